@@ -0,0 +1,401 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   arena.cpp
+@brief  Request scoped arena allocator and string builder
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The HTTP handlers and MQTT callbacks used to build their text in String
+objects, each one a malloc() that is grown and freed again. Over days that
+fragments the heap until a large allocation fails.
+
+Now their temporary text comes from Request_Arena, a static buffer that is
+bumped on allocation and dropped at once when the handler is done:
+
+  UINT16 Mark = Arena_Mark( &Request_Arena );
+  ...
+  Arena_Release( &Request_Arena, Mark );
+
+Marks nest, so a handler may call another one. The last block of the arena
+can grow in place, a string builder that is built last never copies.
+Nothing in here touches the heap.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "arena.h"
+#include "fixed_format.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* No block can grow in place */
+#define ARENA_NO_BLOCK          0xFFFF
+
+#define ARENA_ALIGN_UP( Offset )  ( ((Offset) + (ARENA_ALIGN - 1)) & ~(UINT32)(ARENA_ALIGN - 1) )
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static UINT8  Request_Arena_Buff[REQUEST_ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+
+/* Buffer of a builder that got nothing from its arena */
+static CHAR   Str_Builder_Empty[1] = { 0 };
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+ARENA_RECORD  Request_Arena = { Request_Arena_Buff, REQUEST_ARENA_SIZE, 0, ARENA_NO_BLOCK, 0, 0 };
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static BOOL   Str_Builder_Reserve( STR_BUILDER_RECORD *pSb, UINT16 Extra );
+static void   Str_Builder_Append_Len_P( STR_BUILDER_RECORD *pSb, const CHAR *pFlash, UINT16 Len );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+void
+Arena_Init( ARENA_RECORD *pArena, void *pBuff, UINT16 Size )
+{
+  pArena->pBase     = (UINT8 *)pBuff;
+  pArena->size      = Size;
+  pArena->used      = 0;
+  pArena->last      = ARENA_NO_BLOCK;
+  pArena->peak      = 0;
+  pArena->failures  = 0;
+}
+
+/*===========================================================================*/
+
+/* Allocate a block, NULL if it doesn't fit */
+void *
+Arena_Alloc( ARENA_RECORD *pArena, UINT16 Size )
+{
+  UINT32  Offset = ARENA_ALIGN_UP( pArena->used );
+
+  if ( (Offset + Size) > pArena->size )
+  {
+    pArena->failures++;
+    return NULL;
+  }
+
+  pArena->last = Offset;
+  pArena->used = Offset + Size;
+  pArena->peak = ( pArena->used > pArena->peak ) ? pArena->used : pArena->peak;
+
+  return &pArena->pBase[Offset];
+}
+
+/*===========================================================================*/
+
+/* Resize the last block in place, FALSE if it's not the last or doesn't fit */
+BOOL
+Arena_Grow( ARENA_RECORD *pArena, void *pBlock, UINT16 New_Size )
+{
+  if ( (pArena->last == ARENA_NO_BLOCK) || (pBlock != &pArena->pBase[pArena->last]) ||
+       (((UINT32)pArena->last + New_Size) > pArena->size) )
+  {
+    return FALSE;
+  }
+
+  pArena->used = pArena->last + New_Size;
+  pArena->peak = ( pArena->used > pArena->peak ) ? pArena->used : pArena->peak;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Start of a scope, everything allocated after it goes at Arena_Release() */
+UINT16
+Arena_Mark( ARENA_RECORD *pArena )
+{
+  return pArena->used;
+}
+
+/*===========================================================================*/
+
+void
+Arena_Release( ARENA_RECORD *pArena, UINT16 Mark )
+{
+  if ( Mark < pArena->used )
+  {
+    pArena->used = Mark;
+  }
+  pArena->last = ARENA_NO_BLOCK;
+}
+
+/*===========================================================================*/
+
+/* Make room for Extra more characters, FALSE if the arena is out of it */
+static BOOL
+Str_Builder_Reserve( STR_BUILDER_RECORD *pSb, UINT16 Extra )
+{
+  ARENA_RECORD  *pArena = pSb->pArena;
+  UINT32        Need    = (UINT32)pSb->len + Extra + 1;
+  UINT32        Offset;
+  UINT32        Room;
+  UINT32        New_Cap;
+  BOOL          In_Place;
+  CHAR          *pNew;
+
+  if ( Need <= pSb->cap )
+  {
+    return TRUE;
+  }
+
+  /* Grow in place if it's the last block, else move to a new one */
+  In_Place = ( pArena->last != ARENA_NO_BLOCK ) && ( (UINT8 *)pSb->pBuff == &pArena->pBase[pArena->last] );
+  Offset   = In_Place ? pArena->last : ARENA_ALIGN_UP( pArena->used );
+  Room     = ( Offset < pArena->size ) ? (pArena->size - Offset) : 0;
+
+  if ( Room < Need )
+  {
+    pArena->failures++;
+    pSb->overflow = TRUE;
+    return FALSE;
+  }
+
+  /* Double it to keep appends cheap, but take what's left if that's less */
+  New_Cap = ( ((UINT32)pSb->cap * 2) > Need ) ? ((UINT32)pSb->cap * 2) : Need;
+  New_Cap = ( New_Cap < Room ) ? New_Cap : Room;
+
+  if ( In_Place )
+  {
+    Arena_Grow( pArena, pSb->pBuff, New_Cap );
+  }
+  else
+  {
+    pNew = (CHAR *)Arena_Alloc( pArena, New_Cap );
+    memcpy( pNew, pSb->pBuff, pSb->len + 1 );
+    pSb->pBuff = pNew;
+  }
+  pSb->cap = New_Cap;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Start an empty string, FALSE if not even Capacity fits */
+BOOL
+Str_Builder_Init( STR_BUILDER_RECORD *pSb, ARENA_RECORD *pArena, UINT16 Capacity )
+{
+  pSb->pArena   = pArena;
+  pSb->pBuff    = Str_Builder_Empty;
+  pSb->len      = 0;
+  pSb->cap      = 0;
+  pSb->overflow = FALSE;
+
+  return Str_Builder_Reserve( pSb, Capacity );
+}
+
+/*===========================================================================*/
+
+void
+Str_Builder_Clear( STR_BUILDER_RECORD *pSb )
+{
+  pSb->len = 0;
+  if ( pSb->cap > 0 )
+  {
+    pSb->pBuff[0] = 0;
+  }
+  pSb->overflow = FALSE;
+}
+
+/*===========================================================================*/
+
+/* Append Len characters from RAM, what doesn't fit is cut */
+void
+Str_Builder_Append_Len( STR_BUILDER_RECORD *pSb, const CHAR *pStr, UINT16 Len )
+{
+  if ( !Str_Builder_Reserve( pSb, Len ) )
+  {
+    Len = ( pSb->cap > pSb->len ) ? (pSb->cap - pSb->len - 1) : 0;
+  }
+  if ( Len == 0 )
+  {
+    return;
+  }
+
+  memcpy( &pSb->pBuff[pSb->len], pStr, Len );
+  pSb->len += Len;
+  pSb->pBuff[pSb->len] = 0;
+}
+
+/*===========================================================================*/
+
+void
+Str_Builder_Append( STR_BUILDER_RECORD *pSb, const CHAR *pStr )
+{
+  Str_Builder_Append_Len( pSb, pStr, strlen( pStr ) );
+}
+
+/*===========================================================================*/
+
+/* Append Len characters from flash */
+static void
+Str_Builder_Append_Len_P( STR_BUILDER_RECORD *pSb, const CHAR *pFlash, UINT16 Len )
+{
+  if ( !Str_Builder_Reserve( pSb, Len ) )
+  {
+    Len = ( pSb->cap > pSb->len ) ? (pSb->cap - pSb->len - 1) : 0;
+  }
+  if ( Len == 0 )
+  {
+    return;
+  }
+
+  memcpy_P( &pSb->pBuff[pSb->len], pFlash, Len );
+  pSb->len += Len;
+  pSb->pBuff[pSb->len] = 0;
+}
+
+/*===========================================================================*/
+
+void
+Str_Builder_Append_P( STR_BUILDER_RECORD *pSb, const CHAR *pFlash )
+{
+  Str_Builder_Append_Len_P( pSb, pFlash, strlen_P( pFlash ) );
+}
+
+/*===========================================================================*/
+
+/* printf into the builder, the format is in flash, use PSTR() */
+void
+Str_Builder_Printf( STR_BUILDER_RECORD *pSb, const CHAR *pFormat, ... )
+{
+  va_list   ap;
+  va_list   ap_retry;
+  INT32     Len;
+  UINT16    Room;
+
+  Room = ( pSb->cap > pSb->len ) ? (pSb->cap - pSb->len) : 0;
+
+  va_start( ap, pFormat );
+  va_copy( ap_retry, ap );
+  Len = vsnprintf_P( &pSb->pBuff[pSb->len], Room, pFormat, ap );
+  va_end( ap );
+
+  /* Too long, grow and print again */
+  if ( (Len >= 0) && (Len >= Room) && Str_Builder_Reserve( pSb, Len ) )
+  {
+    Room = pSb->cap - pSb->len;
+    vsnprintf_P( &pSb->pBuff[pSb->len], Room, pFormat, ap_retry );
+  }
+  va_end( ap_retry );
+
+  if ( Len < 0 )
+  {
+    return;
+  }
+
+  /* What was printed, cut to the room there is */
+  Len = ( Len < Room ) ? Len : ( (Room > 0) ? (Room - 1) : 0 );
+  pSb->len += Len;
+}
+
+/*===========================================================================*/
+
+/* Append a number with fixed decimals, as "%.<Decimals>f" but without soft-float */
+void
+Str_Builder_Append_Fixed( STR_BUILDER_RECORD *pSb, FLOAT Value, UINT8 Decimals )
+{
+  CHAR    Number[FIXED_FORMAT_MAX_SIZE];
+  UINT8   Len;
+
+  Len = Fixed_Format( Number, sizeof(Number), Value, Decimals );
+  Str_Builder_Append_Len( pSb, Number, Len );
+}
+
+/*===========================================================================*/
+
+/*!
+Append a template from flash, every "{{ key }}" in it is replaced by what
+Func appends for the key. Spaces around the key are ignored.
+
+@param  pSb         Builder, (IO)
+@param  pTemplate   Template in flash, (I)
+@param  Func        Appends the value of a key, (I)
+@param  pContext    Passed to Func, (I)
+@return None
+*/
+void
+Str_Builder_Template_P( STR_BUILDER_RECORD *pSb, const CHAR *pTemplate, STR_TEMPLATE_FUNC Func, void *pContext )
+{
+  CHAR    Key[STR_TEMPLATE_KEY_MAX_SIZE];
+  UINT16  Start = 0;
+  UINT16  Pos   = 0;
+  UINT16  End;
+  UINT16  Key_Len;
+  CHAR    Ch;
+
+  while ( (Ch = pgm_read_byte( &pTemplate[Pos] )) != 0 )
+  {
+    if ( (Ch != '{') || (pgm_read_byte( &pTemplate[Pos + 1] ) != '{') )
+    {
+      Pos++;
+      continue;
+    }
+
+    /* Find the closing braces */
+    End = Pos + 2;
+    while ( ((Ch = pgm_read_byte( &pTemplate[End] )) != 0) &&
+            !((Ch == '}') && (pgm_read_byte( &pTemplate[End + 1] ) == '}')) )
+    {
+      End++;
+    }
+    if ( Ch == 0 )
+    {
+      /* Not closed, it's text */
+      Pos = End;
+      break;
+    }
+
+    /* The text before it */
+    Str_Builder_Append_Len_P( pSb, &pTemplate[Start], Pos - Start );
+
+    /* The key without the spaces */
+    Key_Len = 0;
+    for ( Pos += 2; Pos < End; Pos++ )
+    {
+      Ch = pgm_read_byte( &pTemplate[Pos] );
+      if ( (Ch != ' ') && (Key_Len < (sizeof(Key) - 1)) )
+      {
+        Key[Key_Len++] = Ch;
+      }
+    }
+    Key[Key_Len] = 0;
+
+    Func( pSb, Key, pContext );
+
+    Pos   = End + 2;
+    Start = Pos;
+  }
+
+  Str_Builder_Append_Len_P( pSb, &pTemplate[Start], Pos - Start );
+}
+
+/*===========================================================================*/
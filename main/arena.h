@@ -0,0 +1,118 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   arena.h
+@brief  Request scoped arena allocator and string builder, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Arena of the HTTP handlers and MQTT callbacks, the largest page with the
+   scan list takes about 2.5 KB */
+#define REQUEST_ARENA_SIZE      4096
+
+/* Blocks are aligned to this */
+#define ARENA_ALIGN             4
+
+/* Longest key of a {{ key }} template placeholder */
+#define STR_TEMPLATE_KEY_MAX_SIZE   32
+
+/* A bump allocator over a fixed buffer, everything is freed at once */
+typedef struct
+{
+  UINT8   *pBase;
+  UINT16  size;
+  UINT16  used;
+  UINT16  last;         /* Offset of the last block, it can grow in place */
+  UINT16  peak;
+  UINT32  failures;     /* Allocations that didn't fit */
+
+} ARENA_RECORD;
+
+/* Text built in an arena, always terminated */
+typedef struct
+{
+  ARENA_RECORD  *pArena;
+  CHAR          *pBuff;
+  UINT16        len;
+  UINT16        cap;
+  BOOL          overflow;   /* Something didn't fit and was cut */
+
+} STR_BUILDER_RECORD;
+
+/* Appends the value of a template key */
+typedef void (*STR_TEMPLATE_FUNC)( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext );
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+extern ARENA_RECORD Request_Arena;
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Arena_Init( ARENA_RECORD *pArena, void *pBuff, UINT16 Size );
+
+extern void *
+Arena_Alloc( ARENA_RECORD *pArena, UINT16 Size );
+
+extern BOOL
+Arena_Grow( ARENA_RECORD *pArena, void *pBlock, UINT16 New_Size );
+
+extern UINT16
+Arena_Mark( ARENA_RECORD *pArena );
+
+extern void
+Arena_Release( ARENA_RECORD *pArena, UINT16 Mark );
+
+extern BOOL
+Str_Builder_Init( STR_BUILDER_RECORD *pSb, ARENA_RECORD *pArena, UINT16 Capacity );
+
+extern void
+Str_Builder_Clear( STR_BUILDER_RECORD *pSb );
+
+extern void
+Str_Builder_Append( STR_BUILDER_RECORD *pSb, const CHAR *pStr );
+
+extern void
+Str_Builder_Append_Len( STR_BUILDER_RECORD *pSb, const CHAR *pStr, UINT16 Len );
+
+extern void
+Str_Builder_Append_P( STR_BUILDER_RECORD *pSb, const CHAR *pFlash );
+
+extern void
+Str_Builder_Printf( STR_BUILDER_RECORD *pSb, const CHAR *pFormat, ... );
+
+extern void
+Str_Builder_Append_Fixed( STR_BUILDER_RECORD *pSb, FLOAT Value, UINT8 Decimals );
+
+extern void
+Str_Builder_Template_P( STR_BUILDER_RECORD *pSb, const CHAR *pTemplate, STR_TEMPLATE_FUNC Func, void *pContext );
+
+#endif  /* __ARENA_H__ */
+
+/*===========================================================================*/
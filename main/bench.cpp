@@ -0,0 +1,373 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   bench.cpp
+@brief  On-device micro-benchmarks of the hot paths
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Times the code that runs all the time: logging, page rendering, MQTT
+dispatch, float formatting and the sonar filter. Each case is called
+BENCH_ITERATIONS times, timed by the CPU cycle counter.
+
+Heap allocations per call come from the umm_malloc statistics, which are
+only there when the core is built with UMM_STATS_FULL (e.g. -DUMM_STATS_FULL
+in build_opt.h). Without it only the retained heap is reported.
+
+Results are printed and published as one JSON line per case, so they can be
+collected and compared between firmware versions:
+{"case":"render_index","fw":"1.0","iters":100,"cycles":..,"ns":..,"allocs_x100":..,"peak":..,"retained":..}
+
+The cases are also called one by one with Bench_Call_Case(), tools/bench_host
+runs them on the host build with an allocator that counts every call.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+#ifdef UMM_STATS_FULL
+#include <umm_malloc/umm_malloc.h>
+#endif
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "bench.h"
+
+#ifdef BENCH_ENABLE
+
+#include "http_server.h"
+#include "mqtt_client.h"
+#include "relay_control.h"
+#include "fixed_format.h"
+#include "watchdog.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+typedef void (*BENCH_FUNC)( void );
+
+typedef struct
+{
+  const CHAR  *pName;
+  BENCH_FUNC  Func;
+
+} BENCH_CASE_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static BOOL           Bench_Requested = FALSE;
+
+/* Results go here, so the calls are not optimized away */
+static volatile UINT32 Bench_Sink     = 0;
+
+static SONAR_FILTER_RECORD Bench_Filter;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void Bench_Log_Filtered( void );
+static void Bench_Log_Emit( void );
+static void Bench_Render_Index( void );
+static void Bench_Render_Control( void );
+static void Bench_Mqtt_Dispatch( void );
+static void Bench_Float_Format( void );
+static void Bench_Fixed_Format( void );
+static void Bench_Sonar_Filter( void );
+static void Bench_Run_Case( BENCH_FUNC Func, BENCH_RESULT_RECORD *pResult );
+static void Bench_Report( const CHAR *pName, const BENCH_RESULT_RECORD *pResult );
+
+static const BENCH_CASE_RECORD Bench_Cases[] =
+{
+  { "log_filtered",   Bench_Log_Filtered },
+  { "log_emit",       Bench_Log_Emit },
+  { "render_index",   Bench_Render_Index },
+  { "render_control", Bench_Render_Control },
+  { "mqtt_dispatch",  Bench_Mqtt_Dispatch },
+  { "float_format",   Bench_Float_Format },
+  { "fixed_format",   Bench_Fixed_Format },
+  { "sonar_filter",   Bench_Sonar_Filter },
+};
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* A log below LOG_LEVEL, the cost of the level check */
+static void
+Bench_Log_Filtered( void )
+{
+  LOG( DBG_3, "Bench: %s %d\n", "filtered", Bench_Sink );
+}
+
+/*===========================================================================*/
+
+/* A log that is printed, exempt from rate limiting */
+static void
+Bench_Log_Emit( void )
+{
+  LOG( DBG_C, "Bench: %s %d\n", "emit", Bench_Sink );
+}
+
+/*===========================================================================*/
+
+static void
+Bench_Render_Index( void )
+{
+  STR_BUILDER_RECORD  Page;
+  MY_STATUS_RECORD    Status;
+  UINT16              Mark = Arena_Mark( &Request_Arena );
+
+  My_Status_Read( &Status );
+  Str_Builder_Init( &Page, &Request_Arena, 1024 );
+  http_render_index( &Page, &Status );
+  Bench_Sink += Page.len;
+
+  Arena_Release( &Request_Arena, Mark );
+}
+
+/*===========================================================================*/
+
+static void
+Bench_Render_Control( void )
+{
+  STR_BUILDER_RECORD  Page;
+  MY_STATUS_RECORD    Status;
+  UINT16              Mark = Arena_Mark( &Request_Arena );
+
+  My_Status_Read( &Status );
+  Str_Builder_Init( &Page, &Request_Arena, 1024 );
+  http_render_control( &Page, &Status );
+  Bench_Sink += Page.len;
+
+  Arena_Release( &Request_Arena, Mark );
+}
+
+/*===========================================================================*/
+
+/* A topic that matches nothing, the cost of the dispatch itself */
+static void
+Bench_Mqtt_Dispatch( void )
+{
+  mqtt_subscribe_callback( "test", "bench" );
+}
+
+/*===========================================================================*/
+
+/* As in the publish burst */
+static void
+Bench_Float_Format( void )
+{
+  Bench_Sink += String( My_Status.avg_distance_cm, 2 ).length();
+}
+
+/*===========================================================================*/
+
+/* The same with the fixed decimal formatter */
+static void
+Bench_Fixed_Format( void )
+{
+  CHAR  Number[FIXED_FORMAT_MAX_SIZE];
+
+  Bench_Sink += Fixed_Format( Number, sizeof(Number), My_Status.avg_distance_cm, 2 );
+}
+
+/*===========================================================================*/
+
+static void
+Bench_Sonar_Filter( void )
+{
+  Bench_Sink += Sonar_Filter_Add( &Bench_Filter, 123.4 + (Bench_Sink & 0x0F) );
+}
+
+/*===========================================================================*/
+
+static void
+Bench_Run_Case( BENCH_FUNC Func, BENCH_RESULT_RECORD *pResult )
+{
+  UINT32  Count;
+  UINT32  Heap_Before;
+  UINT32  Cycles;
+#ifdef UMM_STATS_FULL
+  UINT32  Allocs_Before;
+#endif
+
+  /* Warm up, the first call may fill caches or grow buffers */
+  Func();
+
+  Heap_Before = ESP.getFreeHeap();
+#ifdef UMM_STATS_FULL
+  Allocs_Before = umm_get_malloc_count() + umm_get_realloc_count();
+  umm_free_heap_size_min_reset();
+#endif
+
+  Cycles = ESP.getCycleCount();
+  for ( Count = 0; Count < BENCH_ITERATIONS; Count++ )
+  {
+    Func();
+  }
+  Cycles = ESP.getCycleCount() - Cycles;
+
+  pResult->cycles         = Cycles / BENCH_ITERATIONS;
+  pResult->ns             = Cycles / ESP.getCpuFreqMHz() * (1000 / BENCH_ITERATIONS);
+  pResult->retained_bytes = (INT32)Heap_Before - (INT32)ESP.getFreeHeap();
+#ifdef UMM_STATS_FULL
+  pResult->allocs_x100    = (INT32)((umm_get_malloc_count() + umm_get_realloc_count() - Allocs_Before) * 100 / BENCH_ITERATIONS);
+  pResult->peak_bytes     = (INT32)Heap_Before - (INT32)umm_free_heap_size_min();
+#else
+  pResult->allocs_x100    = -1;
+  pResult->peak_bytes     = -1;
+#endif
+}
+
+/*===========================================================================*/
+
+static void
+Bench_Report( const CHAR *pName, const BENCH_RESULT_RECORD *pResult )
+{
+  CHAR  Line[BENCH_LINE_MAX_SIZE];
+
+  snprintf( Line, sizeof(Line),
+            "{\"case\":\"%s\",\"fw\":\"%s\",\"iters\":%d,\"cycles\":%lu,\"ns\":%lu,"
+            "\"allocs_x100\":%ld,\"peak\":%ld,\"retained\":%ld}",
+            pName, SW_REVISION, BENCH_ITERATIONS, pResult->cycles, pResult->ns,
+            pResult->allocs_x100, pResult->peak_bytes, pResult->retained_bytes );
+
+  Serial.println( Line );
+  if ( mqtt_is_connected() )
+  {
+    mqtt_publish( PSTR(BENCH_RESULT_TOPIC), Line );
+  }
+}
+
+/*===========================================================================*/
+
+UINT8
+Bench_Get_Case_Count( void )
+{
+  return sizeof(Bench_Cases)/sizeof(Bench_Cases[0]);
+}
+
+/*===========================================================================*/
+
+const CHAR *
+Bench_Get_Case_Name( UINT8 Index )
+{
+  return ( Index < Bench_Get_Case_Count() ) ? Bench_Cases[Index].pName : NULL;
+}
+
+/*===========================================================================*/
+
+/* One call of a case, Bench_Setup() first */
+void
+Bench_Call_Case( UINT8 Index )
+{
+  if ( Index < Bench_Get_Case_Count() )
+  {
+    Bench_Cases[Index].Func();
+  }
+}
+
+/*===========================================================================*/
+
+/* State the cases start from */
+void
+Bench_Setup( void )
+{
+  Sonar_Filter_Reset( &Bench_Filter, 100 );
+}
+
+/*===========================================================================*/
+
+/* Run the benchmarks on the next Bench_Handle() */
+void
+Bench_Request( void )
+{
+  Bench_Requested = TRUE;
+}
+
+/*===========================================================================*/
+
+/* Run the benchmarks if requested, to call at each sketch loop().
+   Blocks for the whole run, it's a debug build only */
+void
+Bench_Handle( void )
+{
+  BENCH_RESULT_RECORD Result;
+  UINT8               Index;
+
+  if ( !Bench_Requested )
+  {
+    return;
+  }
+  Bench_Requested = FALSE;
+
+  Bench_Setup();
+
+  for ( Index = 0; Index < Bench_Get_Case_Count(); Index++ )
+  {
+    Bench_Run_Case( Bench_Cases[Index].Func, &Result );
+    Bench_Report( Bench_Cases[Index].pName, &Result );
+
+    /* Let the system breathe between cases */
+    yield();
+    Watchdog_Heartbeat();
+  }
+}
+
+/*===========================================================================*/
+
+#else   /* BENCH_ENABLE */
+
+UINT8
+Bench_Get_Case_Count( void )
+{
+  return 0;
+}
+
+const CHAR *
+Bench_Get_Case_Name( UINT8 Index )
+{
+  return NULL;
+}
+
+void
+Bench_Call_Case( UINT8 Index )
+{
+}
+
+void
+Bench_Setup( void )
+{
+}
+
+void
+Bench_Request( void )
+{
+}
+
+void
+Bench_Handle( void )
+{
+}
+
+#endif  /* BENCH_ENABLE */
+
+/*===========================================================================*/
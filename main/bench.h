@@ -0,0 +1,84 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   bench.h
+@brief  On-device micro-benchmarks of the hot paths, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Only built with BENCH_ENABLE defined in esp8266_global.h.
+*/
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Calls of each case per run, a divisor of 1000 */
+#define BENCH_ITERATIONS      100
+
+/* MQTT topics, publish "run" to start, one JSON line per case comes back */
+#define BENCH_CMD_TOPIC       "bench"
+#define BENCH_RESULT_TOPIC    "bench_result"
+
+#define BENCH_LINE_MAX_SIZE   192
+
+/* Result of one case, all per call */
+typedef struct
+{
+  UINT32  cycles;
+  UINT32  ns;
+
+  /* Heap, only counted when the core is built with UMM_STATS_FULL, else -1 */
+  INT32   allocs_x100;      /* malloc and realloc calls x 100 */
+  INT32   peak_bytes;       /* Heap in use at most during the calls */
+
+  /* Heap not given back after all calls, a leak or a cache */
+  INT32   retained_bytes;
+
+} BENCH_RESULT_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern UINT8
+Bench_Get_Case_Count( void );
+
+extern const CHAR *
+Bench_Get_Case_Name( UINT8 Index );
+
+extern void
+Bench_Call_Case( UINT8 Index );
+
+extern void
+Bench_Setup( void );
+
+extern void
+Bench_Request( void );
+
+extern void
+Bench_Handle( void );
+
+#endif  /* __BENCH_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,173 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   boot_profile.cpp
+@brief  Record when each boot phase starts and finishes
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "boot_profile.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Timing of one boot phase, ms since power on */
+typedef struct
+{
+  BOOL    started;
+  BOOL    done;
+  UINT32  start_ms;
+  UINT32  done_ms;
+
+} BOOT_PHASE_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static BOOT_PHASE_RECORD  Boot_Phases[NUM_BOOT_PHASES];
+
+/* Names used in logs and the boot profile message */
+static const CHAR *Boot_Phase_Names[NUM_BOOT_PHASES] =
+{
+  "hw", "wifi", "ntp", "http", "mqtt"
+};
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+void
+Boot_Phase_Start( BOOT_PHASE Phase )
+{
+  if ( (Phase >= NUM_BOOT_PHASES) || Boot_Phases[Phase].started )
+  {
+    return;
+  }
+
+  Boot_Phases[Phase].started  = TRUE;
+  Boot_Phases[Phase].start_ms = millis();
+}
+
+/*===========================================================================*/
+
+void
+Boot_Phase_Done( BOOT_PHASE Phase )
+{
+  if ( (Phase >= NUM_BOOT_PHASES) || Boot_Phases[Phase].done )
+  {
+    return;
+  }
+
+  /* In case nobody marked the start */
+  Boot_Phase_Start( Phase );
+
+  Boot_Phases[Phase].done     = TRUE;
+  Boot_Phases[Phase].done_ms  = millis();
+
+  LOG( DBG_N, "Boot: Phase %s done at %lu ms, cost %lu ms.\n",
+              Boot_Phase_Names[Phase],
+              Boot_Phases[Phase].done_ms,
+              Boot_Phases[Phase].done_ms - Boot_Phases[Phase].start_ms );
+}
+
+/*===========================================================================*/
+
+BOOL
+Boot_Phase_Is_Done( BOOT_PHASE Phase )
+{
+  if ( Phase >= NUM_BOOT_PHASES )
+  {
+    return FALSE;
+  }
+
+  return Boot_Phases[Phase].done;
+}
+
+/*===========================================================================*/
+
+/* TRUE if all phases are done */
+BOOL
+Boot_Is_Complete( void )
+{
+  UINT8 Phase;
+
+  for ( Phase = 0; Phase < NUM_BOOT_PHASES; Phase++ )
+  {
+    if ( !Boot_Phases[Phase].done )
+    {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+Format the boot profile as JSON, e.g.
+{"hw":[0,35],"wifi":[35,310],...}, [start ms, cost ms], cost is -1 if not done
+
+@param  pBuff   Output buffer, (O)
+@param  Size    Size of output buffer, (I)
+@return Length of the string
+*/
+UINT16
+Boot_Profile_Format( CHAR *pBuff, UINT16 Size )
+{
+  UINT8   Phase;
+  INT32   Len = 0;
+
+  if ( Size == 0 )
+  {
+    return 0;
+  }
+
+  pBuff[0] = 0;
+  Len += snprintf_P( pBuff + Len, Size - Len, PSTR("{") );
+
+  for ( Phase = 0; (Phase < NUM_BOOT_PHASES) && (Len < Size); Phase++ )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%s\"%s\":[%ld,%ld]"),
+                     (Phase == 0)?"":",",
+                     Boot_Phase_Names[Phase],
+                     (INT32)Boot_Phases[Phase].start_ms,
+                     Boot_Phases[Phase].done ? (INT32)(Boot_Phases[Phase].done_ms - Boot_Phases[Phase].start_ms) : -1L );
+  }
+
+  if ( Len < Size )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("}") );
+  }
+
+  return ( Len < Size ) ? Len : (Size - 1);
+}
+
+/*===========================================================================*/
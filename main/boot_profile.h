@@ -0,0 +1,73 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   boot_profile.h
+@brief  Boot phases and their timing definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __BOOT_PROFILE_H__
+#define __BOOT_PROFILE_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Boot phases, all phases except HW come up concurrently in loop() */
+typedef enum
+{
+  BOOT_PHASE_HW = 0,      /* GPIO, config, relay restore and sonar */
+  BOOT_PHASE_WIFI,        /* STA connected */
+  BOOT_PHASE_NTP,         /* Time valid */
+  BOOT_PHASE_HTTP,        /* HTTP server listening */
+  BOOT_PHASE_MQTT,        /* MQTT broker connected */
+  NUM_BOOT_PHASES
+
+} BOOT_PHASE;
+
+/* Publish the boot profile even if some phases are not done after this time */
+#define BOOT_PROFILE_TIMEOUT_MS   (60*1000)
+
+#define BOOT_PROFILE_STR_MAX_SIZE 160
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Boot_Phase_Start( BOOT_PHASE Phase );
+
+extern void
+Boot_Phase_Done( BOOT_PHASE Phase );
+
+extern BOOL
+Boot_Phase_Is_Done( BOOT_PHASE Phase );
+
+extern BOOL
+Boot_Is_Complete( void );
+
+extern UINT16
+Boot_Profile_Format( CHAR *pBuff, UINT16 Size );
+
+#endif  /* __BOOT_PROFILE_H__ */
+
+/*===========================================================================*/
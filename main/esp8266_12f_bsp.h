@@ -18,7 +18,6 @@ Description:
 System Includes
 =============================================================================*/
 
-#include <EEPROM.h>
 
 /*=============================================================================
 Local Includes
@@ -41,8 +40,18 @@ Definitions
 
 /* EEPROM definitions */
 /* Each byte of the EEPROM can only hold a value from 0 to 255. */
-#define EEPROM_CONFIG_SIZE    512
+#define EEPROM_TOTAL_SIZE     512
+#define EEPROM_CONFIG_SIZE    384
 #define EEPROM_CONFIG_ADDR    0
+#define EEPROM_WIFI_CACHE_ADDR  384   /* 64 bytes */
+#define EEPROM_STATE_ADDR       448   /* 64 bytes */
+
+/* RTC user memory definitions, survive resets but not power loss.
+   Offsets are in 4 bytes blocks, 128 blocks available, eboot takes 0 to 31
+   for the command of an OTA update */
+#define RTC_HISTORY_OFFSET    32      /* 32 blocks */
+#define RTC_WIFI_CACHE_OFFSET 64      /* 16 blocks */
+#define RTC_WATCHDOG_OFFSET   80      /* 16 blocks */
 
 /*=============================================================================
 Global References
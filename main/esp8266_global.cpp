@@ -21,12 +21,15 @@ System Includes
 #include <WiFiClient.h>
 #include <ESP8266WebServer.h>
 #include <ESP8266mDNS.h>
+#include <coredecls.h>
 
 /*=============================================================================
 Local Includes
 =============================================================================*/
 
 #include "esp8266_global.h"
+#include "metrics.h"
+#include "seqlock.h"
 
 /*=============================================================================
 Definitions
@@ -42,6 +45,24 @@ Definitions
 #define APPSK  "88888888"
 #endif
 
+/* My config record of format 2, a single station network */
+typedef struct
+{
+  UINT16  format_version;
+
+  CHAR    sta_ssid[WIFI_SSID_STR_MAX_SIZE];
+  CHAR    sta_pwd[WIFI_PWD_STR_MAX_SIZE];
+  CHAR    ap_ssid[WIFI_SSID_STR_MAX_SIZE];
+  CHAR    ap_pwd[WIFI_PWD_STR_MAX_SIZE];
+
+  BOOL    relay_auto;
+  RELAY_TIMING_RECORD relay_on_timing;
+  RELAY_TIMING_RECORD relay_off_timing;
+  FLOAT   high_distance_cm;
+  FLOAT   low_distance_cm;
+
+} MY_CONFIG_V2_RECORD;
+
 /*=============================================================================
 Static Variables
 =============================================================================*/
@@ -53,6 +74,9 @@ static char    LogLevelCharacters[DBG_3+1] =
   'P', 'C', 'A', 'E', 'W', 'N', 'I', '1', '2', '3'
 };
 
+/* Guards My_Status, see My_Status_Read() */
+static SEQLOCK_RECORD  My_Status_Lock = { 0, 0 };
+
 /*=============================================================================
 Global Variables
 =============================================================================*/
@@ -75,11 +99,15 @@ My_Config_Set_Defaults( MY_CONFIG_RECORD *pConfig )
 {
   /* Use the compile-time defaults */
 //  memcpy( pConfig, &My_Config_Default, sizeof(MY_CONFIG_RECORD) );.
+  memset( pConfig, 0, sizeof(MY_CONFIG_RECORD) );
   pConfig->format_version   = MY_CONFIG_FORMAT_VERSION;
-  strcpy( pConfig->sta_ssid,  (CHAR *)STASSID );
-  strcpy( pConfig->sta_pwd,   (CHAR *)STAPSK );
+  pConfig->sta_list[0].valid    = TRUE;
+  pConfig->sta_list[0].priority = 0;
+  strcpy( pConfig->sta_list[0].ssid,  (CHAR *)STASSID );
+  strcpy( pConfig->sta_list[0].pwd,   (CHAR *)STAPSK );
   strcpy( pConfig->ap_ssid,   (CHAR *)APSSID );
   strcpy( pConfig->ap_pwd,    (CHAR *)APPSK );
+  pConfig->wdt_enable = TRUE;
 }
 
 /*===========================================================================*/
@@ -87,6 +115,44 @@ My_Config_Set_Defaults( MY_CONFIG_RECORD *pConfig )
 UINT8
 My_Config_Validate( MY_CONFIG_RECORD  *pConfig )
 {
+  MY_CONFIG_V2_RECORD   Old_Config;
+
+  /* Format 2 has one network where format 3 has the list, it becomes the
+     first of the list, the AP and relay settings are kept */
+  if ( pConfig->format_version == 2 )
+  {
+    memcpy( &Old_Config, pConfig, sizeof(MY_CONFIG_V2_RECORD) );
+    memset( pConfig, 0, sizeof(MY_CONFIG_RECORD) );
+
+    if ( Old_Config.sta_ssid[0] != 0 )
+    {
+      pConfig->sta_list[0].valid    = TRUE;
+      pConfig->sta_list[0].priority = 0;
+      strncpy( pConfig->sta_list[0].ssid, Old_Config.sta_ssid, WIFI_SSID_STR_MAX_SIZE - 1 );
+      strncpy( pConfig->sta_list[0].pwd,  Old_Config.sta_pwd,  WIFI_PWD_STR_MAX_SIZE - 1 );
+    }
+    memcpy( pConfig->ap_ssid, Old_Config.ap_ssid, WIFI_SSID_STR_MAX_SIZE );
+    memcpy( pConfig->ap_pwd,  Old_Config.ap_pwd,  WIFI_PWD_STR_MAX_SIZE );
+    pConfig->ap_ssid[WIFI_SSID_STR_MAX_SIZE - 1] = 0;
+    pConfig->ap_pwd[WIFI_PWD_STR_MAX_SIZE - 1]   = 0;
+
+    pConfig->relay_auto       = Old_Config.relay_auto;
+    pConfig->relay_on_timing  = Old_Config.relay_on_timing;
+    pConfig->relay_off_timing = Old_Config.relay_off_timing;
+    pConfig->high_distance_cm = Old_Config.high_distance_cm;
+    pConfig->low_distance_cm  = Old_Config.low_distance_cm;
+
+    pConfig->format_version   = 3;
+    LOG( DBG_N, "Config format 2 moved to format 3\n" );
+  }
+
+  /* Format 3 is format 4 without wdt_enable at the end, keep the rest */
+  if ( pConfig->format_version == 3 )
+  {
+    pConfig->wdt_enable     = TRUE;
+    pConfig->format_version = MY_CONFIG_FORMAT_VERSION;
+  }
+
   /* Format of this file */
   if ( pConfig->format_version != MY_CONFIG_FORMAT_VERSION)
   {
@@ -109,10 +175,10 @@ My_Config_Save( MY_CONFIG_RECORD  *pConfig )
   UINT16  data_len = sizeof(MY_CONFIG_RECORD);
   UINT16  count;
 
-  EEPROM.begin(512);
+  EEPROM.begin(EEPROM_TOTAL_SIZE);
 
   /* Check length */
-  if( data_len >= 512 )
+  if( data_len >= EEPROM_CONFIG_SIZE )
   {
     LOG( DBG_E, "My Config is too large, size=%d bytes\n", data_len );
     return(FN_RETURN_ERROR);
@@ -126,6 +192,7 @@ My_Config_Save( MY_CONFIG_RECORD  *pConfig )
   }
 
   /* Commit into flash */
+  Metric_Inc( METRIC_EEPROM_COMMITS );
   if (EEPROM.commit())
   {
     LOG( DBG_N, "EEPROM successfully committed\n");
@@ -148,10 +215,10 @@ My_Config_Load( MY_CONFIG_RECORD  *pConfig )
   UINT16  data_len = sizeof(MY_CONFIG_RECORD);
   UINT16  count;
 
-  EEPROM.begin(512);
+  EEPROM.begin(EEPROM_TOTAL_SIZE);
 
   /* Check length */
-  if( data_len >= 512 )
+  if( data_len >= EEPROM_CONFIG_SIZE )
   {
     LOG( DBG_E, "My Config is too large, size=%d bytes\n", data_len );
     return(FN_RETURN_ERROR);
@@ -204,61 +271,99 @@ My_Config_Initialise(void)
 
 /*============================================================================*/
 
-void
-Wifi_Initialise( void )
+/* Persist the relay status, only commit when it is changed */
+UINT8
+My_State_Save( BOOL Relay_Status )
 {
-  u32 std_init_timestamp_ms = 0;
+  MY_STATE_RECORD   State;
+  MY_STATE_RECORD   Old_State;
 
-  /* Set wifi mode to support both AP and STA */
-  WiFi.mode(WIFI_AP_STA);
+  memset( &State, 0, sizeof(State) );
+  State.magic         = MY_STATE_MAGIC;
+  State.relay_status  = Relay_Status;
+  State.crc           = crc32( &State, offsetof(MY_STATE_RECORD, crc) );
 
-/*---------------------------------------------------------------------------*/
+  EEPROM.begin(EEPROM_TOTAL_SIZE);
+  EEPROM.get( EEPROM_STATE_ADDR, Old_State );
+  if ( memcmp( &State, &Old_State, sizeof(State) ) == 0 )
+  {
+    return(FN_RETURN_OK);
+  }
 
-  /* Init the wifi AP function */
-  LOG( DBG_A, "Configuring Access Point...\n" );
-  /* You can remove the password parameter if you want the AP to be open. */
-//  WiFi.softAP(ap_ssid, ap_password);
-  WiFi.softAP( My_Config.ap_ssid );
+  EEPROM.put( EEPROM_STATE_ADDR, State );
+  Metric_Inc( METRIC_EEPROM_COMMITS );
+  if ( !EEPROM.commit() )
+  {
+    LOG( DBG_E, "ERROR! EEPROM commit state failed\n");
+    return(FN_RETURN_ERROR);
+  }
 
-  IPAddress myIP = WiFi.softAPIP();
-  LOG( DBG_A, "AP IP address: %s\n", myIP.toString().c_str() );
+  return(FN_RETURN_OK);
+}
 
-/*---------------------------------------------------------------------------*/
+/*============================================================================*/
 
-  /* Init the wifi STA function */
-  WiFi.begin( My_Config.sta_ssid , My_Config.sta_pwd );
-  std_init_timestamp_ms = millis();
+/* Load the persisted relay status */
+UINT8
+My_State_Load( BOOL *pRelay_Status )
+{
+  MY_STATE_RECORD   State;
+
+  EEPROM.begin(EEPROM_TOTAL_SIZE);
+  EEPROM.get( EEPROM_STATE_ADDR, State );
 
-  /* Wait for connection */
-  while (WiFi.status() != WL_CONNECTED)
+  if ( (State.magic != MY_STATE_MAGIC) ||
+       (State.crc != crc32( &State, offsetof(MY_STATE_RECORD, crc) )) )
   {
-    /* Wait connect for at most 10 seconds */
-    if ( (millis() - std_init_timestamp_ms ) > 10000 )
-    {
-      break;
-    }
+    LOG( DBG_W, "No persisted state in EEPROM\n");
+    return(FN_RETURN_ERROR);
+  }
 
-    digitalWrite(GPIO_LED_BLUE, !digitalRead(GPIO_LED_BLUE));
+  *pRelay_Status = State.relay_status;
 
-    delay(300);
-    Serial.print(".");
-  }
+  return(FN_RETURN_OK);
+}
 
-  Serial.println("");
+/*============================================================================*/
 
-  if ( WiFi.status() != WL_CONNECTED )
-  {
-    LOG( DBG_A, "Connect failed, bad SSID %s!\n", My_Config.sta_ssid );
-    digitalWrite(GPIO_LED_RED, HIGH);
-  }
-  else
-  {
-    LOG( DBG_A, "Connected to: %s\n", My_Config.sta_ssid );
-    LOG( DBG_A, "IP address: %s\n", WiFi.localIP().toString().c_str() );
-    digitalWrite(GPIO_LED_RED, LOW);
-  }
+/* Before changing My_Status, the fields changed together go in one section */
+void
+My_Status_Write_Begin( void )
+{
+  Seqlock_Write_Begin( &My_Status_Lock );
+}
+
+/*============================================================================*/
+
+void
+My_Status_Write_End( void )
+{
+  Seqlock_Write_End( &My_Status_Lock );
+}
+
+/*============================================================================*/
 
-  LOG( DBG_P, "Wifi Initialise Complete.\n" );
+/*!
+Copy My_Status as one, no field from before a write section and another
+from after it. For building pages and payloads, code that writes My_Status
+reads its own fields directly.
+
+@param  pStatus   Copy, (O)
+@return The version of the copy, it goes up with every write section
+*/
+UINT32
+My_Status_Read( MY_STATUS_RECORD *pStatus )
+{
+  return Seqlock_Read( &My_Status_Lock, pStatus, &My_Status, sizeof(MY_STATUS_RECORD) );
+}
+
+/*============================================================================*/
+
+/* Version of My_Status, to tell whether it changed since a copy */
+UINT32
+My_Status_Version( void )
+{
+  return Seqlock_Version( &My_Status_Lock );
 }
 
 /*============================================================================*/
@@ -292,12 +397,33 @@ SR04_Initialise( void )
 
 /*============================================================================*/
 
-/* Report the distance in cm,
+/* Convert the width of an echo pulse to the distance in cm,
+   if return 0, means the distance is not valid */
+FLOAT
+SR04_Echo_To_Distance( UINT32 Duration_us )
+{
+  FLOAT   Distace_cm;
+
+  /* convert the time into a distance */
+  Distace_cm = ((FLOAT)Duration_us * 170) / 10000;
+
+  if ( Distace_cm < 2 || Distace_cm > 430 )
+  {
+    Distace_cm = 0;
+  }
+
+  return Distace_cm;
+}
+
+/*============================================================================*/
+
+/* Report the distance in cm, blocks until the echo is back,
    if return 0, means the distance is not valid */
 FLOAT
 SR04_Get_Distance( void )
 {
-  FLOAT   Duration_us, Distace_cm;
+  UINT32  Duration_us;
+  FLOAT   Distace_cm;
   UINT32  Operation_Start_Timestamp_ms;
 
   Operation_Start_Timestamp_ms = millis();
@@ -315,14 +441,7 @@ SR04_Get_Distance( void )
       of the ping to the reception of its echo off of an object.
       Default timeout is 100000 microseconds */
   Duration_us = pulseIn(GPIO_ECHO, HIGH, 100000);
-
-  /* convert the time into a distance */
-  Distace_cm = (Duration_us * 170) / 10000;
-
-  if ( Distace_cm < 2 || Distace_cm > 430 )
-  {
-    Distace_cm = 0;
-  }
+  Distace_cm  = SR04_Echo_To_Distance( Duration_us );
 
   LOG( DBG_N, "Sonar: Distance %.2f cm, Cost %d ms\n",
               Distace_cm,
@@ -32,8 +32,14 @@ Definitions
 /* Software Version */
 #define SW_REVISION                 "1.0"
 
+/* Uncomment to build the on-device micro-benchmarks, see bench.cpp */
+//#define BENCH_ENABLE
+
+/* Uncomment to talk to the MQTT broker over TLS, see mqtt_transport.h */
+//#define MQTT_TLS_ENABLE
+
 /* The configuration format versions understood by this software release */
-#define MY_CONFIG_FORMAT_VERSION    2
+#define MY_CONFIG_FORMAT_VERSION    4
 #define MY_STATUS_FORMAT_VERSION    1
 
 /*--------------------------------------------------------------------------*/
@@ -86,6 +92,26 @@ typedef struct
 #define WIFI_SSID_STR_MAX_SIZE  32
 #define WIFI_PWD_STR_MAX_SIZE   16
 
+/* Max count of stored station networks */
+#define WIFI_STA_LIST_MAX_SIZE  4
+
+/* Highest priority of a station network */
+#define WIFI_PRIORITY_MAX       9
+
+/* One station network */
+typedef struct
+{
+  /* If this record is used */
+  BOOL    valid;
+
+  /* 0-WIFI_PRIORITY_MAX, higher is preferred */
+  UINT8   priority;
+
+  CHAR    ssid[WIFI_SSID_STR_MAX_SIZE];
+  CHAR    pwd[WIFI_PWD_STR_MAX_SIZE];
+
+} WIFI_STA_RECORD;
+
 /* My config record */
 typedef struct
 {
@@ -93,8 +119,7 @@ typedef struct
   UINT16  format_version;
 
   /* Wifi config */
-  CHAR    sta_ssid[WIFI_SSID_STR_MAX_SIZE];
-  CHAR    sta_pwd[WIFI_PWD_STR_MAX_SIZE];
+  WIFI_STA_RECORD sta_list[WIFI_STA_LIST_MAX_SIZE];
   CHAR    ap_ssid[WIFI_SSID_STR_MAX_SIZE];
   CHAR    ap_pwd[WIFI_PWD_STR_MAX_SIZE];
 
@@ -113,13 +138,17 @@ typedef struct
   /* When distance is low than this value(water level is high), turn on relay */
   FLOAT   low_distance_cm;
 
+  /* Reset when a task misses its deadline, see watchdog.cpp. Added in format 4 */
+  BOOL    wdt_enable;
+
 } MY_CONFIG_RECORD;
 
 /*--------------------------------------------------------------------------*/
 
 #define LOCALTIME_STR_MAX_SIZE  20
 
-/* My status record */
+/* My status record, written between My_Status_Write_Begin() and
+   My_Status_Write_End(), pages and payloads use a My_Status_Read() copy */
 typedef struct
 {
   /* Format of this record */
@@ -155,6 +184,12 @@ typedef struct
   /* Current IP when esp8266 is connected */
   CHAR    current_sta_ip[16];
 
+  /* Time from start connecting to connected in this boot, ms */
+  UINT32  wifi_connect_time_ms;
+
+  /* Wether connected by the cached BSSID/channel/IP, TRUE-fast;FALSE-full */
+  BOOL    wifi_fast_connect;
+
   /*--------------------------------------------------------------------------*/
 
 //  /* Relay timing control config */
@@ -175,6 +210,26 @@ typedef struct
 
 /*--------------------------------------------------------------------------*/
 
+#define MY_STATE_MAGIC  0x53544154    /* 'STAT' */
+
+/* The runtime state persisted across power loss, only written when changed */
+typedef struct
+{
+  /* MY_STATE_MAGIC if this record is valid */
+  UINT32  magic;
+
+  /* Last applied relay status, restored at boot before anything else */
+  BOOL    relay_status;
+
+  UINT8   reserved[3];
+
+  /* CRC of all above */
+  UINT32  crc;
+
+} MY_STATE_RECORD;
+
+/*--------------------------------------------------------------------------*/
+
 
 /*=============================================================================
 Global References
@@ -187,14 +242,38 @@ extern MY_STATUS_RECORD My_Status;
 Prototypes
 =============================================================================*/
 
+extern void
+My_Config_Set_Defaults( MY_CONFIG_RECORD *pConfig );
+
+extern UINT8
+My_Config_Validate( MY_CONFIG_RECORD  *pConfig );
+
 extern UINT8
 My_Config_Save( MY_CONFIG_RECORD  *pConfig );
 
+extern UINT8
+My_Config_Load( MY_CONFIG_RECORD  *pConfig );
+
 extern void
 My_Config_Initialise(void);
 
+extern UINT8
+My_State_Save( BOOL Relay_Status );
+
+extern UINT8
+My_State_Load( BOOL *pRelay_Status );
+
+extern void
+My_Status_Write_Begin( void );
+
 extern void
-Wifi_Initialise( void );
+My_Status_Write_End( void );
+
+extern UINT32
+My_Status_Read( MY_STATUS_RECORD *pStatus );
+
+extern UINT32
+My_Status_Version( void );
 
 extern void
 GPIO_Initialise( void );
@@ -202,6 +281,9 @@ GPIO_Initialise( void );
 extern void
 SR04_Initialise( void );
 
+extern FLOAT
+SR04_Echo_To_Distance( UINT32 Duration_us );
+
 extern FLOAT
 SR04_Get_Distance( void );
 
@@ -0,0 +1,232 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   fixed_format.cpp
+@brief  Fixed decimal number formatting without floating point
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Formats a FLOAT as "%.<n>f" does, byte for byte, but with integer math only
+and straight into the caller's buffer, no soft-float and no heap.
+
+A float is exactly Mantissa * 2^Exponent, with a 24 bit mantissa. Times
+10^Decimals it still fits 64 bits, so the scaled value is exact, and it is
+rounded to an integer the way printf does it: to nearest, ties to even.
+Numbers too large for that, NaN and infinity go through snprintf().
+
+Pure logic, it builds on the host as well, see tools/fixed_format_check.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "fixed_format.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define FLOAT_MANTISSA_BITS   23
+#define FLOAT_EXPONENT_BIAS   (127 + FLOAT_MANTISSA_BITS)
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static const UINT32 Fixed_Pow10[FIXED_FORMAT_MAX_DECIMALS + 1] =
+{
+  1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static UINT8  Fixed_Format_Digits( CHAR *pDigits, UINT64 Value );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Decimal digits of Value in reverse order, returns how many */
+static UINT8
+Fixed_Format_Digits( CHAR *pDigits, UINT64 Value )
+{
+  UINT8   Count = 0;
+  UINT32  Low;
+
+  /* 64 bit division is slow, go 32 bit as soon as it fits */
+  while ( Value > 0xFFFFFFFFull )
+  {
+    pDigits[Count++] = '0' + (CHAR)(Value % 10);
+    Value /= 10;
+  }
+
+  Low = (UINT32)Value;
+  do
+  {
+    pDigits[Count++] = '0' + (CHAR)(Low % 10);
+    Low /= 10;
+  } while ( Low > 0 );
+
+  return Count;
+}
+
+/*===========================================================================*/
+
+/*!
+Format a number with a fixed count of decimals, as snprintf( "%.*f" ).
+
+@param  pBuff     Buffer, (O)
+@param  Size      Buffer size, FIXED_FORMAT_MAX_SIZE holds anything, (I)
+@param  Value     Number, (I)
+@param  Decimals  Digits after the point, (I)
+@return The length, without the terminator. If it doesn't fit the output
+        is cut, as snprintf() would
+*/
+UINT8
+Fixed_Format( CHAR *pBuff, UINT8 Size, FLOAT Value, UINT8 Decimals )
+{
+  uint32_t  Bits;           /* The float's bits, UINT32 is wider on a 64 bit host */
+  UINT32  Mantissa;
+  INT32   Exponent;
+  UINT64  Scaled;
+  UINT64  Int;
+  UINT64  Rest;
+  UINT64  Half;
+  CHAR    Digits[24];
+  UINT8   Count;
+  UINT8   Len = 0;
+  INT32   Ret;
+
+  if ( Size == 0 )
+  {
+    return 0;
+  }
+
+  memcpy( &Bits, &Value, sizeof(Bits) );
+  Mantissa = Bits & ((1UL << FLOAT_MANTISSA_BITS) - 1);
+  Exponent = (Bits >> FLOAT_MANTISSA_BITS) & 0xFF;
+
+  /* NaN, infinity and too many decimals */
+  if ( (Exponent == 0xFF) || (Decimals > FIXED_FORMAT_MAX_DECIMALS) )
+  {
+    Ret = snprintf( pBuff, Size, "%.*f", (int)Decimals, Value );
+    return ( Ret < 0 ) ? 0 : ( (Ret < Size) ? Ret : (Size - 1) );
+  }
+
+  /* Value = Mantissa * 2^Exponent, denormals have no implicit bit */
+  if ( Exponent == 0 )
+  {
+    Exponent = 1;
+  }
+  else
+  {
+    Mantissa |= 1UL << FLOAT_MANTISSA_BITS;
+  }
+  Exponent -= FLOAT_EXPONENT_BIAS;
+
+  /* Scaled by 10^Decimals, exact in 64 bits: 24 + 20 bits */
+  Scaled = (UINT64)Mantissa * Fixed_Pow10[Decimals];
+
+  if ( Exponent >= 0 )
+  {
+    /* Over 2^63 is far out of any range here */
+    if ( (Exponent > 19) || ((Scaled >> (63 - Exponent)) != 0) )
+    {
+      Ret = snprintf( pBuff, Size, "%.*f", (int)Decimals, Value );
+      return ( Ret < 0 ) ? 0 : ( (Ret < Size) ? Ret : (Size - 1) );
+    }
+    Int = Scaled << Exponent;
+  }
+  else if ( Exponent > -64 )
+  {
+    /* Round to nearest, ties to even */
+    Int  = Scaled >> -Exponent;
+    Rest = Scaled & ((1ULL << -Exponent) - 1);
+    Half = 1ULL << (-Exponent - 1);
+    if ( (Rest > Half) || ((Rest == Half) && (Int & 1)) )
+    {
+      Int++;
+    }
+  }
+  else
+  {
+    /* Below 2^-40, that's 0 for any count of decimals here */
+    Int = 0;
+  }
+
+  /* Digits of the integer, with zeros up to one before the point */
+  Count = Fixed_Format_Digits( Digits, Int );
+  while ( Count <= Decimals )
+  {
+    Digits[Count++] = '0';
+  }
+
+  /* Sign, -0.0 included as printf does */
+  if ( (Bits & 0x80000000UL) && (Len < (Size - 1)) )
+  {
+    pBuff[Len++] = '-';
+  }
+
+  while ( (Count > 0) && (Len < (Size - 1)) )
+  {
+    if ( (Count == Decimals) && (Decimals > 0) )
+    {
+      pBuff[Len++] = '.';
+      if ( Len == (Size - 1) )
+      {
+        break;
+      }
+    }
+    pBuff[Len++] = Digits[--Count];
+  }
+  pBuff[Len] = 0;
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+/* Format an unsigned integer, as snprintf( "%lu" ) */
+UINT8
+Fixed_Format_U32( CHAR *pBuff, UINT8 Size, UINT32 Value )
+{
+  CHAR    Digits[12];
+  UINT8   Count;
+  UINT8   Len = 0;
+
+  if ( Size == 0 )
+  {
+    return 0;
+  }
+
+  Count = Fixed_Format_Digits( Digits, Value );
+  while ( (Count > 0) && (Len < (Size - 1)) )
+  {
+    pBuff[Len++] = Digits[--Count];
+  }
+  pBuff[Len] = 0;
+
+  return Len;
+}
+
+/*===========================================================================*/
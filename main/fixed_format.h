@@ -0,0 +1,53 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   fixed_format.h
+@brief  Fixed decimal number formatting without floating point, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __FIXED_FORMAT_H__
+#define __FIXED_FORMAT_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Most decimals taken by the integer path, more go through snprintf() */
+#define FIXED_FORMAT_MAX_DECIMALS   6
+
+/* Buffer size that holds any float with up to FIXED_FORMAT_MAX_DECIMALS */
+#define FIXED_FORMAT_MAX_SIZE       48
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern UINT8
+Fixed_Format( CHAR *pBuff, UINT8 Size, FLOAT Value, UINT8 Decimals );
+
+extern UINT8
+Fixed_Format_U32( CHAR *pBuff, UINT8 Size, UINT32 Value );
+
+#endif  /* __FIXED_FORMAT_H__ */
+
+/*===========================================================================*/
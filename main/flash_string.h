@@ -0,0 +1,80 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   flash_string.h
+@brief  Constant strings and string tables kept in flash
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+On ESP8266 every string literal is copied into DRAM at boot unless it is
+declared PROGMEM, and a PROGMEM string must not be read byte by byte
+through a plain pointer. This header is the one way the modules do it:
+
+  Single strings   static const CHAR Html_Index[] PROGMEM = "...";
+                   String += FPSTR(Html_Index);
+
+  Inline literals  F("...") where a String is taken, PSTR("...") where a
+                   PGM_P goes to a *_P function or mqtt_publish(). LOG()
+                   does this by itself
+
+  String tables    static const CHAR Names[][WIDTH] PROGMEM = { "a", "b" };
+                   FLASH_STRING_TABLE_GET(Names, Index, "?")
+
+A table is a 2D array rather than an array of pointers, so it takes one
+declaration and the pointers don't end up in DRAM.
+*/
+
+#ifndef __FLASH_STRING_H__
+#define __FLASH_STRING_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define FLASH_STRING_TABLE_SIZE( Table )  ( sizeof(Table)/sizeof((Table)[0]) )
+
+/* Entry of a flash string table as a flash string, pDefault when out of range */
+#define FLASH_STRING_TABLE_GET( Table, Index, pDefault ) \
+  ( ((size_t)(Index) < FLASH_STRING_TABLE_SIZE(Table)) ? FPSTR((Table)[Index]) : F(pDefault) )
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+/* Copy a flash string into a RAM buffer, always terminated */
+static inline UINT16
+Flash_String_Copy( CHAR *pBuff, UINT16 Size, const CHAR *pFlash )
+{
+  if ( Size == 0 )
+  {
+    return 0;
+  }
+
+  strncpy_P( pBuff, pFlash, Size - 1 );
+  pBuff[Size - 1] = 0;
+
+  return strlen( pBuff );
+}
+
+#endif  /* __FLASH_STRING_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,445 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   history.cpp
+@brief  History of the distance, relay and link in flash
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A sample a minute, once the clock is set: the average distance, the relay
+and the RSSI. They go into the block of history_block.cpp in RAM, which is
+copied into the RTC memory with each one, so a reset goes on with it and
+only a power loss loses it, an hour or two at most.
+
+A full block is appended to the newest file on LittleFS. A file takes
+HISTORY_FILE_BLOCKS, then the next one is started, "/history/00000002"
+and so on, and once there are HISTORY_FILES_MAX the oldest is removed.
+A block is written each hour or two, the flash doesn't mind.
+
+/api/history?from=&to=&step= reads the blocks one at a time through
+History_Range_Read(), a file that ends before the range by the last block
+in it, and streams a row per step:
+
+  {"from":1790812800,"to":1790899200,"step":60,
+   "columns":["ts","distance_cm","relay","rssi"],"rows":[
+  [1790812800,123.4,0,-67],
+  [1790812860,null,0,-68]]}
+
+The flash needs a file system, e.g. "4MB (FS:2MB OTA:~1019KB)" in the
+Flash Size of the board settings.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <ESP8266WiFi.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "history.h"
+#include "local_clock.h"
+#include "wifi_manager.h"
+#include "watchdog.h"
+#include "metrics.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* "/history/" and 8 digits */
+#define HISTORY_PATH_MAX_SIZE     24
+
+/* Longest row of the JSON */
+#define HISTORY_ROW_MAX_SIZE      48
+
+typedef enum
+{
+  HISTORY_RANGE_HEADER = 0,
+  HISTORY_RANGE_ROWS,
+  HISTORY_RANGE_DONE
+
+} HISTORY_RANGE_STATE;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static BOOL                   History_Mounted   = FALSE;
+
+/* The block samples are appended to, also in the RTC memory */
+static HISTORY_BLOCK_RECORD   History_Block;
+static HISTORY_ENCODER_RECORD History_Encoder;
+
+/* The oldest file and the one blocks are appended to */
+static UINT32                 History_First_Seq = 1;
+static UINT32                 History_Last_Seq  = 1;
+
+/* Step of the last sample, one a step */
+static UINT32                 History_Last_Step = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void History_Path( UINT32 Seq, CHAR *pPath );
+static void History_Store_Block( void );
+static BOOL History_File_Before( File &Blocks, UINT32 From, HISTORY_BLOCK_RECORD *pBlock );
+static BOOL History_Next_Block( void *pContext, HISTORY_BLOCK_RECORD *pBlock );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+History_Path( UINT32 Seq, CHAR *pPath )
+{
+  snprintf_P( pPath, HISTORY_PATH_MAX_SIZE, PSTR(HISTORY_DIR "/%08lu"), Seq );
+}
+
+/*===========================================================================*/
+
+/* Append the full block to the newest file, start the next file when it is full */
+static void
+History_Store_Block( void )
+{
+  CHAR  Path[HISTORY_PATH_MAX_SIZE];
+  File  Blocks;
+
+  if ( !History_Mounted )
+  {
+    Metric_Inc( METRIC_HISTORY_WRITE_FAILED );
+    return;
+  }
+
+  History_Path( History_Last_Seq, Path );
+  Blocks = LittleFS.open( Path, "a" );
+  if ( Blocks && (Blocks.size() >= (HISTORY_FILE_BLOCKS * HISTORY_BLOCK_SIZE)) )
+  {
+    Blocks.close();
+    History_Last_Seq++;
+
+    if ( (History_Last_Seq - History_First_Seq) >= HISTORY_FILES_MAX )
+    {
+      History_Path( History_First_Seq, Path );
+      LittleFS.remove( Path );
+      History_First_Seq++;
+    }
+
+    History_Path( History_Last_Seq, Path );
+    Blocks = LittleFS.open( Path, "a" );
+  }
+
+  if ( !Blocks || (Blocks.write( (const uint8_t *)&History_Block, sizeof(History_Block) ) != sizeof(History_Block)) )
+  {
+    LOG( DBG_E, "History: Write %s failed.\n", Path );
+    Metric_Inc( METRIC_HISTORY_WRITE_FAILED );
+  }
+  else
+  {
+    Metric_Inc( METRIC_HISTORY_BLOCKS );
+  }
+
+  if ( Blocks )
+  {
+    Blocks.close();
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+Mount the file system, find the files and go on with the block in the RTC
+memory, at the end of setup().
+
+@param  None
+@return None
+*/
+void
+History_Initialise( void )
+{
+  Dir     Files;
+  UINT32  Seq;
+  UINT32  First = 0;
+  UINT32  Last  = 0;
+
+  History_Mounted = LittleFS.begin();
+  if ( !History_Mounted )
+  {
+    LOG( DBG_E, "History: No file system, only the last block is kept.\n" );
+  }
+  else
+  {
+    Files = LittleFS.openDir( HISTORY_DIR );
+    while ( Files.next() )
+    {
+      Seq = strtoul( Files.fileName().c_str(), NULL, 10 );
+      if ( Seq == 0 )
+      {
+        continue;
+      }
+      First = ( (First == 0) || (Seq < First) ) ? Seq : First;
+      Last  = ( Seq > Last ) ? Seq : Last;
+    }
+    History_First_Seq = ( First == 0 ) ? 1 : First;
+    History_Last_Seq  = ( Last == 0 ) ? 1 : Last;
+  }
+
+  /* Not after power on, the RTC memory is random then */
+  ESP.rtcUserMemoryRead( RTC_HISTORY_OFFSET, (uint32_t *)&History_Block, sizeof(History_Block) );
+  if ( (ESP.getResetInfoPtr()->reason == REASON_DEFAULT_RST) ||
+       !History_Block_Resume( &History_Encoder, &History_Block ) )
+  {
+    History_Block_Begin( &History_Encoder, &History_Block );
+  }
+  History_Last_Step = ( History_Block.count > 0 ) ? (History_Block.last_ts / HISTORY_STEP_S) : 0;
+
+  LOG( DBG_P, "History: Files %lu to %lu, %u samples in RAM.\n",
+       History_First_Seq, History_Last_Seq, History_Block.count );
+}
+
+/*===========================================================================*/
+
+/* Take a sample each HISTORY_STEP_S, to call at each loop() */
+void
+History_Handle( void )
+{
+  MY_STATUS_RECORD      Status;
+  HISTORY_SAMPLE_RECORD Sample;
+  UINT32                Now_s;
+  FLOAT                 Distance_mm;
+  INT32                 Rssi;
+
+  if ( !Local_Clock_Is_Valid() )
+  {
+    return;
+  }
+
+  Now_s = Local_Clock_Now_s();
+  if ( (Now_s / HISTORY_STEP_S) == History_Last_Step )
+  {
+    return;
+  }
+  History_Last_Step = Now_s / HISTORY_STEP_S;
+
+  /* The clock was set back, wait until it is past the last sample */
+  if ( (History_Block.count > 0) && (Now_s <= History_Encoder.last.ts) )
+  {
+    return;
+  }
+
+  My_Status_Read( &Status );
+
+  memset( &Sample, 0, sizeof(Sample) );
+  Sample.ts = Now_s;
+  if ( Status.distance_valid && (Status.avg_distance_cm > 0) )
+  {
+    Distance_mm         = Status.avg_distance_cm * 10 + 0.5f;
+    Sample.distance_mm  = ( Distance_mm >= 65535 ) ? 65535 : (UINT16)Distance_mm;
+  }
+  Rssi          = Wifi_Is_Connected() ? WiFi.RSSI() : 0;
+  Sample.rssi   = ( (Rssi < 0) && (Rssi >= -128) ) ? (INT8)Rssi : 0;
+  Sample.relay  = Status.relay_status;
+
+  if ( !History_Block_Append( &History_Encoder, &Sample ) )
+  {
+    History_Store_Block();
+    History_Block_Begin( &History_Encoder, &History_Block );
+    History_Block_Append( &History_Encoder, &Sample );
+  }
+
+  ESP.rtcUserMemoryWrite( RTC_HISTORY_OFFSET, (uint32_t *)&History_Block, sizeof(History_Block) );
+}
+
+/*===========================================================================*/
+
+/* The file ends before From, by its last block. Else it is back at its start */
+static BOOL
+History_File_Before( File &Blocks, UINT32 From, HISTORY_BLOCK_RECORD *pBlock )
+{
+  size_t  Size = Blocks.size();
+
+  if ( (Size >= HISTORY_BLOCK_SIZE) &&
+       Blocks.seek( Size - (Size % HISTORY_BLOCK_SIZE) - HISTORY_BLOCK_SIZE ) &&
+       (Blocks.read( (uint8_t *)pBlock, HISTORY_BLOCK_SIZE ) == HISTORY_BLOCK_SIZE) &&
+       History_Block_Is_Valid( pBlock ) && (pBlock->last_ts < From) )
+  {
+    return TRUE;
+  }
+
+  Blocks.seek( 0 );
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/* The blocks of a range, from the files, then the one in RAM */
+static BOOL
+History_Next_Block( void *pContext, HISTORY_BLOCK_RECORD *pBlock )
+{
+  HISTORY_RANGE_RECORD  *pRange = (HISTORY_RANGE_RECORD *)pContext;
+  CHAR                  Path[HISTORY_PATH_MAX_SIZE];
+
+  Watchdog_Heartbeat();
+
+  while ( History_Mounted && (pRange->seq <= History_Last_Seq) )
+  {
+    if ( !pRange->file )
+    {
+      History_Path( pRange->seq, Path );
+      pRange->file = LittleFS.open( Path, "r" );
+      if ( pRange->file && History_File_Before( pRange->file, pRange->query.from, pBlock ) )
+      {
+        pRange->file.close();
+      }
+    }
+
+    if ( pRange->file && (pRange->file.read( (uint8_t *)pBlock, HISTORY_BLOCK_SIZE ) == HISTORY_BLOCK_SIZE) )
+    {
+      return TRUE;
+    }
+
+    if ( pRange->file )
+    {
+      pRange->file.close();
+    }
+    pRange->seq++;
+  }
+
+  if ( !pRange->current_done )
+  {
+    pRange->current_done = TRUE;
+    if ( History_Block.count > 0 )
+    {
+      *pBlock = History_Block;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/*!
+Start reading a range, History_Range_End() when not read to the end.
+
+@param  pRange  (O)
+@param  From    UTC, s, (I)
+@param  To      UTC, s, (I)
+@param  Step    s, made longer for HISTORY_ROWS_MAX at most, (I)
+@return None
+*/
+void
+History_Range_Begin( HISTORY_RANGE_RECORD *pRange, UINT32 From, UINT32 To, UINT32 Step )
+{
+  UINT32  Min_Step;
+
+  To        = ( To < From ) ? From : To;
+  Step      = ( Step < HISTORY_STEP_S ) ? HISTORY_STEP_S : Step;
+  Min_Step  = (To - From) / HISTORY_ROWS_MAX + 1;
+  if ( Step < Min_Step )
+  {
+    Step = ((Min_Step + HISTORY_STEP_S - 1) / HISTORY_STEP_S) * HISTORY_STEP_S;
+  }
+
+  pRange->file          = File();
+  pRange->seq           = History_First_Seq;
+  pRange->current_done  = FALSE;
+  pRange->state         = HISTORY_RANGE_HEADER;
+  pRange->rows          = 0;
+
+  History_Query_Begin( &pRange->query, From, To, Step, History_Next_Block, pRange );
+}
+
+/*===========================================================================*/
+
+/*!
+The next piece of the JSON, as many rows as fit.
+
+@param  pRange  (I/O)
+@param  pBuff   NUL terminated text, (O)
+@param  Size    Size of pBuff, HISTORY_LINE_MAX_SIZE at least, (I)
+@return Its length, 0 once all was given
+*/
+UINT16
+History_Range_Read( HISTORY_RANGE_RECORD *pRange, CHAR *pBuff, UINT16 Size )
+{
+  HISTORY_ROW_RECORD  Row;
+  CHAR                Distance[8];
+  CHAR                Rssi[8];
+  UINT16              Len = 0;
+
+  pBuff[0] = 0;
+
+  if ( pRange->state == HISTORY_RANGE_HEADER )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len,
+                       PSTR("{\"from\":%lu,\"to\":%lu,\"step\":%lu,"
+                            "\"columns\":[\"ts\",\"distance_cm\",\"relay\",\"rssi\"],\"rows\":["),
+                       pRange->query.from, pRange->query.to, pRange->query.step );
+    pRange->state = HISTORY_RANGE_ROWS;
+  }
+
+  while ( (pRange->state == HISTORY_RANGE_ROWS) && ((Size - Len) >= HISTORY_ROW_MAX_SIZE) )
+  {
+    if ( !History_Query_Next( &pRange->query, &Row ) )
+    {
+      Len += snprintf_P( pBuff + Len, Size - Len, PSTR("]}\n") );
+      pRange->state = HISTORY_RANGE_DONE;
+      History_Range_End( pRange );
+      break;
+    }
+
+    if ( Row.distance_mm != 0 )
+    {
+      snprintf_P( Distance, sizeof(Distance), PSTR("%u.%u"), Row.distance_mm / 10, Row.distance_mm % 10 );
+    }
+    else
+    {
+      strcpy_P( Distance, PSTR("null") );
+    }
+    if ( Row.rssi != 0 )
+    {
+      snprintf_P( Rssi, sizeof(Rssi), PSTR("%d"), Row.rssi );
+    }
+    else
+    {
+      strcpy_P( Rssi, PSTR("null") );
+    }
+
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%s\n[%lu,%s,%u,%s]"),
+                       (pRange->rows > 0) ? "," : "", Row.ts, Distance, Row.relay ? 1 : 0, Rssi );
+    pRange->rows++;
+  }
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+/* Close what a range has open */
+void
+History_Range_End( HISTORY_RANGE_RECORD *pRange )
+{
+  if ( pRange->file )
+  {
+    pRange->file.close();
+  }
+}
+
+/*===========================================================================*/
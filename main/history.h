@@ -0,0 +1,84 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   history.h
+@brief  History of the distance, relay and link in flash, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __HISTORY_H__
+#define __HISTORY_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <FS.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "history_block.h"
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Files of HISTORY_FILE_BLOCKS kept, the oldest goes when one more is
+   needed. 24 of 8 KB hold some 12 weeks of a tank level */
+#define HISTORY_FILES_MAX         24
+#define HISTORY_DIR               "/history"
+
+/* Range of /api/history unless given, and the most rows, a longer range
+   is given in longer steps */
+#define HISTORY_RANGE_S           86400
+#define HISTORY_ROWS_MAX          10080
+
+/* Longest piece of the JSON, the header */
+#define HISTORY_LINE_MAX_SIZE     192
+
+/* A range being read, the blocks one at a time */
+typedef struct
+{
+  HISTORY_QUERY_RECORD  query;
+  File                  file;
+  UINT32                seq;              /* Of the file */
+  BOOL                  current_done;     /* The block in RAM, after the files */
+  UINT8                 state;
+  UINT32                rows;
+
+} HISTORY_RANGE_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+History_Initialise( void );
+
+extern void
+History_Handle( void );
+
+extern void
+History_Range_Begin( HISTORY_RANGE_RECORD *pRange, UINT32 From, UINT32 To, UINT32 Step );
+
+extern UINT16
+History_Range_Read( HISTORY_RANGE_RECORD *pRange, CHAR *pBuff, UINT16 Size );
+
+extern void
+History_Range_End( HISTORY_RANGE_RECORD *pRange );
+
+#endif  /* __HISTORY_H__ */
+
+/*===========================================================================*/
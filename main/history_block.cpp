@@ -0,0 +1,645 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   history_block.cpp
+@brief  Compressed blocks of the distance, relay and link history
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A sample a minute of a level that changes slowly is mostly the same
+interval, a distance a few mm off the last one, the relay as it was and
+the RSSI a dB or two away, about 2 bytes with the codes in
+history_block.h instead of the 8 of the sample.
+
+Appending checks first how many bits the sample takes, a sample that
+doesn't fit is refused and leaves the block as it was, the caller stores
+the block and begins the next one. The check is updated with each sample,
+so a block is valid as it is whenever it is copied.
+
+  History_Block_Begin( &Encoder, &Block );
+  if ( !History_Block_Append( &Encoder, &Sample ) )
+  {
+    store Block, History_Block_Begin() and append it again
+  }
+
+  History_Decoder_Init( &Decoder, &Block );
+  while ( History_Decoder_Next( &Decoder, &Sample ) )
+  {
+  }
+
+The decoder stops at the bits and the count in the block, a broken block
+gives fewer samples, never reads outside it.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "history_block.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define HISTORY_BLOCK_MAGIC       0x48495354    /* 'HIST' */
+
+#define HISTORY_DATA_BITS         (HISTORY_BLOCK_DATA_SIZE * 8)
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static uint32_t History_Zigzag( int32_t Value );
+static int32_t  History_Unzigzag( uint32_t Value );
+static void   History_Put_Bits( UINT8 *pData, UINT16 *pBit, UINT32 Value, UINT8 Count );
+static BOOL   History_Get_Bits( HISTORY_DECODER_RECORD *pDecoder, UINT8 Count, UINT32 *pValue );
+static UINT16 History_Encode( const HISTORY_ENCODER_RECORD *pEncoder, const HISTORY_SAMPLE_RECORD *pSample,
+                              UINT8 *pData, UINT16 Bit );
+static uint32_t History_Block_Check( const HISTORY_BLOCK_RECORD *pBlock );
+static BOOL   History_Query_Sample( HISTORY_QUERY_RECORD *pQuery, HISTORY_SAMPLE_RECORD *pSample );
+static void   History_Query_Add( HISTORY_QUERY_RECORD *pQuery, UINT32 Start, const HISTORY_SAMPLE_RECORD *pSample );
+static void   History_Query_Row( HISTORY_QUERY_RECORD *pQuery, HISTORY_ROW_RECORD *pRow );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static uint32_t
+History_Zigzag( int32_t Value )
+{
+  return ( (uint32_t)Value << 1 ) ^ (uint32_t)( Value >> 31 );
+}
+
+/*===========================================================================*/
+
+static int32_t
+History_Unzigzag( uint32_t Value )
+{
+  return (int32_t)( Value >> 1 ) ^ -(int32_t)( Value & 1 );
+}
+
+/*===========================================================================*/
+
+/* Count bits of Value at *pBit, the first one the highest, only counted if pData is NULL */
+static void
+History_Put_Bits( UINT8 *pData, UINT16 *pBit, UINT32 Value, UINT8 Count )
+{
+  UINT8   Index;
+
+  if ( pData != NULL )
+  {
+    for ( Index = Count; Index > 0; Index-- )
+    {
+      if ( (Value >> (Index - 1)) & 1 )
+      {
+        pData[(*pBit + Count - Index) >> 3] |= 0x80 >> ((*pBit + Count - Index) & 7);
+      }
+    }
+  }
+
+  *pBit += Count;
+}
+
+/*===========================================================================*/
+
+static BOOL
+History_Get_Bits( HISTORY_DECODER_RECORD *pDecoder, UINT8 Count, UINT32 *pValue )
+{
+  UINT32  Value = 0;
+  UINT16  Bit   = pDecoder->bit;
+  UINT8   Index;
+
+  /* The bits may be broken as well */
+  if ( (((UINT32)Bit + Count) > pDecoder->pBlock->bits) || (((UINT32)Bit + Count) > HISTORY_DATA_BITS) )
+  {
+    return FALSE;
+  }
+
+  for ( Index = 0; Index < Count; Index++, Bit++ )
+  {
+    Value = (Value << 1) | ((pDecoder->pBlock->data[Bit >> 3] >> (7 - (Bit & 7))) & 1);
+  }
+
+  pDecoder->bit = Bit;
+  *pValue       = Value;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The codes of a sample from Bit on, only counted if pData is NULL. Returns the bit after */
+static UINT16
+History_Encode( const HISTORY_ENCODER_RECORD *pEncoder, const HISTORY_SAMPLE_RECORD *pSample,
+                UINT8 *pData, UINT16 Bit )
+{
+  const HISTORY_SAMPLE_RECORD *pLast = &pEncoder->last;
+  uint32_t  Interval;
+  INT64     Change;
+
+  /* The first timestamp is in the header */
+  if ( pEncoder->pBlock->count > 0 )
+  {
+    Interval = (uint32_t)(pSample->ts - pLast->ts);
+    Change   = (INT64)Interval - (INT64)pEncoder->last_interval;
+    if ( Change == 0 )
+    {
+      History_Put_Bits( pData, &Bit, 0x0, 1 );
+    }
+    else if ( (Change >= -64) && (Change <= 63) )
+    {
+      History_Put_Bits( pData, &Bit, 0x2, 2 );
+      History_Put_Bits( pData, &Bit, History_Zigzag( (INT32)Change ), 7 );
+    }
+    else if ( (Change >= -2048) && (Change <= 2047) )
+    {
+      History_Put_Bits( pData, &Bit, 0x6, 3 );
+      History_Put_Bits( pData, &Bit, History_Zigzag( (INT32)Change ), 12 );
+    }
+    else
+    {
+      History_Put_Bits( pData, &Bit, 0x7, 3 );
+      History_Put_Bits( pData, &Bit, Interval, 32 );
+    }
+  }
+
+  Change = (INT32)pSample->distance_mm - (INT32)pLast->distance_mm;
+  if ( Change == 0 )
+  {
+    History_Put_Bits( pData, &Bit, 0x0, 1 );
+  }
+  else if ( (Change >= -16) && (Change <= 15) )
+  {
+    History_Put_Bits( pData, &Bit, 0x2, 2 );
+    History_Put_Bits( pData, &Bit, History_Zigzag( (INT32)Change ), 5 );
+  }
+  else if ( (Change >= -256) && (Change <= 255) )
+  {
+    History_Put_Bits( pData, &Bit, 0x6, 3 );
+    History_Put_Bits( pData, &Bit, History_Zigzag( (INT32)Change ), 9 );
+  }
+  else
+  {
+    History_Put_Bits( pData, &Bit, 0x7, 3 );
+    History_Put_Bits( pData, &Bit, pSample->distance_mm, 16 );
+  }
+
+  History_Put_Bits( pData, &Bit, (pSample->relay != pLast->relay) ? 1 : 0, 1 );
+
+  Change = (INT32)pSample->rssi - (INT32)pLast->rssi;
+  if ( Change == 0 )
+  {
+    History_Put_Bits( pData, &Bit, 0x0, 1 );
+  }
+  else if ( (Change >= -4) && (Change <= 3) )
+  {
+    History_Put_Bits( pData, &Bit, 0x2, 2 );
+    History_Put_Bits( pData, &Bit, History_Zigzag( (INT32)Change ), 3 );
+  }
+  else
+  {
+    History_Put_Bits( pData, &Bit, 0x3, 2 );
+    History_Put_Bits( pData, &Bit, (UINT8)pSample->rssi, 8 );
+  }
+
+  return Bit;
+}
+
+/*===========================================================================*/
+
+static uint32_t
+History_Block_Check( const HISTORY_BLOCK_RECORD *pBlock )
+{
+  uint32_t  Check = HISTORY_BLOCK_MAGIC;
+  UINT16    Index;
+
+  Check = ((Check << 1) | (Check >> 31)) + pBlock->first_ts;
+  Check = ((Check << 1) | (Check >> 31)) + pBlock->last_ts;
+  Check = ((Check << 1) | (Check >> 31)) + (((uint32_t)pBlock->count << 16) | pBlock->bits);
+  for ( Index = 0; Index < HISTORY_BLOCK_DATA_SIZE; Index++ )
+  {
+    Check = ((Check << 1) | (Check >> 31)) + pBlock->data[Index];
+  }
+
+  return Check;
+}
+
+/*===========================================================================*/
+
+/* An empty block to append to */
+void
+History_Block_Begin( HISTORY_ENCODER_RECORD *pEncoder, HISTORY_BLOCK_RECORD *pBlock )
+{
+  memset( pBlock, 0, sizeof(HISTORY_BLOCK_RECORD) );
+  pBlock->check = History_Block_Check( pBlock );
+
+  memset( pEncoder, 0, sizeof(HISTORY_ENCODER_RECORD) );
+  pEncoder->pBlock        = pBlock;
+  pEncoder->last_interval = HISTORY_STEP_S;
+}
+
+/*===========================================================================*/
+
+/*!
+Go on appending to a block that was stored, as from the RTC memory.
+
+@param  pEncoder  (O)
+@param  pBlock    The block, (I/O)
+@return FALSE if it isn't valid, begin a new one
+*/
+BOOL
+History_Block_Resume( HISTORY_ENCODER_RECORD *pEncoder, HISTORY_BLOCK_RECORD *pBlock )
+{
+  HISTORY_DECODER_RECORD  Decoder;
+  HISTORY_SAMPLE_RECORD   Sample;
+
+  if ( !History_Block_Is_Valid( pBlock ) )
+  {
+    return FALSE;
+  }
+
+  History_Decoder_Init( &Decoder, pBlock );
+  while ( History_Decoder_Next( &Decoder, &Sample ) )
+  {
+  }
+  if ( (Decoder.index != pBlock->count) || (Decoder.bit != pBlock->bits) )
+  {
+    return FALSE;
+  }
+
+  pEncoder->pBlock        = pBlock;
+  pEncoder->last          = Decoder.last;
+  pEncoder->last_interval = Decoder.last_interval;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+Append a sample, it must be later than the last one.
+
+@param  pEncoder  (I/O)
+@param  pSample   (I)
+@return FALSE if it doesn't fit or isn't later, the block is as it was
+*/
+BOOL
+History_Block_Append( HISTORY_ENCODER_RECORD *pEncoder, const HISTORY_SAMPLE_RECORD *pSample )
+{
+  HISTORY_BLOCK_RECORD  *pBlock = pEncoder->pBlock;
+  UINT16                End;
+
+  if ( (pBlock->count > 0) && (pSample->ts <= pEncoder->last.ts) )
+  {
+    return FALSE;
+  }
+
+  if ( (pBlock->count == 0xFFFF) ||
+       (History_Encode( pEncoder, pSample, NULL, pBlock->bits ) > HISTORY_DATA_BITS) )
+  {
+    return FALSE;
+  }
+
+  End = History_Encode( pEncoder, pSample, pBlock->data, pBlock->bits );
+
+  if ( pBlock->count == 0 )
+  {
+    pBlock->first_ts = pSample->ts;
+  }
+  else
+  {
+    pEncoder->last_interval = pSample->ts - pEncoder->last.ts;
+  }
+  pBlock->last_ts = pSample->ts;
+  pBlock->count++;
+  pBlock->bits    = End;
+  pBlock->check   = History_Block_Check( pBlock );
+
+  pEncoder->last  = *pSample;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The check matches and the counts are possible */
+BOOL
+History_Block_Is_Valid( const HISTORY_BLOCK_RECORD *pBlock )
+{
+  return ( pBlock->bits <= HISTORY_DATA_BITS ) &&
+         ( pBlock->last_ts >= pBlock->first_ts ) &&
+         ( pBlock->check == History_Block_Check( pBlock ) );
+}
+
+/*===========================================================================*/
+
+void
+History_Decoder_Init( HISTORY_DECODER_RECORD *pDecoder, const HISTORY_BLOCK_RECORD *pBlock )
+{
+  memset( pDecoder, 0, sizeof(HISTORY_DECODER_RECORD) );
+  pDecoder->pBlock        = pBlock;
+  pDecoder->last_interval = HISTORY_STEP_S;
+}
+
+/*===========================================================================*/
+
+/*!
+The next sample of the block.
+
+@param  pDecoder  (I/O)
+@param  pSample   (O)
+@return FALSE at the end, or where the block is broken
+*/
+BOOL
+History_Decoder_Next( HISTORY_DECODER_RECORD *pDecoder, HISTORY_SAMPLE_RECORD *pSample )
+{
+  HISTORY_SAMPLE_RECORD Sample;
+  UINT32                Code;
+  UINT32                Value;
+
+  if ( pDecoder->index >= pDecoder->pBlock->count )
+  {
+    return FALSE;
+  }
+
+  Sample = pDecoder->last;
+
+  if ( pDecoder->index == 0 )
+  {
+    Sample.ts = pDecoder->pBlock->first_ts;
+  }
+  else
+  {
+    if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+    {
+      return FALSE;
+    }
+    if ( Code == 1 )
+    {
+      if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+      {
+        return FALSE;
+      }
+      if ( Code == 0 )
+      {
+        if ( !History_Get_Bits( pDecoder, 7, &Value ) )
+        {
+          return FALSE;
+        }
+        pDecoder->last_interval += History_Unzigzag( Value );
+      }
+      else
+      {
+        if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+        {
+          return FALSE;
+        }
+        if ( !History_Get_Bits( pDecoder, (Code == 0) ? 12 : 32, &Value ) )
+        {
+          return FALSE;
+        }
+        pDecoder->last_interval = (Code == 0) ? (pDecoder->last_interval + History_Unzigzag( Value )) : Value;
+      }
+    }
+    Sample.ts += pDecoder->last_interval;
+  }
+
+  /* Distance */
+  if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+  {
+    return FALSE;
+  }
+  if ( Code == 1 )
+  {
+    if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+    {
+      return FALSE;
+    }
+    if ( Code == 0 )
+    {
+      if ( !History_Get_Bits( pDecoder, 5, &Value ) )
+      {
+        return FALSE;
+      }
+      Sample.distance_mm += History_Unzigzag( Value );
+    }
+    else
+    {
+      if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+      {
+        return FALSE;
+      }
+      if ( !History_Get_Bits( pDecoder, (Code == 0) ? 9 : 16, &Value ) )
+      {
+        return FALSE;
+      }
+      Sample.distance_mm = (Code == 0) ? (Sample.distance_mm + History_Unzigzag( Value )) : Value;
+    }
+  }
+
+  /* Relay */
+  if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+  {
+    return FALSE;
+  }
+  Sample.relay = ( Code == 1 ) ? !Sample.relay : Sample.relay;
+
+  /* RSSI */
+  if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+  {
+    return FALSE;
+  }
+  if ( Code == 1 )
+  {
+    if ( !History_Get_Bits( pDecoder, 1, &Code ) )
+    {
+      return FALSE;
+    }
+    if ( !History_Get_Bits( pDecoder, (Code == 0) ? 3 : 8, &Value ) )
+    {
+      return FALSE;
+    }
+    Sample.rssi = (Code == 0) ? (INT8)(Sample.rssi + History_Unzigzag( Value )) : (INT8)Value;
+  }
+
+  pDecoder->last = Sample;
+  pDecoder->index++;
+  *pSample = Sample;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+A query of the samples From to To, in rows of Step seconds.
+
+@param  pQuery        (O)
+@param  From          UTC, s, the first row starts there, (I)
+@param  To            UTC, s, the last sample, (I)
+@param  Step          s, HISTORY_STEP_S at least, (I)
+@param  pNext_Block   Gives the blocks, oldest first, (I)
+@param  pContext      For pNext_Block, (I)
+@return None
+*/
+void
+History_Query_Begin( HISTORY_QUERY_RECORD *pQuery, UINT32 From, UINT32 To, UINT32 Step,
+                     HISTORY_BLOCK_FUNC pNext_Block, void *pContext )
+{
+  memset( pQuery, 0, sizeof(HISTORY_QUERY_RECORD) );
+  pQuery->from        = From;
+  pQuery->to          = To;
+  pQuery->step        = ( Step < HISTORY_STEP_S ) ? HISTORY_STEP_S : Step;
+  pQuery->pNext_Block = pNext_Block;
+  pQuery->pContext    = pContext;
+
+  /* An empty block to start from */
+  History_Decoder_Init( &pQuery->decoder, &pQuery->block );
+}
+
+/*===========================================================================*/
+
+/* The next sample in the range, the blocks before it are skipped by their header */
+static BOOL
+History_Query_Sample( HISTORY_QUERY_RECORD *pQuery, HISTORY_SAMPLE_RECORD *pSample )
+{
+  while ( !pQuery->done )
+  {
+    if ( History_Decoder_Next( &pQuery->decoder, pSample ) )
+    {
+      if ( pSample->ts < pQuery->from )
+      {
+        continue;
+      }
+      if ( pSample->ts > pQuery->to )
+      {
+        break;
+      }
+      return TRUE;
+    }
+
+    if ( !pQuery->pNext_Block( pQuery->pContext, &pQuery->block ) )
+    {
+      break;
+    }
+    if ( !History_Block_Is_Valid( &pQuery->block ) )
+    {
+      pQuery->bad_blocks++;
+      pQuery->block.count = 0;
+    }
+    else if ( pQuery->block.last_ts < pQuery->from )
+    {
+      pQuery->block.count = 0;
+    }
+    else if ( pQuery->block.first_ts > pQuery->to )
+    {
+      break;
+    }
+    History_Decoder_Init( &pQuery->decoder, &pQuery->block );
+  }
+
+  pQuery->done = TRUE;
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/* Add a sample to the step from Start */
+static void
+History_Query_Add( HISTORY_QUERY_RECORD *pQuery, UINT32 Start, const HISTORY_SAMPLE_RECORD *pSample )
+{
+  pQuery->row.ts      = Start;
+  pQuery->row.relay   = pQuery->row.relay || pSample->relay;
+  pQuery->row.samples++;
+  if ( pSample->distance_mm != 0 )
+  {
+    pQuery->distance_sum += pSample->distance_mm;
+    pQuery->distance_count++;
+  }
+  if ( pSample->rssi != 0 )
+  {
+    pQuery->rssi_sum += pSample->rssi;
+    pQuery->rssi_count++;
+  }
+}
+
+/*===========================================================================*/
+
+/* The step added up so far, and start the next */
+static void
+History_Query_Row( HISTORY_QUERY_RECORD *pQuery, HISTORY_ROW_RECORD *pRow )
+{
+  *pRow = pQuery->row;
+  if ( pQuery->distance_count > 0 )
+  {
+    pRow->distance_mm = (UINT16)( (pQuery->distance_sum + pQuery->distance_count / 2) / pQuery->distance_count );
+  }
+  if ( pQuery->rssi_count > 0 )
+  {
+    pRow->rssi = (INT8)( (pQuery->rssi_sum - (INT32)pQuery->rssi_count / 2) / (INT32)pQuery->rssi_count );
+  }
+
+  memset( &pQuery->row, 0, sizeof(pQuery->row) );
+  pQuery->distance_sum    = 0;
+  pQuery->distance_count  = 0;
+  pQuery->rssi_sum        = 0;
+  pQuery->rssi_count      = 0;
+}
+
+/*===========================================================================*/
+
+/*!
+The next row, a step with samples. Steps without any are left out.
+
+@param  pQuery  (I/O)
+@param  pRow    (O)
+@return FALSE after the last one
+*/
+BOOL
+History_Query_Next( HISTORY_QUERY_RECORD *pQuery, HISTORY_ROW_RECORD *pRow )
+{
+  HISTORY_SAMPLE_RECORD Sample;
+  UINT32                Start;
+
+  while ( History_Query_Sample( pQuery, &Sample ) )
+  {
+    Start = pQuery->from + ((Sample.ts - pQuery->from) / pQuery->step) * pQuery->step;
+    if ( (pQuery->row.samples > 0) && (Start != pQuery->row.ts) )
+    {
+      History_Query_Row( pQuery, pRow );
+      History_Query_Add( pQuery, Start, &Sample );
+      return TRUE;
+    }
+    History_Query_Add( pQuery, Start, &Sample );
+  }
+
+  if ( pQuery->row.samples > 0 )
+  {
+    History_Query_Row( pQuery, pRow );
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*===========================================================================*/
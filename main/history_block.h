@@ -0,0 +1,184 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   history_block.h
+@brief  Compressed blocks of the distance, relay and link history
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Plain C on a block in memory, without Arduino calls, so the host tools
+build it. history.cpp keeps the blocks in flash.
+
+A block is HISTORY_BLOCK_SIZE bytes and decodes on its own. The samples
+are a bit stream, each one against the one before in the block, the first
+against zeros and a HISTORY_STEP_S interval:
+
+  Timestamp     '0'                         same interval as before
+                '10'  + 7 bits zigzag       interval changed by -64..63 s
+                '110' + 12 bits zigzag      by -2048..2047 s
+                '111' + 32 bits             the interval itself
+  Distance, mm  '0'                         same as before
+                '10'  + 5 bits zigzag       changed by -16..15
+                '110' + 9 bits zigzag       by -256..255
+                '111' + 16 bits             the distance itself
+  Relay         '0' same, '1' switched
+  RSSI, dBm     '0'                         same as before
+                '10'  + 3 bits zigzag       changed by -4..3
+                '11'  + 8 bits              the RSSI itself
+
+A distance of 0 is no valid distance, an RSSI of 0 no link. The values are
+integers, so they are delta encoded, the XOR of Gorilla is for floats.
+
+A query goes over the blocks one at a time, in the order they were
+written, and gives a row per step of the range that has samples: the mean
+of the valid distances and of the RSSI, and whether the relay was on.
+*/
+
+#ifndef __HISTORY_BLOCK_H__
+#define __HISTORY_BLOCK_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define HISTORY_BLOCK_SIZE        128
+#define HISTORY_BLOCK_DATA_SIZE   (HISTORY_BLOCK_SIZE - 16)
+
+/* The interval the samples are taken at */
+#define HISTORY_STEP_S            60
+
+/* Blocks in a file of history.cpp, 8 KB as a block of LittleFS. A query
+   looks at the last one to skip a file */
+#define HISTORY_FILE_BLOCKS       64
+
+/* Most bits a sample takes */
+#define HISTORY_SAMPLE_MAX_BITS   65
+
+typedef struct
+{
+  UINT32    ts;               /* UTC, s */
+  UINT16    distance_mm;      /* 0 if not valid */
+  INT8      rssi;             /* dBm, 0 if not connected */
+  BOOL      relay;
+
+} HISTORY_SAMPLE_RECORD;
+
+/* As stored in flash, the same on the host */
+typedef struct
+{
+  uint32_t  first_ts;
+  uint32_t  last_ts;
+  uint16_t  count;            /* Samples */
+  uint16_t  bits;             /* Of data used */
+  uint32_t  check;            /* See History_Block_Is_Valid() */
+
+  uint8_t   data[HISTORY_BLOCK_DATA_SIZE];
+
+} HISTORY_BLOCK_RECORD;
+
+/* Appends to a block, the last sample is what the next one is against */
+typedef struct
+{
+  HISTORY_BLOCK_RECORD  *pBlock;
+  HISTORY_SAMPLE_RECORD last;
+  UINT32                last_interval;
+
+} HISTORY_ENCODER_RECORD;
+
+typedef struct
+{
+  const HISTORY_BLOCK_RECORD  *pBlock;
+  UINT16                index;          /* Of the next sample */
+  UINT16                bit;            /* Where it starts */
+  HISTORY_SAMPLE_RECORD last;
+  UINT32                last_interval;
+
+} HISTORY_DECODER_RECORD;
+
+/* Copies the next block into pBlock, FALSE after the last one */
+typedef BOOL (*HISTORY_BLOCK_FUNC)( void *pContext, HISTORY_BLOCK_RECORD *pBlock );
+
+typedef struct
+{
+  UINT32    ts;               /* Start of the step */
+  UINT16    distance_mm;      /* Mean, 0 if none was valid */
+  INT8      rssi;             /* Mean, 0 if not connected */
+  BOOL      relay;            /* On at any sample of the step */
+  UINT16    samples;
+
+} HISTORY_ROW_RECORD;
+
+typedef struct
+{
+  UINT32                  from;
+  UINT32                  to;
+  UINT32                  step;
+  HISTORY_BLOCK_FUNC      pNext_Block;
+  void                    *pContext;
+  HISTORY_BLOCK_RECORD    block;
+  HISTORY_DECODER_RECORD  decoder;
+  BOOL                    done;
+
+  /* The step being added up */
+  HISTORY_ROW_RECORD      row;
+  UINT32                  distance_sum;
+  UINT16                  distance_count;
+  INT32                   rssi_sum;
+  UINT16                  rssi_count;
+
+  /* Not valid and left out */
+  UINT16                  bad_blocks;
+
+} HISTORY_QUERY_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+History_Block_Begin( HISTORY_ENCODER_RECORD *pEncoder, HISTORY_BLOCK_RECORD *pBlock );
+
+extern BOOL
+History_Block_Resume( HISTORY_ENCODER_RECORD *pEncoder, HISTORY_BLOCK_RECORD *pBlock );
+
+extern BOOL
+History_Block_Append( HISTORY_ENCODER_RECORD *pEncoder, const HISTORY_SAMPLE_RECORD *pSample );
+
+extern BOOL
+History_Block_Is_Valid( const HISTORY_BLOCK_RECORD *pBlock );
+
+extern void
+History_Decoder_Init( HISTORY_DECODER_RECORD *pDecoder, const HISTORY_BLOCK_RECORD *pBlock );
+
+extern BOOL
+History_Decoder_Next( HISTORY_DECODER_RECORD *pDecoder, HISTORY_SAMPLE_RECORD *pSample );
+
+extern void
+History_Query_Begin( HISTORY_QUERY_RECORD *pQuery, UINT32 From, UINT32 To, UINT32 Step,
+                     HISTORY_BLOCK_FUNC pNext_Block, void *pContext );
+
+extern BOOL
+History_Query_Next( HISTORY_QUERY_RECORD *pQuery, HISTORY_ROW_RECORD *pRow );
+
+#endif  /* __HISTORY_BLOCK_H__ */
+
+/*===========================================================================*/
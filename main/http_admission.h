@@ -0,0 +1,122 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   http_admission.h
+@brief  Admission control of HTTP requests by cost class
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The web server runs inside loop(), every request it handles is time the
+relay, the sonar and MQTT don't get. Each path has a cost class, and each
+class a token bucket, shared by all clients, so a flood from anywhere can
+only take a bounded share of loop():
+
+  HTTP_COST_CHEAP       /metrics, unknown paths, no rendering
+  HTTP_COST_PAGE        A page rendered from what is at hand, the slow
+                        parts behind it (the Wi-Fi scan, the Internet
+                        check) are cached and done once for all
+  HTTP_COST_EXPENSIVE   Writes the config to flash and reconnects
+
+A request over the budget of its class is turned away at once with a 429
+and a Retry-After, before anything else is done for it.
+
+All inline and without Arduino calls, so tools/admission_check floods it
+on the host with the same limits.
+*/
+
+#ifndef __HTTP_ADMISSION_H__
+#define __HTTP_ADMISSION_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "token_bucket.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+typedef enum
+{
+  HTTP_COST_CHEAP = 0,
+  HTTP_COST_PAGE,
+  HTTP_COST_EXPENSIVE,
+
+  NUM_HTTP_COSTS
+
+} HTTP_COST;
+
+/* Steady rate and burst of each class, { interval_ms, burst } */
+#define HTTP_COST_LIMITS      \
+{                             \
+  {   100, 20 },              \
+  {   250,  8 },              \
+  { 10000,  2 },              \
+}
+
+typedef struct
+{
+  uint32_t  interval_ms;
+  uint8_t   burst;
+
+} HTTP_COST_LIMIT_RECORD;
+
+typedef struct
+{
+  TOKEN_BUCKET_RECORD bucket[NUM_HTTP_COSTS];
+
+} HTTP_ADMISSION_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+static inline void
+Http_Admission_Init( HTTP_ADMISSION_RECORD *pAdmission )
+{
+  static const HTTP_COST_LIMIT_RECORD Limits[NUM_HTTP_COSTS] = HTTP_COST_LIMITS;
+  uint8_t                             Cost;
+
+  for ( Cost = 0; Cost < NUM_HTTP_COSTS; Cost++ )
+  {
+    Token_Bucket_Init( &pAdmission->bucket[Cost], Limits[Cost].interval_ms, Limits[Cost].burst );
+  }
+}
+
+/*===========================================================================*/
+
+/* FALSE if the class is over budget, with the seconds to wait for the
+   Retry-After, rounded up */
+static inline BOOL
+Http_Admit( HTTP_ADMISSION_RECORD *pAdmission, HTTP_COST Cost, uint32_t Now_ms, uint32_t *pRetry_s )
+{
+  uint32_t  Retry_ms;
+
+  if ( Token_Bucket_Take( &pAdmission->bucket[Cost], Now_ms, &Retry_ms ) )
+  {
+    *pRetry_s = 0;
+    return TRUE;
+  }
+
+  *pRetry_s = (Retry_ms + 999) / 1000;
+
+  return FALSE;
+}
+
+#endif  /* __HTTP_ADMISSION_H__ */
+
+/*===========================================================================*/
@@ -25,13 +25,65 @@ Local Includes
 =============================================================================*/
 
 #include "http_server.h"
+#include "wifi_manager.h"
+#include "boot_profile.h"
+#include "trace.h"
+#include "relay_actuator.h"
+#include "metrics.h"
+#include "flash_string.h"
+#include "arena.h"
+#include "http_admission.h"
+#include "ota_update.h"
+#include "watchdog.h"
+#include "profiler.h"
+#include "history.h"
+#include "local_clock.h"
 #include "esp8266_global.h"
 
 /*=============================================================================
 Definitions
 =============================================================================*/
 
-#define HTML_INDEX ("\
+/* /metrics is sent in chunks of this size, each one holds a few lines */
+#define HTTP_METRICS_CHUNK_SIZE   512
+
+/* Reserved on top of a page for the values filled in, more is taken from the
+   request arena if needed */
+#define HTTP_RESPONSE_EXTRA_SIZE  256
+
+/* "s<My_Status version>", with the quotes */
+#define HTTP_ETAG_MAX_SIZE        16
+
+/* The Internet check of the index page is reused this long, and gives up
+   on DNS and connecting together after the timeout */
+#define HTTP_INTERNET_CHECK_TTL_MS      30000
+#define HTTP_INTERNET_CHECK_TIMEOUT_MS  1000
+#define HTTP_INTERNET_CHECK_HOST        "www.qq.com"
+
+/* The wifi page has no scan yet, the first one takes about 2 sec */
+#define HTTP_SCAN_RETRY_S         3
+
+/* A 404 echoes this many arguments, each one cut to this length */
+#define HTTP_NOT_FOUND_MAX_ARGS   8
+#define HTTP_NOT_FOUND_MAX_TEXT   32
+
+/* The answer to an update goes out before the restart */
+#define HTTP_UPDATE_RESTART_DELAY_MS  500
+
+/* Context of the wifi page */
+typedef struct
+{
+  const WIFI_SCAN_RECORD  *pResults;
+  INT8                    count;
+
+} HTTP_WIFI_PAGE_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/* Pages, kept in flash and copied into the response */
+static const CHAR Html_Index[] PROGMEM = "\
 <!DOCTYPE html>\
 <html>\
 <head><meta charset='utf-8'><title>ESP8266</title></head>\
@@ -44,17 +96,17 @@ Definitions
 <tr><td>当前IP:</td><td>{{ current_ip }}</td></tr>\
 <tr><td>Internet状态:</td><td>{{ internet_status }}</td></tr>\
 <tr><td>SSID:</td><td>{{ current_ssid }}</td></tr>\
-<tr><td>看门狗(目前无效):</td><td>{{ wdt_status }}</td></tr>\
+<tr><td>看门狗:</td><td>{{ wdt_status }}</td></tr>\
 <tr><td>原始距离(cm):</td><td>{{ raw_distance }}</td></tr>\
 </table><br><br>\
 <form action='wifi' method='get'><input type='submit' value='WIFI配置页面'></form><br>\
-<form action='control' method='get'><input type='submit' value='状态和看门狗设置'></form>\
+<form action='control' method='get'><input type='submit' value='状态和看门狗设置'></form><br>\
+<form action='update' method='get'><input type='submit' value='固件升级'></form>\
 </body>\
 </html>\
-")
+";
 
-
-#define HTML_WIFI ("\
+static const CHAR Html_Wifi[] PROGMEM = "\
 <!DOCTYPE html>\
 <html>\
 <head><meta charset='utf-8'><title>ESP8266 Wifi设置</title></head>\
@@ -67,13 +119,18 @@ WIFI名称: <select name=\"ssid\">\
 {{ ssid_datalist }}\
 </select><br><br>\
 WIFI密码: <input type='password' name=\"pwd\"><br><br>\
+优先级(0-9): <input type='number' name=\"priority\" min='0' max='9' value='0'><br><br>\
 <input type='submit' value='提交'>\
-</form>\
+</form><br>\
+<table border='3'>\
+<tr><th>已保存的WIFI</th><th>优先级</th></tr>\
+{{ saved_list }}\
+</table>\
 </body>\
 </html>\
-")
+";
 
-#define HTML_CONTROL ("\
+static const CHAR Html_Control[] PROGMEM = "\
 <!DOCTYPE html>\
 <html>\
 <head><meta charset='utf-8'><title>ESP8266 设置和状态控制</title></head>\
@@ -83,7 +140,7 @@ WIFI密码: <input type='password' name=\"pwd\"><br><br>\
 <form action='control' method='get'><input type='submit' value='刷新'></form><br>\
 <form action='control' method='post'>\
 <!-- input type='hidden' name='wdt_enable' value='false' --> <!-- 此处为隐藏域，POST时会显示，不能用!!! -->\
-看门狗: <input type='checkbox' name=\"wdt_enable\" value=\"true\" {{ wdt_check_status }}>(目前无效)<br><br>\
+看门狗: <input type='checkbox' name=\"wdt_enable\" value=\"true\" {{ wdt_check_status }}><br><br>\
 <!-- input type='hidden' name='relay' value='false' --> <!-- 不能用!!! -->\
 继电器: <input type='checkbox' name=\"relay\" value=\"true\" {{ relay_check_status }}><br><br>\
 红色灯: <input type='checkbox' name=\"led_red\" value=\"true\" {{ led_red_status }}><br><br>\
@@ -91,11 +148,24 @@ WIFI密码: <input type='password' name=\"pwd\"><br><br>\
 <input type='submit' value='提交'></form>\
 </body>\
 </html>\
-")
+";
 
-/*=============================================================================
-Static Variables
-=============================================================================*/
+/* The MD5 goes before the file, so it is known when the file starts */
+static const CHAR Html_Update[] PROGMEM = "\
+<!DOCTYPE html>\
+<html>\
+<head><meta charset='utf-8'><title>ESP8266 固件升级</title></head>\
+<body>\
+<h1>ESP8266 固件升级</h1>\
+<form action='/' method='get'><input type='submit' value='主页'></form><br>\
+<form action='update' method='post' enctype='multipart/form-data'>\
+MD5(固件或gzip固件): <input type='text' name='md5' size='32'><br><br>\
+固件, gzip固件或差分包: <input type='file' name='image'><br><br>\
+<input type='submit' value='升级'>\
+</form>\
+</body>\
+</html>\
+";
 
 /* Current Wifi status string */
 //STAT_IDLE – no connection and no activity,
@@ -104,7 +174,7 @@ Static Variables
 //STAT_NO_AP_FOUND – failed because no access point replied,
 //STAT_CONNECT_FAIL – failed due to other problems,
 //STAT_GOT_IP – connection successfu
-const static String Wifi_Stutus_String[] =
+static const CHAR Wifi_Stutus_String[][24] PROGMEM =
 {
   "WIFI空闲",
   "WIFI连接失败",
@@ -121,6 +191,24 @@ const static String Wifi_Stutus_String[] =
 //  "WIFI已连接",
 };
 
+/* Token buckets of the cost classes */
+static HTTP_ADMISSION_RECORD  Http_Admission;
+
+/* The upload on /update, for the answer after it */
+static BOOL     Http_Update_Admitted    = FALSE;
+static UINT32   Http_Update_Retry_s     = 0;
+
+/* Last Internet check */
+static BOOL     Http_Internet_Checked   = FALSE;
+static BOOL     Http_Internet_Ok        = FALSE;
+static UINT32   Http_Internet_Check_ms  = 0;
+
+/* Request headers the handlers look at, the server drops all others */
+static const CHAR *Http_Collect_Headers[] =
+{
+  "If-None-Match",
+};
+
 /*=============================================================================
 Global Variables
 =============================================================================*/
@@ -132,77 +220,340 @@ ESP8266WebServer server(80);
 Static Prototypes
 =============================================================================*/
 
+static void http_send_page( int code, const CHAR *pContent_Type, const STR_BUILDER_RECORD *pPage );
+static void http_send_unknown_method( void );
+static BOOL http_admit( HTTP_COST Cost );
+static void http_send_unavailable( UINT32 Retry_s );
+static BOOL http_internet_check( void );
+static void http_send_index( void );
+static void http_watchdog_status( STR_BUILDER_RECORD *pSb );
+static void http_index_value( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext );
+static void http_wifi_value( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext );
+static void http_control_value( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext );
+static void handle_update_upload( void );
+
 /*=============================================================================
 Function Definitions
 =============================================================================*/
 
 /*===========================================================================*/
 
-void handle_index()
+/* Send a page built in the arena, without copying it into a String */
+static void
+http_send_page( int code, const CHAR *pContent_Type, const STR_BUILDER_RECORD *pPage )
+{
+  if ( pPage->overflow )
+  {
+    LOG( DBG_E, "HTTP: Page cut at %u bytes, the request arena is full.\n", pPage->len );
+  }
+
+  server.setContentLength( pPage->len );
+  server.send( code, pContent_Type, "" );
+  server.sendContent( pPage->pBuff, pPage->len );
+}
+
+/*===========================================================================*/
+
+/* The text of an unknown method */
+static void
+http_send_unknown_method( void )
+{
+  STR_BUILDER_RECORD  response_msg;
+
+  Str_Builder_Init( &response_msg, &Request_Arena, 8 );
+  Str_Builder_Printf( &response_msg, PSTR("%d"), (int)server.method() );
+  http_send_page( 200, "text/plain", &response_msg );
+
+  LOG( DBG_I, "Unknown request method: %s\n", response_msg.pBuff );
+}
+
+/*===========================================================================*/
+
+/* Take a token of the class, else turn the request away with a 429 */
+static BOOL
+http_admit( HTTP_COST Cost )
+{
+  uint32_t  retry_s;
+  CHAR      retry[12];
+
+  if ( Http_Admit( &Http_Admission, Cost, millis(), &retry_s ) )
+  {
+    return TRUE;
+  }
+
+  Metric_Inc( METRIC_HTTP_REJECTED );
+  LOG( DBG_I, "HTTP: %s over budget, retry in %lu s.\n", server.uri().c_str(), (UINT32)retry_s );
+
+  snprintf_P( retry, sizeof(retry), PSTR("%lu"), (UINT32)retry_s );
+  server.sendHeader( F("Retry-After"), retry );
+  server.send_P( 429, PSTR("text/plain"), PSTR("Too many requests\n") );
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/* The answer isn't ready yet, the browser reloads by itself */
+static void
+http_send_unavailable( UINT32 Retry_s )
+{
+  CHAR    retry[12];
+
+  Metric_Inc( METRIC_HTTP_UNAVAILABLE );
+
+  snprintf_P( retry, sizeof(retry), PSTR("%lu"), Retry_s );
+  server.sendHeader( F("Retry-After"), retry );
+  server.sendHeader( F("Refresh"), retry );
+  server.send_P( 503, PSTR("text/plain"), PSTR("Busy, try again in a few seconds\n") );
+}
+
+/*===========================================================================*/
+
+/* Connect out to see if there is Internet. Done once per
+   HTTP_INTERNET_CHECK_TTL_MS however many pages ask, and with a short timeout.
+   client.connect() by name would wait the full DNS timeout of lwIP, the
+   lookup takes its own and the connect what is left */
+static BOOL
+http_internet_check( void )
 {
-  String      response_msg;
   WiFiClient  client;
+  IPAddress   ip;
+  UINT32      start_ms;
+  UINT32      spent_ms;
 
-  /* Get the wifi status */
-  My_Status.current_wifi_status = WiFi.status();
-  strcpy( My_Status.current_sta_ssid, WiFi.SSID().c_str() );
-  strcpy( My_Status.current_sta_ip,   WiFi.localIP().toString().c_str() );
+  if ( !Wifi_Is_Connected() )
+  {
+    Http_Internet_Checked = FALSE;
+    return FALSE;
+  }
 
-  /* Check the Internet status */
-  if (!client.connect("www.qq.com", 80))
+  if ( Http_Internet_Checked && ((millis() - Http_Internet_Check_ms) < HTTP_INTERNET_CHECK_TTL_MS) )
   {
-    My_Status.internet_status = FALSE;
+    return Http_Internet_Ok;
   }
-  else
+
+  start_ms          = millis();
+  Http_Internet_Ok  = FALSE;
+  if ( WiFi.hostByName( HTTP_INTERNET_CHECK_HOST, ip, HTTP_INTERNET_CHECK_TIMEOUT_MS ) == 1 )
+  {
+    spent_ms = millis() - start_ms;
+    if ( spent_ms < HTTP_INTERNET_CHECK_TIMEOUT_MS )
+    {
+      client.setTimeout( HTTP_INTERNET_CHECK_TIMEOUT_MS - spent_ms );
+      Http_Internet_Ok = client.connect( ip, 80 );
+    }
+  }
+  if ( Http_Internet_Ok )
   {
-    My_Status.internet_status = TRUE;
     client.stop();
   }
 
-  /* Add the status into html body */
-  response_msg += HTML_INDEX;
-  response_msg.replace("{{ localtime_str }}", My_Status.local_time_str);
-  response_msg.replace("{{ wifi_status }}",   Wifi_Stutus_String[My_Status.current_wifi_status]);
-  response_msg.replace("{{ current_ssid }}",  My_Status.current_sta_ssid);
-  response_msg.replace("{{ current_ip }}",    My_Status.current_sta_ip);
+  Http_Internet_Checked   = TRUE;
+  Http_Internet_Check_ms  = millis();
+
+  return Http_Internet_Ok;
+}
+
+/*===========================================================================*/
+
+void handle_index()
+{
+  Metric_Inc( METRIC_HTTP_INDEX );
+
+  if ( http_admit( HTTP_COST_PAGE ) )
+  {
+    http_send_index();
+  }
+}
+
+/*===========================================================================*/
+
+/* The index page, or a 304 if the browser has it */
+static void
+http_send_index( void )
+{
+  STR_BUILDER_RECORD  response_msg;
+  UINT16              arena_mark = Arena_Mark( &Request_Arena );
+  MY_STATUS_RECORD    status;
+  UINT8               wifi_status;
+  CHAR                ssid[WIFI_SSID_STR_MAX_SIZE];
+  CHAR                ip[sizeof(My_Status.current_sta_ip)];
+  BOOL                internet_status;
+  CHAR                etag[HTTP_ETAG_MAX_SIZE];
+
+  /* Get the wifi status */
+  wifi_status = WiFi.status();
+  strncpy( ssid, WiFi.SSID().c_str(), sizeof(ssid) - 1 );
+  ssid[sizeof(ssid) - 1] = 0;
+  strncpy( ip, WiFi.localIP().toString().c_str(), sizeof(ip) - 1 );
+  ip[sizeof(ip) - 1] = 0;
 
-  if ( My_Status.internet_status == TRUE )
+  /* Check the Internet status */
+  internet_status = http_internet_check();
+
+  /* Only a change moves the version, so the ETag holds while nothing changes */
+  if ( (wifi_status != My_Status.current_wifi_status) || (internet_status != My_Status.internet_status) ||
+       (strcmp( ssid, My_Status.current_sta_ssid ) != 0) || (strcmp( ip, My_Status.current_sta_ip ) != 0) )
   {
-    response_msg.replace("{{ internet_status }}", "已连接外网");
+    My_Status_Write_Begin();
+    My_Status.current_wifi_status = wifi_status;
+    My_Status.internet_status     = internet_status;
+    strcpy( My_Status.current_sta_ssid, ssid );
+    strcpy( My_Status.current_sta_ip,   ip );
+    My_Status_Write_End();
   }
-  else
+
+  /* The browser has this version already */
+  snprintf_P( etag, sizeof(etag), PSTR("\"s%lu\""), My_Status_Read( &status ) );
+  server.sendHeader( F("ETag"), etag );
+  server.sendHeader( F("Cache-Control"), F("no-cache") );
+  if ( server.header( Http_Collect_Headers[0] ) == etag )
   {
-    response_msg.replace("{{ internet_status }}", "连接外网失败");
+    server.send( 304 );
+    Arena_Release( &Request_Arena, arena_mark );
+    return;
   }
 
-  if ( My_Status.distance_valid == TRUE )
+  /* Send the html body back */
+  Str_Builder_Init( &response_msg, &Request_Arena, sizeof(Html_Index) + HTTP_RESPONSE_EXTRA_SIZE );
+  http_render_index( &response_msg, &status );
+  http_send_page( 200, "text/html", &response_msg );
+
+  Arena_Release( &Request_Arena, arena_mark );
+}
+
+/*===========================================================================*/
+
+/* Watchdog on or off, the stalls since power on and the last one */
+static void
+http_watchdog_status( STR_BUILDER_RECORD *pSb )
+{
+  WATCHDOG_STALL_RECORD stall;
+
+  Str_Builder_Append_P( pSb, (My_Config.wdt_enable == TRUE) ? PSTR("开启") : PSTR("关闭(只计数)") );
+  Str_Builder_Printf( pSb, PSTR(", 超时%lu次"), Watchdog_Stalls() );
+
+  if ( Watchdog_Last_Stall( &stall ) )
+  {
+    Str_Builder_Printf( pSb, PSTR(", 上次: %S %lu ms%S"),
+                        (PGM_P)Watchdog_Task_Name( stall.task ), stall.ran_ms,
+                        stall.reset ? PSTR(" 已重启") : PSTR("") );
+  }
+}
+
+/*===========================================================================*/
+
+/* Values of the index page, pContext is a copy of My_Status */
+static void
+http_index_value( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext )
+{
+  const MY_STATUS_RECORD  *pStatus = (const MY_STATUS_RECORD *)pContext;
+
+  if ( strcmp_P( pKey, PSTR("localtime_str") ) == 0 )
+  {
+    Str_Builder_Append( pSb, pStatus->local_time_str );
+  }
+  else if ( strcmp_P( pKey, PSTR("wifi_status") ) == 0 )
+  {
+    Str_Builder_Append_P( pSb, (const CHAR *)FLASH_STRING_TABLE_GET(Wifi_Stutus_String, pStatus->current_wifi_status, "未知") );
+  }
+  else if ( strcmp_P( pKey, PSTR("current_ssid") ) == 0 )
+  {
+    Str_Builder_Append( pSb, pStatus->current_sta_ssid );
+  }
+  else if ( strcmp_P( pKey, PSTR("current_ip") ) == 0 )
+  {
+    Str_Builder_Append( pSb, pStatus->current_sta_ip );
+  }
+  else if ( strcmp_P( pKey, PSTR("internet_status") ) == 0 )
+  {
+    Str_Builder_Append_P( pSb, (pStatus->internet_status == TRUE) ? PSTR("已连接外网") : PSTR("连接外网失败") );
+  }
+  else if ( strcmp_P( pKey, PSTR("wdt_status") ) == 0 )
   {
-    response_msg.replace("{{ raw_distance }}",  String(My_Status.raw_distance_cm, 1) );
+    http_watchdog_status( pSb );
   }
-  else
+  else if ( strcmp_P( pKey, PSTR("raw_distance") ) == 0 )
   {
-    response_msg.replace("{{ raw_distance }}",  "无效");
+    if ( pStatus->distance_valid == TRUE )
+    {
+      Str_Builder_Append_Fixed( pSb, pStatus->raw_distance_cm, 1 );
+    }
+    else
+    {
+      Str_Builder_Append_P( pSb, PSTR("无效") );
+    }
   }
+}
 
-  /* Send the html body back */
-  server.send( 200, "text/html", response_msg );
+/*===========================================================================*/
+
+/* Fill the status into the index page, from a copy of My_Status */
+void http_render_index(STR_BUILDER_RECORD *pSb, const MY_STATUS_RECORD *pStatus)
+{
+  Str_Builder_Template_P( pSb, Html_Index, http_index_value, (void *)pStatus );
 }
 
 /*===========================================================================*/
 
-void handle_wifi()
+/* Values of the wifi page, pContext is a HTTP_WIFI_PAGE_RECORD */
+static void
+http_wifi_value( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext )
 {
-  String  response_msg;
+  const HTTP_WIFI_PAGE_RECORD *pPage = (const HTTP_WIFI_PAGE_RECORD *)pContext;
+  INT8                        index;
+
+  if ( strcmp_P( pKey, PSTR("ssid_datalist") ) == 0 )
+  {
+    for ( index = 0; index < pPage->count; index++ )
+    {
+      /* Ignore the empty ssid */
+      if ( pPage->pResults[index].ssid[0] == 0 )
+      {
+        continue;
+      }
 
-  String  ssid;
-  String  ssid_list;
-  int32_t rssi;
-  int32_t channel;
-  INT8    Scan_Result;
+      /* Using [\"] to replace ['] on important elements,
+         otherwise you may meet some unexpected troubles */
+      Str_Builder_Printf( pSb, PSTR("<option value=\"%s\">%s</option>\n"),
+                          pPage->pResults[index].ssid, pPage->pResults[index].ssid );
+    }
+  }
+  else if ( strcmp_P( pKey, PSTR("saved_list") ) == 0 )
+  {
+    /* The stored networks */
+    for ( index = 0; index < WIFI_STA_LIST_MAX_SIZE; index++ )
+    {
+      if ( My_Config.sta_list[index].valid )
+      {
+        Str_Builder_Printf( pSb, PSTR("<tr><td>%s</td><td>%u</td></tr>\n"),
+                            My_Config.sta_list[index].ssid, (unsigned)My_Config.sta_list[index].priority );
+      }
+    }
+  }
+}
+
+/*===========================================================================*/
+
+void handle_wifi()
+{
+  STR_BUILDER_RECORD  response_msg;
+  UINT16              arena_mark = Arena_Mark( &Request_Arena );
+  HTTP_WIFI_PAGE_RECORD page;
 
   String  new_ssid;
   String  new_psk;
-  UINT32  connect_start_timestamp_ms;
+  INT32   new_priority;
+  INT8    new_index;
+
+  Metric_Inc( METRIC_HTTP_WIFI );
+
+  /* Saving a network writes the flash and reconnects */
+  if ( !http_admit( (server.method() == HTTP_POST) ? HTTP_COST_EXPENSIVE : HTTP_COST_PAGE ) )
+  {
+    Arena_Release( &Request_Arena, arena_mark );
+    return;
+  }
 
   /*---------------------------------------------------------------------------*/
 
@@ -211,54 +562,18 @@ void handle_wifi()
     /* User wants the avaliable SSID list */
     case HTTP_GET:
 
-      LOG( DBG_N, "Starting WiFi scan..." );
-
-      /* Scan wifi first */
-      Scan_Result = WiFi.scanNetworks(/*async=*/false, /*hidden=*/true);
-      if (Scan_Result == 0)
-      {
-        LOG( DBG_W, "No networks found" );
-      }
-      else if (Scan_Result > 0)
-      {
-
-        Serial.printf(PSTR("%d networks found:\n"), Scan_Result);
-
-        // Print unsorted scan results
-        for (int8_t i = 0; i < Scan_Result; i++)
-        {
-          ssid    = WiFi.SSID(i);
-          rssi    = WiFi.RSSI(i);
-          channel = WiFi.channel(i);
-#if 0
-          WiFi.getNetworkInfo(i, ssid, encryptionType, rssi, bssid, channel, hidden);
-#endif
-          Serial.printf(PSTR(" %02d: [CH %02d] %ddBm %s\n"),
-                        i,
-                        channel,
-                        rssi,
-                        ssid.c_str());
-
-          /* Ignore the empty ssid */
-          if ( ssid != "")
-          {
-            /* Using [\"] to replace ['] on important elements,
-               otherwise you may meet some unexpected troubles */
-            ssid_list += "<option value=\""+ssid+"\">"+ssid+"</option>\n";
-          }
-        }
-      }
-      else
+      /* The last scan, shared with the Wifi manager, never wait for one */
+      page.count = Wifi_Page_Scan( &page.pResults );
+      if ( page.count < 0 )
       {
-        LOG( DBG_E, "WiFi scan error %d", Scan_Result);
+        http_send_unavailable( HTTP_SCAN_RETRY_S );
+        break;
       }
 
-      /* Add the ssid list into html body */
-      response_msg += HTML_WIFI;
-      response_msg.replace("{{ ssid_datalist }}", ssid_list);
-
-      /* Send the html body back */
-      server.send( 200, "text/html", response_msg );
+      /* Fill the ssid list into html body, and send it back */
+      Str_Builder_Init( &response_msg, &Request_Arena, sizeof(Html_Wifi) + HTTP_RESPONSE_EXTRA_SIZE );
+      Str_Builder_Template_P( &response_msg, Html_Wifi, http_wifi_value, &page );
+      http_send_page( 200, "text/html", &response_msg );
 
       break;
 
@@ -269,37 +584,18 @@ void handle_wifi()
 
       new_ssid  = server.arg("ssid");
       new_psk   = server.arg("pwd");
+      new_priority = server.arg("priority").toInt();
 
       LOG( DBG_I, "New ssid: %s\n", new_ssid.c_str() );
       LOG( DBG_I, "New psk: %s\n", new_psk.c_str() );
 
-      /* Try connect the new SSID first */
-      connect_start_timestamp_ms = millis();
-      WiFi.begin( new_ssid , new_psk );
-
-      /* Wait for connection */
-      while (WiFi.status() != WL_CONNECTED)
-      {
-        delay(500);
-        Serial.print(".");
-        /* Wait for 10 sec */
-        if ( (millis() - connect_start_timestamp_ms) > 10*1000 )
-        {
-          LOG( DBG_E, "Connect to %s timeout\n", new_ssid);
-          break;
-        }
-      }
-
-      /* Save the config if connect new SSID successfully */
-      if ( WiFi.status() == WL_CONNECTED )
-      {
-        strcpy( My_Config.sta_ssid,  new_ssid.c_str() );
-        strcpy( My_Config.sta_pwd,   new_psk.c_str() );
-        My_Config_Save(&My_Config);
-      }
+      /* Store it into the network list, and connect in background */
+      new_index = Wifi_Add_Network( new_ssid.c_str(), new_psk.c_str(),
+                                    (new_priority < 0) ? 0 : (UINT8)new_priority );
+      Wifi_Connect_Network( new_index );
 
       /* Amyway, send index html body back */
-      handle_index();
+      http_send_index();
 
       break;
 
@@ -307,23 +603,34 @@ void handle_wifi()
 
     default:
 
-      response_msg += server.method();
-      server.send( 200, "text/plain", response_msg );
-
-      LOG( DBG_I, "Unknown request method: %s\n", response_msg );
+      http_send_unknown_method();
       break;
   }
+
+  Arena_Release( &Request_Arena, arena_mark );
 }
 
 /*===========================================================================*/
 
 void handle_control()
 {
-  String  response_msg;
+  UINT32              received_us = micros();
+  STR_BUILDER_RECORD  response_msg;
+  UINT16              arena_mark = Arena_Mark( &Request_Arena );
+  MY_STATUS_RECORD    status;
 
   String  new_relay;
   String  new_led_green;
   String  new_led_red;
+  MY_CONFIG_RECORD  config;
+
+  Metric_Inc( METRIC_HTTP_CONTROL );
+
+  if ( !http_admit( HTTP_COST_PAGE ) )
+  {
+    Arena_Release( &Request_Arena, arena_mark );
+    return;
+  }
 
   /*---------------------------------------------------------------------------*/
 
@@ -336,21 +643,26 @@ void handle_control()
       new_led_green = server.arg("led_green");
       new_led_red   = server.arg("led_red");
 
+      /* The watchdog reset is a config, saved only if changed */
+      memcpy( &config, &My_Config, sizeof(MY_CONFIG_RECORD) );
+      config.wdt_enable = ( server.arg("wdt_enable") == "true" );
+      if ( memcmp( &config, &My_Config, sizeof(MY_CONFIG_RECORD) ) != 0 )
+      {
+        if ( My_Config_Save( &config ) == FN_RETURN_OK )
+        {
+          My_Config = config;
+        }
+      }
+
       LOG( DBG_I, "New relay: %s\n",      new_relay.c_str() );
       LOG( DBG_I, "New led_green: %s\n",  new_led_green.c_str() );
       LOG( DBG_I, "New led_red: %s\n",    new_led_red.c_str() );
 
       /* Update the status */
-      if ( new_relay == "true" )
-      {
-        My_Status.relay_status = TRUE;
-        digitalWrite(GPIO_RELAY, HIGH);
-      }
-      else
-      {
-        My_Status.relay_status = FALSE;
-        digitalWrite(GPIO_RELAY, LOW);
-      }
+      Trace_Command( "relay_status", (new_relay == "true") ? "on" : "off" );
+      Relay_Actuate( (new_relay == "true"), RELAY_SOURCE_HTTP, received_us );
+
+      My_Status_Write_Begin();
 
       if ( new_led_green == "true" )
       {
@@ -374,6 +686,8 @@ void handle_control()
         digitalWrite(GPIO_LED_RED, LOW);
       }
 
+      My_Status_Write_End();
+
       /* Return the control html page after all,
          So... Don't need break */
       //break;
@@ -383,70 +697,332 @@ void handle_control()
     /* User wants know the status of relay */
     case HTTP_GET:
 
-      /* Add the status into html body */
-      response_msg += HTML_CONTROL;
-      if ( My_Status.relay_status == TRUE )
-      {
-        response_msg.replace("{{ relay_check_status }}", "checked=\"true\"");
-      }
-      else
-      {
-        response_msg.replace("{{ relay_check_status }}", "");
-      }
+      /* Send the html body back */
+      My_Status_Read( &status );
+      Str_Builder_Init( &response_msg, &Request_Arena, sizeof(Html_Control) + HTTP_RESPONSE_EXTRA_SIZE );
+      http_render_control( &response_msg, &status );
+      http_send_page( 200, "text/html", &response_msg );
+
+      break;
+
+    /*---------------------------------------------------------------------------*/
+
+    default:
+
+      http_send_unknown_method();
+      break;
+  }
+
+  Arena_Release( &Request_Arena, arena_mark );
+}
+
+/*===========================================================================*/
+
+/* Values of the control page, the checkboxes, pContext is a copy of My_Status */
+static void
+http_control_value( STR_BUILDER_RECORD *pSb, const CHAR *pKey, void *pContext )
+{
+  const MY_STATUS_RECORD  *pStatus = (const MY_STATUS_RECORD *)pContext;
+  BOOL                    checked = FALSE;
+
+  if ( strcmp_P( pKey, PSTR("wdt_check_status") ) == 0 )
+  {
+    checked = My_Config.wdt_enable;
+  }
+  else if ( strcmp_P( pKey, PSTR("relay_check_status") ) == 0 )
+  {
+    checked = pStatus->relay_status;
+  }
+  else if ( strcmp_P( pKey, PSTR("led_green_status") ) == 0 )
+  {
+    checked = pStatus->led_green_status;
+  }
+  else if ( strcmp_P( pKey, PSTR("led_red_status") ) == 0 )
+  {
+    checked = pStatus->led_red_status;
+  }
+
+  if ( checked == TRUE )
+  {
+    Str_Builder_Append_P( pSb, PSTR("checked=\"true\"") );
+  }
+}
+
+/*===========================================================================*/
+
+/* Fill the status into the control page, from a copy of My_Status */
+void http_render_control(STR_BUILDER_RECORD *pSb, const MY_STATUS_RECORD *pStatus)
+{
+  Str_Builder_Template_P( pSb, Html_Control, http_control_value, (void *)pStatus );
+}
+
+/*===========================================================================*/
+
+/* Prometheus text exposition, streamed in chunks from a stack buffer */
+void handle_metrics()
+{
+  CHAR    buff[HTTP_METRICS_CHUNK_SIZE];
+  UINT16  len = 0;
+  UINT8   id;
+
+  Metric_Inc( METRIC_HTTP_METRICS );
+
+  if ( !http_admit( HTTP_COST_CHEAP ) )
+  {
+    return;
+  }
+
+  server.setContentLength( CONTENT_LENGTH_UNKNOWN );
+  server.send( 200, "text/plain; version=0.0.4", "" );
+
+  for ( id = 0; id < NUM_METRICS; id++ )
+  {
+    /* Flush when the next line may not fit */
+    if ( (sizeof(buff) - len) < METRICS_LINE_MAX_SIZE )
+    {
+      server.sendContent( buff, len );
+      len = 0;
+    }
+    len += Metrics_Format_Line( (METRIC_ID)id, &buff[len], sizeof(buff) - len );
+  }
+  server.sendContent( buff, len );
+
+  /* Terminate the chunked response */
+  server.sendContent( "" );
+}
+
+/*===========================================================================*/
+
+/* Each piece of the upload as it comes, straight on to the flash */
+static void
+handle_update_upload( void )
+{
+  HTTPUpload  &upload = server.upload();
+  uint32_t    retry_s;
+
+  switch ( upload.status )
+  {
+    case UPLOAD_FILE_START:
 
-      if ( My_Status.led_green_status == TRUE )
+      /* Checked before anything is written, the answer comes after the upload */
+      Http_Update_Admitted  = FALSE;
+      Http_Update_Retry_s   = 0;
+      if ( !server.authenticate( OTA_USER, OTA_PWD ) )
       {
-        response_msg.replace("{{ led_green_status }}", "checked=\"true\"");
+        break;
       }
-      else
+      if ( !Http_Admit( &Http_Admission, HTTP_COST_EXPENSIVE, millis(), &retry_s ) )
       {
-        response_msg.replace("{{ led_green_status }}", "");
+        Http_Update_Retry_s = retry_s;
+        break;
       }
 
-      if ( My_Status.led_red_status == TRUE )
+      Http_Update_Admitted = TRUE;
+      LOG( DBG_P, "OTA: Upload of %s.\n", upload.filename.c_str() );
+      Ota_Begin( server.arg("md5").c_str() );
+      break;
+
+    case UPLOAD_FILE_WRITE:
+
+      if ( Http_Update_Admitted )
       {
-        response_msg.replace("{{ led_red_status }}", "checked=\"true\"");
+        Ota_Write( upload.buf, upload.currentSize );
       }
-      else
+      break;
+
+    case UPLOAD_FILE_END:
+
+      if ( Http_Update_Admitted )
       {
-        response_msg.replace("{{ led_red_status }}", "");
+        Ota_End();
       }
+      break;
 
-      /* Send the html body back */
-      server.send( 200, "text/html", response_msg );
+    default:
 
+      Ota_Abort();
       break;
+  }
+}
 
-    /*---------------------------------------------------------------------------*/
+/*===========================================================================*/
 
-    default:
+/* The update page, and the answer once an upload is through */
+void handle_update()
+{
+  CHAR    retry[12];
 
-      response_msg += server.method();
-      server.send( 200, "text/plain", response_msg );
+  Metric_Inc( METRIC_HTTP_UPDATE );
 
-      LOG( DBG_I, "Unknown request method: %s\n", response_msg );
-      break;
+  if ( !server.authenticate( OTA_USER, OTA_PWD ) )
+  {
+    server.requestAuthentication();
+    return;
   }
+
+  if ( server.method() != HTTP_POST )
+  {
+    if ( http_admit( HTTP_COST_CHEAP ) )
+    {
+      server.send_P( 200, PSTR("text/html"), Html_Update );
+    }
+    return;
+  }
+
+  /* Turned away at the start of the upload */
+  if ( Http_Update_Retry_s > 0 )
+  {
+    Metric_Inc( METRIC_HTTP_REJECTED );
+    snprintf_P( retry, sizeof(retry), PSTR("%lu"), Http_Update_Retry_s );
+    server.sendHeader( F("Retry-After"), retry );
+    server.send_P( 429, PSTR("text/plain"), PSTR("Too many requests\n") );
+    Http_Update_Retry_s = 0;
+    return;
+  }
+
+  if ( !Http_Update_Admitted || (Ota_State() != OTA_STATE_READY) )
+  {
+    Http_Update_Admitted = FALSE;
+    server.send_P( 400, PSTR("text/plain"),
+                   (Ota_State() == OTA_STATE_FAILED) ? Ota_Error() : PSTR("no firmware uploaded") );
+    return;
+  }
+
+  server.send_P( 200, PSTR("text/plain"), PSTR("Updated, restarting\n") );
+
+  /* The boot loader copies the new image over this one on the way up */
+  delay( HTTP_UPDATE_RESTART_DELAY_MS );
+  ESP.restart();
+}
+
+/*===========================================================================*/
+
+/* The profiler, ?start=<Hz>&s=<s> starts it and ?stop stops it,
+   the profile is streamed as tools/profiler/profile_report.py reads it */
+void handle_profile()
+{
+  CHAR    buff[PROFILER_CHUNK_SIZE];
+  UINT16  cursor = 0;
+  UINT16  len;
+
+  Metric_Inc( METRIC_HTTP_PROFILE );
+
+  if ( !server.authenticate( OTA_USER, OTA_PWD ) )
+  {
+    server.requestAuthentication();
+    return;
+  }
+
+  if ( !http_admit( HTTP_COST_CHEAP ) )
+  {
+    return;
+  }
+
+  if ( server.hasArg("start") )
+  {
+    if ( !Profiler_Start( server.arg("start").toInt(), server.arg("s").toInt() ) )
+    {
+      server.send_P( 409, PSTR("text/plain"), PSTR("Running already\n") );
+      return;
+    }
+    server.send_P( 200, PSTR("text/plain"), PSTR("Started\n") );
+    return;
+  }
+
+  if ( server.hasArg("stop") )
+  {
+    Profiler_Stop();
+  }
+
+  server.setContentLength( CONTENT_LENGTH_UNKNOWN );
+  server.send( 200, "text/plain", "" );
+
+  while ( (len = Profiler_Format( &cursor, buff, sizeof(buff) )) > 0 )
+  {
+    server.sendContent( buff, len );
+  }
+
+  /* Terminate the chunked response */
+  server.sendContent( "" );
+}
+
+/*===========================================================================*/
+
+/* The history of ?from= to ?to=, UTC seconds, in rows of ?step= seconds,
+   streamed a block at a time. The last day a minute each if not given */
+void handle_history()
+{
+  HISTORY_RANGE_RECORD  range;
+  CHAR    buff[HTTP_METRICS_CHUNK_SIZE];
+  UINT32  from;
+  UINT32  to;
+  UINT32  step;
+  UINT16  len;
+
+  Metric_Inc( METRIC_HTTP_HISTORY );
+
+  if ( !http_admit( HTTP_COST_EXPENSIVE ) )
+  {
+    return;
+  }
+
+  to    = server.hasArg("to") ? strtoul( server.arg("to").c_str(), NULL, 10 ) : Local_Clock_Now_s();
+  from  = server.hasArg("from") ? strtoul( server.arg("from").c_str(), NULL, 10 ) :
+          ( (to > HISTORY_RANGE_S) ? (to - HISTORY_RANGE_S) : 0 );
+  step  = server.hasArg("step") ? strtoul( server.arg("step").c_str(), NULL, 10 ) : HISTORY_STEP_S;
+  if ( from > to )
+  {
+    server.send_P( 400, PSTR("text/plain"), PSTR("from is after to\n") );
+    return;
+  }
+
+  server.setContentLength( CONTENT_LENGTH_UNKNOWN );
+  server.send( 200, "application/json", "" );
+
+  History_Range_Begin( &range, from, to, step );
+  while ( (len = History_Range_Read( &range, buff, sizeof(buff) )) > 0 )
+  {
+    server.sendContent( buff, len );
+  }
+  History_Range_End( &range );
+
+  /* Terminate the chunked response */
+  server.sendContent( "" );
 }
 
 /*===========================================================================*/
 
 void handleNotFound()
 {
-  String message = "File Not Found\n\n";
-  message += "URI: ";
-  message += server.uri();
-  message += "\nMethod: ";
-  message += (server.method() == HTTP_GET) ? "GET" : "POST";
-  message += "\nArguments: ";
-  message += server.args();
-  message += "\n";
+  STR_BUILDER_RECORD  message;
+  UINT16              arena_mark = Arena_Mark( &Request_Arena );
+  int                 args = server.args();
 
-  for (uint8_t i = 0; i < server.args(); i++) {
-    message += " " + server.argName(i) + ": " + server.arg(i) + "\n";
+  Metric_Inc( METRIC_HTTP_NOT_FOUND );
+
+  if ( !http_admit( HTTP_COST_CHEAP ) )
+  {
+    return;
+  }
+
+  /* Bounded, however long the request */
+  Str_Builder_Init( &message, &Request_Arena, HTTP_RESPONSE_EXTRA_SIZE );
+  Str_Builder_Printf( &message, PSTR("File Not Found\n\nURI: %.64s\nMethod: %s\nArguments: %d\n"),
+                      server.uri().c_str(), (server.method() == HTTP_GET) ? "GET" : "POST", args );
+
+  for (int i = 0; (i < args) && (i < HTTP_NOT_FOUND_MAX_ARGS); i++) {
+    Str_Builder_Printf( &message, PSTR(" %.*s: %.*s\n"),
+                        HTTP_NOT_FOUND_MAX_TEXT, server.argName(i).c_str(),
+                        HTTP_NOT_FOUND_MAX_TEXT, server.arg(i).c_str() );
   }
+  if ( args > HTTP_NOT_FOUND_MAX_ARGS )
+  {
+    Str_Builder_Printf( &message, PSTR(" ... %d more\n"), args - HTTP_NOT_FOUND_MAX_ARGS );
+  }
+
+  http_send_page( 404, "text/plain", &message );
 
-  server.send(404, "text/plain", message);
+  Arena_Release( &Request_Arena, arena_mark );
 }
 
 /*===========================================================================*/
@@ -461,10 +1037,22 @@ void http_server_init(void)
   server.on("/", handle_index);
   server.on("/wifi", handle_wifi);
   server.on("/control", handle_control);
+  server.on("/metrics", handle_metrics);
+  server.on("/update", HTTP_GET, handle_update);
+  server.on("/update", HTTP_POST, handle_update, handle_update_upload);
+  server.on("/profile", handle_profile);
+  server.on("/api/history", handle_history);
   server.onNotFound(handleNotFound);
 
-  /* Start server */
+  Http_Admission_Init( &Http_Admission );
+
+  /* For the ETag of the index page */
+  server.collectHeaders( Http_Collect_Headers, sizeof(Http_Collect_Headers)/sizeof(Http_Collect_Headers[0]) );
+
+  /* Start server, it's listening on AP at once and on STA when connected */
+  Boot_Phase_Start( BOOT_PHASE_HTTP );
   server.begin();
+  Boot_Phase_Done( BOOT_PHASE_HTTP );
 
   LOG( DBG_P, "HTTP server Initialise Complete.\n" );
 }
@@ -18,10 +18,14 @@ Description:
 System Includes
 =============================================================================*/
 
+#include <Arduino.h>
+
 /*=============================================================================
 Local Includes
 =============================================================================*/
 
+#include "arena.h"
+
 /*=============================================================================
 Definitions
 =============================================================================*/
@@ -36,6 +40,8 @@ Prototypes
 
 extern void http_server_init(void);
 extern void http_handle_client(void);
+extern void http_render_index(STR_BUILDER_RECORD *pSb, const MY_STATUS_RECORD *pStatus);
+extern void http_render_control(STR_BUILDER_RECORD *pSb, const MY_STATUS_RECORD *pStatus);
 
 #endif  /* __HTTP_SERVER_H__ */
 
@@ -0,0 +1,804 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   local_clock.cpp
+@brief  Local clock anchored to the last NTP sync
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Time is the UTC of the last sync plus micros() elapsed since, corrected by
+the drift measured between syncs. micros() is extended to 64 bits here, so
+Local_Clock_Handle() must be called at least once per 71 minutes.
+
+Small sync offsets are slewed, the clock runs slightly faster or slower
+until the offset is absorbed, so it never jumps and a scheduled minute is
+never skipped or repeated. Only large offsets step the clock.
+
+The broken-down local time is kept incrementally, it's only updated when
+the minute rolls over. Calendar math is only done after a sync or a jump.
+
+The time zone is a POSIX TZ string, with or without DST rules. The offset
+in effect is kept with the UTC window it holds for, the next window is
+worked out when the clock leaves it, so at the two transitions a year.
+Springing forward the minutes roll over the hour skipped, falling back the
+clock jumps backward and the calendar is worked out again.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "local_clock.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define US_PER_S        1000000LL
+#define SECS_PER_DAY    86400L
+
+/* A DST start or end rule of a TZ string */
+typedef struct
+{
+  CHAR    type;       /* 'J' Julian day 1-365, 'D' day 0-365, 'M' month.week.day */
+  UINT16  day;        /* Day for 'J' and 'D', weekday 0-6 for 'M' */
+  UINT8   month;      /* 1-12 */
+  UINT8   week;       /* 1-5, 5 is the last */
+  INT32   time_s;     /* Local time of day it happens, may be out of 0-24 h */
+
+} LOCAL_CLOCK_RULE_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static BOOL   Clock_Valid = FALSE;
+
+/* 64 bits micros() */
+static UINT32 Clock_Last_Micros  = 0;
+static UINT64 Clock_Micros_High  = 0;
+
+/* Clock = Anchor_Utc_us + (Micros64 - Anchor_Local_us) corrected by drift,
+   plus the part of Slew_us absorbed so far */
+static UINT64 Anchor_Local_us    = 0;
+static INT64  Anchor_Utc_us      = 0;
+static INT32  Slew_us            = 0;
+
+/* The last sync used for drift measurement */
+static BOOL   Drift_Sync_Valid   = FALSE;
+static UINT64 Drift_Sync_Local_us = 0;
+static INT64  Drift_Sync_Utc_us   = 0;
+
+/* How fast micros() runs, parts per billion, positive is fast */
+static INT32  Drift_ppb          = 0;
+static BOOL   Drift_Valid        = FALSE;
+
+/* Local time = UTC + offset, standard and DST, the rules DST starts and ends by */
+static INT32  Tz_Std_Offset_s    = 8*3600;
+static INT32  Tz_Dst_Offset_s    = 8*3600;
+static BOOL   Tz_Has_Dst         = FALSE;
+static LOCAL_CLOCK_RULE_RECORD  Tz_Rules[2];
+
+/* The offset in effect and the UTC seconds it holds from and until,
+   an empty window until it is first worked out */
+static INT32  Tz_Offset_s        = 8*3600;
+static INT64  Tz_From_s          = 0;
+static INT64  Tz_Until_s         = 0;
+
+/* Broken-down local time of current minute, and local seconds at its start */
+static LOCAL_TIME_RECORD  Clock_Parts;
+static INT64              Minute_Start_s = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static UINT64 Local_Clock_Micros64( void );
+static INT64  Local_Clock_At( UINT64 Local_us );
+static INT64  Local_Clock_Local_s( void );
+static UINT8  Local_Clock_Days_In_Month( UINT16 Year, UINT8 Month );
+static INT64  Local_Clock_Days_From_Civil( INT64 Year, UINT8 Month, UINT8 Day );
+static INT64  Local_Clock_Rule_Day( INT64 Year, const LOCAL_CLOCK_RULE_RECORD *pRule );
+static void   Local_Clock_Tz_Update( INT64 Utc_s );
+static const CHAR *Local_Clock_Parse_Name( const CHAR *pTz );
+static const CHAR *Local_Clock_Parse_Time( const CHAR *pTz, INT32 *pSeconds );
+static const CHAR *Local_Clock_Parse_Rule( const CHAR *pTz, LOCAL_CLOCK_RULE_RECORD *pRule );
+static void   Local_Clock_Recompute( INT64 Local_s );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Extend micros() to 64 bits */
+static UINT64
+Local_Clock_Micros64( void )
+{
+  UINT32  Now = micros();
+
+  if ( Now < Clock_Last_Micros )
+  {
+    Clock_Micros_High += 0x100000000ULL;
+  }
+  Clock_Last_Micros = Now;
+
+  return Clock_Micros_High + Now;
+}
+
+/*===========================================================================*/
+
+/* UTC microseconds since 1970 at given 64 bits micros() */
+static INT64
+Local_Clock_At( UINT64 Local_us )
+{
+  INT64   Elapsed_us;
+  INT64   Slewed_us;
+
+  Elapsed_us = (INT64)(Local_us - Anchor_Local_us);
+
+  /* Remove the drift of micros() */
+  Elapsed_us -= Elapsed_us * Drift_ppb / 1000000000LL;
+
+  /* Absorb the offset at a limited rate */
+  Slewed_us = Elapsed_us * LOCAL_CLOCK_SLEW_RATE_PPM / 1000000LL;
+  if ( Slew_us >= 0 )
+  {
+    Slewed_us = ( Slewed_us < Slew_us ) ? Slewed_us : Slew_us;
+  }
+  else
+  {
+    Slewed_us = ( Slewed_us < -Slew_us ) ? -Slewed_us : Slew_us;
+  }
+
+  return Anchor_Utc_us + Elapsed_us + Slewed_us;
+}
+
+/*===========================================================================*/
+
+/* Local seconds since 1970 */
+static INT64
+Local_Clock_Local_s( void )
+{
+  INT64 Utc_us = Local_Clock_Now_us();
+  INT64 Utc_s;
+
+  /* Floor division, in case of time before 1970 */
+  Utc_s = (Utc_us >= 0) ? (Utc_us / US_PER_S) : ((Utc_us - US_PER_S + 1) / US_PER_S);
+
+  if ( (Utc_s < Tz_From_s) || (Utc_s >= Tz_Until_s) )
+  {
+    Local_Clock_Tz_Update( Utc_s );
+  }
+
+  return Utc_s + Tz_Offset_s;
+}
+
+/*===========================================================================*/
+
+static UINT8
+Local_Clock_Days_In_Month( UINT16 Year, UINT8 Month )
+{
+  static const UINT8 Days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+  if ( (Month == 2) && (((Year % 4) == 0) && (((Year % 100) != 0) || ((Year % 400) == 0))) )
+  {
+    return 29;
+  }
+
+  return Days[Month - 1];
+}
+
+/*===========================================================================*/
+
+/* Days since 1970 of a date, see http://howardhinnant.github.io/date_algorithms.html */
+static INT64
+Local_Clock_Days_From_Civil( INT64 Year, UINT8 Month, UINT8 Day )
+{
+  INT64   Era;
+  UINT32  Yoe, Doy, Doe;
+
+  Year -= ( Month <= 2 ) ? 1 : 0;
+  Era   = ( (Year >= 0) ? Year : (Year - 399) ) / 400;
+  Yoe   = (UINT32)(Year - Era * 400);
+  Doy   = (153*(Month + ((Month > 2) ? -3 : 9)) + 2)/5 + Day - 1;
+  Doe   = Yoe*365 + Yoe/4 - Yoe/100 + Doy;
+
+  return Era * 146097 + (INT64)Doe - 719468;
+}
+
+/*===========================================================================*/
+
+/* Days since 1970 of the day a rule falls on in a year */
+static INT64
+Local_Clock_Rule_Day( INT64 Year, const LOCAL_CLOCK_RULE_RECORD *pRule )
+{
+  INT64   First;
+  INT64   Day;
+  UINT8   Weekday;
+
+  if ( pRule->type == 'J' )
+  {
+    /* Feb 29 is never counted */
+    First = Local_Clock_Days_From_Civil( Year, 1, 1 );
+    return First + pRule->day - 1 + ( ((pRule->day >= 60) && (Local_Clock_Days_In_Month( (UINT16)Year, 2 ) == 29)) ? 1 : 0 );
+  }
+
+  if ( pRule->type == 'D' )
+  {
+    return Local_Clock_Days_From_Civil( Year, 1, 1 ) + pRule->day;
+  }
+
+  /* The week-th given weekday of the month, week 5 is the last one */
+  First   = Local_Clock_Days_From_Civil( Year, pRule->month, 1 );
+  Weekday = (UINT8)( ((First % 7) + 7 + 4) % 7 );
+  Day     = First + (pRule->day + 7 - Weekday) % 7 + (pRule->week - 1) * 7;
+  while ( Day >= First + Local_Clock_Days_In_Month( (UINT16)Year, pRule->month ) )
+  {
+    Day -= 7;
+  }
+
+  return Day;
+}
+
+/*===========================================================================*/
+
+/* Work out the offset in effect at a UTC time and the window it holds for,
+   from the transitions of the year before to the year after */
+static void
+Local_Clock_Tz_Update( INT64 Utc_s )
+{
+  INT64   Change_s[6];
+  INT32   Offset_s[6];
+  INT64   Year;
+  INT64   Swap_s;
+  INT32   Swap_Offset;
+  INT8    Count = 0;
+  INT8    i, j;
+
+  if ( !Tz_Has_Dst )
+  {
+    Tz_Offset_s = Tz_Std_Offset_s;
+    Tz_From_s   = INT64_MIN;
+    Tz_Until_s  = INT64_MAX;
+    return;
+  }
+
+  /* Close enough, a year either way is looked at too */
+  Year = 1970 + ( Utc_s / SECS_PER_DAY ) * 400 / 146097;
+
+  for ( Year = Year - 1, i = 0; i < 3; Year++, i++ )
+  {
+    /* The start is given in standard time, the end in DST */
+    Change_s[Count]   = Local_Clock_Rule_Day( Year, &Tz_Rules[0] ) * SECS_PER_DAY + Tz_Rules[0].time_s - Tz_Std_Offset_s;
+    Offset_s[Count++] = Tz_Dst_Offset_s;
+    Change_s[Count]   = Local_Clock_Rule_Day( Year, &Tz_Rules[1] ) * SECS_PER_DAY + Tz_Rules[1].time_s - Tz_Dst_Offset_s;
+    Offset_s[Count++] = Tz_Std_Offset_s;
+  }
+
+  /* In time order, the south has DST over the new year */
+  for ( i = 1; i < Count; i++ )
+  {
+    Swap_s      = Change_s[i];
+    Swap_Offset = Offset_s[i];
+    for ( j = i - 1; (j >= 0) && (Change_s[j] > Swap_s); j-- )
+    {
+      Change_s[j+1] = Change_s[j];
+      Offset_s[j+1] = Offset_s[j];
+    }
+    Change_s[j+1] = Swap_s;
+    Offset_s[j+1] = Swap_Offset;
+  }
+
+  for ( i = Count - 1; (i >= 0) && (Change_s[i] > Utc_s); i-- )
+  {
+  }
+
+  if ( i < 0 )
+  {
+    Tz_Offset_s = ( Offset_s[0] == Tz_Dst_Offset_s ) ? Tz_Std_Offset_s : Tz_Dst_Offset_s;
+    Tz_From_s   = INT64_MIN;
+    Tz_Until_s  = Change_s[0];
+  }
+  else
+  {
+    Tz_Offset_s = Offset_s[i];
+    Tz_From_s   = Change_s[i];
+    Tz_Until_s  = ( i < (Count - 1) ) ? Change_s[i+1] : INT64_MAX;
+  }
+}
+
+/*===========================================================================*/
+
+/* Full calendar math, only after sync or a jump */
+static void
+Local_Clock_Recompute( INT64 Local_s )
+{
+  INT64   Days;
+  INT64   Secs_Of_Day;
+  INT64   Era;
+  UINT32  Doe, Yoe, Doy, Mp;
+  INT64   Year;
+
+  Days        = Local_s / SECS_PER_DAY;
+  Secs_Of_Day = Local_s % SECS_PER_DAY;
+  if ( Secs_Of_Day < 0 )
+  {
+    Secs_Of_Day += SECS_PER_DAY;
+    Days--;
+  }
+
+  /* Civil from days, see http://howardhinnant.github.io/date_algorithms.html */
+  Days += 719468;
+  Era   = ( (Days >= 0) ? Days : (Days - 146096) ) / 146097;
+  Doe   = (UINT32)(Days - Era * 146097);
+  Yoe   = (Doe - Doe/1460 + Doe/36524 - Doe/146096) / 365;
+  Year  = (INT64)Yoe + Era * 400;
+  Doy   = Doe - (365*Yoe + Yoe/4 - Yoe/100);
+  Mp    = (5*Doy + 2) / 153;
+
+  Clock_Parts.day     = (UINT8)(Doy - (153*Mp + 2)/5 + 1);
+  Clock_Parts.month   = (UINT8)( (Mp < 10) ? (Mp + 3) : (Mp - 9) );
+  Clock_Parts.year    = (UINT16)( Year + ((Clock_Parts.month <= 2) ? 1 : 0) );
+
+  /* 1970-01-01 is Thursday */
+  Days -= 719468;
+  Clock_Parts.weekday = (UINT8)( ((Days % 7) + 7 + 4) % 7 );
+
+  Clock_Parts.hour    = (UINT8)( Secs_Of_Day / 3600 );
+  Clock_Parts.minute  = (UINT8)( (Secs_Of_Day % 3600) / 60 );
+  Clock_Parts.second  = 0;
+
+  Minute_Start_s = Local_s - (Secs_Of_Day % 60);
+}
+
+/*===========================================================================*/
+
+/* Skip the zone name, "CST" or "<+08>", NULL if there is none */
+static const CHAR *
+Local_Clock_Parse_Name( const CHAR *pTz )
+{
+  const CHAR  *pStart = pTz;
+
+  if ( *pTz == '<' )
+  {
+    while ( *pTz && (*pTz != '>') )
+    {
+      pTz++;
+    }
+    return ( *pTz == '>' ) ? (pTz + 1) : NULL;
+  }
+
+  while ( ((*pTz >= 'A') && (*pTz <= 'Z')) || ((*pTz >= 'a') && (*pTz <= 'z')) )
+  {
+    pTz++;
+  }
+
+  return ( pTz == pStart ) ? NULL : pTz;
+}
+
+/*===========================================================================*/
+
+/* [+-]hh[:mm[:ss]] in seconds, NULL if there are no digits */
+static const CHAR *
+Local_Clock_Parse_Time( const CHAR *pTz, INT32 *pSeconds )
+{
+  INT32   Sign  = 1;
+  INT32   Part  = 0;
+  INT32   Unit  = 3600;
+  INT32   Total = 0;
+
+  if ( (*pTz == '+') || (*pTz == '-') )
+  {
+    Sign = (*pTz == '-') ? -1 : 1;
+    pTz++;
+  }
+
+  if ( (*pTz < '0') || (*pTz > '9') )
+  {
+    return NULL;
+  }
+
+  while ( TRUE )
+  {
+    Part = 0;
+    while ( (*pTz >= '0') && (*pTz <= '9') )
+    {
+      Part = Part*10 + (*pTz++ - '0');
+    }
+    Total += Part * Unit;
+
+    if ( (*pTz != ':') || (Unit == 1) )
+    {
+      break;
+    }
+    pTz++;
+    Unit /= 60;
+  }
+
+  *pSeconds = Sign * Total;
+
+  return pTz;
+}
+
+/*===========================================================================*/
+
+/* ",Jn", ",n" or ",Mm.w.d", then "/time", NULL if malformed */
+static const CHAR *
+Local_Clock_Parse_Rule( const CHAR *pTz, LOCAL_CLOCK_RULE_RECORD *pRule )
+{
+  UINT32  Value[3] = { 0, 0, 0 };
+  UINT8   Count;
+
+  if ( *pTz++ != ',' )
+  {
+    return NULL;
+  }
+
+  pRule->type = 'D';
+  if ( (*pTz == 'J') || (*pTz == 'M') )
+  {
+    pRule->type = *pTz++;
+  }
+
+  for ( Count = 0; Count < 3; Count++ )
+  {
+    if ( (*pTz < '0') || (*pTz > '9') )
+    {
+      return NULL;
+    }
+    while ( (*pTz >= '0') && (*pTz <= '9') && (Value[Count] < 1000) )
+    {
+      Value[Count] = Value[Count]*10 + (*pTz++ - '0');
+    }
+    if ( (pRule->type != 'M') || (Count == 2) || (*pTz != '.') )
+    {
+      break;
+    }
+    pTz++;
+  }
+
+  if ( pRule->type == 'M' )
+  {
+    if ( (Count != 2) || (Value[0] < 1) || (Value[0] > 12) ||
+         (Value[1] < 1) || (Value[1] > 5) || (Value[2] > 6) )
+    {
+      return NULL;
+    }
+    pRule->month  = (UINT8)Value[0];
+    pRule->week   = (UINT8)Value[1];
+    pRule->day    = (UINT16)Value[2];
+  }
+  else
+  {
+    if ( (pRule->type == 'J') ? ((Value[0] < 1) || (Value[0] > 365)) : (Value[0] > 365) )
+    {
+      return NULL;
+    }
+    pRule->day = (UINT16)Value[0];
+  }
+
+  /* 02:00 unless given */
+  pRule->time_s = 2*3600;
+  if ( *pTz == '/' )
+  {
+    pTz = Local_Clock_Parse_Time( pTz + 1, &pRule->time_s );
+  }
+
+  return pTz;
+}
+
+/*===========================================================================*/
+
+/*!
+Set the time zone from a POSIX TZ string, e.g. "CST-8", or with DST rules
+"CET-1CEST,M3.5.0,M10.5.0/3". A DST name without rules takes the US ones,
+"M3.2.0,M11.1.0", as glibc does.
+
+@param  pTz   TZ string, (I)
+@return TRUE if parsed OK, else the time zone is not changed
+*/
+BOOL
+Local_Clock_Set_Timezone( const CHAR *pTz )
+{
+  LOCAL_CLOCK_RULE_RECORD   Rules[2];
+  INT32                     Std_Offset_s = 0;
+  INT32                     Dst_Offset_s;
+  BOOL                      Has_Dst = FALSE;
+
+  pTz = Local_Clock_Parse_Name( pTz );
+  if ( pTz != NULL )
+  {
+    pTz = Local_Clock_Parse_Time( pTz, &Std_Offset_s );
+  }
+
+  /* POSIX offsets are west of UTC, the opposite of what we add */
+  Std_Offset_s = -Std_Offset_s;
+  Dst_Offset_s = Std_Offset_s + 3600;
+
+  if ( (pTz != NULL) && (*pTz != 0) )
+  {
+    Has_Dst = TRUE;
+    pTz     = Local_Clock_Parse_Name( pTz );
+
+    if ( (pTz != NULL) && (*pTz != ',') && (*pTz != 0) )
+    {
+      pTz = Local_Clock_Parse_Time( pTz, &Dst_Offset_s );
+      Dst_Offset_s = -Dst_Offset_s;
+    }
+
+    if ( (pTz != NULL) && (*pTz == 0) )
+    {
+      pTz = Local_Clock_Parse_Rule( ",M3.2.0", &Rules[0] );
+      pTz = Local_Clock_Parse_Rule( ",M11.1.0", &Rules[1] );
+    }
+    else if ( pTz != NULL )
+    {
+      pTz = Local_Clock_Parse_Rule( pTz, &Rules[0] );
+      if ( pTz != NULL )
+      {
+        pTz = Local_Clock_Parse_Rule( pTz, &Rules[1] );
+      }
+    }
+  }
+
+  if ( (pTz == NULL) || (*pTz != 0) )
+  {
+    LOG( DBG_E, "Clock: Bad time zone.\n" );
+    return FALSE;
+  }
+
+  Tz_Std_Offset_s = Std_Offset_s;
+  Tz_Dst_Offset_s = Dst_Offset_s;
+  Tz_Has_Dst      = Has_Dst;
+  if ( Has_Dst )
+  {
+    memcpy( Tz_Rules, Rules, sizeof(Tz_Rules) );
+  }
+
+  /* Worked out again at the next reading */
+  Tz_From_s  = 0;
+  Tz_Until_s = 0;
+
+  if ( Clock_Valid )
+  {
+    Local_Clock_Recompute( Local_Clock_Local_s() );
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+Sync the clock to a reference time, and measure the drift since the last sync.
+Offsets up to LOCAL_CLOCK_SLEW_MAX_US are slewed, larger ones step the clock.
+
+@param  Utc_us    UTC microseconds since 1970 at this moment, (I)
+@return TRUE if the clock was stepped
+*/
+BOOL
+Local_Clock_Sync( INT64 Utc_us )
+{
+  UINT64  Local_us  = Local_Clock_Micros64();
+  INT64   Now_us    = Local_Clock_At( Local_us );
+  INT64   Offset_us = Utc_us - Now_us;
+  INT64   Local_Elapsed_us;
+  INT64   Utc_Elapsed_us;
+  INT64   Diff_us;
+  INT32   Measured_ppb;
+
+  if ( Clock_Valid )
+  {
+    LOG( DBG_I, "Clock: Sync offset %ld us\n", (INT32)Offset_us );
+  }
+
+  /* Re-anchor at the current reading before the drift changes */
+  Anchor_Local_us = Local_us;
+  Anchor_Utc_us   = Now_us;
+
+  /* Measure drift over a long enough interval */
+  if ( Drift_Sync_Valid )
+  {
+    Local_Elapsed_us  = (INT64)(Local_us - Drift_Sync_Local_us);
+    Utc_Elapsed_us    = Utc_us - Drift_Sync_Utc_us;
+
+    if ( Utc_Elapsed_us >= LOCAL_CLOCK_DRIFT_MIN_INTERVAL_S * US_PER_S )
+    {
+      /* Range checked before scaling, a step of the clock could overflow it */
+      Diff_us = Local_Elapsed_us - Utc_Elapsed_us;
+      if ( (Diff_us > Utc_Elapsed_us / (1000000000LL / LOCAL_CLOCK_DRIFT_MAX_PPB)) ||
+           (Diff_us < -Utc_Elapsed_us / (1000000000LL / LOCAL_CLOCK_DRIFT_MAX_PPB)) )
+      {
+        LOG( DBG_W, "Clock: Drift %ld us over %ld s out of range, ignored.\n",
+                    (INT32)Diff_us, (INT32)(Utc_Elapsed_us / US_PER_S) );
+      }
+      else
+      {
+        Measured_ppb = (INT32)( Diff_us * 1000000 / (Utc_Elapsed_us / 1000) );
+
+        /* Smooth it, the sync itself has some error */
+        Drift_ppb   = Drift_Valid ? (INT32)(((INT64)Drift_ppb*3 + Measured_ppb) / 4) : Measured_ppb;
+        Drift_Valid = TRUE;
+        LOG( DBG_I, "Clock: Drift measured %ld ppb, using %ld ppb\n", Measured_ppb, Drift_ppb );
+      }
+
+      Drift_Sync_Local_us = Local_us;
+      Drift_Sync_Utc_us   = Utc_us;
+    }
+  }
+  else
+  {
+    Drift_Sync_Valid    = TRUE;
+    Drift_Sync_Local_us = Local_us;
+    Drift_Sync_Utc_us   = Utc_us;
+  }
+
+  if ( Clock_Valid &&
+       (Offset_us <= LOCAL_CLOCK_SLEW_MAX_US) && (Offset_us >= -LOCAL_CLOCK_SLEW_MAX_US) )
+  {
+    Slew_us = (INT32)Offset_us;
+    return FALSE;
+  }
+
+  Anchor_Utc_us   = Utc_us;
+  Slew_us         = 0;
+  Clock_Valid     = TRUE;
+
+  Local_Clock_Recompute( Local_Clock_Local_s() );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Keep micros() extended and roll the minute over, to call at each sketch loop() */
+void
+Local_Clock_Handle( void )
+{
+  INT64   Local_s;
+
+  Local_s = Local_Clock_Local_s();
+
+  if ( !Clock_Valid )
+  {
+    return;
+  }
+
+  /* Jumped backward or too far, do full calendar math */
+  if ( (Local_s < Minute_Start_s) || ((Local_s - Minute_Start_s) >= SECS_PER_DAY) )
+  {
+    Local_Clock_Recompute( Local_s );
+    return;
+  }
+
+  while ( (Local_s - Minute_Start_s) >= 60 )
+  {
+    Minute_Start_s += 60;
+
+    if ( ++Clock_Parts.minute < 60 )
+    {
+      continue;
+    }
+    Clock_Parts.minute = 0;
+
+    if ( ++Clock_Parts.hour < 24 )
+    {
+      continue;
+    }
+    Clock_Parts.hour    = 0;
+    Clock_Parts.weekday = (Clock_Parts.weekday + 1) % 7;
+
+    if ( ++Clock_Parts.day <= Local_Clock_Days_In_Month( Clock_Parts.year, Clock_Parts.month ) )
+    {
+      continue;
+    }
+    Clock_Parts.day = 1;
+
+    if ( ++Clock_Parts.month <= 12 )
+    {
+      continue;
+    }
+    Clock_Parts.month = 1;
+    Clock_Parts.year++;
+  }
+}
+
+/*===========================================================================*/
+
+BOOL
+Local_Clock_Is_Valid( void )
+{
+  return Clock_Valid;
+}
+
+/*===========================================================================*/
+
+/* UTC microseconds since 1970 */
+INT64
+Local_Clock_Now_us( void )
+{
+  return Local_Clock_At( Local_Clock_Micros64() );
+}
+
+/*===========================================================================*/
+
+/* UTC seconds since 1970 */
+UINT32
+Local_Clock_Now_s( void )
+{
+  return (UINT32)( Local_Clock_Now_us() / US_PER_S );
+}
+
+/*===========================================================================*/
+
+/*!
+Get the broken-down local time, O(1), no calendar math.
+
+@param  pTime   Local time, (O)
+@return TRUE if the clock is valid
+*/
+BOOL
+Local_Clock_Get( LOCAL_TIME_RECORD *pTime )
+{
+  INT64   Second;
+
+  *pTime = Clock_Parts;
+
+  if ( !Clock_Valid )
+  {
+    return FALSE;
+  }
+
+  /* Local_Clock_Handle() may not have rolled the minute yet */
+  Second = Local_Clock_Local_s() - Minute_Start_s;
+  pTime->second = (Second < 0) ? 0 : ((Second > 59) ? 59 : (UINT8)Second);
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Format local time as 'YYYY-MM-DD hh:mm:ss', return the length */
+UINT16
+Local_Clock_Format( CHAR *pBuff, UINT16 Size )
+{
+  LOCAL_TIME_RECORD Time;
+  INT32             Len;
+
+  if ( !Local_Clock_Get( &Time ) )
+  {
+    Len = snprintf_P( pBuff, Size, PSTR("N/A") );
+  }
+  else
+  {
+    Len = snprintf_P( pBuff, Size, PSTR("%04u-%02u-%02u %02u:%02u:%02u"),
+                    Time.year, Time.month, Time.day,
+                    Time.hour, Time.minute, Time.second );
+  }
+
+  return ( Len < Size ) ? Len : (Size - 1);
+}
+
+/*===========================================================================*/
+
+INT32
+Local_Clock_Get_Drift_ppb( void )
+{
+  return Drift_ppb;
+}
+
+/*===========================================================================*/
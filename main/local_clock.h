@@ -0,0 +1,94 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   local_clock.h
+@brief  Local clock anchored to the last NTP sync, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __LOCAL_CLOCK_H__
+#define __LOCAL_CLOCK_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Drift is only measured over sync intervals longer than this,
+   shorter ones are dominated by the sync error */
+#define LOCAL_CLOCK_DRIFT_MIN_INTERVAL_S  600
+
+/* Measured drift beyond this is treated as a bad sync, parts per billion */
+#define LOCAL_CLOCK_DRIFT_MAX_PPB         500000
+
+/* Sync offsets within this are slewed, larger ones step the clock */
+#define LOCAL_CLOCK_SLEW_MAX_US           500000
+
+/* How fast an offset is slewed, 500 ppm absorbs 0.5 s in about 17 mins */
+#define LOCAL_CLOCK_SLEW_RATE_PPM         500
+
+/* Broken-down local time */
+typedef struct
+{
+  UINT16  year;       /* e.g. 2026 */
+  UINT8   month;      /* 1-12 */
+  UINT8   day;        /* 1-31 */
+  UINT8   weekday;    /* 0-6, 0 is Sunday */
+  UINT8   hour;       /* 0-23 */
+  UINT8   minute;     /* 0-59 */
+  UINT8   second;     /* 0-59 */
+
+} LOCAL_TIME_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern BOOL
+Local_Clock_Set_Timezone( const CHAR *pTz );
+
+extern BOOL
+Local_Clock_Sync( INT64 Utc_us );
+
+extern void
+Local_Clock_Handle( void );
+
+extern BOOL
+Local_Clock_Is_Valid( void );
+
+extern INT64
+Local_Clock_Now_us( void );
+
+extern UINT32
+Local_Clock_Now_s( void );
+
+extern BOOL
+Local_Clock_Get( LOCAL_TIME_RECORD *pTime );
+
+extern UINT16
+Local_Clock_Format( CHAR *pBuff, UINT16 Size );
+
+extern INT32
+Local_Clock_Get_Drift_ppb( void );
+
+#endif  /* __LOCAL_CLOCK_H__ */
+
+/*===========================================================================*/
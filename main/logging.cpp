@@ -25,6 +25,7 @@ Local Includes
 =============================================================================*/
 
 #include "logging.h"
+#include "flash_string.h"
 
 /*=============================================================================
 Definitions
@@ -62,13 +63,34 @@ typedef struct
 
 } LOG_INPUT_RECORD;
 
+/*! @brief Rate limiting state of one log call site */
+typedef struct
+{
+  /*! Call site key, NULL means this slot is free */
+  const char    *pFile;
+  int           Line;
+
+  /*! Tokens left in the bucket */
+  unsigned char Tokens;
+
+  /*! Last time tokens were refilled - ms */
+  unsigned long Last_Refill_ms;
+
+  /*! Logs dropped at this call site since the last printed one */
+  unsigned long Suppressed_Count;
+
+} LOG_RATE_RECORD;
+
 /* This is the maximum length of the string obtained when FormatString is printed: LOG(,FormatString,...) */
 #define MAX_LOG_MESSAGE_LENGTH                128
 
 /* Don't use malloc() or relative functions which will cause stack error!!! */
 #define MY_MALLOC(id, ptr, size, buffer)  malloc(size)
 #define MY_FREE(id, ptr, size, buffer)    free(ptr)
-#define MY_VSNPRINTF                      vsnprintf
+#define MY_VSNPRINTF                      vsnprintf_P
+
+/* Length of a file name in the suppressed logs summary */
+#define LOG_FILE_NAME_MAX_LENGTH          32
 
 /*=============================================================================
 Static Variables
@@ -81,6 +103,23 @@ static char    LogLevelCharacters[DBG_3+1] =
   'P', 'C', 'A', 'E', 'W', 'N', 'I', '1', '2', '3'
 };
 
+/* Rate limiting table, indexed by hash of file/line */
+static LOG_RATE_RECORD  Log_Rate_Table[LOG_RATE_TABLE_SIZE];
+
+/* Last printed message and how many times it has been repeated since */
+static char           Last_Log_String[MAX_LOG_MESSAGE_LENGTH];
+static unsigned char  Last_Log_Level;
+static unsigned int   Last_Log_ID;
+static unsigned long  Last_Log_Repeat_Count    = 0;
+static unsigned long  Last_Log_First_Repeat_ms = 0;
+
+/* Total statistics since boot */
+static unsigned long  Log_Suppressed_Total  = 0;
+static unsigned long  Log_Repeated_Total    = 0;
+
+/* Dropped at call sites whose slot was recycled, printed before the next log */
+static unsigned long  Log_Evicted_Suppressed = 0;
+
 /*=============================================================================
 Global Variables
 =============================================================================*/
@@ -89,18 +128,164 @@ Global Variables
 Static Prototypes
 =============================================================================*/
 
+static void LOG_Print( unsigned int Log_ID, unsigned char Log_Level, unsigned long Now_us, const char *pLogString );
+static LOG_RATE_RECORD *LOG_Rate_Lookup( const char *pFile, int Line );
+static void LOG_Flush_Repeated( unsigned long Now_us );
+static void LOG_Print_Suppressed( unsigned long Count, const char *pFile, int Line );
+
 /*=============================================================================
 Function Definitions
 =============================================================================*/
 
 /*===========================================================================*/
 
+/* Print one formatted log line to console */
+static void
+LOG_Print(  unsigned int  Log_ID,
+            unsigned char Log_Level,
+            unsigned long Now_us,
+            const char    *pLogString )
+{
+  String  Print_String;
+
+  Print_String += String(LogLevelCharacters[Log_Level]) + ",";
+  Print_String += String(Log_ID) + ",";
+  Print_String += "[" + String(float(Now_us)/1000,3) + "]: ";
+  Print_String += pLogString;
+
+//  Print_String.format( "%c,%u,[%u.%3d] : %s",
+//                        LogLevelCharacters[Log_Level],
+//                        Log_ID,
+//                        (UINT32)Now_us/1000,
+//                        (UINT32)Now_us%1000,
+//                        pLogString );
+
+  /* Print logs immediately to console */
+  Serial.print(Print_String);
+}
+
+/*===========================================================================*/
+
+/*!
+Find the rate limiting record of a call site, O(1).
+The table is open addressed with at most LOG_RATE_PROBE_MAX probes,
+if all probed slots are taken the home slot is recycled.
+
+A recycled slot keeps its bucket, the new call site goes on with the tokens
+the old one left. With more call sites than slots a fresh bucket on every
+recycle would let sites taking turns log without limit.
+
+@param  pFile   File of the call site, (I)
+@param  Line    Line of the call site, (I)
+@return The record, never NULL
+*/
+static LOG_RATE_RECORD *
+LOG_Rate_Lookup( const char *pFile, int Line )
+{
+  unsigned int      Home;
+  unsigned int      Index;
+  unsigned int      Probe;
+  LOG_RATE_RECORD   *pRecord;
+
+  /* The file name is a string literal in flash, every call site has its own,
+     so together with the line its address identifies the call site */
+  Home = ( (unsigned int)(size_t)pFile + (unsigned int)Line ) * 2654435761u;
+  Home = (Home >> 16) & (LOG_RATE_TABLE_SIZE - 1);
+
+  for ( Probe = 0; Probe < LOG_RATE_PROBE_MAX; Probe++ )
+  {
+    Index   = (Home + Probe) & (LOG_RATE_TABLE_SIZE - 1);
+    pRecord = &Log_Rate_Table[Index];
+
+    if ( (pRecord->pFile == pFile) && (pRecord->Line == Line) )
+    {
+      return pRecord;
+    }
+
+    if ( pRecord->pFile == NULL )
+    {
+      break;
+    }
+  }
+
+  if ( Probe == LOG_RATE_PROBE_MAX )
+  {
+    /* Recycle the home slot, its bucket and refill time stay. What it
+       dropped is reported with the next log, not printed here, so the
+       reports can't flood the console either */
+    pRecord = &Log_Rate_Table[Home];
+    Log_Evicted_Suppressed += pRecord->Suppressed_Count;
+  }
+  else
+  {
+    /* A slot never used, a full bucket */
+    pRecord->Tokens         = LOG_RATE_BURST;
+    pRecord->Last_Refill_ms = millis();
+  }
+
+  pRecord->pFile            = pFile;
+  pRecord->Line             = Line;
+  pRecord->Suppressed_Count = 0;
+
+  return pRecord;
+}
+
+/*===========================================================================*/
+
+/* Print "last message repeated N times" if there are pending repeats */
+static void
+LOG_Flush_Repeated( unsigned long Now_us )
+{
+  char  Summary[MAX_LOG_MESSAGE_LENGTH];
+
+  if ( Last_Log_Repeat_Count == 0 )
+  {
+    return;
+  }
+
+  snprintf_P( Summary, sizeof(Summary), PSTR("Log: last message repeated %lu times\n"), Last_Log_Repeat_Count );
+  LOG_Print( Last_Log_ID, Last_Log_Level, Now_us, Summary );
+
+  Last_Log_Repeat_Count = 0;
+}
+
+/*===========================================================================*/
+
+/* Print "N messages suppressed at file:line", the file name is in flash,
+   NULL for the call sites whose slots were recycled */
+static void
+LOG_Print_Suppressed( unsigned long Count, const char *pFile, int Line )
+{
+  char        Summary[MAX_LOG_MESSAGE_LENGTH];
+  char        File[LOG_FILE_NAME_MAX_LENGTH];
+  char        Path[MAX_LOG_MESSAGE_LENGTH];
+  const char  *pName;
+
+  if ( pFile == NULL )
+  {
+    snprintf_P( Summary, sizeof(Summary), PSTR("Log: %lu messages suppressed at other call sites\n"), Count );
+    LOG_Print( LOG_ID_DEFAULT, DBG_W, micros(), Summary );
+    return;
+  }
+
+  /* Copy it out of flash before looking at it, keep the base name only */
+  Flash_String_Copy( Path, sizeof(Path), pFile );
+  pName = strrchr( Path, '/' );
+  pName = ( pName != NULL ) ? (pName + 1) : Path;
+  snprintf( File, sizeof(File), "%s", pName );
+
+  snprintf_P( Summary, sizeof(Summary), PSTR("Log: %lu messages suppressed at %s:%d\n"), Count, File, Line );
+  LOG_Print( LOG_ID_DEFAULT, DBG_W, micros(), Summary );
+}
+
+/*===========================================================================*/
+
 /*!
 Generate a log message
 
 @param  Log_ID           Log message category, (I)
 @param  Log_Level        Log level, (I)
-@param  pFormatString    Format string for log message, (I)
+@param  pFormatString    Format string for log message, in flash, (I)
 @param  ...              Arguments to format string, (I)
 @return None
 
@@ -118,8 +303,10 @@ LOG_ID_Handle(  unsigned int  Log_ID,
   va_list                   ap;
   unsigned int              LogStringLength;
   char                      pLogString[MAX_LOG_MESSAGE_LENGTH];
-  String                    Print_String;
   unsigned long             Now_us;
+  unsigned long             Now_ms;
+  unsigned long             Refill_Count;
+  LOG_RATE_RECORD           *pRate = NULL;
 
   /* Ensure Log_ID in valid range */
   if ( Log_ID >= NUM_LOG_IDS )
@@ -148,6 +335,38 @@ LOG_ID_Handle(  unsigned int  Log_ID,
 
   /* Get current timestamps */
   Now_us = micros();
+  Now_ms = millis();
+
+  /* Rate limiting per call site, done before formatting to keep the cost low */
+  if ( Log_Level > LOG_RATE_EXEMPT_LEVEL )
+  {
+    pRate = LOG_Rate_Lookup( pFile, Line );
+
+    /* Refill the bucket */
+    Refill_Count = (Now_ms - pRate->Last_Refill_ms) / LOG_RATE_REFILL_MS;
+    if ( Refill_Count > 0 )
+    {
+      pRate->Last_Refill_ms += Refill_Count * LOG_RATE_REFILL_MS;
+      if ( Refill_Count >= (unsigned long)(LOG_RATE_BURST - pRate->Tokens) )
+      {
+        pRate->Tokens = LOG_RATE_BURST;
+      }
+      else
+      {
+        pRate->Tokens += Refill_Count;
+      }
+    }
+
+    /* Out of tokens, drop it */
+    if ( pRate->Tokens == 0 )
+    {
+      pRate->Suppressed_Count++;
+      Log_Suppressed_Total++;
+      return;
+    }
+
+    pRate->Tokens--;
+  }
 
 #if 0
   /* Save information about the log; this info will be sent to TSK_Log
@@ -191,20 +410,45 @@ LOG_ID_Handle(  unsigned int  Log_ID,
     fflush( pDebugFile );
   }
 #elif 1
-  Print_String += String(LogLevelCharacters[Log_Level]) + ",";
-  Print_String += String(Log_ID) + ",";
-  Print_String += "[" + String(float(Now_us)/1000,3) + "]: ";
-  Print_String += pLogString;
+  /* Collapse identical consecutive messages */
+  if ( (Log_ID == Last_Log_ID) && (strcmp( pLogString, Last_Log_String ) == 0) )
+  {
+    if ( Last_Log_Repeat_Count == 0 )
+    {
+      Last_Log_First_Repeat_ms = Now_ms;
+    }
+    Last_Log_Repeat_Count++;
+    Log_Repeated_Total++;
 
-//  Print_String.format( "%c,%u,[%u.%3d] : %s",
-//                        LogLevelCharacters[Log_Level],
-//                        Log_ID,
-//                        (UINT32)Now_us/1000,
-//                        (UINT32)Now_us%1000,
-//                        pLogString );
+    /* Don't keep the repeats pending forever */
+    if ( (Now_ms - Last_Log_First_Repeat_ms) >= LOG_REPEAT_FLUSH_MS )
+    {
+      LOG_Flush_Repeated( Now_us );
+    }
+    return;
+  }
 
-  /* Print logs immediately to console */
-  Serial.print(Print_String);
+  LOG_Flush_Repeated( Now_us );
+
+  /* Report what was dropped at recycled call sites, and at this one, before the new message */
+  if ( Log_Evicted_Suppressed > 0 )
+  {
+    LOG_Print_Suppressed( Log_Evicted_Suppressed, NULL, 0 );
+    Log_Evicted_Suppressed = 0;
+  }
+
+  if ( (pRate != NULL) && (pRate->Suppressed_Count > 0) )
+  {
+    LOG_Print_Suppressed( pRate->Suppressed_Count, pFile, Line );
+    pRate->Suppressed_Count = 0;
+  }
+
+  LOG_Print( Log_ID, Log_Level, Now_us, pLogString );
+
+  /* Remember it for duplicate detection */
+  memcpy( Last_Log_String, pLogString, MAX_LOG_MESSAGE_LENGTH );
+  Last_Log_ID     = Log_ID;
+  Last_Log_Level  = Log_Level;
 #else
   /* Get string length and add one for the null termination character */
   LogStringLength = strlen(pLogString) + 1;
@@ -256,3 +500,39 @@ LOG_ID_Handle(  unsigned int  Log_ID,
 }
 
 /*===========================================================================*/
+
+/*!
+Print the pending repeats of the last message once LOG_REPEAT_FLUSH_MS went
+by since the first, call from loop(). Without it the summary would wait for
+the next log, which may not come for hours.
+
+@return None
+*/
+void
+LOG_Handle( void )
+{
+  if ( (Last_Log_Repeat_Count > 0) && ((millis() - Last_Log_First_Repeat_ms) >= LOG_REPEAT_FLUSH_MS) )
+  {
+    LOG_Flush_Repeated( micros() );
+  }
+}
+
+/*===========================================================================*/
+
+/* Total count of logs dropped by rate limiting since boot */
+unsigned long
+LOG_Get_Suppressed_Count( void )
+{
+  return Log_Suppressed_Total;
+}
+
+/*===========================================================================*/
+
+/* Total count of logs collapsed as duplicates since boot */
+unsigned long
+LOG_Get_Repeated_Count( void )
+{
+  return Log_Repeated_Total;
+}
+
+/*===========================================================================*/
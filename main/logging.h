@@ -60,8 +60,24 @@ DBG_3 - debug 3 - voluminous debug info, as much as required
 #define LOG_ID_DEFAULT    1
 #define NUM_LOG_IDS       2
 
-#define LOG_ID(Log_ID, Log_Level, FormatString, ...)  LOG_ID_Handle( Log_ID, Log_Level, __FILE__, __func__, __LINE__, FormatString, ##__VA_ARGS__ )
-#define LOG(Log_Level, FormatString, ...)             LOG_ID_Handle( LOG_ID_DEFAULT, Log_Level, __FILE__, __func__, __LINE__, FormatString, ##__VA_ARGS__ )
+/* Per call site (file/line) log rate limiting, token bucket.
+   Every call site may burst LOG_RATE_BURST logs, then gets one more token
+   every LOG_RATE_REFILL_MS. Levels up to LOG_RATE_EXEMPT_LEVEL are never limited */
+#define LOG_RATE_TABLE_SIZE       32      /* Must be power of 2 */
+#define LOG_RATE_PROBE_MAX        4
+#define LOG_RATE_BURST            5
+#define LOG_RATE_REFILL_MS        10000
+#define LOG_RATE_EXEMPT_LEVEL     DBG_C
+
+/* Identical consecutive messages are collapsed into "last message repeated N times",
+   which is printed when a different message arrives, or by LOG_Handle() once
+   LOG_REPEAT_FLUSH_MS went by since the first repeat */
+#define LOG_REPEAT_FLUSH_MS       60000
+
+/* The format string and file name are kept in flash, the function name is not passed
+   since __func__ can't be, FormatString must be a string literal */
+#define LOG_ID(Log_ID, Log_Level, FormatString, ...)  LOG_ID_Handle( Log_ID, Log_Level, PSTR(__FILE__), NULL, __LINE__, PSTR(FormatString), ##__VA_ARGS__ )
+#define LOG(Log_Level, FormatString, ...)             LOG_ID_Handle( LOG_ID_DEFAULT, Log_Level, PSTR(__FILE__), NULL, __LINE__, PSTR(FormatString), ##__VA_ARGS__ )
 
 /*=============================================================================
 Global References
@@ -80,6 +96,15 @@ LOG_ID_Handle(  unsigned int  Log_ID,
                 const char    *pFormatString,
                 ... );
 
+extern void
+LOG_Handle( void );
+
+extern unsigned long
+LOG_Get_Suppressed_Count( void );
+
+extern unsigned long
+LOG_Get_Repeated_Count( void );
+
 #endif  /* __LOGGING_H__ */
 
 /*===========================================================================*/
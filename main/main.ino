@@ -17,7 +17,6 @@ System Includes
 =============================================================================*/
 
 #include <stdio.h>
-#include <ESPDateTime.h>
 
 /*=============================================================================
 Local Includes
@@ -25,21 +24,47 @@ Local Includes
 
 #include "http_server.h"
 #include "mqtt_client.h"
+#include "wifi_manager.h"
+#include "boot_profile.h"
+#include "local_clock.h"
+#include "sntp_client.h"
+#include "relay_control.h"
+#include "relay_actuator.h"
+#include "sonar_sampler.h"
+#include "bench.h"
+#include "watchdog.h"
+#include "profiler.h"
+#include "history.h"
+#include "trace.h"
+#include "metrics.h"
+#include "arena.h"
 #include "esp8266_global.h"
 
 /*=============================================================================
 Definitions
 =============================================================================*/
 
-/* The deepth of sonar distance window LPF */
-#define DISTANCE_WINDOW_LPF_WIDTH 10
+/* NTP configs, servers are tried in order */
+#define NTP_SERVER            "time.pool.aliyun.com"
+#define NTP_SERVER_2          "ntp.aliyun.com"
+#define NTP_SERVER_3          "cn.pool.ntp.org"
+#define NTP_TIMEZONE          "CST-8"
+
+/* The MQTT state report */
+#define MQTT_REPORT_INTERVAL_MS   5000
 
 /*=============================================================================
 Static Variables
 =============================================================================*/
 
-static  FLOAT Sonar_Distance_History[DISTANCE_WINDOW_LPF_WIDTH];
-static  UINT8 Sonar_Distance_History_Index=0;
+static  SONAR_FILTER_RECORD Sonar_Filter;
+
+/* Boot states */
+static  BOOL  Boot_NTP_Started        = FALSE;
+static  BOOL  Boot_Profile_Published  = FALSE;
+
+/* The relay status last written into EEPROM */
+static  BOOL  Last_Saved_Relay_Status = FALSE;
 
 /*=============================================================================
 Global Variables
@@ -51,10 +76,8 @@ u32 led_flash_interval_ms             = 500;
 
 /* All update timestamps */
 u32 last_led_flash_timestamp_ms       = 0;
-u32 last_measure_sonar_timestamp_ms   = 0;
 u32 last_average_sonar_timestamp_ms   = 0;
 u32 last_time_str_update_timestamp_ms = 0;
-u32 last_sync_ntp_timestamp_ms        = 0;
 u32 last_mqtt_report_timestamp_ms     = 0;
 u32 last_mqtt_connect_timestamp_ms    = 0;
 
@@ -68,24 +91,61 @@ Function Definitions
 
 /*===========================================================================*/
 
-static void Setup_DateTime()
+/* Start NTP once wifi is connected, and mark the phase done when time is valid.
+   Never blocks, the SNTP client is driven by Sntp_Handle() */
+static void Boot_NTP_Handle()
 {
-  // setup this after wifi connected
-  // you can use custom timeZone,server and timeout
-  // DateTime.setTimeZone(-4);
-  //   DateTime.setServer("asia.pool.ntp.org");
-  //   DateTime.begin(15 * 1000);
-  DateTime.setServer("time.pool.aliyun.com");
-  DateTime.setTimeZone("CST-8");
-  DateTime.begin(3 * 1000);
-  if (!DateTime.isTimeValid())
+  if ( Boot_Phase_Is_Done(BOOT_PHASE_NTP) || !Wifi_Is_Connected() )
+  {
+    return;
+  }
+
+  if ( Boot_NTP_Started == FALSE )
   {
-    LOG( DBG_E, "DateTime: Failed to get time from server.\n");
+    Boot_NTP_Started = TRUE;
+    Boot_Phase_Start( BOOT_PHASE_NTP );
+
+    Local_Clock_Set_Timezone(NTP_TIMEZONE);
+    Sntp_Add_Server(NTP_SERVER);
+    Sntp_Add_Server(NTP_SERVER_2);
+    Sntp_Add_Server(NTP_SERVER_3);
+    Sntp_Start();
+    return;
   }
-  else
+
+  if ( Local_Clock_Is_Valid() )
   {
-    LOG( DBG_E, "DateTime: DateTime is %s\n", DateTime.toString().c_str() );
-    LOG( DBG_E, "DateTime: Timestamp is %ld\n", DateTime.now() );
+    My_Status_Write_Begin();
+    Local_Clock_Format( My_Status.local_time_str, LOCALTIME_STR_MAX_SIZE );
+    My_Status_Write_End();
+    LOG( DBG_E, "DateTime: DateTime is %s\n", My_Status.local_time_str );
+    LOG( DBG_E, "DateTime: Timestamp is %lu\n", Local_Clock_Now_s() );
+    Boot_Phase_Done( BOOT_PHASE_NTP );
+  }
+}
+
+/*===========================================================================*/
+
+/* Publish the boot profile once MQTT is connected and all phases are done */
+static void Boot_Profile_Handle()
+{
+  CHAR  Profile_Str[BOOT_PROFILE_STR_MAX_SIZE];
+
+  if ( Boot_Profile_Published || !mqtt_is_connected() )
+  {
+    return;
+  }
+
+  if ( !Boot_Is_Complete() && (millis() < BOOT_PROFILE_TIMEOUT_MS) )
+  {
+    return;
+  }
+
+  Boot_Profile_Format( Profile_Str, sizeof(Profile_Str) );
+  if ( mqtt_publish(PSTR("boot_profile"), Profile_Str) )
+  {
+    Boot_Profile_Published = TRUE;
+    LOG( DBG_N, "Boot: Profile %s\n", Profile_Str );
   }
 }
 
@@ -93,29 +153,56 @@ static void Setup_DateTime()
 
 void setup()
 {
-  delay(100);
+  BOOL  Relay_Status = FALSE;
 
   /*-----------------------------------------------------------------------------
    Power On Initialisation
   -----------------------------------------------------------------------------*/
-  Serial.begin(115200);
+  Boot_Phase_Start( BOOT_PHASE_HW );
 
   /* Init GPIOs */
   GPIO_Initialise();
 
+  Serial.begin(115200);
+
   LOG( DBG_P, "ESP8266 Iot gateway starting, version %s\n", SW_REVISION );
 
+  /* Restore the relay before anything else, it was undefined during boot */
+  if ( My_State_Load( &Relay_Status ) == FN_RETURN_OK )
+  {
+    digitalWrite( GPIO_RELAY, Relay_Status ? HIGH : LOW );
+  }
+
+  /* Init all local configs */
+  My_Config_Initialise();
+
   /*-----------------------------------------------------------------------------
    System Initialisation
   -----------------------------------------------------------------------------*/
 
   /* Clean all the status */
   memset( &My_Status, 0 ,sizeof(MY_STATUS_RECORD) );
+  My_Status.relay_status  = Relay_Status;
+  Last_Saved_Relay_Status = Relay_Status;
 
-  /* Init all local configs */
-  My_Config_Initialise();
+  /* Init sonar HC-SR04 and take the first sample,
+     so the relay logic has a valid distance in the first loop */
+  SR04_Initialise();
+  My_Status.raw_distance_cm = SR04_Get_Distance();
+  My_Status.distance_valid  = (My_Status.raw_distance_cm==0)?FALSE:TRUE;
+  Sonar_Filter_Reset( &Sonar_Filter, My_Status.raw_distance_cm );
+  My_Status.avg_distance_cm = Sonar_Filter.avg_distance_cm;
 
-  /* Init wifi configs */
+  /* From now on the timer pings it */
+  Sonar_Sampler_Start( SONAR_SAMPLE_HZ );
+
+  Boot_Phase_Done( BOOT_PHASE_HW );
+
+  /*---------------------------------------------------------------------------*/
+
+  /* Everything below returns at once, they come up in loop() concurrently */
+
+  /* Start wifi connecting */
   Wifi_Initialise();
 
   /* Init the HTTP server */
@@ -124,35 +211,48 @@ void setup()
   /* Init the MQTT client */
   mqtt_client_init();
 
-  /* Init sonar HC-SR04 */
-  SR04_Initialise();
+  /* Mount the file system of the history, go on with the block kept in RTC memory */
+  History_Initialise();
 
-  /*---------------------------------------------------------------------------*/
-
-  delay(3000);
+  /* Start counting after the boot allocations */
+  Metrics_Initialise();
 
-  /* Start NTP client and do update once, delay sometime after Wifi initlised */
-  Setup_DateTime();
-
-  /* Initlise all the variables */
-  My_Status.raw_distance_cm = SR04_Get_Distance();
-  memset( Sonar_Distance_History, My_Status.raw_distance_cm, DISTANCE_WINDOW_LPF_WIDTH);
+  /* Watch the tasks of loop() from now on */
+  Watchdog_Initialise();
 
+  /* NTP is started in loop() after Wifi connected */
 }
 
 /*===========================================================================*/
 
 void loop()
 {
-  UINT32  Count;
   BOOL    Ret = TRUE;
-
-  UINT32        Current_Hour;
-  UINT32        Current_Minute;
-  UINT32        Today_Minutes;        /* Mintues since the beginning of today */
-  UINT32        Timing_On_Minutes;
-  UINT32        Timing_Off_Minutes;
-  DateTimeParts Current_Parts = DateTime.getParts();
+  BOOL    New_Relay_Status;
+  BOOL    Distance_Valid;
+  FLOAT   Raw_Distance_cm;
+
+  LOCAL_TIME_RECORD   Current_Time;
+  RELAY_INPUT_RECORD  Relay_Input;
+  STR_BUILDER_RECORD  Payload;
+  UINT16              Arena_Mark_Pos;
+  MY_STATUS_RECORD    Status;
+
+  /* A new pass, and the stall before this boot reported */
+  Watchdog_Handle();
+
+  /* Roll the local clock, no calendar math unless the minute rolls over */
+  Local_Clock_Handle();
+
+  /* Bring up Wifi, NTP and report the boot profile in background */
+  Watchdog_Begin( WATCHDOG_TASK_WIFI );
+  Wifi_Handle();
+  Watchdog_Begin( WATCHDOG_TASK_NTP );
+  Sntp_Handle();
+  Boot_NTP_Handle();
+  Watchdog_Begin( WATCHDOG_TASK_PUBLISH );
+  Boot_Profile_Handle();
+  Watchdog_End();
 
   /* Every 1 sec, flash LED and check wifi state
      If Wifi is disconnected, flash quickly */
@@ -165,37 +265,65 @@ void loop()
 
   /*---------------------------------------------------------------------------*/
 
+  /* Just connected, the reports start at a random point of their period,
+     so a fleet that reconnected together doesn't report together */
+  if ( !mqtt_is_connected() )
+  {
+    last_mqtt_connect_timestamp_ms = 0;
+  }
+  else if ( last_mqtt_connect_timestamp_ms == 0 )
+  {
+    last_mqtt_connect_timestamp_ms = millis();
+    last_mqtt_report_timestamp_ms  = last_mqtt_connect_timestamp_ms - MQTT_REPORT_INTERVAL_MS +
+                                     (ESP.random() % MQTT_REPORT_INTERVAL_MS);
+  }
+
   /* Every 5 sec, Publish MQTT messages */
-   if ( (millis() - last_mqtt_report_timestamp_ms ) > (1000*5) )
+   if ( (millis() - last_mqtt_report_timestamp_ms ) > MQTT_REPORT_INTERVAL_MS )
   {
     last_mqtt_report_timestamp_ms = millis();
+    Watchdog_Begin( WATCHDOG_TASK_PUBLISH );
+
+    /* One copy, so the relay and the distances are from the same moment */
+    My_Status_Read( &Status );
 
     /* Alive status */
-    Ret &= mqtt_publish("alive_status", "on");
+    Ret &= mqtt_publish(PSTR("alive_status"), "on");
 
     /* Relay status */
-    Ret &= mqtt_publish("relay_status", My_Status.relay_status?"on":"off");
+    Ret &= mqtt_publish(PSTR("relay_status"), Status.relay_status?"on":"off");
 
     /* Relay auto config */
-    Ret &= mqtt_publish("auto_control_relay", My_Config.relay_auto?"true":"false");
+    Ret &= mqtt_publish(PSTR("auto_control_relay"), My_Config.relay_auto?"true":"false");
 
-    /* Publish timing config or sonar distance according to relay_auto config */
+    /* Watchdog config */
+    Ret &= mqtt_publish(PSTR("wdt_enable"), My_Config.wdt_enable?"true":"false");
+
+    /* Publish timing config or sonar distance according to relay_auto config,
+       the payloads are formatted in the request arena without soft-float */
+    Arena_Mark_Pos = Arena_Mark( &Request_Arena );
+    Str_Builder_Init( &Payload, &Request_Arena, 16 );
     if ( My_Config.relay_auto == TRUE )
     {
       /* Sonar raw and average distance */
-      Ret &= mqtt_publish("raw_distance", String(My_Status.raw_distance_cm, 2) );
-      Ret &= mqtt_publish("avg_distance", String(My_Status.avg_distance_cm, 2) );
+      Str_Builder_Append_Fixed( &Payload, Status.raw_distance_cm, 2 );
+      Ret &= mqtt_publish(PSTR("raw_distance"), Payload.pBuff );
+      Str_Builder_Clear( &Payload );
+      Str_Builder_Append_Fixed( &Payload, Status.avg_distance_cm, 2 );
+      Ret &= mqtt_publish(PSTR("avg_distance"), Payload.pBuff );
     }
     else
     {
-      Ret &= mqtt_publish("relay_timing_on_enable", My_Config.relay_on_timing.valid?"true":"false");
-      Ret &= mqtt_publish("relay_timing_on_time", String( (My_Config.relay_on_timing.hh +
-                                                     (FLOAT)My_Config.relay_on_timing.mm/60), 1));
-
-      Ret &= mqtt_publish("relay_timing_off_enable", My_Config.relay_off_timing.valid?"true":"false");
-      Ret &= mqtt_publish("relay_timing_off_time", String( (My_Config.relay_off_timing.hh +
-                                                      (FLOAT)My_Config.relay_off_timing.mm/60), 1));
+      Ret &= mqtt_publish(PSTR("relay_timing_on_enable"), My_Config.relay_on_timing.valid?"true":"false");
+      Str_Builder_Append_Fixed( &Payload, My_Config.relay_on_timing.hh + (FLOAT)My_Config.relay_on_timing.mm/60, 1 );
+      Ret &= mqtt_publish(PSTR("relay_timing_on_time"), Payload.pBuff );
+      Str_Builder_Clear( &Payload );
+
+      Ret &= mqtt_publish(PSTR("relay_timing_off_enable"), My_Config.relay_off_timing.valid?"true":"false");
+      Str_Builder_Append_Fixed( &Payload, My_Config.relay_off_timing.hh + (FLOAT)My_Config.relay_off_timing.mm/60, 1 );
+      Ret &= mqtt_publish(PSTR("relay_timing_off_time"), Payload.pBuff );
     }
+    Arena_Release( &Request_Arena, Arena_Mark_Pos );
 
     LOG( DBG_N, "MQTT: Publish %s every 5 sec.\n", Ret?"success":"failed" );
 
@@ -209,22 +337,7 @@ void loop()
       led_flash_interval_ms = 200;
     }
 
-  }
-
-  /*---------------------------------------------------------------------------*/
-
-  /* Every 30 mins, update NTP time */
-  if ( (millis() - last_sync_ntp_timestamp_ms ) > (1000*60*30) )
-  {
-    last_sync_ntp_timestamp_ms = millis();
-    if( DateTime.begin(500) == false )
-    {
-      LOG( DBG_E, "NTP: Sync NTP failed.\n");
-    }
-    else
-    {
-      LOG( DBG_N, "NTP: Sync NTP success.\n");
-    }
+    Watchdog_End();
   }
 
   /*---------------------------------------------------------------------------*/
@@ -233,18 +346,13 @@ void loop()
   if ( (millis() - last_time_str_update_timestamp_ms ) > (1000*10) )
   {
     last_time_str_update_timestamp_ms = millis();
-    if ( !DateTime.isTimeValid() )
+    /* Not synced yet, the SNTP client retries by itself */
+    if ( Local_Clock_Is_Valid() )
     {
-      LOG( DBG_E, "NTP: Failed to get time from server, retry.\n");
-      if( DateTime.begin(500) == false )
-      {
-        LOG( DBG_E, "NTP: Sync NTP failed.\n");
-      }
-    }
-    else
-    {
-      My_Status.local_timestamp_s = DateTime.now();
-      sprintf( My_Status.local_time_str, "%s", DateTime.toString().c_str() );
+      My_Status_Write_Begin();
+      My_Status.local_timestamp_s = Local_Clock_Now_s();
+      Local_Clock_Format( My_Status.local_time_str, LOCALTIME_STR_MAX_SIZE );
+      My_Status_Write_End();
       LOG( DBG_I, "NTP: DateTime: %s\n", My_Status.local_time_str );
     }
   }
@@ -252,138 +360,85 @@ void loop()
   /*---------------------------------------------------------------------------*/
 
 #if 1
-  /* Every 1 sec, update sonar distance and average the sonar distance */
-  if ( (millis() - last_measure_sonar_timestamp_ms ) > 1000 )
+  /* Update sonar distance and average the sonar distance, the samples are
+     taken by the timer at SONAR_SAMPLE_HZ and wait here however late loop() is */
+  Watchdog_Begin( WATCHDOG_TASK_SAMPLING );
+  while ( Sonar_Sampler_Get( &Raw_Distance_cm ) )
   {
-    last_measure_sonar_timestamp_ms = millis();
-    My_Status.raw_distance_cm = SR04_Get_Distance();
-    My_Status.distance_valid  = (My_Status.raw_distance_cm==0)?FALSE:TRUE;
+    if ( Trace_Is_Active() )
+    {
+      Trace_Sample( Raw_Distance_cm,
+                    Local_Clock_Get( &Current_Time ) ? (Current_Time.hour*60 + Current_Time.minute) : -1 );
+    }
 
-    /* Update average distance */
-    if ( My_Status.distance_valid == TRUE )
+    /* Update average distance, a sample and its average change as one */
+    Distance_Valid = Sonar_Filter_Add( &Sonar_Filter, Raw_Distance_cm );
+    My_Status_Write_Begin();
+    My_Status.raw_distance_cm = Raw_Distance_cm;
+    My_Status.distance_valid  = Distance_Valid;
+    My_Status.avg_distance_cm = Sonar_Filter.avg_distance_cm;
+    My_Status_Write_End();
+    if ( !Distance_Valid )
     {
-      /* Update history records */
-      Sonar_Distance_History[Sonar_Distance_History_Index] = My_Status.raw_distance_cm;
-      Sonar_Distance_History_Index = CIRCULAR_INC( Sonar_Distance_History_Index, DISTANCE_WINDOW_LPF_WIDTH);
-
-      /* Do average */
-      My_Status.avg_distance_cm = 0;
-      for (Count = 0; Count < DISTANCE_WINDOW_LPF_WIDTH; ++Count)
-      {
-        My_Status.avg_distance_cm += Sonar_Distance_History[Count];
-      }
-      My_Status.avg_distance_cm = My_Status.avg_distance_cm/DISTANCE_WINDOW_LPF_WIDTH;
+      Metric_Inc( METRIC_SONAR_INVALID );
     }
   }
+  Watchdog_End();
 #endif
 
   /*---------------------------------------------------------------------------*/
 
   /* Operate the delay according to sonar distance when relay_auto is on
      Operate the delay according to timing when relay_auto is off */
-  if ( My_Config.relay_auto == TRUE )
-  {
-    if ( My_Status.distance_valid == TRUE )
-    {
-      /* More than high distance means low water level, turn off relay
-         Less than low distance means high water level, turn on relay
-         To avoid switch relay frequently */
-      if ( My_Status.avg_distance_cm > My_Config.high_distance_cm )
-      {
-        My_Status.relay_status = FALSE;
-      }
-
-      if ( My_Status.avg_distance_cm < My_Config.low_distance_cm )
-      {
-        My_Status.relay_status = TRUE;
-      }
-    }
-    else
-    {
-      My_Status.relay_status = FALSE;
-    }
-  }
-  else
-  {
-    Current_Hour    = (UINT32)Current_Parts.getHours();
-    Current_Minute  = (UINT32)Current_Parts.getMinutes();
+  Relay_Input.distance_valid  = My_Status.distance_valid;
+  Relay_Input.avg_distance_cm = My_Status.avg_distance_cm;
+  Relay_Input.time_valid      = Local_Clock_Get( &Current_Time );
+  Relay_Input.hour            = Current_Time.hour;
+  Relay_Input.minute          = Current_Time.minute;
 
-    /* If both timing on and off are enabled, operate relay in time range
-       else operate relay by time point.
-       Because if only refer to time point, the relay status may be wrong after ESP reboot */
-    if ( (My_Config.relay_on_timing.valid == TRUE) && (My_Config.relay_off_timing.valid == TRUE) )
-    {
-      Today_Minutes       = Current_Hour*60 + Current_Minute;
-      Timing_On_Minutes   = My_Config.relay_on_timing.hh*60 + My_Config.relay_on_timing.mm;
-      Timing_Off_Minutes  = My_Config.relay_off_timing.hh*60 + My_Config.relay_off_timing.mm;
-
-      if( Timing_Off_Minutes >= Timing_On_Minutes )
-      {
-        /* NOT include 00:00 */
-        if ( (Today_Minutes >= Timing_On_Minutes) && (Today_Minutes < Timing_Off_Minutes) )
-        {
-          My_Status.relay_status = TRUE;
-        }
-        else
-        {
-          My_Status.relay_status = FALSE;
-        }
-      }
-      else
-      {
-        /* Include 00:00 */
-        if ( (Today_Minutes >= Timing_On_Minutes) || (Today_Minutes < Timing_Off_Minutes) )
-        {
-          My_Status.relay_status = TRUE;
-        }
-        else
-        {
-          My_Status.relay_status = FALSE;
-        }
-      }
-    }
-    else
-    {
-      /* Check if it is time to turn on/off relay */
-
-      if ( My_Config.relay_on_timing.valid )
-      {
-        if ( (My_Config.relay_on_timing.hh == Current_Hour) && (My_Config.relay_on_timing.mm == Current_Minute) )
-        {
-          My_Status.relay_status = TRUE;
-        }
-      }
-
-      if ( My_Config.relay_off_timing.valid )
-      {
-        if ( (My_Config.relay_off_timing.hh == Current_Hour) && (My_Config.relay_off_timing.mm == Current_Minute) )
-        {
-          My_Status.relay_status = FALSE;
-        }
-      }
-    }
-  }
+  New_Relay_Status = Relay_Decide( &My_Config, &Relay_Input, My_Status.relay_status );
 
   /*---------------------------------------------------------------------------*/
 
-  /* Apply the status of relay */
-  if ( My_Status.relay_status == TRUE )
+  /* Apply the status of relay, the same path as the commands */
+  if ( New_Relay_Status != My_Status.relay_status )
   {
-    digitalWrite(GPIO_RELAY,    HIGH);
-//    digitalWrite(GPIO_LED_RED,  HIGH);
+    Relay_Actuate( New_Relay_Status, RELAY_SOURCE_AUTO, micros() );
   }
-  else
+
+  /* Persist it, so it can be restored at once after a brownout */
+  if ( My_Status.relay_status != Last_Saved_Relay_Status )
   {
-    digitalWrite(GPIO_RELAY,    LOW);
-//    digitalWrite(GPIO_LED_RED,  LOW);
+    if ( My_State_Save( My_Status.relay_status ) == FN_RETURN_OK )
+    {
+      Last_Saved_Relay_Status = My_Status.relay_status;
+    }
   }
 
+  /* A sample a minute into the history, once the clock is set */
+  History_Handle();
+
   /*---------------------------------------------------------------------------*/
 
   /* Web page handle */
+  Watchdog_Begin( WATCHDOG_TASK_HTTP );
   http_handle_client();
 
   /* MQTT server communication and subscribe handle */
+  Watchdog_Begin( WATCHDOG_TASK_MQTT );
   mqtt_handle_client();
+  Watchdog_End();
+
+  /* Loop rate, heap watermarks and the metrics snapshot */
+  Metrics_Handle();
+
+  /* A log repeated and then quiet, its summary not held back */
+  LOG_Handle();
+
+  /* Stop the profiler when its time is up and publish the profile */
+  Profiler_Handle();
+
+  /* Micro-benchmarks, only with BENCH_ENABLE */
+  Bench_Handle();
 }
 
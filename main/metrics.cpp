@@ -0,0 +1,457 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   metrics.cpp
+@brief  Metrics registry, counters and gauges with watermarks
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+All metrics live in one fixed array, updating one is an array write, no
+allocation and no formatting. Heap and loop rate are sampled by
+Metrics_Handle() once per METRICS_SAMPLE_MS, with min/max watermarks.
+
+They are served as Prometheus text exposition on /metrics, and a JSON
+snapshot is published over MQTT every METRICS_SNAPSHOT_MS.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "metrics.h"
+#include "mqtt_client.h"
+#include "flash_string.h"
+#include "arena.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static const METRIC_DESC_RECORD Metric_Desc[NUM_METRICS] PROGMEM =
+{
+  { "esp_uptime_seconds",            "",                    "uptime",
+    "Seconds since boot",                                       METRIC_TYPE_GAUGE },
+  { "esp_loop_rate_hz",              "",                    "loop_hz",
+    "loop() iterations per second",                             METRIC_TYPE_GAUGE },
+  { "esp_loop_rate_min_hz",          "",                    "loop_hz_min",
+    "Lowest loop() iterations per second since boot",           METRIC_TYPE_GAUGE },
+  { "esp_heap_free_bytes",           "",                    "heap",
+    "Free heap",                                                METRIC_TYPE_GAUGE },
+  { "esp_heap_free_min_bytes",       "",                    "heap_min",
+    "Lowest free heap since boot",                              METRIC_TYPE_GAUGE },
+  { "esp_heap_max_block_bytes",      "",                    "block",
+    "Largest free heap block",                                  METRIC_TYPE_GAUGE },
+  { "esp_heap_max_block_min_bytes",  "",                    "block_min",
+    "Smallest largest free heap block since boot",              METRIC_TYPE_GAUGE },
+  { "esp_heap_fragmentation_percent", "",                   "frag",
+    "Heap fragmentation",                                       METRIC_TYPE_GAUGE },
+  { "esp_heap_fragmentation_max_percent", "",               "frag_max",
+    "Highest heap fragmentation since boot",                    METRIC_TYPE_GAUGE },
+  { "mqtt_publish_total",            "result=\"ok\"",       "pub_ok",
+    "MQTT publishes",                                           METRIC_TYPE_COUNTER },
+  { "mqtt_publish_total",            "result=\"failed\"",   "pub_fail",
+    "MQTT publishes",                                           METRIC_TYPE_COUNTER },
+  { "mqtt_connects_total",           "",                    "mqtt_conn",
+    "MQTT broker connections, the first one included",          METRIC_TYPE_COUNTER },
+  { "mqtt_connect_failures_total",   "",                    "mqtt_fail",
+    "Broker connects failed in TCP or TLS",                     METRIC_TYPE_COUNTER },
+  { "mqtt_handshake_ms",             "session=\"new\"",     "hs_new_ms",
+    "Last broker connect, TCP and TLS handshake",               METRIC_TYPE_GAUGE },
+  { "mqtt_handshake_ms",             "session=\"cached\"",  "hs_cached_ms",
+    "Last broker connect, TCP and TLS handshake",               METRIC_TYPE_GAUGE },
+  { "mqtt_tls_heap_bytes",           "",                    "tls_heap",
+    "Heap the TLS connection holds",                            METRIC_TYPE_GAUGE },
+  { "mqtt_tls_stack_max_bytes",      "",                    "tls_stack",
+    "Most of the BearSSL stack used since boot",                METRIC_TYPE_GAUGE },
+  { "mqtt_qos1_retransmits_total",   "",                    "qos_retx",
+    "QoS 1 publishes sent again for a late PUBACK",             METRIC_TYPE_COUNTER },
+  { "mqtt_qos1_duplicates_total",    "",                    "qos_dup",
+    "QoS 1 commands received again, not applied",              METRIC_TYPE_COUNTER },
+  { "mqtt_qos1_ack_ms",              "",                    "qos_ack_ms",
+    "Last QoS 1 publish, handed in to PUBACK",                  METRIC_TYPE_GAUGE },
+  { "mqtt_rx_skipped_total",         "",                    "rx_skip",
+    "Packets over the receive buffer, dropped",                 METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/\"",          "http_index",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/wifi\"",      "http_wifi",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/control\"",   "http_control",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/metrics\"",   "http_metrics",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/update\"",    "http_update",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/profile\"",   "",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"/api/history\"", "",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_requests_total",           "path=\"other\"",      "http_other",
+    "HTTP requests by path",                                    METRIC_TYPE_COUNTER },
+  { "http_turned_away_total",        "code=\"429\"",        "http_429",
+    "HTTP requests over budget or not ready",                   METRIC_TYPE_COUNTER },
+  { "http_turned_away_total",        "code=\"503\"",        "http_503",
+    "HTTP requests over budget or not ready",                   METRIC_TYPE_COUNTER },
+  { "eeprom_commits_total",          "",                    "eeprom",
+    "EEPROM commits, each one wears the flash",                 METRIC_TYPE_COUNTER },
+  { "ota_failures_total",            "",                    "ota_fail",
+    "Firmware updates refused or broken off",                   METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"loop\"",       "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"sampling\"",   "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"publish\"",    "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"http\"",       "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"mqtt\"",       "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"ntp\"",        "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_stalls_total",         "task=\"wifi\"",       "",
+    "Tasks over their deadline, since power on",                METRIC_TYPE_COUNTER },
+  { "watchdog_resets_total",         "",                    "wdt_reset",
+    "Resets by the watchdog, since power on",                   METRIC_TYPE_COUNTER },
+  { "sonar_invalid_samples_total",   "",                    "sonar_inv",
+    "Sonar samples without an echo",                            METRIC_TYPE_COUNTER },
+  { "log_suppressed_total",          "",                    "log_drop",
+    "Log lines dropped by rate limiting",                       METRIC_TYPE_COUNTER },
+  { "request_arena_peak_bytes",      "",                    "arena_peak",
+    "Most of the request arena used at once",                   METRIC_TYPE_GAUGE },
+  { "request_arena_failures_total",  "",                    "arena_fail",
+    "Request arena allocations that didn't fit",                METRIC_TYPE_COUNTER },
+  { "sonar_samples_total",           "",                    "sonar",
+    "Sonar samples taken by loop()",                            METRIC_TYPE_COUNTER },
+  { "sonar_queue_drops_total",       "",                    "sonar_drop",
+    "Sonar samples lost to a full queue",                       METRIC_TYPE_COUNTER },
+  { "sonar_jitter_us",               "",                    "jitter",
+    "Last sonar ping interval off its period",                  METRIC_TYPE_GAUGE },
+  { "sonar_jitter_max_us",           "",                    "jitter_max",
+    "Most a sonar ping interval was off since boot",            METRIC_TYPE_GAUGE },
+  { "sonar_wait_max_ms",             "",                    "sonar_wait",
+    "Longest a sonar sample waited for loop()",                 METRIC_TYPE_GAUGE },
+  { "history_blocks_total",          "",                    "",
+    "History blocks written to flash",                          METRIC_TYPE_COUNTER },
+  { "history_write_failures_total",  "",                    "",
+    "History blocks that couldn't be written",                  METRIC_TYPE_COUNTER },
+  { "relay_gpio_latency_us_bucket",  "le=\"1000\"",         "",
+    "Relay command received to GPIO written",                   METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"2000\"",         "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"5000\"",         "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"10000\"",        "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"20000\"",        "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"50000\"",        "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"100000\"",       "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_bucket",  "le=\"+Inf\"",         "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_sum",     "",                    "gpio_us_sum",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_gpio_latency_us_count",   "",                    "gpio_n",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"1000\"",         "",
+    "Relay command received to new state published",           METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"2000\"",         "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"5000\"",         "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"10000\"",        "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"20000\"",        "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"50000\"",        "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"100000\"",       "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_bucket",   "le=\"+Inf\"",         "",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_sum",      "",                    "ack_us_sum",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+  { "relay_ack_latency_us_count",    "",                    "ack_n",
+    "",                                                         METRIC_TYPE_HISTOGRAM },
+};
+
+/* Upper bounds of the latency histogram buckets, matching the le labels */
+static const UINT32 Metric_Latency_Bounds_us[METRIC_LATENCY_BUCKETS] PROGMEM =
+{
+  1000, 2000, 5000, 10000, 20000, 50000, 100000
+};
+
+static UINT32 Metric_Value[NUM_METRICS];
+
+/* Loop rate */
+static UINT32 Metrics_Loop_Count      = 0;
+static UINT32 Metrics_Last_Sample_ms  = 0;
+static UINT32 Metrics_Last_Snapshot_ms = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Metrics_Sample( UINT32 Elapsed_ms );
+static UINT8  Metrics_Family_Len( const METRIC_DESC_RECORD *pDesc );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Sample the heap and the loop rate */
+static void
+Metrics_Sample( UINT32 Elapsed_ms )
+{
+  uint32_t  Free;
+  uint16_t  Max_Block;
+  uint8_t   Frag;
+
+  ESP.getHeapStats( &Free, &Max_Block, &Frag );
+
+  Metric_Set( METRIC_HEAP_FREE, Free );
+  Metric_Min( METRIC_HEAP_FREE_MIN, Free );
+  Metric_Set( METRIC_HEAP_MAX_BLOCK, Max_Block );
+  Metric_Min( METRIC_HEAP_MAX_BLOCK_MIN, Max_Block );
+  Metric_Set( METRIC_HEAP_FRAG, Frag );
+  Metric_Max( METRIC_HEAP_FRAG_MAX, Frag );
+
+  if ( Elapsed_ms > 0 )
+  {
+    Metric_Set( METRIC_LOOP_RATE, Metrics_Loop_Count * 1000 / Elapsed_ms );
+    Metric_Min( METRIC_LOOP_RATE_MIN, Metric_Value[METRIC_LOOP_RATE] );
+  }
+  Metrics_Loop_Count = 0;
+
+  Metric_Set( METRIC_UPTIME_S, millis() / 1000 );
+  Metric_Set( METRIC_LOG_SUPPRESSED, LOG_Get_Suppressed_Count() );
+  Metric_Set( METRIC_ARENA_PEAK, Request_Arena.peak );
+  Metric_Set( METRIC_ARENA_FAILURES, Request_Arena.failures );
+}
+
+/*===========================================================================*/
+
+void
+Metric_Inc( METRIC_ID Id )
+{
+  Metric_Value[Id]++;
+}
+
+/*===========================================================================*/
+
+void
+Metric_Set( METRIC_ID Id, UINT32 Value )
+{
+  Metric_Value[Id] = Value;
+}
+
+/*===========================================================================*/
+
+/* Low watermark */
+void
+Metric_Min( METRIC_ID Id, UINT32 Value )
+{
+  if ( Value < Metric_Value[Id] )
+  {
+    Metric_Value[Id] = Value;
+  }
+}
+
+/*===========================================================================*/
+
+/* High watermark */
+void
+Metric_Max( METRIC_ID Id, UINT32 Value )
+{
+  if ( Value > Metric_Value[Id] )
+  {
+    Metric_Value[Id] = Value;
+  }
+}
+
+/*===========================================================================*/
+
+/* Count a latency into a histogram, its first entry is given */
+void
+Metric_Observe_Latency( METRIC_ID Histogram, UINT32 Value_us )
+{
+  UINT8   Bucket;
+
+  /* The buckets are cumulative */
+  for ( Bucket = 0; Bucket < METRIC_LATENCY_BUCKETS; Bucket++ )
+  {
+    if ( Value_us <= pgm_read_dword( &Metric_Latency_Bounds_us[Bucket] ) )
+    {
+      Metric_Value[Histogram + Bucket]++;
+    }
+  }
+
+  Metric_Value[Histogram + METRIC_LATENCY_BUCKETS]++;
+  Metric_Value[Histogram + METRIC_LATENCY_BUCKETS + 1] += Value_us;
+  Metric_Value[Histogram + METRIC_LATENCY_BUCKETS + 2]++;
+}
+
+/*===========================================================================*/
+
+UINT32
+Metric_Get( METRIC_ID Id )
+{
+  return Metric_Value[Id];
+}
+
+/*===========================================================================*/
+
+void
+Metrics_Initialise( void )
+{
+  /* Counters are zero from boot, low watermarks start high */
+  Metric_Value[METRIC_LOOP_RATE_MIN]      = 0xFFFFFFFF;
+  Metric_Value[METRIC_HEAP_FREE_MIN]      = 0xFFFFFFFF;
+  Metric_Value[METRIC_HEAP_MAX_BLOCK_MIN] = 0xFFFFFFFF;
+
+  Metrics_Last_Sample_ms   = millis();
+  Metrics_Last_Snapshot_ms = millis();
+  Metrics_Sample( 0 );
+}
+
+/*===========================================================================*/
+
+/* Count the loop, sample and publish when it's time, to call at each sketch loop() */
+void
+Metrics_Handle( void )
+{
+  CHAR    Snapshot[METRICS_SNAPSHOT_MAX_SIZE];
+  UINT32  Now_ms = millis();
+
+  Metrics_Loop_Count++;
+
+  /* Catch the dips between the samples */
+  Metric_Min( METRIC_HEAP_FREE_MIN, ESP.getFreeHeap() );
+
+  if ( (Now_ms - Metrics_Last_Sample_ms) >= METRICS_SAMPLE_MS )
+  {
+    Metrics_Sample( Now_ms - Metrics_Last_Sample_ms );
+    Metrics_Last_Sample_ms = Now_ms;
+  }
+
+  if ( ((Now_ms - Metrics_Last_Snapshot_ms) >= METRICS_SNAPSHOT_MS) && mqtt_is_connected() )
+  {
+    Metrics_Last_Snapshot_ms = Now_ms;
+    Metrics_Format_Snapshot( Snapshot, sizeof(Snapshot) );
+    mqtt_publish( PSTR(METRICS_SNAPSHOT_TOPIC), Snapshot );
+  }
+}
+
+/*===========================================================================*/
+
+/* Length of the family name, a histogram entry without its suffix */
+static UINT8
+Metrics_Family_Len( const METRIC_DESC_RECORD *pDesc )
+{
+  const CHAR  *pSuffix = strrchr( pDesc->name, '_' );
+
+  if ( (pDesc->type == METRIC_TYPE_HISTOGRAM) && (pSuffix != NULL) )
+  {
+    return pSuffix - pDesc->name;
+  }
+
+  return strlen( pDesc->name );
+}
+
+/*===========================================================================*/
+
+/*!
+Format one metric in the text exposition, with HELP and TYPE lines if it's
+the first of its family.
+
+@param  Id      Metric, (I)
+@param  pBuff   Buffer, (O)
+@param  Size    Buffer size, (I)
+@return The length written
+*/
+UINT16
+Metrics_Format_Line( METRIC_ID Id, CHAR *pBuff, UINT16 Size )
+{
+  METRIC_DESC_RECORD  Desc;
+  METRIC_DESC_RECORD  Prev;
+  INT32               Len = 0;
+  UINT8               Family_Len;
+
+  memcpy_P( &Desc, &Metric_Desc[Id], sizeof(Desc) );
+  Family_Len = Metrics_Family_Len( &Desc );
+
+  if ( Id > 0 )
+  {
+    memcpy_P( &Prev, &Metric_Desc[Id - 1], sizeof(Prev) );
+  }
+
+  if ( (Id == 0) || (Metrics_Family_Len( &Prev ) != Family_Len) || (strncmp( Desc.name, Prev.name, Family_Len ) != 0) )
+  {
+    Len = snprintf_P( pBuff, Size, PSTR("# HELP %.*s %s\n# TYPE %.*s %s\n"),
+                      Family_Len, Desc.name, Desc.help, Family_Len, Desc.name,
+                      (Desc.type == METRIC_TYPE_COUNTER) ? "counter" :
+                      (Desc.type == METRIC_TYPE_GAUGE) ? "gauge" : "histogram" );
+    Len = ( Len < Size ) ? Len : (Size - 1);
+  }
+
+  if ( Desc.labels[0] != 0 )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%s{%s} %lu\n"), Desc.name, Desc.labels, Metric_Value[Id] );
+  }
+  else
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%s %lu\n"), Desc.name, Metric_Value[Id] );
+  }
+
+  return ( Len < Size ) ? Len : (Size - 1);
+}
+
+/*===========================================================================*/
+
+/* Format all metrics as one JSON object with the short keys */
+UINT16
+Metrics_Format_Snapshot( CHAR *pBuff, UINT16 Size )
+{
+  INT32   Len = 0;
+  UINT8   Id;
+  CHAR    Key[sizeof(Metric_Desc[0].key)];
+
+  for ( Id = 0; (Id < NUM_METRICS) && (Len < Size); Id++ )
+  {
+    /* Histogram buckets are only on /metrics */
+    if ( Flash_String_Copy( Key, sizeof(Key), Metric_Desc[Id].key ) == 0 )
+    {
+      continue;
+    }
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%c\"%s\":%lu"),
+                       (Len == 0) ? '{' : ',', Key, Metric_Value[Id] );
+  }
+
+  if ( Len < Size )
+  {
+    Len += snprintf( pBuff + Len, Size - Len, "}" );
+  }
+
+  return ( Len < Size ) ? Len : (Size - 1);
+}
+
+/*===========================================================================*/
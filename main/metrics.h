@@ -0,0 +1,171 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   metrics.h
+@brief  Metrics registry, counters and gauges with watermarks, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Heap and loop rate are sampled at this interval */
+#define METRICS_SAMPLE_MS           1000
+
+/* Snapshot published over MQTT at this interval */
+#define METRICS_SNAPSHOT_MS         60000
+#define METRICS_SNAPSHOT_TOPIC      "metrics"
+#define METRICS_SNAPSHOT_MAX_SIZE   992
+
+/* Longest line of the text exposition, with its HELP and TYPE lines */
+#define METRICS_LINE_MAX_SIZE       192
+
+typedef enum
+{
+  METRIC_TYPE_COUNTER = 0,
+  METRIC_TYPE_GAUGE,
+  METRIC_TYPE_HISTOGRAM,      /* Name ends in _bucket, _sum or _count */
+
+} METRIC_TYPE;
+
+/* Upper bounds of a latency histogram, 1 ms to 100 ms */
+#define METRIC_LATENCY_BUCKETS      7
+
+/* A latency histogram takes consecutive entries, from its first bucket:
+   METRIC_LATENCY_BUCKETS buckets, +Inf, sum and count */
+#define METRIC_LATENCY_ENTRIES      (METRIC_LATENCY_BUCKETS + 3)
+
+/* All metrics, a family with labels takes consecutive entries */
+typedef enum
+{
+  METRIC_UPTIME_S = 0,
+  METRIC_LOOP_RATE,
+  METRIC_LOOP_RATE_MIN,
+  METRIC_HEAP_FREE,
+  METRIC_HEAP_FREE_MIN,
+  METRIC_HEAP_MAX_BLOCK,
+  METRIC_HEAP_MAX_BLOCK_MIN,
+  METRIC_HEAP_FRAG,
+  METRIC_HEAP_FRAG_MAX,
+  METRIC_MQTT_PUBLISH_OK,
+  METRIC_MQTT_PUBLISH_FAILED,
+  METRIC_MQTT_CONNECTS,
+  METRIC_MQTT_CONNECT_FAILED,
+  METRIC_MQTT_HANDSHAKE_NEW_MS,
+  METRIC_MQTT_HANDSHAKE_CACHED_MS,
+  METRIC_MQTT_TLS_HEAP,
+  METRIC_MQTT_TLS_STACK_MAX,
+  METRIC_MQTT_QOS_RETRANSMITS,
+  METRIC_MQTT_QOS_DUPLICATES,
+  METRIC_MQTT_QOS_ACK_MS,
+  METRIC_MQTT_RX_SKIPPED,
+  METRIC_HTTP_INDEX,
+  METRIC_HTTP_WIFI,
+  METRIC_HTTP_CONTROL,
+  METRIC_HTTP_METRICS,
+  METRIC_HTTP_UPDATE,
+  METRIC_HTTP_PROFILE,
+  METRIC_HTTP_HISTORY,
+  METRIC_HTTP_NOT_FOUND,
+  METRIC_HTTP_REJECTED,
+  METRIC_HTTP_UNAVAILABLE,
+  METRIC_EEPROM_COMMITS,
+  METRIC_OTA_FAILURES,
+  METRIC_WATCHDOG_STALLS_LOOP,          /* One per WATCHDOG_TASK, in its order */
+  METRIC_WATCHDOG_STALLS_SAMPLING,
+  METRIC_WATCHDOG_STALLS_PUBLISH,
+  METRIC_WATCHDOG_STALLS_HTTP,
+  METRIC_WATCHDOG_STALLS_MQTT,
+  METRIC_WATCHDOG_STALLS_NTP,
+  METRIC_WATCHDOG_STALLS_WIFI,
+  METRIC_WATCHDOG_RESETS,
+  METRIC_SONAR_INVALID,
+  METRIC_LOG_SUPPRESSED,
+  METRIC_ARENA_PEAK,
+  METRIC_ARENA_FAILURES,
+  METRIC_SONAR_SAMPLES,
+  METRIC_SONAR_QUEUE_DROPS,
+  METRIC_SONAR_JITTER_US,
+  METRIC_SONAR_JITTER_MAX_US,
+  METRIC_SONAR_WAIT_MAX_MS,
+  METRIC_HISTORY_BLOCKS,
+  METRIC_HISTORY_WRITE_FAILED,
+  METRIC_RELAY_GPIO_LATENCY,
+  METRIC_RELAY_GPIO_LATENCY_END = METRIC_RELAY_GPIO_LATENCY + METRIC_LATENCY_ENTRIES - 1,
+  METRIC_RELAY_ACK_LATENCY,
+  METRIC_RELAY_ACK_LATENCY_END  = METRIC_RELAY_ACK_LATENCY + METRIC_LATENCY_ENTRIES - 1,
+  NUM_METRICS
+
+} METRIC_ID;
+
+/* Static description of one metric, the table is in flash so the strings are inline */
+typedef struct
+{
+  CHAR        name[36];     /* Family name in the text exposition */
+  CHAR        labels[20];   /* e.g. "path=\"/\"", empty if none */
+  CHAR        key[16];      /* Short key in the MQTT snapshot, not in it if empty */
+  CHAR        help[48];
+  METRIC_TYPE type;
+
+} METRIC_DESC_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Metric_Inc( METRIC_ID Id );
+
+extern void
+Metric_Set( METRIC_ID Id, UINT32 Value );
+
+extern void
+Metric_Min( METRIC_ID Id, UINT32 Value );
+
+extern void
+Metric_Max( METRIC_ID Id, UINT32 Value );
+
+extern void
+Metric_Observe_Latency( METRIC_ID Histogram, UINT32 Value_us );
+
+extern UINT32
+Metric_Get( METRIC_ID Id );
+
+extern void
+Metrics_Initialise( void );
+
+extern void
+Metrics_Handle( void );
+
+extern UINT16
+Metrics_Format_Line( METRIC_ID Id, CHAR *pBuff, UINT16 Size );
+
+extern UINT16
+Metrics_Format_Snapshot( CHAR *pBuff, UINT16 Size );
+
+#endif  /* __METRICS_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,102 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_backoff.h
+@brief  Reconnect delays, exponential with decorrelated jitter
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+When the broker restarts every gateway loses it in the same millisecond.
+With a fixed reconnect interval they all come back in the same millisecond
+too, again and again, and the broker gets the whole fleet at once each
+time. Here each delay is drawn between the base and three times the last
+delay, up to the cap:
+
+  Mqtt_Backoff_Init( &Backoff, 2000, 120000 );
+  Wait_ms = Mqtt_Backoff_Next( &Backoff, ESP.random() );    after a failure
+  Mqtt_Backoff_Reset( &Backoff );                           once stable
+
+The delays grow about as fast as doubling would, but two clients that
+failed together draw different ones, and keep drawing from different
+ranges, so they drift apart instead of retrying in step.
+
+All inline and without Arduino calls, the random number is passed in, so
+tools/reconnect_storm builds it on the host.
+*/
+
+#ifndef __MQTT_BACKOFF_H__
+#define __MQTT_BACKOFF_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+typedef struct
+{
+  uint32_t  base_ms;        /* Shortest delay */
+  uint32_t  cap_ms;         /* Longest delay */
+  uint32_t  last_ms;        /* The last delay drawn, base_ms after a reset */
+
+} MQTT_BACKOFF_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+static inline void
+Mqtt_Backoff_Reset( MQTT_BACKOFF_RECORD *pBackoff )
+{
+  pBackoff->last_ms = pBackoff->base_ms;
+}
+
+/*===========================================================================*/
+
+static inline void
+Mqtt_Backoff_Init( MQTT_BACKOFF_RECORD *pBackoff, uint32_t Base_ms, uint32_t Cap_ms )
+{
+  pBackoff->base_ms = Base_ms;
+  pBackoff->cap_ms  = Cap_ms;
+  Mqtt_Backoff_Reset( pBackoff );
+}
+
+/*===========================================================================*/
+
+/* The next delay, uniform between the base and three times the last one */
+static inline uint32_t
+Mqtt_Backoff_Next( MQTT_BACKOFF_RECORD *pBackoff, uint32_t Random )
+{
+  uint32_t  High_ms = pBackoff->last_ms * 3;
+
+  /* No overflow, whatever the cap */
+  if ( (High_ms > pBackoff->cap_ms) || (High_ms < pBackoff->last_ms) )
+  {
+    High_ms = pBackoff->cap_ms;
+  }
+
+  pBackoff->last_ms = pBackoff->base_ms + (Random % (High_ms - pBackoff->base_ms + 1));
+
+  return pBackoff->last_ms;
+}
+
+#endif  /* __MQTT_BACKOFF_H__ */
+
+/*===========================================================================*/
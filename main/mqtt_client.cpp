@@ -9,6 +9,31 @@ Copyright Mickey
 @note
 
 Description:
+A small MQTT 3.1.1 client of our own, on the connection from
+mqtt_transport.cpp, plain or TLS. Driven from loop(), it never waits for
+the broker except in the connect itself:
+
+  DISCONNECTED   Connect while Wifi is up, after a backoff delay
+  CONNACK_WAIT   CONNECT sent
+  CONNECTED      PINGREQ when nothing went out for a keep alive
+
+A whole fleet loses the broker at once when it restarts, so nothing here
+happens in step with the other gateways. The delay before each reconnect
+is drawn by mqtt_backoff.h, and only goes back to the base once a
+connection has held for MQTT_BACKOFF_STABLE_MS. After CONNACK the device
+subscribes at a random point in the first MQTT_SUBSCRIBE_SPREAD_MS, and
+publishes its state after that. The first connect after power on goes out
+at once, for the boot profile.
+
+Each device has its own topics, by chip ID, see mqtt_client.h. One
+SUBSCRIBE takes all of its commands with a wildcard, together with the
+broadcast ones if enabled, and the callback gets the command name, the
+topic after the prefix. So callers publish and compare names only.
+
+Commands come at QoS 1, a copy the broker sends again is acknowledged but
+not applied. mqtt_publish_qos1() is for state changes that must arrive,
+up to MQTT_QOS_WINDOW of them wait for PUBACK at once, they are sent again
+from the loop until acknowledged, and after a reconnect, see mqtt_qos.cpp.
 */
 
 /*=============================================================================
@@ -16,12 +41,26 @@ System Includes
 =============================================================================*/
 
 #include <ESP8266WiFi.h>
+#include <Client.h>
 
 /*=============================================================================
 Local Includes
 =============================================================================*/
 
 #include "mqtt_client.h"
+#include "mqtt_packet.h"
+#include "mqtt_transport.h"
+#include "mqtt_backoff.h"
+#include "mqtt_qos.h"
+#include "wifi_manager.h"
+#include "boot_profile.h"
+#include "bench.h"
+#include "relay_control.h"
+#include "relay_actuator.h"
+#include "trace.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "fixed_format.h"
 #include "esp8266_global.h"
 
 /*=============================================================================
@@ -30,32 +69,120 @@ Definitions
 
 /* MQTT server configs */
 #define MQTT_HOST "149.129.92.172"
+#ifdef MQTT_TLS_ENABLE
+#define MQTT_PORT 8883
+#else
 #define MQTT_PORT 1883
-#define MQTT_ID   "esp8266"
+#endif
+#define MQTT_ID   "esp8266-"
 #define MQTT_USER "zhuzhong"
 #define MQTT_PWD  "159357258"
 
+/* A PINGREQ goes out when nothing went out or came in for the keep alive */
+#define MQTT_KEEPALIVE_S            15
+
+/* Longest wait for CONNACK or PINGRESP */
+#define MQTT_RESPONSE_TIMEOUT_MS    10000
+
+/* Delays between connect attempts, and how long a connection must hold
+   before they start from the base again */
+#define MQTT_BACKOFF_BASE_MS        2000
+#define MQTT_BACKOFF_CAP_MS         120000
+#define MQTT_BACKOFF_STABLE_MS      60000
+
+/* The subscribe at a random point this long after CONNACK */
+#define MQTT_SUBSCRIBE_SPREAD_MS    2000
+
+/* Commands to every device */
+#define MQTT_BROADCAST_PREFIX       MQTT_TOPIC_ROOT "/" MQTT_BROADCAST_ID "/cmd/"
+
+/* Incoming packets, commands are short, longer ones are skipped */
+#define MQTT_RX_BUFFER_SIZE         256
+
+typedef enum
+{
+  MQTT_STATE_DISCONNECTED = 0,
+  MQTT_STATE_CONNACK_WAIT,
+  MQTT_STATE_CONNECTED,
+
+} MQTT_STATE;
+
+/* A packet too long for Mqtt_Rx, read through and dropped. A QoS 1 PUBLISH
+   still gets its PUBACK, else the broker keeps it in flight */
+typedef struct
+{
+  UINT32    left;           /* Bytes of it still to come, 0 if none */
+  UINT32    pos;            /* Bytes of it read */
+  UINT8     header_len;
+  BOOL      ack;            /* A QoS 1 PUBLISH */
+  UINT16    topic_len;
+  UINT16    packet_id;
+
+} MQTT_SKIP_RECORD;
+
 /*=============================================================================
 Static Variables
 =============================================================================*/
 
+/* Set from the chip ID at init, "esp8266-<id>", "<root>/<id>/cmd/#" and
+   "<root>/<id>/state/" */
+static CHAR       Mqtt_Client_Id[16];
+static CHAR       Mqtt_Cmd_Filter[MQTT_TOPIC_PREFIX_SIZE];
+static CHAR       Mqtt_State_Prefix[MQTT_TOPIC_PREFIX_SIZE];
+static UINT8      Mqtt_Cmd_Prefix_Len = 0;
+
+static Client     *pMqtt_Net          = NULL;
+static MQTT_STATE Mqtt_State          = MQTT_STATE_DISCONNECTED;
+static UINT32     Mqtt_State_Start_ms = 0;
+static BOOL       Mqtt_Tried          = FALSE;
+
+static MQTT_BACKOFF_RECORD  Mqtt_Backoff;
+static UINT32     Mqtt_Retry_ms       = 0;
+
+/* The subscribe after CONNACK, and when */
+static BOOL       Mqtt_Subscribed     = FALSE;
+static UINT32     Mqtt_Sub_Due_ms     = 0;
+
+/* Keep alive, a silent broker is pinged as well */
+static UINT32     Mqtt_Last_Tx_ms     = 0;
+static UINT32     Mqtt_Last_Rx_ms     = 0;
+static UINT32     Mqtt_Ping_Sent_ms   = 0;
+static BOOL       Mqtt_Ping_Pending   = FALSE;
+
+/* QoS 1 in both ways, and the packet identifiers */
+static MQTT_QOS_RECORD  Mqtt_Qos;
+
+static UINT8      Mqtt_Tx[MQTT_MAX_PACKET_SIZE];
+
+/* One more to terminate the payload in place */
+static UINT8      Mqtt_Rx[MQTT_RX_BUFFER_SIZE + 1];
+static UINT16     Mqtt_Rx_Len         = 0;
+static MQTT_SKIP_RECORD Mqtt_Rx_Skip;
+
 /*=============================================================================
 Global Variables
 =============================================================================*/
 
-EspMQTTClient mqtt_client(
-  MQTT_HOST,    // MQTT Broker server ip
-  MQTT_PORT,    // The MQTT port, default to 1883. this line can be omitted
-  MQTT_USER,    // Can be omitted if not needed
-  MQTT_PWD,     // Can be omitted if not needed
-  MQTT_ID       // Client name that uniquely identify your device
-);
-
 /*=============================================================================
 Static Prototypes
 =============================================================================*/
 
-static void mqtt_subscribe_callback(const String &topicStr, const String &message);
+static void   mqtt_set_state( MQTT_STATE State );
+static BOOL   mqtt_write( const UINT8 *pPacket, UINT16 Len );
+static BOOL   mqtt_send( UINT16 Len );
+static void   mqtt_send_due( void );
+static void   mqtt_connect( void );
+static void   mqtt_drop( const CHAR *pReason );
+static void   mqtt_retry_later( void );
+static void   mqtt_read( void );
+static void   mqtt_skip_start( UINT32 Packet_Len );
+static void   mqtt_skip( const UINT8 *pData, UINT16 Len );
+static void   mqtt_on_packet( MQTT_PACKET_RECORD *pPacket );
+static void   mqtt_on_connected( void );
+static void   mqtt_subscribe( UINT32 Now_ms );
+static const CHAR *mqtt_command_name( const CHAR *pTopic );
+static void   mqtt_state_topic( CHAR *pBuff, UINT16 Size, PGM_P pTopic );
+static void   mqtt_announce( void );
 
 /*=============================================================================
 Function Definitions
@@ -63,204 +190,649 @@ Function Definitions
 
 /*===========================================================================*/
 
-/* This function is called once everything is connected (Wifi and MQTT)
-   WARNING : YOU MUST IMPLEMENT IT IF YOU USE EspMQTTClient */
-void onConnectionEstablished()
+static void
+mqtt_set_state( MQTT_STATE State )
 {
-#if 0
-  // Subscribe to "mytopic/test" and display received message to Serial
-  client.subscribe("mytopic/test", [](const String & payload) {
-    Serial.println(payload);
-  });
-
-  // Subscribe to "mytopic/wildcardtest/#" and display received message to Serial
-  client.subscribe("mytopic/wildcardtest/#", [](const String & topic, const String & payload) {
-    Serial.println("(From wildcard) topic: " + topic + ", payload: " + payload);
-  });
-
-  // Publish a message to "mytopic/test"
-  client.publish("mytopic/test", "This is a message"); // You can activate the retain flag by setting the third parameter to true
-
-  // Execute delayed instructions
-  client.executeDelayed(5 * 1000, []() {
-    client.publish("mytopic/wildcardtest/test123", "This is a message sent 5 seconds later");
-  });
-#endif
+  Mqtt_State          = State;
+  Mqtt_State_Start_ms = millis();
+}
 
-  /* Subscribe the topics, this operation must after connected */
-  mqtt_client.subscribe("relay_status", mqtt_subscribe_callback);
-  mqtt_client.subscribe("relay_timing_on_enable", mqtt_subscribe_callback);
-  mqtt_client.subscribe("relay_timing_on_time", mqtt_subscribe_callback);
-  mqtt_client.subscribe("relay_timing_off_enable", mqtt_subscribe_callback);
-  mqtt_client.subscribe("relay_timing_off_time", mqtt_subscribe_callback);
-  mqtt_client.subscribe("auto_control_relay", mqtt_subscribe_callback);
-  mqtt_client.subscribe("high_distance", mqtt_subscribe_callback);
-  mqtt_client.subscribe("low_distance", mqtt_subscribe_callback);
+/*===========================================================================*/
 
-  /* Publish must done once here, othrewise publish in loop will block */
-  mqtt_publish("relay_status", My_Status.relay_status?"on":"off");
+static BOOL
+mqtt_write( const UINT8 *pPacket, UINT16 Len )
+{
+  if ( (Len == 0) || (pMqtt_Net->write( pPacket, Len ) != Len) )
+  {
+    return FALSE;
+  }
 
-  LOG( DBG_W, "MQTT broker connected.\n" );
+  Mqtt_Last_Tx_ms = millis();
+
+  return TRUE;
 }
 
 /*===========================================================================*/
 
-/* MQTT client initialise */
-void mqtt_client_init(void)
+/* Send the packet in Mqtt_Tx */
+static BOOL
+mqtt_send( UINT16 Len )
+{
+  return mqtt_write( Mqtt_Tx, Len );
+}
+
+/*===========================================================================*/
+
+/* The QoS 1 publishes that are new or whose PUBACK is late */
+static void
+mqtt_send_due( void )
 {
-  /* Optional functionalities of EspMQTTClient */
-//  mqtt_client.enableDebuggingMessages(); // Enable debugging messages sent to serial output
-//  mqtt_client.enableHTTPWebUpdater(); // Enable the web updater. User and password default to values of MQTTUsername and MQTTPassword. These can be overridded with enableHTTPWebUpdater("user", "password").
-//  mqtt_client.enableOTA(); // Enable OTA (Over The Air) updates. Password defaults to MQTTPassword. Port is the default OTA port. Can be overridden with enableOTA("password", port).
-//  mqtt_client.enableLastWillMessage("TestClient/lastwill", "I am going offline");  // You can activate the retain flag by setting the third parameter to true
+  const UINT8   *pPacket;
+  UINT16        Len;
 
-  LOG( DBG_P, "MQTT client Initialise Complete.\n" );
+  while ( (Mqtt_State == MQTT_STATE_CONNECTED) &&
+          ((pPacket = Mqtt_Qos_Due( &Mqtt_Qos, millis(), &Len )) != NULL) )
+  {
+    if ( pPacket[0] & MQTT_PUBLISH_DUP )
+    {
+      Metric_Inc( METRIC_MQTT_QOS_RETRANSMITS );
+    }
+    if ( !mqtt_write( pPacket, Len ) )
+    {
+      mqtt_drop( "QoS 1 publish not sent" );
+    }
+  }
 }
 
 /*===========================================================================*/
 
-/* Check the MQTT connecttion before publish */
-bool mqtt_publish(const String &topic, const String &payload)
+/* Open the connection and send CONNECT, CONNACK comes in mqtt_read() */
+static void
+mqtt_connect( void )
 {
-  bool ret;
+  Mqtt_Tried = TRUE;
+  mqtt_set_state( MQTT_STATE_DISCONNECTED );
+
+  pMqtt_Net = Mqtt_Transport_Connect( MQTT_HOST, MQTT_PORT );
+  if ( pMqtt_Net == NULL )
+  {
+    mqtt_retry_later();
+    return;
+  }
 
-  ret = mqtt_client.publish( topic.c_str(), payload.c_str() );
+  Mqtt_Rx_Len       = 0;
+  Mqtt_Rx_Skip.left = 0;
+  Mqtt_Last_Rx_ms   = millis();
+  Mqtt_Ping_Pending = FALSE;
 
-  LOG( DBG_I, "MQTT: Pub, topic(%s), message(%s)\n", topic.c_str(), payload.c_str() );
+  if ( !mqtt_send( Mqtt_Encode_Connect( Mqtt_Tx, sizeof(Mqtt_Tx), Mqtt_Client_Id, MQTT_USER, MQTT_PWD,
+                                        MQTT_KEEPALIVE_S, TRUE ) ) )
+  {
+    mqtt_drop( "CONNECT not sent" );
+    return;
+  }
 
-  return ret;
+  mqtt_set_state( MQTT_STATE_CONNACK_WAIT );
 }
 
 /*===========================================================================*/
 
-/* Main loop, to call at each sketch loop() */
-void mqtt_handle_client(void)
+static void
+mqtt_drop( const CHAR *pReason )
 {
-  mqtt_client.loop();
+  LOG( DBG_W, "MQTT: Disconnected, %s.\n", pReason );
+
+  Mqtt_Transport_Stop();
+  mqtt_set_state( MQTT_STATE_DISCONNECTED );
+  mqtt_retry_later();
 }
 
 /*===========================================================================*/
 
-/* MQTT callback function for all subscribed topics */
-void mqtt_subscribe_callback(const String &topicStr, const String &message)
+/* Draw the delay before the next connect */
+static void
+mqtt_retry_later( void )
 {
-  MY_CONFIG_RECORD  Config;
-  FLOAT             Time_hour;
-  FLOAT             Distance_cm;
+  Mqtt_Retry_ms = Mqtt_Backoff_Next( &Mqtt_Backoff, ESP.random() );
 
-  /* Copy the global config to local config.
-     Compare in the end of function, if config is modified, save the config */
-  memcpy( &Config, &My_Config, sizeof(MY_CONFIG_RECORD) );
+  LOG( DBG_N, "MQTT: Reconnect in %lu ms.\n", Mqtt_Retry_ms );
+}
 
-  /*---------------------------------------------------------------------------*/
+/*===========================================================================*/
 
-  /* Topic: 'test' */
-  if ( topicStr == "test" )
+/* Take what arrived, and handle each whole packet */
+static void
+mqtt_read( void )
+{
+  MQTT_PACKET_RECORD  Packet;
+  UINT32              Packet_Len;
+  INT8                Result;
+  int                 Count;
+  int                 Got;
+  UINT8               Saved;
+
+  Count = pMqtt_Net->available();
+  while ( (Count > 0) && (Mqtt_State != MQTT_STATE_DISCONNECTED) )
   {
-    /* Do nothing, only leave for test */
-  }
+    /* The rest of a packet too long for the buffer */
+    if ( Mqtt_Rx_Skip.left > 0 )
+    {
+      Got = pMqtt_Net->read( Mqtt_Rx, min( (UINT32)Count, min( Mqtt_Rx_Skip.left, (UINT32)MQTT_RX_BUFFER_SIZE ) ) );
+      if ( Got <= 0 )
+      {
+        break;
+      }
+      mqtt_skip( Mqtt_Rx, Got );
+      Count -= Got;
+      continue;
+    }
 
-  /*---------------------------------------------------------------------------*/
+    Got = pMqtt_Net->read( &Mqtt_Rx[Mqtt_Rx_Len], min( Count, MQTT_RX_BUFFER_SIZE - Mqtt_Rx_Len ) );
+    if ( Got <= 0 )
+    {
+      break;
+    }
+    Mqtt_Rx_Len += Got;
+    Count       -= Got;
 
-  /* Topic: 'relay_status' */
-  if ( topicStr == "relay_status" )
-  {
-    if ( message == "on" )
+    while ( (Result = Mqtt_Decode_Length( Mqtt_Rx, Mqtt_Rx_Len, &Packet_Len )) == 1 )
     {
-      My_Status.relay_status = TRUE;
+      if ( Packet_Len > MQTT_RX_BUFFER_SIZE )
+      {
+        LOG( DBG_W, "MQTT: Skip a %lu byte packet.\n", Packet_Len );
+        mqtt_skip_start( Packet_Len );
+        mqtt_skip( Mqtt_Rx, Mqtt_Rx_Len );
+        Mqtt_Rx_Len = 0;
+        break;
+      }
+      if ( Packet_Len > Mqtt_Rx_Len )
+      {
+        break;
+      }
+
+      Saved = Mqtt_Rx[Packet_Len];
+      Mqtt_Rx[Packet_Len] = 0;
+      if ( !Mqtt_Decode( Mqtt_Rx, Packet_Len, &Packet ) )
+      {
+        mqtt_drop( "malformed packet" );
+        return;
+      }
+      mqtt_on_packet( &Packet );
+      Mqtt_Rx[Packet_Len] = Saved;
+      Mqtt_Last_Rx_ms     = millis();
+
+      Mqtt_Rx_Len -= Packet_Len;
+      memmove( Mqtt_Rx, &Mqtt_Rx[Packet_Len], Mqtt_Rx_Len );
+
+      if ( Mqtt_State == MQTT_STATE_DISCONNECTED )
+      {
+        return;
+      }
     }
-    else
+
+    if ( Result < 0 )
     {
-      My_Status.relay_status = FALSE;
+      mqtt_drop( "malformed length" );
+      return;
     }
   }
+}
 
-  /*---------------------------------------------------------------------------*/
+/*===========================================================================*/
+
+/* A packet too long for Mqtt_Rx, its fixed header is at the start of it */
+static void
+mqtt_skip_start( UINT32 Packet_Len )
+{
+  UINT8   Header_Len = 2;
 
-  /* Topic: 'relay_timing_on_enable' and 'relay_timing_on_time' */
-  if ( topicStr == "relay_timing_on_enable" )
+  while ( Mqtt_Rx[Header_Len - 1] & 0x80 )
   {
-    if ( message == "true" )
+    Header_Len++;
+  }
+
+  memset( &Mqtt_Rx_Skip, 0, sizeof(Mqtt_Rx_Skip) );
+  Mqtt_Rx_Skip.left       = Packet_Len;
+  Mqtt_Rx_Skip.header_len = Header_Len;
+  Mqtt_Rx_Skip.ack        = ( (Mqtt_Rx[0] >> 4) == MQTT_PUBLISH ) &&
+                            ( ((Mqtt_Rx[0] >> MQTT_PUBLISH_QOS_SHIFT) & 0x03) == 1 );
+}
+
+/*===========================================================================*/
+
+/* The next bytes of the packet skipped, the packet ID of a PUBLISH is after
+   its topic, wherever the reads split it */
+static void
+mqtt_skip( const UINT8 *pData, UINT16 Len )
+{
+  UINT32  Id_Pos = Mqtt_Rx_Skip.header_len + 2 + Mqtt_Rx_Skip.topic_len;
+  UINT16  Index;
+
+  for ( Index = 0; (Index < Len) && Mqtt_Rx_Skip.ack; Index++ )
+  {
+    if ( Mqtt_Rx_Skip.pos + Index == Mqtt_Rx_Skip.header_len )
     {
-      Config.relay_on_timing.valid = TRUE;
+      Mqtt_Rx_Skip.topic_len = (UINT16)pData[Index] << 8;
     }
-    else
+    else if ( Mqtt_Rx_Skip.pos + Index == (UINT32)Mqtt_Rx_Skip.header_len + 1 )
+    {
+      Mqtt_Rx_Skip.topic_len |= pData[Index];
+      Id_Pos = Mqtt_Rx_Skip.header_len + 2 + Mqtt_Rx_Skip.topic_len;
+    }
+    else if ( Mqtt_Rx_Skip.pos + Index == Id_Pos )
     {
-      Config.relay_on_timing.valid = FALSE;
+      Mqtt_Rx_Skip.packet_id = (UINT16)pData[Index] << 8;
     }
+    else if ( Mqtt_Rx_Skip.pos + Index == Id_Pos + 1 )
+    {
+      Mqtt_Rx_Skip.packet_id |= pData[Index];
+    }
+  }
+  Mqtt_Rx_Skip.pos  += Len;
+  Mqtt_Rx_Skip.left -= Len;
+
+  if ( Mqtt_Rx_Skip.left > 0 )
+  {
+    return;
+  }
+
+  Metric_Inc( METRIC_MQTT_RX_SKIPPED );
+  if ( Mqtt_Rx_Skip.ack && (Mqtt_Rx_Skip.pos >= Id_Pos + 2) )
+  {
+    LOG( DBG_W, "MQTT: Publish %u skipped, acknowledged.\n", Mqtt_Rx_Skip.packet_id );
+    mqtt_send( Mqtt_Encode_Ack( Mqtt_Tx, sizeof(Mqtt_Tx), MQTT_PUBACK, Mqtt_Rx_Skip.packet_id ) );
+  }
+}
+
+/*===========================================================================*/
+
+static void
+mqtt_on_packet( MQTT_PACKET_RECORD *pPacket )
+{
+  const CHAR  *pName;
+  UINT16      Index;
+  UINT32      Latency_ms;
+
+  switch ( pPacket->type )
+  {
+    case MQTT_CONNACK:
+
+      if ( pPacket->pPayload[1] != 0 )
+      {
+        LOG( DBG_E, "MQTT: Broker refused, code %d.\n", pPacket->pPayload[1] );
+        mqtt_drop( "refused" );
+        break;
+      }
+      mqtt_set_state( MQTT_STATE_CONNECTED );
+      mqtt_on_connected();
+      break;
+
+    case MQTT_PUBLISH:
+
+      /* The payload is terminated by mqtt_read() */
+      if ( ((pPacket->flags >> MQTT_PUBLISH_QOS_SHIFT) & 0x03) == 1 )
+      {
+        mqtt_send( Mqtt_Encode_Ack( Mqtt_Tx, sizeof(Mqtt_Tx), MQTT_PUBACK, pPacket->packet_id ) );
+      }
+      if ( !Mqtt_Qos_Is_New( &Mqtt_Qos, pPacket ) )
+      {
+        Metric_Inc( METRIC_MQTT_QOS_DUPLICATES );
+        LOG( DBG_N, "MQTT: Copy of %u, %s, not applied.\n", pPacket->packet_id, pPacket->pTopic );
+        break;
+      }
+      pName = mqtt_command_name( pPacket->pTopic );
+      if ( pName == NULL )
+      {
+        LOG( DBG_W, "MQTT: Not a command topic, %s\n", pPacket->pTopic );
+        break;
+      }
+      mqtt_subscribe_callback( pName, (const CHAR *)pPacket->pPayload );
+      break;
+
+    case MQTT_SUBACK:
+
+      Mqtt_Subscribed = TRUE;
+
+      /* A return code for each topic filter */
+      for ( Index = 0; Index < pPacket->payload_len; Index++ )
+      {
+        if ( pPacket->pPayload[Index] == 0x80 )
+        {
+          LOG( DBG_E, "MQTT: Subscribe %u, topic filter %u refused.\n", pPacket->packet_id, Index );
+        }
+      }
+      break;
+
+    case MQTT_PUBACK:
+
+      if ( Mqtt_Qos_Acked( &Mqtt_Qos, pPacket->packet_id, millis(), &Latency_ms ) )
+      {
+        Metric_Set( METRIC_MQTT_QOS_ACK_MS, Latency_ms );
+      }
+      break;
+
+    case MQTT_PINGRESP:
+
+      Mqtt_Ping_Pending = FALSE;
+      break;
+
+    default:
+      break;
   }
+}
+
+/*===========================================================================*/
 
-  if ( topicStr == "relay_timing_on_time" )
+/* Once the broker took CONNECT, the subscribe goes at a random point */
+static void
+mqtt_on_connected( void )
+{
+  Mqtt_Subscribed = FALSE;
+  Mqtt_Sub_Due_ms = millis() + (ESP.random() % MQTT_SUBSCRIBE_SPREAD_MS);
+
+  /* The broker has none of the last session, what waits for PUBACK goes again */
+  Mqtt_Qos_Reconnected( &Mqtt_Qos );
+
+  Metric_Inc( METRIC_MQTT_CONNECTS );
+  LOG( DBG_W, "MQTT broker connected.\n" );
+
+  Boot_Phase_Done( BOOT_PHASE_MQTT );
+}
+
+/*===========================================================================*/
+
+/* All commands in one SUBSCRIBE when due, the SUBACK is not waited for.
+   One not sent goes again on the next pass */
+static void
+mqtt_subscribe( UINT32 Now_ms )
+{
+  const CHAR  *pFilters[] =
   {
-    Time_hour = atof(message.c_str());
+    Mqtt_Cmd_Filter,
+#ifdef MQTT_BROADCAST_ENABLE
+    MQTT_BROADCAST_PREFIX "#",
+#endif
+  };
 
-    /* 24 hours */
-    if( (Time_hour >= 0) && (Time_hour < 24) )
+  if ( Mqtt_Subscribed || ((INT32)(Now_ms - Mqtt_Sub_Due_ms) < 0) )
+  {
+    return;
+  }
+
+  if ( !mqtt_send( Mqtt_Encode_Subscribe( Mqtt_Tx, sizeof(Mqtt_Tx), Mqtt_Qos_Next_Id( &Mqtt_Qos ),
+                                          pFilters, sizeof(pFilters) / sizeof(pFilters[0]), 1 ) ) )
+  {
+    LOG( DBG_W, "MQTT: Subscribe not sent, again on the next pass.\n" );
+    return;
+  }
+  Mqtt_Subscribed = TRUE;
+
+  mqtt_announce();
+}
+
+/*===========================================================================*/
+
+/* The command name of a topic, NULL if not one of ours */
+static const CHAR *
+mqtt_command_name( const CHAR *pTopic )
+{
+  if ( strncmp( pTopic, Mqtt_Cmd_Filter, Mqtt_Cmd_Prefix_Len ) == 0 )
+  {
+    return &pTopic[Mqtt_Cmd_Prefix_Len];
+  }
+
+#ifdef MQTT_BROADCAST_ENABLE
+  if ( strncmp_P( pTopic, PSTR(MQTT_BROADCAST_PREFIX), sizeof(MQTT_BROADCAST_PREFIX) - 1 ) == 0 )
+  {
+    return &pTopic[sizeof(MQTT_BROADCAST_PREFIX) - 1];
+  }
+#endif
+
+  return NULL;
+}
+
+/*===========================================================================*/
+
+/* The full topic of a state name, copied out of flash into pBuff, the
+   prefix is shorter than MQTT_TOPIC_MAX_SIZE */
+static void
+mqtt_state_topic( CHAR *pBuff, UINT16 Size, PGM_P pTopic )
+{
+  UINT16  Len = strlen( Mqtt_State_Prefix );
+
+  memcpy( pBuff, Mqtt_State_Prefix, Len );
+  strncpy_P( &pBuff[Len], pTopic, Size - Len - 1 );
+  pBuff[Size - 1] = '\0';
+}
+
+/*===========================================================================*/
+
+/* The broker may have missed changes while disconnected */
+static void
+mqtt_announce( void )
+{
+  CHAR    payload[12];
+
+  mqtt_publish(PSTR("relay_status"), My_Status.relay_status?"on":"off");
+
+  /* Report how long wifi connecting cost in this boot */
+  Fixed_Format_U32( payload, sizeof(payload), My_Status.wifi_connect_time_ms );
+  mqtt_publish(PSTR("wifi_connect_time"), payload );
+  mqtt_publish(PSTR("wifi_fast_connect"), My_Status.wifi_fast_connect?"true":"false");
+}
+
+/*===========================================================================*/
+
+/* MQTT client initialise */
+void mqtt_client_init(void)
+{
+  UINT32  Chip_Id = ESP.getChipId();
+
+  snprintf_P( Mqtt_Client_Id, sizeof(Mqtt_Client_Id), PSTR(MQTT_ID "%06lx"), Chip_Id );
+  snprintf_P( Mqtt_Cmd_Filter, sizeof(Mqtt_Cmd_Filter), PSTR(MQTT_TOPIC_ROOT "/%06lx/cmd/#"), Chip_Id );
+  snprintf_P( Mqtt_State_Prefix, sizeof(Mqtt_State_Prefix), PSTR(MQTT_TOPIC_ROOT "/%06lx/state/"), Chip_Id );
+  Mqtt_Cmd_Prefix_Len = strlen( Mqtt_Cmd_Filter ) - 1;
+
+  mqtt_set_state( MQTT_STATE_DISCONNECTED );
+  Mqtt_Backoff_Init( &Mqtt_Backoff, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS );
+  Mqtt_Qos_Init( &Mqtt_Qos, MQTT_QOS_WINDOW );
+
+  Boot_Phase_Start( BOOT_PHASE_MQTT );
+
+  LOG( DBG_P, "MQTT client Initialise Complete, commands on %s\n", Mqtt_Cmd_Filter );
+}
+
+/*===========================================================================*/
+
+/* Check the MQTT connecttion before publish, the topic is a state name in flash */
+bool mqtt_publish(PGM_P topic, const char *payload)
+{
+  bool ret = false;
+  CHAR full_topic[MQTT_TOPIC_MAX_SIZE];
+
+  mqtt_state_topic( full_topic, sizeof(full_topic), topic );
+  if ( Mqtt_State == MQTT_STATE_CONNECTED )
+  {
+    ret = mqtt_send( Mqtt_Encode_Publish( Mqtt_Tx, sizeof(Mqtt_Tx), full_topic,
+                                          (const UINT8 *)payload, strlen(payload), 0, FALSE, FALSE, 0 ) );
+  }
+  Metric_Inc( ret ? METRIC_MQTT_PUBLISH_OK : METRIC_MQTT_PUBLISH_FAILED );
+
+  LOG( DBG_I, "MQTT: Pub, topic(%s), message(%s)\n", full_topic, payload );
+
+  return ret;
+}
+
+/*===========================================================================*/
+
+/* At least once, held until the broker acknowledges it, over reconnects too.
+   FALSE if MQTT_QOS_WINDOW publishes wait already */
+bool mqtt_publish_qos1(PGM_P topic, const char *payload)
+{
+  bool ret;
+  CHAR full_topic[MQTT_TOPIC_MAX_SIZE];
+
+  mqtt_state_topic( full_topic, sizeof(full_topic), topic );
+  ret = ( Mqtt_Qos_Publish( &Mqtt_Qos, full_topic, (const UINT8 *)payload, strlen(payload),
+                            FALSE, millis() ) != 0 );
+  Metric_Inc( ret ? METRIC_MQTT_PUBLISH_OK : METRIC_MQTT_PUBLISH_FAILED );
+
+  LOG( DBG_I, "MQTT: Pub QoS 1, topic(%s), message(%s)%s\n", full_topic, payload, ret ? "" : ", window full" );
+
+  /* Now rather than on the next loop() pass */
+  mqtt_send_due();
+
+  return ret;
+}
+
+/*===========================================================================*/
+
+/* Main loop, to call at each sketch loop() */
+void mqtt_handle_client(void)
+{
+  UINT32  now_ms = millis();
+
+  if ( Mqtt_State == MQTT_STATE_DISCONNECTED )
+  {
+    if ( Wifi_Is_Connected() && (!Mqtt_Tried || ((now_ms - Mqtt_State_Start_ms) >= Mqtt_Retry_ms)) )
     {
-      Config.relay_on_timing.hh = (UINT32)Time_hour;
-      Config.relay_on_timing.mm = (UINT32)((Time_hour - (FLOAT)Config.relay_on_timing.hh)*60);
+      mqtt_connect();
     }
+    return;
+  }
+
+  if ( !pMqtt_Net->connected() )
+  {
+    mqtt_drop( "connection lost" );
+    return;
+  }
+
+  mqtt_read();
+  mqtt_send_due();
+
+  switch ( Mqtt_State )
+  {
+    case MQTT_STATE_CONNACK_WAIT:
+
+      if ( (now_ms - Mqtt_State_Start_ms) > MQTT_RESPONSE_TIMEOUT_MS )
+      {
+        mqtt_drop( "no CONNACK" );
+      }
+      break;
+
+    case MQTT_STATE_CONNECTED:
+
+      mqtt_subscribe( now_ms );
+
+      if ( (now_ms - Mqtt_State_Start_ms) >= MQTT_BACKOFF_STABLE_MS )
+      {
+        Mqtt_Backoff_Reset( &Mqtt_Backoff );
+      }
+
+      if ( Mqtt_Ping_Pending )
+      {
+        if ( (now_ms - Mqtt_Ping_Sent_ms) > MQTT_RESPONSE_TIMEOUT_MS )
+        {
+          mqtt_drop( "no PINGRESP" );
+        }
+      }
+      else if ( ((now_ms - Mqtt_Last_Tx_ms) >= (MQTT_KEEPALIVE_S * 1000UL)) ||
+                ((now_ms - Mqtt_Last_Rx_ms) >= (MQTT_KEEPALIVE_S * 1000UL)) )
+      {
+        Mqtt_Ping_Pending = mqtt_send( Mqtt_Encode_Empty( Mqtt_Tx, sizeof(Mqtt_Tx), MQTT_PINGREQ ) );
+        Mqtt_Ping_Sent_ms = now_ms;
+      }
+      break;
+
+    default:
+      break;
   }
+}
+
+/*===========================================================================*/
+
+/* TRUE if the broker is connected */
+bool mqtt_is_connected(void)
+{
+  return ( Mqtt_State == MQTT_STATE_CONNECTED );
+}
+
+/*===========================================================================*/
+
+/* MQTT callback function for all subscribed topics */
+void mqtt_subscribe_callback(const CHAR *pTopic, const CHAR *pMessage)
+{
+  UINT32            Received_us = micros();
+  MY_CONFIG_RECORD  Config;
+  BOOL              Relay_Status;
+
+  /* Copy the global config to local config.
+     Compare in the end of function, if config is modified, save the config */
+  memcpy( &Config, &My_Config, sizeof(MY_CONFIG_RECORD) );
 
   /*---------------------------------------------------------------------------*/
 
-  /* Topic: 'relay_timing_off_enable' and 'relay_timing_off_time' */
-  if ( topicStr == "relay_timing_off_enable" )
+  /* Topic: 'test' */
+  if ( strcmp( pTopic, "test" ) == 0 )
   {
-    if ( message == "true" )
-    {
-      Config.relay_off_timing.valid = TRUE;
-    }
-    else
-    {
-      Config.relay_off_timing.valid = FALSE;
-    }
+    /* Do nothing, only leave for test */
   }
 
-  if ( topicStr == "relay_timing_off_time" )
+  /*---------------------------------------------------------------------------*/
+
+  /* Relay and its config, shared with the trace replay */
+  Relay_Status = My_Status.relay_status;
+  if ( Relay_Apply_Command( &Config, &Relay_Status, pTopic, pMessage ) )
   {
-    Time_hour = atof(message.c_str());
+    Trace_Command( pTopic, pMessage );
 
-    /* 24 hours */
-    if( (Time_hour >= 0) && (Time_hour < 24) )
+    /* Drive the relay now, not on a later loop() pass */
+    if ( Relay_Status != My_Status.relay_status )
     {
-      Config.relay_off_timing.hh = (UINT32)Time_hour;
-      Config.relay_off_timing.mm = (UINT32)((Time_hour - (FLOAT)Config.relay_off_timing.hh)*60);
+      Relay_Actuate( Relay_Status, RELAY_SOURCE_MQTT, Received_us );
     }
   }
 
   /*---------------------------------------------------------------------------*/
 
-  /* Topic: 'auto_control_relay', 'high_distance' and 'low_distance' */
-  if ( topicStr == "auto_control_relay" )
+  /* Topic: 'wdt_enable', reset for a stalled task or only count it */
+  if ( strcmp( pTopic, "wdt_enable" ) == 0 )
   {
-    if ( message == "true" )
+    Config.wdt_enable = ( strcmp( pMessage, "true" ) == 0 );
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* Topic: 'trace', record the relay inputs */
+  if ( strcmp( pTopic, TRACE_CMD_TOPIC ) == 0 )
+  {
+    if ( strcmp( pMessage, "on" ) == 0 )
     {
-      Config.relay_auto = TRUE;
+      Trace_Start();
     }
     else
     {
-      Config.relay_auto = FALSE;
+      Trace_Stop();
     }
   }
 
-  if ( topicStr == "high_distance" )
+  /*---------------------------------------------------------------------------*/
+
+  /* Topic: 'profile', start or stop the profiler */
+  if ( strcmp( pTopic, PROFILER_CMD_TOPIC ) == 0 )
   {
-    Distance_cm = atof(message.c_str());
-    if ( (Distance_cm > 0) && (Distance_cm <= 300) )
-    {
-      Config.high_distance_cm = Distance_cm;
-    }
+    Profiler_Command( pMessage );
   }
 
-  if ( topicStr == "low_distance" )
+  /*---------------------------------------------------------------------------*/
+
+#ifdef BENCH_ENABLE
+  /* Topic: 'bench', run in loop(), not in this callback */
+  if ( (strcmp( pTopic, BENCH_CMD_TOPIC ) == 0) && (strcmp( pMessage, "run" ) == 0) )
   {
-    Distance_cm = atof(message.c_str());
-    if ( (Distance_cm > 0) && (Distance_cm <= 300) )
-    {
-      Config.low_distance_cm = Distance_cm;
-    }
+    Bench_Request();
   }
+#endif
 
   /*---------------------------------------------------------------------------*/
 
@@ -273,6 +845,6 @@ void mqtt_subscribe_callback(const String &topicStr, const String &message)
     }
   }
 
-  LOG( DBG_N, "MQTT: Sub, topic(%s), message(%s)\n", topicStr.c_str(), message.c_str() );
+  LOG( DBG_N, "MQTT: Sub, topic(%s), message(%s)\n", pTopic, pMessage );
 }
 
@@ -18,17 +18,38 @@ Description:
 System Includes
 =============================================================================*/
 
-#include <EspMQTTClient.h>
+#include <Arduino.h>
 
 /*=============================================================================
 Local Includes
 =============================================================================*/
 
+#include "esp8266_global.h"
+
 /*=============================================================================
 Definitions
 =============================================================================*/
 
+/* Outgoing packet buffer, it holds the metrics snapshot and the boot
+   profile in one packet */
+#define MQTT_MAX_PACKET_SIZE    1024
+
+/* Each device has its own topics, <id> is its chip ID in hex:
+     MQTT_TOPIC_ROOT/<id>/cmd/<name>     commands to it
+     MQTT_TOPIC_ROOT/<id>/state/<name>   states from it */
+#define MQTT_TOPIC_ROOT         "site"
+
+/* Uncomment to take commands to all devices as well, on
+   MQTT_TOPIC_ROOT/MQTT_BROADCAST_ID/cmd/<name> */
+//#define MQTT_BROADCAST_ENABLE
+#define MQTT_BROADCAST_ID       "all"
+
+/* Topic up to the name, and whole */
+#define MQTT_TOPIC_PREFIX_SIZE  32
+#define MQTT_TOPIC_MAX_SIZE     64
+
 #if 0
+# Names, after MQTT_TOPIC_ROOT/<id>/cmd/ and MQTT_TOPIC_ROOT/<id>/state/
 # MQTT Subscribe Topics
 mqtt_sub_topics = [
     "relay_timing_on_enable",
@@ -60,15 +81,16 @@ mqtt_pub_topics = [
 Global References
 =============================================================================*/
 
-extern EspMQTTClient mqtt_client;
-
 /*=============================================================================
 Prototypes
 =============================================================================*/
 
 void mqtt_client_init(void);
-bool mqtt_publish(const String &topic, const String &payload);
+bool mqtt_publish(PGM_P topic, const char *payload);
+bool mqtt_publish_qos1(PGM_P topic, const char *payload);
 void mqtt_handle_client(void);
+bool mqtt_is_connected(void);
+void mqtt_subscribe_callback(const CHAR *pTopic, const CHAR *pMessage);
 
 #endif  /* __MQTT_CLIENT_H__ */
 
@@ -0,0 +1,418 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_packet.cpp
+@brief  MQTT 3.1.1 packet encoding and decoding
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The encoders write one whole packet into pBuff and return its length, 0
+if it doesn't fit. The decoder takes a packet from a receive buffer in two
+steps, Mqtt_Decode_Length() tells when it is all there, Mqtt_Decode()
+takes it apart in place.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "mqtt_packet.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static UINT16 Mqtt_Put_Header( UINT8 *pBuff, UINT8 First, UINT32 Remaining );
+static UINT16 Mqtt_Header_Len( UINT32 Remaining );
+static UINT16 Mqtt_Put_String( UINT8 *pBuff, const CHAR *pStr, UINT16 Len );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Bytes of the fixed header for a remaining length */
+static UINT16
+Mqtt_Header_Len( UINT32 Remaining )
+{
+  UINT16  Len = 2;
+
+  while ( Remaining > 127 )
+  {
+    Remaining >>= 7;
+    Len++;
+  }
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+static UINT16
+Mqtt_Put_Header( UINT8 *pBuff, UINT8 First, UINT32 Remaining )
+{
+  UINT16  Len = 0;
+
+  pBuff[Len++] = First;
+  do
+  {
+    pBuff[Len] = Remaining & 0x7F;
+    Remaining >>= 7;
+    if ( Remaining > 0 )
+    {
+      pBuff[Len] |= 0x80;
+    }
+    Len++;
+  } while ( Remaining > 0 );
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+/* A UTF-8 string, 2 bytes of length first */
+static UINT16
+Mqtt_Put_String( UINT8 *pBuff, const CHAR *pStr, UINT16 Len )
+{
+  pBuff[0] = Len >> 8;
+  pBuff[1] = Len & 0xFF;
+  memcpy( &pBuff[2], pStr, Len );
+
+  return Len + 2;
+}
+
+/*===========================================================================*/
+
+/*!
+CONNECT, with user and password if given.
+
+@param  pBuff           Buffer, (O)
+@param  Size            Buffer size, (I)
+@param  pClient_Id      Client identifier, (I)
+@param  pUser           User name, NULL if none, (I)
+@param  pPassword       Password, NULL if none, (I)
+@param  Keepalive_s     Keep alive interval, (I)
+@param  Clean_Session   Start without the state of an earlier session, (I)
+@return Length of the packet, 0 if it doesn't fit
+*/
+UINT16
+Mqtt_Encode_Connect( UINT8 *pBuff, UINT16 Size, const CHAR *pClient_Id,
+                     const CHAR *pUser, const CHAR *pPassword, UINT16 Keepalive_s, BOOL Clean_Session )
+{
+  UINT16  Id_Len    = strlen( pClient_Id );
+  UINT16  User_Len  = ( pUser != NULL ) ? strlen( pUser ) : 0;
+  UINT16  Pwd_Len   = ( pPassword != NULL ) ? strlen( pPassword ) : 0;
+  UINT32  Remaining = 10 + 2 + Id_Len;
+  UINT16  Len;
+  UINT8   Flags     = Clean_Session ? 0x02 : 0;
+
+  if ( pUser != NULL )
+  {
+    Remaining += 2 + User_Len;
+    Flags     |= 0x80;
+  }
+  if ( pPassword != NULL )
+  {
+    Remaining += 2 + Pwd_Len;
+    Flags     |= 0x40;
+  }
+
+  if ( (Mqtt_Header_Len( Remaining ) + Remaining) > Size )
+  {
+    return 0;
+  }
+
+  Len  = Mqtt_Put_Header( pBuff, MQTT_CONNECT << 4, Remaining );
+  Len += Mqtt_Put_String( &pBuff[Len], "MQTT", 4 );
+  pBuff[Len++] = MQTT_PROTOCOL_LEVEL;
+  pBuff[Len++] = Flags;
+  pBuff[Len++] = Keepalive_s >> 8;
+  pBuff[Len++] = Keepalive_s & 0xFF;
+  Len += Mqtt_Put_String( &pBuff[Len], pClient_Id, Id_Len );
+  if ( pUser != NULL )
+  {
+    Len += Mqtt_Put_String( &pBuff[Len], pUser, User_Len );
+  }
+  if ( pPassword != NULL )
+  {
+    Len += Mqtt_Put_String( &pBuff[Len], pPassword, Pwd_Len );
+  }
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+/*!
+PUBLISH.
+
+@param  pBuff         Buffer, (O)
+@param  Size          Buffer size, (I)
+@param  pTopic        Topic, (I)
+@param  pPayload      Payload, (I)
+@param  Payload_Len   Payload length, (I)
+@param  Qos           0 or 1, (I)
+@param  Retain        Broker keeps it for new subscribers, (I)
+@param  Dup           A retransmission, (I)
+@param  Packet_Id     With QoS 1 only, (I)
+@return Length of the packet, 0 if it doesn't fit
+*/
+UINT16
+Mqtt_Encode_Publish( UINT8 *pBuff, UINT16 Size, const CHAR *pTopic, const UINT8 *pPayload, UINT16 Payload_Len,
+                     UINT8 Qos, BOOL Retain, BOOL Dup, UINT16 Packet_Id )
+{
+  UINT16  Topic_Len = strlen( pTopic );
+  UINT32  Remaining = 2 + Topic_Len + ((Qos > 0) ? 2 : 0) + Payload_Len;
+  UINT8   First     = (MQTT_PUBLISH << 4) | (Qos << MQTT_PUBLISH_QOS_SHIFT);
+  UINT16  Len;
+
+  if ( (Mqtt_Header_Len( Remaining ) + Remaining) > Size )
+  {
+    return 0;
+  }
+
+  First |= Retain ? MQTT_PUBLISH_RETAIN : 0;
+  First |= Dup ? MQTT_PUBLISH_DUP : 0;
+
+  Len  = Mqtt_Put_Header( pBuff, First, Remaining );
+  Len += Mqtt_Put_String( &pBuff[Len], pTopic, Topic_Len );
+  if ( Qos > 0 )
+  {
+    pBuff[Len++] = Packet_Id >> 8;
+    pBuff[Len++] = Packet_Id & 0xFF;
+  }
+  memcpy( &pBuff[Len], pPayload, Payload_Len );
+
+  return Len + Payload_Len;
+}
+
+/*===========================================================================*/
+
+/*!
+SUBSCRIBE to one or more topic filters, all with the same QoS, in one packet
+so they take one SUBACK.
+
+@param  pBuff         Buffer, (O)
+@param  Size          Buffer size, (I)
+@param  Packet_Id     Packet identifier, (I)
+@param  ppTopics      Topic filters, (I)
+@param  Count         Count of them, (I)
+@param  Qos           0 or 1, (I)
+@return Length of the packet, 0 if it doesn't fit
+*/
+UINT16
+Mqtt_Encode_Subscribe( UINT8 *pBuff, UINT16 Size, UINT16 Packet_Id,
+                       const CHAR * const *ppTopics, UINT8 Count, UINT8 Qos )
+{
+  UINT32  Remaining = 2;
+  UINT16  Len;
+  UINT8   Index;
+
+  for ( Index = 0; Index < Count; Index++ )
+  {
+    Remaining += 2 + strlen( ppTopics[Index] ) + 1;
+  }
+
+  if ( (Count == 0) || ((Mqtt_Header_Len( Remaining ) + Remaining) > Size) )
+  {
+    return 0;
+  }
+
+  /* The reserved flags of SUBSCRIBE are 0010 */
+  Len  = Mqtt_Put_Header( pBuff, (MQTT_SUBSCRIBE << 4) | 0x02, Remaining );
+  pBuff[Len++] = Packet_Id >> 8;
+  pBuff[Len++] = Packet_Id & 0xFF;
+  for ( Index = 0; Index < Count; Index++ )
+  {
+    Len += Mqtt_Put_String( &pBuff[Len], ppTopics[Index], strlen( ppTopics[Index] ) );
+    pBuff[Len++] = Qos;
+  }
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+/* PUBACK and the other packets that are only a packet identifier */
+UINT16
+Mqtt_Encode_Ack( UINT8 *pBuff, UINT16 Size, MQTT_PACKET_TYPE Type, UINT16 Packet_Id )
+{
+  if ( Size < 4 )
+  {
+    return 0;
+  }
+
+  pBuff[0] = (Type << 4) | ((Type == MQTT_PUBREL) ? 0x02 : 0);
+  pBuff[1] = 2;
+  pBuff[2] = Packet_Id >> 8;
+  pBuff[3] = Packet_Id & 0xFF;
+
+  return 4;
+}
+
+/*===========================================================================*/
+
+/* PINGREQ, PINGRESP, DISCONNECT */
+UINT16
+Mqtt_Encode_Empty( UINT8 *pBuff, UINT16 Size, MQTT_PACKET_TYPE Type )
+{
+  if ( Size < 2 )
+  {
+    return 0;
+  }
+
+  pBuff[0] = Type << 4;
+  pBuff[1] = 0;
+
+  return 2;
+}
+
+/*===========================================================================*/
+
+/*!
+Length of the packet at the start of a receive buffer.
+
+@param  pBuff         Received bytes, (I)
+@param  Len           Count of them, (I)
+@param  pPacket_Len   Whole packet, fixed header included, (O)
+@return 1 if known, 0 if more bytes are needed, -1 if malformed
+*/
+INT8
+Mqtt_Decode_Length( const UINT8 *pBuff, UINT16 Len, UINT32 *pPacket_Len )
+{
+  UINT32  Remaining = 0;
+  UINT8   Shift     = 0;
+  UINT16  Index;
+
+  for ( Index = 1; Index < MQTT_FIXED_HEADER_MAX; Index++ )
+  {
+    if ( Index >= Len )
+    {
+      return 0;
+    }
+
+    Remaining |= (UINT32)(pBuff[Index] & 0x7F) << Shift;
+    Shift     += 7;
+
+    if ( (pBuff[Index] & 0x80) == 0 )
+    {
+      *pPacket_Len = Index + 1 + Remaining;
+      return 1;
+    }
+  }
+
+  return -1;
+}
+
+/*===========================================================================*/
+
+/*!
+Take a whole packet apart. The topic of a PUBLISH is moved 2 bytes down
+over its length, so it can be NUL terminated in place.
+
+@param  pBuff         The packet, (I/O)
+@param  Packet_Len    From Mqtt_Decode_Length(), (I)
+@param  pPacket       Its fields, (O)
+@return FALSE if malformed
+*/
+BOOL
+Mqtt_Decode( UINT8 *pBuff, UINT32 Packet_Len, MQTT_PACKET_RECORD *pPacket )
+{
+  UINT32  Pos = 1;
+  UINT16  Topic_Len;
+
+  memset( pPacket, 0, sizeof(MQTT_PACKET_RECORD) );
+  pPacket->type  = pBuff[0] >> 4;
+  pPacket->flags = pBuff[0] & 0x0F;
+
+  /* Skip the remaining length */
+  while ( pBuff[Pos++] & 0x80 )
+  {
+  }
+
+  switch ( pPacket->type )
+  {
+    case MQTT_PUBLISH:
+
+      if ( (Pos + 2) > Packet_Len )
+      {
+        return FALSE;
+      }
+      Topic_Len = (pBuff[Pos] << 8) | pBuff[Pos + 1];
+      if ( (Pos + 2 + Topic_Len) > Packet_Len )
+      {
+        return FALSE;
+      }
+
+      memmove( &pBuff[Pos], &pBuff[Pos + 2], Topic_Len );
+      pBuff[Pos + Topic_Len] = 0;
+      pPacket->pTopic = (CHAR *)&pBuff[Pos];
+      Pos += 2 + Topic_Len;
+
+      if ( ((pPacket->flags >> MQTT_PUBLISH_QOS_SHIFT) & 0x03) > 0 )
+      {
+        if ( (Pos + 2) > Packet_Len )
+        {
+          return FALSE;
+        }
+        pPacket->packet_id = (pBuff[Pos] << 8) | pBuff[Pos + 1];
+        Pos += 2;
+      }
+      break;
+
+    case MQTT_PUBACK:
+    case MQTT_PUBREC:
+    case MQTT_PUBREL:
+    case MQTT_PUBCOMP:
+    case MQTT_SUBACK:
+    case MQTT_UNSUBACK:
+
+      if ( (Pos + 2) > Packet_Len )
+      {
+        return FALSE;
+      }
+      pPacket->packet_id = (pBuff[Pos] << 8) | pBuff[Pos + 1];
+      Pos += 2;
+      break;
+
+    case MQTT_CONNACK:
+
+      if ( (Pos + 2) > Packet_Len )
+      {
+        return FALSE;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  pPacket->pPayload     = &pBuff[Pos];
+  pPacket->payload_len  = Packet_Len - Pos;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,112 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_packet.h
+@brief  MQTT 3.1.1 packet encoding and decoding definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Only the packets a client sends or gets. Plain C on byte buffers, without
+Arduino calls, so the host tools build it.
+*/
+
+#ifndef __MQTT_PACKET_H__
+#define __MQTT_PACKET_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Protocol level of MQTT 3.1.1 */
+#define MQTT_PROTOCOL_LEVEL       4
+
+/* Longest fixed header, type and 4 bytes of remaining length */
+#define MQTT_FIXED_HEADER_MAX     5
+
+/* Control packet types, the high nibble of the first byte */
+typedef enum
+{
+  MQTT_CONNECT = 1,
+  MQTT_CONNACK,
+  MQTT_PUBLISH,
+  MQTT_PUBACK,
+  MQTT_PUBREC,
+  MQTT_PUBREL,
+  MQTT_PUBCOMP,
+  MQTT_SUBSCRIBE,
+  MQTT_SUBACK,
+  MQTT_UNSUBSCRIBE,
+  MQTT_UNSUBACK,
+  MQTT_PINGREQ,
+  MQTT_PINGRESP,
+  MQTT_DISCONNECT,
+
+} MQTT_PACKET_TYPE;
+
+/* PUBLISH flags */
+#define MQTT_PUBLISH_RETAIN       0x01
+#define MQTT_PUBLISH_QOS_SHIFT    1
+#define MQTT_PUBLISH_DUP          0x08
+
+/* A decoded packet, the pointers are into the receive buffer */
+typedef struct
+{
+  UINT8     type;           /* MQTT_PACKET_TYPE */
+  UINT8     flags;          /* Low nibble of the first byte */
+  UINT16    packet_id;      /* PUBLISH with QoS, PUBACK, SUBACK, UNSUBACK */
+  CHAR      *pTopic;        /* PUBLISH, NUL terminated */
+  UINT8     *pPayload;      /* PUBLISH payload, the rest of CONNACK and SUBACK */
+  UINT16    payload_len;
+
+} MQTT_PACKET_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern UINT16
+Mqtt_Encode_Connect( UINT8 *pBuff, UINT16 Size, const CHAR *pClient_Id,
+                     const CHAR *pUser, const CHAR *pPassword, UINT16 Keepalive_s, BOOL Clean_Session );
+
+extern UINT16
+Mqtt_Encode_Publish( UINT8 *pBuff, UINT16 Size, const CHAR *pTopic, const UINT8 *pPayload, UINT16 Payload_Len,
+                     UINT8 Qos, BOOL Retain, BOOL Dup, UINT16 Packet_Id );
+
+extern UINT16
+Mqtt_Encode_Subscribe( UINT8 *pBuff, UINT16 Size, UINT16 Packet_Id,
+                       const CHAR * const *ppTopics, UINT8 Count, UINT8 Qos );
+
+extern UINT16
+Mqtt_Encode_Ack( UINT8 *pBuff, UINT16 Size, MQTT_PACKET_TYPE Type, UINT16 Packet_Id );
+
+extern UINT16
+Mqtt_Encode_Empty( UINT8 *pBuff, UINT16 Size, MQTT_PACKET_TYPE Type );
+
+extern INT8
+Mqtt_Decode_Length( const UINT8 *pBuff, UINT16 Len, UINT32 *pPacket_Len );
+
+extern BOOL
+Mqtt_Decode( UINT8 *pBuff, UINT32 Packet_Len, MQTT_PACKET_RECORD *pPacket );
+
+#endif  /* __MQTT_PACKET_H__ */
+
+/*===========================================================================*/
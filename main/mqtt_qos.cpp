@@ -0,0 +1,326 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_qos.cpp
+@brief  MQTT QoS 1 state, the outgoing window and the incoming duplicates
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Outgoing, a QoS 1 PUBLISH takes a slot of the window until its PUBACK.
+Mqtt_Qos_Publish() only encodes it into the slot, Mqtt_Qos_Due() gives
+out what is to be sent, new ones first in the order handed in, then those
+whose PUBACK is late, with DUP set and the timer doubled:
+
+  Id = Mqtt_Qos_Publish( &Qos, pTopic, pPayload, Len, FALSE, millis() );
+  ...
+  while ( (pPacket = Mqtt_Qos_Due( &Qos, millis(), &Len )) != NULL )
+  {
+    send pPacket
+  }
+
+So the sending is in one place, called from loop(). With the window full
+Mqtt_Qos_Publish() refuses, the caller decides what to drop.
+
+The session is always clean, so after a reconnect the broker knows none of
+the packet identifiers. Mqtt_Qos_Reconnected() sends all slots again and
+forgets the incoming ones.
+
+Incoming, the broker sends a QoS 1 PUBLISH again with DUP set when it
+missed our PUBACK. Mqtt_Qos_Is_New() remembers the last few identifiers
+and tells such a copy, so a command is applied once. A PUBLISH without
+DUP is always new, the broker may give out an identifier again once it
+had the PUBACK.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "mqtt_qos.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* A packet identifier, never 0 and not one still waiting for PUBACK, for
+   SUBSCRIBE as well so they don't clash */
+UINT16
+Mqtt_Qos_Next_Id( MQTT_QOS_RECORD *pQos )
+{
+  UINT8   Index;
+  BOOL    Taken;
+
+  do
+  {
+    if ( ++pQos->packet_id == 0 )
+    {
+      pQos->packet_id = 1;
+    }
+
+    Taken = FALSE;
+    for ( Index = 0; Index < pQos->window; Index++ )
+    {
+      if ( pQos->slots[Index].used && (pQos->slots[Index].packet_id == pQos->packet_id) )
+      {
+        Taken = TRUE;
+      }
+    }
+  } while ( Taken );
+
+  return pQos->packet_id;
+}
+
+/*===========================================================================*/
+
+/*!
+Empty window and no identifiers seen.
+
+@param  pQos      The state, (O)
+@param  Window    Most publishes waiting for PUBACK, 1 to MQTT_QOS_WINDOW, (I)
+*/
+void
+Mqtt_Qos_Init( MQTT_QOS_RECORD *pQos, UINT8 Window )
+{
+  memset( pQos, 0, sizeof(MQTT_QOS_RECORD) );
+
+  pQos->window = ( (Window > 0) && (Window <= MQTT_QOS_WINDOW) ) ? Window : MQTT_QOS_WINDOW;
+}
+
+/*===========================================================================*/
+
+/*!
+Take a QoS 1 PUBLISH into the window, Mqtt_Qos_Due() gives it out.
+
+@param  pQos          The state, (I/O)
+@param  pTopic        Topic, (I)
+@param  pPayload      Payload, (I)
+@param  Payload_Len   Payload length, (I)
+@param  Retain        Broker keeps it for new subscribers, (I)
+@param  Now_ms        Time, (I)
+@return Its packet identifier, 0 if the window is full or it doesn't fit
+*/
+UINT16
+Mqtt_Qos_Publish( MQTT_QOS_RECORD *pQos, const CHAR *pTopic, const UINT8 *pPayload, UINT16 Payload_Len,
+                  BOOL Retain, UINT32 Now_ms )
+{
+  MQTT_QOS_SLOT_RECORD  *pSlot = NULL;
+  UINT8   Index;
+
+  for ( Index = 0; Index < pQos->window; Index++ )
+  {
+    if ( !pQos->slots[Index].used )
+    {
+      pSlot = &pQos->slots[Index];
+      break;
+    }
+  }
+
+  if ( pSlot == NULL )
+  {
+    return 0;
+  }
+
+  pSlot->packet_id = Mqtt_Qos_Next_Id( pQos );
+  pSlot->len       = Mqtt_Encode_Publish( pSlot->packet, sizeof(pSlot->packet), pTopic, pPayload, Payload_Len,
+                                          1, Retain, FALSE, pSlot->packet_id );
+  if ( pSlot->len == 0 )
+  {
+    return 0;
+  }
+
+  pSlot->used      = TRUE;
+  pSlot->due       = TRUE;
+  pSlot->sends     = 0;
+  pSlot->queued_ms = Now_ms;
+  pSlot->retry_ms  = MQTT_QOS_RETRY_MS;
+
+  return pSlot->packet_id;
+}
+
+/*===========================================================================*/
+
+/*!
+The next packet to send, the oldest of those due. It counts as sent.
+
+@param  pQos      The state, (I/O)
+@param  Now_ms    Time, (I)
+@param  pLen      Its length, (O)
+@return The packet, DUP set if sent before, NULL if none is due
+*/
+const UINT8 *
+Mqtt_Qos_Due( MQTT_QOS_RECORD *pQos, UINT32 Now_ms, UINT16 *pLen )
+{
+  MQTT_QOS_SLOT_RECORD  *pSlot = NULL;
+  MQTT_QOS_SLOT_RECORD  *pCheck;
+  UINT8   Index;
+
+  for ( Index = 0; Index < pQos->window; Index++ )
+  {
+    pCheck = &pQos->slots[Index];
+
+    if ( !pCheck->used || (!pCheck->due && ((Now_ms - pCheck->sent_ms) < pCheck->retry_ms)) )
+    {
+      continue;
+    }
+    if ( (pSlot == NULL) || ((INT32)(pCheck->queued_ms - pSlot->queued_ms) < 0) )
+    {
+      pSlot = pCheck;
+    }
+  }
+
+  if ( pSlot == NULL )
+  {
+    return NULL;
+  }
+
+  if ( pSlot->sends > 0 )
+  {
+    pSlot->packet[0] |= MQTT_PUBLISH_DUP;
+
+    /* The timer ran out, the broker or the way to it is slow */
+    if ( !pSlot->due )
+    {
+      pSlot->retry_ms = ( pSlot->retry_ms < (MQTT_QOS_RETRY_MAX_MS / 2) ) ? (pSlot->retry_ms * 2)
+                                                                           : MQTT_QOS_RETRY_MAX_MS;
+    }
+  }
+  if ( pSlot->sends < 255 )
+  {
+    pSlot->sends++;
+  }
+  pSlot->due      = FALSE;
+  pSlot->sent_ms  = Now_ms;
+
+  *pLen = pSlot->len;
+
+  return pSlot->packet;
+}
+
+/*===========================================================================*/
+
+/*!
+A PUBACK came, free its slot.
+
+@param  pQos          The state, (I/O)
+@param  Packet_Id     From the PUBACK, (I)
+@param  Now_ms        Time, (I)
+@param  pLatency_ms   From handed in to acknowledged, (O)
+@return FALSE if no slot has it, a late PUBACK for a copy
+*/
+BOOL
+Mqtt_Qos_Acked( MQTT_QOS_RECORD *pQos, UINT16 Packet_Id, UINT32 Now_ms, UINT32 *pLatency_ms )
+{
+  UINT8   Index;
+
+  for ( Index = 0; Index < pQos->window; Index++ )
+  {
+    if ( pQos->slots[Index].used && (pQos->slots[Index].sends > 0) &&
+         (pQos->slots[Index].packet_id == Packet_Id) )
+    {
+      *pLatency_ms = Now_ms - pQos->slots[Index].queued_ms;
+      pQos->slots[Index].used = FALSE;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/* A new clean session, send all again and forget the incoming identifiers */
+void
+Mqtt_Qos_Reconnected( MQTT_QOS_RECORD *pQos )
+{
+  UINT8   Index;
+
+  for ( Index = 0; Index < pQos->window; Index++ )
+  {
+    pQos->slots[Index].due      = TRUE;
+    pQos->slots[Index].retry_ms = MQTT_QOS_RETRY_MS;
+  }
+
+  memset( pQos->seen, 0, sizeof(pQos->seen) );
+  pQos->seen_next = 0;
+}
+
+/*===========================================================================*/
+
+/* Publishes waiting for PUBACK */
+UINT8
+Mqtt_Qos_In_Flight( const MQTT_QOS_RECORD *pQos )
+{
+  UINT8   Index;
+  UINT8   Count = 0;
+
+  for ( Index = 0; Index < pQos->window; Index++ )
+  {
+    Count += pQos->slots[Index].used ? 1 : 0;
+  }
+
+  return Count;
+}
+
+/*===========================================================================*/
+
+/*!
+Whether an incoming PUBLISH is to be handled, FALSE for a copy of one
+already handled. It is acknowledged either way.
+
+@param  pQos      The state, (I/O)
+@param  pPacket   A decoded PUBLISH, (I)
+@return FALSE if a copy
+*/
+BOOL
+Mqtt_Qos_Is_New( MQTT_QOS_RECORD *pQos, const MQTT_PACKET_RECORD *pPacket )
+{
+  UINT8   Index;
+
+  if ( ((pPacket->flags >> MQTT_PUBLISH_QOS_SHIFT) & 0x03) == 0 )
+  {
+    return TRUE;
+  }
+
+  for ( Index = 0; Index < MQTT_QOS_SEEN_SIZE; Index++ )
+  {
+    if ( pQos->seen[Index] == pPacket->packet_id )
+    {
+      /* Without DUP, the broker gave the identifier out again */
+      return ( (pPacket->flags & MQTT_PUBLISH_DUP) == 0 );
+    }
+  }
+
+  pQos->seen[pQos->seen_next] = pPacket->packet_id;
+  pQos->seen_next = (pQos->seen_next + 1) % MQTT_QOS_SEEN_SIZE;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
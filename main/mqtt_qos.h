@@ -0,0 +1,114 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_qos.h
+@brief  MQTT QoS 1 state, the outgoing window and the incoming duplicates
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Plain C on byte buffers, without Arduino calls, so the host tools build it.
+The caller owns the connection, this only keeps the packets until PUBACK
+and tells when to send them again.
+*/
+
+#ifndef __MQTT_QOS_H__
+#define __MQTT_QOS_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+#include "mqtt_packet.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Most QoS 1 publishes waiting for PUBACK at once */
+#ifndef MQTT_QOS_WINDOW
+#define MQTT_QOS_WINDOW           4
+#endif
+
+/* Longest QoS 1 PUBLISH, topic and payload, it is kept until PUBACK */
+#ifndef MQTT_QOS_PACKET_MAX_SIZE
+#define MQTT_QOS_PACKET_MAX_SIZE  64
+#endif
+
+/* A PUBLISH without PUBACK goes again after this, doubled each time */
+#define MQTT_QOS_RETRY_MS         2000
+#define MQTT_QOS_RETRY_MAX_MS     16000
+
+/* Incoming packet identifiers remembered, to tell a resent PUBLISH */
+#define MQTT_QOS_SEEN_SIZE        16
+
+typedef struct
+{
+  BOOL      used;
+  BOOL      due;            /* Send on the next Mqtt_Qos_Due(), timer or not */
+  UINT8     sends;          /* So far, up to 255 */
+  UINT16    packet_id;
+  UINT16    len;
+  UINT32    queued_ms;      /* Handed in */
+  UINT32    sent_ms;        /* Last sent */
+  UINT32    retry_ms;       /* From sent_ms to the next send */
+  UINT8     packet[MQTT_QOS_PACKET_MAX_SIZE];
+
+} MQTT_QOS_SLOT_RECORD;
+
+typedef struct
+{
+  MQTT_QOS_SLOT_RECORD  slots[MQTT_QOS_WINDOW];
+  UINT8     window;         /* Slots in use at most, up to MQTT_QOS_WINDOW */
+  UINT16    packet_id;      /* The last one given out */
+
+  UINT16    seen[MQTT_QOS_SEEN_SIZE];
+  UINT8     seen_next;
+
+} MQTT_QOS_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Mqtt_Qos_Init( MQTT_QOS_RECORD *pQos, UINT8 Window );
+
+extern UINT16
+Mqtt_Qos_Next_Id( MQTT_QOS_RECORD *pQos );
+
+extern UINT16
+Mqtt_Qos_Publish( MQTT_QOS_RECORD *pQos, const CHAR *pTopic, const UINT8 *pPayload, UINT16 Payload_Len,
+                  BOOL Retain, UINT32 Now_ms );
+
+extern const UINT8 *
+Mqtt_Qos_Due( MQTT_QOS_RECORD *pQos, UINT32 Now_ms, UINT16 *pLen );
+
+extern BOOL
+Mqtt_Qos_Acked( MQTT_QOS_RECORD *pQos, UINT16 Packet_Id, UINT32 Now_ms, UINT32 *pLatency_ms );
+
+extern void
+Mqtt_Qos_Reconnected( MQTT_QOS_RECORD *pQos );
+
+extern UINT8
+Mqtt_Qos_In_Flight( const MQTT_QOS_RECORD *pQos );
+
+extern BOOL
+Mqtt_Qos_Is_New( MQTT_QOS_RECORD *pQos, const MQTT_PACKET_RECORD *pPacket );
+
+#endif  /* __MQTT_QOS_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,236 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_transport.cpp
+@brief  Connection to the MQTT broker, plain TCP or TLS
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A full BearSSL handshake takes seconds on the 80 MHz ESP8266, most of it
+the public key operations, and blocks loop() meanwhile. So with TLS:
+
+  Session     The session of the last handshake is kept and offered again
+              on the next connect. A broker that still has it resumes with
+              a few hashes, no key exchange and no certificate check.
+  Suites      ECDHE with ECDSA comes first, ECDHE with RSA after, for a
+              broker with an RSA certificate. No plain RSA key exchange.
+  Buffers     The receive buffer is MQTT_TLS_RX_BUFFER_SIZE if the broker
+              takes the Maximum Fragment Length extension, probed once,
+              else a whole 16 KB record.
+
+A session offered is only resumed if the broker still has it. BearSSL
+copies the parameters of the handshake back into the session, a resumed
+one keeps its session ID and master secret, a full handshake brings new
+ones. So each connect reports its time, by whether the session was
+resumed, the heap the connection holds, and the most of the BearSSL stack
+ever used, the handshake is where it peaks.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <ESP8266WiFi.h>
+#include <WiFiClient.h>
+#ifdef MQTT_TLS_ENABLE
+#include <WiFiClientSecure.h>
+#include <StackThunk.h>
+#endif
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "mqtt_transport.h"
+#include "metrics.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+#ifdef MQTT_TLS_ENABLE
+
+static BearSSL::WiFiClientSecure  Mqtt_Tls;
+
+/* Offered again on each connect, kept across reconnects */
+static BearSSL::Session           Mqtt_Tls_Session;
+static BOOL                       Mqtt_Tls_Have_Session = FALSE;
+
+/* Maximum Fragment Length, probed on the first connect */
+static BOOL                       Mqtt_Tls_Probed       = FALSE;
+static UINT16                     Mqtt_Tls_Rx_Size      = MQTT_TLS_RECORD_MAX_SIZE;
+
+/* In order of preference */
+static const uint16_t             Mqtt_Tls_Ciphers[] =
+{
+  BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+  BR_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+  BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+  BR_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256,
+  BR_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256,
+};
+
+#ifdef MQTT_TLS_CA_CERT
+static BearSSL::X509List          Mqtt_Tls_Trust( MQTT_TLS_CA_CERT );
+#endif
+
+#else
+
+static WiFiClient                 Mqtt_Plain;
+
+#endif
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+#ifdef MQTT_TLS_ENABLE
+static void Mqtt_Transport_Setup_Tls( const CHAR *pHost, UINT16 Port );
+#endif
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+#ifdef MQTT_TLS_ENABLE
+
+/* Buffers, suites, trust and the cached session, before each connect */
+static void
+Mqtt_Transport_Setup_Tls( const CHAR *pHost, UINT16 Port )
+{
+  if ( !Mqtt_Tls_Probed )
+  {
+    if ( BearSSL::WiFiClientSecure::probeMaxFragmentLength( pHost, Port, MQTT_TLS_RX_BUFFER_SIZE ) )
+    {
+      Mqtt_Tls_Rx_Size = MQTT_TLS_RX_BUFFER_SIZE;
+    }
+    else
+    {
+      LOG( DBG_W, "MQTT: Broker doesn't take %d byte fragments, using %d.\n",
+                  MQTT_TLS_RX_BUFFER_SIZE, MQTT_TLS_RECORD_MAX_SIZE );
+    }
+    Mqtt_Tls_Probed = TRUE;
+  }
+
+  Mqtt_Tls.setBufferSizes( Mqtt_Tls_Rx_Size, MQTT_TLS_TX_BUFFER_SIZE );
+  Mqtt_Tls.setCiphers( Mqtt_Tls_Ciphers, sizeof(Mqtt_Tls_Ciphers) / sizeof(Mqtt_Tls_Ciphers[0]) );
+  Mqtt_Tls.setTimeout( MQTT_CONNECT_TIMEOUT_MS );
+
+#if defined(MQTT_TLS_CA_CERT)
+  Mqtt_Tls.setTrustAnchors( &Mqtt_Tls_Trust );
+#elif defined(MQTT_TLS_FINGERPRINT)
+  Mqtt_Tls.setFingerprint( MQTT_TLS_FINGERPRINT );
+#else
+  Mqtt_Tls.setInsecure();
+  LOG( DBG_W, "MQTT: The broker certificate is not checked.\n" );
+#endif
+
+  Mqtt_Tls.setSession( &Mqtt_Tls_Session );
+}
+
+#endif
+
+/*===========================================================================*/
+
+/*!
+Connect to the broker, blocks for the TCP connect and the TLS handshake.
+
+@param  pHost   Broker host name or IP, (I)
+@param  Port    Broker port, (I)
+@return The connection, NULL if failed
+*/
+Client *
+Mqtt_Transport_Connect( const CHAR *pHost, UINT16 Port )
+{
+  UINT32      Start_ms    = millis();
+  UINT32      Heap_Before = ESP.getFreeHeap();
+  BOOL        Resumed     = FALSE;
+  WiFiClient  *pClient;
+
+#ifdef MQTT_TLS_ENABLE
+  BearSSL::Session  Offered;
+  CHAR              Error[48];
+
+  /* Byte for byte, its parameters aren't public */
+  memcpy( (void *)&Offered, (const void *)&Mqtt_Tls_Session, sizeof(Offered) );
+
+  Mqtt_Transport_Setup_Tls( pHost, Port );
+  pClient = &Mqtt_Tls;
+
+  if ( !Mqtt_Tls.connect( pHost, Port ) )
+  {
+    Mqtt_Tls.getLastSSLError( Error, sizeof(Error) );
+    LOG( DBG_E, "MQTT: TLS connect failed, %s\n", Error );
+    Metric_Inc( METRIC_MQTT_CONNECT_FAILED );
+
+    /* Maybe the session is what the broker didn't like */
+    Mqtt_Tls_Session      = BearSSL::Session();
+    Mqtt_Tls_Have_Session = FALSE;
+
+    Mqtt_Tls.stop();
+    return NULL;
+  }
+
+  /* The same session ID and master secret as offered, no key exchange */
+  Resumed = Mqtt_Tls_Have_Session &&
+            ( memcmp( (const void *)&Offered, (const void *)&Mqtt_Tls_Session, sizeof(Offered) ) == 0 );
+  if ( Mqtt_Tls_Have_Session && !Resumed )
+  {
+    LOG( DBG_W, "MQTT: The broker didn't resume the session, full handshake.\n" );
+  }
+  Mqtt_Tls_Have_Session = TRUE;
+
+  Metric_Set( METRIC_MQTT_TLS_HEAP, Heap_Before - ESP.getFreeHeap() );
+  Metric_Set( METRIC_MQTT_TLS_STACK_MAX, stack_thunk_get_max_usage() );
+#else
+  Mqtt_Plain.setTimeout( MQTT_CONNECT_TIMEOUT_MS );
+  pClient = &Mqtt_Plain;
+
+  if ( !Mqtt_Plain.connect( pHost, Port ) )
+  {
+    LOG( DBG_E, "MQTT: TCP connect failed.\n" );
+    Metric_Inc( METRIC_MQTT_CONNECT_FAILED );
+    return NULL;
+  }
+#endif
+
+  /* Commands and acks are small, don't hold them back */
+  pClient->setNoDelay( true );
+
+  Metric_Min( METRIC_HEAP_FREE_MIN, ESP.getFreeHeap() );
+  Metric_Set( Resumed ? METRIC_MQTT_HANDSHAKE_CACHED_MS : METRIC_MQTT_HANDSHAKE_NEW_MS, millis() - Start_ms );
+
+  LOG( DBG_N, "MQTT: Connected in %lu ms, %s session, heap %lu -> %lu\n", millis() - Start_ms,
+              Resumed ? "resumed" : "new", Heap_Before, (UINT32)ESP.getFreeHeap() );
+
+  return pClient;
+}
+
+/*===========================================================================*/
+
+/* Close the connection, the TLS session stays for the next one */
+void
+Mqtt_Transport_Stop( void )
+{
+#ifdef MQTT_TLS_ENABLE
+  Mqtt_Tls.stop();
+#else
+  Mqtt_Plain.stop();
+#endif
+}
+
+/*===========================================================================*/
@@ -0,0 +1,69 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_transport.h
+@brief  Connection to the MQTT broker, plain TCP or TLS
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+TLS with MQTT_TLS_ENABLE defined in esp8266_global.h.
+*/
+
+#ifndef __MQTT_TRANSPORT_H__
+#define __MQTT_TRANSPORT_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Client.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Longest a connect blocks, TCP and the TLS handshake each */
+#define MQTT_CONNECT_TIMEOUT_MS   5000
+
+/* BearSSL buffers. The receive buffer must hold a whole TLS record, that is
+   16 KB unless the broker takes the Maximum Fragment Length extension */
+#ifndef MQTT_TLS_RX_BUFFER_SIZE
+#define MQTT_TLS_RX_BUFFER_SIZE   1024
+#endif
+#ifndef MQTT_TLS_TX_BUFFER_SIZE
+#define MQTT_TLS_TX_BUFFER_SIZE   1024
+#endif
+#define MQTT_TLS_RECORD_MAX_SIZE  16384
+
+/* The broker certificate is checked against MQTT_TLS_CA_CERT, the PEM of
+   its CA, or else MQTT_TLS_FINGERPRINT, the SHA-1 of the certificate.
+   Without either it is not checked at all */
+//#define MQTT_TLS_CA_CERT        "-----BEGIN CERTIFICATE-----\n...\n-----END CERTIFICATE-----\n"
+//#define MQTT_TLS_FINGERPRINT    "AB:CD:..."
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern Client *
+Mqtt_Transport_Connect( const CHAR *pHost, UINT16 Port );
+
+extern void
+Mqtt_Transport_Stop( void );
+
+#endif  /* __MQTT_TRANSPORT_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,365 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ota_delta.cpp
+@brief  Firmware delta, applied as it streams in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A new firmware is mostly the old one, moved about: the code that didn't
+change is still there, at another address if something before it grew.
+The delta says where to copy each piece of the new image from in the old
+one, and carries only the bytes that are nowhere in it.
+
+Ota_Delta_Feed() takes the delta in the pieces it arrives in, and writes
+the new image as soon as each piece of it is known, so neither the delta
+nor the new image is ever held whole:
+
+  Ota_Delta_Init( &Delta, &Io );
+  while ( more of the delta )
+  {
+    if ( !Ota_Delta_Feed( &Delta, pData, Len ) )
+    {
+      give up, Delta.error says why
+    }
+  }
+  complete = Ota_Delta_Is_Done( &Delta );
+
+A copy takes OTA_DELTA_READ_SIZE bytes of the old image at a time, that
+is all the buffer there is. Every offset and length is checked against
+the sizes in the header before it is used, a broken delta stops at the
+first wrong command and writes nothing past the new size.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "ota_delta.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* A literal is written in pieces of at most this */
+#define OTA_DELTA_WRITE_MAX_SIZE  0x8000
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static UINT32 Ota_Delta_Get_U32( const UINT8 *pBuff );
+static BOOL   Ota_Delta_Fail( OTA_DELTA_RECORD *pDelta, OTA_DELTA_ERROR Error );
+static BOOL   Ota_Delta_Header( OTA_DELTA_RECORD *pDelta );
+static BOOL   Ota_Delta_Varint( OTA_DELTA_RECORD *pDelta, UINT8 Byte, BOOL *pComplete );
+static BOOL   Ota_Delta_Command( OTA_DELTA_RECORD *pDelta );
+static BOOL   Ota_Delta_Copy( OTA_DELTA_RECORD *pDelta );
+static void   Ota_Delta_Next( OTA_DELTA_RECORD *pDelta );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static UINT32
+Ota_Delta_Get_U32( const UINT8 *pBuff )
+{
+  return (UINT32)pBuff[0] | ((UINT32)pBuff[1] << 8) | ((UINT32)pBuff[2] << 16) | ((UINT32)pBuff[3] << 24);
+}
+
+/*===========================================================================*/
+
+static BOOL
+Ota_Delta_Fail( OTA_DELTA_RECORD *pDelta, OTA_DELTA_ERROR Error )
+{
+  pDelta->state = OTA_DELTA_STATE_FAILED;
+  pDelta->error = Error;
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/* The header is complete in buff */
+static BOOL
+Ota_Delta_Header( OTA_DELTA_RECORD *pDelta )
+{
+  OTA_DELTA_HEADER_RECORD *pHeader = &pDelta->header;
+
+  if ( (memcmp( pDelta->buff, OTA_DELTA_MAGIC, 4 ) != 0) || (pDelta->buff[4] != OTA_DELTA_VERSION) )
+  {
+    return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_HEADER );
+  }
+
+  pHeader->old_size = Ota_Delta_Get_U32( &pDelta->buff[8] );
+  pHeader->new_size = Ota_Delta_Get_U32( &pDelta->buff[12] );
+  memcpy( pHeader->old_md5, &pDelta->buff[16], sizeof(pHeader->old_md5) );
+  memcpy( pHeader->new_md5, &pDelta->buff[32], sizeof(pHeader->new_md5) );
+
+  if ( pHeader->new_size == 0 )
+  {
+    return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_HEADER );
+  }
+
+  if ( (pDelta->io.pHeader != NULL) && !pDelta->io.pHeader( pDelta->io.pContext, pHeader ) )
+  {
+    return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_REFUSED );
+  }
+
+  pDelta->state = OTA_DELTA_STATE_COMMAND;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* One more byte of a varint, *pComplete once it is all there */
+static BOOL
+Ota_Delta_Varint( OTA_DELTA_RECORD *pDelta, UINT8 Byte, BOOL *pComplete )
+{
+  /* Five bytes hold 32 bits, a sixth is garbage */
+  if ( pDelta->varint_shift > 28 )
+  {
+    return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_COMMAND );
+  }
+
+  pDelta->varint |= (UINT32)(Byte & 0x7F) << pDelta->varint_shift;
+  pDelta->varint_shift += 7;
+
+  *pComplete = ( (Byte & 0x80) == 0 );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The varint of a command is complete, a copy waits for its offset */
+static BOOL
+Ota_Delta_Command( OTA_DELTA_RECORD *pDelta )
+{
+  UINT32  Length = pDelta->varint >> 1;
+
+  if ( (Length == 0) || (Length > (pDelta->header.new_size - pDelta->written)) )
+  {
+    return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_COMMAND );
+  }
+
+  pDelta->remain = Length;
+  pDelta->state  = (pDelta->varint & 1) ? OTA_DELTA_STATE_LITERAL : OTA_DELTA_STATE_OFFSET;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The offset of a copy is complete, copy it all */
+static BOOL
+Ota_Delta_Copy( OTA_DELTA_RECORD *pDelta )
+{
+  INT32   Offset = (INT32)(pDelta->varint >> 1) ^ -(INT32)(pDelta->varint & 1);
+  INT64   Source = (INT64)pDelta->source + Offset;
+  UINT16  Take;
+
+  if ( (Source < 0) || (Source > (INT64)pDelta->header.old_size) ||
+       (pDelta->remain > (pDelta->header.old_size - (UINT32)Source)) )
+  {
+    return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_COMMAND );
+  }
+
+  pDelta->source = (UINT32)Source;
+
+  while ( pDelta->remain > 0 )
+  {
+    Take = ( pDelta->remain < OTA_DELTA_READ_SIZE ) ? pDelta->remain : OTA_DELTA_READ_SIZE;
+
+    if ( !pDelta->io.pRead( pDelta->io.pContext, pDelta->source, pDelta->buff, Take ) )
+    {
+      return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_READ );
+    }
+    if ( !pDelta->io.pWrite( pDelta->io.pContext, pDelta->buff, Take ) )
+    {
+      return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_WRITE );
+    }
+
+    pDelta->source  += Take;
+    pDelta->written += Take;
+    pDelta->remain  -= Take;
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* A command is complete, the next one or the end */
+static void
+Ota_Delta_Next( OTA_DELTA_RECORD *pDelta )
+{
+  pDelta->state = ( pDelta->written == pDelta->header.new_size ) ? OTA_DELTA_STATE_DONE
+                                                                 : OTA_DELTA_STATE_COMMAND;
+}
+
+/*===========================================================================*/
+
+/*!
+Ready for the first byte of a delta.
+
+@param  pDelta    The state, (O)
+@param  pIo       Callbacks, the header one may be NULL, (I)
+*/
+void
+Ota_Delta_Init( OTA_DELTA_RECORD *pDelta, const OTA_DELTA_IO_RECORD *pIo )
+{
+  memset( pDelta, 0, sizeof(OTA_DELTA_RECORD) );
+
+  pDelta->io    = *pIo;
+  pDelta->state = OTA_DELTA_STATE_HEADER;
+  pDelta->error = OTA_DELTA_OK;
+}
+
+/*===========================================================================*/
+
+/*!
+The next piece of the delta, any length, the new image is written as far
+as it is known.
+
+@param  pDelta    The state, (I/O)
+@param  pData     The piece, (I)
+@param  Len       Its length, (I)
+@return FALSE if the delta is broken or a callback failed, see error
+*/
+BOOL
+Ota_Delta_Feed( OTA_DELTA_RECORD *pDelta, const UINT8 *pData, UINT32 Len )
+{
+  UINT32  Index = 0;
+  UINT32  Take;
+  BOOL    Complete;
+
+  while ( Index < Len )
+  {
+    switch ( pDelta->state )
+    {
+      case OTA_DELTA_STATE_HEADER:
+
+        Take = OTA_DELTA_HEADER_SIZE - pDelta->header_len;
+        Take = ( Take < (Len - Index) ) ? Take : (Len - Index);
+        memcpy( &pDelta->buff[pDelta->header_len], &pData[Index], Take );
+        pDelta->header_len += Take;
+        Index += Take;
+
+        if ( (pDelta->header_len == OTA_DELTA_HEADER_SIZE) && !Ota_Delta_Header( pDelta ) )
+        {
+          return FALSE;
+        }
+        pDelta->varint       = 0;
+        pDelta->varint_shift = 0;
+        break;
+
+      /*---------------------------------------------------------------------------*/
+
+      case OTA_DELTA_STATE_COMMAND:
+      case OTA_DELTA_STATE_OFFSET:
+
+        if ( !Ota_Delta_Varint( pDelta, pData[Index++], &Complete ) )
+        {
+          return FALSE;
+        }
+        if ( !Complete )
+        {
+          break;
+        }
+
+        if ( pDelta->state == OTA_DELTA_STATE_COMMAND )
+        {
+          if ( !Ota_Delta_Command( pDelta ) )
+          {
+            return FALSE;
+          }
+        }
+        else
+        {
+          if ( !Ota_Delta_Copy( pDelta ) )
+          {
+            return FALSE;
+          }
+          Ota_Delta_Next( pDelta );
+        }
+        pDelta->varint       = 0;
+        pDelta->varint_shift = 0;
+        break;
+
+      /*---------------------------------------------------------------------------*/
+
+      case OTA_DELTA_STATE_LITERAL:
+
+        Take = ( pDelta->remain < (Len - Index) ) ? pDelta->remain : (Len - Index);
+        Take = ( Take < OTA_DELTA_WRITE_MAX_SIZE ) ? Take : OTA_DELTA_WRITE_MAX_SIZE;
+
+        if ( !pDelta->io.pWrite( pDelta->io.pContext, &pData[Index], (UINT16)Take ) )
+        {
+          return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_WRITE );
+        }
+        Index           += Take;
+        pDelta->written += Take;
+        pDelta->remain  -= Take;
+
+        if ( pDelta->remain == 0 )
+        {
+          Ota_Delta_Next( pDelta );
+        }
+        break;
+
+      /*---------------------------------------------------------------------------*/
+
+      case OTA_DELTA_STATE_DONE:
+
+        return Ota_Delta_Fail( pDelta, OTA_DELTA_ERROR_TRAILING );
+
+      /*---------------------------------------------------------------------------*/
+
+      default:
+
+        return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The new image is written whole */
+BOOL
+Ota_Delta_Is_Done( const OTA_DELTA_RECORD *pDelta )
+{
+  return ( pDelta->state == OTA_DELTA_STATE_DONE );
+}
+
+/*===========================================================================*/
+
+/* Whether an upload starting with these bytes is a delta, not an image */
+BOOL
+Ota_Delta_Is_Delta( const UINT8 *pData, UINT32 Len )
+{
+  return ( (Len >= 4) && (memcmp( pData, OTA_DELTA_MAGIC, 4 ) == 0) );
+}
+
+/*===========================================================================*/
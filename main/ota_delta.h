@@ -0,0 +1,144 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ota_delta.h
+@brief  Firmware delta, applied as it streams in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Plain C on byte buffers, without Arduino calls, so the host tools build it.
+The running firmware is read and the new one written through callbacks,
+the delta itself is fed in whatever pieces it arrives in.
+
+The format, made by tools/ota_delta/make_delta.py, little endian:
+
+  Header, OTA_DELTA_HEADER_SIZE bytes
+    "ESPD", version, 3 reserved, old size, new size, old MD5, new MD5
+  Commands, until the new size is written, each one a varint
+    (Length << 1) | 0   copy Length bytes of the old image, a zigzag varint
+                        follows, where from, relative to the end of the
+                        last copy
+    (Length << 1) | 1   Length bytes follow, taken as they are
+*/
+
+#ifndef __OTA_DELTA_H__
+#define __OTA_DELTA_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define OTA_DELTA_MAGIC           "ESPD"
+#define OTA_DELTA_VERSION         1
+#define OTA_DELTA_HEADER_SIZE     48
+
+/* The old image is read in pieces of this size for a copy */
+#define OTA_DELTA_READ_SIZE       256
+
+typedef enum
+{
+  OTA_DELTA_OK = 0,
+  OTA_DELTA_ERROR_HEADER,         /* Not a delta, or a version not known */
+  OTA_DELTA_ERROR_REFUSED,        /* The header callback said no */
+  OTA_DELTA_ERROR_COMMAND,        /* Outside the old image, or past the new size */
+  OTA_DELTA_ERROR_READ,
+  OTA_DELTA_ERROR_WRITE,
+  OTA_DELTA_ERROR_TRAILING,       /* Bytes after the new image is complete */
+
+} OTA_DELTA_ERROR;
+
+typedef struct
+{
+  UINT32    old_size;
+  UINT32    new_size;
+  UINT8     old_md5[16];
+  UINT8     new_md5[16];
+
+} OTA_DELTA_HEADER_RECORD;
+
+/* The header is complete, FALSE to refuse the delta */
+typedef BOOL (*OTA_DELTA_HEADER_FN)( void *pContext, const OTA_DELTA_HEADER_RECORD *pHeader );
+
+/* Len bytes of the old image from Offset */
+typedef BOOL (*OTA_DELTA_READ_FN)( void *pContext, UINT32 Offset, UINT8 *pBuff, UINT16 Len );
+
+/* The next Len bytes of the new image */
+typedef BOOL (*OTA_DELTA_WRITE_FN)( void *pContext, const UINT8 *pBuff, UINT16 Len );
+
+typedef struct
+{
+  OTA_DELTA_HEADER_FN pHeader;
+  OTA_DELTA_READ_FN   pRead;
+  OTA_DELTA_WRITE_FN  pWrite;
+  void                *pContext;
+
+} OTA_DELTA_IO_RECORD;
+
+typedef enum
+{
+  OTA_DELTA_STATE_HEADER = 0,
+  OTA_DELTA_STATE_COMMAND,        /* The varint of the next command */
+  OTA_DELTA_STATE_OFFSET,         /* The varint where a copy is from */
+  OTA_DELTA_STATE_LITERAL,
+  OTA_DELTA_STATE_DONE,
+  OTA_DELTA_STATE_FAILED,
+
+} OTA_DELTA_STATE;
+
+typedef struct
+{
+  OTA_DELTA_IO_RECORD     io;
+  OTA_DELTA_STATE         state;
+  OTA_DELTA_ERROR         error;
+  OTA_DELTA_HEADER_RECORD header;
+
+  UINT8     header_len;           /* Of it received so far */
+  UINT32    varint;
+  UINT8     varint_shift;
+
+  UINT32    remain;               /* Of the copy or the literal */
+  UINT32    source;               /* In the old image, where the last copy ended */
+  UINT32    written;              /* Of the new image */
+
+  UINT8     buff[OTA_DELTA_HEADER_SIZE > OTA_DELTA_READ_SIZE ? OTA_DELTA_HEADER_SIZE : OTA_DELTA_READ_SIZE];
+
+} OTA_DELTA_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Ota_Delta_Init( OTA_DELTA_RECORD *pDelta, const OTA_DELTA_IO_RECORD *pIo );
+
+extern BOOL
+Ota_Delta_Feed( OTA_DELTA_RECORD *pDelta, const UINT8 *pData, UINT32 Len );
+
+extern BOOL
+Ota_Delta_Is_Done( const OTA_DELTA_RECORD *pDelta );
+
+extern BOOL
+Ota_Delta_Is_Delta( const UINT8 *pData, UINT32 Len );
+
+#endif  /* __OTA_DELTA_H__ */
+
+/*===========================================================================*/
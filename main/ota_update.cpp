@@ -0,0 +1,409 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ota_update.cpp
+@brief  Firmware update over the air, streamed into the update space
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Each piece of the upload goes on into the Updater as it comes, which
+writes it to the free flash above the running firmware a sector at a time,
+so nothing more than a piece and a sector is ever held in RAM. What the
+upload is, the first bytes tell:
+
+  0xE9        A firmware image, the .bin of the build
+  1F 8B       The same gzipped, smaller on the air. The Updater takes it
+              as it is, the boot loader unpacks it when it copies it over
+  "ESPD"      A delta from tools/ota_delta/make_delta.py, against the
+              firmware running now. Ota_Delta_Feed() makes the new image
+              from it and the running one, read back from the flash, as
+              it comes in
+
+An image must come with its MD5, a delta carries the MD5s of both images.
+The running firmware must be the one the delta was made against, its MD5
+is checked before anything is written. The new image is checked against
+its MD5 by Update.end() once it is all written, and only then is the boot
+loader told to copy it over the running one on the next boot.
+
+The ESP8266 has no second slot to boot from, so the fallback is the
+running firmware itself: an update cut short, a delta for another
+firmware, or an MD5 that doesn't match leaves it as it is, and it goes on
+running and can take the next try.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <Updater.h>
+#include <MD5Builder.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "ota_update.h"
+#include "ota_delta.h"
+#include "metrics.h"
+#include "watchdog.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The first bytes of an image and of a gzipped one */
+#define OTA_IMAGE_MAGIC       0xE9
+#define OTA_GZIP_MAGIC_1      0x1F
+#define OTA_GZIP_MAGIC_2      0x8B
+
+/* Bytes of the first piece that tell what the upload is */
+#define OTA_MAGIC_SIZE        4
+
+typedef enum
+{
+  OTA_KIND_IMAGE = 0,         /* Gzipped or not, the Updater knows */
+  OTA_KIND_DELTA,
+
+} OTA_KIND;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static OTA_STATE          Ota_Current_State = OTA_STATE_IDLE;
+static OTA_KIND           Ota_Kind;
+static OTA_DELTA_RECORD   Ota_Delta;
+
+/* Given with the upload, empty if none */
+static CHAR     Ota_Md5[OTA_MD5_STR_SIZE];
+
+/* Why the last update failed, in flash */
+static PGM_P    Ota_Error_Str     = NULL;
+
+static UINT32   Ota_Received      = 0;
+static UINT32   Ota_Start_ms      = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static BOOL ota_fail( PGM_P pWhy );
+static void ota_hex( const UINT8 *pMd5, CHAR *pStr );
+static BOOL ota_running_md5( UINT32 Size, UINT8 *pMd5 );
+static BOOL ota_begin( UINT32 Size );
+static BOOL ota_delta_header( void *pContext, const OTA_DELTA_HEADER_RECORD *pHeader );
+static BOOL ota_delta_read( void *pContext, UINT32 Offset, UINT8 *pBuff, UINT16 Len );
+static BOOL ota_delta_write( void *pContext, const UINT8 *pBuff, UINT16 Len );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Give up on this update, the running firmware stays */
+static BOOL
+ota_fail( PGM_P pWhy )
+{
+  if ( Update.isRunning() )
+  {
+    Update.end();
+  }
+
+  Ota_Current_State = OTA_STATE_FAILED;
+  Ota_Error_Str     = pWhy;
+  Metric_Inc( METRIC_OTA_FAILURES );
+
+  LOG( DBG_E, "OTA: Failed after %lu bytes, %S.\n", Ota_Received, pWhy );
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+static void
+ota_hex( const UINT8 *pMd5, CHAR *pStr )
+{
+  UINT8   Index;
+
+  for ( Index = 0; Index < 16; Index++ )
+  {
+    snprintf_P( &pStr[Index * 2], 3, PSTR("%02x"), pMd5[Index] );
+  }
+}
+
+/*===========================================================================*/
+
+/* MD5 of the first Size bytes of the flash, the running firmware as its .bin */
+static BOOL
+ota_running_md5( UINT32 Size, UINT8 *pMd5 )
+{
+  MD5Builder  Md5;
+  UINT8       Buff[OTA_DELTA_READ_SIZE];
+  UINT32      Offset;
+  UINT16      Take;
+
+  Md5.begin();
+  for ( Offset = 0; Offset < Size; Offset += Take )
+  {
+    Take = ( (Size - Offset) < sizeof(Buff) ) ? (Size - Offset) : sizeof(Buff);
+    if ( !ESP.flashRead( Offset, Buff, Take ) )
+    {
+      return FALSE;
+    }
+    Md5.add( Buff, Take );
+    yield();
+    Watchdog_Heartbeat();
+  }
+  Md5.calculate();
+  Md5.getBytes( pMd5 );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Start the Updater, checking against Ota_Md5 at the end */
+static BOOL
+ota_begin( UINT32 Size )
+{
+  if ( !Update.begin( Size ) )
+  {
+    LOG( DBG_E, "OTA: %s.\n", Update.getErrorString().c_str() );
+    return ota_fail( PSTR("no room for it") );
+  }
+  Update.setMD5( Ota_Md5 );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The delta must be for the running firmware */
+static BOOL
+ota_delta_header( void *pContext, const OTA_DELTA_HEADER_RECORD *pHeader )
+{
+  UINT8   Md5[16];
+  CHAR    New_Md5[OTA_MD5_STR_SIZE];
+
+  if ( !ota_running_md5( pHeader->old_size, Md5 ) || (memcmp( Md5, pHeader->old_md5, sizeof(Md5) ) != 0) )
+  {
+    ota_fail( PSTR("the delta is for another firmware") );
+    return FALSE;
+  }
+
+  ota_hex( pHeader->new_md5, New_Md5 );
+  if ( (Ota_Md5[0] != 0) && (strcasecmp( Ota_Md5, New_Md5 ) != 0) )
+  {
+    ota_fail( PSTR("the MD5 given isn't that of the delta") );
+    return FALSE;
+  }
+  strcpy( Ota_Md5, New_Md5 );
+
+  LOG( DBG_I, "OTA: Delta from %lu to %lu bytes, to MD5 %s.\n", pHeader->old_size, pHeader->new_size, Ota_Md5 );
+
+  return ota_begin( pHeader->new_size );
+}
+
+/*===========================================================================*/
+
+static BOOL
+ota_delta_read( void *pContext, UINT32 Offset, UINT8 *pBuff, UINT16 Len )
+{
+  return ESP.flashRead( Offset, pBuff, Len );
+}
+
+/*===========================================================================*/
+
+static BOOL
+ota_delta_write( void *pContext, const UINT8 *pBuff, UINT16 Len )
+{
+  /* A long copy writes many sectors from one piece of the upload */
+  yield();
+  Watchdog_Heartbeat();
+
+  return ( Update.write( (UINT8 *)pBuff, Len ) == Len );
+}
+
+/*===========================================================================*/
+
+/*!
+A new upload, whatever was before is dropped.
+
+@param  pMd5    MD5 of the image in hex, NULL or empty if none, (I)
+*/
+void
+Ota_Begin( const CHAR *pMd5 )
+{
+  Ota_Abort();
+
+  Ota_Current_State = OTA_STATE_RECEIVING;
+  Ota_Error_Str     = NULL;
+  Ota_Received      = 0;
+  Ota_Start_ms      = millis();
+
+  Ota_Md5[0] = 0;
+  if ( (pMd5 != NULL) && (strlen( pMd5 ) == (OTA_MD5_STR_SIZE - 1)) )
+  {
+    strcpy( Ota_Md5, pMd5 );
+  }
+  else if ( (pMd5 != NULL) && (pMd5[0] != 0) )
+  {
+    ota_fail( PSTR("the MD5 isn't 32 hex digits") );
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+The next piece of the upload, it is written before this returns.
+
+@param  pData   The piece, (I)
+@param  Len     Its length, (I)
+@return FALSE once the update failed, the rest of the upload is ignored
+*/
+BOOL
+Ota_Write( const UINT8 *pData, UINT32 Len )
+{
+  static const OTA_DELTA_IO_RECORD Io = { ota_delta_header, ota_delta_read, ota_delta_write, NULL };
+
+  if ( Ota_Current_State != OTA_STATE_RECEIVING )
+  {
+    return FALSE;
+  }
+
+  /* The upload takes longer than any HTTP deadline, it moves on though */
+  Watchdog_Heartbeat();
+
+  /* The first piece tells what it is */
+  if ( Ota_Received == 0 )
+  {
+    if ( Len < OTA_MAGIC_SIZE )
+    {
+      return ota_fail( PSTR("the first piece is too short") );
+    }
+
+    if ( Ota_Delta_Is_Delta( pData, Len ) )
+    {
+      Ota_Kind = OTA_KIND_DELTA;
+      Ota_Delta_Init( &Ota_Delta, &Io );
+    }
+    else if ( (pData[0] == OTA_IMAGE_MAGIC) || ((pData[0] == OTA_GZIP_MAGIC_1) && (pData[1] == OTA_GZIP_MAGIC_2)) )
+    {
+      Ota_Kind = OTA_KIND_IMAGE;
+      if ( Ota_Md5[0] == 0 )
+      {
+        return ota_fail( PSTR("an image needs its MD5") );
+      }
+
+      /* Its size comes only at the end, take all there is */
+      if ( !ota_begin( (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000 ) )
+      {
+        return FALSE;
+      }
+    }
+    else
+    {
+      return ota_fail( PSTR("not an image, a gzipped one or a delta") );
+    }
+  }
+
+  Ota_Received += Len;
+
+  if ( Ota_Kind == OTA_KIND_DELTA )
+  {
+    if ( !Ota_Delta_Feed( &Ota_Delta, pData, Len ) )
+    {
+      /* The header callback failed it already if refused */
+      return ( Ota_Current_State == OTA_STATE_FAILED ) ? FALSE
+                                                       : ota_fail( PSTR("the delta is broken") );
+    }
+  }
+  else if ( Update.write( (UINT8 *)pData, Len ) != Len )
+  {
+    LOG( DBG_E, "OTA: %s.\n", Update.getErrorString().c_str() );
+    return ota_fail( PSTR("writing the flash failed") );
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+The upload is complete, check the new image against its MD5 and have it
+copied over the running one on the next boot.
+
+@return TRUE if it is ready, restart to run it
+*/
+BOOL
+Ota_End( void )
+{
+  if ( Ota_Current_State != OTA_STATE_RECEIVING )
+  {
+    return ( Ota_Current_State == OTA_STATE_READY );
+  }
+
+  if ( Ota_Received == 0 )
+  {
+    return ota_fail( PSTR("nothing was uploaded") );
+  }
+
+  if ( (Ota_Kind == OTA_KIND_DELTA) && !Ota_Delta_Is_Done( &Ota_Delta ) )
+  {
+    return ota_fail( PSTR("the delta was cut short") );
+  }
+
+  /* An image is as long as it came, a delta said how long */
+  if ( !Update.end( Ota_Kind == OTA_KIND_IMAGE ) )
+  {
+    LOG( DBG_E, "OTA: %s.\n", Update.getErrorString().c_str() );
+    return ota_fail( PSTR("the MD5 doesn't match") );
+  }
+
+  Ota_Current_State = OTA_STATE_READY;
+
+  LOG( DBG_P, "OTA: %s of %lu bytes in %lu ms, MD5 %s, runs after the restart.\n",
+       (Ota_Kind == OTA_KIND_DELTA) ? "Delta" : "Image", Ota_Received, millis() - Ota_Start_ms, Ota_Md5 );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The upload broke off, a new one may come */
+void
+Ota_Abort( void )
+{
+  if ( Ota_Current_State == OTA_STATE_RECEIVING )
+  {
+    ota_fail( PSTR("the upload broke off") );
+  }
+}
+
+/*===========================================================================*/
+
+OTA_STATE
+Ota_State( void )
+{
+  return Ota_Current_State;
+}
+
+/*===========================================================================*/
+
+/* Why the last update failed, in flash, NULL if it didn't */
+const CHAR *
+Ota_Error( void )
+{
+  return Ota_Error_Str;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,79 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ota_update.h
+@brief  Firmware update over the air, streamed into the update space
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Takes a firmware image, a gzipped one, or a delta from tools/ota_delta, in
+the pieces it arrives in. http_server.cpp feeds it the upload on /update.
+*/
+
+#ifndef __OTA_UPDATE_H__
+#define __OTA_UPDATE_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The web updater of the old MQTT library took the MQTT user and password */
+#define OTA_USER          "zhuzhong"
+#define OTA_PWD           "159357258"
+
+/* An MD5 in hex, with the NUL */
+#define OTA_MD5_STR_SIZE  33
+
+typedef enum
+{
+  OTA_STATE_IDLE = 0,
+  OTA_STATE_RECEIVING,
+  OTA_STATE_READY,          /* Verified, it runs after the restart */
+  OTA_STATE_FAILED,
+
+} OTA_STATE;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Ota_Begin( const CHAR *pMd5 );
+
+extern BOOL
+Ota_Write( const UINT8 *pData, UINT32 Len );
+
+extern BOOL
+Ota_End( void );
+
+extern void
+Ota_Abort( void );
+
+extern OTA_STATE
+Ota_State( void );
+
+extern const CHAR *
+Ota_Error( void );
+
+#endif  /* __OTA_UPDATE_H__ */
+
+/*===========================================================================*/
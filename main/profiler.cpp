@@ -0,0 +1,327 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   profiler.cpp
+@brief  Sampling profiler on the timer0 tick
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+While it runs, the timer0 interrupt of the watchdog ticks at the sampling
+rate and each tick counts where it came in, the program counter loop(),
+the Wi-Fi stack, the MQTT client or the web server was at, into a fixed
+histogram. A level 1 interrupt is taken as an exception, so EPC1 holds
+that address and Profiler_Sample() only reads it.
+
+The histogram is an open addressed hash table of PROFILER_SLOTS, a sample
+goes into its hashed slot or one of the next PROFILER_PROBES, else it is
+counted as dropped. Nothing is allocated, it is 2 KB at the default size.
+
+Code that runs with the interrupts masked, the SDK's critical sections
+and the other interrupts, is not seen. Its time is counted where the
+interrupts come on again.
+
+Started and stopped over MQTT, PROFILER_CMD_TOPIC, or on /profile, and
+it stops by itself after the duration asked for. Once stopped it is
+published on PROFILER_STATE_TOPIC in pieces, the same text /profile
+serves:
+
+  # profile rate_hz=100 ms=60000 samples=6000 dropped=0 isr_cycles=187 ...
+  40201b3c 1234
+  4010045a 12
+  # end
+
+tools/profiler/profile_report.py finds the functions of the addresses in the ELF
+of the build and prints a flat profile, or the folded stacks for a flame
+graph.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "profiler.h"
+#include "watchdog.h"
+#include "mqtt_client.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Fibonacci hashing of the word address */
+#define PROFILER_HASH_MULTIPLIER  2654435761UL
+
+typedef struct
+{
+  uint32_t  pc;
+  uint32_t  count;          /* 0 if the slot is free */
+
+} PROFILER_SLOT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/* Interrupt side */
+static PROFILER_SLOT_RECORD   Profiler_Slots[PROFILER_SLOTS];
+static volatile uint32_t      Profiler_Samples  = 0;
+static volatile uint32_t      Profiler_Dropped  = 0;
+static volatile uint32_t      Profiler_Cycles   = 0;
+
+/* loop() side */
+static BOOL     Profiler_Running      = FALSE;
+static UINT16   Profiler_Rate_Hz      = 0;
+static UINT32   Profiler_Start_ms     = 0;
+static UINT32   Profiler_Duration_ms  = 0;
+static UINT32   Profiler_Ran_ms       = 0;
+
+/* Publishing the profile once stopped, the cursor of the next piece */
+static BOOL     Profiler_Uploading    = FALSE;
+static UINT16   Profiler_Upload_Cursor = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void IRAM_ATTR Profiler_Sample( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Tick function of the watchdog timer, count where it came in */
+static void IRAM_ATTR
+Profiler_Sample( void )
+{
+  uint32_t  Start = ESP.getCycleCount();
+  uint32_t  Pc;
+  uint32_t  Hash;
+  uint32_t  Slot;
+  UINT8     Probe;
+
+#if defined(__XTENSA__)
+  __asm__ __volatile__( "rsr %0, epc1" : "=a" (Pc) );
+#else
+  /* Host build, there is no interrupted PC to read */
+  Pc = (uint32_t)(uintptr_t)__builtin_return_address( 0 );
+#endif
+
+  Profiler_Samples = Profiler_Samples + 1;
+
+  Hash = ((Pc >> 2) * PROFILER_HASH_MULTIPLIER) >> 16;
+  for ( Probe = 0; Probe < PROFILER_PROBES; Probe++ )
+  {
+    Slot = (Hash + Probe) & (PROFILER_SLOTS - 1);
+    if ( Profiler_Slots[Slot].count == 0 )
+    {
+      Profiler_Slots[Slot].pc    = Pc;
+      Profiler_Slots[Slot].count = 1;
+      break;
+    }
+    if ( Profiler_Slots[Slot].pc == Pc )
+    {
+      Profiler_Slots[Slot].count++;
+      break;
+    }
+  }
+
+  if ( Probe == PROFILER_PROBES )
+  {
+    Profiler_Dropped = Profiler_Dropped + 1;
+  }
+
+  Profiler_Cycles = Profiler_Cycles + (ESP.getCycleCount() - Start);
+}
+
+/*===========================================================================*/
+
+/*!
+Start sampling with an empty histogram, the last profile is dropped.
+
+@param  Rate_Hz     Samples per second, 10 to WATCHDOG_TICK_HZ_MAX in
+                    steps of 10, 0 for PROFILER_RATE_HZ, (I)
+@param  Duration_s  Stops by itself after, 0 for PROFILER_DURATION_S, (I)
+@return FALSE if it runs already
+*/
+BOOL
+Profiler_Start( UINT16 Rate_Hz, UINT16 Duration_s )
+{
+  if ( Profiler_Running )
+  {
+    return FALSE;
+  }
+
+  Rate_Hz     = ( Rate_Hz == 0 ) ? PROFILER_RATE_HZ : Rate_Hz;
+  Duration_s  = ( Duration_s == 0 ) ? PROFILER_DURATION_S : Duration_s;
+  Duration_s  = ( Duration_s > PROFILER_DURATION_S_MAX ) ? PROFILER_DURATION_S_MAX : Duration_s;
+
+  memset( Profiler_Slots, 0, sizeof(Profiler_Slots) );
+  Profiler_Samples      = 0;
+  Profiler_Dropped      = 0;
+  Profiler_Cycles       = 0;
+  Profiler_Uploading    = FALSE;
+  Profiler_Duration_ms  = (UINT32)Duration_s * 1000;
+  Profiler_Start_ms     = millis();
+  Profiler_Running      = TRUE;
+
+  Profiler_Rate_Hz = Watchdog_Set_Tick_Func( Profiler_Sample, Rate_Hz );
+
+  LOG( DBG_P, "Profiler: Sampling at %u Hz for %u s.\n", Profiler_Rate_Hz, Duration_s );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Stop sampling and publish the profile */
+void
+Profiler_Stop( void )
+{
+  if ( !Profiler_Running )
+  {
+    return;
+  }
+
+  Watchdog_Set_Tick_Func( NULL, 0 );
+
+  Profiler_Running        = FALSE;
+  Profiler_Ran_ms         = millis() - Profiler_Start_ms;
+  Profiler_Uploading      = TRUE;
+  Profiler_Upload_Cursor  = 0;
+
+  LOG( DBG_P, "Profiler: %lu samples in %lu ms, %lu dropped.\n",
+       (UINT32)Profiler_Samples, Profiler_Ran_ms, (UINT32)Profiler_Dropped );
+}
+
+/*===========================================================================*/
+
+BOOL
+Profiler_Is_Running( void )
+{
+  return Profiler_Running;
+}
+
+/*===========================================================================*/
+
+/*!
+The MQTT command, "start", "start <Hz>", "start <Hz> <s>" or "stop".
+
+@param  pMessage  The payload, (I)
+@return None
+*/
+void
+Profiler_Command( const CHAR *pMessage )
+{
+  unsigned int  Rate_Hz    = 0;
+  unsigned int  Duration_s = 0;
+
+  if ( strncmp( pMessage, "start", 5 ) == 0 )
+  {
+    sscanf( pMessage + 5, "%u %u", &Rate_Hz, &Duration_s );
+    Profiler_Start( Rate_Hz, Duration_s );
+  }
+  else if ( strcmp( pMessage, "stop" ) == 0 )
+  {
+    Profiler_Stop();
+  }
+}
+
+/*===========================================================================*/
+
+/* Stop when the time is up and publish the profile, to call at each loop() */
+void
+Profiler_Handle( void )
+{
+  CHAR    Chunk[PROFILER_CHUNK_SIZE];
+  UINT16  Cursor;
+
+  if ( Profiler_Running && ((millis() - Profiler_Start_ms) >= Profiler_Duration_ms) )
+  {
+    Profiler_Stop();
+  }
+
+  /* A piece per pass, it goes on where it was after a failed publish */
+  if ( !Profiler_Uploading || !mqtt_is_connected() )
+  {
+    return;
+  }
+
+  Cursor = Profiler_Upload_Cursor;
+  if ( Profiler_Format( &Cursor, Chunk, sizeof(Chunk) ) == 0 )
+  {
+    Profiler_Uploading = FALSE;
+    return;
+  }
+
+  if ( mqtt_publish( PSTR(PROFILER_STATE_TOPIC), Chunk ) )
+  {
+    Profiler_Upload_Cursor = Cursor;
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+The profile as text, as many whole lines as fit. The cursor starts at 0
+with the header and goes on over the slots, the last line is "# end".
+
+@param  pCursor   Where to go on, (I/O)
+@param  pBuff     NUL terminated text, (O)
+@param  Size      Size of pBuff, PROFILER_LINE_MAX_SIZE at least, (I)
+@return Its length, 0 once all was given
+*/
+UINT16
+Profiler_Format( UINT16 *pCursor, CHAR *pBuff, UINT16 Size )
+{
+  UINT16  Len = 0;
+  UINT16  Slot;
+
+  pBuff[0] = 0;
+
+  if ( *pCursor == 0 )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len,
+                       PSTR("# profile rate_hz=%u ms=%lu samples=%lu dropped=%lu isr_cycles=%lu cpu_mhz=%u sw=%s\n"),
+                       Profiler_Rate_Hz, Profiler_Running ? (millis() - Profiler_Start_ms) : Profiler_Ran_ms,
+                       (UINT32)Profiler_Samples, (UINT32)Profiler_Dropped,
+                       (Profiler_Samples > 0) ? (UINT32)(Profiler_Cycles / Profiler_Samples) : 0UL,
+                       ESP.getCpuFreqMHz(), SW_REVISION );
+    *pCursor = 1;
+  }
+
+  /* Slot n is at cursor n + 1 */
+  while ( (*pCursor <= PROFILER_SLOTS) && ((Size - Len) >= PROFILER_LINE_MAX_SIZE) )
+  {
+    Slot = *pCursor - 1;
+    if ( Profiler_Slots[Slot].count != 0 )
+    {
+      Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%08lx %lu\n"),
+                         (UINT32)Profiler_Slots[Slot].pc, (UINT32)Profiler_Slots[Slot].count );
+    }
+    (*pCursor)++;
+  }
+
+  if ( (*pCursor == (PROFILER_SLOTS + 1)) && ((Size - Len) >= PROFILER_LINE_MAX_SIZE) )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("# end\n") );
+    (*pCursor)++;
+  }
+
+  return Len;
+}
+
+/*===========================================================================*/
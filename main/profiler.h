@@ -0,0 +1,82 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   profiler.h
+@brief  Sampling profiler on the timer0 tick, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Places in the histogram, a power of 2, 8 bytes each */
+#ifndef PROFILER_SLOTS
+#define PROFILER_SLOTS          256
+#endif
+
+/* Slots tried from the hashed one, a sample finding none free is dropped */
+#define PROFILER_PROBES         8
+
+/* Samples per second and how long, unless given. Each sample takes a few
+   us in the interrupt, the header of the profile has what it really took */
+#define PROFILER_RATE_HZ        100
+#define PROFILER_DURATION_S     60
+#define PROFILER_DURATION_S_MAX 3600
+
+/* Command "start [<Hz> [<s>]]" or "stop", the profile is published in
+   pieces on the state topic once stopped */
+#define PROFILER_CMD_TOPIC      "profile"
+#define PROFILER_STATE_TOPIC    "profile"
+#define PROFILER_CHUNK_SIZE     768
+
+/* Longest line of the profile, the header */
+#define PROFILER_LINE_MAX_SIZE  128
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern BOOL
+Profiler_Start( UINT16 Rate_Hz, UINT16 Duration_s );
+
+extern void
+Profiler_Stop( void );
+
+extern BOOL
+Profiler_Is_Running( void );
+
+extern void
+Profiler_Command( const CHAR *pMessage );
+
+extern void
+Profiler_Handle( void );
+
+extern UINT16
+Profiler_Format( UINT16 *pCursor, CHAR *pBuff, UINT16 Size );
+
+#endif  /* __PROFILER_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,125 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   relay_actuator.cpp
+@brief  The one path that drives the relay, with latency measurement
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A relay command from MQTT used to only set My_Status.relay_status, the
+GPIO followed on a later loop() pass, after the sonar, NTP and HTTP work.
+The HTTP control page wrote the GPIO at once. Now every source goes
+through Relay_Actuate(), called right in the MQTT callback or the HTTP
+handler that got the command:
+
+  received    micros() when the callback or handler was entered
+  actuated    GPIO written, Trace_Relay() recorded
+  acked       the new state published on RELAY_ACK_TOPIC
+
+The commands feed two latency histograms, received to actuated and
+received to acked, on /metrics. Changes decided by loop() itself are
+written and acknowledged the same way but not timed.
+
+Persisting the state is left to loop(), an EEPROM commit takes too long
+for this path.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "relay_actuator.h"
+#include "mqtt_client.h"
+#include "metrics.h"
+#include "trace.h"
+#include "flash_string.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static RELAY_ACTUATION_RECORD Relay_Last;
+
+/* Names used in logs */
+static const CHAR Relay_Source_Names[NUM_RELAY_SOURCES][8] PROGMEM =
+{
+  "mqtt", "http", "auto"
+};
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/*!
+Drive the relay and acknowledge it, before anything else is done.
+
+@param  Relay_Status  TRUE-On;FALSE-Off, (I)
+@param  Source        Where the command came from, (I)
+@param  Received_us   micros() when the command was received, (I)
+@return None
+*/
+void
+Relay_Actuate( BOOL Relay_Status, RELAY_SOURCE Source, UINT32 Received_us )
+{
+  CHAR  Source_Name[sizeof(Relay_Source_Names[0])];
+
+  digitalWrite( GPIO_RELAY, Relay_Status ? HIGH : LOW );
+
+  Relay_Last.actuated_us  = micros();
+  Relay_Last.source       = Source;
+  Relay_Last.relay_status = Relay_Status;
+  Relay_Last.received_us  = Received_us;
+  Relay_Last.acked_us     = 0;
+
+  My_Status_Write_Begin();
+  My_Status.relay_status  = Relay_Status;
+  My_Status_Write_End();
+  Trace_Relay( Relay_Status );
+
+  /* At least once, a missed change leaves the other side wrong until the next report */
+  if ( mqtt_publish_qos1( PSTR(RELAY_ACK_TOPIC), Relay_Status ? "on" : "off" ) && mqtt_is_connected() )
+  {
+    Relay_Last.acked_us = micros();
+  }
+
+  /* Only commands are timed */
+  if ( Source != RELAY_SOURCE_AUTO )
+  {
+    Metric_Observe_Latency( METRIC_RELAY_GPIO_LATENCY, Relay_Last.actuated_us - Received_us );
+    if ( Relay_Last.acked_us != 0 )
+    {
+      Metric_Observe_Latency( METRIC_RELAY_ACK_LATENCY, Relay_Last.acked_us - Received_us );
+    }
+  }
+
+  Flash_String_Copy( Source_Name, sizeof(Source_Name), Relay_Source_Names[Source] );
+  LOG( DBG_N, "Relay: %s by %s, actuated in %lu us, acked in %lu us\n",
+              Relay_Status ? "on" : "off", Source_Name,
+              Relay_Last.actuated_us - Received_us,
+              (Relay_Last.acked_us != 0) ? (Relay_Last.acked_us - Received_us) : 0 );
+}
+
+/*===========================================================================*/
@@ -0,0 +1,68 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   relay_actuator.h
+@brief  The one path that drives the relay, with latency measurement, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __RELAY_ACTUATOR_H__
+#define __RELAY_ACTUATOR_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Every relay change is published here, "on"/"off", as the acknowledgement */
+#define RELAY_ACK_TOPIC       "relay_ack"
+
+/* Where a relay change came from */
+typedef enum
+{
+  RELAY_SOURCE_MQTT = 0,
+  RELAY_SOURCE_HTTP,
+  RELAY_SOURCE_AUTO,          /* Relay_Decide() in loop(), not timed */
+  NUM_RELAY_SOURCES
+
+} RELAY_SOURCE;
+
+/* Timing of the last relay change, micros() */
+typedef struct
+{
+  RELAY_SOURCE  source;
+  BOOL          relay_status;
+  UINT32        received_us;      /* Command received */
+  UINT32        actuated_us;      /* GPIO written */
+  UINT32        acked_us;         /* Published on RELAY_ACK_TOPIC, 0 if not connected */
+
+} RELAY_ACTUATION_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Relay_Actuate( BOOL Relay_Status, RELAY_SOURCE Source, UINT32 Received_us );
+
+#endif  /* __RELAY_ACTUATOR_H__ */
+
+/*===========================================================================*/
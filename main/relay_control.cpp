@@ -0,0 +1,307 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   relay_control.cpp
+@brief  Sonar distance filter and relay decision logic
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Moved out of loop() unchanged in behaviour. In auto mode the relay follows
+the water level with hysteresis, otherwise it follows the on/off timing.
+
+Commands use the MQTT topic and message strings, the same whether they come
+from the broker or from a replayed trace.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdlib.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "relay_control.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static BOOL Relay_Decide_Auto( const MY_CONFIG_RECORD *pConfig, const RELAY_INPUT_RECORD *pInput, BOOL Relay_Status );
+static BOOL Relay_Decide_Timing( const MY_CONFIG_RECORD *pConfig, const RELAY_INPUT_RECORD *pInput, BOOL Relay_Status );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Operate the relay according to sonar distance */
+static BOOL
+Relay_Decide_Auto( const MY_CONFIG_RECORD *pConfig, const RELAY_INPUT_RECORD *pInput, BOOL Relay_Status )
+{
+  if ( pInput->distance_valid == FALSE )
+  {
+    return FALSE;
+  }
+
+  /* More than high distance means low water level, turn off relay
+     Less than low distance means high water level, turn on relay
+     To avoid switch relay frequently */
+  if ( pInput->avg_distance_cm > pConfig->high_distance_cm )
+  {
+    Relay_Status = FALSE;
+  }
+
+  if ( pInput->avg_distance_cm < pConfig->low_distance_cm )
+  {
+    Relay_Status = TRUE;
+  }
+
+  return Relay_Status;
+}
+
+/*===========================================================================*/
+
+/* Operate the relay according to timing */
+static BOOL
+Relay_Decide_Timing( const MY_CONFIG_RECORD *pConfig, const RELAY_INPUT_RECORD *pInput, BOOL Relay_Status )
+{
+  UINT32  Today_Minutes;        /* Mintues since the beginning of today */
+  UINT32  Timing_On_Minutes;
+  UINT32  Timing_Off_Minutes;
+
+  /* Without valid time, keep the relay as it was */
+  if ( pInput->time_valid == FALSE )
+  {
+    return Relay_Status;
+  }
+
+  /* If both timing on and off are enabled, operate relay in time range
+     else operate relay by time point.
+     Because if only refer to time point, the relay status may be wrong after ESP reboot */
+  if ( (pConfig->relay_on_timing.valid == TRUE) && (pConfig->relay_off_timing.valid == TRUE) )
+  {
+    Today_Minutes       = pInput->hour*60 + pInput->minute;
+    Timing_On_Minutes   = pConfig->relay_on_timing.hh*60 + pConfig->relay_on_timing.mm;
+    Timing_Off_Minutes  = pConfig->relay_off_timing.hh*60 + pConfig->relay_off_timing.mm;
+
+    if( Timing_Off_Minutes >= Timing_On_Minutes )
+    {
+      /* NOT include 00:00 */
+      return ( (Today_Minutes >= Timing_On_Minutes) && (Today_Minutes < Timing_Off_Minutes) );
+    }
+    else
+    {
+      /* Include 00:00 */
+      return ( (Today_Minutes >= Timing_On_Minutes) || (Today_Minutes < Timing_Off_Minutes) );
+    }
+  }
+
+  /* Check if it is time to turn on/off relay */
+  if ( pConfig->relay_on_timing.valid )
+  {
+    if ( (pConfig->relay_on_timing.hh == pInput->hour) && (pConfig->relay_on_timing.mm == pInput->minute) )
+    {
+      Relay_Status = TRUE;
+    }
+  }
+
+  if ( pConfig->relay_off_timing.valid )
+  {
+    if ( (pConfig->relay_off_timing.hh == pInput->hour) && (pConfig->relay_off_timing.mm == pInput->minute) )
+    {
+      Relay_Status = FALSE;
+    }
+  }
+
+  return Relay_Status;
+}
+
+/*===========================================================================*/
+
+/* Fill the whole window with one sample, so the average is valid at once */
+void
+Sonar_Filter_Reset( SONAR_FILTER_RECORD *pFilter, FLOAT Distance_cm )
+{
+  UINT8   Count;
+
+  for ( Count = 0; Count < DISTANCE_WINDOW_LPF_WIDTH; Count++ )
+  {
+    pFilter->history[Count] = Distance_cm;
+  }
+  pFilter->index            = 0;
+  pFilter->avg_distance_cm  = Distance_cm;
+}
+
+/*===========================================================================*/
+
+/*!
+Add a raw sample and update the average, invalid samples are skipped.
+
+@param  pFilter           Filter, (I/O)
+@param  Raw_Distance_cm   Raw sample, 0 if the measurement failed, (I)
+@return TRUE if the sample is valid
+*/
+BOOL
+Sonar_Filter_Add( SONAR_FILTER_RECORD *pFilter, FLOAT Raw_Distance_cm )
+{
+  UINT8   Count;
+  FLOAT   Sum = 0;
+
+  if ( Raw_Distance_cm == 0 )
+  {
+    return FALSE;
+  }
+
+  /* Update history records */
+  pFilter->history[pFilter->index] = Raw_Distance_cm;
+  pFilter->index = CIRCULAR_INC( pFilter->index, DISTANCE_WINDOW_LPF_WIDTH );
+
+  /* Do average */
+  for ( Count = 0; Count < DISTANCE_WINDOW_LPF_WIDTH; ++Count )
+  {
+    Sum += pFilter->history[Count];
+  }
+  pFilter->avg_distance_cm = Sum/DISTANCE_WINDOW_LPF_WIDTH;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+Apply a command to the config or the relay.
+
+@param  pConfig         Config, (I/O)
+@param  pRelay_Status   Relay status, (I/O)
+@param  pTopic          Command topic, (I)
+@param  pMessage        Command message, (I)
+@return TRUE if the topic is a relay command
+*/
+BOOL
+Relay_Apply_Command( MY_CONFIG_RECORD *pConfig, BOOL *pRelay_Status, const CHAR *pTopic, const CHAR *pMessage )
+{
+  FLOAT   Time_hour;
+  FLOAT   Distance_cm;
+
+  /* Topic: 'relay_status' */
+  if ( strcmp( pTopic, "relay_status" ) == 0 )
+  {
+    *pRelay_Status = ( strcmp( pMessage, "on" ) == 0 );
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* Topic: 'relay_timing_on_enable' and 'relay_timing_on_time' */
+  else if ( strcmp( pTopic, "relay_timing_on_enable" ) == 0 )
+  {
+    pConfig->relay_on_timing.valid = ( strcmp( pMessage, "true" ) == 0 );
+  }
+
+  else if ( strcmp( pTopic, "relay_timing_on_time" ) == 0 )
+  {
+    Time_hour = atof( pMessage );
+
+    /* 24 hours */
+    if( (Time_hour >= 0) && (Time_hour < 24) )
+    {
+      pConfig->relay_on_timing.hh = (UINT32)Time_hour;
+      pConfig->relay_on_timing.mm = (UINT32)((Time_hour - (FLOAT)pConfig->relay_on_timing.hh)*60);
+    }
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* Topic: 'relay_timing_off_enable' and 'relay_timing_off_time' */
+  else if ( strcmp( pTopic, "relay_timing_off_enable" ) == 0 )
+  {
+    pConfig->relay_off_timing.valid = ( strcmp( pMessage, "true" ) == 0 );
+  }
+
+  else if ( strcmp( pTopic, "relay_timing_off_time" ) == 0 )
+  {
+    Time_hour = atof( pMessage );
+
+    /* 24 hours */
+    if( (Time_hour >= 0) && (Time_hour < 24) )
+    {
+      pConfig->relay_off_timing.hh = (UINT32)Time_hour;
+      pConfig->relay_off_timing.mm = (UINT32)((Time_hour - (FLOAT)pConfig->relay_off_timing.hh)*60);
+    }
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* Topic: 'auto_control_relay', 'high_distance' and 'low_distance' */
+  else if ( strcmp( pTopic, "auto_control_relay" ) == 0 )
+  {
+    pConfig->relay_auto = ( strcmp( pMessage, "true" ) == 0 );
+  }
+
+  else if ( strcmp( pTopic, "high_distance" ) == 0 )
+  {
+    Distance_cm = atof( pMessage );
+    if ( (Distance_cm > 0) && (Distance_cm <= 300) )
+    {
+      pConfig->high_distance_cm = Distance_cm;
+    }
+  }
+
+  else if ( strcmp( pTopic, "low_distance" ) == 0 )
+  {
+    Distance_cm = atof( pMessage );
+    if ( (Distance_cm > 0) && (Distance_cm <= 300) )
+    {
+      pConfig->low_distance_cm = Distance_cm;
+    }
+  }
+
+  else
+  {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/*!
+Decide the relay status, in auto mode by distance, otherwise by timing.
+
+@param  pConfig         Config, (I)
+@param  pInput          Distance and local time, (I)
+@param  Relay_Status    Current relay status, (I)
+@return The new relay status
+*/
+BOOL
+Relay_Decide( const MY_CONFIG_RECORD *pConfig, const RELAY_INPUT_RECORD *pInput, BOOL Relay_Status )
+{
+  if ( pConfig->relay_auto == TRUE )
+  {
+    return Relay_Decide_Auto( pConfig, pInput, Relay_Status );
+  }
+
+  return Relay_Decide_Timing( pConfig, pInput, Relay_Status );
+}
+
+/*===========================================================================*/
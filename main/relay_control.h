@@ -0,0 +1,82 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   relay_control.h
+@brief  Sonar distance filter and relay decision logic
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Pure logic without any Arduino calls, time and samples are passed in.
+It builds with a plain host compiler, so the relay control can be run
+against recorded or scripted samples off the device.
+*/
+
+#ifndef __RELAY_CONTROL_H__
+#define __RELAY_CONTROL_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The deepth of sonar distance window LPF */
+#define DISTANCE_WINDOW_LPF_WIDTH 10
+
+/* Sonar distance window LPF */
+typedef struct
+{
+  FLOAT   history[DISTANCE_WINDOW_LPF_WIDTH];
+  UINT8   index;
+  FLOAT   avg_distance_cm;
+
+} SONAR_FILTER_RECORD;
+
+/* Everything the relay decision depends on, besides the config */
+typedef struct
+{
+  /* Filtered sonar distance, used in auto mode */
+  BOOL    distance_valid;
+  FLOAT   avg_distance_cm;
+
+  /* Local time, used in timing mode */
+  BOOL    time_valid;
+  UINT8   hour;
+  UINT8   minute;
+
+} RELAY_INPUT_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Sonar_Filter_Reset( SONAR_FILTER_RECORD *pFilter, FLOAT Distance_cm );
+
+extern BOOL
+Sonar_Filter_Add( SONAR_FILTER_RECORD *pFilter, FLOAT Raw_Distance_cm );
+
+extern BOOL
+Relay_Apply_Command( MY_CONFIG_RECORD *pConfig, BOOL *pRelay_Status, const CHAR *pTopic, const CHAR *pMessage );
+
+extern BOOL
+Relay_Decide( const MY_CONFIG_RECORD *pConfig, const RELAY_INPUT_RECORD *pInput, BOOL Relay_Status );
+
+#endif  /* __RELAY_CONTROL_H__ */
+
+/*===========================================================================*/
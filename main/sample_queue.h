@@ -0,0 +1,149 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sample_queue.h
+@brief  Lock-free queue of sensor samples from an interrupt to loop()
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A single-producer single-consumer ring. The producer is an interrupt
+handler, the consumer is loop(), neither ever waits for the other and no
+interrupts are masked:
+
+  head  is only written by the producer, after the sample is in its slot
+  tail  is only written by the consumer, after the sample is copied out
+
+Both are free running and wrap at 2^16, the slot is the index masked by
+SAMPLE_QUEUE_SIZE - 1. When the ring is full the new sample is dropped
+and counted, loop() falling behind never blocks the interrupt.
+
+All inline and without Arduino calls, so tools/sample_queue_check builds
+it on the host.
+*/
+
+#ifndef __SAMPLE_QUEUE_H__
+#define __SAMPLE_QUEUE_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Slots in the ring, a power of 2, 1.6 sec of samples at 10 Hz */
+#define SAMPLE_QUEUE_SIZE     16
+
+/* Orders the slot access against the index update, on the single core
+   ESP8266 it only keeps the compiler from reordering. The host check puts
+   its simulated interrupts here */
+#ifndef SAMPLE_QUEUE_RELEASE
+#define SAMPLE_QUEUE_RELEASE()  __atomic_thread_fence( __ATOMIC_RELEASE )
+#define SAMPLE_QUEUE_ACQUIRE()  __atomic_thread_fence( __ATOMIC_ACQUIRE )
+#endif
+
+/* One sample, the times are micros() */
+typedef struct
+{
+  uint32_t  seq;          /* Counts the triggers, a gap is a dropped sample */
+  uint32_t  trigger_us;   /* When the ping was sent */
+  uint32_t  echo_us;      /* Width of the echo, 0 if none came back */
+
+} SAMPLE_RECORD;
+
+typedef struct
+{
+  volatile uint16_t head;     /* Next slot to write, producer only */
+  volatile uint16_t tail;     /* Next slot to read, consumer only */
+  volatile uint32_t drops;    /* Samples lost to a full ring, producer only */
+  SAMPLE_RECORD     slot[SAMPLE_QUEUE_SIZE];
+
+} SAMPLE_QUEUE_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+static inline void
+Sample_Queue_Init( SAMPLE_QUEUE_RECORD *pQueue )
+{
+  pQueue->head  = 0;
+  pQueue->tail  = 0;
+  pQueue->drops = 0;
+}
+
+/*===========================================================================*/
+
+/* Producer, FALSE if the ring is full and the sample is dropped */
+static inline BOOL
+Sample_Queue_Push( SAMPLE_QUEUE_RECORD *pQueue, const SAMPLE_RECORD *pSample )
+{
+  uint16_t  Head = pQueue->head;
+
+  if ( (uint16_t)(Head - pQueue->tail) >= SAMPLE_QUEUE_SIZE )
+  {
+    pQueue->drops = pQueue->drops + 1;
+    return FALSE;
+  }
+
+  pQueue->slot[Head & (SAMPLE_QUEUE_SIZE - 1)] = *pSample;
+
+  /* The slot is written before the consumer can see it */
+  SAMPLE_QUEUE_RELEASE();
+  pQueue->head = Head + 1;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Consumer, FALSE if the ring is empty */
+static inline BOOL
+Sample_Queue_Pop( SAMPLE_QUEUE_RECORD *pQueue, SAMPLE_RECORD *pSample )
+{
+  uint16_t  Tail = pQueue->tail;
+
+  if ( Tail == pQueue->head )
+  {
+    return FALSE;
+  }
+
+  /* The slot is read after the head that published it */
+  SAMPLE_QUEUE_ACQUIRE();
+  *pSample = pQueue->slot[Tail & (SAMPLE_QUEUE_SIZE - 1)];
+
+  /* and before the producer can reuse it */
+  SAMPLE_QUEUE_RELEASE();
+  pQueue->tail = Tail + 1;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Samples waiting, either side */
+static inline uint16_t
+Sample_Queue_Count( const SAMPLE_QUEUE_RECORD *pQueue )
+{
+  return (uint16_t)(pQueue->head - pQueue->tail);
+}
+
+#endif  /* __SAMPLE_QUEUE_H__ */
+
+/*===========================================================================*/
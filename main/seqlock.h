@@ -0,0 +1,144 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   seqlock.h
+@brief  Sequence lock, consistent copies of a record without blocking its writer
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The writer makes the sequence odd before it changes the record and even
+again after. A reader copies the record and checks the sequence did not
+move and was even, else it copies again:
+
+  Writer                          Reader
+  Seqlock_Write_Begin( &Lock );   Version = Seqlock_Read( &Lock, &Copy,
+  Record.a = ...;                                         &Record, sizeof(Copy) );
+  Record.b = ...;
+  Seqlock_Write_End( &Lock );
+
+The writer never waits and nothing masks interrupts. The writers must be
+in one context, sections may nest and count as one. A reader may be
+preempted by the writer, but must not preempt it, e.g. read from an
+interrupt while loop() writes, it would wait for ever.
+
+The version is the number of finished write sections, it only goes up, so
+it tells a reader whether anything changed since its last copy.
+
+All inline and without Arduino calls, so tools/seqlock_check builds it on
+the host.
+*/
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Orders the sequence against the record, on the single core ESP8266 it
+   only keeps the compiler from reordering */
+#define SEQLOCK_FENCE()   __atomic_thread_fence( __ATOMIC_SEQ_CST )
+
+/* Copies the record, the host check puts its simulated writer in here */
+#ifndef SEQLOCK_COPY
+#define SEQLOCK_COPY( pDst, pSrc, Size )  memcpy( (pDst), (const void *)(pSrc), (Size) )
+#endif
+
+typedef struct
+{
+  volatile uint32_t seq;      /* Odd while a write is in progress */
+  uint8_t           depth;    /* Nested write sections, writer only */
+
+} SEQLOCK_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+static inline void
+Seqlock_Init( SEQLOCK_RECORD *pLock )
+{
+  pLock->seq   = 0;
+  pLock->depth = 0;
+}
+
+/*===========================================================================*/
+
+static inline void
+Seqlock_Write_Begin( SEQLOCK_RECORD *pLock )
+{
+  if ( pLock->depth++ == 0 )
+  {
+    pLock->seq = pLock->seq + 1;
+    SEQLOCK_FENCE();
+  }
+}
+
+/*===========================================================================*/
+
+static inline void
+Seqlock_Write_End( SEQLOCK_RECORD *pLock )
+{
+  if ( --pLock->depth == 0 )
+  {
+    SEQLOCK_FENCE();
+    pLock->seq = pLock->seq + 1;
+  }
+}
+
+/*===========================================================================*/
+
+/* Copy the record as one, returns its version */
+static inline uint32_t
+Seqlock_Read( const SEQLOCK_RECORD *pLock, void *pCopy, const volatile void *pRecord, size_t Size )
+{
+  uint32_t  Seq;
+
+  do
+  {
+    /* Wait for a write in progress to finish */
+    while ( (Seq = pLock->seq) & 1 )
+    {
+    }
+
+    SEQLOCK_FENCE();
+    SEQLOCK_COPY( pCopy, pRecord, Size );
+    SEQLOCK_FENCE();
+
+  } while ( Seq != pLock->seq );
+
+  return Seq / 2;
+}
+
+/*===========================================================================*/
+
+/* Finished write sections so far */
+static inline uint32_t
+Seqlock_Version( const SEQLOCK_RECORD *pLock )
+{
+  return pLock->seq / 2;
+}
+
+#endif  /* __SEQLOCK_H__ */
+
+/*===========================================================================*/
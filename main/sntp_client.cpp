@@ -0,0 +1,552 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sntp_client.cpp
+@brief  Non-blocking SNTP client, syncs the local clock
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Nothing here waits. A request is sent and Sntp_Handle() picks up the reply
+on a later loop() pass, DNS lookups use the lwIP callback.
+
+Each poll sends a burst of SNTP_BURST_SIZE requests to one server and keeps
+the sample with the lowest round trip, its offset has the least error from
+asymmetric delay. If no valid reply comes back, the next server is tried
+with an exponential backoff.
+
+The offset is handed to Local_Clock_Sync(), small ones are slewed.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <lwip/dns.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sntp_client.h"
+#include "local_clock.h"
+#include "wifi_manager.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Seconds from 1900-01-01 to 1970-01-01 */
+#define NTP_UNIX_OFFSET_S   2208988800ULL
+
+/* Field offsets in the packet */
+#define NTP_OFS_FLAGS       0
+#define NTP_OFS_STRATUM     1
+#define NTP_OFS_ORIGINATE   24
+#define NTP_OFS_RECEIVE     32
+#define NTP_OFS_TRANSMIT    40
+
+/* LI 0, version 4, mode 3 (client) */
+#define NTP_CLIENT_FLAGS    0x23
+#define NTP_MODE_SERVER     4
+#define NTP_LI_UNSYNCED     3
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static WiFiUDP      Sntp_Udp;
+
+static const CHAR  *Sntp_Servers[SNTP_SERVER_MAX];
+static UINT8        Sntp_Num_Servers  = 0;
+static UINT8        Sntp_Server_Index = 0;
+static IPAddress    Sntp_Server_IP;
+
+static BOOL         Sntp_Started      = FALSE;
+static SNTP_STATE   Sntp_State        = SNTP_STATE_IDLE;
+static UINT32       Sntp_State_Start_ms = 0;
+
+/* When the last poll ended, and how long to wait for the next */
+static UINT32       Sntp_Last_Poll_ms = 0;
+static UINT32       Sntp_Interval_ms  = 0;
+static UINT32       Sntp_Retry_ms     = SNTP_RETRY_MIN_MS;
+
+/* DNS lookup in progress, the sequence drops late callbacks */
+static volatile UINT8 Sntp_Dns_Seq    = 0;
+static volatile BOOL  Sntp_Dns_Done   = FALSE;
+static volatile BOOL  Sntp_Dns_Failed = FALSE;
+static volatile UINT32 Sntp_Dns_Addr  = 0;
+
+/* Current request, the transmit timestamp sent must come back as originate */
+static UINT8        Sntp_Cookie[8];
+static INT64        Sntp_T1_us        = 0;
+
+/* Burst state, the best sample is the one with the lowest RTT */
+static UINT8        Sntp_Burst_Count  = 0;
+static BOOL         Sntp_Best_Valid   = FALSE;
+static INT64        Sntp_Best_Offset_us = 0;
+static INT64        Sntp_Best_Rtt_us  = 0;
+static UINT32       Sntp_Last_Rtt_us  = 0;
+static INT64        Sntp_Last_Offset_us = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Sntp_Set_State( SNTP_STATE State );
+static void   Sntp_Dns_Found( const char *pName, const ip_addr_t *pAddr, void *pArg );
+static void   Sntp_Resolve( void );
+static void   Sntp_Send( void );
+static void   Sntp_Receive( void );
+static void   Sntp_Next_Request( void );
+static void   Sntp_Finish_Poll( void );
+static BOOL   Sntp_Time_Is_Set( const UINT8 *pBuff );
+static INT64  Sntp_Read_Time_us( const UINT8 *pBuff );
+static void   Sntp_Write_Time( UINT8 *pBuff, INT64 Time_us );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Sntp_Set_State( SNTP_STATE State )
+{
+  Sntp_State          = State;
+  Sntp_State_Start_ms = millis();
+}
+
+/*===========================================================================*/
+
+/* FALSE for an NTP timestamp of all zeros, a time the server didn't give */
+static BOOL
+Sntp_Time_Is_Set( const UINT8 *pBuff )
+{
+  UINT8   Index;
+
+  for ( Index = 0; Index < 8; Index++ )
+  {
+    if ( pBuff[Index] != 0 )
+    {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/*===========================================================================*/
+
+/* NTP timestamp to UTC microseconds since 1970 */
+static INT64
+Sntp_Read_Time_us( const UINT8 *pBuff )
+{
+  UINT64  Secs;
+  UINT32  Frac;
+
+  Secs = ((UINT32)pBuff[0] << 24) | ((UINT32)pBuff[1] << 16) | ((UINT32)pBuff[2] << 8) | pBuff[3];
+  Frac = ((UINT32)pBuff[4] << 24) | ((UINT32)pBuff[5] << 16) | ((UINT32)pBuff[6] << 8) | pBuff[7];
+
+  /* RFC 4330, MSB clear means era 1, after 2036-02-07 */
+  if ( (Secs & 0x80000000UL) == 0 )
+  {
+    Secs += 0x100000000ULL;
+  }
+
+  return (INT64)(Secs - NTP_UNIX_OFFSET_S) * 1000000LL + (INT64)(((UINT64)Frac * 1000000ULL) >> 32);
+}
+
+/*===========================================================================*/
+
+/* UTC microseconds since 1970 to NTP timestamp */
+static void
+Sntp_Write_Time( UINT8 *pBuff, INT64 Time_us )
+{
+  UINT32  Secs;
+  UINT32  Frac;
+
+  Secs = (UINT32)( (UINT64)(Time_us / 1000000LL) + NTP_UNIX_OFFSET_S );
+  Frac = (UINT32)( ((UINT64)(Time_us % 1000000LL) << 32) / 1000000ULL );
+
+  pBuff[0] = (UINT8)(Secs >> 24);
+  pBuff[1] = (UINT8)(Secs >> 16);
+  pBuff[2] = (UINT8)(Secs >> 8);
+  pBuff[3] = (UINT8)(Secs);
+  pBuff[4] = (UINT8)(Frac >> 24);
+  pBuff[5] = (UINT8)(Frac >> 16);
+  pBuff[6] = (UINT8)(Frac >> 8);
+  pBuff[7] = (UINT8)(Frac);
+}
+
+/*===========================================================================*/
+
+/* lwIP DNS callback, only records the result, Sntp_Handle() acts on it */
+static void
+Sntp_Dns_Found( const char *pName, const ip_addr_t *pAddr, void *pArg )
+{
+  (void)pName;
+
+  if ( (UINT8)(uintptr_t)pArg != Sntp_Dns_Seq )
+  {
+    return;
+  }
+
+  if ( pAddr == NULL )
+  {
+    Sntp_Dns_Failed = TRUE;
+    return;
+  }
+
+  Sntp_Dns_Addr = (UINT32)IPAddress( pAddr );
+  Sntp_Dns_Done = TRUE;
+}
+
+/*===========================================================================*/
+
+/* Look up the current server, send at once if the address is cached */
+static void
+Sntp_Resolve( void )
+{
+  ip_addr_t   Addr;
+  err_t       Err;
+
+  Sntp_Dns_Seq++;
+  Sntp_Dns_Done   = FALSE;
+  Sntp_Dns_Failed = FALSE;
+
+  /* A literal IP needs no lookup */
+  if ( Sntp_Server_IP.fromString( Sntp_Servers[Sntp_Server_Index] ) )
+  {
+    Sntp_Send();
+    return;
+  }
+
+  Err = dns_gethostbyname( Sntp_Servers[Sntp_Server_Index], &Addr,
+                           Sntp_Dns_Found, (void *)(uintptr_t)Sntp_Dns_Seq );
+  if ( Err == ERR_OK )
+  {
+    Sntp_Server_IP = IPAddress( &Addr );
+    Sntp_Send();
+  }
+  else if ( Err == ERR_INPROGRESS )
+  {
+    Sntp_Set_State( SNTP_STATE_RESOLVING );
+  }
+  else
+  {
+    LOG( DBG_W, "SNTP: DNS lookup of %s failed.\n", Sntp_Servers[Sntp_Server_Index] );
+    Sntp_Finish_Poll();
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Sntp_Send( void )
+{
+  UINT8   Packet[SNTP_PACKET_SIZE];
+
+  /* Drop any late reply of a previous request */
+  while ( Sntp_Udp.parsePacket() > 0 )
+  {
+    Sntp_Udp.flush();
+  }
+
+  memset( Packet, 0, sizeof(Packet) );
+  Packet[NTP_OFS_FLAGS] = NTP_CLIENT_FLAGS;
+
+  /* The local time is only used to match the reply, it may not be valid */
+  Sntp_T1_us = Local_Clock_Now_us();
+  Sntp_Write_Time( &Packet[NTP_OFS_TRANSMIT], Sntp_T1_us );
+  memcpy( Sntp_Cookie, &Packet[NTP_OFS_TRANSMIT], sizeof(Sntp_Cookie) );
+
+  if ( (Sntp_Udp.beginPacket( Sntp_Server_IP, SNTP_PORT ) == 0) ||
+       (Sntp_Udp.write( Packet, sizeof(Packet) ) != sizeof(Packet)) ||
+       (Sntp_Udp.endPacket() == 0) )
+  {
+    LOG( DBG_W, "SNTP: Send to %s failed.\n", Sntp_Server_IP.toString().c_str() );
+    Sntp_Next_Request();
+    return;
+  }
+
+  Sntp_Set_State( SNTP_STATE_WAIT_REPLY );
+}
+
+/*===========================================================================*/
+
+/* Check a reply, and keep it if it has the lowest RTT of the burst */
+static void
+Sntp_Receive( void )
+{
+  UINT8   Packet[SNTP_PACKET_SIZE];
+  INT64   T1_us, T2_us, T3_us, T4_us;
+  INT64   Offset_us;
+  INT64   Rtt_us;
+  INT32   Size;
+
+  Size = Sntp_Udp.parsePacket();
+  if ( Size <= 0 )
+  {
+    return;
+  }
+
+  T4_us = Local_Clock_Now_us();
+
+  if ( (Size < SNTP_PACKET_SIZE) ||
+       (Sntp_Udp.remoteIP() != Sntp_Server_IP) ||
+       (Sntp_Udp.read( Packet, sizeof(Packet) ) != sizeof(Packet)) )
+  {
+    Sntp_Udp.flush();
+    return;
+  }
+  Sntp_Udp.flush();
+
+  /* Not ours, or a late reply of an earlier request, keep waiting */
+  if ( ((Packet[NTP_OFS_FLAGS] & 0x07) != NTP_MODE_SERVER) ||
+       (memcmp( &Packet[NTP_OFS_ORIGINATE], Sntp_Cookie, sizeof(Sntp_Cookie) ) != 0) )
+  {
+    return;
+  }
+
+  /* Kiss-o'-Death or an unsynced server, give up on this server */
+  if ( (Packet[NTP_OFS_STRATUM] == 0) || (Packet[NTP_OFS_STRATUM] > 15) ||
+       ((Packet[NTP_OFS_FLAGS] >> 6) == NTP_LI_UNSYNCED) )
+  {
+    LOG( DBG_W, "SNTP: %s is not usable, stratum %u.\n",
+         Sntp_Servers[Sntp_Server_Index], Packet[NTP_OFS_STRATUM] );
+    Sntp_Burst_Count = SNTP_BURST_SIZE;
+    Sntp_Next_Request();
+    return;
+  }
+
+  /* RFC 4330 section 5, a zero time is not read as one of era 1, and the
+     server can't have sent before it received */
+  T1_us = Sntp_T1_us;
+  T2_us = Sntp_Read_Time_us( &Packet[NTP_OFS_RECEIVE] );
+  T3_us = Sntp_Read_Time_us( &Packet[NTP_OFS_TRANSMIT] );
+  if ( !Sntp_Time_Is_Set( &Packet[NTP_OFS_RECEIVE] ) ||
+       !Sntp_Time_Is_Set( &Packet[NTP_OFS_TRANSMIT] ) ||
+       (T3_us < T2_us) )
+  {
+    LOG( DBG_W, "SNTP: Bad times from %s, dropped.\n", Sntp_Servers[Sntp_Server_Index] );
+    Sntp_Next_Request();
+    return;
+  }
+
+  Offset_us = ( (T2_us - T1_us) + (T3_us - T4_us) ) / 2;
+  Rtt_us    = (T4_us - T1_us) - (T3_us - T2_us);
+  if ( Rtt_us < 0 )
+  {
+    Rtt_us = 0;
+  }
+
+  LOG( DBG_1, "SNTP: Sample RTT %ld us\n", (INT32)Rtt_us );
+
+  if ( Rtt_us > SNTP_MAX_RTT_MS * 1000LL )
+  {
+    LOG( DBG_I, "SNTP: RTT %ld ms too long, dropped.\n", (INT32)(Rtt_us / 1000) );
+  }
+  else if ( !Sntp_Best_Valid || (Rtt_us < Sntp_Best_Rtt_us) )
+  {
+    Sntp_Best_Valid     = TRUE;
+    Sntp_Best_Offset_us = Offset_us;
+    Sntp_Best_Rtt_us    = Rtt_us;
+  }
+
+  Sntp_Next_Request();
+}
+
+/*===========================================================================*/
+
+/* One request of the burst is done, wait for the next or finish */
+static void
+Sntp_Next_Request( void )
+{
+  if ( ++Sntp_Burst_Count < SNTP_BURST_SIZE )
+  {
+    Sntp_Set_State( SNTP_STATE_BURST_WAIT );
+  }
+  else
+  {
+    Sntp_Finish_Poll();
+  }
+}
+
+/*===========================================================================*/
+
+/* Apply the best sample of the burst, or move on to the next server */
+static void
+Sntp_Finish_Poll( void )
+{
+  BOOL  Stepped;
+
+  Sntp_Last_Poll_ms = millis();
+  Sntp_Set_State( SNTP_STATE_IDLE );
+
+  if ( Sntp_Best_Valid )
+  {
+    /* The local clock is not touched during a burst, the offset still holds */
+    Stepped = Local_Clock_Sync( Local_Clock_Now_us() + Sntp_Best_Offset_us );
+    Sntp_Last_Rtt_us    = (UINT32)Sntp_Best_Rtt_us;
+    Sntp_Last_Offset_us = Sntp_Best_Offset_us;
+
+    if ( Stepped )
+    {
+      LOG( DBG_N, "SNTP: Synced with %s, clock stepped, RTT %lu us.\n",
+           Sntp_Servers[Sntp_Server_Index], Sntp_Last_Rtt_us );
+    }
+    else
+    {
+      LOG( DBG_N, "SNTP: Synced with %s, slewing %ld us, RTT %lu us.\n",
+           Sntp_Servers[Sntp_Server_Index], (INT32)Sntp_Best_Offset_us, Sntp_Last_Rtt_us );
+    }
+
+    Sntp_Retry_ms    = SNTP_RETRY_MIN_MS;
+    Sntp_Interval_ms = SNTP_POLL_INTERVAL_MS;
+    return;
+  }
+
+  LOG( DBG_E, "SNTP: No valid reply from %s, retry in %lu ms.\n",
+       Sntp_Servers[Sntp_Server_Index], Sntp_Retry_ms );
+
+  Sntp_Server_Index = (Sntp_Server_Index + 1) % Sntp_Num_Servers;
+  Sntp_Interval_ms  = Sntp_Retry_ms;
+  Sntp_Retry_ms     = ( Sntp_Retry_ms*2 < SNTP_RETRY_MAX_MS ) ? (Sntp_Retry_ms*2) : SNTP_RETRY_MAX_MS;
+}
+
+/*===========================================================================*/
+
+/*!
+Add a server, tried in the order added. The string must stay valid.
+
+@param  pServer   Host name or IP, (I)
+@return TRUE if added
+*/
+BOOL
+Sntp_Add_Server( const CHAR *pServer )
+{
+  if ( Sntp_Num_Servers >= SNTP_SERVER_MAX )
+  {
+    LOG( DBG_E, "SNTP: Server list is full, %s dropped.\n", pServer );
+    return FALSE;
+  }
+
+  Sntp_Servers[Sntp_Num_Servers++] = pServer;
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Start syncing, the first poll is sent on the next Sntp_Handle() */
+void
+Sntp_Start( void )
+{
+  if ( Sntp_Started || (Sntp_Num_Servers == 0) )
+  {
+    return;
+  }
+
+  Sntp_Udp.begin( SNTP_LOCAL_PORT );
+  Sntp_Started = TRUE;
+  Sntp_Request_Sync();
+}
+
+/*===========================================================================*/
+
+/* Poll as soon as possible */
+void
+Sntp_Request_Sync( void )
+{
+  Sntp_Interval_ms  = 0;
+  Sntp_Last_Poll_ms = millis();
+}
+
+/*===========================================================================*/
+
+/* Drive the client, to call at each sketch loop() */
+void
+Sntp_Handle( void )
+{
+  if ( !Sntp_Started )
+  {
+    return;
+  }
+
+  switch ( Sntp_State )
+  {
+    case SNTP_STATE_IDLE:
+      if ( !Wifi_Is_Connected() || ((millis() - Sntp_Last_Poll_ms) < Sntp_Interval_ms) )
+      {
+        break;
+      }
+
+      Sntp_Burst_Count = 0;
+      Sntp_Best_Valid  = FALSE;
+      Sntp_Resolve();
+      break;
+
+    case SNTP_STATE_RESOLVING:
+      if ( Sntp_Dns_Done )
+      {
+        Sntp_Server_IP = IPAddress( Sntp_Dns_Addr );
+        Sntp_Send();
+      }
+      else if ( Sntp_Dns_Failed || ((millis() - Sntp_State_Start_ms) > SNTP_DNS_TIMEOUT_MS) )
+      {
+        LOG( DBG_W, "SNTP: DNS lookup of %s failed.\n", Sntp_Servers[Sntp_Server_Index] );
+        Sntp_Dns_Seq++;
+        Sntp_Finish_Poll();
+      }
+      break;
+
+    case SNTP_STATE_WAIT_REPLY:
+      Sntp_Receive();
+      if ( (Sntp_State == SNTP_STATE_WAIT_REPLY) &&
+           ((millis() - Sntp_State_Start_ms) > SNTP_REPLY_TIMEOUT_MS) )
+      {
+        LOG( DBG_I, "SNTP: No reply from %s.\n", Sntp_Servers[Sntp_Server_Index] );
+        Sntp_Next_Request();
+      }
+      break;
+
+    case SNTP_STATE_BURST_WAIT:
+      if ( (millis() - Sntp_State_Start_ms) >= SNTP_BURST_SPACING_MS )
+      {
+        Sntp_Send();
+      }
+      break;
+
+    default:
+      Sntp_Set_State( SNTP_STATE_IDLE );
+      break;
+  }
+}
+
+/*===========================================================================*/
+
+/* RTT of the sample used by the last sync */
+UINT32
+Sntp_Get_Last_Rtt_us( void )
+{
+  return Sntp_Last_Rtt_us;
+}
+
+/*===========================================================================*/
+
+/* Offset of the sample used by the last sync, positive if the clock was behind */
+INT64
+Sntp_Get_Last_Offset_us( void )
+{
+  return Sntp_Last_Offset_us;
+}
+
+/*===========================================================================*/
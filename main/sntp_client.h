@@ -0,0 +1,89 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sntp_client.h
+@brief  Non-blocking SNTP client definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __SNTP_CLIENT_H__
+#define __SNTP_CLIENT_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define SNTP_SERVER_MAX           4
+#define SNTP_PORT                 123
+#define SNTP_LOCAL_PORT           4123
+#define SNTP_PACKET_SIZE          48
+
+/* Give up a DNS lookup or a request after these */
+#define SNTP_DNS_TIMEOUT_MS       3000
+#define SNTP_REPLY_TIMEOUT_MS     1000
+
+/* Each poll sends a burst of requests and keeps the one with the lowest RTT,
+   replies slower than SNTP_MAX_RTT_MS are dropped */
+#define SNTP_BURST_SIZE           4
+#define SNTP_BURST_SPACING_MS     250
+#define SNTP_MAX_RTT_MS           500
+
+/* Poll interval once synced, and the retry backoff when a poll fails */
+#define SNTP_POLL_INTERVAL_MS     (30*60*1000UL)
+#define SNTP_RETRY_MIN_MS         2000
+#define SNTP_RETRY_MAX_MS         64000
+
+/* SNTP client states */
+typedef enum
+{
+  SNTP_STATE_IDLE = 0,
+  SNTP_STATE_RESOLVING,         /* DNS lookup of the current server */
+  SNTP_STATE_WAIT_REPLY,        /* Request sent, waiting for the reply */
+  SNTP_STATE_BURST_WAIT,        /* Spacing between requests of a burst */
+
+} SNTP_STATE;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern BOOL
+Sntp_Add_Server( const CHAR *pServer );
+
+extern void
+Sntp_Start( void );
+
+extern void
+Sntp_Handle( void );
+
+extern void
+Sntp_Request_Sync( void );
+
+extern UINT32
+Sntp_Get_Last_Rtt_us( void );
+
+extern INT64
+Sntp_Get_Last_Offset_us( void );
+
+#endif  /* __SNTP_CLIENT_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,264 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sonar_sampler.cpp
+@brief  Sonar sampling on a hardware timer
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The sonar used to be pinged from loop() "every 1 sec", which really was
+whenever loop() got there. A blocking HTTP handler, a Wi-Fi scan or a
+publish stretched the interval, and pulseIn() blocked loop() in turn.
+
+Now timer1 sends the pings at a fixed rate and the echo is timed by the
+edge interrupts of GPIO_ECHO, nothing waits:
+
+  timer1      Sonar_Sampler_Tick()   Ends a ping without echo, sends the next
+  GPIO_ECHO   Sonar_Sampler_Echo()   Rising edge starts, falling edge ends it
+
+Finished samples go into a SAMPLE_QUEUE_RECORD, Sonar_Sampler_Get() takes
+them out in loop(). Both interrupts are on the same level and never nest,
+so together they are the one producer of the queue.
+
+The samples keep their trigger time, so the interval jitter, the time a
+sample waited for loop() and the samples dropped are in the metrics.
+
+timer1 is taken, analogWrite() and Servo can't use it any more.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sonar_sampler.h"
+#include "sample_queue.h"
+#include "metrics.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* timer1 runs from the 80 MHz APB clock, divided by 256 */
+#define SONAR_TIMER_TICKS_PER_S   312500
+
+/* Where the current ping is */
+typedef enum
+{
+  SONAR_STATE_IDLE = 0,       /* Echo ended, sample queued */
+  SONAR_STATE_WAIT_ECHO,      /* Triggered, echo not started */
+  SONAR_STATE_ECHO,           /* Echo high */
+
+} SONAR_STATE;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static SAMPLE_QUEUE_RECORD  Sonar_Queue;
+
+/* Interrupt side */
+static volatile UINT8     Sonar_State         = SONAR_STATE_IDLE;
+static volatile uint32_t  Sonar_Seq           = 0;
+static volatile uint32_t  Sonar_Trigger_us    = 0;
+static volatile uint32_t  Sonar_Echo_Start_us = 0;
+static uint32_t           Sonar_Trigger_Cycles = 0;
+
+/* loop() side */
+static BOOL       Sonar_Running       = FALSE;
+static UINT32     Sonar_Period_us     = 0;
+static BOOL       Sonar_Have_Last     = FALSE;
+static uint32_t   Sonar_Last_Seq      = 0;
+static uint32_t   Sonar_Last_Trigger_us = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void IRAM_ATTR Sonar_Sampler_Tick( void );
+static void IRAM_ATTR Sonar_Sampler_Echo( void );
+static void           Sonar_Sampler_Account( const SAMPLE_RECORD *pSample );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* timer1 interrupt, end the last ping and send the next */
+static void IRAM_ATTR
+Sonar_Sampler_Tick( void )
+{
+  SAMPLE_RECORD Sample;
+  uint32_t      Start;
+
+  /* No echo in a whole period, nothing in range */
+  if ( Sonar_State != SONAR_STATE_IDLE )
+  {
+    Sample.seq        = Sonar_Seq;
+    Sample.trigger_us = Sonar_Trigger_us;
+    Sample.echo_us    = 0;
+    Sample_Queue_Push( &Sonar_Queue, &Sample );
+  }
+
+  /* Busy wait on the cycle counter, delayMicroseconds() is not in IRAM */
+  digitalWrite( GPIO_TRIG, HIGH );
+  Start = ESP.getCycleCount();
+  while ( (ESP.getCycleCount() - Start) < Sonar_Trigger_Cycles )
+  {
+  }
+  digitalWrite( GPIO_TRIG, LOW );
+
+  Sonar_Seq         = Sonar_Seq + 1;
+  Sonar_Trigger_us  = micros();
+  Sonar_State       = SONAR_STATE_WAIT_ECHO;
+}
+
+/*===========================================================================*/
+
+/* GPIO_ECHO edge interrupt, time the echo pulse */
+static void IRAM_ATTR
+Sonar_Sampler_Echo( void )
+{
+  SAMPLE_RECORD Sample;
+  uint32_t      Now_us = micros();
+
+  if ( digitalRead( GPIO_ECHO ) == HIGH )
+  {
+    if ( Sonar_State == SONAR_STATE_WAIT_ECHO )
+    {
+      Sonar_Echo_Start_us = Now_us;
+      Sonar_State         = SONAR_STATE_ECHO;
+    }
+    return;
+  }
+
+  /* A falling edge of a ping that already timed out is ignored */
+  if ( Sonar_State != SONAR_STATE_ECHO )
+  {
+    return;
+  }
+
+  Sample.seq        = Sonar_Seq;
+  Sample.trigger_us = Sonar_Trigger_us;
+  Sample.echo_us    = Now_us - Sonar_Echo_Start_us;
+  Sample_Queue_Push( &Sonar_Queue, &Sample );
+
+  Sonar_State = SONAR_STATE_IDLE;
+}
+
+/*===========================================================================*/
+
+/* Interval jitter and queue wait of a sample taken out */
+static void
+Sonar_Sampler_Account( const SAMPLE_RECORD *pSample )
+{
+  UINT32  Interval_us;
+  UINT32  Jitter_us;
+
+  Metric_Inc( METRIC_SONAR_SAMPLES );
+  Metric_Set( METRIC_SONAR_QUEUE_DROPS, Sonar_Queue.drops );
+  Metric_Max( METRIC_SONAR_WAIT_MAX_MS, (micros() - pSample->trigger_us) / 1000 );
+
+  /* Only between consecutive pings, a dropped one makes the gap longer */
+  if ( Sonar_Have_Last && (pSample->seq == (Sonar_Last_Seq + 1)) )
+  {
+    Interval_us = pSample->trigger_us - Sonar_Last_Trigger_us;
+    Jitter_us   = ( Interval_us > Sonar_Period_us ) ? (Interval_us - Sonar_Period_us) : (Sonar_Period_us - Interval_us);
+
+    Metric_Set( METRIC_SONAR_JITTER_US, Jitter_us );
+    Metric_Max( METRIC_SONAR_JITTER_MAX_US, Jitter_us );
+  }
+
+  Sonar_Have_Last       = TRUE;
+  Sonar_Last_Seq        = pSample->seq;
+  Sonar_Last_Trigger_us = pSample->trigger_us;
+}
+
+/*===========================================================================*/
+
+/*!
+Start pinging at a fixed rate, SR04_Initialise() first.
+
+@param  Rate_Hz   Pings per second, 1 to SONAR_SAMPLE_HZ_MAX, (I)
+@return None
+*/
+void
+Sonar_Sampler_Start( UINT8 Rate_Hz )
+{
+  if ( Sonar_Running )
+  {
+    Sonar_Sampler_Stop();
+  }
+
+  Rate_Hz = ( Rate_Hz < 1 ) ? 1 : Rate_Hz;
+  Rate_Hz = ( Rate_Hz > SONAR_SAMPLE_HZ_MAX ) ? SONAR_SAMPLE_HZ_MAX : Rate_Hz;
+
+  Sample_Queue_Init( &Sonar_Queue );
+  Sonar_State           = SONAR_STATE_IDLE;
+  Sonar_Have_Last       = FALSE;
+  Sonar_Period_us       = 1000000 / Rate_Hz;
+  Sonar_Trigger_Cycles  = (uint32_t)ESP.getCpuFreqMHz() * SONAR_TRIGGER_US;
+
+  attachInterrupt( digitalPinToInterrupt( GPIO_ECHO ), Sonar_Sampler_Echo, CHANGE );
+
+  timer1_attachInterrupt( Sonar_Sampler_Tick );
+  timer1_enable( TIM_DIV256, TIM_EDGE, TIM_LOOP );
+  timer1_write( SONAR_TIMER_TICKS_PER_S / Rate_Hz );
+
+  Sonar_Running = TRUE;
+
+  LOG( DBG_N, "Sonar: Sampling at %d Hz.\n", Rate_Hz );
+}
+
+/*===========================================================================*/
+
+void
+Sonar_Sampler_Stop( void )
+{
+  timer1_disable();
+  timer1_detachInterrupt();
+  detachInterrupt( digitalPinToInterrupt( GPIO_ECHO ) );
+
+  Sonar_Running = FALSE;
+}
+
+/*===========================================================================*/
+
+/*!
+Take the oldest sample out, to call from loop() until it returns FALSE.
+
+@param  pDistance_cm  Distance, 0 if not valid as from SR04_Get_Distance(), (O)
+@return FALSE if there is no sample
+*/
+BOOL
+Sonar_Sampler_Get( FLOAT *pDistance_cm )
+{
+  SAMPLE_RECORD Sample;
+
+  if ( !Sample_Queue_Pop( &Sonar_Queue, &Sample ) )
+  {
+    return FALSE;
+  }
+
+  Sonar_Sampler_Account( &Sample );
+  *pDistance_cm = SR04_Echo_To_Distance( Sample.echo_us );
+
+  LOG( DBG_I, "Sonar: Sample %lu, distance %.2f cm\n", (UINT32)Sample.seq, *pDistance_cm );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
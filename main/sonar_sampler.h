@@ -0,0 +1,63 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sonar_sampler.h
+@brief  Sonar sampling on a hardware timer, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __SONAR_SAMPLER_H__
+#define __SONAR_SAMPLER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Pings per second, e.g. 10 for a tank that fills fast. The filter window
+   is in samples, so a higher rate also makes it shorter in time */
+#ifndef SONAR_SAMPLE_HZ
+#define SONAR_SAMPLE_HZ       1
+#endif
+
+/* An echo takes up to 38 ms when nothing is in range, the ping after it
+   must not start before */
+#define SONAR_SAMPLE_HZ_MAX   20
+
+/* Width of the trigger pulse, the HC-SR04 wants 10 us or more */
+#define SONAR_TRIGGER_US      10
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Sonar_Sampler_Start( UINT8 Rate_Hz );
+
+extern void
+Sonar_Sampler_Stop( void );
+
+extern BOOL
+Sonar_Sampler_Get( FLOAT *pDistance_cm );
+
+#endif  /* __SONAR_SAMPLER_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,110 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   token_bucket.h
+@brief  Token bucket, admits a burst and then a steady rate
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The bucket holds time instead of tokens. It fills at one millisecond per
+millisecond up to Burst intervals, a request takes one interval out:
+
+  Token_Bucket_Init( &Bucket, 1000, 5 );     5 at once, then 1 per second
+  if ( !Token_Bucket_Take( &Bucket, millis(), &Retry_ms ) )
+  {
+    ...  reject, a token is back in Retry_ms
+  }
+
+So a rate below one per second needs no fractions, and the time until the
+next token falls out of the same numbers.
+
+All inline and without Arduino calls, so tools/admission_check builds it on
+the host.
+*/
+
+#ifndef __TOKEN_BUCKET_H__
+#define __TOKEN_BUCKET_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+typedef struct
+{
+  uint32_t  interval_ms;    /* One token per interval */
+  uint32_t  capacity_ms;    /* Burst intervals */
+  uint32_t  level_ms;       /* Saved up so far */
+  uint32_t  last_ms;        /* When it was last filled */
+  BOOL      started;        /* last_ms is set */
+
+} TOKEN_BUCKET_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+/* A full bucket */
+static inline void
+Token_Bucket_Init( TOKEN_BUCKET_RECORD *pBucket, uint32_t Interval_ms, uint8_t Burst )
+{
+  pBucket->interval_ms  = Interval_ms;
+  pBucket->capacity_ms  = Interval_ms * Burst;
+  pBucket->level_ms     = pBucket->capacity_ms;
+  pBucket->last_ms      = 0;
+  pBucket->started      = FALSE;
+}
+
+/*===========================================================================*/
+
+/* Take a token, FALSE and the wait until the next one if there is none */
+static inline BOOL
+Token_Bucket_Take( TOKEN_BUCKET_RECORD *pBucket, uint32_t Now_ms, uint32_t *pRetry_ms )
+{
+  uint32_t  Elapsed_ms = pBucket->started ? (Now_ms - pBucket->last_ms) : 0;
+
+  /* Fill, without overflowing after a long quiet time */
+  if ( Elapsed_ms >= (pBucket->capacity_ms - pBucket->level_ms) )
+  {
+    pBucket->level_ms = pBucket->capacity_ms;
+  }
+  else
+  {
+    pBucket->level_ms += Elapsed_ms;
+  }
+  pBucket->last_ms = Now_ms;
+  pBucket->started = TRUE;
+
+  if ( pBucket->level_ms < pBucket->interval_ms )
+  {
+    *pRetry_ms = pBucket->interval_ms - pBucket->level_ms;
+    return FALSE;
+  }
+
+  pBucket->level_ms -= pBucket->interval_ms;
+  *pRetry_ms = 0;
+
+  return TRUE;
+}
+
+#endif  /* __TOKEN_BUCKET_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,189 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   trace.cpp
+@brief  Record sonar samples, commands and relay changes
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+When recording, every input of the relay logic and every relay change is
+written as one line to Serial and to TRACE_DATA_TOPIC:
+
+  S,<ms>,<raw_cm>,<minute_of_day>   Raw sonar sample, minute is -1 without time
+  C,<ms>,<topic>,<message>          Command, as received on MQTT
+  R,<ms>,<0|1>                      Relay changed, Trace_Relay() can be
+                                    called each loop, only changes are written
+
+Recording starts with the current config as C lines and the relay as an
+R line, so a trace replays on its own. See tools/trace_replay.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "trace.h"
+#include "mqtt_client.h"
+#include "fixed_format.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static BOOL   Trace_Active = FALSE;
+
+/* The relay status last written */
+static BOOL   Trace_Relay_Status = FALSE;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Trace_Output( const CHAR *pLine );
+static void   Trace_Timing( const CHAR *pEnable_Topic, const CHAR *pTime_Topic, const RELAY_TIMING_RECORD *pTiming );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Trace_Output( const CHAR *pLine )
+{
+  Serial.println( pLine );
+  if ( mqtt_is_connected() )
+  {
+    mqtt_publish( PSTR(TRACE_DATA_TOPIC), pLine );
+  }
+}
+
+/*===========================================================================*/
+
+/* The timing config as commands */
+static void
+Trace_Timing( const CHAR *pEnable_Topic, const CHAR *pTime_Topic, const RELAY_TIMING_RECORD *pTiming )
+{
+  CHAR  Message[16];
+
+  Trace_Command( pEnable_Topic, pTiming->valid ? "true" : "false" );
+
+  /* Nudge it into the minute, the command takes hours and truncates */
+  Fixed_Format( Message, sizeof(Message), pTiming->hh + (pTiming->mm + 0.5f)/60, 4 );
+  Trace_Command( pTime_Topic, Message );
+}
+
+/*===========================================================================*/
+
+/* Start recording, with the current config and relay */
+void
+Trace_Start( void )
+{
+  CHAR  Message[16];
+
+  Trace_Active = TRUE;
+
+  Trace_Command( "auto_control_relay", My_Config.relay_auto ? "true" : "false" );
+
+  Fixed_Format( Message, sizeof(Message), My_Config.high_distance_cm, 2 );
+  Trace_Command( "high_distance", Message );
+  Fixed_Format( Message, sizeof(Message), My_Config.low_distance_cm, 2 );
+  Trace_Command( "low_distance", Message );
+
+  Trace_Timing( "relay_timing_on_enable",  "relay_timing_on_time",  &My_Config.relay_on_timing );
+  Trace_Timing( "relay_timing_off_enable", "relay_timing_off_time", &My_Config.relay_off_timing );
+
+  Trace_Relay_Status = !My_Status.relay_status;
+  Trace_Relay( My_Status.relay_status );
+
+  LOG( DBG_N, "Trace: Recording started.\n" );
+}
+
+/*===========================================================================*/
+
+void
+Trace_Stop( void )
+{
+  Trace_Active = FALSE;
+  LOG( DBG_N, "Trace: Recording stopped.\n" );
+}
+
+/*===========================================================================*/
+
+BOOL
+Trace_Is_Active( void )
+{
+  return Trace_Active;
+}
+
+/*===========================================================================*/
+
+/* A raw sonar sample, as it goes into the filter */
+void
+Trace_Sample( FLOAT Raw_Distance_cm, INT16 Minute_Of_Day )
+{
+  CHAR  Line[TRACE_LINE_MAX_SIZE];
+  CHAR  Distance[FIXED_FORMAT_MAX_SIZE];
+
+  if ( !Trace_Active )
+  {
+    return;
+  }
+
+  Fixed_Format( Distance, sizeof(Distance), Raw_Distance_cm, 2 );
+  snprintf_P( Line, sizeof(Line), PSTR("S,%lu,%s,%d"), millis(), Distance, Minute_Of_Day );
+  Trace_Output( Line );
+}
+
+/*===========================================================================*/
+
+void
+Trace_Command( const CHAR *pTopic, const CHAR *pMessage )
+{
+  CHAR  Line[TRACE_LINE_MAX_SIZE];
+
+  if ( !Trace_Active )
+  {
+    return;
+  }
+
+  snprintf_P( Line, sizeof(Line), PSTR("C,%lu,%s,%s"), millis(), pTopic, pMessage );
+  Trace_Output( Line );
+}
+
+/*===========================================================================*/
+
+/* The relay status, only written when changed */
+void
+Trace_Relay( BOOL Relay_Status )
+{
+  CHAR  Line[TRACE_LINE_MAX_SIZE];
+
+  if ( !Trace_Active || (Relay_Status == Trace_Relay_Status) )
+  {
+    return;
+  }
+  Trace_Relay_Status = Relay_Status;
+
+  snprintf_P( Line, sizeof(Line), PSTR("R,%lu,%d"), millis(), Relay_Status ? 1 : 0 );
+  Trace_Output( Line );
+}
+
+/*===========================================================================*/
@@ -0,0 +1,65 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   trace.h
+@brief  Record sonar samples, commands and relay changes, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* MQTT topics, publish "on"/"off" to start/stop, the lines come back on data */
+#define TRACE_CMD_TOPIC       "trace"
+#define TRACE_DATA_TOPIC      "trace_data"
+
+#define TRACE_LINE_MAX_SIZE   96
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Trace_Start( void );
+
+extern void
+Trace_Stop( void );
+
+extern BOOL
+Trace_Is_Active( void );
+
+extern void
+Trace_Sample( FLOAT Raw_Distance_cm, INT16 Minute_Of_Day );
+
+extern void
+Trace_Command( const CHAR *pTopic, const CHAR *pMessage );
+
+extern void
+Trace_Relay( BOOL Relay_Status );
+
+#endif  /* __TRACE_H__ */
+
+/*===========================================================================*/
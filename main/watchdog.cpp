@@ -0,0 +1,508 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   watchdog.cpp
+@brief  Software watchdog of the loop() tasks
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+loop() tells which task it is in, Watchdog_Begin() before the sampling,
+the publishes, the HTTP and MQTT clients, NTP and Wifi, Watchdog_End()
+after. All between them is the LOOP task. Each task has a deadline, a
+task that legitimately runs longer, a firmware upload in the HTTP task,
+keeps it off with Watchdog_Heartbeat() as it makes progress.
+
+timer0 looks at the running task every WATCHDOG_TICK_MS, from its
+interrupt, so a task stuck in a blocking wait is caught while it waits.
+Once over its deadline the task, and how long it has run so far, go into
+RTC user memory, which keeps them across a reset. It is written straight
+from the interrupt and again on each tick the task stays stuck, so the
+record is there even if it never returns and the SDK watchdog resets.
+
+The reset itself is done by Watchdog_Check(), a recurrent scheduled
+function, when the task gives the CPU back through yield() or delay() or
+after loop(). It only resets if wdt_enable is set, on the control page or
+over MQTT, else the stalls are only counted.
+
+The stall counts per task are since power on, they are in the metrics and
+in the WATCHDOG_STATE_TOPIC report published after a boot that follows a
+stall, with the task, how long it ran and what reset it:
+
+  {"task":"mqtt","ran_ms":12040,"reset":"watchdog","stalls":{"loop":0,...}}
+
+timer0 is taken, Servo can't use it any more. Another user of a periodic
+interrupt, the profiler, gets called on each tick through
+Watchdog_Set_Tick_Func(), timer0 then ticks faster and the task is still
+looked at every WATCHDOG_TICK_MS.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <Schedule.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "watchdog.h"
+#include "mqtt_client.h"
+#include "metrics.h"
+#include "flash_string.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define WATCHDOG_RTC_MAGIC      0x57444F47    /* 'WDOG' */
+
+/* Block 0 of the RTC user memory, block N is at + 4 N. Below it, from
+   0x60001100, is the system RTC memory of the SDK */
+#define RTC_USER_MEMORY_ADDR    0x60001200
+
+/* A word of the RTC memory, the host build maps the addresses itself */
+#if defined(__XTENSA__)
+#define RTC_MEMORY_WORD( Addr ) ( *(volatile uint32_t *)(Addr) )
+#endif
+
+#define WATCHDOG_REPORT_MAX_SIZE  192
+
+/* Where the stalls are kept across a reset, all words for the RTC memory */
+typedef struct
+{
+  UINT32  magic;
+
+  /* Deadlines missed per task, since power on */
+  UINT32  stalls[NUM_WATCHDOG_TASKS];
+
+  /* Resets by the watchdog, since power on */
+  UINT32  resets;
+
+  /* The last stall */
+  UINT32  last_task;
+  UINT32  last_ran_ms;
+  UINT32  last_reset;             /* TRUE if the watchdog reset for it */
+  UINT32  last_new;               /* TRUE until the boot after it */
+
+  /* ~ the sum of all above */
+  UINT32  check;
+
+} WATCHDOG_RTC_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/* Longest each task may go without a heartbeat, in RAM for the interrupt.
+   MQTT connects in two steps of up to MQTT_CONNECT_TIMEOUT_MS each */
+static const UINT16 Watchdog_Deadline_ms[NUM_WATCHDOG_TASKS] =
+{
+  5000,       /* LOOP */
+  1000,       /* SAMPLING */
+  5000,       /* PUBLISH */
+  10000,      /* HTTP */
+  15000,      /* MQTT */
+  2000,       /* NTP */
+  5000,       /* WIFI */
+};
+
+static const CHAR Watchdog_Task_Names[][12] PROGMEM =
+{
+  "loop", "sampling", "publish", "http", "mqtt", "ntp", "wifi"
+};
+
+static WATCHDOG_RTC_RECORD  Watchdog_Rtc;
+
+/* loop() side, the interrupt reads them */
+static volatile UINT8     Watchdog_Task      = WATCHDOG_TASK_LOOP;
+static volatile uint32_t  Watchdog_Start_us  = 0;
+static volatile uint32_t  Watchdog_Beat_us   = 0;
+
+/* Interrupt side */
+static volatile BOOL      Watchdog_Stalled       = FALSE;
+static volatile BOOL      Watchdog_Reset_Pending = FALSE;
+static uint32_t           Watchdog_Tick_Cycles   = 0;
+static UINT16             Watchdog_Ticks_Per_Check = 1;
+static UINT16             Watchdog_Ticks_Left    = 1;
+static WATCHDOG_TICK_FUNC Watchdog_Tick_Func     = NULL;
+
+/* The report of the stall before this boot */
+static BOOL     Watchdog_Report_Pending = FALSE;
+static PGM_P    Watchdog_Report_Reset   = NULL;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void IRAM_ATTR Watchdog_Rtc_Store( void );
+static void IRAM_ATTR Watchdog_Tick( void );
+static bool           Watchdog_Check( void );
+static void           Watchdog_Metrics( void );
+static UINT16         Watchdog_Format_Report( CHAR *pBuff, UINT16 Size );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Seal Watchdog_Rtc and write it to the RTC memory, word by word */
+static void IRAM_ATTR
+Watchdog_Rtc_Store( void )
+{
+  UINT32  *pWord = (UINT32 *)&Watchdog_Rtc;
+  UINT32  Sum    = 0;
+  UINT8   Index;
+
+  for ( Index = 0; Index < (sizeof(Watchdog_Rtc) / sizeof(UINT32)) - 1; Index++ )
+  {
+    Sum += pWord[Index];
+  }
+  Watchdog_Rtc.check = ~Sum;
+
+  /* Where ESP.rtcUserMemoryRead() of Watchdog_Initialise() reads it */
+  for ( Index = 0; Index < (sizeof(Watchdog_Rtc) / sizeof(UINT32)); Index++ )
+  {
+    RTC_MEMORY_WORD( RTC_USER_MEMORY_ADDR + (RTC_WATCHDOG_OFFSET + Index) * 4 ) = pWord[Index];
+  }
+}
+
+/*===========================================================================*/
+
+/* timer0 interrupt, is the running task over its deadline */
+static void IRAM_ATTR
+Watchdog_Tick( void )
+{
+  uint32_t  Now_us = micros();
+  UINT8     Task   = Watchdog_Task;
+
+  timer0_write( ESP.getCycleCount() + Watchdog_Tick_Cycles );
+
+  if ( Watchdog_Tick_Func != NULL )
+  {
+    Watchdog_Tick_Func();
+  }
+
+  if ( --Watchdog_Ticks_Left != 0 )
+  {
+    return;
+  }
+  Watchdog_Ticks_Left = Watchdog_Ticks_Per_Check;
+
+  if ( (Now_us - Watchdog_Beat_us) <= ((uint32_t)Watchdog_Deadline_ms[Task] * 1000) )
+  {
+    return;
+  }
+
+  if ( !Watchdog_Stalled )
+  {
+    Watchdog_Stalled          = TRUE;
+    Watchdog_Reset_Pending    = TRUE;
+    Watchdog_Rtc.stalls[Task]++;
+    Watchdog_Rtc.last_task    = Task;
+    Watchdog_Rtc.last_reset   = FALSE;
+    Watchdog_Rtc.last_new     = TRUE;
+  }
+
+  /* Still running, keep how long so far */
+  Watchdog_Rtc.last_ran_ms = (Now_us - Watchdog_Start_us) / 1000;
+  Watchdog_Rtc_Store();
+}
+
+/*===========================================================================*/
+
+/* Recurrent scheduled function, reset for a stall if enabled */
+static bool
+Watchdog_Check( void )
+{
+  if ( !Watchdog_Reset_Pending )
+  {
+    return true;
+  }
+  Watchdog_Reset_Pending = FALSE;
+
+  Watchdog_Metrics();
+
+  LOG( DBG_E, "Watchdog: Task %S over its deadline, ran %lu ms.\n",
+       (PGM_P)Watchdog_Task_Name( (WATCHDOG_TASK)Watchdog_Rtc.last_task ), Watchdog_Rtc.last_ran_ms );
+
+  if ( !My_Config.wdt_enable )
+  {
+    return true;
+  }
+
+  noInterrupts();
+  Watchdog_Rtc.resets++;
+  Watchdog_Rtc.last_reset = TRUE;
+  Watchdog_Rtc_Store();
+  interrupts();
+
+  LOG( DBG_P, "Watchdog: Resetting.\n" );
+  ESP.restart();
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* The counts of Watchdog_Rtc into the metrics */
+static void
+Watchdog_Metrics( void )
+{
+  UINT8   Task;
+
+  for ( Task = 0; Task < NUM_WATCHDOG_TASKS; Task++ )
+  {
+    Metric_Set( (METRIC_ID)(METRIC_WATCHDOG_STALLS_LOOP + Task), Watchdog_Rtc.stalls[Task] );
+  }
+  Metric_Set( METRIC_WATCHDOG_RESETS, Watchdog_Rtc.resets );
+}
+
+/*===========================================================================*/
+
+/* The stall before this boot and the counts as JSON */
+static UINT16
+Watchdog_Format_Report( CHAR *pBuff, UINT16 Size )
+{
+  UINT8   Task;
+  INT32   Len = 0;
+
+  Len += snprintf_P( pBuff + Len, Size - Len, PSTR("{\"task\":\"%S\",\"ran_ms\":%lu,\"reset\":\"%S\",\"stalls\":{"),
+                     (PGM_P)Watchdog_Task_Name( (WATCHDOG_TASK)Watchdog_Rtc.last_task ),
+                     Watchdog_Rtc.last_ran_ms, Watchdog_Report_Reset );
+
+  for ( Task = 0; (Task < NUM_WATCHDOG_TASKS) && (Len < Size); Task++ )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("%s\"%S\":%lu"),
+                       (Task == 0)?"":",", Watchdog_Task_Names[Task], Watchdog_Rtc.stalls[Task] );
+  }
+
+  if ( Len < Size )
+  {
+    Len += snprintf_P( pBuff + Len, Size - Len, PSTR("}}") );
+  }
+
+  return ( Len < Size ) ? Len : (Size - 1);
+}
+
+/*===========================================================================*/
+
+/*!
+Take over the stalls kept in the RTC memory and start watching, at the end
+of setup(), before that nothing is watched.
+
+@return None
+*/
+void
+Watchdog_Initialise( void )
+{
+  UINT32  Reason = ESP.getResetInfoPtr()->reason;
+  UINT32  *pWord = (UINT32 *)&Watchdog_Rtc;
+  UINT32  Sum    = 0;
+  UINT8   Index;
+
+  ESP.rtcUserMemoryRead( RTC_WATCHDOG_OFFSET, (uint32_t *)&Watchdog_Rtc, sizeof(Watchdog_Rtc) );
+  for ( Index = 0; Index < (sizeof(Watchdog_Rtc) / sizeof(UINT32)) - 1; Index++ )
+  {
+    Sum += pWord[Index];
+  }
+
+  /* Whatever is there after a power on is noise */
+  if ( (Reason == REASON_DEFAULT_RST) || (Watchdog_Rtc.magic != WATCHDOG_RTC_MAGIC) ||
+       (Watchdog_Rtc.check != ~Sum) || (Watchdog_Rtc.last_task >= NUM_WATCHDOG_TASKS) )
+  {
+    memset( &Watchdog_Rtc, 0, sizeof(Watchdog_Rtc) );
+    Watchdog_Rtc.magic = WATCHDOG_RTC_MAGIC;
+  }
+
+  if ( Watchdog_Rtc.last_new )
+  {
+    /* The SDK watchdog got there first if the task never gave the CPU back */
+    if ( Watchdog_Rtc.last_reset )
+    {
+      Watchdog_Report_Reset = PSTR("watchdog");
+    }
+    else if ( (Reason == REASON_WDT_RST) || (Reason == REASON_SOFT_WDT_RST) )
+    {
+      Watchdog_Report_Reset = PSTR("sdk_wdt");
+    }
+    else
+    {
+      Watchdog_Report_Reset = PSTR("none");
+    }
+    Watchdog_Report_Pending = TRUE;
+    Watchdog_Rtc.last_new   = FALSE;
+
+    LOG( DBG_P, "Watchdog: Task %S ran %lu ms before this boot, reset by %S.\n",
+         (PGM_P)Watchdog_Task_Name( (WATCHDOG_TASK)Watchdog_Rtc.last_task ),
+         Watchdog_Rtc.last_ran_ms, Watchdog_Report_Reset );
+  }
+  Watchdog_Rtc_Store();
+  Watchdog_Metrics();
+
+  Watchdog_Begin( WATCHDOG_TASK_LOOP );
+
+  Watchdog_Tick_Cycles = (uint32_t)ESP.getCpuFreqMHz() * 1000 * WATCHDOG_TICK_MS;
+  Watchdog_Ticks_Per_Check = 1;
+  Watchdog_Ticks_Left      = 1;
+  noInterrupts();
+  timer0_isr_init();
+  timer0_attachInterrupt( Watchdog_Tick );
+  timer0_write( ESP.getCycleCount() + Watchdog_Tick_Cycles );
+  interrupts();
+
+  schedule_recurrent_function_us( Watchdog_Check, WATCHDOG_TICK_MS * 1000 );
+
+  LOG( DBG_N, "Watchdog: Watching, reset %s.\n", My_Config.wdt_enable ? "on" : "off" );
+}
+
+/*===========================================================================*/
+
+/* A new pass of loop(), to call first in it */
+void
+Watchdog_Handle( void )
+{
+  CHAR    Report[WATCHDOG_REPORT_MAX_SIZE];
+
+  Watchdog_Begin( WATCHDOG_TASK_LOOP );
+
+  if ( Watchdog_Report_Pending && mqtt_is_connected() )
+  {
+    Watchdog_Format_Report( Report, sizeof(Report) );
+    if ( mqtt_publish( PSTR(WATCHDOG_STATE_TOPIC), Report ) )
+    {
+      Watchdog_Report_Pending = FALSE;
+      LOG( DBG_N, "Watchdog: Report %s\n", Report );
+    }
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+The task loop() goes into, its deadline starts now.
+
+@param  Task    The task, (I)
+@return None
+*/
+void
+Watchdog_Begin( WATCHDOG_TASK Task )
+{
+  uint32_t  Now_us = micros();
+
+  noInterrupts();
+  Watchdog_Task     = Task;
+  Watchdog_Start_us = Now_us;
+  Watchdog_Beat_us  = Now_us;
+  Watchdog_Stalled  = FALSE;
+  interrupts();
+}
+
+/*===========================================================================*/
+
+/* Back from the task, the rest of loop() is the LOOP task */
+void
+Watchdog_End( void )
+{
+  Watchdog_Begin( WATCHDOG_TASK_LOOP );
+}
+
+/*===========================================================================*/
+
+/* The running task is making progress, its deadline starts again */
+void
+Watchdog_Heartbeat( void )
+{
+  Watchdog_Beat_us = micros();
+}
+
+/*===========================================================================*/
+
+/*!
+Have a function called on each tick of timer0, from its interrupt.
+
+@param  pFunc     IRAM_ATTR function, NULL for none, (I)
+@param  Rate_Hz   Ticks per second, 1000 / WATCHDOG_TICK_MS up to
+                  WATCHDOG_TICK_HZ_MAX, rounded to a multiple of it, (I)
+@return The rate it ticks at
+*/
+UINT16
+Watchdog_Set_Tick_Func( WATCHDOG_TICK_FUNC pFunc, UINT16 Rate_Hz )
+{
+  UINT16  Ticks_Per_Check;
+
+  Rate_Hz = ( pFunc == NULL ) ? (1000 / WATCHDOG_TICK_MS) : Rate_Hz;
+  Rate_Hz = ( Rate_Hz > WATCHDOG_TICK_HZ_MAX ) ? WATCHDOG_TICK_HZ_MAX : Rate_Hz;
+  Ticks_Per_Check = Rate_Hz / (1000 / WATCHDOG_TICK_MS);
+  Ticks_Per_Check = ( Ticks_Per_Check < 1 ) ? 1 : Ticks_Per_Check;
+
+  noInterrupts();
+  Watchdog_Tick_Func       = pFunc;
+  Watchdog_Tick_Cycles     = (uint32_t)ESP.getCpuFreqMHz() * 1000 * WATCHDOG_TICK_MS / Ticks_Per_Check;
+  Watchdog_Ticks_Per_Check = Ticks_Per_Check;
+  Watchdog_Ticks_Left      = Ticks_Per_Check;
+  interrupts();
+
+  return Ticks_Per_Check * (1000 / WATCHDOG_TICK_MS);
+}
+
+/*===========================================================================*/
+
+const __FlashStringHelper *
+Watchdog_Task_Name( WATCHDOG_TASK Task )
+{
+  return FLASH_STRING_TABLE_GET( Watchdog_Task_Names, Task, "unknown" );
+}
+
+/*===========================================================================*/
+
+/* Stalls of all tasks, since power on */
+UINT32
+Watchdog_Stalls( void )
+{
+  UINT32  Total = 0;
+  UINT8   Task;
+
+  for ( Task = 0; Task < NUM_WATCHDOG_TASKS; Task++ )
+  {
+    Total += Watchdog_Rtc.stalls[Task];
+  }
+
+  return Total;
+}
+
+/*===========================================================================*/
+
+/*!
+The last stall, since power on.
+
+@param  pStall  The stall, (O)
+@return FALSE if there was none
+*/
+BOOL
+Watchdog_Last_Stall( WATCHDOG_STALL_RECORD *pStall )
+{
+  if ( Watchdog_Stalls() == 0 )
+  {
+    return FALSE;
+  }
+
+  noInterrupts();
+  pStall->task    = (WATCHDOG_TASK)Watchdog_Rtc.last_task;
+  pStall->ran_ms  = Watchdog_Rtc.last_ran_ms;
+  pStall->reset   = Watchdog_Rtc.last_reset;
+  interrupts();
+
+  return TRUE;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,104 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   watchdog.h
+@brief  Software watchdog of the loop() tasks, definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __WATCHDOG_H__
+#define __WATCHDOG_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* How often the timer looks at the running task */
+#define WATCHDOG_TICK_MS      100
+
+/* Fastest the timer ticks for a tick function, see Watchdog_Set_Tick_Func() */
+#define WATCHDOG_TICK_HZ_MAX  1000
+
+/* Published once connected after a boot that follows a stall */
+#define WATCHDOG_STATE_TOPIC  "watchdog"
+
+/* What loop() is doing, LOOP is all of it outside the others */
+typedef enum
+{
+  WATCHDOG_TASK_LOOP = 0,
+  WATCHDOG_TASK_SAMPLING,
+  WATCHDOG_TASK_PUBLISH,
+  WATCHDOG_TASK_HTTP,
+  WATCHDOG_TASK_MQTT,
+  WATCHDOG_TASK_NTP,
+  WATCHDOG_TASK_WIFI,
+
+  NUM_WATCHDOG_TASKS
+
+} WATCHDOG_TASK;
+
+/* The last stall, in RTC user memory across the reset */
+typedef struct
+{
+  WATCHDOG_TASK task;
+  UINT32        ran_ms;       /* How long it had run when last seen */
+  BOOL          reset;        /* The watchdog reset for it */
+
+} WATCHDOG_STALL_RECORD;
+
+/* Called from the timer0 interrupt on each tick, must be IRAM_ATTR */
+typedef void (*WATCHDOG_TICK_FUNC)( void );
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Watchdog_Initialise( void );
+
+extern void
+Watchdog_Handle( void );
+
+extern void
+Watchdog_Begin( WATCHDOG_TASK Task );
+
+extern void
+Watchdog_End( void );
+
+extern void
+Watchdog_Heartbeat( void );
+
+extern UINT16
+Watchdog_Set_Tick_Func( WATCHDOG_TICK_FUNC pFunc, UINT16 Rate_Hz );
+
+extern const __FlashStringHelper *
+Watchdog_Task_Name( WATCHDOG_TASK Task );
+
+extern UINT32
+Watchdog_Stalls( void );
+
+extern BOOL
+Watchdog_Last_Stall( WATCHDOG_STALL_RECORD *pStall );
+
+#endif  /* __WATCHDOG_H__ */
+
+/*===========================================================================*/
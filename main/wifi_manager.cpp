@@ -0,0 +1,701 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   wifi_manager.cpp
+@brief  Wifi connection management, with fast reconnect from cached AP info
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The BSSID, channel and DHCP lease of the last successful connection are
+cached in RTC memory (survives reset) and EEPROM (survives power loss).
+On boot a directed connect with them skips the scan and DHCP, and falls
+back to a full connect if it fails.
+
+A full connect scans in background and selects the best stored network
+by RSSI and priority. When connected with a weak signal, it scans again
+and roams to a clearly stronger AP.
+
+Connecting never blocks, it is driven by Wifi_Handle() from loop().
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <EEPROM.h>
+#include <ESP8266WiFi.h>
+#include <coredecls.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "wifi_manager.h"
+#include "wifi_select.h"
+#include "boot_profile.h"
+#include "metrics.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Uncomment to use a static IP instead of DHCP, for both fast and full connect */
+//#define STA_STATIC_IP       "192.168.1.200"
+//#define STA_STATIC_GATEWAY  "192.168.1.1"
+//#define STA_STATIC_NETMASK  "255.255.255.0"
+//#define STA_STATIC_DNS      "192.168.1.1"
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static WIFI_STATE Wifi_State            = WIFI_STATE_IDLE;
+static UINT32     Wifi_State_Start_ms   = 0;
+static UINT32     Wifi_Connect_Start_ms = 0;
+
+/* The stored network in use, -1 if none */
+static INT8       Wifi_Current_Index    = -1;
+
+/* Roaming */
+static BOOL       Wifi_Roam_Scanning    = FALSE;
+static UINT32     Wifi_Last_Roam_Check_ms = 0;
+static UINT32     Wifi_Last_Roam_Scan_ms  = 0;
+
+/* Last scan results, strongest first */
+static WIFI_SCAN_RECORD Wifi_Scan_Results[WIFI_SCAN_MAX_RESULTS];
+static UINT8            Wifi_Scan_Count = 0;
+static BOOL             Wifi_Scan_Valid = FALSE;
+static UINT32           Wifi_Scan_Done_ms = 0;
+
+/* A scan for the wifi page is running */
+static BOOL             Wifi_Page_Scanning = FALSE;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static UINT32 Wifi_Credential_CRC( INT8 Index );
+static INT8   Wifi_Cache_Load( WIFI_CACHE_RECORD *pCache );
+static void   Wifi_Set_State( WIFI_STATE State );
+static void   Wifi_Start_Scan( BOOL Roaming );
+static BOOL   Wifi_Collect_Scan( void );
+static void   Wifi_Connect_Selected( INT8 List_Index, INT8 Scan_Index );
+static void   Wifi_On_Connected( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* CRC of ssid and password of a stored network */
+static UINT32
+Wifi_Credential_CRC( INT8 Index )
+{
+  UINT32  Crc;
+
+  Crc = crc32( My_Config.sta_list[Index].ssid, strlen(My_Config.sta_list[Index].ssid) );
+  Crc = crc32( My_Config.sta_list[Index].pwd,  strlen(My_Config.sta_list[Index].pwd), Crc );
+
+  return Crc;
+}
+
+/*===========================================================================*/
+
+/* Load the cache from RTC memory, or from EEPROM after power loss.
+   Return the index of the stored network it belongs to, -1 if not usable */
+static INT8
+Wifi_Cache_Load( WIFI_CACHE_RECORD *pCache )
+{
+  BOOL  Valid = FALSE;
+  INT8  Index;
+
+  /* RTC memory first */
+  if ( ESP.rtcUserMemoryRead( RTC_WIFI_CACHE_OFFSET, (uint32_t *)pCache, sizeof(WIFI_CACHE_RECORD) ) )
+  {
+    Valid = ( pCache->magic == WIFI_CACHE_MAGIC ) &&
+            ( pCache->crc == crc32( pCache, offsetof(WIFI_CACHE_RECORD, crc) ) );
+  }
+
+  /* Then EEPROM */
+  if ( Valid == FALSE )
+  {
+    EEPROM.begin(EEPROM_TOTAL_SIZE);
+    EEPROM.get( EEPROM_WIFI_CACHE_ADDR, *pCache );
+
+    Valid = ( pCache->magic == WIFI_CACHE_MAGIC ) &&
+            ( pCache->crc == crc32( pCache, offsetof(WIFI_CACHE_RECORD, crc) ) );
+  }
+
+  if ( Valid == FALSE )
+  {
+    LOG( DBG_I, "Wifi: No cached AP info.\n" );
+    return -1;
+  }
+
+  /* Find the stored network, it may be changed since the cache was written */
+  for ( Index = 0; Index < WIFI_STA_LIST_MAX_SIZE; Index++ )
+  {
+    if ( My_Config.sta_list[Index].valid &&
+         (pCache->credential_crc == Wifi_Credential_CRC(Index)) )
+    {
+      return Index;
+    }
+  }
+
+  LOG( DBG_I, "Wifi: Cached AP info is for another SSID.\n" );
+  return -1;
+}
+
+/*===========================================================================*/
+
+/* Save the current connection into RTC memory,
+   and into EEPROM if it is changed, to avoid wearing the flash */
+void
+Wifi_Cache_Update( void )
+{
+  WIFI_CACHE_RECORD Cache;
+  WIFI_CACHE_RECORD Old_Cache;
+
+  if ( (WiFi.status() != WL_CONNECTED) || (Wifi_Current_Index < 0) )
+  {
+    return;
+  }
+
+  memset( &Cache, 0, sizeof(Cache) );
+  Cache.magic           = WIFI_CACHE_MAGIC;
+  Cache.credential_crc  = Wifi_Credential_CRC( Wifi_Current_Index );
+  memcpy( Cache.bssid, WiFi.BSSID(), sizeof(Cache.bssid) );
+  Cache.channel         = (UINT8)WiFi.channel();
+  Cache.ip              = (UINT32)WiFi.localIP();
+  Cache.gateway         = (UINT32)WiFi.gatewayIP();
+  Cache.netmask         = (UINT32)WiFi.subnetMask();
+  Cache.dns             = (UINT32)WiFi.dnsIP();
+  Cache.crc             = crc32( &Cache, offsetof(WIFI_CACHE_RECORD, crc) );
+
+  ESP.rtcUserMemoryWrite( RTC_WIFI_CACHE_OFFSET, (uint32_t *)&Cache, sizeof(Cache) );
+
+  EEPROM.begin(EEPROM_TOTAL_SIZE);
+  EEPROM.get( EEPROM_WIFI_CACHE_ADDR, Old_Cache );
+  if ( memcmp( &Cache, &Old_Cache, sizeof(Cache) ) != 0 )
+  {
+    EEPROM.put( EEPROM_WIFI_CACHE_ADDR, Cache );
+    Metric_Inc( METRIC_EEPROM_COMMITS );
+    if ( !EEPROM.commit() )
+    {
+      LOG( DBG_E, "Wifi: Save AP info into EEPROM failed.\n" );
+    }
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Wifi_Set_State( WIFI_STATE State )
+{
+  Wifi_State          = State;
+  Wifi_State_Start_ms = millis();
+}
+
+/*===========================================================================*/
+
+/* Start a background scan, poll the result in Wifi_Handle() */
+static void
+Wifi_Start_Scan( BOOL Roaming )
+{
+  WiFi.scanDelete();
+  WiFi.scanNetworks( /*async=*/true, /*hidden=*/false );
+
+  Wifi_Roam_Scanning = Roaming;
+  if ( Roaming )
+  {
+    Wifi_Last_Roam_Scan_ms = millis();
+  }
+  else
+  {
+    Wifi_Set_State( WIFI_STATE_SCANNING );
+  }
+
+  LOG( DBG_I, "Wifi: Start %s scan.\n", Roaming?"roaming":"connecting" );
+}
+
+/*===========================================================================*/
+
+/* Copy the finished scan into Wifi_Scan_Results and sort it.
+   Return FALSE if the scan is still running */
+static BOOL
+Wifi_Collect_Scan( void )
+{
+  INT8    Scan_Result;
+  INT8    Index;
+
+  Scan_Result = WiFi.scanComplete();
+  if ( Scan_Result == WIFI_SCAN_RUNNING )
+  {
+    return FALSE;
+  }
+
+  /* Whoever started it, the wifi page shares the results, none on an error */
+  Wifi_Scan_Count     = 0;
+  Wifi_Scan_Valid     = TRUE;
+  Wifi_Scan_Done_ms   = millis();
+  Wifi_Page_Scanning  = FALSE;
+
+  if ( Scan_Result < 0 )
+  {
+    LOG( DBG_E, "Wifi: Scan error %d\n", Scan_Result );
+    return TRUE;
+  }
+
+  for ( Index = 0; (Index < Scan_Result) && (Wifi_Scan_Count < WIFI_SCAN_MAX_RESULTS); Index++ )
+  {
+    WIFI_SCAN_RECORD *pRecord = &Wifi_Scan_Results[Wifi_Scan_Count];
+
+    strncpy( pRecord->ssid, WiFi.SSID(Index).c_str(), WIFI_SSID_STR_MAX_SIZE - 1 );
+    pRecord->ssid[WIFI_SSID_STR_MAX_SIZE - 1] = 0;
+    memcpy( pRecord->bssid, WiFi.BSSID(Index), sizeof(pRecord->bssid) );
+    pRecord->channel  = (UINT8)WiFi.channel(Index);
+    pRecord->rssi     = (INT8)WiFi.RSSI(Index);
+
+    Wifi_Scan_Count++;
+  }
+
+  WiFi.scanDelete();
+
+  Wifi_Sort_Scan( Wifi_Scan_Results, Wifi_Scan_Count );
+
+  LOG( DBG_I, "Wifi: Scan found %d APs.\n", Wifi_Scan_Count );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Start a directed connect to the AP selected from the scan */
+static void
+Wifi_Connect_Selected( INT8 List_Index, INT8 Scan_Index )
+{
+  WIFI_SCAN_RECORD  *pRecord = &Wifi_Scan_Results[Scan_Index];
+
+  LOG( DBG_N, "Wifi: Connect to %s, channel %d, %d dBm\n",
+              My_Config.sta_list[List_Index].ssid,
+              pRecord->channel,
+              pRecord->rssi );
+
+#ifndef STA_STATIC_IP
+  /* Back to DHCP */
+  WiFi.config( IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0) );
+#endif
+  WiFi.begin( My_Config.sta_list[List_Index].ssid,
+              My_Config.sta_list[List_Index].pwd,
+              pRecord->channel,
+              pRecord->bssid,
+              true );
+
+  Wifi_Current_Index = List_Index;
+  Wifi_Set_State( WIFI_STATE_CONNECTING );
+}
+
+/*===========================================================================*/
+
+static void
+Wifi_On_Connected( void )
+{
+  LOG( DBG_A, "Connected to: %s, %d dBm\n", WiFi.SSID().c_str(), WiFi.RSSI() );
+  LOG( DBG_A, "IP address: %s\n", WiFi.localIP().toString().c_str() );
+  digitalWrite(GPIO_LED_RED, LOW);
+
+  /* The SDK may reconnect by itself, find out which network it is */
+  if ( (Wifi_Current_Index < 0) ||
+       (strcmp( My_Config.sta_list[Wifi_Current_Index].ssid, WiFi.SSID().c_str() ) != 0) )
+  {
+    for ( Wifi_Current_Index = WIFI_STA_LIST_MAX_SIZE - 1; Wifi_Current_Index >= 0; Wifi_Current_Index-- )
+    {
+      if ( My_Config.sta_list[Wifi_Current_Index].valid &&
+           (strcmp( My_Config.sta_list[Wifi_Current_Index].ssid, WiFi.SSID().c_str() ) == 0) )
+      {
+        break;
+      }
+    }
+  }
+
+  Wifi_Cache_Update();
+
+  if ( !Boot_Phase_Is_Done( BOOT_PHASE_WIFI ) )
+  {
+    My_Status_Write_Begin();
+    My_Status.wifi_fast_connect     = ( Wifi_State == WIFI_STATE_FAST_CONNECTING );
+    My_Status.wifi_connect_time_ms  = millis() - Wifi_Connect_Start_ms;
+    My_Status_Write_End();
+
+    LOG( DBG_P, "Wifi: %s connect cost %lu ms.\n",
+                My_Status.wifi_fast_connect?"fast":"full",
+                My_Status.wifi_connect_time_ms );
+
+    Boot_Phase_Done( BOOT_PHASE_WIFI );
+  }
+
+  Wifi_Last_Roam_Check_ms = millis();
+  Wifi_Set_State( WIFI_STATE_CONNECTED );
+}
+
+/*============================================================================*/
+
+/* Start the AP and STA, return immediately.
+   Connecting is going on in Wifi_Handle() */
+void
+Wifi_Initialise( void )
+{
+  WIFI_CACHE_RECORD Cache;
+  INT8              Index;
+
+  /* Set wifi mode to support both AP and STA */
+  WiFi.mode(WIFI_AP_STA);
+
+  /* We cache the AP info by ourselves, don't let SDK write flash on every connect */
+  WiFi.persistent(false);
+
+/*---------------------------------------------------------------------------*/
+
+  /* Init the wifi AP function */
+  LOG( DBG_A, "Configuring Access Point...\n" );
+  /* You can remove the password parameter if you want the AP to be open. */
+//  WiFi.softAP(ap_ssid, ap_password);
+  WiFi.softAP( My_Config.ap_ssid );
+
+  IPAddress myIP = WiFi.softAPIP();
+  LOG( DBG_A, "AP IP address: %s\n", myIP.toString().c_str() );
+
+/*---------------------------------------------------------------------------*/
+
+  /* Init the wifi STA function */
+  Boot_Phase_Start( BOOT_PHASE_WIFI );
+  Wifi_Connect_Start_ms       = millis();
+  My_Status_Write_Begin();
+  My_Status.wifi_fast_connect = FALSE;
+  My_Status_Write_End();
+
+#ifdef STA_STATIC_IP
+  {
+    IPAddress Ip, Gateway, Netmask, Dns;
+
+    Ip.fromString(STA_STATIC_IP);
+    Gateway.fromString(STA_STATIC_GATEWAY);
+    Netmask.fromString(STA_STATIC_NETMASK);
+    Dns.fromString(STA_STATIC_DNS);
+    WiFi.config( Ip, Gateway, Netmask, Dns );
+  }
+#endif
+
+  /* Directed connect with the cached BSSID, channel and lease, skip scan and DHCP */
+  Index = Wifi_Cache_Load( &Cache );
+  if ( Index >= 0 )
+  {
+    LOG( DBG_N, "Wifi: Fast connect to %s, channel %d\n", My_Config.sta_list[Index].ssid, Cache.channel );
+
+#ifndef STA_STATIC_IP
+    WiFi.config( IPAddress(Cache.ip), IPAddress(Cache.gateway), IPAddress(Cache.netmask), IPAddress(Cache.dns) );
+#endif
+    WiFi.begin( My_Config.sta_list[Index].ssid, My_Config.sta_list[Index].pwd, Cache.channel, Cache.bssid, true );
+
+    Wifi_Current_Index = Index;
+    Wifi_Set_State( WIFI_STATE_FAST_CONNECTING );
+  }
+  else
+  {
+    Wifi_Start_Scan( FALSE );
+  }
+
+  LOG( DBG_P, "Wifi Initialise Complete.\n" );
+}
+
+/*============================================================================*/
+
+/* Wifi state machine, to call at each sketch loop() */
+void
+Wifi_Handle( void )
+{
+  BOOL    Connected = ( WiFi.status() == WL_CONNECTED );
+  INT8    List_Index;
+  INT8    Scan_Index;
+  INT32   Current_Rssi;
+
+  /* A scan only the wifi page waits for */
+  if ( Wifi_Page_Scanning && (Wifi_State != WIFI_STATE_SCANNING) && !Wifi_Roam_Scanning )
+  {
+    Wifi_Collect_Scan();
+  }
+
+  switch ( Wifi_State )
+  {
+    case WIFI_STATE_FAST_CONNECTING:
+
+      if ( Connected )
+      {
+        Wifi_On_Connected();
+      }
+      else if ( (millis() - Wifi_State_Start_ms) > WIFI_FAST_CONNECT_TIMEOUT_MS )
+      {
+        LOG( DBG_W, "Wifi: Fast connect failed, fall back to full connect.\n" );
+        WiFi.disconnect();
+        Wifi_Start_Scan( FALSE );
+      }
+      break;
+
+    /*---------------------------------------------------------------------------*/
+
+    case WIFI_STATE_SCANNING:
+
+      if ( !Wifi_Collect_Scan() )
+      {
+        break;
+      }
+
+      List_Index = Wifi_Select_Network( My_Config.sta_list, WIFI_STA_LIST_MAX_SIZE,
+                                        Wifi_Scan_Results, Wifi_Scan_Count, &Scan_Index );
+      if ( List_Index < 0 )
+      {
+        LOG( DBG_A, "Wifi: No stored network found!\n" );
+        digitalWrite(GPIO_LED_RED, HIGH);
+        Wifi_Set_State( WIFI_STATE_DISCONNECTED );
+      }
+      else
+      {
+        Wifi_Connect_Selected( List_Index, Scan_Index );
+      }
+      break;
+
+    /*---------------------------------------------------------------------------*/
+
+    case WIFI_STATE_CONNECTING:
+
+      if ( Connected )
+      {
+        Wifi_On_Connected();
+      }
+      else if ( (millis() - Wifi_State_Start_ms) > WIFI_FULL_CONNECT_TIMEOUT_MS )
+      {
+        LOG( DBG_A, "Connect failed, bad SSID %s!\n",
+                    (Wifi_Current_Index >= 0) ? My_Config.sta_list[Wifi_Current_Index].ssid : "" );
+        digitalWrite(GPIO_LED_RED, HIGH);
+        Wifi_Set_State( WIFI_STATE_DISCONNECTED );
+      }
+      break;
+
+    /*---------------------------------------------------------------------------*/
+
+    case WIFI_STATE_CONNECTED:
+
+      if ( !Connected )
+      {
+        LOG( DBG_W, "Wifi: Connection lost.\n" );
+        Wifi_Roam_Scanning = FALSE;
+        Wifi_Set_State( WIFI_STATE_DISCONNECTED );
+        break;
+      }
+
+      /* Roaming scan finished, move if a clearly stronger AP is found */
+      if ( Wifi_Roam_Scanning )
+      {
+        if ( !Wifi_Collect_Scan() )
+        {
+          break;
+        }
+        Wifi_Roam_Scanning = FALSE;
+
+        Current_Rssi  = WiFi.RSSI();
+        List_Index    = Wifi_Select_Network( My_Config.sta_list, WIFI_STA_LIST_MAX_SIZE,
+                                             Wifi_Scan_Results, Wifi_Scan_Count, &Scan_Index );
+        if ( (List_Index >= 0) &&
+             (memcmp( Wifi_Scan_Results[Scan_Index].bssid, WiFi.BSSID(), 6 ) != 0) &&
+             (Wifi_Scan_Results[Scan_Index].rssi >= Current_Rssi + WIFI_ROAM_HYSTERESIS_DB) )
+        {
+          LOG( DBG_N, "Wifi: Roam from %d dBm to %d dBm.\n", Current_Rssi, Wifi_Scan_Results[Scan_Index].rssi );
+          Wifi_Connect_Selected( List_Index, Scan_Index );
+        }
+        break;
+      }
+
+      /* Check if the link is weak */
+      if ( (millis() - Wifi_Last_Roam_Check_ms) > WIFI_ROAM_CHECK_MS )
+      {
+        Wifi_Last_Roam_Check_ms = millis();
+
+        if ( (WiFi.RSSI() < WIFI_ROAM_RSSI_THRESHOLD) &&
+             ((millis() - Wifi_Last_Roam_Scan_ms) > WIFI_ROAM_SCAN_INTERVAL_MS) )
+        {
+          Wifi_Start_Scan( TRUE );
+        }
+      }
+      break;
+
+    /*---------------------------------------------------------------------------*/
+
+    case WIFI_STATE_DISCONNECTED:
+
+      /* SDK keeps retrying the last AP in background */
+      if ( Connected )
+      {
+        LOG( DBG_N, "Wifi: Reconnected.\n" );
+        Wifi_On_Connected();
+      }
+      else if ( (millis() - Wifi_State_Start_ms) > WIFI_RETRY_INTERVAL_MS )
+      {
+        Wifi_Start_Scan( FALSE );
+      }
+      break;
+
+    /*---------------------------------------------------------------------------*/
+
+    default:
+      break;
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+Scan results for the wifi page, strongest first.
+They are kept for WIFI_PAGE_SCAN_MAX_AGE_MS, a call after that starts a
+background scan and still gets the old ones. A scan in flight, for
+connecting, roaming or an earlier call, is never started twice.
+
+@param  ppResults   Results, valid until the next Wifi_Handle(), (O)
+@return Number of results, -1 if the first scan is not done yet
+*/
+INT8
+Wifi_Page_Scan( const WIFI_SCAN_RECORD **ppResults )
+{
+  BOOL  Scanning = Wifi_Page_Scanning || Wifi_Roam_Scanning || (Wifi_State == WIFI_STATE_SCANNING);
+  BOOL  Connecting = (Wifi_State == WIFI_STATE_FAST_CONNECTING) || (Wifi_State == WIFI_STATE_CONNECTING);
+
+  /* A scan would get in the way of connecting */
+  if ( !Scanning && !Connecting &&
+       (!Wifi_Scan_Valid || ((millis() - Wifi_Scan_Done_ms) > WIFI_PAGE_SCAN_MAX_AGE_MS)) )
+  {
+    WiFi.scanDelete();
+    WiFi.scanNetworks( /*async=*/true, /*hidden=*/false );
+    Wifi_Page_Scanning = TRUE;
+
+    LOG( DBG_I, "Wifi: Start page scan.\n" );
+  }
+
+  *ppResults = Wifi_Scan_Results;
+
+  return Wifi_Scan_Valid ? (INT8)Wifi_Scan_Count : -1;
+}
+
+/*===========================================================================*/
+
+/* TRUE if the STA is connected and got IP */
+BOOL
+Wifi_Is_Connected( void )
+{
+  return ( Wifi_State == WIFI_STATE_CONNECTED );
+}
+
+/*===========================================================================*/
+
+/*!
+Add or update a stored network and save the config.
+A new network takes a free slot, or replaces the lowest priority one.
+
+@param  pSsid       SSID, (I)
+@param  pPwd        Password, (I)
+@param  Priority    0-WIFI_PRIORITY_MAX, higher is preferred, (I)
+@return Index of the stored network, -1 if failed
+*/
+INT8
+Wifi_Add_Network( const CHAR *pSsid, const CHAR *pPwd, UINT8 Priority )
+{
+  MY_CONFIG_RECORD  Config;
+  INT8              Index;
+  INT8              Slot = -1;
+
+  if ( (strlen(pSsid) == 0) ||
+       (strlen(pSsid) >= WIFI_SSID_STR_MAX_SIZE) ||
+       (strlen(pPwd) >= WIFI_PWD_STR_MAX_SIZE) )
+  {
+    LOG( DBG_E, "Wifi: Bad ssid or password length.\n" );
+    return -1;
+  }
+
+  if ( Priority > WIFI_PRIORITY_MAX )
+  {
+    Priority = WIFI_PRIORITY_MAX;
+  }
+
+  memcpy( &Config, &My_Config, sizeof(MY_CONFIG_RECORD) );
+
+  /* Same SSID, else the first free slot, else the lowest priority one */
+  for ( Index = 0; Index < WIFI_STA_LIST_MAX_SIZE; Index++ )
+  {
+    if ( Config.sta_list[Index].valid && (strcmp( Config.sta_list[Index].ssid, pSsid ) == 0) )
+    {
+      Slot = Index;
+      break;
+    }
+
+    if ( (Slot >= 0) && !Config.sta_list[Slot].valid )
+    {
+      continue;
+    }
+
+    if ( (Slot < 0) ||
+         !Config.sta_list[Index].valid ||
+         (Config.sta_list[Index].priority < Config.sta_list[Slot].priority) )
+    {
+      Slot = Index;
+    }
+  }
+
+  memset( &Config.sta_list[Slot], 0, sizeof(WIFI_STA_RECORD) );
+  Config.sta_list[Slot].valid     = TRUE;
+  Config.sta_list[Slot].priority  = Priority;
+  strcpy( Config.sta_list[Slot].ssid, pSsid );
+  strcpy( Config.sta_list[Slot].pwd,  pPwd );
+
+  if ( My_Config_Save( &Config ) != FN_RETURN_OK )
+  {
+    return -1;
+  }
+
+  memcpy( &My_Config, &Config, sizeof(MY_CONFIG_RECORD) );
+
+  LOG( DBG_N, "Wifi: Network %s stored at %d, priority %d\n", pSsid, Slot, Priority );
+
+  return Slot;
+}
+
+/*===========================================================================*/
+
+/* Start connecting to a stored network, return immediately */
+void
+Wifi_Connect_Network( INT8 Index )
+{
+  if ( (Index < 0) || (Index >= WIFI_STA_LIST_MAX_SIZE) || !My_Config.sta_list[Index].valid )
+  {
+    return;
+  }
+
+  LOG( DBG_N, "Wifi: Connect to %s\n", My_Config.sta_list[Index].ssid );
+
+#ifndef STA_STATIC_IP
+  /* Back to DHCP */
+  WiFi.config( IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0) );
+#endif
+  WiFi.begin( My_Config.sta_list[Index].ssid, My_Config.sta_list[Index].pwd );
+
+  Wifi_Roam_Scanning = FALSE;
+  Wifi_Current_Index = Index;
+  Wifi_Set_State( WIFI_STATE_CONNECTING );
+}
+
+/*===========================================================================*/
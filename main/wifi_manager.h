@@ -0,0 +1,123 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   wifi_manager.h
+@brief  Wifi connection management definitions
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __WIFI_MANAGER_H__
+#define __WIFI_MANAGER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+#include "wifi_select.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Connect timeout when using the cached BSSID/channel/IP */
+#define WIFI_FAST_CONNECT_TIMEOUT_MS  2000
+
+/* Connect timeout of a full connect with DHCP */
+#define WIFI_FULL_CONNECT_TIMEOUT_MS  10000
+
+/* Rescan and reconnect after being disconnected for this time */
+#define WIFI_RETRY_INTERVAL_MS        30000
+
+/* Roaming, checked every WIFI_ROAM_CHECK_MS when connected.
+   If RSSI is below the threshold, scan in background at most every
+   WIFI_ROAM_SCAN_INTERVAL_MS, and move to an AP stronger by the hysteresis */
+#define WIFI_ROAM_CHECK_MS            10000
+#define WIFI_ROAM_SCAN_INTERVAL_MS    60000
+#define WIFI_ROAM_RSSI_THRESHOLD      (-75)
+#define WIFI_ROAM_HYSTERESIS_DB       8
+
+/* The wifi page reuses a scan this old, a request after it starts a new
+   one in background and gets the old results meanwhile */
+#define WIFI_PAGE_SCAN_MAX_AGE_MS     30000
+
+/* Wifi STA states */
+typedef enum
+{
+  WIFI_STATE_IDLE = 0,
+  WIFI_STATE_FAST_CONNECTING,   /* Directed connect with the cache */
+  WIFI_STATE_SCANNING,          /* Scan to select a network */
+  WIFI_STATE_CONNECTING,        /* Connecting to the selected network */
+  WIFI_STATE_CONNECTED,
+  WIFI_STATE_DISCONNECTED,
+
+} WIFI_STATE;
+
+#define WIFI_CACHE_MAGIC              0x57494643    /* 'WIFC' */
+
+/* Last successful connection, cached in RTC memory and EEPROM */
+typedef struct
+{
+  /* WIFI_CACHE_MAGIC if this record is valid */
+  UINT32  magic;
+
+  /* CRC of ssid and password, the cache is only used for the same AP */
+  UINT32  credential_crc;
+
+  /* AP MAC and channel, used to skip the scan */
+  UINT8   bssid[6];
+  UINT8   channel;
+  UINT8   reserved;
+
+  /* DHCP lease, used to skip DHCP */
+  UINT32  ip;
+  UINT32  gateway;
+  UINT32  netmask;
+  UINT32  dns;
+
+  /* CRC of all above */
+  UINT32  crc;
+
+} WIFI_CACHE_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Wifi_Initialise( void );
+
+extern void
+Wifi_Handle( void );
+
+extern BOOL
+Wifi_Is_Connected( void );
+
+extern INT8
+Wifi_Page_Scan( const WIFI_SCAN_RECORD **ppResults );
+
+extern INT8
+Wifi_Add_Network( const CHAR *pSsid, const CHAR *pPwd, UINT8 Priority );
+
+extern void
+Wifi_Connect_Network( INT8 Index );
+
+extern void
+Wifi_Cache_Update( void );
+
+#endif  /* __WIFI_MANAGER_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,135 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   wifi_select.cpp
+@brief  Select the station network to connect from scan results
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "wifi_select.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Sort the scan results by RSSI, strongest first.
+   Insertion sort, the list is short and the order is stable */
+void
+Wifi_Sort_Scan( WIFI_SCAN_RECORD *pScan, UINT8 Scan_Size )
+{
+  UINT8             i;
+  INT16             j;
+  WIFI_SCAN_RECORD  Record;
+
+  for ( i = 1; i < Scan_Size; i++ )
+  {
+    Record = pScan[i];
+
+    for ( j = i - 1; (j >= 0) && (pScan[j].rssi < Record.rssi); j-- )
+    {
+      pScan[j+1] = pScan[j];
+    }
+
+    pScan[j+1] = Record;
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+Select the best AP among the scan results which matches a stored network.
+Score is RSSI plus WIFI_PRIORITY_WEIGHT_DB for each priority level,
+so a stronger AP wins unless the other network is preferred clearly.
+With repeaters the same SSID is found several times, the strongest wins.
+
+@param  pList         Stored networks, (I)
+@param  List_Size     Count of stored networks, (I)
+@param  pScan         Scan results, (I)
+@param  Scan_Size     Count of scan results, (I)
+@param  pScan_Index   Index of the selected AP in scan results, (O)
+@return Index of the selected stored network, -1 if nothing matches
+*/
+INT8
+Wifi_Select_Network(  const WIFI_STA_RECORD   *pList,
+                      UINT8                   List_Size,
+                      const WIFI_SCAN_RECORD  *pScan,
+                      UINT8                   Scan_Size,
+                      INT8                    *pScan_Index )
+{
+  UINT8   List_Index;
+  UINT8   Scan_Index;
+  INT32   Score;
+  INT32   Best_Score    = -0x7FFFFFFF;
+  INT8    Best_List     = -1;
+  INT8    Best_Scan     = -1;
+
+  for ( Scan_Index = 0; Scan_Index < Scan_Size; Scan_Index++ )
+  {
+    if ( pScan[Scan_Index].rssi < WIFI_MIN_RSSI_DBM )
+    {
+      continue;
+    }
+
+    for ( List_Index = 0; List_Index < List_Size; List_Index++ )
+    {
+      if ( !pList[List_Index].valid ||
+           (strncmp( pList[List_Index].ssid, pScan[Scan_Index].ssid, WIFI_SSID_STR_MAX_SIZE ) != 0) )
+      {
+        continue;
+      }
+
+      Score = pScan[Scan_Index].rssi + (INT32)pList[List_Index].priority * WIFI_PRIORITY_WEIGHT_DB;
+
+      /* Equal score, keep the stronger one */
+      if ( (Score > Best_Score) ||
+           ((Score == Best_Score) && (pScan[Scan_Index].rssi > pScan[Best_Scan].rssi)) )
+      {
+        Best_Score  = Score;
+        Best_List   = List_Index;
+        Best_Scan   = Scan_Index;
+      }
+    }
+  }
+
+  if ( pScan_Index != NULL )
+  {
+    *pScan_Index = Best_Scan;
+  }
+
+  return Best_List;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,71 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   wifi_select.h
+@brief  Select the station network to connect from scan results
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Pure logic without any Wifi calls, so it can be run with simulated scan results.
+*/
+
+#ifndef __WIFI_SELECT_H__
+#define __WIFI_SELECT_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "esp8266_global.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Max count of scan results kept */
+#define WIFI_SCAN_MAX_RESULTS     16
+
+/* APs weaker than this are ignored */
+#define WIFI_MIN_RSSI_DBM         (-88)
+
+/* One priority level is worth this much RSSI */
+#define WIFI_PRIORITY_WEIGHT_DB   10
+
+/* One AP found in the scan */
+typedef struct
+{
+  CHAR    ssid[WIFI_SSID_STR_MAX_SIZE];
+  UINT8   bssid[6];
+  UINT8   channel;
+  INT8    rssi;
+
+} WIFI_SCAN_RECORD;
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern void
+Wifi_Sort_Scan( WIFI_SCAN_RECORD *pScan, UINT8 Scan_Size );
+
+extern INT8
+Wifi_Select_Network(  const WIFI_STA_RECORD   *pList,
+                      UINT8                   List_Size,
+                      const WIFI_SCAN_RECORD  *pScan,
+                      UINT8                   Scan_Size,
+                      INT8                    *pScan_Index );
+
+#endif  /* __WIFI_SELECT_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,318 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   admission_check.cpp
+@brief  Flood a simulated loop() with HTTP requests, with and without admission
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/http_admission.h on the host against a model of loop(). Time is
+simulated in microseconds, each loop() does its own work and then lets the
+web server handle at most one pending request, as handleClient() does.
+Requests arrive at random at a fixed rate, over all paths, and wait in a
+backlog of a few connections, more are refused by the TCP stack.
+
+The request costs are rough numbers measured on the board:
+
+  Path          Before                          Now
+  /             300 ms Internet check each      6 ms, the check once per 30 sec
+  /wifi GET     2.2 s blocking scan each        8 ms from the shared scan
+  /control      6 ms                            6 ms
+  /metrics      12 ms                           12 ms
+  /wifi POST    250 ms flash write              250 ms
+  other         3 ms + echo of the arguments    3 ms, echo bounded
+  turned away   -                               0.8 ms for the 429
+
+Both ways are run with the same arrivals, and the loop() interval and the
+share of the time that went to HTTP are printed. It fails if with
+admission the 99th percentile of the interval, or the time the admitted
+requests take per second, is over what the limits allow.
+
+Build, from this directory:
+  g++ -O2 -I../../main -o admission_check admission_check.cpp
+
+Usage:
+  admission_check [-r requests/s] [-t seconds] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "http_admission.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* loop() without HTTP, sonar, relay, MQTT */
+#define CHECK_LOOP_US             1000
+
+/* Connections the TCP stack holds for the server */
+#define CHECK_BACKLOG             5
+
+/* Sending a 429 */
+#define CHECK_REJECT_US           800
+
+/* The Internet check, cached for this long */
+#define CHECK_INTERNET_US         300000
+#define CHECK_INTERNET_TTL_US     30000000ULL
+
+/* With admission the 99th percentile of the loop() interval stays below */
+#define CHECK_P99_BOUND_US        20000
+
+typedef struct
+{
+  const CHAR  *pName;
+  HTTP_COST   cost;
+  uint32_t    before_us;
+  uint32_t    now_us;
+
+} CHECK_PATH_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static const CHECK_PATH_RECORD  Check_Paths[] =
+{
+  { "/",          HTTP_COST_PAGE,       CHECK_INTERNET_US,  6000 },
+  { "/wifi",      HTTP_COST_PAGE,       2200000,            8000 },
+  { "/control",   HTTP_COST_PAGE,       6000,               6000 },
+  { "/metrics",   HTTP_COST_CHEAP,      12000,              12000 },
+  { "/wifi POST", HTTP_COST_EXPENSIVE,  250000,             250000 },
+  { "other",      HTTP_COST_CHEAP,      9000,               3000 },
+};
+
+#define CHECK_NUM_PATHS   (sizeof(Check_Paths) / sizeof(Check_Paths[0]))
+
+static const HTTP_COST_LIMIT_RECORD Check_Limits[NUM_HTTP_COSTS] = HTTP_COST_LIMITS;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check_Arrivals( std::vector<uint64_t> *pTimes, std::vector<uint8_t> *pPaths,
+                              double Rate, uint32_t Seconds );
+static BOOL   Check_Run( BOOL Admission, const std::vector<uint64_t> &Times,
+                         const std::vector<uint8_t> &Paths, uint32_t Seconds );
+static double Check_Budget_Us( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Poisson arrivals over a random mix of paths */
+static void
+Check_Arrivals( std::vector<uint64_t> *pTimes, std::vector<uint8_t> *pPaths, double Rate, uint32_t Seconds )
+{
+  double  Now_us = 0;
+
+  while ( Now_us < Seconds * 1e6 )
+  {
+    Now_us += -log( (rand() + 1.0) / (RAND_MAX + 2.0) ) * 1e6 / Rate;
+    pTimes->push_back( (uint64_t)Now_us );
+    pPaths->push_back( (uint8_t)(rand() % CHECK_NUM_PATHS) );
+  }
+}
+
+/*===========================================================================*/
+
+/* HTTP time the limits allow per second, for the admitted requests */
+static double
+Check_Budget_Us( void )
+{
+  double    Budget = 0;
+  uint32_t  Worst[NUM_HTTP_COSTS] = { 0 };
+  size_t    Index;
+
+  for ( Index = 0; Index < CHECK_NUM_PATHS; Index++ )
+  {
+    Worst[Check_Paths[Index].cost] = std::max( Worst[Check_Paths[Index].cost], Check_Paths[Index].now_us );
+  }
+
+  for ( Index = 0; Index < NUM_HTTP_COSTS; Index++ )
+  {
+    Budget += Worst[Index] * 1000.0 / Check_Limits[Index].interval_ms;
+  }
+
+  /* And the Internet check */
+  return Budget + CHECK_INTERNET_US * 1e6 / CHECK_INTERNET_TTL_US;
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Run( BOOL Admission, const std::vector<uint64_t> &Times, const std::vector<uint8_t> &Paths, uint32_t Seconds )
+{
+  HTTP_ADMISSION_RECORD   Buckets;
+  std::vector<uint8_t>    Backlog;
+  std::vector<uint32_t>   Intervals;
+  uint64_t  Now_us        = 0;
+  uint64_t  Last_Loop_us  = 0;
+  uint64_t  Http_us       = 0;
+  uint64_t  Admitted_us   = 0;
+  uint64_t  Checked_us    = 0;
+  BOOL      Checked       = FALSE;
+  uint32_t  Served        = 0;
+  uint32_t  Rejected      = 0;
+  uint32_t  Refused       = 0;
+  uint32_t  Retry_s;
+  uint32_t  Cost_us;
+  size_t    Next          = 0;
+  double    Budget_us     = Check_Budget_Us() * Seconds;
+  BOOL      Ok            = TRUE;
+
+  Http_Admission_Init( &Buckets );
+
+  while ( Now_us < (uint64_t)Seconds * 1000000 )
+  {
+    /* What arrived while the last loop() ran */
+    while ( (Next < Times.size()) && (Times[Next] <= Now_us) )
+    {
+      if ( Backlog.size() < CHECK_BACKLOG )
+      {
+        Backlog.push_back( Paths[Next] );
+      }
+      else
+      {
+        Refused++;
+      }
+      Next++;
+    }
+
+    Now_us += CHECK_LOOP_US;
+
+    /* handleClient(), one request */
+    if ( !Backlog.empty() )
+    {
+      const CHECK_PATH_RECORD *pPath = &Check_Paths[Backlog.front()];
+
+      Backlog.erase( Backlog.begin() );
+
+      if ( !Admission )
+      {
+        Cost_us = pPath->before_us;
+        Served++;
+      }
+      else if ( !Http_Admit( &Buckets, pPath->cost, (uint32_t)(Now_us / 1000), &Retry_s ) )
+      {
+        Cost_us = CHECK_REJECT_US;
+        Rejected++;
+      }
+      else
+      {
+        Cost_us = pPath->now_us;
+        if ( (pPath == &Check_Paths[0]) && (!Checked || ((Now_us - Checked_us) >= CHECK_INTERNET_TTL_US)) )
+        {
+          Cost_us    += CHECK_INTERNET_US;
+          Checked     = TRUE;
+          Checked_us  = Now_us;
+        }
+        Admitted_us += Cost_us;
+        Served++;
+      }
+
+      Now_us  += Cost_us;
+      Http_us += Cost_us;
+    }
+
+    Intervals.push_back( (uint32_t)(Now_us - Last_Loop_us) );
+    Last_Loop_us = Now_us;
+  }
+
+  std::sort( Intervals.begin(), Intervals.end() );
+
+  printf( "%-10s %zu loops, %u served, %u turned away, %u refused\n"
+          "           interval p50 %u us, p99 %u us, max %u us, HTTP %.1f%% of the time\n",
+          Admission ? "admission" : "before",
+          Intervals.size(), Served, Rejected, Refused,
+          Intervals[Intervals.size() / 2], Intervals[Intervals.size() * 99 / 100], Intervals.back(),
+          100.0 * Http_us / Now_us );
+
+  if ( Admission )
+  {
+    if ( Intervals[Intervals.size() * 99 / 100] > CHECK_P99_BOUND_US )
+    {
+      printf( "  p99 interval over %u us\n", CHECK_P99_BOUND_US );
+      Ok = FALSE;
+    }
+    if ( Admitted_us > Budget_us )
+    {
+      printf( "  admitted requests took %.0f ms, over the %.0f ms the limits allow\n",
+              Admitted_us / 1000.0, Budget_us / 1000.0 );
+      Ok = FALSE;
+    }
+    printf( "           admitted %.0f ms of %.0f ms allowed, %s\n",
+            Admitted_us / 1000.0, Budget_us / 1000.0, Ok ? "ok" : "FAILED" );
+  }
+
+  return Ok;
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  std::vector<uint64_t> Times;
+  std::vector<uint8_t>  Paths;
+  double    Rate    = 200;
+  uint32_t  Seconds = 120;
+  uint32_t  Seed    = 1;
+  INT32     Opt;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-r" ) == 0) && (Opt + 1 < argc) )
+    {
+      Rate = strtod( argv[++Opt], NULL );
+    }
+    else if ( (strcmp( argv[Opt], "-t" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seconds = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-r requests/s] [-t seconds] [-s seed]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( (Rate <= 0) || (Seconds == 0) )
+  {
+    fprintf( stderr, "Rate and time must be above 0\n" );
+    return 1;
+  }
+
+  srand( Seed );
+  Check_Arrivals( &Times, &Paths, Rate, Seconds );
+
+  printf( "%.0f requests/s for %u s, %zu requests\n", Rate, Seconds, Times.size() );
+
+  Check_Run( FALSE, Times, Paths, Seconds );
+
+  return Check_Run( TRUE, Times, Paths, Seconds ) ? 0 : 2;
+}
+
+/*===========================================================================*/
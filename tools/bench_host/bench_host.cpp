@@ -0,0 +1,313 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   bench_host.cpp
+@brief  The micro-benchmarks of main/bench.cpp on Linux, every allocation counted
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs the cases of bench.cpp on the host build of tools/host_sim. malloc(),
+calloc(), realloc() and free() are interposed here, over those of glibc, so
+every allocation the firmware makes, through String, new or the C library,
+is counted with its size. Each case is called -n times after a first call,
+timed by the host's monotonic clock, and reported as one JSON line like
+those of the device, with the bytes allocated as well:
+
+{"case":"render_index","fw":"1.0","iters":10000,"ns":..,"allocs_x100":..,"bytes_x100":..,"peak":..,"retained":..}
+
+  ns          host time per call, to compare between runs of one machine
+  allocs_x100 allocations per call x 100, realloc() counted as one
+  bytes_x100  bytes asked for per call x 100
+  peak        heap in use at most during the calls, above that before
+  retained    heap not given back after all the calls
+
+It fails if String(float, 2) allocates nothing, then the interposing
+doesn't work, or if a case that must not allocate does: the filtered log,
+the pages rendered in the request arena, the fixed decimal formatter and
+the sonar filter.
+
+Not built with the sanitizers, they interpose the allocator themselves.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target bench_host
+
+Usage:
+  bench_host [-n iterations] [-v]      -v for the console of the firmware
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "bench.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Cases that must not allocate */
+static const char   *Check_No_Alloc[] =
+{
+  "log_filtered", "render_index", "render_control", "fixed_format", "sonar_filter"
+};
+
+/* The allocator of glibc under the interposed one */
+extern "C" void   *__libc_malloc( size_t Size );
+extern "C" void   *__libc_calloc( size_t Count, size_t Size );
+extern "C" void   *__libc_realloc( void *pOld, size_t Size );
+extern "C" void   __libc_free( void *pMem );
+
+/* What is counted while Heap_Counting */
+typedef struct
+{
+  uint64_t  allocs;
+  uint64_t  bytes;
+  int64_t   in_use;       /* Usable bytes, from the start of the counting */
+  int64_t   peak;
+
+} HEAP_COUNT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static bool               Heap_Counting = false;
+static HEAP_COUNT_RECORD  Heap_Count;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void     Heap_Count_Alloc( void *pMem, size_t Size );
+static void     Heap_Count_Free( void *pMem );
+static uint64_t Bench_Now_ns( void );
+static bool     Bench_Must_Not_Alloc( const char *pName );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Heap_Count_Alloc( void *pMem, size_t Size )
+{
+  if ( !Heap_Counting || (pMem == NULL) )
+  {
+    return;
+  }
+
+  Heap_Count.allocs++;
+  Heap_Count.bytes  += Size;
+  Heap_Count.in_use += malloc_usable_size( pMem );
+  if ( Heap_Count.in_use > Heap_Count.peak )
+  {
+    Heap_Count.peak = Heap_Count.in_use;
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Heap_Count_Free( void *pMem )
+{
+  if ( Heap_Counting && (pMem != NULL) )
+  {
+    Heap_Count.in_use -= malloc_usable_size( pMem );
+  }
+}
+
+/*===========================================================================*/
+
+extern "C" void *
+malloc( size_t Size )
+{
+  void  *pMem = __libc_malloc( Size );
+
+  Heap_Count_Alloc( pMem, Size );
+  return pMem;
+}
+
+/*===========================================================================*/
+
+extern "C" void *
+calloc( size_t Count, size_t Size )
+{
+  void  *pMem = __libc_calloc( Count, Size );
+
+  Heap_Count_Alloc( pMem, Count * Size );
+  return pMem;
+}
+
+/*===========================================================================*/
+
+extern "C" void *
+realloc( void *pOld, size_t Size )
+{
+  size_t  Old_Size = ( Heap_Counting && (pOld != NULL) ) ? malloc_usable_size( pOld ) : 0;
+  void    *pMem    = __libc_realloc( pOld, Size );
+
+  /* Failed, the old block is still there */
+  if ( (pMem == NULL) && (Size != 0) )
+  {
+    return NULL;
+  }
+
+  Heap_Count.in_use -= Old_Size;
+  Heap_Count_Alloc( pMem, Size );
+  return pMem;
+}
+
+/*===========================================================================*/
+
+extern "C" void
+free( void *pMem )
+{
+  Heap_Count_Free( pMem );
+  __libc_free( pMem );
+}
+
+/*===========================================================================*/
+
+static uint64_t
+Bench_Now_ns( void )
+{
+  struct timespec Now;
+
+  clock_gettime( CLOCK_MONOTONIC, &Now );
+  return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+/*===========================================================================*/
+
+static bool
+Bench_Must_Not_Alloc( const char *pName )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < sizeof(Check_No_Alloc)/sizeof(Check_No_Alloc[0]); Index++ )
+  {
+    if ( strcmp( pName, Check_No_Alloc[Index] ) == 0 )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  uint32_t  Iterations = 10000;
+  uint32_t  Count;
+  uint8_t   Index;
+  uint64_t  Start_ns;
+  uint64_t  Ns;
+  const char  *pName;
+  FILE      *pConsole = NULL;
+  int       Opt;
+  bool      Ok = true;
+  bool      Float_Allocs = false;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Iterations = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( strcmp( argv[Opt], "-v" ) == 0 )
+    {
+      pConsole = stdout;
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-n iterations] [-v]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( Iterations == 0 )
+  {
+    fprintf( stderr, "Iterations above 0\n" );
+    return 1;
+  }
+
+  if ( Bench_Get_Case_Count() == 0 )
+  {
+    fprintf( stderr, "bench.cpp built without BENCH_ENABLE\n" );
+    return 1;
+  }
+
+  if ( pConsole == NULL )
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+
+  Bench_Setup();
+
+  for ( Index = 0; Index < Bench_Get_Case_Count(); Index++ )
+  {
+    pName = Bench_Get_Case_Name( Index );
+
+    /* Warm up, the first call may fill caches or grow buffers */
+    Bench_Call_Case( Index );
+
+    memset( &Heap_Count, 0, sizeof(Heap_Count) );
+    Heap_Counting = true;
+    Start_ns      = Bench_Now_ns();
+    for ( Count = 0; Count < Iterations; Count++ )
+    {
+      Bench_Call_Case( Index );
+    }
+    Ns            = Bench_Now_ns() - Start_ns;
+    Heap_Counting = false;
+
+    printf( "{\"case\":\"%s\",\"fw\":\"%s\",\"iters\":%u,\"ns\":%llu,\"allocs_x100\":%llu,"
+            "\"bytes_x100\":%llu,\"peak\":%lld,\"retained\":%lld}\n",
+            pName, SW_REVISION, Iterations, (unsigned long long)(Ns / Iterations),
+            (unsigned long long)(Heap_Count.allocs * 100 / Iterations),
+            (unsigned long long)(Heap_Count.bytes * 100 / Iterations),
+            (long long)Heap_Count.peak, (long long)Heap_Count.in_use );
+
+    if ( strcmp( pName, "float_format" ) == 0 )
+    {
+      Float_Allocs = ( Heap_Count.allocs > 0 );
+    }
+    if ( Bench_Must_Not_Alloc( pName ) && (Heap_Count.allocs > 0) )
+    {
+      fprintf( stderr, "FAIL: %s allocates, %llu times in %u calls\n",
+               pName, (unsigned long long)Heap_Count.allocs, Iterations );
+      Ok = false;
+    }
+  }
+
+  if ( !Float_Allocs )
+  {
+    fprintf( stderr, "FAIL: String(float, 2) counted no allocation, the allocator isn't interposed\n" );
+    Ok = false;
+  }
+
+  fprintf( stderr, "%s\n", Ok ? "PASS" : "FAIL" );
+  return Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
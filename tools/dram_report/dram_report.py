@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+#==============================================================================
+# Copyright Mickey
+#==============================================================================
+"""
+@file   dram_report.py
+@brief  Report the DRAM taken by a firmware build, and compare two builds
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The ESP8266 has 80 KB of DRAM for .data, .rodata and .bss, what is left is
+the heap. This lists the DRAM sections and the largest symbols in them, so
+string literals and tables that should be in flash stand out. With a
+baseline, it prints the change per section and per symbol.
+
+Get the ELF from the Arduino build, e.g.
+  arduino-cli compile -b esp8266:esp8266:nodemcuv2 --export-binaries main
+  -> main/build/esp8266.esp8266.nodemcuv2/main.ino.elf
+
+Usage:
+  dram_report.py [-n top] [-b baseline.elf] [-p tool-prefix] firmware.elf
+
+The toolchain comes with the ESP8266 core, add its bin directory to PATH
+or give the prefix with -p, e.g. -p ~/.arduino15/packages/esp8266/tools/
+xtensa-lx106-elf-gcc/3.1.0-gcc10.3-e5f9fec/bin/xtensa-lx106-elf-
+"""
+
+import argparse
+import subprocess
+import sys
+
+# DRAM address range of the ESP8266
+DRAM_START  = 0x3FFE8000
+DRAM_END    = 0x40000000
+DRAM_SIZE   = 80 * 1024
+
+
+def run(tool, args):
+    """Run a toolchain program and return its output lines"""
+    try:
+        out = subprocess.run([tool] + args, check=True, capture_output=True, text=True).stdout
+    except FileNotFoundError:
+        sys.exit("%s not found, see -p" % tool)
+    except subprocess.CalledProcessError as err:
+        sys.exit(err.stderr.strip())
+    return out.splitlines()
+
+
+def in_dram(addr):
+    return DRAM_START <= addr < DRAM_END
+
+
+def load_sections(prefix, elf):
+    """Allocated sections in DRAM, {name: size}"""
+    sections = {}
+    for line in run(prefix + "readelf", ["-S", "-W", elf]):
+        # [Nr] Name Type Addr Off Size ES Flg Lk Inf Al
+        fields = line.replace("[ ", "[").split()
+        if len(fields) < 8 or not fields[0].startswith("["):
+            continue
+        try:
+            addr = int(fields[3], 16)
+            size = int(fields[5], 16)
+        except ValueError:
+            continue
+        if in_dram(addr) and "A" in fields[7] and size > 0:
+            sections[fields[1]] = size
+    return sections
+
+
+def load_symbols(prefix, elf):
+    """Symbols in DRAM, {name: size}, anonymous string literals only show in the section totals"""
+    symbols = {}
+    for line in run(prefix + "nm", ["-S", "-C", "--size-sort", elf]):
+        fields = line.split(None, 3)
+        if len(fields) < 4:
+            continue
+        addr, size, name = int(fields[0], 16), int(fields[1], 16), fields[3]
+        if in_dram(addr):
+            symbols[name] = symbols.get(name, 0) + size
+    return symbols
+
+
+def report(prefix, elf, top):
+    sections = load_sections(prefix, elf)
+    symbols  = load_symbols(prefix, elf)
+    used     = sum(sections.values())
+
+    print("%s" % elf)
+    for name, size in sorted(sections.items(), key=lambda item: -item[1]):
+        print("  %-24s %7d" % (name, size))
+    print("  %-24s %7d of %d, %d left for heap and stack" % ("total", used, DRAM_SIZE, DRAM_SIZE - used))
+
+    print("\nLargest symbols in DRAM:")
+    for name, size in sorted(symbols.items(), key=lambda item: -item[1])[:top]:
+        print("  %7d  %s" % (size, name))
+
+    return sections, symbols
+
+
+def compare(old, new, top):
+    """Print the change from the baseline, negative is DRAM freed"""
+    old_sections, old_symbols = old
+    new_sections, new_symbols = new
+
+    print("\nChange from baseline:")
+    for name in sorted(set(old_sections) | set(new_sections)):
+        delta = new_sections.get(name, 0) - old_sections.get(name, 0)
+        if delta != 0:
+            print("  %-24s %+7d" % (name, delta))
+    print("  %-24s %+7d" % ("total", sum(new_sections.values()) - sum(old_sections.values())))
+
+    deltas = []
+    for name in set(old_symbols) | set(new_symbols):
+        delta = new_symbols.get(name, 0) - old_symbols.get(name, 0)
+        if delta != 0:
+            deltas.append((delta, name))
+
+    print("\nLargest symbol changes:")
+    for delta, name in sorted(deltas, key=lambda item: -abs(item[0]))[:top]:
+        print("  %+7d  %s" % (delta, name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="DRAM usage of an ESP8266 firmware ELF")
+    parser.add_argument("elf")
+    parser.add_argument("-n", "--top", type=int, default=20, help="symbols to list")
+    parser.add_argument("-b", "--baseline", help="ELF of the build to compare with")
+    parser.add_argument("-p", "--prefix", default="xtensa-lx106-elf-", help="toolchain prefix")
+    args = parser.parse_args()
+
+    new = report(args.prefix, args.elf, args.top)
+    if args.baseline:
+        print()
+        old = report(args.prefix, args.baseline, 0)
+        compare(old, new, args.top)
+
+
+if __name__ == "__main__":
+    main()
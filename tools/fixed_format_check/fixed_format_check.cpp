@@ -0,0 +1,224 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   fixed_format_check.cpp
+@brief  Check Fixed_Format() against snprintf() and compare their speed
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Formats every float in a range with main/fixed_format.cpp and with
+snprintf( "%.*f" ), reports the first mismatches and the time each took.
+The default range covers the sonar distances and the timing hours, both
+signs, with the decimals the firmware publishes.
+
+Build, from this directory:
+  g++ -O2 -I../../main -o fixed_format_check fixed_format_check.cpp ../../main/fixed_format.cpp
+
+Usage:
+  fixed_format_check [-d decimals] [-r min max]
+
+  -d  Decimals to check, default 1 and 2
+  -r  Range of the absolute value, default 0 to 600
+
+Every float in the range is checked, 0 to 600 is about 1.1 billion of them
+per sign and decimal count, the default run takes about half an hour.
+Use -r for a quick check of a smaller range.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "fixed_format.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define CHECK_MISMATCH_MAX    10
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/* Keeps the formatting from being optimised away */
+static volatile UINT32 Check_Sink = 0;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static DOUBLE Check_Now_s( void );
+static uint32_t Check_Float_Bits( FLOAT Value );
+static FLOAT  Check_Bits_Float( uint32_t Bits );
+static UINT64 Check_Range( FLOAT Min, FLOAT Max, UINT8 Decimals, BOOL Negative );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static DOUBLE
+Check_Now_s( void )
+{
+  struct timespec Now;
+
+  clock_gettime( CLOCK_MONOTONIC, &Now );
+  return Now.tv_sec + Now.tv_nsec / 1e9;
+}
+
+/*===========================================================================*/
+
+static uint32_t
+Check_Float_Bits( FLOAT Value )
+{
+  uint32_t  Bits;
+
+  memcpy( &Bits, &Value, sizeof(Bits) );
+  return Bits;
+}
+
+/*===========================================================================*/
+
+static FLOAT
+Check_Bits_Float( uint32_t Bits )
+{
+  FLOAT   Value;
+
+  memcpy( &Value, &Bits, sizeof(Value) );
+  return Value;
+}
+
+/*===========================================================================*/
+
+/* Every float in [Min, Max], positive floats sort as their bits */
+static UINT64
+Check_Range( FLOAT Min, FLOAT Max, UINT8 Decimals, BOOL Negative )
+{
+  CHAR    Expect[FIXED_FORMAT_MAX_SIZE];
+  CHAR    Result[FIXED_FORMAT_MAX_SIZE];
+  uint32_t  First = Check_Float_Bits( Min );
+  uint32_t  Last  = Check_Float_Bits( Max );
+  uint32_t  Bits;
+  UINT64  Mismatches = 0;
+  FLOAT   Value;
+  DOUBLE  Start_s;
+  DOUBLE  Fixed_s;
+  DOUBLE  Printf_s;
+
+  /* Correctness */
+  for ( Bits = First; Bits <= Last; Bits++ )
+  {
+    Value = Check_Bits_Float( Bits );
+    Value = Negative ? -Value : Value;
+
+    snprintf( Expect, sizeof(Expect), "%.*f", (int)Decimals, Value );
+    Fixed_Format( Result, sizeof(Result), Value, Decimals );
+
+    if ( strcmp( Expect, Result ) != 0 )
+    {
+      if ( Mismatches < CHECK_MISMATCH_MAX )
+      {
+        printf( "  mismatch %.9g (0x%08lx): expect %s, got %s\n", Value, (UINT32)Bits, Expect, Result );
+      }
+      Mismatches++;
+    }
+
+    if ( Bits == 0xFFFFFFFF )
+    {
+      break;
+    }
+  }
+
+  /* Speed, a sample of the range so both see the same numbers */
+  Start_s = Check_Now_s();
+  for ( Bits = First; Bits <= Last; Bits += 97 )
+  {
+    Check_Sink += Fixed_Format( Result, sizeof(Result), Check_Bits_Float( Bits ), Decimals );
+  }
+  Fixed_s = Check_Now_s() - Start_s;
+
+  Start_s = Check_Now_s();
+  for ( Bits = First; Bits <= Last; Bits += 97 )
+  {
+    Check_Sink += snprintf( Result, sizeof(Result), "%.*f", (int)Decimals, Check_Bits_Float( Bits ) );
+  }
+  Printf_s = Check_Now_s() - Start_s;
+
+  printf( "%c[%g, %g] %%.%uf: %lu floats, %llu mismatches, fixed %.1f ns, snprintf %.1f ns\n",
+          Negative ? '-' : '+', Min, Max, Decimals, (UINT32)(Last - First + 1), Mismatches,
+          Fixed_s * 1e9 / ((Last - First) / 97 + 1), Printf_s * 1e9 / ((Last - First) / 97 + 1) );
+
+  return Mismatches;
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  FLOAT   Min = 0;
+  FLOAT   Max = 600;
+  INT32   Decimals = -1;
+  UINT64  Mismatches = 0;
+  INT32   Opt;
+  UINT8   Count;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-d" ) == 0) && (Opt + 1 < argc) )
+    {
+      Decimals = atoi( argv[++Opt] );
+    }
+    else if ( (strcmp( argv[Opt], "-r" ) == 0) && (Opt + 2 < argc) )
+    {
+      Min = atof( argv[++Opt] );
+      Max = atof( argv[++Opt] );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-d decimals] [-r min max]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( (Min < 0) || (Max < Min) )
+  {
+    fprintf( stderr, "The range is of the absolute value, 0 <= min <= max\n" );
+    return 1;
+  }
+
+  for ( Count = 1; Count <= 2; Count++ )
+  {
+    if ( (Decimals >= 0) && (Decimals != Count) )
+    {
+      continue;
+    }
+    Mismatches += Check_Range( Min, Max, Count, FALSE );
+    Mismatches += Check_Range( Min, Max, Count, TRUE );
+  }
+
+  if ( (Decimals > 2) || (Decimals == 0) )
+  {
+    Mismatches += Check_Range( Min, Max, Decimals, FALSE );
+    Mismatches += Check_Range( Min, Max, Decimals, TRUE );
+  }
+
+  return ( Mismatches == 0 ) ? 0 : 2;
+}
+
+/*===========================================================================*/
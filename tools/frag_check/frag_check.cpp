@@ -0,0 +1,695 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   frag_check.cpp
+@brief  Heap fragmentation after a million requests, String handlers vs the arena
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+malloc(), calloc(), realloc() and free() are interposed, while a request is
+handled they work on a heap of CHECK_HEAP_SIZE bytes kept like umm_malloc
+keeps the ESP8266's: 8 byte blocks, a 4 byte header, best fit, freed
+blocks merged with their neighbours, realloc() in place when it can.
+
+The same requests are handled twice, from one seed:
+
+  String  as the handlers were before the request arena, the index page a
+          String with a replace() per key, the scan list a String grown by
+          +=, and the publish burst a String topic from F() and a
+          String(float, 2) payload per value
+  Arena   as they are, the page from http_render_index() and the scan
+          list in Request_Arena, the payloads by Fixed_Format() on the
+          stack and the topics given to mqtt_publish() from flash
+
+Each request also takes a receive buffer for its length, and now and then
+something that stays for up to CHECK_KEEP_MAX requests, a message or a
+connection, in the middle of the handling, as the network stack does.
+Those are the same for both. Fragmentation is as ESP.getHeapFragmentation()
+has it, 100 - 100 * sqrt(sum of the free blocks squared) / free.
+
+The fragmentation the arena handlers leave is that of what stays, their
+own allocations are none. It fails if they allocate at all or if an
+allocation fails with them. How far the two runs differ is printed, the
+worst of it varies with the seed as what stays lands elsewhere.
+
+Not built with the sanitizers, they interpose the allocator themselves.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target frag_check
+
+Usage:
+  frag_check [-n requests] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "arena.h"
+#include "fixed_format.h"
+#include "http_server.h"
+#include "mqtt_client.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Free heap of a device connected to Wi-Fi and the broker */
+#define CHECK_HEAP_SIZE       20000
+
+#define HEAP_BLOCK_SIZE       8
+#define HEAP_HEADER_SIZE      4
+#define HEAP_BLOCKS           (CHECK_HEAP_SIZE / HEAP_BLOCK_SIZE)
+
+/* What stays across requests, at most this many at once, for at most this
+   many requests */
+#define CHECK_KEEP_SLOTS      16
+#define CHECK_KEEP_MAX        200
+
+/* Networks in the scan list, values in the publish burst */
+#define CHECK_SCAN_COUNT      8
+#define CHECK_PUBLISH_COUNT   10
+
+/* The glibc allocator, outside the requests */
+extern "C" void   *__libc_malloc( size_t Size );
+extern "C" void   *__libc_calloc( size_t Count, size_t Size );
+extern "C" void   *__libc_realloc( void *pOld, size_t Size );
+extern "C" void   __libc_free( void *pMem );
+
+/* A run of blocks, used or free, in address order */
+typedef struct
+{
+  uint16_t  next;
+  uint16_t  prev;
+  bool      free;
+
+} HEAP_CHUNK_RECORD;
+
+typedef struct
+{
+  void      *pMem;
+  uint32_t  until;          /* Request it is freed at */
+
+} CHECK_KEEP_RECORD;
+
+typedef struct
+{
+  const char  *pName;
+  uint64_t    handler_allocs;
+  uint64_t    failures;
+  uint32_t    frag;         /* At the end, % */
+  uint32_t    worst_frag;
+  uint32_t    min_largest;  /* Largest free block, the least seen */
+  uint32_t    free_bytes;
+
+} CHECK_RESULT_RECORD;
+
+typedef void (*CHECK_HANDLER_FUNC)( uint32_t Request );
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static uint8_t            Heap_Mem[HEAP_BLOCKS * HEAP_BLOCK_SIZE];
+static HEAP_CHUNK_RECORD  Heap_Chunk[HEAP_BLOCKS + 1];
+
+/* The heap model takes the allocations while set */
+static bool               Heap_Active   = false;
+static bool               Heap_Handling = false;
+static uint64_t           Heap_Handler_Allocs;
+static uint64_t           Heap_Failures;
+
+static CHECK_KEEP_RECORD  Check_Keep[CHECK_KEEP_SLOTS];
+static uint32_t           Check_Seed;
+
+/* Stands in for the page template of the String handler */
+static String             Check_Template;
+
+static const char         *Check_Keys[] =
+{
+  "{{ localtime_str }}", "{{ wifi_status }}", "{{ current_ip }}", "{{ internet_status }}",
+  "{{ current_ssid }}", "{{ wdt_status }}", "{{ raw_distance }}"
+};
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void     Heap_Init( void );
+static bool     Heap_Owns( void *pMem );
+static size_t   Heap_Usable( void *pMem );
+static void     *Heap_Alloc( size_t Size );
+static void     Heap_Free( void *pMem );
+static void     *Heap_Realloc( void *pOld, size_t Size );
+static void     Heap_Split( uint16_t Chunk, uint16_t Blocks );
+static uint16_t Heap_Merge( uint16_t Chunk );
+static void     Heap_Stats( uint32_t *pFree, uint32_t *pLargest, uint32_t *pFrag );
+static uint32_t Check_Random( uint32_t Range );
+static void     Check_Keep_Something( uint32_t Request );
+static void     Check_Handle_String( uint32_t Request );
+static void     Check_Handle_Arena( uint32_t Request );
+static void     Check_Run( CHECK_HANDLER_FUNC Handler, uint32_t Requests, uint32_t Seed,
+                           CHECK_RESULT_RECORD *pResult );
+static void     Check_Print( const CHECK_RESULT_RECORD *pResult, uint32_t Requests );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Heap_Init( void )
+{
+  Heap_Chunk[0].next            = HEAP_BLOCKS;
+  Heap_Chunk[0].prev            = 0;
+  Heap_Chunk[0].free            = true;
+  Heap_Chunk[HEAP_BLOCKS].next  = HEAP_BLOCKS;
+  Heap_Chunk[HEAP_BLOCKS].prev  = 0;
+  Heap_Chunk[HEAP_BLOCKS].free  = false;
+}
+
+/*===========================================================================*/
+
+static bool
+Heap_Owns( void *pMem )
+{
+  return ( (uint8_t *)pMem >= Heap_Mem ) && ( (uint8_t *)pMem < &Heap_Mem[sizeof(Heap_Mem)] );
+}
+
+/*===========================================================================*/
+
+static size_t
+Heap_Usable( void *pMem )
+{
+  uint16_t  Chunk = (uint16_t)(((uint8_t *)pMem - Heap_Mem) / HEAP_BLOCK_SIZE);
+
+  return (Heap_Chunk[Chunk].next - Chunk) * HEAP_BLOCK_SIZE - HEAP_HEADER_SIZE;
+}
+
+/*===========================================================================*/
+
+/* Leave Blocks in Chunk, the rest a free chunk of its own */
+static void
+Heap_Split( uint16_t Chunk, uint16_t Blocks )
+{
+  uint16_t  Rest = Chunk + Blocks;
+  uint16_t  Next = Heap_Chunk[Chunk].next;
+
+  if ( Rest >= Next )
+  {
+    return;
+  }
+
+  Heap_Chunk[Rest].next   = Next;
+  Heap_Chunk[Rest].prev   = Chunk;
+  Heap_Chunk[Rest].free   = true;
+  Heap_Chunk[Next].prev   = Rest;
+  Heap_Chunk[Chunk].next  = Rest;
+
+  Heap_Merge( Rest );
+}
+
+/*===========================================================================*/
+
+/* Merge a free chunk with free neighbours, the chunk it ends up in */
+static uint16_t
+Heap_Merge( uint16_t Chunk )
+{
+  uint16_t  Next = Heap_Chunk[Chunk].next;
+  uint16_t  Prev = Heap_Chunk[Chunk].prev;
+
+  if ( (Next < HEAP_BLOCKS) && Heap_Chunk[Next].free )
+  {
+    Heap_Chunk[Chunk].next                  = Heap_Chunk[Next].next;
+    Heap_Chunk[Heap_Chunk[Next].next].prev  = Chunk;
+  }
+
+  if ( (Chunk != 0) && Heap_Chunk[Prev].free )
+  {
+    Heap_Chunk[Prev].next                         = Heap_Chunk[Chunk].next;
+    Heap_Chunk[Heap_Chunk[Chunk].next].prev       = Prev;
+    Chunk = Prev;
+  }
+
+  return Chunk;
+}
+
+/*===========================================================================*/
+
+static void *
+Heap_Alloc( size_t Size )
+{
+  size_t    Blocks = (Size + HEAP_HEADER_SIZE + HEAP_BLOCK_SIZE - 1) / HEAP_BLOCK_SIZE;
+  uint16_t  Chunk;
+  uint16_t  Best   = HEAP_BLOCKS;
+  uint16_t  Length;
+  uint16_t  Best_Length = 0;
+
+  if ( Heap_Handling )
+  {
+    Heap_Handler_Allocs++;
+  }
+
+  for ( Chunk = 0; Chunk < HEAP_BLOCKS; Chunk = Heap_Chunk[Chunk].next )
+  {
+    Length = Heap_Chunk[Chunk].next - Chunk;
+    if ( Heap_Chunk[Chunk].free && (Length >= Blocks) && ((Best == HEAP_BLOCKS) || (Length < Best_Length)) )
+    {
+      Best        = Chunk;
+      Best_Length = Length;
+    }
+  }
+
+  if ( Best == HEAP_BLOCKS )
+  {
+    Heap_Failures++;
+    return NULL;
+  }
+
+  Heap_Chunk[Best].free = false;
+  Heap_Split( Best, (uint16_t)Blocks );
+
+  return &Heap_Mem[Best * HEAP_BLOCK_SIZE];
+}
+
+/*===========================================================================*/
+
+static void
+Heap_Free( void *pMem )
+{
+  uint16_t  Chunk = (uint16_t)(((uint8_t *)pMem - Heap_Mem) / HEAP_BLOCK_SIZE);
+
+  Heap_Chunk[Chunk].free = true;
+  Heap_Merge( Chunk );
+}
+
+/*===========================================================================*/
+
+/* In place if it shrinks or the next chunk is free and large enough */
+static void *
+Heap_Realloc( void *pOld, size_t Size )
+{
+  uint16_t  Chunk  = (uint16_t)(((uint8_t *)pOld - Heap_Mem) / HEAP_BLOCK_SIZE);
+  uint16_t  Next   = Heap_Chunk[Chunk].next;
+  size_t    Blocks = (Size + HEAP_HEADER_SIZE + HEAP_BLOCK_SIZE - 1) / HEAP_BLOCK_SIZE;
+  size_t    Length = Next - Chunk;
+  void      *pNew;
+
+  if ( Heap_Handling )
+  {
+    Heap_Handler_Allocs++;
+  }
+
+  if ( (Blocks > Length) && (Next < HEAP_BLOCKS) && Heap_Chunk[Next].free &&
+       (Heap_Chunk[Next].next - Chunk >= Blocks) )
+  {
+    Heap_Chunk[Chunk].next                  = Heap_Chunk[Next].next;
+    Heap_Chunk[Heap_Chunk[Next].next].prev  = Chunk;
+    Length = Heap_Chunk[Chunk].next - Chunk;
+  }
+
+  if ( Blocks <= Length )
+  {
+    Heap_Split( Chunk, (uint16_t)Blocks );
+    return pOld;
+  }
+
+  pNew = Heap_Alloc( Size );
+  if ( Heap_Handling )
+  {
+    Heap_Handler_Allocs--;
+  }
+  if ( pNew != NULL )
+  {
+    memcpy( pNew, pOld, min( Size, Heap_Usable( pOld ) ) );
+    Heap_Free( pOld );
+  }
+
+  return pNew;
+}
+
+/*===========================================================================*/
+
+static void
+Heap_Stats( uint32_t *pFree, uint32_t *pLargest, uint32_t *pFrag )
+{
+  uint16_t  Chunk;
+  uint32_t  Bytes;
+  uint32_t  Free    = 0;
+  uint32_t  Largest = 0;
+  double    Squares = 0;
+
+  for ( Chunk = 0; Chunk < HEAP_BLOCKS; Chunk = Heap_Chunk[Chunk].next )
+  {
+    if ( Heap_Chunk[Chunk].free )
+    {
+      Bytes    = (Heap_Chunk[Chunk].next - Chunk) * HEAP_BLOCK_SIZE;
+      Free    += Bytes;
+      Squares += (double)Bytes * Bytes;
+      Largest  = max( Largest, Bytes );
+    }
+  }
+
+  *pFree    = Free;
+  *pLargest = Largest;
+  *pFrag    = ( Free > 0 ) ? (uint32_t)(100 - sqrt( Squares ) * 100 / Free) : 100;
+}
+
+/*===========================================================================*/
+
+extern "C" void *
+malloc( size_t Size )
+{
+  void  *pMem;
+
+  if ( !Heap_Active )
+  {
+    return __libc_malloc( Size );
+  }
+
+  /* Failed on the device, the run goes on from the host's heap */
+  pMem = Heap_Alloc( Size );
+  return ( pMem != NULL ) ? pMem : __libc_malloc( Size );
+}
+
+/*===========================================================================*/
+
+extern "C" void *
+calloc( size_t Count, size_t Size )
+{
+  void  *pMem;
+
+  if ( !Heap_Active )
+  {
+    return __libc_calloc( Count, Size );
+  }
+
+  pMem = malloc( Count * Size );
+  if ( pMem != NULL )
+  {
+    memset( pMem, 0, Count * Size );
+  }
+  return pMem;
+}
+
+/*===========================================================================*/
+
+extern "C" void *
+realloc( void *pOld, size_t Size )
+{
+  void  *pNew;
+
+  if ( (pOld == NULL) || !Heap_Owns( pOld ) )
+  {
+    return ( pOld == NULL ) ? malloc( Size ) : __libc_realloc( pOld, Size );
+  }
+  if ( Size == 0 )
+  {
+    Heap_Free( pOld );
+    return NULL;
+  }
+
+  pNew = Heap_Realloc( pOld, Size );
+  if ( pNew == NULL )
+  {
+    pNew = __libc_malloc( Size );
+    memcpy( pNew, pOld, min( Size, Heap_Usable( pOld ) ) );
+    Heap_Free( pOld );
+  }
+  return pNew;
+}
+
+/*===========================================================================*/
+
+extern "C" void
+free( void *pMem )
+{
+  if ( Heap_Owns( pMem ) )
+  {
+    Heap_Free( pMem );
+  }
+  else
+  {
+    __libc_free( pMem );
+  }
+}
+
+/*===========================================================================*/
+
+static uint32_t
+Check_Random( uint32_t Range )
+{
+  Check_Seed = Check_Seed * 1103515245 + 12345;
+  return (Check_Seed >> 8) % Range;
+}
+
+/*===========================================================================*/
+
+/* A message or a connection that stays, now and then */
+static void
+Check_Keep_Something( uint32_t Request )
+{
+  uint32_t  Index;
+  bool      Handling = Heap_Handling;
+
+  if ( Check_Random( 4 ) != 0 )
+  {
+    return;
+  }
+
+  Heap_Handling = false;
+  for ( Index = 0; Index < CHECK_KEEP_SLOTS; Index++ )
+  {
+    if ( Check_Keep[Index].pMem == NULL )
+    {
+      Check_Keep[Index].pMem  = malloc( 64 + Check_Random( 960 ) );
+      Check_Keep[Index].until = Request + 1 + Check_Random( CHECK_KEEP_MAX );
+      break;
+    }
+  }
+  Heap_Handling = Handling;
+}
+
+/*===========================================================================*/
+
+/* The handlers before the request arena */
+static void
+Check_Handle_String( uint32_t Request )
+{
+  String    Page = Check_Template;
+  String    List;
+  uint32_t  Index;
+
+  Check_Keep_Something( Request );
+
+  for ( Index = 0; Index < sizeof(Check_Keys)/sizeof(Check_Keys[0]); Index++ )
+  {
+    Page.replace( String( Check_Keys[Index] ), String( 12.5f + Index, 2 ) );
+  }
+
+  for ( Index = 0; Index < CHECK_SCAN_COUNT; Index++ )
+  {
+    List += String( "<option value=\"" ) + "network" + String( Index ) + "\">" + "network" + String( Index ) + "</option>\n";
+  }
+
+  for ( Index = 0; Index < CHECK_PUBLISH_COUNT; Index++ )
+  {
+    String  Topic( F("avg_distance") );
+    String  Payload( 123.4f + Index, 2 );
+
+    (void)Topic;
+    (void)Payload;
+  }
+}
+
+/*===========================================================================*/
+
+/* The handlers as they are */
+static void
+Check_Handle_Arena( uint32_t Request )
+{
+  STR_BUILDER_RECORD  Page;
+  STR_BUILDER_RECORD  List;
+  MY_STATUS_RECORD    Status;
+  CHAR                Payload[FIXED_FORMAT_MAX_SIZE];
+  UINT16              Mark = Arena_Mark( &Request_Arena );
+  uint32_t            Index;
+
+  My_Status_Read( &Status );
+  Str_Builder_Init( &Page, &Request_Arena, 1024 );
+  http_render_index( &Page, &Status );
+
+  Check_Keep_Something( Request );
+
+  Str_Builder_Init( &List, &Request_Arena, 256 );
+  for ( Index = 0; Index < CHECK_SCAN_COUNT; Index++ )
+  {
+    Str_Builder_Printf( &List, PSTR("<option value=\"network%u\">network%u</option>\n"), Index, Index );
+  }
+
+  for ( Index = 0; Index < CHECK_PUBLISH_COUNT; Index++ )
+  {
+    Fixed_Format( Payload, sizeof(Payload), 123.4f + Index, 2 );
+    mqtt_publish( PSTR("avg_distance"), Payload );
+  }
+
+  Arena_Release( &Request_Arena, Mark );
+}
+
+/*===========================================================================*/
+
+static void
+Check_Run( CHECK_HANDLER_FUNC Handler, uint32_t Requests, uint32_t Seed, CHECK_RESULT_RECORD *pResult )
+{
+  uint32_t  Request;
+  uint32_t  Index;
+  uint32_t  Free;
+  uint32_t  Largest;
+  uint32_t  Frag;
+  void      *pReceive;
+
+  Heap_Init();
+  memset( Check_Keep, 0, sizeof(Check_Keep) );
+  Check_Seed          = Seed;
+  Heap_Handler_Allocs = 0;
+  Heap_Failures       = 0;
+  pResult->worst_frag   = 0;
+  pResult->min_largest  = CHECK_HEAP_SIZE;
+
+  for ( Request = 0; Request < Requests; Request++ )
+  {
+    Heap_Active = true;
+
+    for ( Index = 0; Index < CHECK_KEEP_SLOTS; Index++ )
+    {
+      if ( (Check_Keep[Index].pMem != NULL) && (Check_Keep[Index].until <= Request) )
+      {
+        free( Check_Keep[Index].pMem );
+        Check_Keep[Index].pMem = NULL;
+      }
+    }
+
+    pReceive      = malloc( 128 + Check_Random( 1332 ) );
+    Heap_Handling = true;
+    Handler( Request );
+    Heap_Handling = false;
+    free( pReceive );
+
+    Heap_Active = false;
+
+    Heap_Stats( &Free, &Largest, &Frag );
+    pResult->worst_frag  = max( pResult->worst_frag, Frag );
+    pResult->min_largest = min( pResult->min_largest, Largest );
+  }
+
+  Heap_Stats( &pResult->free_bytes, &Largest, &pResult->frag );
+  pResult->handler_allocs = Heap_Handler_Allocs;
+  pResult->failures       = Heap_Failures;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Print( const CHECK_RESULT_RECORD *pResult, uint32_t Requests )
+{
+  printf( "%-7s %lu handler allocations (%.1f a request), %lu failed\n",
+          pResult->pName, (unsigned long)pResult->handler_allocs,
+          (double)pResult->handler_allocs / Requests, (unsigned long)pResult->failures );
+  printf( "        fragmentation %u %% at the end, %u %% at worst, free %u B, largest block %u B at least\n",
+          pResult->frag, pResult->worst_frag, pResult->free_bytes, pResult->min_largest );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  CHECK_RESULT_RECORD Old;
+  CHECK_RESULT_RECORD New;
+  STR_BUILDER_RECORD  Page;
+  MY_STATUS_RECORD    Status;
+  UINT16    Mark;
+  uint32_t  Requests = 1000000;
+  uint32_t  Seed     = 1;
+  uint32_t  Index;
+  int       Opt;
+  bool      Ok = true;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Requests = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-n requests] [-s seed]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( Requests == 0 )
+  {
+    fprintf( stderr, "Requests above 0\n" );
+    return 1;
+  }
+
+  Sim_Serial_Set_Output( fopen( "/dev/null", "w" ) );
+
+  /* The rendered page and the keys, about the template of the old handler */
+  Mark = Arena_Mark( &Request_Arena );
+  My_Status_Read( &Status );
+  Str_Builder_Init( &Page, &Request_Arena, 1024 );
+  http_render_index( &Page, &Status );
+  Check_Template = Page.pBuff;
+  for ( Index = 0; Index < sizeof(Check_Keys)/sizeof(Check_Keys[0]); Index++ )
+  {
+    Check_Template += Check_Keys[Index];
+  }
+  Arena_Release( &Request_Arena, Mark );
+
+  printf( "%u requests, a heap of %u bytes, seed %u\n", Requests, CHECK_HEAP_SIZE, Seed );
+
+  Old.pName = "String";
+  Check_Run( Check_Handle_String, Requests, Seed, &Old );
+  Check_Print( &Old, Requests );
+
+  New.pName = "Arena";
+  Check_Run( Check_Handle_Arena, Requests, Seed, &New );
+  Check_Print( &New, Requests );
+
+  if ( New.handler_allocs != 0 )
+  {
+    printf( "FAIL: the arena handlers allocated from the heap\n" );
+    Ok = false;
+  }
+  if ( New.failures != 0 )
+  {
+    printf( "FAIL: allocations failed with the arena handlers\n" );
+    Ok = false;
+  }
+
+  printf( "%s\n", Ok ? "PASS" : "FAIL" );
+  return Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,488 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   history_bench.cpp
+@brief  Compression and query speed of main/history_block.cpp on synthetic levels
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Makes weeks of minute samples as history.cpp takes them and stores them in
+blocks, checks they all decode to what went in, also after going on from a
+block as from the RTC memory, and prints the size they take and how fast
+they encode, decode and answer queries.
+
+The curves:
+
+  tank    The level of a tank that drains through the day and the relay
+          fills from low to high, a few mm of noise, a reading in 200 not
+          valid, the RSSI wandering, now and then a second late and an
+          hour away a week
+  steady  A level that stays, the odd mm of noise, a link that stays
+  noisy   Random distances, relay and RSSI each minute, the worst case
+
+The raw size is 8 bytes a sample: the timestamp, the distance, the RSSI
+and the relay. The times are of the host, on the ESP8266 they are many
+times longer and the blocks come from flash, the blocks read tell how
+much of that a query takes.
+
+Build, from this directory:
+  g++ -O2 -I../../main -o history_bench history_bench.cpp ../../main/history_block.cpp
+
+Usage:
+  history_bench [-w weeks] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "history_block.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define BENCH_RAW_SAMPLE_SIZE     8
+
+/* 2026-10-01 00:00 UTC */
+#define BENCH_START_TS            1790812800UL
+
+#define BENCH_DAY_S               86400UL
+
+typedef enum
+{
+  BENCH_TANK = 0,
+  BENCH_STEADY,
+  BENCH_NOISY,
+  NUM_BENCH_CURVES
+
+} BENCH_CURVE;
+
+/* The blocks as history.cpp reads them from its files */
+typedef struct
+{
+  const std::vector<HISTORY_BLOCK_RECORD> *pBlocks;
+  uint32_t  from;
+  size_t    next;
+  uint32_t  read;             /* Blocks and headers */
+
+} BENCH_SOURCE_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static const char *Bench_Curve_Names[NUM_BENCH_CURVES] = { "tank", "steady", "noisy" };
+
+/* Keeps the decoding from being optimised away */
+static volatile uint32_t Bench_Sink;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static double Bench_Now_s( void );
+static void   Bench_Make( BENCH_CURVE Curve, uint32_t Weeks, std::vector<HISTORY_SAMPLE_RECORD> *pSamples );
+static void   Bench_Store( const std::vector<HISTORY_SAMPLE_RECORD> &Samples,
+                           std::vector<HISTORY_BLOCK_RECORD> *pBlocks, size_t Resume_At );
+static BOOL   Bench_Verify( const std::vector<HISTORY_SAMPLE_RECORD> &Samples,
+                            const std::vector<HISTORY_BLOCK_RECORD> &Blocks );
+static BOOL   Bench_Next_Block( void *pContext, HISTORY_BLOCK_RECORD *pBlock );
+static BOOL   Bench_Query( const std::vector<HISTORY_SAMPLE_RECORD> &Samples,
+                           const std::vector<HISTORY_BLOCK_RECORD> &Blocks,
+                           const char *pName, uint32_t From, uint32_t To, uint32_t Step );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static double
+Bench_Now_s( void )
+{
+  struct timespec Now;
+
+  clock_gettime( CLOCK_MONOTONIC, &Now );
+
+  return Now.tv_sec + Now.tv_nsec / 1e9;
+}
+
+/*===========================================================================*/
+
+static void
+Bench_Make( BENCH_CURVE Curve, uint32_t Weeks, std::vector<HISTORY_SAMPLE_RECORD> *pSamples )
+{
+  HISTORY_SAMPLE_RECORD Sample;
+  uint32_t  Count     = Weeks * 7 * 1440;
+  uint32_t  Ts        = BENCH_START_TS;
+  uint32_t  Index;
+  double    Level_mm  = 900;
+  double    Drain;
+  int       Rssi      = -67;
+  BOOL      Relay     = FALSE;
+
+  pSamples->clear();
+
+  for ( Index = 0; Index < Count; Index++ )
+  {
+    memset( &Sample, 0, sizeof(Sample) );
+
+    switch ( Curve )
+    {
+      case BENCH_TANK:
+
+        /* Late now and then, an hour of reboot or no clock each week */
+        Ts += HISTORY_STEP_S + (((rand() % 20) == 0) ? 1 : 0);
+        if ( (Index % (7 * 1440)) == (3 * 1440) )
+        {
+          Ts += 3600;
+        }
+
+        /* Distance from the sensor down to the water, the tank drains more by day */
+        Drain = ( ((Ts % BENCH_DAY_S) > 6 * 3600) && ((Ts % BENCH_DAY_S) < 22 * 3600) ) ? 1.2 : 0.2;
+        Level_mm += Relay ? -12.0 : Drain;
+        Relay = ( Level_mm > 1500 ) ? TRUE : ( Level_mm < 300 ) ? FALSE : Relay;
+
+        Sample.distance_mm  = ( (rand() % 200) == 0 ) ? 0 : (UINT16)( Level_mm + (rand() % 5) - 2 );
+        Rssi               += ( (rand() % 5) == 0 ) ? (rand() % 3) - 1 : 0;
+        Rssi                = ( Rssi > -50 ) ? -50 : ( Rssi < -90 ) ? -90 : Rssi;
+        Sample.rssi         = ( (rand() % 2000) == 0 ) ? 0 : (INT8)Rssi;
+        Sample.relay        = Relay;
+        break;
+
+      case BENCH_STEADY:
+
+        Ts += HISTORY_STEP_S;
+        Sample.distance_mm  = (UINT16)( 1234 + (((rand() % 50) == 0) ? 1 : 0) );
+        Sample.rssi         = -61;
+        Sample.relay        = FALSE;
+        break;
+
+      case BENCH_NOISY:
+      default:
+
+        Ts += HISTORY_STEP_S;
+        Sample.distance_mm  = (UINT16)( 200 + (rand() % 3800) );
+        Sample.rssi         = (INT8)( -40 - (rand() % 60) );
+        Sample.relay        = ( rand() % 2 ) == 1;
+        break;
+    }
+
+    Sample.ts = Ts;
+    pSamples->push_back( Sample );
+  }
+}
+
+/*===========================================================================*/
+
+/* As history.cpp does, the block at Resume_At goes on from a copy of it */
+static void
+Bench_Store( const std::vector<HISTORY_SAMPLE_RECORD> &Samples,
+             std::vector<HISTORY_BLOCK_RECORD> *pBlocks, size_t Resume_At )
+{
+  HISTORY_ENCODER_RECORD  Encoder;
+  HISTORY_BLOCK_RECORD    Block;
+  HISTORY_BLOCK_RECORD    Rtc;
+  size_t                  Index;
+
+  pBlocks->clear();
+  History_Block_Begin( &Encoder, &Block );
+
+  for ( Index = 0; Index < Samples.size(); Index++ )
+  {
+    if ( Index == Resume_At )
+    {
+      Rtc = Block;
+      memset( &Encoder, 0, sizeof(Encoder) );
+      memset( &Block, 0xA5, sizeof(Block) );
+      Block = Rtc;
+      if ( !History_Block_Resume( &Encoder, &Block ) )
+      {
+        printf( "  Resume failed at sample %zu\n", Index );
+        exit( 2 );
+      }
+    }
+
+    if ( !History_Block_Append( &Encoder, &Samples[Index] ) )
+    {
+      pBlocks->push_back( Block );
+      History_Block_Begin( &Encoder, &Block );
+      if ( !History_Block_Append( &Encoder, &Samples[Index] ) )
+      {
+        printf( "  Sample %zu doesn't fit an empty block\n", Index );
+        exit( 2 );
+      }
+    }
+  }
+
+  if ( Block.count > 0 )
+  {
+    pBlocks->push_back( Block );
+  }
+}
+
+/*===========================================================================*/
+
+static BOOL
+Bench_Verify( const std::vector<HISTORY_SAMPLE_RECORD> &Samples,
+              const std::vector<HISTORY_BLOCK_RECORD> &Blocks )
+{
+  HISTORY_DECODER_RECORD  Decoder;
+  HISTORY_SAMPLE_RECORD   Sample;
+  size_t                  Index = 0;
+  size_t                  Block;
+
+  for ( Block = 0; Block < Blocks.size(); Block++ )
+  {
+    if ( !History_Block_Is_Valid( &Blocks[Block] ) )
+    {
+      printf( "  Block %zu is not valid\n", Block );
+      return FALSE;
+    }
+
+    History_Decoder_Init( &Decoder, &Blocks[Block] );
+    while ( History_Decoder_Next( &Decoder, &Sample ) )
+    {
+      if ( (Index >= Samples.size()) || (Sample.ts != Samples[Index].ts) ||
+           (Sample.distance_mm != Samples[Index].distance_mm) || (Sample.rssi != Samples[Index].rssi) ||
+           (Sample.relay != Samples[Index].relay) )
+      {
+        printf( "  Sample %zu differs, block %zu\n", Index, Block );
+        return FALSE;
+      }
+      Index++;
+    }
+    if ( Decoder.index != Blocks[Block].count )
+    {
+      printf( "  Block %zu gave %u of %u samples\n", Block, Decoder.index, Blocks[Block].count );
+      return FALSE;
+    }
+  }
+
+  if ( Index != Samples.size() )
+  {
+    printf( "  %zu of %zu samples decoded\n", Index, Samples.size() );
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+static BOOL
+Bench_Next_Block( void *pContext, HISTORY_BLOCK_RECORD *pBlock )
+{
+  BENCH_SOURCE_RECORD *pSource = (BENCH_SOURCE_RECORD *)pContext;
+  size_t              Last;
+
+  /* A file that ends before the range is skipped by the header of its last block */
+  while ( ((pSource->next % HISTORY_FILE_BLOCKS) == 0) && (pSource->next < pSource->pBlocks->size()) )
+  {
+    Last = pSource->next + HISTORY_FILE_BLOCKS - 1;
+    Last = ( Last >= pSource->pBlocks->size() ) ? pSource->pBlocks->size() - 1 : Last;
+    pSource->read++;
+    if ( (*pSource->pBlocks)[Last].last_ts >= pSource->from )
+    {
+      break;
+    }
+    pSource->next += HISTORY_FILE_BLOCKS;
+  }
+
+  if ( pSource->next >= pSource->pBlocks->size() )
+  {
+    return FALSE;
+  }
+
+  *pBlock = (*pSource->pBlocks)[pSource->next++];
+  pSource->read++;
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Time a query, and check its rows against the samples added up here */
+static BOOL
+Bench_Query( const std::vector<HISTORY_SAMPLE_RECORD> &Samples,
+             const std::vector<HISTORY_BLOCK_RECORD> &Blocks,
+             const char *pName, uint32_t From, uint32_t To, uint32_t Step )
+{
+  HISTORY_QUERY_RECORD  Query;
+  HISTORY_ROW_RECORD    Row;
+  BENCH_SOURCE_RECORD   Source;
+  std::vector<HISTORY_ROW_RECORD> Rows;
+  uint32_t  Repeat = 0;
+  uint32_t  Expected = 0;
+  uint32_t  Start;
+  uint32_t  Last_Start = 0;
+  size_t    Index;
+  double    Begin_s = Bench_Now_s();
+  double    Took_s;
+
+  do
+  {
+    Source.pBlocks  = &Blocks;
+    Source.from     = From;
+    Source.next     = 0;
+    Source.read     = 0;
+    Rows.clear();
+
+    History_Query_Begin( &Query, From, To, Step, Bench_Next_Block, &Source );
+    while ( History_Query_Next( &Query, &Row ) )
+    {
+      Rows.push_back( Row );
+    }
+    Repeat++;
+    Took_s = Bench_Now_s() - Begin_s;
+
+  } while ( Took_s < 0.2 );
+
+  /* The steps with samples, each a row */
+  for ( Index = 0; Index < Samples.size(); Index++ )
+  {
+    if ( (Samples[Index].ts < From) || (Samples[Index].ts > To) )
+    {
+      continue;
+    }
+    Start = From + ((Samples[Index].ts - From) / Step) * Step;
+    if ( (Expected == 0) || (Start != Last_Start) )
+    {
+      if ( (Expected >= Rows.size()) || (Rows[Expected].ts != Start) )
+      {
+        printf( "  %s: row %u should start at %u\n", pName, Expected, Start );
+        return FALSE;
+      }
+      Expected++;
+      Last_Start = Start;
+    }
+  }
+  if ( Expected != Rows.size() )
+  {
+    printf( "  %s: %zu rows, %u steps with samples\n", pName, Rows.size(), Expected );
+    return FALSE;
+  }
+
+  Bench_Sink = Bench_Sink + Rows.size();
+
+  printf( "  %-24s %5zu rows %5u of %4zu blocks read %8.1f us\n",
+          pName, Rows.size(), Source.read, Blocks.size(), 1e6 * Took_s / Repeat );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  std::vector<HISTORY_SAMPLE_RECORD>  Samples;
+  std::vector<HISTORY_BLOCK_RECORD>   Blocks;
+  HISTORY_DECODER_RECORD  Decoder;
+  HISTORY_SAMPLE_RECORD   Sample;
+  uint32_t  Weeks   = 4;
+  uint32_t  Seed    = 1;
+  uint32_t  Curve;
+  uint32_t  Repeat;
+  uint32_t  End;
+  size_t    Index;
+  double    Begin_s;
+  double    Encode_s;
+  double    Decode_s;
+  double    Bytes;
+  INT32     Opt;
+  BOOL      Ok      = TRUE;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-w" ) == 0) && (Opt + 1 < argc) )
+    {
+      Weeks = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-w weeks] [-s seed]\n", argv[0] );
+      return 1;
+    }
+  }
+  Weeks = ( Weeks == 0 ) ? 1 : Weeks;
+
+  printf( "%u weeks of a sample a minute, blocks of %u bytes, %u to a file\n", Weeks, HISTORY_BLOCK_SIZE,
+          HISTORY_FILE_BLOCKS );
+
+  for ( Curve = 0; Curve < NUM_BENCH_CURVES; Curve++ )
+  {
+    srand( Seed );
+    Bench_Make( (BENCH_CURVE)Curve, Weeks, &Samples );
+
+    Begin_s = Bench_Now_s();
+    Bench_Store( Samples, &Blocks, Samples.size() / 3 );
+    Encode_s = Bench_Now_s() - Begin_s;
+
+    Bytes = (double)Blocks.size() * HISTORY_BLOCK_SIZE;
+    printf( "\n%s: %zu samples in %zu blocks, %.0f KB\n", Bench_Curve_Names[Curve], Samples.size(), Blocks.size(),
+            Bytes / 1024 );
+    printf( "  %.2f bytes a sample, %.1f x smaller than raw, %.0f KB a week\n",
+            Bytes / Samples.size(), BENCH_RAW_SAMPLE_SIZE * Samples.size() / Bytes, Bytes / Weeks / 1024 );
+
+    if ( !Bench_Verify( Samples, Blocks ) )
+    {
+      Ok = FALSE;
+      continue;
+    }
+
+    Begin_s = Bench_Now_s();
+    Repeat  = 0;
+    do
+    {
+      for ( Index = 0; Index < Blocks.size(); Index++ )
+      {
+        History_Decoder_Init( &Decoder, &Blocks[Index] );
+        while ( History_Decoder_Next( &Decoder, &Sample ) )
+        {
+          Bench_Sink = Bench_Sink + Sample.distance_mm;
+        }
+      }
+      Repeat++;
+      Decode_s = Bench_Now_s() - Begin_s;
+
+    } while ( Decode_s < 0.2 );
+
+    printf( "  Encode %.0f ns, decode %.0f ns a sample, %.0f ns a block\n",
+            1e9 * Encode_s / Samples.size(), 1e9 * Decode_s / Repeat / Samples.size(),
+            1e9 * Decode_s / Repeat / Blocks.size() );
+
+    End = Samples.back().ts;
+    Ok = Bench_Query( Samples, Blocks, "last hour, 60 s", End - 3600, End, 60 ) && Ok;
+    Ok = Bench_Query( Samples, Blocks, "last day, 60 s", End - BENCH_DAY_S, End, 60 ) && Ok;
+    Ok = Bench_Query( Samples, Blocks, "last day, 1 h", End - BENCH_DAY_S, End, 3600 ) && Ok;
+    Ok = Bench_Query( Samples, Blocks, "a day a week ago, 5 min", End - 8 * BENCH_DAY_S, End - 7 * BENCH_DAY_S,
+                      300 ) && Ok;
+    Ok = Bench_Query( Samples, Blocks, "all, 1 h", Samples.front().ts, End, 3600 ) && Ok;
+  }
+
+  printf( "\n%s\n", Ok ? "All samples decoded as stored" : "FAILED" );
+
+  return Ok ? 0 : 2;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,465 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   broker.cpp
+@brief  Host build, an MQTT broker stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A clock poller: takes the new connections, reads what came and answers
+it, with the packet code of the firmware, main/mqtt_packet.cpp.
+
+  CONNECT       CONNACK accepted, whatever the client id and password
+  SUBSCRIBE     SUBACK granting QoS 0 to each filter, '+' and '#' match
+  PUBLISH       Kept by topic, PUBACK at QoS 1, sent on to the subscribers
+  PUBACK        Kept by packet ID
+  PINGREQ       PINGRESP
+  DISCONNECT    The connection is closed
+
+A malformed packet closes the connection, as a broker does. What the
+runner publishes goes out at QoS 0 to every matching subscription, or at
+QoS 1 with the packet ID it gives.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "broker.h"
+#include "mqtt_packet.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define BROKER_DEVICE_PORT    1883
+#define BROKER_PACKET_MAX     4096
+
+typedef struct
+{
+  int                       fd;
+  std::vector<uint8_t>      rx;
+  std::vector<std::string>  filters;
+
+} BROKER_CLIENT_RECORD;
+
+typedef struct
+{
+  std::string   last;
+  uint32_t      count;
+
+} BROKER_TOPIC_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static int                                        Broker_Fd = -1;
+static std::vector<BROKER_CLIENT_RECORD>          Broker_Clients;
+static std::map<std::string, BROKER_TOPIC_RECORD> Broker_Topics;
+static uint32_t                                   Broker_Connects       = 0;
+static uint32_t                                   Broker_Subscriptions  = 0;
+static std::set<uint16_t>                         Broker_Acked;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Broker_Poll( void );
+static bool   Broker_Read( BROKER_CLIENT_RECORD *pClient );
+static bool   Broker_On_Packet( BROKER_CLIENT_RECORD *pClient, uint8_t *pBuff, UINT32 Len );
+static bool   Broker_Subscribe( BROKER_CLIENT_RECORD *pClient, const MQTT_PACKET_RECORD *pPacket );
+static void   Broker_Send( BROKER_CLIENT_RECORD *pClient, const uint8_t *pBuff, size_t Len );
+static void   Broker_Forward( const char *pTopic, const uint8_t *pPayload, uint16_t Len,
+                              uint8_t Qos, uint16_t Packet_Id );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/*!
+@brief  Listen on loopback for the device port 1883
+@return false if no socket
+*/
+bool
+Sim_Broker_Start( void )
+{
+  if ( Broker_Fd >= 0 )
+  {
+    return true;
+  }
+
+  Broker_Fd = Sim_Net_Listen( 0, false );
+  if ( Broker_Fd < 0 )
+  {
+    return false;
+  }
+
+  Sim_Net_Map( BROKER_DEVICE_PORT, Sim_Net_Local_Port( Broker_Fd ) );
+  Sim_Clock_Add_Poll( Broker_Poll );
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* Close all the connections, as a broker restarting */
+void
+Sim_Broker_Drop( void )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < Broker_Clients.size(); Index++ )
+  {
+    close( Broker_Clients[Index].fd );
+  }
+  Broker_Clients.clear();
+}
+
+/*===========================================================================*/
+
+void
+Sim_Broker_Publish( const char *pTopic, const char *pPayload )
+{
+  Broker_Forward( pTopic, (const uint8_t *)pPayload, strlen( pPayload ), 0, 0 );
+}
+
+/*===========================================================================*/
+
+/* At QoS 1, Sim_Broker_Acked() tells when the device acknowledged it */
+void
+Sim_Broker_Publish_Qos1( const char *pTopic, const char *pPayload, uint16_t Packet_Id )
+{
+  Broker_Acked.erase( Packet_Id );
+  Broker_Forward( pTopic, (const uint8_t *)pPayload, strlen( pPayload ), 1, Packet_Id );
+}
+
+/*===========================================================================*/
+
+bool
+Sim_Broker_Acked( uint16_t Packet_Id )
+{
+  return Broker_Acked.count( Packet_Id ) > 0;
+}
+
+/*===========================================================================*/
+
+/* The last payload published to a topic, NULL if none */
+const char *
+Sim_Broker_Last( const char *pTopic )
+{
+  std::map<std::string, BROKER_TOPIC_RECORD>::iterator  It = Broker_Topics.find( pTopic );
+
+  return ( It == Broker_Topics.end() ) ? NULL : It->second.last.c_str();
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Broker_Count( const char *pTopic )
+{
+  std::map<std::string, BROKER_TOPIC_RECORD>::iterator  It = Broker_Topics.find( pTopic );
+
+  return ( It == Broker_Topics.end() ) ? 0 : It->second.count;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Broker_Connects( void )
+{
+  return Broker_Connects;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Broker_Subscriptions( void )
+{
+  return Broker_Subscriptions;
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  Does a topic filter match a topic, MQTT 3.1.1 section 4.7
+@param  pFilter   With '+' for a level and '#' for the rest, (I)
+@param  pTopic    A topic name, (I)
+*/
+bool
+Sim_Broker_Topic_Match( const char *pFilter, const char *pTopic )
+{
+  while ( *pFilter != 0 )
+  {
+    if ( *pFilter == '#' )
+    {
+      return true;
+    }
+    if ( *pFilter == '+' )
+    {
+      while ( (*pTopic != 0) && (*pTopic != '/') )
+      {
+        pTopic++;
+      }
+      pFilter++;
+      continue;
+    }
+    if ( *pFilter != *pTopic )
+    {
+      /* "a/#" matches "a" as well */
+      return ( *pTopic == 0 ) && ( strcmp( pFilter, "/#" ) == 0 );
+    }
+    pFilter++;
+    pTopic++;
+  }
+
+  return *pTopic == 0;
+}
+
+/*===========================================================================*/
+
+static void
+Broker_Poll( void )
+{
+  BROKER_CLIENT_RECORD  Client;
+  size_t                Index;
+  int                   Fd;
+  int                   On = 1;
+
+  /* No Nagle, what is sent while a segment is unacknowledged would wait
+     for the delayed ACK, in real time, many virtual seconds */
+  while ( (Fd = accept( Broker_Fd, NULL, NULL )) >= 0 )
+  {
+    fcntl( Fd, F_SETFL, fcntl( Fd, F_GETFL ) | O_NONBLOCK );
+    setsockopt( Fd, IPPROTO_TCP, TCP_NODELAY, &On, sizeof(On) );
+    Client.fd = Fd;
+    Broker_Clients.push_back( Client );
+  }
+
+  for ( Index = 0; Index < Broker_Clients.size(); )
+  {
+    if ( Broker_Read( &Broker_Clients[Index] ) )
+    {
+      Index++;
+      continue;
+    }
+    close( Broker_Clients[Index].fd );
+    Broker_Clients.erase( Broker_Clients.begin() + Index );
+  }
+}
+
+/*===========================================================================*/
+
+/* What came, false once the connection is to be closed */
+static bool
+Broker_Read( BROKER_CLIENT_RECORD *pClient )
+{
+  uint8_t   Buff[1024];
+  ssize_t   Got;
+  UINT32    Packet_Len;
+  INT8      Result;
+
+  while ( (Got = recv( pClient->fd, Buff, sizeof(Buff), 0 )) > 0 )
+  {
+    pClient->rx.insert( pClient->rx.end(), Buff, Buff + Got );
+  }
+  if ( (Got == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK)) )
+  {
+    return false;
+  }
+
+  while ( pClient->rx.size() >= 2 )
+  {
+    Result = Mqtt_Decode_Length( pClient->rx.data(), (UINT16)std::min<size_t>( pClient->rx.size(), 0xffff ), &Packet_Len );
+    if ( (Result < 0) || (Packet_Len > BROKER_PACKET_MAX) )
+    {
+      return false;
+    }
+    if ( (Result == 0) || (pClient->rx.size() < Packet_Len) )
+    {
+      break;
+    }
+
+    std::vector<uint8_t>  Packet( pClient->rx.begin(), pClient->rx.begin() + Packet_Len );
+
+    pClient->rx.erase( pClient->rx.begin(), pClient->rx.begin() + Packet_Len );
+    if ( !Broker_On_Packet( pClient, Packet.data(), Packet_Len ) )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/*===========================================================================*/
+
+static bool
+Broker_On_Packet( BROKER_CLIENT_RECORD *pClient, uint8_t *pBuff, UINT32 Len )
+{
+  MQTT_PACKET_RECORD    Packet;
+  BROKER_TOPIC_RECORD   *pTopic;
+  uint8_t               Tx[8];
+
+  if ( !Mqtt_Decode( pBuff, Len, &Packet ) )
+  {
+    return false;
+  }
+
+  switch ( Packet.type )
+  {
+    case MQTT_CONNECT:
+
+      Broker_Connects++;
+      Broker_Send( pClient, Tx, Mqtt_Encode_Ack( Tx, sizeof(Tx), MQTT_CONNACK, 0 ) );
+      break;
+
+    case MQTT_SUBSCRIBE:
+
+      return Broker_Subscribe( pClient, &Packet );
+
+    case MQTT_PUBLISH:
+
+      pTopic = &Broker_Topics[Packet.pTopic];
+      pTopic->last.assign( (const char *)Packet.pPayload, Packet.payload_len );
+      pTopic->count++;
+      if ( ((Packet.flags >> MQTT_PUBLISH_QOS_SHIFT) & 0x03) == 1 )
+      {
+        Broker_Send( pClient, Tx, Mqtt_Encode_Ack( Tx, sizeof(Tx), MQTT_PUBACK, Packet.packet_id ) );
+      }
+      Broker_Forward( Packet.pTopic, Packet.pPayload, Packet.payload_len, 0, 0 );
+      break;
+
+    case MQTT_PUBACK:
+
+      Broker_Acked.insert( Packet.packet_id );
+      break;
+
+    case MQTT_PINGREQ:
+
+      Broker_Send( pClient, Tx, Mqtt_Encode_Empty( Tx, sizeof(Tx), MQTT_PINGRESP ) );
+      break;
+
+    case MQTT_DISCONNECT:
+
+      return false;
+
+    default:
+      break;
+  }
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* The payload is the packet id then the filters, each length, name, QoS */
+static bool
+Broker_Subscribe( BROKER_CLIENT_RECORD *pClient, const MQTT_PACKET_RECORD *pPacket )
+{
+  const uint8_t   *pPos = pPacket->pPayload;
+  const uint8_t   *pEnd = pPacket->pPayload + pPacket->payload_len;
+  uint16_t        Packet_Id;
+  uint16_t        Filter_Len;
+  uint8_t         Tx[64];
+  uint8_t         Codes = 0;
+
+  if ( (pEnd - pPos) < 2 )
+  {
+    return false;
+  }
+  Packet_Id = (pPos[0] << 8) | pPos[1];
+  pPos += 2;
+
+  while ( pPos < pEnd )
+  {
+    if ( (pEnd - pPos) < 2 )
+    {
+      return false;
+    }
+    Filter_Len = (pPos[0] << 8) | pPos[1];
+    if ( (pEnd - pPos) < (2 + Filter_Len + 1) )
+    {
+      return false;
+    }
+    pClient->filters.push_back( std::string( (const char *)pPos + 2, Filter_Len ) );
+    pPos += 2 + Filter_Len + 1;
+    Broker_Subscriptions++;
+    if ( (4 + Codes) < sizeof(Tx) )
+    {
+      Tx[4 + Codes++] = 0;
+    }
+  }
+
+  Tx[0] = MQTT_SUBACK << 4;
+  Tx[1] = 2 + Codes;
+  Tx[2] = Packet_Id >> 8;
+  Tx[3] = Packet_Id & 0xff;
+  Broker_Send( pClient, Tx, 4 + Codes );
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* The device reads it with the next wait, a short send is dropped */
+static void
+Broker_Send( BROKER_CLIENT_RECORD *pClient, const uint8_t *pBuff, size_t Len )
+{
+  if ( Len > 0 )
+  {
+    if ( send( pClient->fd, pBuff, Len, MSG_NOSIGNAL ) != (ssize_t)Len )
+    {
+      fprintf( stderr, "broker: short send of %zu bytes\n", Len );
+    }
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Broker_Forward( const char *pTopic, const uint8_t *pPayload, uint16_t Len,
+                uint8_t Qos, uint16_t Packet_Id )
+{
+  uint8_t   Tx[BROKER_PACKET_MAX];
+  uint16_t  Tx_Len;
+  size_t    Index;
+  size_t    Filter;
+
+  Tx_Len = Mqtt_Encode_Publish( Tx, sizeof(Tx), pTopic, pPayload, Len, Qos, FALSE, FALSE, Packet_Id );
+  for ( Index = 0; Index < Broker_Clients.size(); Index++ )
+  {
+    for ( Filter = 0; Filter < Broker_Clients[Index].filters.size(); Filter++ )
+    {
+      if ( Sim_Broker_Topic_Match( Broker_Clients[Index].filters[Filter].c_str(), pTopic ) )
+      {
+        Broker_Send( &Broker_Clients[Index], Tx, Tx_Len );
+        break;
+      }
+    }
+  }
+}
+
+/*===========================================================================*/
@@ -0,0 +1,43 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   broker.h
+@brief  Host build, an MQTT broker stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Just enough of a broker for the firmware: CONNECT, SUBSCRIBE, PUBLISH at
+QoS 0 and 1 both ways, PINGREQ. It listens on loopback for the device port 1883 and
+keeps the last payload and the count of each topic published to it.
+*/
+
+#ifndef __BROKER_H__
+#define __BROKER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern bool         Sim_Broker_Start( void );
+extern void         Sim_Broker_Drop( void );
+extern void         Sim_Broker_Publish( const char *pTopic, const char *pPayload );
+extern void         Sim_Broker_Publish_Qos1( const char *pTopic, const char *pPayload, uint16_t Packet_Id );
+extern bool         Sim_Broker_Acked( uint16_t Packet_Id );
+extern const char   *Sim_Broker_Last( const char *pTopic );
+extern uint32_t     Sim_Broker_Count( const char *pTopic );
+extern uint32_t     Sim_Broker_Connects( void );
+extern uint32_t     Sim_Broker_Subscriptions( void );
+extern bool         Sim_Broker_Topic_Match( const char *pFilter, const char *pTopic );
+
+#endif  /* __BROKER_H__ */
+
+/*===========================================================================*/
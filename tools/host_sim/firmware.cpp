@@ -0,0 +1,18 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   firmware.cpp
+@brief  Host build, the sketch as a C++ file
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The Arduino IDE builds main.ino as C++ after adding the prototypes, it has
+none to add here, everything is defined before its use.
+*/
+
+#include "main.ino"
+
+/*===========================================================================*/
@@ -0,0 +1,340 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   Arduino.h
+@brief  Host build, the ESP8266 Arduino core as the firmware uses it
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The part of the ESP8266 Arduino core the firmware calls, for Linux. Time
+is the virtual clock of clock.cpp, the pins are those of gpio.cpp, see
+sim.h. Flash strings are plain strings, there is no PROGMEM on the host.
+
+unsigned long is 64 bits here and 32 bits on the ESP8266. millis() and
+micros() give the 32 bits values all the same, so they wrap as on the
+device, but a difference of two of them kept in an unsigned long does not.
+*/
+
+#ifndef __ARDUINO_H__
+#define __ARDUINO_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <functional>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+typedef uint8_t   u8;
+typedef uint16_t  u16;
+typedef uint32_t  u32;
+typedef int32_t   s32;
+
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define PGM_P             const char *
+#define PSTR( s )         ( s )
+
+class __FlashStringHelper;
+#define FPSTR( p )        ( reinterpret_cast<const __FlashStringHelper *>( p ) )
+#define F( s )            FPSTR( PSTR( s ) )
+
+#define pgm_read_byte( p )    ( *(const uint8_t *)(p) )
+#define pgm_read_word( p )    ( *(const uint16_t *)(p) )
+#define pgm_read_dword( p )   ( *(const uint32_t *)(p) )
+#define pgm_read_ptr( p )     ( *(void * const *)(p) )
+#define pgm_read_float( p )   ( *(const float *)(p) )
+
+#define strlen_P      strlen
+#define strcmp_P      strcmp
+#define strncmp_P     strncmp
+#define strcpy_P      strcpy
+#define strncpy_P     strncpy
+#define strcat_P      strcat
+#define strstr_P      strstr
+#define memcpy_P      memcpy
+#define memcmp_P      memcmp
+#define sprintf_P     sprintf
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+#define RISING        1
+#define FALLING       2
+#define CHANGE        3
+
+/* Timer dividers and modes */
+#define TIM_DIV1      0
+#define TIM_DIV16     1
+#define TIM_DIV256    3
+#define TIM_EDGE      0
+#define TIM_LEVEL     1
+#define TIM_SINGLE    0
+#define TIM_LOOP      1
+
+/* rst_info.reason */
+#define REASON_DEFAULT_RST        0
+#define REASON_WDT_RST            1
+#define REASON_EXCEPTION_RST      2
+#define REASON_SOFT_WDT_RST       3
+#define REASON_SOFT_RESTART       4
+#define REASON_DEEP_SLEEP_AWAKE   5
+#define REASON_EXT_SYS_RST        6
+
+typedef void (*voidFuncPtr)( void );
+typedef void (*timercallback)( void );
+
+struct rst_info
+{
+  uint32_t  reason;
+  uint32_t  exccause;
+  uint32_t  epc1;
+  uint32_t  epc2;
+  uint32_t  epc3;
+  uint32_t  excvaddr;
+  uint32_t  depc;
+};
+
+template<typename T> T min( T a, T b ) { return ( a < b ) ? a : b; }
+template<typename T> T max( T a, T b ) { return ( a > b ) ? a : b; }
+
+/*---------------------------------------------------------------------------*/
+
+class String
+{
+public:
+  String( const char *pStr = "" );
+  String( const String &Other );
+  String( String &&Other );
+  String( const __FlashStringHelper *pStr );
+  explicit String( char c );
+  explicit String( int Value, unsigned char Base = 10 );
+  explicit String( unsigned int Value, unsigned char Base = 10 );
+  explicit String( long Value, unsigned char Base = 10 );
+  explicit String( unsigned long Value, unsigned char Base = 10 );
+  explicit String( float Value, unsigned char Decimals = 2 );
+  explicit String( double Value, unsigned char Decimals = 2 );
+  ~String();
+
+  String &operator=( const String &Other );
+  String &operator=( String &&Other );
+  String &operator=( const char *pStr );
+  String &operator=( const __FlashStringHelper *pStr );
+
+  bool concat( const char *pStr, unsigned int Len );
+  bool concat( const char *pStr )               { return concat( pStr, strlen( pStr ) ); }
+  bool concat( const String &Other )            { return concat( Other.c_str(), Other.length() ); }
+  bool concat( char c )                         { return concat( &c, 1 ); }
+  bool concat( int Value )                      { return concat( String( Value ) ); }
+  bool concat( unsigned int Value )             { return concat( String( Value ) ); }
+  bool concat( long Value )                     { return concat( String( Value ) ); }
+  bool concat( unsigned long Value )            { return concat( String( Value ) ); }
+  bool concat( float Value )                    { return concat( String( Value ) ); }
+  bool concat( double Value )                   { return concat( String( Value ) ); }
+  bool concat( const __FlashStringHelper *pStr ){ return concat( (const char *)pStr ); }
+
+  template<typename T> String &operator+=( const T &Value ) { concat( Value ); return *this; }
+  String &operator+=( const char *pStr )        { concat( pStr ); return *this; }
+
+  bool operator==( const String &Other ) const  { return equals( Other.c_str() ); }
+  bool operator==( const char *pStr ) const     { return equals( pStr ); }
+  bool operator!=( const String &Other ) const  { return !equals( Other.c_str() ); }
+  bool operator!=( const char *pStr ) const     { return !equals( pStr ); }
+  bool operator<( const String &Other ) const   { return strcmp( c_str(), Other.c_str() ) < 0; }
+  char operator[]( unsigned int Index ) const   { return charAt( Index ); }
+  char &operator[]( unsigned int Index );
+
+  bool equals( const char *pStr ) const         { return strcmp( c_str(), pStr ) == 0; }
+  bool equals( const String &Other ) const      { return equals( Other.c_str() ); }
+  bool equalsIgnoreCase( const String &Other ) const;
+  bool startsWith( const String &Prefix ) const;
+  bool endsWith( const String &Suffix ) const;
+
+  const char   *c_str( void ) const             { return pBuff ? pBuff : ""; }
+  unsigned int length( void ) const             { return Len; }
+  bool         isEmpty( void ) const            { return Len == 0; }
+  bool         reserve( unsigned int Size );
+  char         charAt( unsigned int Index ) const;
+  void         setCharAt( unsigned int Index, char c );
+  int          indexOf( char c, unsigned int From = 0 ) const;
+  int          indexOf( const String &Str, unsigned int From = 0 ) const;
+  int          lastIndexOf( char c ) const;
+  String       substring( unsigned int From ) const { return substring( From, Len ); }
+  String       substring( unsigned int From, unsigned int To ) const;
+  void         replace( const String &Find, const String &With );
+  void         remove( unsigned int Index, unsigned int Count = (unsigned int)-1 );
+  void         trim( void );
+  void         toLowerCase( void );
+  void         toUpperCase( void );
+  long         toInt( void ) const              { return atol( c_str() ); }
+  float        toFloat( void ) const            { return (float)atof( c_str() ); }
+  double       toDouble( void ) const           { return atof( c_str() ); }
+
+private:
+  char          *pBuff;
+  unsigned int  Len;
+  unsigned int  Capacity;
+};
+
+String operator+( const String &Left, const String &Right );
+String operator+( const String &Left, const char *pRight );
+String operator+( const char *pLeft, const String &Right );
+String operator+( const String &Left, char Right );
+
+/*---------------------------------------------------------------------------*/
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write( uint8_t c ) = 0;
+  virtual size_t write( const uint8_t *pBuff, size_t Size );
+  size_t write( const char *pStr )              { return write( (const uint8_t *)pStr, strlen( pStr ) ); }
+
+  size_t print( const char *pStr )              { return write( pStr ); }
+  size_t print( const String &Str )             { return write( (const uint8_t *)Str.c_str(), Str.length() ); }
+  size_t print( const __FlashStringHelper *pStr ) { return write( (const char *)pStr ); }
+  size_t print( char c )                        { return write( (uint8_t)c ); }
+  size_t print( int Value )                     { return printf( "%d", Value ); }
+  size_t print( unsigned int Value )            { return printf( "%u", Value ); }
+  size_t print( long Value )                    { return printf( "%ld", Value ); }
+  size_t print( unsigned long Value )           { return printf( "%lu", Value ); }
+  size_t print( double Value, int Decimals = 2 ) { return printf( "%.*f", Decimals, Value ); }
+  template<typename T> size_t println( const T &Value ) { return print( Value ) + println(); }
+  size_t println( void )                        { return write( "\r\n" ); }
+
+  size_t printf( const char *pFormat, ... ) __attribute__((format(printf, 2, 3)));
+  size_t printf_P( const char *pFormat, ... ) __attribute__((format(printf, 2, 3)));
+  virtual void flush( void ) {}
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available( void ) = 0;
+  virtual int read( void ) = 0;
+  virtual int peek( void ) { return -1; }
+  size_t readBytes( uint8_t *pBuff, size_t Size );
+  size_t readBytes( char *pBuff, size_t Size )  { return readBytes( (uint8_t *)pBuff, Size ); }
+  void   setTimeout( unsigned long Timeout_ms ) { Stream_Timeout_ms = Timeout_ms; }
+
+protected:
+  unsigned long Stream_Timeout_ms = 1000;
+};
+
+/* Serial, to stdout or where Sim_Serial_Set_Output() says */
+class HardwareSerial : public Stream
+{
+public:
+  void   begin( unsigned long Baud )            { (void)Baud; }
+  size_t write( uint8_t c ) override;
+  size_t write( const uint8_t *pBuff, size_t Size ) override;
+  using Print::write;
+  int    available( void ) override             { return 0; }
+  int    read( void ) override                  { return -1; }
+  int    availableForWrite( void )              { return 128; }
+  void   flush( void ) override;
+};
+
+extern HardwareSerial Serial;
+
+/*---------------------------------------------------------------------------*/
+
+class EspClass
+{
+public:
+  uint32_t  getFreeHeap( void );
+  uint32_t  getMaxFreeBlockSize( void );
+  uint8_t   getHeapFragmentation( void );
+  void      getHeapStats( uint32_t *pFree, uint16_t *pMax_Block, uint8_t *pFrag );
+  uint32_t  getChipId( void );
+  uint32_t  getCycleCount( void );
+  uint8_t   getCpuFreqMHz( void )               { return 80; }
+  bool      rtcUserMemoryRead( uint32_t Offset, uint32_t *pData, size_t Size );
+  bool      rtcUserMemoryWrite( uint32_t Offset, uint32_t *pData, size_t Size );
+  void      restart( void ) __attribute__((noreturn));
+  void      reset( void ) __attribute__((noreturn)) { restart(); }
+  rst_info  *getResetInfoPtr( void );
+  String    getResetReason( void );
+  uint32_t  getSketchSize( void );
+  uint32_t  getFreeSketchSpace( void );
+  bool      flashRead( uint32_t Offset, uint32_t *pData, size_t Size );
+  bool      flashRead( uint32_t Offset, uint8_t *pData, size_t Size );
+  uint32_t  random( void );
+};
+
+extern EspClass ESP;
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern unsigned long  millis( void );
+extern unsigned long  micros( void );
+extern void           delay( unsigned long Ms );
+extern void           delayMicroseconds( unsigned int Us );
+extern void           yield( void );
+
+extern void           pinMode( uint8_t Pin, uint8_t Mode );
+extern void           digitalWrite( uint8_t Pin, uint8_t Level );
+extern int            digitalRead( uint8_t Pin );
+extern unsigned long  pulseIn( uint8_t Pin, uint8_t Level, unsigned long Timeout_us = 1000000 );
+extern void           attachInterrupt( uint8_t Pin, voidFuncPtr pFunc, int Mode );
+extern void           detachInterrupt( uint8_t Pin );
+inline uint8_t        digitalPinToInterrupt( uint8_t Pin ) { return Pin; }
+
+extern void           noInterrupts( void );
+extern void           interrupts( void );
+extern uint32_t       xt_rsil( uint32_t Level );
+extern void           xt_wsr_ps( uint32_t State );
+
+/* The RTC memory by address as the chip maps it, the system blocks from
+   0x60001100, the user blocks from 0x60001200, a UINT32 of the firmware each */
+#define RTC_MEMORY_WORD( Addr ) ( *rtc_memory_word( Addr ) )
+extern volatile unsigned long *rtc_memory_word( uint32_t Addr );
+
+extern void           timer0_isr_init( void );
+extern void           timer0_attachInterrupt( timercallback pFunc );
+extern void           timer0_detachInterrupt( void );
+extern void           timer0_write( uint32_t Count );
+extern void           timer1_isr_init( void );
+extern void           timer1_attachInterrupt( timercallback pFunc );
+extern void           timer1_detachInterrupt( void );
+extern void           timer1_enable( uint8_t Divider, uint8_t Int_Type, uint8_t Reload );
+extern void           timer1_disable( void );
+extern void           timer1_write( uint32_t Ticks );
+
+extern long           random( long Max );
+extern long           random( long Min, long Max );
+extern void           randomSeed( unsigned long Seed );
+
+/* As the core's, %S is a string in flash, to glibc a wchar_t one */
+extern int            snprintf_P( char *pBuff, size_t Size, const char *pFormat, ... );
+extern int            vsnprintf_P( char *pBuff, size_t Size, const char *pFormat, va_list ap );
+
+extern char           *dtostrf( double Value, signed char Width, unsigned char Decimals, char *pBuff );
+extern uint32_t       crc32( const void *pData, size_t Length, uint32_t Crc = 0xffffffff );
+
+extern void           configTime( const char *pTz, const char *pServer1,
+                                  const char *pServer2 = nullptr, const char *pServer3 = nullptr );
+
+#endif  /* __ARDUINO_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,46 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   Client.h
+@brief  Host build, a byte stream connection
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+*/
+
+#ifndef __CLIENT_H__
+#define __CLIENT_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+class Client : public Stream
+{
+public:
+  virtual int     connect( IPAddress Ip, uint16_t Port ) = 0;
+  virtual int     connect( const char *pHost, uint16_t Port ) = 0;
+  virtual size_t  write( uint8_t c ) override = 0;
+  virtual size_t  write( const uint8_t *pBuff, size_t Size ) override = 0;
+  virtual int     available( void ) override = 0;
+  virtual int     read( void ) override = 0;
+  virtual int     read( uint8_t *pBuff, size_t Size ) = 0;
+  virtual void    stop( void ) = 0;
+  virtual uint8_t connected( void ) = 0;
+  virtual operator bool( void ) = 0;
+  using Print::write;
+};
+
+#endif  /* __CLIENT_H__ */
+
+/*===========================================================================*/
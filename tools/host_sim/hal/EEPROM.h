@@ -0,0 +1,73 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   EEPROM.h
+@brief  Host build, the EEPROM emulated in flash
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A RAM copy as the core keeps it, commit() writes it to eeprom.bin of the
+storage directory, begin() reads it back. Erased flash reads 0xff.
+*/
+
+#ifndef __EEPROM_H__
+#define __EEPROM_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+class EEPROMClass
+{
+public:
+  EEPROMClass() : pData( NULL ), Size( 0 ), Dirty( false ), Commits( 0 ) {}
+
+  void      begin( size_t Size );
+  uint8_t   read( int Address );
+  void      write( int Address, uint8_t Value );
+  bool      commit( void );
+  bool      end( void )                     { return commit(); }
+  uint8_t   *getDataPtr( void )             { Dirty = true; return pData; }
+  size_t    length( void )                  { return Size; }
+  uint32_t  commits( void )                 { return Commits; }
+
+  template<typename T> T &get( int Address, T &Value )
+  {
+    if ( (Address >= 0) && (Address + sizeof(T) <= Size) )
+    {
+      memcpy( (void *)&Value, pData + Address, sizeof(T) );
+    }
+    return Value;
+  }
+
+  template<typename T> const T &put( int Address, const T &Value )
+  {
+    if ( (Address >= 0) && (Address + sizeof(T) <= Size) )
+    {
+      memcpy( pData + Address, (const void *)&Value, sizeof(T) );
+      Dirty = true;
+    }
+    return Value;
+  }
+
+private:
+  uint8_t   *pData;
+  size_t    Size;
+  bool      Dirty;
+  uint32_t  Commits;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif  /* __EEPROM_H__ */
+
+/*===========================================================================*/
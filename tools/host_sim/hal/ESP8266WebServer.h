@@ -0,0 +1,134 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ESP8266WebServer.h
+@brief  Host build, the web server on the host's loopback
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Serves on 127.0.0.1, on the port of Sim_Web_Set_Port() or a free one, see
+Sim_Web_Port(). A request at a time, read whole by handleClient(), the
+query and a form body are the arguments. The answer is closed after the
+handler, a length not known is sent chunked as the core does.
+
+A multipart upload is not taken apart, the upload handler is not called.
+*/
+
+#ifndef __ESP8266WEBSERVER_H__
+#define __ESP8266WEBSERVER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <vector>
+#include "ESP8266WiFi.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define CONTENT_LENGTH_UNKNOWN    ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET    ((size_t)-2)
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+
+#define HTTP_UPLOAD_BUFLEN        2048
+
+typedef struct
+{
+  HTTPUploadStatus  status;
+  String            filename;
+  String            name;
+  String            type;
+  size_t            totalSize;
+  size_t            currentSize;
+  size_t            contentLength;
+  uint8_t           buf[HTTP_UPLOAD_BUFLEN];
+
+} HTTPUpload;
+
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit ESP8266WebServer( int Port );
+
+  void        on( const char *pUri, THandlerFunction Handler )  { on( pUri, HTTP_ANY, Handler ); }
+  void        on( const char *pUri, HTTPMethod Method, THandlerFunction Handler ) { on( pUri, Method, Handler, nullptr ); }
+  void        on( const char *pUri, HTTPMethod Method, THandlerFunction Handler, THandlerFunction Upload );
+  void        onNotFound( THandlerFunction Handler )            { Not_Found = Handler; }
+  void        begin( void );
+  void        close( void );
+  void        handleClient( void );
+
+  HTTPMethod  method( void )                                    { return Method; }
+  String      uri( void )                                       { return Uri; }
+  int         args( void )                                      { return (int)Args.size(); }
+  String      arg( int Index );
+  String      arg( const char *pName );
+  String      arg( const String &Name )                         { return arg( Name.c_str() ); }
+  String      argName( int Index );
+  bool        hasArg( const char *pName );
+  bool        hasArg( const String &Name )                      { return hasArg( Name.c_str() ); }
+  String      header( const char *pName );
+  bool        hasHeader( const char *pName );
+  void        collectHeaders( const char **ppNames, size_t Count ) { (void)ppNames; (void)Count; }
+
+  void        send( int Code, const char *pContent_Type, const String &Content );
+  void        send( int Code, const char *pContent_Type, const char *pContent );
+  void        send( int Code, const char *pContent_Type, const char *pContent, size_t Len );
+  void        send( int Code = 200 )                            { send( Code, NULL, "", 0 ); }
+  void        send_P( int Code, PGM_P pContent_Type, PGM_P pContent ) { send( Code, pContent_Type, pContent ); }
+  void        send_P( int Code, PGM_P pContent_Type, PGM_P pContent, size_t Len ) { send( Code, pContent_Type, pContent, Len ); }
+  void        sendHeader( const String &Name, const String &Value, bool First = false );
+  void        setContentLength( size_t Len )                    { Content_Length = Len; }
+  void        sendContent( const String &Content )              { sendContent( Content.c_str(), Content.length() ); }
+  void        sendContent( const char *pContent, size_t Len );
+  void        sendContent( const char *pContent )               { sendContent( pContent, strlen( pContent ) ); }
+  void        sendContent_P( PGM_P pContent )                   { sendContent( pContent ); }
+  void        sendContent_P( PGM_P pContent, size_t Len )       { sendContent( pContent, Len ); }
+
+  HTTPUpload  &upload( void )                                   { return Upload_State; }
+  bool        authenticate( const char *pUser, const char *pPassword );
+  void        requestAuthentication( void );
+
+private:
+  struct Route
+  {
+    String            uri;
+    HTTPMethod        method;
+    THandlerFunction  handler;
+    THandlerFunction  upload;
+  };
+
+  int                 Port;
+  int                 Listen_Fd;
+  int                 Client_Fd;
+  std::vector<Route>  Routes;
+  THandlerFunction    Not_Found;
+
+  HTTPMethod          Method;
+  String              Uri;
+  std::vector<std::pair<String, String>>  Args;
+  std::vector<std::pair<String, String>>  Headers;
+  std::vector<std::pair<String, String>>  Response_Headers;
+  size_t              Content_Length;
+  bool                Chunked;
+  bool                Responded;
+  HTTPUpload          Upload_State;
+
+  bool                Read_Request( void );
+  void                Add_Args( const String &Encoded );
+  void                Write( const char *pBuff, size_t Len );
+};
+
+#endif  /* __ESP8266WEBSERVER_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,108 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ESP8266WiFi.h
+@brief  Host build, the Wi-Fi station and access point
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The air is a list of access points, Sim_Wifi_Add_Ap(). begin() finds one
+by SSID, and its BSSID if given, and is connected WIFI_SIM_CONNECT_MS
+later, WIFI_SIM_FAST_CONNECT_MS with the channel and BSSID given. A scan
+takes WIFI_SIM_SCAN_MS. The soft AP is only a name.
+*/
+
+#ifndef __ESP8266WIFI_H__
+#define __ESP8266WIFI_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiUdp.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define WIFI_SIM_CONNECT_MS       2500
+#define WIFI_SIM_FAST_CONNECT_MS  300
+#define WIFI_SIM_SCAN_MS          2000
+
+typedef enum
+{
+  WL_IDLE_STATUS      = 0,
+  WL_NO_SSID_AVAIL    = 1,
+  WL_SCAN_COMPLETED   = 2,
+  WL_CONNECTED        = 3,
+  WL_CONNECT_FAILED   = 4,
+  WL_CONNECTION_LOST  = 5,
+  WL_WRONG_PASSWORD   = 6,
+  WL_DISCONNECTED     = 7,
+  WL_NO_SHIELD        = 255,
+
+} wl_status_t;
+
+typedef enum
+{
+  WIFI_OFF    = 0,
+  WIFI_STA    = 1,
+  WIFI_AP     = 2,
+  WIFI_AP_STA = 3,
+
+} WiFiMode_t;
+
+#define WIFI_SCAN_RUNNING   (-1)
+#define WIFI_SCAN_FAILED    (-2)
+
+class ESP8266WiFiClass
+{
+public:
+  bool        mode( WiFiMode_t Mode );
+  bool        persistent( bool Persistent );
+  bool        setAutoConnect( bool Auto );
+  bool        setAutoReconnect( bool Auto );
+  bool        softAP( const char *pSsid, const char *pPassword = NULL, int Channel = 1, int Hidden = 0, int Max_Connection = 4 );
+  IPAddress   softAPIP( void );
+
+  wl_status_t begin( const char *pSsid, const char *pPassword = NULL, int32_t Channel = 0,
+                     const uint8_t *pBssid = NULL, bool Connect = true );
+  bool        config( IPAddress Ip, IPAddress Gateway, IPAddress Netmask,
+                      IPAddress Dns1 = IPAddress(), IPAddress Dns2 = IPAddress() );
+  bool        disconnect( bool Wifi_Off = false );
+  wl_status_t status( void );
+  bool        isConnected( void )   { return status() == WL_CONNECTED; }
+
+  String      SSID( void );
+  int32_t     RSSI( void );
+  uint8_t     *BSSID( void );
+  int32_t     channel( void );
+  IPAddress   localIP( void );
+  IPAddress   gatewayIP( void );
+  IPAddress   subnetMask( void );
+  IPAddress   dnsIP( uint8_t Index = 0 );
+  String      macAddress( void );
+
+  int8_t      scanNetworks( bool Async = false, bool Show_Hidden = false );
+  int8_t      scanComplete( void );
+  void        scanDelete( void );
+  String      SSID( uint8_t Index );
+  int32_t     RSSI( uint8_t Index );
+  uint8_t     *BSSID( uint8_t Index );
+  int32_t     channel( uint8_t Index );
+
+  int         hostByName( const char *pHost, IPAddress &Result );
+  int         hostByName( const char *pHost, IPAddress &Result, uint32_t Timeout_ms );
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif  /* __ESP8266WIFI_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,21 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ESP8266mDNS.h
+@brief  Host build, mDNS
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Not simulated, the firmware doesn't announce itself.
+*/
+
+#ifndef __ESP8266MDNS_H__
+#define __ESP8266MDNS_H__
+
+
+#endif  /* __ESP8266MDNS_H__ */
+
+/*===========================================================================*/
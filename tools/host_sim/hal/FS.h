@@ -0,0 +1,106 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   FS.h
+@brief  Host build, a file system on a host directory
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The paths of the firmware under littlefs/ of the storage directory. A
+File is shared by its copies and closed with the last, as the core's.
+*/
+
+#ifndef __FS_H__
+#define __FS_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+namespace fs
+{
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream
+{
+public:
+  File() {}
+  explicit File( FILE *pFile, const String &Name );
+
+  explicit operator bool() const            { return pHandle && *pHandle; }
+  size_t    size( void );
+  size_t    position( void );
+  bool      seek( uint32_t Pos, SeekMode Mode = SeekSet );
+  int       read( void ) override;
+  size_t    read( uint8_t *pBuff, size_t Size );
+  int       available( void ) override;
+  size_t    write( uint8_t c ) override     { return write( &c, 1 ); }
+  size_t    write( const uint8_t *pBuff, size_t Size ) override;
+  void      flush( void ) override;
+  void      close( void );
+  const char *name( void ) const            { return Name.c_str(); }
+  using Print::write;
+
+private:
+  std::shared_ptr<FILE *>   pHandle;
+  String                    Name;
+};
+
+class Dir
+{
+public:
+  Dir() : Index( -1 ) {}
+  Dir( const String &Path, const std::vector<String> &Names ) : Path( Path ), Names( Names ), Index( -1 ) {}
+
+  bool      next( void )                    { return ++Index < (int)Names.size(); }
+  String    fileName( void )                { return ( Index >= 0 && Index < (int)Names.size() ) ? Names[Index] : String(); }
+  size_t    fileSize( void );
+  bool      isFile( void );
+
+private:
+  String              Path;
+  std::vector<String> Names;
+  int                 Index;
+};
+
+class FS
+{
+public:
+  bool      begin( void );
+  void      end( void )                     {}
+  bool      format( void );
+  File      open( const char *pPath, const char *pMode );
+  File      open( const String &Path, const char *pMode ) { return open( Path.c_str(), pMode ); }
+  bool      exists( const char *pPath );
+  bool      remove( const char *pPath );
+  bool      remove( const String &Path )    { return remove( Path.c_str() ); }
+  bool      rename( const char *pFrom, const char *pTo );
+  bool      mkdir( const char *pPath );
+  Dir       openDir( const char *pPath );
+};
+
+}
+
+using fs::FS;
+using fs::File;
+using fs::Dir;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif  /* __FS_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,55 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   IPAddress.h
+@brief  Host build, an IPv4 address
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Kept as lwIP keeps it, the first byte lowest, so (UINT32) of one is the
+same number as on the device.
+*/
+
+#ifndef __IPADDRESS_H__
+#define __IPADDRESS_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <lwip/dns.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+class IPAddress
+{
+public:
+  IPAddress() : Addr( 0 ) {}
+  IPAddress( uint8_t a, uint8_t b, uint8_t c, uint8_t d )
+    : Addr( (uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24) ) {}
+  IPAddress( uint32_t Raw ) : Addr( Raw ) {}
+  IPAddress( const ip_addr_t *pAddr ) : Addr( pAddr ? pAddr->addr : 0 ) {}
+
+  operator uint32_t() const                       { return Addr; }
+  bool operator==( const IPAddress &Other ) const { return Addr == Other.Addr; }
+  bool operator!=( const IPAddress &Other ) const { return Addr != Other.Addr; }
+  uint8_t operator[]( int Index ) const           { return (uint8_t)( Addr >> (8 * Index) ); }
+
+  bool    isSet( void ) const                     { return Addr != 0; }
+  String  toString( void ) const;
+  bool    fromString( const char *pStr );
+  bool    fromString( const String &Str )         { return fromString( Str.c_str() ); }
+
+private:
+  uint32_t  Addr;
+};
+
+#endif  /* __IPADDRESS_H__ */
+
+/*===========================================================================*/
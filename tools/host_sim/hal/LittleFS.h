@@ -0,0 +1,32 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   LittleFS.h
+@brief  Host build, LittleFS
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+See FS.h.
+*/
+
+#ifndef __LITTLEFS_H__
+#define __LITTLEFS_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <FS.h>
+
+/*=============================================================================
+Global References
+=============================================================================*/
+
+extern fs::FS LittleFS;
+
+#endif  /* __LITTLEFS_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,40 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   MD5Builder.h
+@brief  Host build, MD5
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Not simulated, updates aren't, every digest is zeros.
+*/
+
+#ifndef __MD5BUILDER_H__
+#define __MD5BUILDER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+class MD5Builder
+{
+public:
+  void    begin( void )                             {}
+  void    add( const uint8_t *pData, uint16_t Len ) { (void)pData; (void)Len; }
+  void    calculate( void )                         {}
+  void    getBytes( uint8_t *pOut )                 { memset( pOut, 0, 16 ); }
+  String  toString( void )                          { return String( "00000000000000000000000000000000" ); }
+};
+
+#endif  /* __MD5BUILDER_H__ */
+
+/*===========================================================================*/
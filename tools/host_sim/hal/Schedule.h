@@ -0,0 +1,38 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   Schedule.h
+@brief  Host build, functions run by the SDK loop
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Run by the virtual clock, see clock.cpp.
+*/
+
+#ifndef __SCHEDULE_H__
+#define __SCHEDULE_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <functional>
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern bool
+schedule_recurrent_function_us( const std::function<bool(void)> &fn, uint32_t repeat_us,
+                                const std::function<bool(void)> &alarm = nullptr );
+
+extern bool
+schedule_function( const std::function<void(void)> &fn );
+
+#endif  /* __SCHEDULE_H__ */
+
+/*===========================================================================*/
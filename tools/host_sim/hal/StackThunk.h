@@ -0,0 +1,32 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   StackThunk.h
+@brief  Host build, the BearSSL stack of the core
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+There is no separate stack for BearSSL on the host, none of it is used.
+*/
+
+#ifndef __STACKTHUNK_H__
+#define __STACKTHUNK_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+inline uint32_t stack_thunk_get_max_usage( void ) { return 0; }
+
+#endif  /* __STACKTHUNK_H__ */
+
+/*===========================================================================*/
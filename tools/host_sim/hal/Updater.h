@@ -0,0 +1,45 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   Updater.h
+@brief  Host build, writing a new firmware
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Not simulated, begin() fails, so an update is refused as on a device
+without the room for one.
+*/
+
+#ifndef __UPDATER_H__
+#define __UPDATER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+class UpdaterClass
+{
+public:
+  bool    begin( size_t Size, int Command = 0, int Led_Pin = -1, uint8_t Led_On = 0 );
+  bool    setMD5( const char *pMd5 )              { (void)pMd5; return true; }
+  size_t  write( uint8_t *pData, size_t Len )     { (void)pData; (void)Len; return 0; }
+  bool    end( bool Even_If_Remaining = false )   { (void)Even_If_Remaining; return false; }
+  bool    isRunning( void )                       { return false; }
+  bool    hasError( void )                        { return true; }
+  String  getErrorString( void )                  { return String( "Not simulated on the host" ); }
+};
+
+extern UpdaterClass Update;
+
+#endif  /* __UPDATER_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,61 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   WiFiClient.h
+@brief  Host build, a TCP connection over the host's loopback
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A connect goes to the host port the device port is mapped to, see
+Sim_Net_Map(), whatever the address, and only while Wi-Fi is connected. A
+host name costs a DNS lookup first, as on the device, waiting up to the
+core's default of 10 s if no answer comes. One can't be copied.
+*/
+
+#ifndef __WIFICLIENT_H__
+#define __WIFICLIENT_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include "Client.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+class WiFiClient : public Client
+{
+public:
+  WiFiClient() : Fd( -1 ) {}
+  explicit WiFiClient( int Accepted_Fd ) : Fd( Accepted_Fd ) {}
+  WiFiClient( const WiFiClient & ) = delete;
+  WiFiClient &operator=( const WiFiClient & ) = delete;
+  virtual ~WiFiClient() { stop(); }
+
+  int     connect( IPAddress Ip, uint16_t Port ) override;
+  int     connect( const char *pHost, uint16_t Port ) override;
+  int     connect( const String &Host, uint16_t Port ) { return connect( Host.c_str(), Port ); }
+  size_t  write( uint8_t c ) override                  { return write( &c, 1 ); }
+  size_t  write( const uint8_t *pBuff, size_t Size ) override;
+  int     available( void ) override;
+  int     read( void ) override;
+  int     read( uint8_t *pBuff, size_t Size ) override;
+  int     peek( void ) override;
+  void    stop( void ) override;
+  uint8_t connected( void ) override;
+  operator bool( void ) override                       { return Fd >= 0; }
+  void    setNoDelay( bool No_Delay );
+  using Print::write;
+
+protected:
+  int     Fd;
+};
+
+#endif  /* __WIFICLIENT_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,115 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   WiFiClientSecure.h
+@brief  Host build, BearSSL::WiFiClientSecure over OpenSSL
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+What mqtt_transport.cpp uses of the client of the core, on a WiFiClient
+connection, TLS 1.2 only and without tickets as BearSSL has it. Like
+BearSSL, the session given to setSession() is offered on connect and gets
+the parameters of the handshake back after it, so a resumed one is left
+as it was and a full handshake changes it.
+
+The implementation is host_sim/tls.cpp, outside hal/ so only what uses TLS
+links OpenSSL. Not there: trust anchors and fingerprints, the connection
+is always insecure.
+*/
+
+#ifndef __WIFICLIENTSECURE_H__
+#define __WIFICLIENTSECURE_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <string.h>
+#include "WiFiClient.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The suites of bearssl_ssl.h mqtt_transport.cpp asks for */
+#define BR_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256        0xC023
+#define BR_TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256          0xC027
+#define BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256        0xC02B
+#define BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256          0xC02F
+#define BR_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256    0xCCA8
+#define BR_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256  0xCCA9
+
+/* As in bearssl_ssl.h */
+typedef struct
+{
+  unsigned char session_id[32];
+  unsigned char session_id_len;
+  uint16_t      version;
+  uint16_t      cipher_suite;
+  unsigned char master_secret[48];
+
+} br_ssl_session_parameters;
+
+typedef struct ssl_st SSL;
+
+namespace BearSSL
+{
+
+class Session
+{
+  friend class WiFiClientSecure;
+
+public:
+  Session() { memset( &Params, 0, sizeof(Params) ); }
+
+private:
+  br_ssl_session_parameters Params;
+};
+
+class WiFiClientSecure : public WiFiClient
+{
+public:
+  WiFiClientSecure() : pSsl( NULL ), pSession( NULL ), Rx_Size( 16384 ), Mfl_Code( 0 ),
+                       Ciphers_Len( 0 ), Last_Error( 0 ) {}
+  virtual ~WiFiClientSecure() { stop(); }
+
+  int     connect( IPAddress Ip, uint16_t Port ) override;
+  int     connect( const char *pHost, uint16_t Port ) override;
+  size_t  write( uint8_t c ) override                  { return write( &c, 1 ); }
+  size_t  write( const uint8_t *pBuff, size_t Size ) override;
+  int     available( void ) override;
+  int     read( void ) override;
+  int     read( uint8_t *pBuff, size_t Size ) override;
+  int     peek( void ) override;
+  void    stop( void ) override;
+  uint8_t connected( void ) override;
+  using Print::write;
+
+  void    setBufferSizes( int Rx_Bytes, int Tx_Bytes )  { Rx_Size = Rx_Bytes; (void)Tx_Bytes; }
+  bool    setCiphers( const uint16_t *pCiphers, int Count );
+  void    setInsecure( void )                           {}
+  void    setSession( Session *pNew_Session )           { pSession = pNew_Session; }
+  int     getLastSSLError( char *pDest = NULL, size_t Len = 0 );
+
+  static bool probeMaxFragmentLength( const char *pHost, uint16_t Port, uint16_t Len );
+
+private:
+  bool    Handshake( void );
+
+  SSL       *pSsl;
+  Session   *pSession;
+  int       Rx_Size;
+  uint8_t   Mfl_Code;       /* Maximum Fragment Length asked for, 0 if none */
+  uint16_t  Ciphers[16];
+  int       Ciphers_Len;
+  unsigned long Last_Error;
+};
+
+}
+
+#endif  /* __WIFICLIENTSECURE_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,68 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   WiFiUdp.h
+@brief  Host build, UDP over the host's loopback
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Bound to a free host port whatever the port asked for, sent to the host
+port the device port is mapped to, see Sim_Net_Map().
+*/
+
+#ifndef __WIFIUDP_H__
+#define __WIFIUDP_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define WIFIUDP_PACKET_MAX    1472
+
+class WiFiUDP
+{
+public:
+  WiFiUDP() : Fd( -1 ), Tx_Len( 0 ), Tx_Port( 0 ), Rx_Len( 0 ), Rx_Pos( 0 ), Rx_Port( 0 ) {}
+  ~WiFiUDP() { stop(); }
+
+  uint8_t   begin( uint16_t Port );
+  void      stop( void );
+  int       beginPacket( IPAddress Ip, uint16_t Port );
+  int       beginPacket( const char *pHost, uint16_t Port );
+  size_t    write( const uint8_t *pBuff, size_t Size );
+  size_t    write( uint8_t c )    { return write( &c, 1 ); }
+  int       endPacket( void );
+  int       parsePacket( void );
+  int       available( void )     { return Rx_Len - Rx_Pos; }
+  int       read( void );
+  int       read( uint8_t *pBuff, size_t Size );
+  int       read( char *pBuff, size_t Size ) { return read( (uint8_t *)pBuff, Size ); }
+  void      flush( void )         { Rx_Pos = Rx_Len; }
+  IPAddress remoteIP( void )      { return Rx_Ip; }
+  uint16_t  remotePort( void )    { return Rx_Port; }
+
+private:
+  int       Fd;
+  uint8_t   Tx[WIFIUDP_PACKET_MAX];
+  int       Tx_Len;
+  uint16_t  Tx_Port;
+  uint8_t   Rx[WIFIUDP_PACKET_MAX];
+  int       Rx_Len;
+  int       Rx_Pos;
+  IPAddress Rx_Ip;
+  uint16_t  Rx_Port;
+};
+
+#endif  /* __WIFIUDP_H__ */
+
+/*===========================================================================*/
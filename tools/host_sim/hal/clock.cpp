@@ -0,0 +1,568 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   clock.cpp
+@brief  Host build, the virtual clock, timers and interrupts
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+One 64 bits count of CPU cycles is all the time there is. millis(),
+micros() and ESP.getCycleCount() are cut from it, delay() moves it and
+fires what falls due on the way, in the order of its time:
+
+  timer0    One shot at a cycle count, the watchdog's tick
+  timer1    Divided by 1, 16 or 256, once or reloaded, the sonar's ping
+  events    Sim_Clock_At(), the echo edges of the HC-SR04, DNS answers
+  scheduled schedule_recurrent_function_us(), not from an interrupt
+
+The first three are interrupts, none comes in while interrupts are masked
+or another one runs, they come once they are unmasked. Then the pollers
+of the stand-ins run, at most every 100 us, so a packet sent is answered
+by the next wait.
+
+Unpaced the clock goes as fast as the host runs the code, paced it is held
+back to Speed times real time, so a browser on the host can keep up.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <Schedule.h>
+#include <map>
+#include <vector>
+#include <time.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define CLOCK_NEVER   UINT64_MAX
+
+/* What yield() costs, it lets the clock move in a loop waiting on it */
+#define CLOCK_YIELD_CYCLES    (10 * SIM_CPU_MHZ)
+
+/* The pollers are system calls, a pulseIn() waits a microsecond at a time */
+#define CLOCK_POLL_CYCLES     (100 * SIM_CPU_MHZ)
+
+typedef struct
+{
+  SIM_EVENT_FUNC  pFunc;
+  void            *pContext;
+
+} CLOCK_EVENT_RECORD;
+
+typedef struct
+{
+  std::function<bool(void)>   func;
+  uint64_t                    period;     /* 0 for once */
+  uint64_t                    due;
+
+} CLOCK_SCHEDULED_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static uint64_t       Clock_Cycles      = 0;
+static uint32_t       Clock_Int_Level   = 0;
+static bool           Clock_In_Isr      = false;
+static bool           Clock_In_Scheduled = false;
+
+static timercallback  Timer0_Func       = NULL;
+static uint64_t       Timer0_Due        = CLOCK_NEVER;
+
+static timercallback  Timer1_Func       = NULL;
+static bool           Timer1_Enabled    = false;
+static bool           Timer1_Reload     = false;
+static uint32_t       Timer1_Divider    = 1;
+static uint64_t       Timer1_Period     = 0;
+static uint64_t       Timer1_Due        = CLOCK_NEVER;
+
+static std::multimap<uint64_t, CLOCK_EVENT_RECORD>  Clock_Events;
+static std::vector<CLOCK_SCHEDULED_RECORD>          Clock_Scheduled;
+static std::vector<SIM_POLL_FUNC>                   Clock_Polls;
+
+/* Paced runs, the real time at the virtual start */
+static double         Clock_Pace        = 0;
+static struct timespec Clock_Real_Start;
+static uint64_t       Clock_Pace_Start  = 0;
+static uint64_t       Clock_Polled      = 0;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static bool     Clock_Isr_Allowed( void );
+static uint64_t Clock_Next_Due( void );
+static void     Clock_Fire( uint64_t Due );
+static void     Clock_Isr( timercallback pFunc );
+static void     Clock_Hold_Pace( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static bool
+Clock_Isr_Allowed( void )
+{
+  return ( Clock_Int_Level == 0 ) && !Clock_In_Isr;
+}
+
+/*===========================================================================*/
+
+/* The earliest of what may fire now */
+static uint64_t
+Clock_Next_Due( void )
+{
+  uint64_t  Due = CLOCK_NEVER;
+  size_t    Index;
+
+  if ( Clock_Isr_Allowed() )
+  {
+    Due = min( Due, Timer0_Due );
+    Due = min( Due, Timer1_Due );
+    if ( !Clock_Events.empty() )
+    {
+      Due = min( Due, Clock_Events.begin()->first );
+    }
+  }
+
+  if ( !Clock_In_Isr && !Clock_In_Scheduled )
+  {
+    for ( Index = 0; Index < Clock_Scheduled.size(); Index++ )
+    {
+      Due = min( Due, Clock_Scheduled[Index].due );
+    }
+  }
+
+  return Due;
+}
+
+/*===========================================================================*/
+
+static void
+Clock_Isr( timercallback pFunc )
+{
+  Clock_In_Isr = true;
+  pFunc();
+  Clock_In_Isr = false;
+}
+
+/*===========================================================================*/
+
+/* Fire one of what is due at Due, interrupts first */
+static void
+Clock_Fire( uint64_t Due )
+{
+  CLOCK_EVENT_RECORD  Event;
+  size_t              Index;
+
+  if ( Clock_Isr_Allowed() )
+  {
+    if ( Timer0_Due == Due )
+    {
+      /* One shot, the handler writes the next compare */
+      Timer0_Due = CLOCK_NEVER;
+      if ( Timer0_Func != NULL )
+      {
+        Clock_Isr( Timer0_Func );
+      }
+      return;
+    }
+
+    if ( Timer1_Due == Due )
+    {
+      Timer1_Due = Timer1_Reload ? (Due + Timer1_Period) : CLOCK_NEVER;
+      if ( Timer1_Func != NULL )
+      {
+        Clock_Isr( Timer1_Func );
+      }
+      return;
+    }
+
+    if ( !Clock_Events.empty() && (Clock_Events.begin()->first == Due) )
+    {
+      Event = Clock_Events.begin()->second;
+      Clock_Events.erase( Clock_Events.begin() );
+      Clock_In_Isr = true;
+      Event.pFunc( Event.pContext );
+      Clock_In_Isr = false;
+      return;
+    }
+  }
+
+  for ( Index = 0; Index < Clock_Scheduled.size(); Index++ )
+  {
+    if ( Clock_Scheduled[Index].due == Due )
+    {
+      std::function<bool(void)>   Func = Clock_Scheduled[Index].func;
+
+      Clock_In_Scheduled = true;
+      bool Again = Func() && ( Clock_Scheduled[Index].period != 0 );
+      Clock_In_Scheduled = false;
+
+      if ( Again )
+      {
+        Clock_Scheduled[Index].due = Due + Clock_Scheduled[Index].period;
+      }
+      else
+      {
+        Clock_Scheduled.erase( Clock_Scheduled.begin() + Index );
+      }
+      return;
+    }
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Clock_Hold_Pace( void )
+{
+  struct timespec Now;
+  double          Real_us;
+  double          Virtual_us;
+
+  if ( Clock_Pace <= 0 )
+  {
+    return;
+  }
+
+  clock_gettime( CLOCK_MONOTONIC, &Now );
+  Real_us    = (Now.tv_sec - Clock_Real_Start.tv_sec) * 1e6 + (Now.tv_nsec - Clock_Real_Start.tv_nsec) / 1e3;
+  Virtual_us = (double)(Clock_Cycles - Clock_Pace_Start) / SIM_CPU_MHZ / Clock_Pace;
+  if ( Virtual_us > Real_us + 1000 )
+  {
+    struct timespec Wait;
+    uint64_t        Wait_us = (uint64_t)(Virtual_us - Real_us);
+
+    Wait.tv_sec  = Wait_us / 1000000;
+    Wait.tv_nsec = (Wait_us % 1000000) * 1000;
+    nanosleep( &Wait, NULL );
+  }
+}
+
+/*===========================================================================*/
+
+uint64_t
+Sim_Clock_Cycles( void )
+{
+  return Clock_Cycles;
+}
+
+/*===========================================================================*/
+
+uint64_t
+Sim_Clock_Us( void )
+{
+  return Clock_Cycles / SIM_CPU_MHZ;
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  Move the clock to Cycles, what falls due on the way fires at its time
+@param  Cycles    Where to, nothing if it is in the past, (I)
+*/
+void
+Sim_Clock_Run_Until( uint64_t Cycles )
+{
+  uint64_t  Due;
+  size_t    Index;
+
+  while ( (Due = Clock_Next_Due()) <= Cycles )
+  {
+    if ( Due > Clock_Cycles )
+    {
+      Clock_Cycles = Due;
+    }
+    Clock_Fire( Due );
+  }
+
+  if ( Cycles > Clock_Cycles )
+  {
+    Clock_Cycles = Cycles;
+  }
+
+  if ( !Clock_In_Isr && (Clock_Cycles - Clock_Polled >= CLOCK_POLL_CYCLES) )
+  {
+    Clock_Polled = Clock_Cycles;
+    for ( Index = 0; Index < Clock_Polls.size(); Index++ )
+    {
+      Clock_Polls[Index]();
+    }
+  }
+
+  Clock_Hold_Pace();
+}
+
+/*===========================================================================*/
+
+void
+Sim_Clock_Advance( uint64_t Us )
+{
+  Sim_Clock_Run_Until( Clock_Cycles + Us * SIM_CPU_MHZ );
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  Call a function at a time, as an interrupt
+@param  Cycles    When, (I)
+@param  pFunc     The function, (I)
+@param  pContext  For it, (I)
+*/
+void
+Sim_Clock_At( uint64_t Cycles, SIM_EVENT_FUNC pFunc, void *pContext )
+{
+  CLOCK_EVENT_RECORD  Event = { pFunc, pContext };
+
+  Clock_Events.insert( std::make_pair( Cycles, Event ) );
+}
+
+/*===========================================================================*/
+
+void
+Sim_Clock_Add_Poll( SIM_POLL_FUNC pFunc )
+{
+  Clock_Polls.push_back( pFunc );
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  Hold the clock back to a multiple of real time
+@param  Speed   Virtual seconds a real second, 0 for as fast as it goes, (I)
+*/
+void
+Sim_Clock_Set_Pace( double Speed )
+{
+  Clock_Pace        = Speed;
+  Clock_Pace_Start  = Clock_Cycles;
+  clock_gettime( CLOCK_MONOTONIC, &Clock_Real_Start );
+}
+
+/*===========================================================================*/
+
+unsigned long
+millis( void )
+{
+  return (uint32_t)( Clock_Cycles / SIM_CYCLES_PER_MS );
+}
+
+/*===========================================================================*/
+
+unsigned long
+micros( void )
+{
+  return (uint32_t)( Clock_Cycles / SIM_CPU_MHZ );
+}
+
+/*===========================================================================*/
+
+uint32_t
+EspClass::getCycleCount( void )
+{
+  return (uint32_t)( Clock_Cycles++ );
+}
+
+/*===========================================================================*/
+
+void
+delay( unsigned long Ms )
+{
+  Sim_Clock_Run_Until( Clock_Cycles + Ms * SIM_CYCLES_PER_MS );
+}
+
+/*===========================================================================*/
+
+void
+delayMicroseconds( unsigned int Us )
+{
+  Sim_Clock_Run_Until( Clock_Cycles + (uint64_t)Us * SIM_CPU_MHZ );
+}
+
+/*===========================================================================*/
+
+void
+yield( void )
+{
+  Sim_Clock_Run_Until( Clock_Cycles + CLOCK_YIELD_CYCLES );
+}
+
+/*===========================================================================*/
+
+uint32_t
+xt_rsil( uint32_t Level )
+{
+  uint32_t  Old = Clock_Int_Level;
+
+  Clock_Int_Level = Level;
+
+  return Old;
+}
+
+/*===========================================================================*/
+
+void
+xt_wsr_ps( uint32_t State )
+{
+  Clock_Int_Level = State & 0x0f;
+
+  /* What came in while masked is taken now */
+  if ( Clock_Isr_Allowed() )
+  {
+    Sim_Clock_Run_Until( Clock_Cycles );
+  }
+}
+
+/*===========================================================================*/
+
+void
+noInterrupts( void )
+{
+  xt_rsil( 15 );
+}
+
+/*===========================================================================*/
+
+void
+interrupts( void )
+{
+  xt_wsr_ps( 0 );
+}
+
+/*===========================================================================*/
+
+void
+timer0_isr_init( void )
+{
+}
+
+/*===========================================================================*/
+
+void
+timer0_attachInterrupt( timercallback pFunc )
+{
+  Timer0_Func = pFunc;
+}
+
+/*===========================================================================*/
+
+void
+timer0_detachInterrupt( void )
+{
+  Timer0_Func = NULL;
+  Timer0_Due  = CLOCK_NEVER;
+}
+
+/*===========================================================================*/
+
+/* The compare is against the low 32 bits, a count passed already comes
+   round after 2^32 cycles as on the chip */
+void
+timer0_write( uint32_t Count )
+{
+  Timer0_Due = Clock_Cycles + (uint32_t)( Count - (uint32_t)Clock_Cycles );
+}
+
+/*===========================================================================*/
+
+void
+timer1_isr_init( void )
+{
+}
+
+/*===========================================================================*/
+
+void
+timer1_attachInterrupt( timercallback pFunc )
+{
+  Timer1_Func = pFunc;
+}
+
+/*===========================================================================*/
+
+void
+timer1_detachInterrupt( void )
+{
+  Timer1_Func = NULL;
+}
+
+/*===========================================================================*/
+
+void
+timer1_enable( uint8_t Divider, uint8_t Int_Type, uint8_t Reload )
+{
+  (void)Int_Type;
+
+  Timer1_Divider  = ( Divider == TIM_DIV256 ) ? 256 : ( Divider == TIM_DIV16 ) ? 16 : 1;
+  Timer1_Reload   = ( Reload == TIM_LOOP );
+  Timer1_Enabled  = true;
+}
+
+/*===========================================================================*/
+
+void
+timer1_disable( void )
+{
+  Timer1_Enabled  = false;
+  Timer1_Due      = CLOCK_NEVER;
+}
+
+/*===========================================================================*/
+
+void
+timer1_write( uint32_t Ticks )
+{
+  Timer1_Period = (uint64_t)Ticks * Timer1_Divider;
+  Timer1_Due    = Timer1_Enabled ? (Clock_Cycles + Timer1_Period) : CLOCK_NEVER;
+}
+
+/*===========================================================================*/
+
+bool
+schedule_recurrent_function_us( const std::function<bool(void)> &fn, uint32_t repeat_us,
+                                const std::function<bool(void)> &alarm )
+{
+  CLOCK_SCHEDULED_RECORD  Scheduled;
+
+  (void)alarm;
+
+  Scheduled.func    = fn;
+  Scheduled.period  = (uint64_t)max( repeat_us, (uint32_t)1 ) * SIM_CPU_MHZ;
+  Scheduled.due     = Clock_Cycles + Scheduled.period;
+  Clock_Scheduled.push_back( Scheduled );
+
+  return true;
+}
+
+/*===========================================================================*/
+
+bool
+schedule_function( const std::function<void(void)> &fn )
+{
+  CLOCK_SCHEDULED_RECORD  Scheduled;
+
+  Scheduled.func    = [fn]() { fn(); return false; };
+  Scheduled.period  = 0;
+  Scheduled.due     = Clock_Cycles;
+  Clock_Scheduled.push_back( Scheduled );
+
+  return true;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,885 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   core.cpp
+@brief  Host build, String, Serial and the rest of the core
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+String grows on the heap as the core's does, so what the firmware
+allocates through it is allocated here too. The heap the firmware sees is
+SIM_HEAP_SIZE less what the process has allocated since the start, from
+mallinfo2(), the largest block is all of it. ESP.restart() ends the run,
+see Sim_Set_Restart_Handler(), the storage is kept for the next one.
+
+Random numbers are one seeded sequence, so a run is the same every time.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <malloc.h>
+#include <ctype.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Free heap of the firmware at boot, about that of a real one */
+#define SIM_HEAP_SIZE         48000
+
+/* Longest format of the _P printfs, on the stack, the heap is the firmware's */
+#define CORE_FORMAT_SIZE      512
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static FILE     *Core_Serial_Out    = NULL;
+static uint32_t Core_Random_State   = 1;
+static uint32_t Core_Chip_Id        = 0x00c0ffee;
+static size_t   Core_Heap_Base      = 0;
+static bool     Core_Heap_Base_Set  = false;
+static void     (*pCore_Restart)( void ) = NULL;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+HardwareSerial  Serial;
+EspClass        ESP;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static uint32_t Core_Random( void );
+static size_t   Core_Heap_Used( void );
+static const char *Core_Format_P( const char *pFormat, char *pBuff );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* xorshift32 */
+static uint32_t
+Core_Random( void )
+{
+  Core_Random_State ^= Core_Random_State << 13;
+  Core_Random_State ^= Core_Random_State >> 17;
+  Core_Random_State ^= Core_Random_State << 5;
+
+  return Core_Random_State;
+}
+
+/*===========================================================================*/
+
+/* Bytes allocated since the first look */
+static size_t
+Core_Heap_Used( void )
+{
+  struct mallinfo2  Info = mallinfo2();
+
+  if ( !Core_Heap_Base_Set )
+  {
+    Core_Heap_Base      = Info.uordblks;
+    Core_Heap_Base_Set  = true;
+  }
+
+  return ( Info.uordblks > Core_Heap_Base ) ? (Info.uordblks - Core_Heap_Base) : 0;
+}
+
+/*===========================================================================*/
+
+/* The format with %S as %s, pFormat itself if it has none or is too long */
+static const char *
+Core_Format_P( const char *pFormat, char *pBuff )
+{
+  size_t  Len = strlen( pFormat );
+  size_t  Pos;
+
+  if ( (strchr( pFormat, 'S' ) == NULL) || (Len >= CORE_FORMAT_SIZE) )
+  {
+    return pFormat;
+  }
+
+  memcpy( pBuff, pFormat, Len + 1 );
+  for ( Pos = 0; Pos < Len; Pos++ )
+  {
+    if ( pBuff[Pos] != '%' )
+    {
+      continue;
+    }
+
+    /* Flags, width, precision and length up to the conversion, %% too */
+    Pos++;
+    while ( (pBuff[Pos] != '\0') && (strchr( "-+ #0123456789.*hlLqjzt", pBuff[Pos] ) != NULL) )
+    {
+      Pos++;
+    }
+    if ( pBuff[Pos] == 'S' )
+    {
+      pBuff[Pos] = 's';
+    }
+  }
+
+  return pBuff;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Set_Seed( uint32_t Seed )
+{
+  Core_Random_State = Seed ? Seed : 1;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Set_Chip_Id( uint32_t Chip_Id )
+{
+  Core_Chip_Id = Chip_Id;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Serial_Set_Output( FILE *pFile )
+{
+  Core_Serial_Out = pFile;
+}
+
+/*===========================================================================*/
+
+/* Called by ESP.restart(), instead of ending the process */
+void
+Sim_Set_Restart_Handler( void (*pFunc)( void ) )
+{
+  pCore_Restart = pFunc;
+}
+
+/*===========================================================================*/
+
+String::String( const char *pStr ) : pBuff( NULL ), Len( 0 ), Capacity( 0 )
+{
+  if ( pStr != NULL )
+  {
+    concat( pStr );
+  }
+}
+
+String::String( const String &Other ) : pBuff( NULL ), Len( 0 ), Capacity( 0 )
+{
+  concat( Other );
+}
+
+String::String( String &&Other ) : pBuff( Other.pBuff ), Len( Other.Len ), Capacity( Other.Capacity )
+{
+  Other.pBuff     = NULL;
+  Other.Len       = 0;
+  Other.Capacity  = 0;
+}
+
+String::String( const __FlashStringHelper *pStr ) : String( (const char *)pStr )
+{
+}
+
+String::String( char c ) : pBuff( NULL ), Len( 0 ), Capacity( 0 )
+{
+  concat( &c, 1 );
+}
+
+String::String( int Value, unsigned char Base ) : String( (long)Value, Base )
+{
+}
+
+String::String( unsigned int Value, unsigned char Base ) : String( (unsigned long)Value, Base )
+{
+}
+
+String::String( long Value, unsigned char Base ) : pBuff( NULL ), Len( 0 ), Capacity( 0 )
+{
+  if ( (Base == 10) && (Value < 0) )
+  {
+    concat( '-' );
+    *this += String( (unsigned long)-Value, Base );
+  }
+  else
+  {
+    *this = String( (unsigned long)Value, Base );
+  }
+}
+
+String::String( unsigned long Value, unsigned char Base ) : pBuff( NULL ), Len( 0 ), Capacity( 0 )
+{
+  char    Digits[72];
+  int     Pos = sizeof(Digits) - 1;
+
+  Digits[Pos] = '\0';
+  do
+  {
+    Digits[--Pos] = "0123456789abcdefghijklmnopqrstuvwxyz"[Value % Base];
+    Value /= Base;
+  } while ( Value != 0 );
+  concat( &Digits[Pos] );
+}
+
+String::String( float Value, unsigned char Decimals ) : String( (double)Value, Decimals )
+{
+}
+
+String::String( double Value, unsigned char Decimals ) : pBuff( NULL ), Len( 0 ), Capacity( 0 )
+{
+  char    Buff[64];
+
+  snprintf( Buff, sizeof(Buff), "%.*f", Decimals, Value );
+  concat( Buff );
+}
+
+String::~String()
+{
+  free( pBuff );
+}
+
+/*===========================================================================*/
+
+String &
+String::operator=( const String &Other )
+{
+  if ( this != &Other )
+  {
+    Len = 0;
+    concat( Other );
+  }
+  return *this;
+}
+
+String &
+String::operator=( String &&Other )
+{
+  if ( this != &Other )
+  {
+    free( pBuff );
+    pBuff           = Other.pBuff;
+    Len             = Other.Len;
+    Capacity        = Other.Capacity;
+    Other.pBuff     = NULL;
+    Other.Len       = 0;
+    Other.Capacity  = 0;
+  }
+  return *this;
+}
+
+String &
+String::operator=( const char *pStr )
+{
+  String  Copy( pStr );
+
+  return *this = (String &&)Copy;
+}
+
+String &
+String::operator=( const __FlashStringHelper *pStr )
+{
+  return *this = (const char *)pStr;
+}
+
+/*===========================================================================*/
+
+bool
+String::reserve( unsigned int Size )
+{
+  char  *pNew;
+
+  if ( (pBuff != NULL) && (Capacity >= Size) )
+  {
+    return true;
+  }
+
+  pNew = (char *)realloc( pBuff, Size + 1 );
+  if ( pNew == NULL )
+  {
+    return false;
+  }
+  if ( pBuff == NULL )
+  {
+    pNew[0] = '\0';
+  }
+  pBuff     = pNew;
+  Capacity  = Size;
+
+  return true;
+}
+
+/*===========================================================================*/
+
+bool
+String::concat( const char *pStr, unsigned int Add )
+{
+  if ( !reserve( Len + Add ) )
+  {
+    return false;
+  }
+
+  memmove( &pBuff[Len], pStr, Add );
+  Len += Add;
+  pBuff[Len] = '\0';
+
+  return true;
+}
+
+/*===========================================================================*/
+
+char &
+String::operator[]( unsigned int Index )
+{
+  static char   Dummy;
+
+  if ( Index >= Len )
+  {
+    Dummy = '\0';
+    return Dummy;
+  }
+  return pBuff[Index];
+}
+
+char
+String::charAt( unsigned int Index ) const
+{
+  return ( Index < Len ) ? pBuff[Index] : '\0';
+}
+
+void
+String::setCharAt( unsigned int Index, char c )
+{
+  if ( Index < Len )
+  {
+    pBuff[Index] = c;
+  }
+}
+
+/*===========================================================================*/
+
+bool
+String::equalsIgnoreCase( const String &Other ) const
+{
+  return ( Len == Other.Len ) && ( strcasecmp( c_str(), Other.c_str() ) == 0 );
+}
+
+bool
+String::startsWith( const String &Prefix ) const
+{
+  return ( Len >= Prefix.Len ) && ( memcmp( c_str(), Prefix.c_str(), Prefix.Len ) == 0 );
+}
+
+bool
+String::endsWith( const String &Suffix ) const
+{
+  return ( Len >= Suffix.Len ) && ( memcmp( c_str() + Len - Suffix.Len, Suffix.c_str(), Suffix.Len ) == 0 );
+}
+
+/*===========================================================================*/
+
+int
+String::indexOf( char c, unsigned int From ) const
+{
+  const char  *pFound;
+
+  if ( From >= Len )
+  {
+    return -1;
+  }
+  pFound = strchr( c_str() + From, c );
+
+  return pFound ? (int)(pFound - c_str()) : -1;
+}
+
+int
+String::indexOf( const String &Str, unsigned int From ) const
+{
+  const char  *pFound;
+
+  if ( From > Len )
+  {
+    return -1;
+  }
+  pFound = strstr( c_str() + From, Str.c_str() );
+
+  return pFound ? (int)(pFound - c_str()) : -1;
+}
+
+int
+String::lastIndexOf( char c ) const
+{
+  const char  *pFound = strrchr( c_str(), c );
+
+  return pFound ? (int)(pFound - c_str()) : -1;
+}
+
+/*===========================================================================*/
+
+String
+String::substring( unsigned int From, unsigned int To ) const
+{
+  String  Out;
+
+  if ( From > To )
+  {
+    unsigned int  Swap = From;
+
+    From  = To;
+    To    = Swap;
+  }
+  if ( To > Len )
+  {
+    To = Len;
+  }
+  if ( From < To )
+  {
+    Out.concat( c_str() + From, To - From );
+  }
+
+  return Out;
+}
+
+/*===========================================================================*/
+
+void
+String::replace( const String &Find, const String &With )
+{
+  String  Out;
+  int     From = 0;
+  int     Found;
+
+  if ( Find.Len == 0 )
+  {
+    return;
+  }
+
+  while ( (Found = indexOf( Find, From )) >= 0 )
+  {
+    Out.concat( c_str() + From, Found - From );
+    Out.concat( With );
+    From = Found + Find.Len;
+  }
+  Out.concat( c_str() + From, Len - From );
+
+  *this = (String &&)Out;
+}
+
+/*===========================================================================*/
+
+void
+String::remove( unsigned int Index, unsigned int Count )
+{
+  if ( Index >= Len )
+  {
+    return;
+  }
+  if ( Count > Len - Index )
+  {
+    Count = Len - Index;
+  }
+  memmove( &pBuff[Index], &pBuff[Index + Count], Len - Index - Count + 1 );
+  Len -= Count;
+}
+
+/*===========================================================================*/
+
+void
+String::trim( void )
+{
+  unsigned int  Start = 0;
+  unsigned int  End   = Len;
+
+  while ( (Start < End) && isspace( (unsigned char)pBuff[Start] ) )
+  {
+    Start++;
+  }
+  while ( (End > Start) && isspace( (unsigned char)pBuff[End - 1] ) )
+  {
+    End--;
+  }
+  *this = substring( Start, End );
+}
+
+/*===========================================================================*/
+
+void
+String::toLowerCase( void )
+{
+  for ( unsigned int Index = 0; Index < Len; Index++ )
+  {
+    pBuff[Index] = (char)tolower( (unsigned char)pBuff[Index] );
+  }
+}
+
+void
+String::toUpperCase( void )
+{
+  for ( unsigned int Index = 0; Index < Len; Index++ )
+  {
+    pBuff[Index] = (char)toupper( (unsigned char)pBuff[Index] );
+  }
+}
+
+/*===========================================================================*/
+
+String
+operator+( const String &Left, const String &Right )
+{
+  String  Out( Left );
+
+  Out.concat( Right );
+  return Out;
+}
+
+String
+operator+( const String &Left, const char *pRight )
+{
+  String  Out( Left );
+
+  Out.concat( pRight );
+  return Out;
+}
+
+String
+operator+( const char *pLeft, const String &Right )
+{
+  String  Out( pLeft );
+
+  Out.concat( Right );
+  return Out;
+}
+
+String
+operator+( const String &Left, char Right )
+{
+  String  Out( Left );
+
+  Out.concat( Right );
+  return Out;
+}
+
+/*===========================================================================*/
+
+size_t
+Print::write( const uint8_t *pBuff, size_t Size )
+{
+  size_t  Count = 0;
+
+  while ( (Count < Size) && (write( pBuff[Count] ) == 1) )
+  {
+    Count++;
+  }
+
+  return Count;
+}
+
+/*===========================================================================*/
+
+size_t
+Print::printf( const char *pFormat, ... )
+{
+  char    Buff[256];
+  char    *pOut = Buff;
+  va_list ap;
+  int     Len;
+  size_t  Written;
+
+  va_start( ap, pFormat );
+  Len = vsnprintf( Buff, sizeof(Buff), pFormat, ap );
+  va_end( ap );
+  if ( Len < 0 )
+  {
+    return 0;
+  }
+
+  if ( Len >= (int)sizeof(Buff) )
+  {
+    pOut = (char *)malloc( Len + 1 );
+    if ( pOut == NULL )
+    {
+      return 0;
+    }
+    va_start( ap, pFormat );
+    vsnprintf( pOut, Len + 1, pFormat, ap );
+    va_end( ap );
+  }
+
+  Written = write( (const uint8_t *)pOut, Len );
+  if ( pOut != Buff )
+  {
+    free( pOut );
+  }
+
+  return Written;
+}
+
+/*===========================================================================*/
+
+size_t
+Print::printf_P( const char *pFormat, ... )
+{
+  char    Buff[256];
+  va_list ap;
+  int     Len;
+
+  va_start( ap, pFormat );
+  Len = vsnprintf_P( Buff, sizeof(Buff), pFormat, ap );
+  va_end( ap );
+  if ( Len < 0 )
+  {
+    return 0;
+  }
+
+  return write( (const uint8_t *)Buff, min( (size_t)Len, sizeof(Buff) - 1 ) );
+}
+
+/*===========================================================================*/
+
+size_t
+Stream::readBytes( uint8_t *pBuff, size_t Size )
+{
+  size_t    Count = 0;
+  uint32_t  Start = millis();
+  int       c;
+
+  while ( (Count < Size) && ((millis() - Start) < Stream_Timeout_ms) )
+  {
+    c = read();
+    if ( c < 0 )
+    {
+      yield();
+      continue;
+    }
+    pBuff[Count++] = (uint8_t)c;
+  }
+
+  return Count;
+}
+
+/*===========================================================================*/
+
+size_t
+HardwareSerial::write( uint8_t c )
+{
+  return write( &c, 1 );
+}
+
+size_t
+HardwareSerial::write( const uint8_t *pBuff, size_t Size )
+{
+  return fwrite( pBuff, 1, Size, Core_Serial_Out ? Core_Serial_Out : stdout );
+}
+
+void
+HardwareSerial::flush( void )
+{
+  fflush( Core_Serial_Out ? Core_Serial_Out : stdout );
+}
+
+/*===========================================================================*/
+
+uint32_t
+EspClass::getFreeHeap( void )
+{
+  size_t  Used = Core_Heap_Used();
+
+  return ( Used < SIM_HEAP_SIZE ) ? (uint32_t)(SIM_HEAP_SIZE - Used) : 0;
+}
+
+uint32_t
+EspClass::getMaxFreeBlockSize( void )
+{
+  return getFreeHeap();
+}
+
+uint8_t
+EspClass::getHeapFragmentation( void )
+{
+  return 0;
+}
+
+void
+EspClass::getHeapStats( uint32_t *pFree, uint16_t *pMax_Block, uint8_t *pFrag )
+{
+  uint32_t  Free = getFreeHeap();
+
+  if ( pFree != NULL )
+  {
+    *pFree = Free;
+  }
+  if ( pMax_Block != NULL )
+  {
+    *pMax_Block = (uint16_t)min( Free, (uint32_t)0xffff );
+  }
+  if ( pFrag != NULL )
+  {
+    *pFrag = 0;
+  }
+}
+
+/*===========================================================================*/
+
+uint32_t
+EspClass::getChipId( void )
+{
+  return Core_Chip_Id;
+}
+
+/*===========================================================================*/
+
+uint32_t
+EspClass::random( void )
+{
+  return Core_Random();
+}
+
+/*===========================================================================*/
+
+void
+EspClass::restart( void )
+{
+  Serial.flush();
+  Sim_Storage_Restart();
+  if ( pCore_Restart != NULL )
+  {
+    pCore_Restart();
+  }
+  exit( 3 );
+}
+
+/*===========================================================================*/
+
+String
+EspClass::getResetReason( void )
+{
+  return String( getResetInfoPtr()->reason == REASON_SOFT_RESTART ? "Software/System restart" : "Power On" );
+}
+
+/*===========================================================================*/
+
+uint32_t
+EspClass::getSketchSize( void )
+{
+  return 400000;
+}
+
+uint32_t
+EspClass::getFreeSketchSpace( void )
+{
+  return 1000000 - 400000;
+}
+
+/*===========================================================================*/
+
+long
+random( long Max )
+{
+  return ( Max <= 0 ) ? 0 : (long)( Core_Random() % (uint32_t)Max );
+}
+
+long
+random( long Min, long Max )
+{
+  return ( Max <= Min ) ? Min : Min + random( Max - Min );
+}
+
+void
+randomSeed( unsigned long Seed )
+{
+  Sim_Set_Seed( (uint32_t)Seed );
+}
+
+/*===========================================================================*/
+
+int
+snprintf_P( char *pBuff, size_t Size, const char *pFormat, ... )
+{
+  va_list ap;
+  int     Len;
+
+  va_start( ap, pFormat );
+  Len = vsnprintf_P( pBuff, Size, pFormat, ap );
+  va_end( ap );
+
+  return Len;
+}
+
+int
+vsnprintf_P( char *pBuff, size_t Size, const char *pFormat, va_list ap )
+{
+  char    Format[CORE_FORMAT_SIZE];
+
+  return vsnprintf( pBuff, Size, Core_Format_P( pFormat, Format ), ap );
+}
+
+/*===========================================================================*/
+
+char *
+dtostrf( double Value, signed char Width, unsigned char Decimals, char *pBuff )
+{
+  sprintf( pBuff, "%*.*f", Width, Decimals, Value );
+  return pBuff;
+}
+
+/*===========================================================================*/
+
+/* As the core computes it, MSB first */
+uint32_t
+crc32( const void *pData, size_t Length, uint32_t Crc )
+{
+  const uint8_t   *pByte = (const uint8_t *)pData;
+  uint32_t        Bit;
+  bool            Flip;
+
+  while ( Length-- )
+  {
+    uint8_t   c = *pByte++;
+
+    for ( Bit = 0x80; Bit > 0; Bit >>= 1 )
+    {
+      Flip = ( Crc & 0x80000000 ) != 0;
+      if ( c & Bit )
+      {
+        Flip = !Flip;
+      }
+      Crc <<= 1;
+      if ( Flip )
+      {
+        Crc ^= 0x04c11db7;
+      }
+    }
+  }
+
+  return Crc;
+}
+
+/*===========================================================================*/
+
+/* The firmware keeps its own clock, see local_clock.cpp */
+void
+configTime( const char *pTz, const char *pServer1, const char *pServer2, const char *pServer3 )
+{
+  (void)pTz;
+  (void)pServer1;
+  (void)pServer2;
+  (void)pServer3;
+}
+
+/*===========================================================================*/
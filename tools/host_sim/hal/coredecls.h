@@ -0,0 +1,22 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   coredecls.h
+@brief  Host build, declarations of the core
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+crc32() is in Arduino.h.
+*/
+
+#ifndef __COREDECLS_H__
+#define __COREDECLS_H__
+
+#include <Arduino.h>
+
+#endif  /* __COREDECLS_H__ */
+
+/*===========================================================================*/
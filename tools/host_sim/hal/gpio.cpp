@@ -0,0 +1,413 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   gpio.cpp
+@brief  Host build, the pins and an HC-SR04 on two of them
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A pin is a level, written by the firmware or by the simulated sensor, and
+a count of its changes, the relay and LEDs are looked at that way. A pin
+interrupt is called at the edge as the chip would.
+
+The HC-SR04 answers a trigger pulse of 10 us or more: the echo pin rises
+SR04_ECHO_DELAY_US after the trigger falls and stays high 2 / 340 m/s of
+the distance at that moment, 58.8 us a cm. Out of its range there is no
+echo and the pin stays high for SR04_TIMEOUT_US, as the module does.
+
+The distance follows a script, points of seconds and centimetres with
+straight lines between them, from Sim_Sr04_Add_Point() or a file of
+"<seconds> <cm>" lines, # for comments. A distance of 0 is no echo.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <vector>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define GPIO_PINS             17
+
+#define SR04_TRIGGER_MIN_US   10
+#define SR04_ECHO_DELAY_US    450
+#define SR04_TIMEOUT_US       38000
+#define SR04_RANGE_MIN_CM     2
+#define SR04_RANGE_MAX_CM     400
+#define SR04_US_PER_CM        (2 * 10000.0 / 340)
+
+typedef struct
+{
+  double  time_s;
+  double  distance_cm;
+
+} SR04_POINT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static int          Gpio_Level[GPIO_PINS];
+static uint32_t     Gpio_Changes[GPIO_PINS];
+static voidFuncPtr  Gpio_Isr[GPIO_PINS];
+static int          Gpio_Isr_Mode[GPIO_PINS];
+
+static int          Sr04_Trig     = -1;
+static int          Sr04_Echo     = -1;
+static uint64_t     Sr04_Trig_Rise = 0;
+static bool         Sr04_Busy     = false;
+static uint32_t     Sr04_Pings    = 0;
+static double       Sr04_Noise_cm = 0;
+static uint32_t     Sr04_Noise_Seed = 12345;
+
+static std::vector<SR04_POINT_RECORD>  Sr04_Script;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Gpio_Change( uint8_t Pin, int Level );
+static void   Sr04_Echo_Edge( void *pContext );
+static void   Sr04_Trigger( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* A new level, and its interrupt if it has one for this edge */
+static void
+Gpio_Change( uint8_t Pin, int Level )
+{
+  int   Mode;
+
+  if ( (Pin >= GPIO_PINS) || (Gpio_Level[Pin] == Level) )
+  {
+    return;
+  }
+
+  Gpio_Level[Pin] = Level;
+  Gpio_Changes[Pin]++;
+
+  Mode = Gpio_Isr_Mode[Pin];
+  if ( (Gpio_Isr[Pin] != NULL) &&
+       ((Mode == CHANGE) || ((Mode == RISING) && Level) || ((Mode == FALLING) && !Level)) )
+  {
+    Gpio_Isr[Pin]();
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Sr04_Echo_Edge( void *pContext )
+{
+  int   Level = (int)(intptr_t)pContext;
+
+  Gpio_Change( (uint8_t)Sr04_Echo, Level );
+  if ( Level == LOW )
+  {
+    Sr04_Busy = false;
+  }
+}
+
+/*===========================================================================*/
+
+/* The trigger fell, schedule the echo */
+static void
+Sr04_Trigger( void )
+{
+  uint64_t  Now = Sim_Clock_Cycles();
+  uint64_t  Rise;
+  uint64_t  Width_us;
+  double    Distance_cm;
+  double    Noise;
+
+  if ( Sr04_Busy || ((Now - Sr04_Trig_Rise) < SR04_TRIGGER_MIN_US * SIM_CPU_MHZ) )
+  {
+    return;
+  }
+
+  Sr04_Busy = true;
+  Sr04_Pings++;
+
+  Distance_cm = Sim_Sr04_Distance();
+  if ( Sr04_Noise_cm > 0 )
+  {
+    /* Sum of uniforms, near enough to normal */
+    Noise = 0;
+    for ( int Count = 0; Count < 4; Count++ )
+    {
+      Sr04_Noise_Seed = Sr04_Noise_Seed * 1103515245 + 12345;
+      Noise += ((Sr04_Noise_Seed >> 8) & 0xffff) / 65536.0 - 0.5;
+    }
+    Distance_cm += Noise * Sr04_Noise_cm * 1.7;
+  }
+
+  if ( (Distance_cm < SR04_RANGE_MIN_CM) || (Distance_cm > SR04_RANGE_MAX_CM) )
+  {
+    Width_us = SR04_TIMEOUT_US;
+  }
+  else
+  {
+    Width_us = (uint64_t)( Distance_cm * SR04_US_PER_CM + 0.5 );
+  }
+
+  Rise = Now + SR04_ECHO_DELAY_US * SIM_CPU_MHZ;
+  Sim_Clock_At( Rise, Sr04_Echo_Edge, (void *)(intptr_t)HIGH );
+  Sim_Clock_At( Rise + Width_us * SIM_CPU_MHZ, Sr04_Echo_Edge, (void *)(intptr_t)LOW );
+}
+
+/*===========================================================================*/
+
+int
+Sim_Gpio_Level( uint8_t Pin )
+{
+  return ( Pin < GPIO_PINS ) ? Gpio_Level[Pin] : LOW;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Gpio_Changes( uint8_t Pin )
+{
+  return ( Pin < GPIO_PINS ) ? Gpio_Changes[Pin] : 0;
+}
+
+/*===========================================================================*/
+
+/* Drive an input from outside */
+void
+Sim_Gpio_Set( uint8_t Pin, int Level )
+{
+  Gpio_Change( Pin, Level ? HIGH : LOW );
+}
+
+/*===========================================================================*/
+
+void
+Sim_Sr04_Attach( uint8_t Trig_Pin, uint8_t Echo_Pin )
+{
+  Sr04_Trig = Trig_Pin;
+  Sr04_Echo = Echo_Pin;
+}
+
+/*===========================================================================*/
+
+/* Points in time order, one out of order starts the script again */
+void
+Sim_Sr04_Add_Point( double Time_s, double Distance_cm )
+{
+  SR04_POINT_RECORD   Point = { Time_s, Distance_cm };
+
+  if ( !Sr04_Script.empty() && (Sr04_Script.back().time_s > Time_s) )
+  {
+    Sr04_Script.clear();
+  }
+  Sr04_Script.push_back( Point );
+}
+
+/*===========================================================================*/
+
+bool
+Sim_Sr04_Load( const char *pPath )
+{
+  FILE    *pFile = fopen( pPath, "r" );
+  char    Line[128];
+  double  Time_s;
+  double  Distance_cm;
+
+  if ( pFile == NULL )
+  {
+    return false;
+  }
+
+  Sr04_Script.clear();
+  while ( fgets( Line, sizeof(Line), pFile ) != NULL )
+  {
+    if ( (Line[0] != '#') && (sscanf( Line, "%lf %lf", &Time_s, &Distance_cm ) == 2) )
+    {
+      Sim_Sr04_Add_Point( Time_s, Distance_cm );
+    }
+  }
+  fclose( pFile );
+
+  return !Sr04_Script.empty();
+}
+
+/*===========================================================================*/
+
+/* Spread of the readings, the standard deviation near enough */
+void
+Sim_Sr04_Set_Noise( double Noise_cm )
+{
+  Sr04_Noise_cm = Noise_cm;
+}
+
+/*===========================================================================*/
+
+/* The distance of the script now */
+double
+Sim_Sr04_Distance( void )
+{
+  double  Now_s = (double)Sim_Clock_Cycles() / (SIM_CYCLES_PER_MS * 1000);
+  size_t  Index;
+
+  if ( Sr04_Script.empty() )
+  {
+    return 0;
+  }
+  if ( Now_s <= Sr04_Script.front().time_s )
+  {
+    return Sr04_Script.front().distance_cm;
+  }
+
+  for ( Index = 1; Index < Sr04_Script.size(); Index++ )
+  {
+    const SR04_POINT_RECORD &From = Sr04_Script[Index - 1];
+    const SR04_POINT_RECORD &To   = Sr04_Script[Index];
+
+    if ( Now_s <= To.time_s )
+    {
+      if ( To.time_s == From.time_s )
+      {
+        return To.distance_cm;
+      }
+      return From.distance_cm + (To.distance_cm - From.distance_cm) * (Now_s - From.time_s) / (To.time_s - From.time_s);
+    }
+  }
+
+  return Sr04_Script.back().distance_cm;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Sr04_Pings( void )
+{
+  return Sr04_Pings;
+}
+
+/*===========================================================================*/
+
+void
+pinMode( uint8_t Pin, uint8_t Mode )
+{
+  (void)Pin;
+  (void)Mode;
+}
+
+/*===========================================================================*/
+
+void
+digitalWrite( uint8_t Pin, uint8_t Level )
+{
+  if ( Pin >= GPIO_PINS )
+  {
+    return;
+  }
+
+  if ( (Pin == Sr04_Trig) && (Level != Gpio_Level[Pin]) )
+  {
+    if ( Level )
+    {
+      Sr04_Trig_Rise = Sim_Clock_Cycles();
+    }
+    else
+    {
+      Sr04_Trigger();
+    }
+  }
+
+  Gpio_Change( Pin, Level ? HIGH : LOW );
+}
+
+/*===========================================================================*/
+
+int
+digitalRead( uint8_t Pin )
+{
+  return Sim_Gpio_Level( Pin );
+}
+
+/*===========================================================================*/
+
+void
+attachInterrupt( uint8_t Pin, voidFuncPtr pFunc, int Mode )
+{
+  if ( Pin < GPIO_PINS )
+  {
+    Gpio_Isr[Pin]       = pFunc;
+    Gpio_Isr_Mode[Pin]  = Mode;
+  }
+}
+
+/*===========================================================================*/
+
+void
+detachInterrupt( uint8_t Pin )
+{
+  if ( Pin < GPIO_PINS )
+  {
+    Gpio_Isr[Pin] = NULL;
+  }
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  Length of a pulse, the clock moves while waiting
+@param  Pin         The pin, (I)
+@param  Level       HIGH for a high pulse, (I)
+@param  Timeout_us  Most to wait for it to start, and for it to end, (I)
+@return Its length in us, 0 if none came in time
+*/
+unsigned long
+pulseIn( uint8_t Pin, uint8_t Level, unsigned long Timeout_us )
+{
+  uint64_t  Limit = Sim_Clock_Cycles() + (uint64_t)Timeout_us * SIM_CPU_MHZ;
+  uint64_t  Start;
+
+  /* The end of a pulse already going, then its start */
+  while ( (digitalRead( Pin ) == Level) && (Sim_Clock_Cycles() < Limit) )
+  {
+    delayMicroseconds( 1 );
+  }
+  while ( (digitalRead( Pin ) != Level) && (Sim_Clock_Cycles() < Limit) )
+  {
+    delayMicroseconds( 1 );
+  }
+  if ( digitalRead( Pin ) != Level )
+  {
+    return 0;
+  }
+
+  Start = Sim_Clock_Cycles();
+  Limit = Start + (uint64_t)Timeout_us * SIM_CPU_MHZ;
+  while ( (digitalRead( Pin ) == Level) && (Sim_Clock_Cycles() < Limit) )
+  {
+    delayMicroseconds( 1 );
+  }
+  if ( digitalRead( Pin ) == Level )
+  {
+    return 0;
+  }
+
+  return (unsigned long)( (Sim_Clock_Cycles() - Start) / SIM_CPU_MHZ );
+}
+
+/*===========================================================================*/
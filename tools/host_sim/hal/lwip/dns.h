@@ -0,0 +1,53 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   dns.h
+@brief  Host build, the lwIP resolver
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Answered by wifi.cpp, every name is the host's loopback.
+*/
+
+#ifndef __LWIP_DNS_H__
+#define __LWIP_DNS_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+typedef struct
+{
+  uint32_t  addr;
+
+} ip_addr_t;
+
+typedef int8_t  err_t;
+
+#define ERR_OK            0
+#define ERR_TIMEOUT       -3
+#define ERR_RTE           -4
+#define ERR_INPROGRESS    -5
+#define ERR_ARG           -16
+
+typedef void (*dns_found_callback)( const char *name, const ip_addr_t *ipaddr, void *callback_arg );
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern err_t
+dns_gethostbyname( const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg );
+
+#endif  /* __LWIP_DNS_H__ */
+
+/*===========================================================================*/
@@ -0,0 +1,103 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sim.h
+@brief  Host build, control of the simulated board
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+What the simulation runner and the host checks set up and look at, the
+firmware itself only sees the Arduino API.
+
+Time is virtual, in cycles of the 80 MHz CPU. It moves when the firmware
+waits, delay(), delayMicroseconds(), pulseIn(), and when the runner calls
+Sim_Clock_Advance() between two loop(). A busy wait on ESP.getCycleCount()
+moves it a cycle a call. As it moves the timer and pin interrupts come in
+at their time, then the functions of schedule_recurrent_function_us() and
+the pollers of the stand-ins run.
+*/
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define SIM_CPU_MHZ             80
+#define SIM_CYCLES_PER_MS       (SIM_CPU_MHZ * 1000ULL)
+
+/* A Sim_Clock_At() callback and a poller */
+typedef void (*SIM_EVENT_FUNC)( void *pContext );
+typedef void (*SIM_POLL_FUNC)( void );
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+/* Clock, clock.cpp */
+extern uint64_t   Sim_Clock_Cycles( void );
+extern uint64_t   Sim_Clock_Us( void );
+extern void       Sim_Clock_Advance( uint64_t Us );
+extern void       Sim_Clock_Run_Until( uint64_t Cycles );
+extern void       Sim_Clock_At( uint64_t Cycles, SIM_EVENT_FUNC pFunc, void *pContext );
+extern void       Sim_Clock_Add_Poll( SIM_POLL_FUNC pFunc );
+extern void       Sim_Clock_Set_Pace( double Speed );
+
+/* Pins and the HC-SR04, gpio.cpp */
+extern int        Sim_Gpio_Level( uint8_t Pin );
+extern uint32_t   Sim_Gpio_Changes( uint8_t Pin );
+extern void       Sim_Gpio_Set( uint8_t Pin, int Level );
+extern void       Sim_Sr04_Attach( uint8_t Trig_Pin, uint8_t Echo_Pin );
+extern void       Sim_Sr04_Add_Point( double Time_s, double Distance_cm );
+extern bool       Sim_Sr04_Load( const char *pPath );
+extern void       Sim_Sr04_Set_Noise( double Noise_cm );
+extern double     Sim_Sr04_Distance( void );
+extern uint32_t   Sim_Sr04_Pings( void );
+
+/* Wi-Fi and sockets, wifi.cpp */
+extern int        Sim_Wifi_Add_Ap( const char *pSsid, int Rssi, uint8_t Channel );
+extern void       Sim_Wifi_Set_Rssi( const char *pSsid, int Rssi );
+extern void       Sim_Wifi_Set_Ap_Rssi( int Ap, int Rssi );
+extern void       Sim_Wifi_Drop( void );
+extern const char *Sim_Wifi_Ssid( void );
+extern int        Sim_Wifi_Ap( void );
+extern uint32_t   Sim_Wifi_Connects( void );
+extern void       Sim_Net_Map( uint16_t Device_Port, uint16_t Host_Port );
+extern uint16_t   Sim_Net_Host_Port( uint16_t Device_Port );
+extern int        Sim_Net_Listen( uint16_t Port, bool Udp );
+extern uint16_t   Sim_Net_Local_Port( int Fd );
+extern void       Sim_Net_Internet( bool Up );
+extern uint32_t   Sim_Net_Dns_Lookups( void );
+extern void       Sim_Net_Fail_Writes( uint32_t Count );
+extern uint32_t   Sim_Net_Failing_Writes( void );
+
+/* Web server, web_server.cpp */
+extern uint16_t   Sim_Web_Port( void );
+extern void       Sim_Web_Set_Port( uint16_t Port );
+
+/* EEPROM, RTC memory, flash and LittleFS, storage.cpp */
+extern void       Sim_Storage_Set_Dir( const char *pDir );
+extern const char *Sim_Storage_Dir( void );
+extern bool       Sim_Storage_Restarted( void );
+extern void       Sim_Storage_Restart( void );
+
+/* The rest of the board, core.cpp */
+extern void       Sim_Set_Seed( uint32_t Seed );
+extern void       Sim_Set_Chip_Id( uint32_t Chip_Id );
+extern void       Sim_Serial_Set_Output( FILE *pFile );
+extern void       Sim_Set_Restart_Handler( void (*pFunc)( void ) );
+
+#endif  /* __SIM_H__ */
+
+/*===========================================================================*/
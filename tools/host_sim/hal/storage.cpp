@@ -0,0 +1,583 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   storage.cpp
+@brief  Host build, EEPROM, RTC memory, flash and LittleFS
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+All of it in one storage directory, kept from a run to the next as the
+chip keeps it over a reset:
+
+  eeprom.bin    The EEPROM, written by EEPROM.commit()
+  rtc.bin       The RTC user memory, written by ESP.restart()
+  restarted     Left by ESP.restart(), the next run is a soft restart
+  flash.bin     The firmware image ESP.flashRead() reads, if there is one
+  littlefs/     LittleFS
+
+RTC memory only survives a restart, a run that doesn't follow one starts
+from power on with it full of noise. Without Sim_Storage_Set_Dir() the
+directory is a new one under /tmp.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <LittleFS.h>
+#include <Updater.h>
+#include <string>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* 128 blocks as on the chip, a block is a UINT32 of the firmware, 8 bytes
+   here, so its records of UINT32 keep their offsets apart */
+#define STORAGE_RTC_BLOCK   sizeof(unsigned long)
+#define STORAGE_RTC_SIZE    (128 * STORAGE_RTC_BLOCK)
+
+/* The addresses of the RTC memory, the SDK's 64 system blocks, then the
+   user blocks */
+#define STORAGE_RTC_SYSTEM_ADDR   0x60001100
+#define STORAGE_RTC_USER_ADDR     0x60001200
+#define STORAGE_RTC_END_ADDR      (STORAGE_RTC_USER_ADDR + 128 * 4)
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static std::string  Storage_Dir;
+static bool         Storage_Loaded    = false;
+static bool         Storage_Restarted = false;
+static uint8_t      Storage_Rtc[STORAGE_RTC_SIZE] __attribute__((aligned(sizeof(unsigned long))));
+static unsigned long Storage_Rtc_System[64];
+static rst_info     Storage_Reset_Info;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+EEPROMClass   EEPROM;
+fs::FS        LittleFS;
+UpdaterClass  Update;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void         Storage_Load( void );
+static std::string  Storage_Path( const char *pName );
+static bool         Storage_Make_Dirs( const std::string &Path );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+void
+Sim_Storage_Set_Dir( const char *pDir )
+{
+  Storage_Dir     = pDir;
+  Storage_Loaded  = false;
+  Storage_Make_Dirs( Storage_Dir + "/littlefs" );
+}
+
+/*===========================================================================*/
+
+const char *
+Sim_Storage_Dir( void )
+{
+  if ( Storage_Dir.empty() )
+  {
+    char  Temp[] = "/tmp/host_sim.XXXXXX";
+
+    Sim_Storage_Set_Dir( mkdtemp( Temp ) ? Temp : "/tmp" );
+  }
+
+  return Storage_Dir.c_str();
+}
+
+/*===========================================================================*/
+
+bool
+Sim_Storage_Restarted( void )
+{
+  Storage_Load();
+  return Storage_Restarted;
+}
+
+/*===========================================================================*/
+
+/* Keep the RTC memory for the next run, it is a soft restart */
+void
+Sim_Storage_Restart( void )
+{
+  FILE  *pFile;
+
+  Storage_Load();
+  pFile = fopen( Storage_Path( "rtc.bin" ).c_str(), "wb" );
+  if ( pFile != NULL )
+  {
+    fwrite( Storage_Rtc, 1, sizeof(Storage_Rtc), pFile );
+    fclose( pFile );
+  }
+  pFile = fopen( Storage_Path( "restarted" ).c_str(), "w" );
+  if ( pFile != NULL )
+  {
+    fclose( pFile );
+  }
+}
+
+/*===========================================================================*/
+
+static std::string
+Storage_Path( const char *pName )
+{
+  return std::string( Sim_Storage_Dir() ) + "/" + pName;
+}
+
+/*===========================================================================*/
+
+/* mkdir -p of the directories of a path, and of the path */
+static bool
+Storage_Make_Dirs( const std::string &Path )
+{
+  size_t  Slash;
+
+  for ( Slash = Path.find( '/', 1 ); Slash != std::string::npos; Slash = Path.find( '/', Slash + 1 ) )
+  {
+    ::mkdir( Path.substr( 0, Slash ).c_str(), 0755 );
+  }
+
+  return ( ::mkdir( Path.c_str(), 0755 ) == 0 ) || ( errno == EEXIST );
+}
+
+/*===========================================================================*/
+
+/* The RTC memory, and why this run started */
+static void
+Storage_Load( void )
+{
+  FILE    *pFile;
+  size_t  Index;
+
+  if ( Storage_Loaded )
+  {
+    return;
+  }
+  Storage_Loaded = true;
+
+  Storage_Restarted = ( access( Storage_Path( "restarted" ).c_str(), F_OK ) == 0 );
+  unlink( Storage_Path( "restarted" ).c_str() );
+
+  for ( Index = 0; Index < sizeof(Storage_Rtc); Index++ )
+  {
+    Storage_Rtc[Index] = (uint8_t)( ESP.random() >> 7 );
+  }
+  pFile = Storage_Restarted ? fopen( Storage_Path( "rtc.bin" ).c_str(), "rb" ) : NULL;
+  if ( pFile != NULL )
+  {
+    if ( fread( Storage_Rtc, 1, sizeof(Storage_Rtc), pFile ) != sizeof(Storage_Rtc) )
+    {
+      Storage_Restarted = false;
+    }
+    fclose( pFile );
+  }
+
+  memset( &Storage_Reset_Info, 0, sizeof(Storage_Reset_Info) );
+  Storage_Reset_Info.reason = Storage_Restarted ? REASON_SOFT_RESTART : REASON_DEFAULT_RST;
+}
+
+/*===========================================================================*/
+
+/* Offset in blocks, as the SDK has it */
+bool
+EspClass::rtcUserMemoryRead( uint32_t Offset, uint32_t *pData, size_t Size )
+{
+  Storage_Load();
+  if ( (Offset * STORAGE_RTC_BLOCK + Size) > sizeof(Storage_Rtc) )
+  {
+    return false;
+  }
+
+  memcpy( pData, &Storage_Rtc[Offset * STORAGE_RTC_BLOCK], Size );
+  return true;
+}
+
+bool
+EspClass::rtcUserMemoryWrite( uint32_t Offset, uint32_t *pData, size_t Size )
+{
+  Storage_Load();
+  if ( (Offset * STORAGE_RTC_BLOCK + Size) > sizeof(Storage_Rtc) )
+  {
+    return false;
+  }
+
+  memcpy( &Storage_Rtc[Offset * STORAGE_RTC_BLOCK], pData, Size );
+  return true;
+}
+
+/* A word written by address, as from an interrupt. The system blocks aren't
+   kept, nothing of the firmware reads them back */
+volatile unsigned long *
+rtc_memory_word( uint32_t Addr )
+{
+  if ( (Addr < STORAGE_RTC_SYSTEM_ADDR) || (Addr >= STORAGE_RTC_END_ADDR) || ((Addr & 3) != 0) )
+  {
+    fprintf( stderr, "host_sim: no RTC memory at 0x%08x\n", Addr );
+    abort();
+  }
+
+  if ( Addr < STORAGE_RTC_USER_ADDR )
+  {
+    return &Storage_Rtc_System[(Addr - STORAGE_RTC_SYSTEM_ADDR) / 4];
+  }
+
+  Storage_Load();
+  return (volatile unsigned long *)&Storage_Rtc[((Addr - STORAGE_RTC_USER_ADDR) / 4) * STORAGE_RTC_BLOCK];
+}
+
+rst_info *
+EspClass::getResetInfoPtr( void )
+{
+  Storage_Load();
+  return &Storage_Reset_Info;
+}
+
+/*===========================================================================*/
+
+bool
+EspClass::flashRead( uint32_t Offset, uint8_t *pData, size_t Size )
+{
+  FILE    *pFile = fopen( Storage_Path( "flash.bin" ).c_str(), "rb" );
+  size_t  Got    = 0;
+
+  memset( pData, 0xff, Size );
+  if ( pFile != NULL )
+  {
+    if ( fseek( pFile, Offset, SEEK_SET ) == 0 )
+    {
+      Got = fread( pData, 1, Size, pFile );
+    }
+    fclose( pFile );
+  }
+  (void)Got;
+
+  return true;
+}
+
+bool
+EspClass::flashRead( uint32_t Offset, uint32_t *pData, size_t Size )
+{
+  return flashRead( Offset, (uint8_t *)pData, Size );
+}
+
+/*===========================================================================*/
+
+void
+EEPROMClass::begin( size_t New_Size )
+{
+  FILE    *pFile;
+
+  if ( (pData != NULL) && (Size == New_Size) )
+  {
+    return;
+  }
+
+  free( pData );
+  pData = (uint8_t *)malloc( New_Size );
+  Size  = New_Size;
+  Dirty = false;
+  memset( pData, 0xff, Size );
+
+  pFile = fopen( Storage_Path( "eeprom.bin" ).c_str(), "rb" );
+  if ( pFile != NULL )
+  {
+    if ( fread( pData, 1, Size, pFile ) == 0 )
+    {
+      memset( pData, 0xff, Size );
+    }
+    fclose( pFile );
+  }
+}
+
+uint8_t
+EEPROMClass::read( int Address )
+{
+  return ( (Address >= 0) && ((size_t)Address < Size) ) ? pData[Address] : 0;
+}
+
+void
+EEPROMClass::write( int Address, uint8_t Value )
+{
+  if ( (Address >= 0) && ((size_t)Address < Size) && (pData[Address] != Value) )
+  {
+    pData[Address]  = Value;
+    Dirty           = true;
+  }
+}
+
+/* Nothing changed is nothing written, as the core does */
+bool
+EEPROMClass::commit( void )
+{
+  FILE    *pFile;
+  bool    Ok;
+
+  if ( pData == NULL )
+  {
+    return false;
+  }
+  if ( !Dirty )
+  {
+    return true;
+  }
+
+  pFile = fopen( Storage_Path( "eeprom.bin" ).c_str(), "wb" );
+  if ( pFile == NULL )
+  {
+    return false;
+  }
+  Ok = ( fwrite( pData, 1, Size, pFile ) == Size );
+  fclose( pFile );
+
+  Dirty = false;
+  Commits++;
+
+  return Ok;
+}
+
+/*===========================================================================*/
+
+namespace fs
+{
+
+File::File( FILE *pFile, const String &Name )
+  : pHandle( new FILE *( pFile ), []( FILE **ppFile ) { if ( *ppFile ) fclose( *ppFile ); delete ppFile; } ),
+    Name( Name )
+{
+}
+
+size_t
+File::size( void )
+{
+  struct stat   Info;
+
+  if ( !*this || (fstat( fileno( *pHandle ), &Info ) != 0) )
+  {
+    return 0;
+  }
+  fflush( *pHandle );
+  fstat( fileno( *pHandle ), &Info );
+
+  return (size_t)Info.st_size;
+}
+
+size_t
+File::position( void )
+{
+  return *this ? (size_t)ftell( *pHandle ) : 0;
+}
+
+bool
+File::seek( uint32_t Pos, SeekMode Mode )
+{
+  return *this && ( fseek( *pHandle, Pos, (Mode == SeekSet) ? SEEK_SET : (Mode == SeekCur) ? SEEK_CUR : SEEK_END ) == 0 );
+}
+
+int
+File::read( void )
+{
+  uint8_t   c;
+
+  return ( read( &c, 1 ) == 1 ) ? c : -1;
+}
+
+size_t
+File::read( uint8_t *pBuff, size_t Size )
+{
+  return *this ? fread( pBuff, 1, Size, *pHandle ) : 0;
+}
+
+int
+File::available( void )
+{
+  size_t  Pos = position();
+  size_t  All = size();
+
+  return ( All > Pos ) ? (int)(All - Pos) : 0;
+}
+
+size_t
+File::write( const uint8_t *pBuff, size_t Size )
+{
+  return *this ? fwrite( pBuff, 1, Size, *pHandle ) : 0;
+}
+
+void
+File::flush( void )
+{
+  if ( *this )
+  {
+    fflush( *pHandle );
+  }
+}
+
+/* Closed for all the copies, as the core's */
+void
+File::close( void )
+{
+  if ( *this )
+  {
+    fclose( *pHandle );
+    *pHandle = NULL;
+  }
+  pHandle.reset();
+}
+
+/*===========================================================================*/
+
+size_t
+Dir::fileSize( void )
+{
+  struct stat   Info;
+  std::string   Full = std::string( Path.c_str() ) + "/" + fileName().c_str();
+
+  return ( stat( Full.c_str(), &Info ) == 0 ) ? (size_t)Info.st_size : 0;
+}
+
+bool
+Dir::isFile( void )
+{
+  struct stat   Info;
+  std::string   Full = std::string( Path.c_str() ) + "/" + fileName().c_str();
+
+  return ( stat( Full.c_str(), &Info ) == 0 ) && S_ISREG( Info.st_mode );
+}
+
+/*===========================================================================*/
+
+bool
+FS::begin( void )
+{
+  return Storage_Make_Dirs( Storage_Path( "littlefs" ) );
+}
+
+bool
+FS::format( void )
+{
+  std::string   Command = "rm -rf '" + Storage_Path( "littlefs" ) + "'";
+
+  if ( system( Command.c_str() ) != 0 )
+  {
+    return false;
+  }
+  return begin();
+}
+
+/* Directories are made on the way, as LittleFS does */
+File
+FS::open( const char *pPath, const char *pMode )
+{
+  std::string   Full = Storage_Path( "littlefs" ) + pPath;
+  std::string   Mode = pMode;
+  FILE          *pFile;
+
+  if ( Mode.find_first_of( "wa" ) != std::string::npos )
+  {
+    Storage_Make_Dirs( Full.substr( 0, Full.rfind( '/' ) ) );
+  }
+  if ( Mode.find( 'b' ) == std::string::npos )
+  {
+    Mode += "b";
+  }
+
+  pFile = fopen( Full.c_str(), Mode.c_str() );
+  if ( pFile == NULL )
+  {
+    return File();
+  }
+
+  return File( pFile, String( strrchr( pPath, '/' ) ? strrchr( pPath, '/' ) + 1 : pPath ) );
+}
+
+bool
+FS::exists( const char *pPath )
+{
+  return access( (Storage_Path( "littlefs" ) + pPath).c_str(), F_OK ) == 0;
+}
+
+bool
+FS::remove( const char *pPath )
+{
+  return unlink( (Storage_Path( "littlefs" ) + pPath).c_str() ) == 0;
+}
+
+bool
+FS::rename( const char *pFrom, const char *pTo )
+{
+  return ::rename( (Storage_Path( "littlefs" ) + pFrom).c_str(), (Storage_Path( "littlefs" ) + pTo).c_str() ) == 0;
+}
+
+bool
+FS::mkdir( const char *pPath )
+{
+  return Storage_Make_Dirs( Storage_Path( "littlefs" ) + pPath );
+}
+
+/* The names in a directory, in no particular order as LittleFS */
+Dir
+FS::openDir( const char *pPath )
+{
+  std::string           Full = Storage_Path( "littlefs" ) + pPath;
+  std::vector<String>   Names;
+  DIR                   *pDir = opendir( Full.c_str() );
+  struct dirent         *pEntry;
+
+  if ( pDir != NULL )
+  {
+    while ( (pEntry = readdir( pDir )) != NULL )
+    {
+      if ( pEntry->d_name[0] != '.' )
+      {
+        Names.push_back( String( pEntry->d_name ) );
+      }
+    }
+    closedir( pDir );
+  }
+
+  return Dir( String( Full.c_str() ), Names );
+}
+
+}
+
+/*===========================================================================*/
+
+bool
+UpdaterClass::begin( size_t Size, int Command, int Led_Pin, uint8_t Led_On )
+{
+  (void)Size;
+  (void)Command;
+  (void)Led_Pin;
+  (void)Led_On;
+  return false;
+}
+
+/*===========================================================================*/
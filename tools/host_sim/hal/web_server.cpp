@@ -0,0 +1,592 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   web_server.cpp
+@brief  Host build, the web server on the host's loopback
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+See ESP8266WebServer.h. A request is read whole at the accept, waiting up
+to WEB_READ_TIMEOUT_MS of real time for the rest of it, a client on the
+host is never as slow as one on Wi-Fi.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <ESP8266WebServer.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define WEB_READ_TIMEOUT_MS     2000
+#define WEB_REQUEST_MAX_SIZE    16384
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static uint16_t   Web_Host_Port   = 0;
+static uint16_t   Web_Bound_Port  = 0;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static const char *Web_Reason( int Code );
+static String     Web_Decode( const String &Encoded );
+static String     Web_Base64( const String &Plain );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Host port of the next begin(), 0 for any free one */
+void
+Sim_Web_Set_Port( uint16_t Port )
+{
+  Web_Host_Port = Port;
+}
+
+/*===========================================================================*/
+
+/* Host port served on */
+uint16_t
+Sim_Web_Port( void )
+{
+  return Web_Bound_Port;
+}
+
+/*===========================================================================*/
+
+static const char *
+Web_Reason( int Code )
+{
+  switch ( Code )
+  {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 302: return "Found";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 409: return "Conflict";
+    case 429: return "Too Many Requests";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default:  return "";
+  }
+}
+
+/*===========================================================================*/
+
+/* %xx and + of a form */
+static String
+Web_Decode( const String &Encoded )
+{
+  String        Out;
+  unsigned int  Index;
+  char          Hex[3] = { 0, 0, 0 };
+
+  for ( Index = 0; Index < Encoded.length(); Index++ )
+  {
+    char  c = Encoded[Index];
+
+    if ( (c == '%') && (Index + 2 < Encoded.length()) )
+    {
+      Hex[0] = Encoded[Index + 1];
+      Hex[1] = Encoded[Index + 2];
+      c      = (char)strtol( Hex, NULL, 16 );
+      Index += 2;
+    }
+    else if ( c == '+' )
+    {
+      c = ' ';
+    }
+    Out += c;
+  }
+
+  return Out;
+}
+
+/*===========================================================================*/
+
+static String
+Web_Base64( const String &Plain )
+{
+  static const char Table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  String            Out;
+  unsigned int      Index;
+  uint32_t          Bits;
+
+  for ( Index = 0; Index < Plain.length(); Index += 3 )
+  {
+    Bits = (uint32_t)(uint8_t)Plain[Index] << 16;
+    if ( Index + 1 < Plain.length() ) Bits |= (uint32_t)(uint8_t)Plain[Index + 1] << 8;
+    if ( Index + 2 < Plain.length() ) Bits |= (uint8_t)Plain[Index + 2];
+
+    Out += Table[(Bits >> 18) & 0x3f];
+    Out += Table[(Bits >> 12) & 0x3f];
+    Out += ( Index + 1 < Plain.length() ) ? Table[(Bits >> 6) & 0x3f] : '=';
+    Out += ( Index + 2 < Plain.length() ) ? Table[Bits & 0x3f] : '=';
+  }
+
+  return Out;
+}
+
+/*===========================================================================*/
+
+ESP8266WebServer::ESP8266WebServer( int Port )
+  : Port( Port ), Listen_Fd( -1 ), Client_Fd( -1 ), Method( HTTP_GET ),
+    Content_Length( CONTENT_LENGTH_NOT_SET ), Chunked( false ), Responded( false )
+{
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::on( const char *pUri, HTTPMethod Method, THandlerFunction Handler, THandlerFunction Upload )
+{
+  Route   New;
+
+  New.uri     = pUri;
+  New.method  = Method;
+  New.handler = Handler;
+  New.upload  = Upload;
+  Routes.push_back( New );
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::begin( void )
+{
+  Listen_Fd       = Sim_Net_Listen( Web_Host_Port, false );
+  Web_Bound_Port  = ( Listen_Fd >= 0 ) ? Sim_Net_Local_Port( Listen_Fd ) : 0;
+  Sim_Net_Map( (uint16_t)Port, Web_Bound_Port );
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::close( void )
+{
+  if ( Listen_Fd >= 0 )
+  {
+    ::close( Listen_Fd );
+    Listen_Fd = -1;
+  }
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::Add_Args( const String &Encoded )
+{
+  int   From = 0;
+  int   End;
+  int   Equal;
+
+  while ( From < (int)Encoded.length() )
+  {
+    End = Encoded.indexOf( '&', From );
+    if ( End < 0 )
+    {
+      End = Encoded.length();
+    }
+
+    String  Pair = Encoded.substring( From, End );
+    Equal = Pair.indexOf( '=' );
+    if ( Pair.length() > 0 )
+    {
+      Args.push_back( std::make_pair( Web_Decode( Equal < 0 ? Pair : Pair.substring( 0, Equal ) ),
+                                      Web_Decode( Equal < 0 ? String() : Pair.substring( Equal + 1 ) ) ) );
+    }
+    From = End + 1;
+  }
+}
+
+/*===========================================================================*/
+
+/* Read and parse the request on Client_Fd */
+bool
+ESP8266WebServer::Read_Request( void )
+{
+  String          Raw;
+  char            Buff[1024];
+  struct pollfd   Poll;
+  ssize_t         Got;
+  int             Head_End = -1;
+  size_t          Body_Len = 0;
+
+  Poll.fd     = Client_Fd;
+  Poll.events = POLLIN;
+
+  while ( Raw.length() < WEB_REQUEST_MAX_SIZE )
+  {
+    if ( (Head_End >= 0) && (Raw.length() >= Head_End + 4 + Body_Len) )
+    {
+      break;
+    }
+    if ( poll( &Poll, 1, WEB_READ_TIMEOUT_MS ) <= 0 )
+    {
+      return false;
+    }
+    Got = recv( Client_Fd, Buff, sizeof(Buff), 0 );
+    if ( Got <= 0 )
+    {
+      return false;
+    }
+    Raw.concat( Buff, (unsigned int)Got );
+
+    if ( Head_End < 0 )
+    {
+      Head_End = Raw.indexOf( "\r\n\r\n" );
+      if ( Head_End >= 0 )
+      {
+        int   Length_At = Raw.substring( 0, Head_End ).indexOf( "Content-Length:" );
+
+        Body_Len = ( Length_At >= 0 ) ? strtoul( Raw.c_str() + Length_At + 15, NULL, 10 ) : 0;
+      }
+    }
+  }
+  if ( Head_End < 0 )
+  {
+    return false;
+  }
+
+  /* The request line */
+  String  Head  = Raw.substring( 0, Head_End );
+  int     Line_End = Head.indexOf( "\r\n" );
+  String  Line  = Head.substring( 0, Line_End < 0 ? Head.length() : Line_End );
+  int     Space1 = Line.indexOf( ' ' );
+  int     Space2 = Line.indexOf( ' ', Space1 + 1 );
+  String  Verb  = Line.substring( 0, Space1 );
+  String  Path  = Line.substring( Space1 + 1, Space2 < 0 ? Line.length() : Space2 );
+  int     Query = Path.indexOf( '?' );
+
+  Method = ( Verb == "POST" ) ? HTTP_POST : ( Verb == "PUT" ) ? HTTP_PUT : ( Verb == "DELETE" ) ? HTTP_DELETE :
+           ( Verb == "HEAD" ) ? HTTP_HEAD : ( Verb == "OPTIONS" ) ? HTTP_OPTIONS : HTTP_GET;
+  Uri    = ( Query < 0 ) ? Path : Path.substring( 0, Query );
+  Args.clear();
+  Headers.clear();
+  if ( Query >= 0 )
+  {
+    Add_Args( Path.substring( Query + 1 ) );
+  }
+
+  /* The headers */
+  int   From = ( Line_End < 0 ) ? Head.length() : Line_End + 2;
+  while ( From < (int)Head.length() )
+  {
+    int     End   = Head.indexOf( "\r\n", From );
+    String  Field = Head.substring( From, End < 0 ? Head.length() : End );
+    int     Colon = Field.indexOf( ':' );
+
+    if ( Colon > 0 )
+    {
+      String  Value = Field.substring( Colon + 1 );
+
+      Value.trim();
+      Headers.push_back( std::make_pair( Field.substring( 0, Colon ), Value ) );
+    }
+    From = ( End < 0 ) ? Head.length() : End + 2;
+  }
+
+  /* A form body, and the body as "plain" as the core has it */
+  String  Body = Raw.substring( Head_End + 4 );
+  if ( Body.length() > 0 )
+  {
+    if ( header( "Content-Type" ).startsWith( "application/x-www-form-urlencoded" ) )
+    {
+      Add_Args( Body );
+    }
+    Args.push_back( std::make_pair( String( "plain" ), Body ) );
+  }
+
+  return true;
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::handleClient( void )
+{
+  size_t  Index;
+
+  if ( Listen_Fd < 0 )
+  {
+    return;
+  }
+
+  Client_Fd = accept( Listen_Fd, NULL, NULL );
+  if ( Client_Fd < 0 )
+  {
+    return;
+  }
+
+  Content_Length  = CONTENT_LENGTH_NOT_SET;
+  Chunked         = false;
+  Responded       = false;
+  Response_Headers.clear();
+
+  if ( Read_Request() )
+  {
+    for ( Index = 0; Index < Routes.size(); Index++ )
+    {
+      if ( (Routes[Index].uri == Uri) &&
+           ((Routes[Index].method == HTTP_ANY) || (Routes[Index].method == Method)) )
+      {
+        Routes[Index].handler();
+        break;
+      }
+    }
+    if ( Index == Routes.size() )
+    {
+      if ( Not_Found )
+      {
+        Not_Found();
+      }
+      else
+      {
+        send( 404, "text/plain", "Not found" );
+      }
+    }
+
+    /* The handler left the chunks open */
+    if ( Chunked )
+    {
+      sendContent( "", 0 );
+    }
+  }
+
+  ::close( Client_Fd );
+  Client_Fd = -1;
+}
+
+/*===========================================================================*/
+
+String
+ESP8266WebServer::arg( int Index )
+{
+  return ( (Index >= 0) && (Index < (int)Args.size()) ) ? Args[Index].second : String();
+}
+
+String
+ESP8266WebServer::arg( const char *pName )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < Args.size(); Index++ )
+  {
+    if ( Args[Index].first == pName )
+    {
+      return Args[Index].second;
+    }
+  }
+
+  return String();
+}
+
+String
+ESP8266WebServer::argName( int Index )
+{
+  return ( (Index >= 0) && (Index < (int)Args.size()) ) ? Args[Index].first : String();
+}
+
+bool
+ESP8266WebServer::hasArg( const char *pName )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < Args.size(); Index++ )
+  {
+    if ( Args[Index].first == pName )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*===========================================================================*/
+
+String
+ESP8266WebServer::header( const char *pName )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < Headers.size(); Index++ )
+  {
+    if ( strcasecmp( Headers[Index].first.c_str(), pName ) == 0 )
+    {
+      return Headers[Index].second;
+    }
+  }
+
+  return String();
+}
+
+bool
+ESP8266WebServer::hasHeader( const char *pName )
+{
+  return header( pName ).length() > 0;
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::Write( const char *pBuff, size_t Len )
+{
+  ssize_t   Sent;
+
+  while ( (Client_Fd >= 0) && (Len > 0) )
+  {
+    Sent = ::send( Client_Fd, pBuff, Len, MSG_NOSIGNAL );
+    if ( Sent <= 0 )
+    {
+      return;
+    }
+    pBuff += Sent;
+    Len   -= Sent;
+  }
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::sendHeader( const String &Name, const String &Value, bool First )
+{
+  if ( First )
+  {
+    Response_Headers.insert( Response_Headers.begin(), std::make_pair( Name, Value ) );
+  }
+  else
+  {
+    Response_Headers.push_back( std::make_pair( Name, Value ) );
+  }
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::send( int Code, const char *pContent_Type, const String &Content )
+{
+  send( Code, pContent_Type, Content.c_str(), Content.length() );
+}
+
+void
+ESP8266WebServer::send( int Code, const char *pContent_Type, const char *pContent )
+{
+  send( Code, pContent_Type, pContent, strlen( pContent ) );
+}
+
+/*!
+@brief  The status, the headers and the content or the first of it
+@param  Code            HTTP status, (I)
+@param  pContent_Type   NULL for none, (I)
+@param  pContent        The content, (I)
+@param  Len             Its length, (I)
+*/
+void
+ESP8266WebServer::send( int Code, const char *pContent_Type, const char *pContent, size_t Len )
+{
+  String  Head;
+  size_t  Index;
+
+  if ( Responded )
+  {
+    return;
+  }
+  Responded = true;
+
+  Head  = String( "HTTP/1.1 " ) + String( Code ) + " " + Web_Reason( Code ) + "\r\n";
+  if ( pContent_Type != NULL )
+  {
+    Head += String( "Content-Type: " ) + pContent_Type + "\r\n";
+  }
+  if ( Content_Length == CONTENT_LENGTH_UNKNOWN )
+  {
+    Head   += "Transfer-Encoding: chunked\r\n";
+    Chunked = true;
+  }
+  else
+  {
+    Head += String( "Content-Length: " ) + String( (unsigned long)(Content_Length == CONTENT_LENGTH_NOT_SET ? Len : Content_Length) ) + "\r\n";
+  }
+  for ( Index = 0; Index < Response_Headers.size(); Index++ )
+  {
+    Head += Response_Headers[Index].first + ": " + Response_Headers[Index].second + "\r\n";
+  }
+  Head += "Connection: close\r\n\r\n";
+
+  Write( Head.c_str(), Head.length() );
+  if ( Len > 0 )
+  {
+    sendContent( pContent, Len );
+  }
+}
+
+/*===========================================================================*/
+
+/* More of the content, an empty piece ends a chunked one */
+void
+ESP8266WebServer::sendContent( const char *pContent, size_t Len )
+{
+  char  Size[16];
+
+  if ( !Chunked )
+  {
+    Write( pContent, Len );
+    return;
+  }
+
+  snprintf( Size, sizeof(Size), "%zx\r\n", Len );
+  Write( Size, strlen( Size ) );
+  Write( pContent, Len );
+  Write( "\r\n", 2 );
+  if ( Len == 0 )
+  {
+    Chunked = false;
+  }
+}
+
+/*===========================================================================*/
+
+bool
+ESP8266WebServer::authenticate( const char *pUser, const char *pPassword )
+{
+  String  Expected = String( "Basic " ) + Web_Base64( String( pUser ) + ":" + pPassword );
+
+  return header( "Authorization" ) == Expected;
+}
+
+/*===========================================================================*/
+
+void
+ESP8266WebServer::requestAuthentication( void )
+{
+  sendHeader( "WWW-Authenticate", "Basic realm=\"Login Required\"" );
+  send( 401 );
+}
+
+/*===========================================================================*/
@@ -0,0 +1,1094 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   wifi.cpp
+@brief  Host build, Wi-Fi, DNS and the sockets
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The station side of ESP8266WiFi.h over a list of simulated access points,
+and WiFiClient and WiFiUDP over sockets on the host's loopback. Every
+device port the stand-ins serve is mapped to the host port they listen
+on, a port not mapped is a host that doesn't answer.
+
+Every name resolves to 127.0.0.1 after SIM_DNS_MS while the internet is
+up, Sim_Net_Internet(). While it is down no answer comes, a blocking
+lookup waits its timeout, lwIP gives up after SIM_DNS_GIVE_UP_MS. The
+internet itself is a listener for port 80 that takes a connection and
+closes it.
+
+Blocking calls move the virtual clock by what they would take, a connect
+SIM_NET_RTT_MS, one that gets no answer its timeout. Sim_Net_Fail_Writes()
+has the next writes of the clients send nothing, as with the send buffer
+of lwIP full.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <ESP8266WiFi.h>
+#include <lwip/dns.h>
+#include <map>
+#include <vector>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define SIM_DNS_MS              20
+#define SIM_DNS_GIVE_UP_MS      5000
+#define SIM_DNS_TIMEOUT_MS      10000
+#define SIM_NET_RTT_MS          2
+#define SIM_NET_CONNECT_TIMEOUT_MS  5000
+
+#define SIM_NET_INTERNET_PORT   80
+
+typedef struct
+{
+  char      ssid[33];
+  uint8_t   bssid[6];
+  uint8_t   channel;
+  int       rssi;
+
+} WIFI_AP_RECORD;
+
+typedef struct
+{
+  dns_found_callback  pFound;
+  void                *pArg;
+  std::string         name;
+  bool                answered;
+
+} WIFI_DNS_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static std::vector<WIFI_AP_RECORD>  Wifi_Aps;
+static std::vector<WIFI_AP_RECORD>  Wifi_Scan;
+
+/* The access point begun with, -1 for none, and when it connects */
+static int          Wifi_Ap           = -1;
+static bool         Wifi_Ap_Found     = false;
+static uint64_t     Wifi_Ready_At     = 0;
+static bool         Wifi_Lost         = false;
+static bool         Wifi_Counted      = false;
+static uint32_t     Wifi_Connects     = 0;
+
+static bool         Wifi_Scan_Running = false;
+static bool         Wifi_Scan_Done    = false;
+static uint64_t     Wifi_Scan_Done_At = 0;
+
+static char         Wifi_Soft_Ap[33];
+
+static std::map<uint16_t, uint16_t>   Net_Ports;
+static bool         Net_Internet_Up   = true;
+static int          Net_Internet_Fd   = -1;
+static uint32_t     Net_Dns_Lookups   = 0;
+static uint32_t     Net_Fail_Writes   = 0;
+
+/*=============================================================================
+Global Variables
+=============================================================================*/
+
+ESP8266WiFiClass    WiFi;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static bool   Wifi_Is_Connected( void );
+static int    Wifi_Find( const char *pSsid, const uint8_t *pBssid );
+static void   Net_Dns_Answer( void *pContext );
+static void   Net_Internet_Poll( void );
+static int    Net_Connect( uint16_t Port );
+static bool   Net_Literal( const char *pHost, IPAddress *pIp );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static bool
+Wifi_Is_Connected( void )
+{
+  return WiFi.status() == WL_CONNECTED;
+}
+
+/*===========================================================================*/
+
+/* The first access point of the SSID, and of the BSSID unless NULL */
+static int
+Wifi_Find( const char *pSsid, const uint8_t *pBssid )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < Wifi_Aps.size(); Index++ )
+  {
+    if ( (strcmp( Wifi_Aps[Index].ssid, pSsid ) == 0) &&
+         ((pBssid == NULL) || (memcmp( Wifi_Aps[Index].bssid, pBssid, 6 ) == 0)) )
+    {
+      return (int)Index;
+    }
+  }
+
+  return -1;
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  An access point on the air, a repeater is one more of the SSID
+@param  pSsid     Its name, (I)
+@param  Rssi      How strong, dBm, (I)
+@param  Channel   Its channel, (I)
+@return Its number, the last byte of its BSSID less one
+*/
+int
+Sim_Wifi_Add_Ap( const char *pSsid, int Rssi, uint8_t Channel )
+{
+  WIFI_AP_RECORD  Ap;
+
+  memset( &Ap, 0, sizeof(Ap) );
+  strncpy( Ap.ssid, pSsid, sizeof(Ap.ssid) - 1 );
+  Ap.bssid[0] = 0x02;
+  Ap.bssid[5] = (uint8_t)( Wifi_Aps.size() + 1 );
+  Ap.channel  = Channel;
+  Ap.rssi     = Rssi;
+  Wifi_Aps.push_back( Ap );
+
+  return (int)Wifi_Aps.size() - 1;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Wifi_Set_Rssi( const char *pSsid, int Rssi )
+{
+  int   Index = Wifi_Find( pSsid, NULL );
+
+  if ( Index >= 0 )
+  {
+    Wifi_Aps[Index].rssi = Rssi;
+  }
+}
+
+/*===========================================================================*/
+
+/* By the number Sim_Wifi_Add_Ap() gave, for the repeaters of an SSID */
+void
+Sim_Wifi_Set_Ap_Rssi( int Ap, int Rssi )
+{
+  if ( (Ap >= 0) && ((size_t)Ap < Wifi_Aps.size()) )
+  {
+    Wifi_Aps[Ap].rssi = Rssi;
+  }
+}
+
+/*===========================================================================*/
+
+/* The access point goes away from the station, it doesn't reconnect itself */
+void
+Sim_Wifi_Drop( void )
+{
+  if ( Wifi_Ap >= 0 )
+  {
+    Wifi_Ap   = -1;
+    Wifi_Lost = true;
+  }
+}
+
+/*===========================================================================*/
+
+const char *
+Sim_Wifi_Ssid( void )
+{
+  return Wifi_Is_Connected() ? Wifi_Aps[Wifi_Ap].ssid : NULL;
+}
+
+/*===========================================================================*/
+
+/* The number of the access point connected to, -1 if none */
+int
+Sim_Wifi_Ap( void )
+{
+  return Wifi_Is_Connected() ? Wifi_Ap : -1;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Wifi_Connects( void )
+{
+  return Wifi_Connects;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Net_Map( uint16_t Device_Port, uint16_t Host_Port )
+{
+  if ( Host_Port == 0 )
+  {
+    Net_Ports.erase( Device_Port );
+  }
+  else
+  {
+    Net_Ports[Device_Port] = Host_Port;
+  }
+}
+
+/*===========================================================================*/
+
+uint16_t
+Sim_Net_Host_Port( uint16_t Device_Port )
+{
+  std::map<uint16_t, uint16_t>::iterator  Found = Net_Ports.find( Device_Port );
+
+  return ( Found == Net_Ports.end() ) ? 0 : Found->second;
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  A socket on the loopback to take connections or datagrams
+@param  Port    Host port, 0 for any free one, (I)
+@param  Udp     TRUE for UDP, (I)
+@return Its descriptor, non blocking, -1 if failed
+*/
+int
+Sim_Net_Listen( uint16_t Port, bool Udp )
+{
+  struct sockaddr_in  Addr;
+  int                 Fd;
+  int                 On = 1;
+
+  Fd = socket( AF_INET, Udp ? SOCK_DGRAM : SOCK_STREAM, 0 );
+  if ( Fd < 0 )
+  {
+    return -1;
+  }
+
+  setsockopt( Fd, SOL_SOCKET, SO_REUSEADDR, &On, sizeof(On) );
+  memset( &Addr, 0, sizeof(Addr) );
+  Addr.sin_family       = AF_INET;
+  Addr.sin_addr.s_addr  = htonl( INADDR_LOOPBACK );
+  Addr.sin_port         = htons( Port );
+  if ( (bind( Fd, (struct sockaddr *)&Addr, sizeof(Addr) ) != 0) ||
+       (!Udp && (listen( Fd, 8 ) != 0)) )
+  {
+    close( Fd );
+    return -1;
+  }
+  fcntl( Fd, F_SETFL, fcntl( Fd, F_GETFL ) | O_NONBLOCK );
+
+  return Fd;
+}
+
+/*===========================================================================*/
+
+uint16_t
+Sim_Net_Local_Port( int Fd )
+{
+  struct sockaddr_in  Addr;
+  socklen_t           Len = sizeof(Addr);
+
+  if ( getsockname( Fd, (struct sockaddr *)&Addr, &Len ) != 0 )
+  {
+    return 0;
+  }
+
+  return ntohs( Addr.sin_port );
+}
+
+/*===========================================================================*/
+
+static void
+Net_Internet_Poll( void )
+{
+  int   Fd;
+
+  while ( (Net_Internet_Fd >= 0) && ((Fd = accept( Net_Internet_Fd, NULL, NULL )) >= 0) )
+  {
+    close( Fd );
+  }
+}
+
+/*===========================================================================*/
+
+/* The internet up or down, port 80 and DNS */
+void
+Sim_Net_Internet( bool Up )
+{
+  static bool   Polled = false;
+
+  Net_Internet_Up = Up;
+
+  if ( Up && (Net_Internet_Fd < 0) )
+  {
+    Net_Internet_Fd = Sim_Net_Listen( 0, false );
+    Sim_Net_Map( SIM_NET_INTERNET_PORT, Sim_Net_Local_Port( Net_Internet_Fd ) );
+  }
+  else if ( !Up && (Net_Internet_Fd >= 0) )
+  {
+    close( Net_Internet_Fd );
+    Net_Internet_Fd = -1;
+    Sim_Net_Map( SIM_NET_INTERNET_PORT, 0 );
+  }
+
+  if ( !Polled )
+  {
+    Polled = true;
+    Sim_Clock_Add_Poll( Net_Internet_Poll );
+  }
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Net_Dns_Lookups( void )
+{
+  return Net_Dns_Lookups;
+}
+
+/*===========================================================================*/
+
+/* The next Count writes of the clients send nothing */
+void
+Sim_Net_Fail_Writes( uint32_t Count )
+{
+  Net_Fail_Writes = Count;
+}
+
+/*===========================================================================*/
+
+/* Writes still to fail */
+uint32_t
+Sim_Net_Failing_Writes( void )
+{
+  return Net_Fail_Writes;
+}
+
+/*===========================================================================*/
+
+static bool
+Net_Literal( const char *pHost, IPAddress *pIp )
+{
+  return pIp->fromString( pHost );
+}
+
+/*===========================================================================*/
+
+/* A lookup ends, the answer or none */
+static void
+Net_Dns_Answer( void *pContext )
+{
+  WIFI_DNS_RECORD   *pDns = (WIFI_DNS_RECORD *)pContext;
+  ip_addr_t         Addr;
+
+  Addr.addr = (uint32_t)IPAddress( 127, 0, 0, 1 );
+  pDns->pFound( pDns->name.c_str(), pDns->answered ? &Addr : NULL, pDns->pArg );
+  delete pDns;
+}
+
+/*===========================================================================*/
+
+err_t
+dns_gethostbyname( const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg )
+{
+  WIFI_DNS_RECORD   *pDns;
+  IPAddress         Ip;
+
+  if ( Net_Literal( hostname, &Ip ) )
+  {
+    addr->addr = (uint32_t)Ip;
+    return ERR_OK;
+  }
+  if ( !Wifi_Is_Connected() )
+  {
+    return ERR_RTE;
+  }
+
+  Net_Dns_Lookups++;
+  pDns            = new WIFI_DNS_RECORD;
+  pDns->pFound    = found;
+  pDns->pArg      = callback_arg;
+  pDns->name      = hostname;
+  pDns->answered  = Net_Internet_Up;
+  Sim_Clock_At( Sim_Clock_Cycles() + (Net_Internet_Up ? SIM_DNS_MS : SIM_DNS_GIVE_UP_MS) * SIM_CYCLES_PER_MS,
+                Net_Dns_Answer, pDns );
+
+  return ERR_INPROGRESS;
+}
+
+/*===========================================================================*/
+
+/* A TCP connection to the host port a device port is mapped to */
+static int
+Net_Connect( uint16_t Port )
+{
+  struct sockaddr_in  Addr;
+  uint16_t            Host_Port = Sim_Net_Host_Port( Port );
+  int                 Fd;
+
+  if ( Host_Port == 0 )
+  {
+    return -1;
+  }
+
+  Fd = socket( AF_INET, SOCK_STREAM, 0 );
+  if ( Fd < 0 )
+  {
+    return -1;
+  }
+
+  memset( &Addr, 0, sizeof(Addr) );
+  Addr.sin_family       = AF_INET;
+  Addr.sin_addr.s_addr  = htonl( INADDR_LOOPBACK );
+  Addr.sin_port         = htons( Host_Port );
+  if ( connect( Fd, (struct sockaddr *)&Addr, sizeof(Addr) ) != 0 )
+  {
+    close( Fd );
+    return -1;
+  }
+  fcntl( Fd, F_SETFL, fcntl( Fd, F_GETFL ) | O_NONBLOCK );
+
+  return Fd;
+}
+
+/*===========================================================================*/
+
+bool
+ESP8266WiFiClass::mode( WiFiMode_t Mode )
+{
+  (void)Mode;
+  return true;
+}
+
+bool
+ESP8266WiFiClass::persistent( bool Persistent )
+{
+  (void)Persistent;
+  return true;
+}
+
+bool
+ESP8266WiFiClass::setAutoConnect( bool Auto )
+{
+  (void)Auto;
+  return true;
+}
+
+bool
+ESP8266WiFiClass::setAutoReconnect( bool Auto )
+{
+  (void)Auto;
+  return true;
+}
+
+/*===========================================================================*/
+
+bool
+ESP8266WiFiClass::softAP( const char *pSsid, const char *pPassword, int Channel, int Hidden, int Max_Connection )
+{
+  (void)pPassword;
+  (void)Channel;
+  (void)Hidden;
+  (void)Max_Connection;
+
+  strncpy( Wifi_Soft_Ap, pSsid, sizeof(Wifi_Soft_Ap) - 1 );
+  return true;
+}
+
+IPAddress
+ESP8266WiFiClass::softAPIP( void )
+{
+  return IPAddress( 192, 168, 4, 1 );
+}
+
+/*===========================================================================*/
+
+wl_status_t
+ESP8266WiFiClass::begin( const char *pSsid, const char *pPassword, int32_t Channel,
+                         const uint8_t *pBssid, bool Connect )
+{
+  int   Index = Wifi_Find( pSsid, pBssid );
+  bool  Fast  = ( Channel != 0 ) && ( pBssid != NULL );
+
+  (void)pPassword;
+
+  Wifi_Ap       = Connect ? Index : -1;
+  Wifi_Ap_Found = ( Index >= 0 );
+  Wifi_Ready_At = Sim_Clock_Cycles() + (Fast ? WIFI_SIM_FAST_CONNECT_MS : WIFI_SIM_CONNECT_MS) * SIM_CYCLES_PER_MS;
+  Wifi_Lost     = false;
+  Wifi_Counted  = false;
+
+  return WL_DISCONNECTED;
+}
+
+/*===========================================================================*/
+
+bool
+ESP8266WiFiClass::config( IPAddress Ip, IPAddress Gateway, IPAddress Netmask, IPAddress Dns1, IPAddress Dns2 )
+{
+  (void)Ip;
+  (void)Gateway;
+  (void)Netmask;
+  (void)Dns1;
+  (void)Dns2;
+  return true;
+}
+
+/*===========================================================================*/
+
+bool
+ESP8266WiFiClass::disconnect( bool Wifi_Off )
+{
+  (void)Wifi_Off;
+
+  Wifi_Ap   = -1;
+  Wifi_Lost = false;
+  return true;
+}
+
+/*===========================================================================*/
+
+wl_status_t
+ESP8266WiFiClass::status( void )
+{
+  if ( Wifi_Ap >= 0 )
+  {
+    if ( Sim_Clock_Cycles() < Wifi_Ready_At )
+    {
+      return WL_DISCONNECTED;
+    }
+    if ( !Wifi_Counted )
+    {
+      Wifi_Counted = true;
+      Wifi_Connects++;
+    }
+    return WL_CONNECTED;
+  }
+
+  if ( Wifi_Lost )
+  {
+    return WL_CONNECTION_LOST;
+  }
+  if ( !Wifi_Ap_Found && (Wifi_Ready_At != 0) && (Sim_Clock_Cycles() >= Wifi_Ready_At) )
+  {
+    return WL_NO_SSID_AVAIL;
+  }
+
+  return ( Wifi_Ready_At == 0 ) ? WL_IDLE_STATUS : WL_DISCONNECTED;
+}
+
+/*===========================================================================*/
+
+String
+ESP8266WiFiClass::SSID( void )
+{
+  return String( Wifi_Is_Connected() ? Wifi_Aps[Wifi_Ap].ssid : "" );
+}
+
+int32_t
+ESP8266WiFiClass::RSSI( void )
+{
+  return Wifi_Is_Connected() ? Wifi_Aps[Wifi_Ap].rssi : 31;
+}
+
+uint8_t *
+ESP8266WiFiClass::BSSID( void )
+{
+  static uint8_t  None[6];
+
+  return Wifi_Is_Connected() ? Wifi_Aps[Wifi_Ap].bssid : None;
+}
+
+int32_t
+ESP8266WiFiClass::channel( void )
+{
+  return Wifi_Is_Connected() ? Wifi_Aps[Wifi_Ap].channel : 0;
+}
+
+IPAddress
+ESP8266WiFiClass::localIP( void )
+{
+  return Wifi_Is_Connected() ? IPAddress( 192, 168, 1, 50 ) : IPAddress();
+}
+
+IPAddress
+ESP8266WiFiClass::gatewayIP( void )
+{
+  return Wifi_Is_Connected() ? IPAddress( 192, 168, 1, 1 ) : IPAddress();
+}
+
+IPAddress
+ESP8266WiFiClass::subnetMask( void )
+{
+  return Wifi_Is_Connected() ? IPAddress( 255, 255, 255, 0 ) : IPAddress();
+}
+
+IPAddress
+ESP8266WiFiClass::dnsIP( uint8_t Index )
+{
+  return ( Wifi_Is_Connected() && (Index == 0) ) ? IPAddress( 192, 168, 1, 1 ) : IPAddress();
+}
+
+String
+ESP8266WiFiClass::macAddress( void )
+{
+  return String( "5C:CF:7F:00:00:01" );
+}
+
+/*===========================================================================*/
+
+int8_t
+ESP8266WiFiClass::scanNetworks( bool Async, bool Show_Hidden )
+{
+  (void)Show_Hidden;
+
+  Wifi_Scan_Running = true;
+  Wifi_Scan_Done    = false;
+  Wifi_Scan_Done_At = Sim_Clock_Cycles() + WIFI_SIM_SCAN_MS * SIM_CYCLES_PER_MS;
+
+  if ( Async )
+  {
+    return WIFI_SCAN_RUNNING;
+  }
+
+  Sim_Clock_Run_Until( Wifi_Scan_Done_At );
+  return scanComplete();
+}
+
+int8_t
+ESP8266WiFiClass::scanComplete( void )
+{
+  if ( Wifi_Scan_Running && (Sim_Clock_Cycles() >= Wifi_Scan_Done_At) )
+  {
+    Wifi_Scan_Running = false;
+    Wifi_Scan_Done    = true;
+    Wifi_Scan         = Wifi_Aps;
+  }
+
+  if ( Wifi_Scan_Running )
+  {
+    return WIFI_SCAN_RUNNING;
+  }
+
+  return Wifi_Scan_Done ? (int8_t)Wifi_Scan.size() : WIFI_SCAN_FAILED;
+}
+
+void
+ESP8266WiFiClass::scanDelete( void )
+{
+  Wifi_Scan.clear();
+  Wifi_Scan_Done = false;
+}
+
+String
+ESP8266WiFiClass::SSID( uint8_t Index )
+{
+  return String( (Index < Wifi_Scan.size()) ? Wifi_Scan[Index].ssid : "" );
+}
+
+int32_t
+ESP8266WiFiClass::RSSI( uint8_t Index )
+{
+  return ( Index < Wifi_Scan.size() ) ? Wifi_Scan[Index].rssi : 0;
+}
+
+uint8_t *
+ESP8266WiFiClass::BSSID( uint8_t Index )
+{
+  static uint8_t  None[6];
+
+  return ( Index < Wifi_Scan.size() ) ? Wifi_Scan[Index].bssid : None;
+}
+
+int32_t
+ESP8266WiFiClass::channel( uint8_t Index )
+{
+  return ( Index < Wifi_Scan.size() ) ? Wifi_Scan[Index].channel : 0;
+}
+
+/*===========================================================================*/
+
+int
+ESP8266WiFiClass::hostByName( const char *pHost, IPAddress &Result )
+{
+  return hostByName( pHost, Result, SIM_DNS_TIMEOUT_MS );
+}
+
+/*!
+@brief  Resolve a name, waiting for the answer
+@param  pHost       The name, (I)
+@param  Result      Its address, (O)
+@param  Timeout_ms  Most to wait, (I)
+@return 1 if resolved
+*/
+int
+ESP8266WiFiClass::hostByName( const char *pHost, IPAddress &Result, uint32_t Timeout_ms )
+{
+  if ( Net_Literal( pHost, &Result ) )
+  {
+    return 1;
+  }
+  if ( !Wifi_Is_Connected() )
+  {
+    return 0;
+  }
+
+  Net_Dns_Lookups++;
+  if ( !Net_Internet_Up || (Timeout_ms < SIM_DNS_MS) )
+  {
+    delay( Timeout_ms );
+    return 0;
+  }
+
+  delay( SIM_DNS_MS );
+  Result = IPAddress( 127, 0, 0, 1 );
+  return 1;
+}
+
+/*===========================================================================*/
+
+String
+IPAddress::toString( void ) const
+{
+  char  Buff[16];
+
+  snprintf( Buff, sizeof(Buff), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3] );
+  return String( Buff );
+}
+
+bool
+IPAddress::fromString( const char *pStr )
+{
+  unsigned int  Part[4];
+  char          Tail;
+
+  if ( (sscanf( pStr, "%u.%u.%u.%u%c", &Part[0], &Part[1], &Part[2], &Part[3], &Tail ) != 4) ||
+       (Part[0] > 255) || (Part[1] > 255) || (Part[2] > 255) || (Part[3] > 255) )
+  {
+    return false;
+  }
+
+  *this = IPAddress( (uint8_t)Part[0], (uint8_t)Part[1], (uint8_t)Part[2], (uint8_t)Part[3] );
+  return true;
+}
+
+/*===========================================================================*/
+
+int
+WiFiClient::connect( IPAddress Ip, uint16_t Port )
+{
+  (void)Ip;
+
+  stop();
+  if ( !Wifi_Is_Connected() )
+  {
+    return 0;
+  }
+
+  Fd = Net_Connect( Port );
+  if ( Fd < 0 )
+  {
+    /* Nobody there, the SYN goes unanswered */
+    delay( min( Stream_Timeout_ms, (unsigned long)SIM_NET_CONNECT_TIMEOUT_MS ) );
+    return 0;
+  }
+
+  delay( SIM_NET_RTT_MS );
+  return 1;
+}
+
+int
+WiFiClient::connect( const char *pHost, uint16_t Port )
+{
+  IPAddress   Ip;
+
+  if ( !WiFi.hostByName( pHost, Ip ) )
+  {
+    return 0;
+  }
+
+  return connect( Ip, Port );
+}
+
+/*===========================================================================*/
+
+size_t
+WiFiClient::write( const uint8_t *pBuff, size_t Size )
+{
+  ssize_t   Sent;
+
+  if ( (Fd < 0) || !Wifi_Is_Connected() )
+  {
+    return 0;
+  }
+  if ( Net_Fail_Writes > 0 )
+  {
+    Net_Fail_Writes--;
+    return 0;
+  }
+
+  Sent = send( Fd, pBuff, Size, MSG_NOSIGNAL );
+
+  return ( Sent < 0 ) ? 0 : (size_t)Sent;
+}
+
+/*===========================================================================*/
+
+int
+WiFiClient::available( void )
+{
+  int   Count = 0;
+
+  if ( (Fd < 0) || (ioctl( Fd, FIONREAD, &Count ) != 0) )
+  {
+    return 0;
+  }
+
+  return Count;
+}
+
+int
+WiFiClient::read( void )
+{
+  uint8_t   c;
+
+  return ( read( &c, 1 ) == 1 ) ? c : -1;
+}
+
+int
+WiFiClient::read( uint8_t *pBuff, size_t Size )
+{
+  ssize_t   Got;
+
+  if ( Fd < 0 )
+  {
+    return -1;
+  }
+
+  Got = recv( Fd, pBuff, Size, MSG_DONTWAIT );
+
+  return ( Got < 0 ) ? -1 : (int)Got;
+}
+
+int
+WiFiClient::peek( void )
+{
+  uint8_t   c;
+
+  if ( (Fd < 0) || (recv( Fd, &c, 1, MSG_DONTWAIT | MSG_PEEK ) != 1) )
+  {
+    return -1;
+  }
+
+  return c;
+}
+
+/*===========================================================================*/
+
+void
+WiFiClient::stop( void )
+{
+  if ( Fd >= 0 )
+  {
+    close( Fd );
+    Fd = -1;
+  }
+}
+
+/*===========================================================================*/
+
+/* Connected, or closed by the other side with data still to read */
+uint8_t
+WiFiClient::connected( void )
+{
+  uint8_t   c;
+  ssize_t   Got;
+
+  if ( (Fd < 0) || !Wifi_Is_Connected() )
+  {
+    return 0;
+  }
+  if ( available() > 0 )
+  {
+    return 1;
+  }
+
+  Got = recv( Fd, &c, 1, MSG_DONTWAIT | MSG_PEEK );
+
+  return ( (Got < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ) ? 1 : 0;
+}
+
+/*===========================================================================*/
+
+void
+WiFiClient::setNoDelay( bool No_Delay )
+{
+  int   On = No_Delay ? 1 : 0;
+
+  if ( Fd >= 0 )
+  {
+    setsockopt( Fd, IPPROTO_TCP, TCP_NODELAY, &On, sizeof(On) );
+  }
+}
+
+/*===========================================================================*/
+
+uint8_t
+WiFiUDP::begin( uint16_t Port )
+{
+  (void)Port;
+
+  stop();
+  Fd = Sim_Net_Listen( 0, true );
+
+  return ( Fd >= 0 ) ? 1 : 0;
+}
+
+void
+WiFiUDP::stop( void )
+{
+  if ( Fd >= 0 )
+  {
+    close( Fd );
+    Fd = -1;
+  }
+}
+
+/*===========================================================================*/
+
+int
+WiFiUDP::beginPacket( IPAddress Ip, uint16_t Port )
+{
+  (void)Ip;
+
+  if ( (Fd < 0) || !Wifi_Is_Connected() )
+  {
+    return 0;
+  }
+
+  Tx_Len  = 0;
+  Tx_Port = Port;
+  return 1;
+}
+
+int
+WiFiUDP::beginPacket( const char *pHost, uint16_t Port )
+{
+  IPAddress   Ip;
+
+  if ( !WiFi.hostByName( pHost, Ip ) )
+  {
+    return 0;
+  }
+
+  return beginPacket( Ip, Port );
+}
+
+size_t
+WiFiUDP::write( const uint8_t *pBuff, size_t Size )
+{
+  Size = min( Size, (size_t)(sizeof(Tx) - Tx_Len) );
+  memcpy( &Tx[Tx_Len], pBuff, Size );
+  Tx_Len += (int)Size;
+
+  return Size;
+}
+
+/* A port not mapped takes it all the same, it is lost on the way */
+int
+WiFiUDP::endPacket( void )
+{
+  struct sockaddr_in  Addr;
+  uint16_t            Host_Port = Sim_Net_Host_Port( Tx_Port );
+
+  if ( (Fd < 0) || !Wifi_Is_Connected() )
+  {
+    return 0;
+  }
+  if ( Host_Port == 0 )
+  {
+    return 1;
+  }
+
+  memset( &Addr, 0, sizeof(Addr) );
+  Addr.sin_family       = AF_INET;
+  Addr.sin_addr.s_addr  = htonl( INADDR_LOOPBACK );
+  Addr.sin_port         = htons( Host_Port );
+
+  return ( sendto( Fd, Tx, Tx_Len, 0, (struct sockaddr *)&Addr, sizeof(Addr) ) == Tx_Len ) ? 1 : 0;
+}
+
+/*===========================================================================*/
+
+int
+WiFiUDP::parsePacket( void )
+{
+  struct sockaddr_in  Addr;
+  socklen_t           Len = sizeof(Addr);
+  ssize_t             Got;
+
+  Rx_Len = 0;
+  Rx_Pos = 0;
+  if ( Fd < 0 )
+  {
+    return 0;
+  }
+
+  Got = recvfrom( Fd, Rx, sizeof(Rx), MSG_DONTWAIT, (struct sockaddr *)&Addr, &Len );
+  if ( Got <= 0 )
+  {
+    return 0;
+  }
+
+  /* What lwIP would give, the first byte lowest */
+  Rx_Ip   = IPAddress( Addr.sin_addr.s_addr );
+  Rx_Port = ntohs( Addr.sin_port );
+  Rx_Len  = (int)Got;
+
+  return Rx_Len;
+}
+
+int
+WiFiUDP::read( void )
+{
+  return ( Rx_Pos < Rx_Len ) ? Rx[Rx_Pos++] : -1;
+}
+
+int
+WiFiUDP::read( uint8_t *pBuff, size_t Size )
+{
+  int   Take = min( (int)Size, Rx_Len - Rx_Pos );
+
+  memcpy( pBuff, &Rx[Rx_Pos], Take );
+  Rx_Pos += Take;
+
+  return Take;
+}
+
+/*===========================================================================*/
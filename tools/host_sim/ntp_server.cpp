@@ -0,0 +1,247 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ntp_server.cpp
+@brief  Host build, an NTP server stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+A clock poller on a loopback UDP socket mapped to the device port 123. A
+request is stamped received and transmitted at once, the reply is queued
+and sent once the delay is up, so the whole delay is on the way back and
+the client sees it as round trip and half of it as offset error.
+
+Loss is drawn from its own generator, the firmware's random() is not
+disturbed by it.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <deque>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "ntp_server.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define NTP_DEVICE_PORT       123
+#define NTP_UNIX_OFFSET_S     2208988800ULL
+
+#define NTP_OFS_FLAGS         0
+#define NTP_OFS_STRATUM       1
+#define NTP_OFS_POLL          2
+#define NTP_OFS_PRECISION     3
+#define NTP_OFS_REF_ID        12
+#define NTP_OFS_REFERENCE     16
+#define NTP_OFS_ORIGINATE     24
+#define NTP_OFS_RECEIVE       32
+#define NTP_OFS_TRANSMIT      40
+
+/* No leap second, version 4, server */
+#define NTP_SERVER_FLAGS      0x24
+
+typedef struct
+{
+  uint64_t              due_cycles;
+  struct sockaddr_in    to;
+  uint8_t               packet[SIM_NTP_PACKET_SIZE];
+
+} NTP_REPLY_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static int                            Ntp_Fd        = -1;
+static int64_t                        Ntp_Start_us  = 0;
+static double                         Ntp_Drift_Ppm = 0;
+static uint32_t                       Ntp_Delay_us  = 0;
+static uint32_t                       Ntp_Loss      = 0;
+static uint32_t                       Ntp_Rand      = 0x2545f491;
+static SIM_NTP_TAMPER_FUNC            pNtp_Tamper   = NULL;
+static uint32_t                       Ntp_Requests  = 0;
+static uint32_t                       Ntp_Replies   = 0;
+static std::deque<NTP_REPLY_RECORD>   Ntp_Queue;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Ntp_Poll( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/*!
+@brief  Listen on loopback for the device port 123
+@param  Start_Unix_us   The true time at virtual time 0, (I)
+@return false if no socket
+*/
+bool
+Sim_Ntp_Start( int64_t Start_Unix_us )
+{
+  Ntp_Start_us = Start_Unix_us;
+  if ( Ntp_Fd >= 0 )
+  {
+    return true;
+  }
+
+  Ntp_Fd = Sim_Net_Listen( 0, true );
+  if ( Ntp_Fd < 0 )
+  {
+    return false;
+  }
+
+  Sim_Net_Map( NTP_DEVICE_PORT, Sim_Net_Local_Port( Ntp_Fd ) );
+  Sim_Clock_Add_Poll( Ntp_Poll );
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* The true time, the virtual time is the device crystal */
+int64_t
+Sim_Ntp_Now_us( void )
+{
+  double  Us = (double)Sim_Clock_Us();
+
+  return Ntp_Start_us + (int64_t)( Us + Us * Ntp_Drift_Ppm / 1e6 );
+}
+
+/*===========================================================================*/
+
+/* How much faster true time runs than the device, ppm */
+void
+Sim_Ntp_Set_Drift( double Ppm )
+{
+  Ntp_Drift_Ppm = Ppm;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Ntp_Set_Delay( uint32_t Delay_us )
+{
+  Ntp_Delay_us = Delay_us;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Ntp_Set_Loss( uint32_t Percent )
+{
+  Ntp_Loss = Percent;
+}
+
+/*===========================================================================*/
+
+void
+Sim_Ntp_Set_Tamper( SIM_NTP_TAMPER_FUNC pFunc )
+{
+  pNtp_Tamper = pFunc;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Ntp_Requests( void )
+{
+  return Ntp_Requests;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Ntp_Replies( void )
+{
+  return Ntp_Replies;
+}
+
+/*===========================================================================*/
+
+/* UTC microseconds since 1970 to an NTP timestamp */
+void
+Sim_Ntp_Write_Time( uint8_t *pBuff, int64_t Unix_us )
+{
+  uint32_t  Secs = (uint32_t)( (uint64_t)(Unix_us / 1000000) + NTP_UNIX_OFFSET_S );
+  uint32_t  Frac = (uint32_t)( ((uint64_t)(Unix_us % 1000000) << 32) / 1000000 );
+  int       Index;
+
+  for ( Index = 0; Index < 4; Index++ )
+  {
+    pBuff[Index]     = (uint8_t)( Secs >> (24 - 8 * Index) );
+    pBuff[4 + Index] = (uint8_t)( Frac >> (24 - 8 * Index) );
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Ntp_Poll( void )
+{
+  NTP_REPLY_RECORD  Reply;
+  uint8_t           Request[128];
+  socklen_t         From_Len = sizeof(Reply.to);
+  ssize_t           Got;
+
+  while ( (Got = recvfrom( Ntp_Fd, Request, sizeof(Request), 0, (struct sockaddr *)&Reply.to, &From_Len )) > 0 )
+  {
+    From_Len = sizeof(Reply.to);
+    Ntp_Requests++;
+
+    Ntp_Rand ^= Ntp_Rand << 13;
+    Ntp_Rand ^= Ntp_Rand >> 17;
+    Ntp_Rand ^= Ntp_Rand << 5;
+    if ( (Got < SIM_NTP_PACKET_SIZE) || ((Ntp_Rand % 100) < Ntp_Loss) )
+    {
+      continue;
+    }
+
+    memset( Reply.packet, 0, sizeof(Reply.packet) );
+    Reply.packet[NTP_OFS_FLAGS]     = NTP_SERVER_FLAGS;
+    Reply.packet[NTP_OFS_STRATUM]   = 1;
+    Reply.packet[NTP_OFS_POLL]      = Request[NTP_OFS_POLL];
+    Reply.packet[NTP_OFS_PRECISION] = (uint8_t)-20;
+    memcpy( &Reply.packet[NTP_OFS_REF_ID], "GPS", 4 );
+    Sim_Ntp_Write_Time( &Reply.packet[NTP_OFS_REFERENCE], Sim_Ntp_Now_us() );
+    memcpy( &Reply.packet[NTP_OFS_ORIGINATE], &Request[NTP_OFS_TRANSMIT], 8 );
+    Sim_Ntp_Write_Time( &Reply.packet[NTP_OFS_RECEIVE], Sim_Ntp_Now_us() );
+    Sim_Ntp_Write_Time( &Reply.packet[NTP_OFS_TRANSMIT], Sim_Ntp_Now_us() );
+    if ( pNtp_Tamper != NULL )
+    {
+      pNtp_Tamper( Reply.packet );
+    }
+
+    Reply.due_cycles = Sim_Clock_Cycles() + (uint64_t)Ntp_Delay_us * SIM_CPU_MHZ;
+    Ntp_Queue.push_back( Reply );
+  }
+
+  while ( !Ntp_Queue.empty() && (Ntp_Queue.front().due_cycles <= Sim_Clock_Cycles()) )
+  {
+    sendto( Ntp_Fd, Ntp_Queue.front().packet, SIM_NTP_PACKET_SIZE, 0,
+            (struct sockaddr *)&Ntp_Queue.front().to, sizeof(Ntp_Queue.front().to) );
+    Ntp_Queue.pop_front();
+    Ntp_Replies++;
+  }
+}
+
+/*===========================================================================*/
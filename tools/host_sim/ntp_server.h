@@ -0,0 +1,52 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ntp_server.h
+@brief  Host build, an NTP server stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Answers the requests to the device port 123 with the true time, the start
+time given plus the virtual time, run fast or slow by a drift so the device
+clock has something to follow. A reply can be held back, lost, or changed
+on its way out to try the checks of the client.
+*/
+
+#ifndef __NTP_SERVER_H__
+#define __NTP_SERVER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define SIM_NTP_PACKET_SIZE   48
+
+/* Changes a reply before it goes, (I/O) */
+typedef void (*SIM_NTP_TAMPER_FUNC)( uint8_t *pPacket );
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern bool       Sim_Ntp_Start( int64_t Start_Unix_us );
+extern int64_t    Sim_Ntp_Now_us( void );
+extern void       Sim_Ntp_Set_Drift( double Ppm );
+extern void       Sim_Ntp_Set_Delay( uint32_t Delay_us );
+extern void       Sim_Ntp_Set_Loss( uint32_t Percent );
+extern void       Sim_Ntp_Set_Tamper( SIM_NTP_TAMPER_FUNC pFunc );
+extern uint32_t   Sim_Ntp_Requests( void );
+extern uint32_t   Sim_Ntp_Replies( void );
+extern void       Sim_Ntp_Write_Time( uint8_t *pBuff, int64_t Unix_us );
+
+#endif  /* __NTP_SERVER_H__ */
+
+/*===========================================================================*/
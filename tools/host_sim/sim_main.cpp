@@ -0,0 +1,488 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sim_main.cpp
+@brief  Host build, runs the firmware against the stand-ins
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The firmware of main/, unchanged, on Linux with the shims of hal/. One AP
+"ZXG", a broker and an NTP server on loopback, the HC-SR04 on its pins with
+a water level script, the EEPROM and LittleFS in a directory. setup() runs
+once, then loop() and the clock moves -s ms between two passes, for -t
+seconds of virtual time.
+
+Without -x the virtual time runs as fast as the host goes, 10 minutes take
+a few seconds. -x 1 runs it at real time, with -p the web pages are on
+http://127.0.0.1:<port>/ for a browser.
+
+The level script is "<seconds> <cm>" a line, the distance from the sensor
+down to the water, interpolated between the lines. The default one fills
+the tank from 150 cm to 20 cm and drains it back, twice in 10 minutes.
+
+Then the run is checked, the exit code is 1 if any of these failed:
+
+  wifi      Connected to the AP
+  ntp       The local clock is synced, within 50 ms of the true time
+  mqtt      Connected to the broker, subscribed, alive_status published
+  relay     Auto control set over MQTT, low 40 cm and high 120 cm, the
+            relay went on as the water came up and off as it went down
+  http      GET / answered 200 over loopback
+
+The checks that need more than the time given are skipped. The serial log
+of the firmware is on stdout, or in the -o file, the checks on stderr.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target host_sim
+
+Usage:
+  host_sim [-t seconds] [-s step ms] [-l level script] [-d storage dir]
+           [-p http port] [-x speed] [-o serial log] [--seed n]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "broker.h"
+#include "ntp_server.h"
+#include "esp8266_12f_bsp.h"
+#include "local_clock.h"
+#include "sntp_client.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define SIM_AP_SSID           "ZXG"
+#define SIM_AP_RSSI           -55
+#define SIM_AP_CHANNEL        6
+
+/* 2026-10-19 00:00:00 UTC, the true time at virtual time 0 */
+#define SIM_START_UNIX_US     1792368000000000LL
+
+#define SIM_LOW_CM            "40"
+#define SIM_HIGH_CM           "120"
+#define SIM_RELAY_SETUP_S     60
+
+#define SIM_NTP_MAX_ERROR_US  50000
+
+typedef struct
+{
+  const char  *pName;
+  bool        ran;
+  bool        passed;
+  std::string detail;
+
+} SIM_CHECK_RECORD;
+
+typedef enum
+{
+  SIM_CHECK_WIFI = 0,
+  SIM_CHECK_NTP,
+  SIM_CHECK_MQTT,
+  SIM_CHECK_RELAY,
+  SIM_CHECK_HTTP,
+  SIM_CHECK_MAX,
+
+} SIM_CHECK_INDEX;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static SIM_CHECK_RECORD   Sim_Checks[SIM_CHECK_MAX] =
+{
+  { "wifi",  false, false, "" },
+  { "ntp",   false, false, "" },
+  { "mqtt",  false, false, "" },
+  { "relay", false, false, "" },
+  { "http",  false, false, "" },
+};
+
+static char     Sim_Cmd_Prefix[32];
+static char     Sim_State_Prefix[32];
+
+/*=============================================================================
+Prototypes of the firmware, main.ino
+=============================================================================*/
+
+extern void setup( void );
+extern void loop( void );
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Sim_Default_Level( void );
+static void   Sim_Run_For( uint64_t Until_us, uint32_t Step_ms );
+static void   Sim_Check( SIM_CHECK_INDEX Check, bool Passed, const char *pFormat, ... );
+static const char *Sim_State( const char *pName );
+static void   Sim_Command( const char *pName, const char *pPayload );
+static bool   Sim_Http_Get( const char *pPath, uint32_t Step_ms, std::string *pResponse );
+static void   Sim_On_Restart( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Fill from 150 cm to 20 cm in 2 minutes, hold, drain back, twice */
+static void
+Sim_Default_Level( void )
+{
+  Sim_Sr04_Add_Point(   0, 150 );
+  Sim_Sr04_Add_Point(  90, 150 );
+  Sim_Sr04_Add_Point( 210,  20 );
+  Sim_Sr04_Add_Point( 240,  20 );
+  Sim_Sr04_Add_Point( 360, 150 );
+  Sim_Sr04_Add_Point( 390, 150 );
+  Sim_Sr04_Add_Point( 510,  20 );
+  Sim_Sr04_Add_Point( 540,  20 );
+  Sim_Sr04_Add_Point( 600, 150 );
+}
+
+/*===========================================================================*/
+
+/* loop() until the virtual time, a step apart */
+static void
+Sim_Run_For( uint64_t Until_us, uint32_t Step_ms )
+{
+  while ( Sim_Clock_Us() < Until_us )
+  {
+    loop();
+    Sim_Clock_Advance( (uint64_t)Step_ms * 1000 );
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Sim_Check( SIM_CHECK_INDEX Check, bool Passed, const char *pFormat, ... )
+{
+  char      Detail[256];
+  va_list   Args;
+
+  va_start( Args, pFormat );
+  vsnprintf( Detail, sizeof(Detail), pFormat, Args );
+  va_end( Args );
+
+  Sim_Checks[Check].ran     = true;
+  Sim_Checks[Check].passed  = Passed;
+  Sim_Checks[Check].detail  = Detail;
+}
+
+/*===========================================================================*/
+
+/* The last state the device published, "" if none */
+static const char *
+Sim_State( const char *pName )
+{
+  std::string   Topic = std::string( Sim_State_Prefix ) + pName;
+  const char    *pLast = Sim_Broker_Last( Topic.c_str() );
+
+  return ( pLast != NULL ) ? pLast : "";
+}
+
+/*===========================================================================*/
+
+static void
+Sim_Command( const char *pName, const char *pPayload )
+{
+  std::string   Topic = std::string( Sim_Cmd_Prefix ) + pName;
+
+  Sim_Broker_Publish( Topic.c_str(), pPayload );
+}
+
+/*===========================================================================*/
+
+/*!
+@brief  A request to the web server of the firmware, over loopback
+@param  pPath       The path, (I)
+@param  Step_ms     loop() runs meanwhile, a step apart, (I)
+@param  pResponse   All of the response, (O)
+@return false if no connection or no answer in 10 s of virtual time
+*/
+static bool
+Sim_Http_Get( const char *pPath, uint32_t Step_ms, std::string *pResponse )
+{
+  struct sockaddr_in  Addr;
+  std::string         Request;
+  char                Buff[2048];
+  ssize_t             Got;
+  uint64_t            Until_us = Sim_Clock_Us() + 10000000ULL;
+  int                 Fd;
+
+  Fd = socket( AF_INET, SOCK_STREAM, 0 );
+  memset( &Addr, 0, sizeof(Addr) );
+  Addr.sin_family       = AF_INET;
+  Addr.sin_addr.s_addr  = htonl( INADDR_LOOPBACK );
+  Addr.sin_port         = htons( Sim_Web_Port() );
+  if ( (Fd < 0) || (Sim_Web_Port() == 0) || (connect( Fd, (struct sockaddr *)&Addr, sizeof(Addr) ) != 0) )
+  {
+    if ( Fd >= 0 )
+    {
+      close( Fd );
+    }
+    return false;
+  }
+
+  Request = std::string( "GET " ) + pPath + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n";
+  if ( send( Fd, Request.data(), Request.size(), MSG_NOSIGNAL ) != (ssize_t)Request.size() )
+  {
+    close( Fd );
+    return false;
+  }
+
+  pResponse->clear();
+  while ( Sim_Clock_Us() < Until_us )
+  {
+    loop();
+    Sim_Clock_Advance( (uint64_t)Step_ms * 1000 );
+    while ( (Got = recv( Fd, Buff, sizeof(Buff), MSG_DONTWAIT )) > 0 )
+    {
+      pResponse->append( Buff, Got );
+    }
+    if ( Got == 0 )
+    {
+      break;
+    }
+  }
+  close( Fd );
+
+  return !pResponse->empty();
+}
+
+/*===========================================================================*/
+
+static void
+Sim_On_Restart( void )
+{
+  fprintf( stderr, "host_sim: the firmware restarted at %.3f s, the storage is in %s\n",
+           Sim_Clock_Us() / 1e6, Sim_Storage_Dir() );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  uint32_t      Seconds   = 600;
+  uint32_t      Step_ms   = 10;
+  const char    *pLevel   = NULL;
+  const char    *pDir     = NULL;
+  const char    *pSerial  = NULL;
+  uint16_t      Http_Port = 0;
+  double        Speed     = 0;
+  uint32_t      Seed      = 1;
+  uint32_t      Relay_On  = 0;
+  uint32_t      Relay_Off = 0;
+  int           Relay_Level;
+  int64_t       Error_us;
+  std::string   Response;
+  FILE          *pSerial_File = NULL;
+  int           Opt;
+  int           Index;
+  bool          Ok = true;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-t" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seconds = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Step_ms = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-l" ) == 0) && (Opt + 1 < argc) )
+    {
+      pLevel = argv[++Opt];
+    }
+    else if ( (strcmp( argv[Opt], "-d" ) == 0) && (Opt + 1 < argc) )
+    {
+      pDir = argv[++Opt];
+    }
+    else if ( (strcmp( argv[Opt], "-p" ) == 0) && (Opt + 1 < argc) )
+    {
+      Http_Port = (uint16_t)strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-x" ) == 0) && (Opt + 1 < argc) )
+    {
+      Speed = atof( argv[++Opt] );
+    }
+    else if ( (strcmp( argv[Opt], "-o" ) == 0) && (Opt + 1 < argc) )
+    {
+      pSerial = argv[++Opt];
+    }
+    else if ( (strcmp( argv[Opt], "--seed" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-t seconds] [-s step ms] [-l level script] [-d storage dir]\n"
+                       "          [-p http port] [-x speed] [-o serial log] [--seed n]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( (Seconds == 0) || (Step_ms == 0) )
+  {
+    fprintf( stderr, "Time and step must be above 0\n" );
+    return 1;
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* The board and what is around it */
+  Sim_Set_Seed( Seed );
+  Sim_Set_Restart_Handler( Sim_On_Restart );
+  if ( pDir != NULL )
+  {
+    Sim_Storage_Set_Dir( pDir );
+  }
+  if ( pSerial != NULL )
+  {
+    pSerial_File = fopen( pSerial, "w" );
+    if ( pSerial_File == NULL )
+    {
+      fprintf( stderr, "Can't write %s\n", pSerial );
+      return 1;
+    }
+    Sim_Serial_Set_Output( pSerial_File );
+  }
+  Sim_Web_Set_Port( Http_Port );
+
+  Sim_Wifi_Add_Ap( SIM_AP_SSID, SIM_AP_RSSI, SIM_AP_CHANNEL );
+  Sim_Net_Internet( true );
+  if ( !Sim_Broker_Start() || !Sim_Ntp_Start( SIM_START_UNIX_US ) )
+  {
+    fprintf( stderr, "No loopback sockets for the broker and the NTP server\n" );
+    return 1;
+  }
+
+  Sim_Sr04_Attach( GPIO_TRIG, GPIO_ECHO );
+  if ( pLevel != NULL )
+  {
+    if ( !Sim_Sr04_Load( pLevel ) )
+    {
+      fprintf( stderr, "No level in %s\n", pLevel );
+      return 1;
+    }
+  }
+  else
+  {
+    Sim_Default_Level();
+  }
+
+  snprintf( Sim_Cmd_Prefix, sizeof(Sim_Cmd_Prefix), "site/%06x/cmd/", ESP.getChipId() );
+  snprintf( Sim_State_Prefix, sizeof(Sim_State_Prefix), "site/%06x/state/", ESP.getChipId() );
+
+  fprintf( stderr, "host_sim: %u s, a loop() every %u ms, storage in %s\n", Seconds, Step_ms, Sim_Storage_Dir() );
+  if ( Speed > 0 )
+  {
+    Sim_Clock_Set_Pace( Speed );
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  setup();
+
+  /* Up and connected, then the relay set to auto */
+  Sim_Run_For( std::min<uint64_t>( SIM_RELAY_SETUP_S, Seconds ) * 1000000ULL, Step_ms );
+
+  if ( Seconds >= SIM_RELAY_SETUP_S )
+  {
+    Sim_Check( SIM_CHECK_WIFI, WiFi.status() == WL_CONNECTED, "status %d, %u connects, on %s",
+               WiFi.status(), Sim_Wifi_Connects(), Sim_Wifi_Ssid() );
+    Sim_Check( SIM_CHECK_MQTT, (Sim_Broker_Connects() > 0) && (Sim_Broker_Subscriptions() > 0) &&
+                               (strcmp( Sim_State( "alive_status" ), "on" ) == 0),
+               "%u connects, %u subscriptions, alive_status \"%s\"",
+               Sim_Broker_Connects(), Sim_Broker_Subscriptions(), Sim_State( "alive_status" ) );
+
+    Ok = Sim_Http_Get( "/", Step_ms, &Response );
+    Sim_Check( SIM_CHECK_HTTP, Ok && (Response.compare( 0, 12, "HTTP/1.1 200" ) == 0),
+               "%zu bytes, \"%.12s\"", Response.size(), Response.c_str() );
+
+    Sim_Command( "low_distance", SIM_LOW_CM );
+    Sim_Command( "high_distance", SIM_HIGH_CM );
+    Sim_Command( "auto_control_relay", "true" );
+  }
+
+  /* Count the relay edges from here on */
+  Relay_Level = Sim_Gpio_Level( GPIO_RELAY );
+  while ( Sim_Clock_Us() < (uint64_t)Seconds * 1000000ULL )
+  {
+    loop();
+    Sim_Clock_Advance( (uint64_t)Step_ms * 1000 );
+    if ( Sim_Gpio_Level( GPIO_RELAY ) != Relay_Level )
+    {
+      Relay_Level = Sim_Gpio_Level( GPIO_RELAY );
+      if ( Relay_Level == GPIO_HIGH )
+      {
+        Relay_On++;
+      }
+      else
+      {
+        Relay_Off++;
+      }
+      fprintf( stderr, "host_sim: %8.3f s relay %s at %.1f cm\n",
+               Sim_Clock_Us() / 1e6, Relay_Level ? "on" : "off", Sim_Sr04_Distance() );
+    }
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  if ( Seconds >= SIM_RELAY_SETUP_S )
+  {
+    Error_us = Local_Clock_Now_us() - Sim_Ntp_Now_us();
+    Sim_Check( SIM_CHECK_NTP, Local_Clock_Is_Valid() && (llabs( Error_us ) < SIM_NTP_MAX_ERROR_US),
+               "%s, %lld us off, %u requests", Local_Clock_Is_Valid() ? "valid" : "not valid",
+               (long long)Error_us, Sim_Ntp_Requests() );
+  }
+
+  /* The default script crosses both thresholds twice after the setup */
+  if ( (pLevel == NULL) && (Seconds >= 600) )
+  {
+    Sim_Check( SIM_CHECK_RELAY, (Relay_On >= 2) && (Relay_Off >= 2) && (strcmp( Sim_State( "auto_control_relay" ), "true" ) == 0),
+               "%u on, %u off, auto_control_relay \"%s\"", Relay_On, Relay_Off, Sim_State( "auto_control_relay" ) );
+  }
+
+  Ok = true;
+  for ( Index = 0; Index < SIM_CHECK_MAX; Index++ )
+  {
+    fprintf( stderr, "%-6s %s  %s\n", Sim_Checks[Index].pName,
+             !Sim_Checks[Index].ran ? "skipped" : Sim_Checks[Index].passed ? "ok  " : "FAIL", Sim_Checks[Index].detail.c_str() );
+    Ok = Ok && ( !Sim_Checks[Index].ran || Sim_Checks[Index].passed );
+  }
+
+  fprintf( stderr, "%u pings, %u DNS lookups, %u NTP requests\n",
+           Sim_Sr04_Pings(), Sim_Net_Dns_Lookups(), Sim_Ntp_Requests() );
+
+  if ( pSerial_File != NULL )
+  {
+    fclose( pSerial_File );
+  }
+
+  return Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
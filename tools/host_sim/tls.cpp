@@ -0,0 +1,329 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   tls.cpp
+@brief  Host build, BearSSL::WiFiClientSecure over OpenSSL
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The client of hal/WiFiClientSecure.h. The handshake runs on the socket of
+the WiFiClient below it, waiting up to the timeout of setTimeout() in real
+time, the virtual clock doesn't move. OpenSSL is held to what BearSSL
+does: TLS 1.2, no tickets and no extended master secret, which BearSSL
+doesn't have, so a session is only its ID, suite and master secret and is
+offered again from those alone.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecure.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <string>
+#include <poll.h>
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static SSL_CTX    *pTls_Ctx = NULL;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static SSL_CTX    *Tls_Ctx( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static SSL_CTX *
+Tls_Ctx( void )
+{
+  if ( pTls_Ctx == NULL )
+  {
+    pTls_Ctx = SSL_CTX_new( TLS_client_method() );
+    SSL_CTX_set_min_proto_version( pTls_Ctx, TLS1_2_VERSION );
+    SSL_CTX_set_max_proto_version( pTls_Ctx, TLS1_2_VERSION );
+    SSL_CTX_set_options( pTls_Ctx, SSL_OP_NO_TICKET | SSL_OP_NO_EXTENDED_MASTER_SECRET );
+    SSL_CTX_set_session_cache_mode( pTls_Ctx, SSL_SESS_CACHE_OFF );
+    SSL_CTX_set_verify( pTls_Ctx, SSL_VERIFY_NONE, NULL );
+  }
+
+  return pTls_Ctx;
+}
+
+/*===========================================================================*/
+
+namespace BearSSL
+{
+
+/*===========================================================================*/
+
+/* The session offered, the suites and the fragment length, then the
+   handshake, and the parameters of it back into the session */
+bool
+WiFiClientSecure::Handshake( void )
+{
+  SSL_SESSION       *pSsl_Session;
+  const SSL_CIPHER  *pCipher;
+  const uint8_t     *pId;
+  unsigned int      Id_Len;
+  uint8_t           Suite[2];
+  std::string       Names;
+  struct pollfd     Poll;
+  unsigned long     Waited_ms = 0;
+  int               Index;
+  int               Ret;
+
+  pSsl = SSL_new( Tls_Ctx() );
+  SSL_set_fd( pSsl, Fd );
+
+  for ( Index = 0; Index < Ciphers_Len; Index++ )
+  {
+    Suite[0] = Ciphers[Index] >> 8;
+    Suite[1] = Ciphers[Index] & 0xff;
+    pCipher  = SSL_CIPHER_find( pSsl, Suite );
+    if ( pCipher != NULL )
+    {
+      Names += Names.empty() ? "" : ":";
+      Names += SSL_CIPHER_get_name( pCipher );
+    }
+  }
+  if ( !Names.empty() )
+  {
+    SSL_set_cipher_list( pSsl, Names.c_str() );
+  }
+  if ( Mfl_Code != 0 )
+  {
+    SSL_set_tlsext_max_fragment_length( pSsl, Mfl_Code );
+  }
+
+  if ( (pSession != NULL) && (pSession->Params.session_id_len > 0) )
+  {
+    Suite[0]     = pSession->Params.cipher_suite >> 8;
+    Suite[1]     = pSession->Params.cipher_suite & 0xff;
+    pSsl_Session = SSL_SESSION_new();
+    SSL_SESSION_set1_id( pSsl_Session, pSession->Params.session_id, pSession->Params.session_id_len );
+    SSL_SESSION_set1_master_key( pSsl_Session, pSession->Params.master_secret, sizeof(pSession->Params.master_secret) );
+    SSL_SESSION_set_protocol_version( pSsl_Session, pSession->Params.version );
+    SSL_SESSION_set_cipher( pSsl_Session, SSL_CIPHER_find( pSsl, Suite ) );
+    SSL_set_session( pSsl, pSsl_Session );
+    SSL_SESSION_free( pSsl_Session );
+  }
+
+  while ( (Ret = SSL_connect( pSsl )) != 1 )
+  {
+    Ret = SSL_get_error( pSsl, Ret );
+    if ( ((Ret != SSL_ERROR_WANT_READ) && (Ret != SSL_ERROR_WANT_WRITE)) || (Waited_ms >= Stream_Timeout_ms) )
+    {
+      Last_Error = ERR_peek_last_error();
+      return false;
+    }
+
+    Poll.fd     = Fd;
+    Poll.events = ( Ret == SSL_ERROR_WANT_READ ) ? POLLIN : POLLOUT;
+    poll( &Poll, 1, 10 );
+    Waited_ms += 10;
+  }
+
+  if ( pSession != NULL )
+  {
+    pSsl_Session = SSL_get_session( pSsl );
+    pId          = SSL_SESSION_get_id( pSsl_Session, &Id_Len );
+
+    memset( &pSession->Params, 0, sizeof(pSession->Params) );
+    memcpy( pSession->Params.session_id, pId, Id_Len );
+    pSession->Params.session_id_len = Id_Len;
+    pSession->Params.version        = SSL_SESSION_get_protocol_version( pSsl_Session );
+    pSession->Params.cipher_suite   = SSL_CIPHER_get_protocol_id( SSL_SESSION_get0_cipher( pSsl_Session ) );
+    SSL_SESSION_get_master_key( pSsl_Session, pSession->Params.master_secret, sizeof(pSession->Params.master_secret) );
+  }
+
+  return true;
+}
+
+/*===========================================================================*/
+
+int
+WiFiClientSecure::connect( IPAddress Ip, uint16_t Port )
+{
+  if ( !WiFiClient::connect( Ip, Port ) )
+  {
+    return 0;
+  }
+  if ( !Handshake() )
+  {
+    stop();
+    return 0;
+  }
+
+  return 1;
+}
+
+/* The lookup here, that of WiFiClient would call the connect above */
+int
+WiFiClientSecure::connect( const char *pHost, uint16_t Port )
+{
+  IPAddress   Ip;
+
+  if ( !WiFi.hostByName( pHost, Ip ) )
+  {
+    return 0;
+  }
+
+  return connect( Ip, Port );
+}
+
+/*===========================================================================*/
+
+size_t
+WiFiClientSecure::write( const uint8_t *pBuff, size_t Size )
+{
+  int   Sent;
+
+  if ( (pSsl == NULL) || (Size == 0) )
+  {
+    return 0;
+  }
+
+  Sent = SSL_write( pSsl, pBuff, Size );
+
+  return ( Sent > 0 ) ? (size_t)Sent : 0;
+}
+
+/*===========================================================================*/
+
+/* What is decrypted already, else a record is read if one came */
+int
+WiFiClientSecure::available( void )
+{
+  uint8_t   c;
+
+  if ( pSsl == NULL )
+  {
+    return 0;
+  }
+  if ( SSL_pending( pSsl ) == 0 )
+  {
+    SSL_peek( pSsl, &c, 1 );
+  }
+
+  return SSL_pending( pSsl );
+}
+
+int
+WiFiClientSecure::read( void )
+{
+  uint8_t   c;
+
+  return ( read( &c, 1 ) == 1 ) ? c : -1;
+}
+
+int
+WiFiClientSecure::read( uint8_t *pBuff, size_t Size )
+{
+  int   Got;
+
+  if ( pSsl == NULL )
+  {
+    return -1;
+  }
+
+  Got = SSL_read( pSsl, pBuff, Size );
+
+  return ( Got > 0 ) ? Got : -1;
+}
+
+int
+WiFiClientSecure::peek( void )
+{
+  uint8_t   c;
+
+  return ( (pSsl != NULL) && (SSL_peek( pSsl, &c, 1 ) == 1) ) ? c : -1;
+}
+
+/*===========================================================================*/
+
+void
+WiFiClientSecure::stop( void )
+{
+  if ( pSsl != NULL )
+  {
+    SSL_free( pSsl );
+    pSsl = NULL;
+  }
+  WiFiClient::stop();
+}
+
+/*===========================================================================*/
+
+uint8_t
+WiFiClientSecure::connected( void )
+{
+  return ( pSsl != NULL ) && WiFiClient::connected();
+}
+
+/*===========================================================================*/
+
+bool
+WiFiClientSecure::setCiphers( const uint16_t *pCiphers, int Count )
+{
+  Ciphers_Len = min( Count, (int)(sizeof(Ciphers) / sizeof(Ciphers[0])) );
+  memcpy( Ciphers, pCiphers, Ciphers_Len * sizeof(Ciphers[0]) );
+
+  return true;
+}
+
+/*===========================================================================*/
+
+int
+WiFiClientSecure::getLastSSLError( char *pDest, size_t Len )
+{
+  if ( (pDest != NULL) && (Len > 0) )
+  {
+    ERR_error_string_n( Last_Error, pDest, Len );
+  }
+
+  return (int)ERR_GET_REASON( Last_Error );
+}
+
+/*===========================================================================*/
+
+/* A whole handshake here, the core only sends the ClientHello */
+bool
+WiFiClientSecure::probeMaxFragmentLength( const char *pHost, uint16_t Port, uint16_t Len )
+{
+  WiFiClientSecure  Probe;
+  SSL_SESSION       *pSsl_Session;
+
+  switch ( Len )
+  {
+    case 512:   Probe.Mfl_Code = TLSEXT_max_fragment_length_512;   break;
+    case 1024:  Probe.Mfl_Code = TLSEXT_max_fragment_length_1024;  break;
+    case 2048:  Probe.Mfl_Code = TLSEXT_max_fragment_length_2048;  break;
+    case 4096:  Probe.Mfl_Code = TLSEXT_max_fragment_length_4096;  break;
+    default:    return false;
+  }
+
+  if ( !Probe.connect( pHost, Port ) )
+  {
+    return false;
+  }
+  pSsl_Session = SSL_get_session( Probe.pSsl );
+
+  return SSL_SESSION_get_max_fragment_length( pSsl_Session ) == Probe.Mfl_Code;
+}
+
+/*===========================================================================*/
+
+}
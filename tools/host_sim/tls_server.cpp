@@ -0,0 +1,233 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   tls_server.cpp
+@brief  Host build, a TLS broker stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The device blocks in its handshake, as on the chip, so this is a thread
+of its own rather than a clock poller, one connection at a time. The key
+is an ECDSA P-256 one made at the start, with a certificate it signs
+itself. The session cache is OpenSSL's, by session ID, tickets are off.
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <atomic>
+#include <thread>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "tls_server.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define TLS_DEVICE_PORT       8883
+
+/* Longest a connection waits for the device */
+#define TLS_IDLE_S            5
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static int                    Tls_Fd = -1;
+static SSL_CTX                *pTls_Server_Ctx = NULL;
+static std::atomic<uint32_t>  Tls_Handshakes( 0 );
+static std::atomic<uint32_t>  Tls_Resumed( 0 );
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static bool   Tls_Make_Ctx( void );
+static void   Tls_Serve( void );
+static void   Tls_Serve_One( int Fd );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/*!
+@brief  Listen on loopback for the device port 8883
+@return false if no socket or no key
+*/
+bool
+Sim_Tls_Start( void )
+{
+  if ( Tls_Fd >= 0 )
+  {
+    return true;
+  }
+
+  if ( !Tls_Make_Ctx() )
+  {
+    return false;
+  }
+  Tls_Fd = Sim_Net_Listen( 0, false );
+  if ( Tls_Fd < 0 )
+  {
+    return false;
+  }
+
+  Sim_Net_Map( TLS_DEVICE_PORT, Sim_Net_Local_Port( Tls_Fd ) );
+  std::thread( Tls_Serve ).detach();
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* The next offer of a session gets a full handshake */
+void
+Sim_Tls_Forget_Sessions( void )
+{
+  SSL_CTX_flush_sessions( pTls_Server_Ctx, time( NULL ) + 365L * 86400 );
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Tls_Handshakes( void )
+{
+  return Tls_Handshakes;
+}
+
+/*===========================================================================*/
+
+uint32_t
+Sim_Tls_Resumed( void )
+{
+  return Tls_Resumed;
+}
+
+/*===========================================================================*/
+
+/* TLS 1.2, no tickets, the key and its certificate */
+static bool
+Tls_Make_Ctx( void )
+{
+  static const unsigned char  Id_Context[] = "broker";
+  EVP_PKEY  *pKey;
+  X509      *pCert;
+  X509_NAME *pName;
+
+  pKey = EVP_EC_gen( "P-256" );
+  if ( pKey == NULL )
+  {
+    return false;
+  }
+
+  pCert = X509_new();
+  X509_set_version( pCert, 2 );
+  ASN1_INTEGER_set( X509_get_serialNumber( pCert ), 1 );
+  X509_gmtime_adj( X509_getm_notBefore( pCert ), 0 );
+  X509_gmtime_adj( X509_getm_notAfter( pCert ), 86400 );
+  X509_set_pubkey( pCert, pKey );
+  pName = X509_get_subject_name( pCert );
+  X509_NAME_add_entry_by_txt( pName, "CN", MBSTRING_ASC, (const unsigned char *)"broker", -1, -1, 0 );
+  X509_set_issuer_name( pCert, pName );
+  X509_sign( pCert, pKey, EVP_sha256() );
+
+  pTls_Server_Ctx = SSL_CTX_new( TLS_server_method() );
+  SSL_CTX_set_min_proto_version( pTls_Server_Ctx, TLS1_2_VERSION );
+  SSL_CTX_set_max_proto_version( pTls_Server_Ctx, TLS1_2_VERSION );
+  /* The device closes without a close_notify, not an error to drop the session for */
+  SSL_CTX_set_options( pTls_Server_Ctx, SSL_OP_NO_TICKET | SSL_OP_IGNORE_UNEXPECTED_EOF );
+  SSL_CTX_set_session_cache_mode( pTls_Server_Ctx, SSL_SESS_CACHE_SERVER );
+  SSL_CTX_set_session_id_context( pTls_Server_Ctx, Id_Context, sizeof(Id_Context) - 1 );
+  SSL_CTX_use_certificate( pTls_Server_Ctx, pCert );
+  SSL_CTX_use_PrivateKey( pTls_Server_Ctx, pKey );
+
+  X509_free( pCert );
+  EVP_PKEY_free( pKey );
+
+  return true;
+}
+
+/*===========================================================================*/
+
+/* The thread, a connection after the other */
+static void
+Tls_Serve( void )
+{
+  struct pollfd   Poll;
+  int             Fd;
+
+  for ( ;; )
+  {
+    Poll.fd     = Tls_Fd;
+    Poll.events = POLLIN;
+    if ( poll( &Poll, 1, -1 ) <= 0 )
+    {
+      continue;
+    }
+
+    Fd = accept( Tls_Fd, NULL, NULL );
+    if ( Fd >= 0 )
+    {
+      Tls_Serve_One( Fd );
+      close( Fd );
+    }
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Tls_Serve_One( int Fd )
+{
+  struct timeval  Idle = { TLS_IDLE_S, 0 };
+  SSL             *pSsl;
+  uint8_t         Buff[512];
+  int             Got;
+
+  fcntl( Fd, F_SETFL, fcntl( Fd, F_GETFL ) & ~O_NONBLOCK );
+  setsockopt( Fd, SOL_SOCKET, SO_RCVTIMEO, &Idle, sizeof(Idle) );
+
+  pSsl = SSL_new( pTls_Server_Ctx );
+  SSL_set_fd( pSsl, Fd );
+
+  if ( SSL_accept( pSsl ) == 1 )
+  {
+    Tls_Handshakes++;
+    if ( SSL_session_reused( pSsl ) )
+    {
+      Tls_Resumed++;
+    }
+
+    while ( (Got = SSL_read( pSsl, Buff, sizeof(Buff) )) > 0 )
+    {
+      SSL_write( pSsl, Buff, Got );
+    }
+
+    /* As shut down, OpenSSL drops the session of a connection that wasn't,
+       a close_notify to a closed socket would be a SIGPIPE */
+    SSL_set_shutdown( pSsl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN );
+  }
+
+  SSL_free( pSsl );
+}
+
+/*===========================================================================*/
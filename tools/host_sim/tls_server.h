@@ -0,0 +1,39 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   tls_server.h
+@brief  Host build, a TLS broker stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Takes TLS 1.2 connections to the device port 8883 with a certificate of
+its own, keeps their sessions by ID to resume them, and echoes what comes
+on a connection until it is closed. It counts the handshakes and those
+that resumed a session, and can forget the sessions, as a broker that
+restarted.
+*/
+
+#ifndef __TLS_SERVER_H__
+#define __TLS_SERVER_H__
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdint.h>
+
+/*=============================================================================
+Prototypes
+=============================================================================*/
+
+extern bool       Sim_Tls_Start( void );
+extern void       Sim_Tls_Forget_Sessions( void );
+extern uint32_t   Sim_Tls_Handshakes( void );
+extern uint32_t   Sim_Tls_Resumed( void );
+
+#endif  /* __TLS_SERVER_H__ */
+
+/*===========================================================================*/
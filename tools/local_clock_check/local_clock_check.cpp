@@ -0,0 +1,382 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   local_clock_check.cpp
+@brief  Check the local clock, drift, the micros() wrap and the time zones
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/local_clock.cpp on the virtual clock of tools/host_sim, where
+micros() wraps every 2^32 us, 71.6 minutes, as on the chip. Each part
+prints what it found and FAIL where it is not what is expected:
+
+Drift, micros() runs -d ppm fast against the reference and the clock is
+synced every 16 minutes for 4 hours, Local_Clock_Handle() every 10 s. The
+drift measured has to be within 1 ppm of it and the error before the
+last sync within 2 ms, it would be 38 ms at 40 ppm without correction.
+
+Wrap, no more syncs for 5 wraps of micros(), Local_Clock_Handle() once an
+hour. The clock never goes backward, read every second around each wrap,
+and stays within 5 ms.
+
+Time zones, "CST-8" over the new year, then the two DST transitions of
+"CET-1CEST,M3.5.0,M10.5.0/3", the local minutes seen as the clock runs
+through them:
+
+  spring    01:58 01:59 03:00 03:01     02:xx never seen
+  autumn    02:58 02:59 02:00 02:01     02:xx twice, once in each offset
+
+Last the broken-down time right after a sync is compared to localtime_r()
+of the C library for -n random times of 1990 to 2060, in several zones,
+north and south, with default rules and with Julian day rules.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target local_clock_check
+
+Usage:
+  local_clock_check [-d drift ppm] [-n times] [-v]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "local_clock.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define US_PER_S          1000000LL
+
+/* 2026-10-19 00:00:00 UTC */
+#define CHECK_START_UTC_S 1792368000LL
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static bool     Check_Ok = true;
+
+/* The reference, UTC at virtual time 0 and how much slower it runs */
+static int64_t  Ref_Utc_us  = CHECK_START_UTC_S * US_PER_S;
+static double   Ref_Drift   = 40e-6;
+
+/* The zones compared with the C library, as the clock and the C library
+   take them. For DST without rules the C library reads tzdata, where the
+   US rules of before 2007 are, so it is given the rules of today */
+static const char *Check_Zones[][2] =
+{
+  { "CST-8",                                  "CST-8" },
+  { "CET-1CEST,M3.5.0,M10.5.0/3",             "CET-1CEST,M3.5.0,M10.5.0/3" },
+  { "EST5EDT",                                "EST5EDT,M3.2.0,M11.1.0" },
+  { "PST8PDT,M3.2.0/2:00:00,M11.1.0/2:00:00", "PST8PDT,M3.2.0/2:00:00,M11.1.0/2:00:00" },
+  { "AEST-10AEDT,M10.1.0,M4.1.0/3",           "AEST-10AEDT,M10.1.0,M4.1.0/3" },
+  { "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",       "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1" },
+  { "<+0530>-5:30",                           "<+0530>-5:30" },
+  { "XXX3YYY,J60/1,300/4",                    "XXX3YYY,J60/1,300/4" },
+};
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void     Check( bool Condition, const char *pWhat );
+static int64_t  Check_Ref_us( void );
+static void     Check_Sync_At( int64_t Utc_s );
+static void     Check_Drift( void );
+static void     Check_Wrap( void );
+static std::string  Check_Minutes( int64_t From_Utc_s, uint32_t Seconds );
+static void     Check_Zones_Run( uint32_t Times );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Check( bool Condition, const char *pWhat )
+{
+  printf( "  %-4s %s\n", Condition ? "ok" : "FAIL", pWhat );
+  if ( !Condition )
+  {
+    Check_Ok = false;
+  }
+}
+
+/*===========================================================================*/
+
+/* UTC of the reference now, micros() runs Ref_Drift fast against it */
+static int64_t
+Check_Ref_us( void )
+{
+  return Ref_Utc_us + (int64_t)( (double)Sim_Clock_Us() / (1.0 + Ref_Drift) );
+}
+
+/*===========================================================================*/
+
+/* Step the clock to a UTC time, the reference goes along */
+static void
+Check_Sync_At( int64_t Utc_s )
+{
+  Ref_Utc_us += Utc_s * US_PER_S - Check_Ref_us();
+  Local_Clock_Sync( Check_Ref_us() );
+  Local_Clock_Handle();
+}
+
+/*===========================================================================*/
+
+static void
+Check_Drift( void )
+{
+  int64_t   Error_us = 0;
+  int64_t   First_Error_us = 0;
+  uint32_t  Sync;
+  uint32_t  Step;
+  char      Line[128];
+
+  printf( "Drift\n" );
+
+  Local_Clock_Sync( Check_Ref_us() );
+
+  for ( Sync = 0; Sync < 15; Sync++ )
+  {
+    for ( Step = 0; Step < 16 * 6; Step++ )
+    {
+      Sim_Clock_Advance( 10 * US_PER_S );
+      Local_Clock_Handle();
+    }
+
+    Error_us = Local_Clock_Now_us() - Check_Ref_us();
+    if ( Sync == 0 )
+    {
+      First_Error_us = Error_us;
+    }
+    Local_Clock_Sync( Check_Ref_us() );
+  }
+
+  snprintf( Line, sizeof(Line), "drift %ld ppb, %.0f ppm fast",
+            (long)Local_Clock_Get_Drift_ppb(), Ref_Drift * 1e6 );
+  Check( llabs( Local_Clock_Get_Drift_ppb() - (int64_t)(Ref_Drift / (1.0 - Ref_Drift) * 1e9) ) <= 1000, Line );
+
+  snprintf( Line, sizeof(Line), "error %ld us before the last sync, %ld us before the first",
+            (long)Error_us, (long)First_Error_us );
+  Check( llabs( Error_us ) <= 2000, Line );
+}
+
+/*===========================================================================*/
+
+static void
+Check_Wrap( void )
+{
+  uint64_t  Wrap_us;
+  int64_t   Last_us;
+  int64_t   Now_us;
+  int64_t   Error_us;
+  int64_t   Worst_us  = 0;
+  bool      Monotonic = true;
+  uint32_t  Wraps;
+  uint32_t  Step;
+  char      Line[128];
+
+  printf( "Wrap\n" );
+
+  Last_us = Local_Clock_Now_us();
+  for ( Wraps = 0; Wraps < 5; Wraps++ )
+  {
+    /* Local_Clock_Handle() once an hour up to 30 s before the wrap */
+    Wrap_us = ( (Sim_Clock_Us() >> 32) + 1 ) << 32;
+    while ( Sim_Clock_Us() + 3600 * US_PER_S < Wrap_us - 30 * US_PER_S )
+    {
+      Sim_Clock_Advance( 3600 * US_PER_S );
+      Local_Clock_Handle();
+    }
+    Sim_Clock_Advance( Wrap_us - 30 * US_PER_S - Sim_Clock_Us() );
+
+    /* Then every second over it */
+    for ( Step = 0; Step < 60; Step++ )
+    {
+      Now_us    = Local_Clock_Now_us();
+      Monotonic = Monotonic && ( Now_us >= Last_us );
+      Last_us   = Now_us;
+      Error_us  = llabs( Now_us - Check_Ref_us() );
+      Worst_us  = ( Error_us > Worst_us ) ? Error_us : Worst_us;
+      Sim_Clock_Advance( US_PER_S );
+      Local_Clock_Handle();
+    }
+  }
+
+  snprintf( Line, sizeof(Line), "never backward over %u wraps", Wraps );
+  Check( Monotonic, Line );
+  snprintf( Line, sizeof(Line), "worst error %ld us", (long)Worst_us );
+  Check( Worst_us <= 5000, Line );
+}
+
+/*===========================================================================*/
+
+/* The local minutes seen, as "hh:mm", Local_Clock_Handle() every second */
+static std::string
+Check_Minutes( int64_t From_Utc_s, uint32_t Seconds )
+{
+  LOCAL_TIME_RECORD Time;
+  std::string       Seen;
+  char              Minute[8];
+  int               Last = -1;
+  uint32_t          Step;
+
+  Check_Sync_At( From_Utc_s );
+  for ( Step = 0; Step < Seconds; Step++ )
+  {
+    Local_Clock_Get( &Time );
+    if ( (Time.hour * 60 + Time.minute) != Last )
+    {
+      Last = Time.hour * 60 + Time.minute;
+      snprintf( Minute, sizeof(Minute), "%s%02u:%02u", Seen.empty() ? "" : " ", Time.hour, Time.minute );
+      Seen += Minute;
+    }
+    Sim_Clock_Advance( US_PER_S );
+    Local_Clock_Handle();
+  }
+
+  return Seen;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Zones_Run( uint32_t Times )
+{
+  LOCAL_TIME_RECORD Time;
+  struct tm         Tm;
+  std::string       Seen;
+  time_t            Utc_s;
+  uint32_t          Zone;
+  uint32_t          Index;
+  uint32_t          Wrong = 0;
+  char              Line[160];
+
+  printf( "Time zones\n" );
+
+  /* 2026-12-31 15:59:00 UTC, a minute to the new year in China */
+  Check( Local_Clock_Set_Timezone( "CST-8" ), "CST-8 is taken" );
+  Seen = Check_Minutes( 1798732740LL, 120 );
+  Local_Clock_Get( &Time );
+  snprintf( Line, sizeof(Line), "CST-8 over the new year, %s, then %04u-%02u-%02u weekday %u",
+            Seen.c_str(), Time.year, Time.month, Time.day, Time.weekday );
+  Check( (Seen == "23:59 00:00") && (Time.year == 2027) && (Time.month == 1) && (Time.day == 1) &&
+         (Time.weekday == 5), Line );
+
+  /* 2026-03-29 00:58:00 UTC, two minutes to the spring transition */
+  Check( Local_Clock_Set_Timezone( "CET-1CEST,M3.5.0,M10.5.0/3" ), "CET-1CEST,M3.5.0,M10.5.0/3 is taken" );
+  Seen = Check_Minutes( 1774745880LL, 240 );
+  snprintf( Line, sizeof(Line), "spring forward, %s", Seen.c_str() );
+  Check( Seen == "01:58 01:59 03:00 03:01", Line );
+
+  /* 2026-10-25 00:58:00 UTC, two minutes to the autumn transition */
+  Seen = Check_Minutes( 1792889880LL, 240 );
+  snprintf( Line, sizeof(Line), "fall back, %s", Seen.c_str() );
+  Check( Seen == "02:58 02:59 02:00 02:01", Line );
+
+  Check( !Local_Clock_Set_Timezone( "CET-1CEST,M13.5.0,M10.5.0" ), "a bad rule is refused" );
+  Check( !Local_Clock_Set_Timezone( "-8" ), "no zone name is refused" );
+
+  /* The C library on random times */
+  for ( Zone = 0; Zone < sizeof(Check_Zones) / sizeof(Check_Zones[0]); Zone++ )
+  {
+    setenv( "TZ", Check_Zones[Zone][1], 1 );
+    tzset();
+    if ( !Local_Clock_Set_Timezone( Check_Zones[Zone][0] ) )
+    {
+      printf( "  FAIL %s is refused\n", Check_Zones[Zone][0] );
+      Check_Ok = false;
+      continue;
+    }
+
+    for ( Index = 0; Index < Times; Index++ )
+    {
+      /* 1990 to 2060 */
+      Utc_s = 631152000 + (time_t)( (uint64_t)rand() * RAND_MAX + rand() ) % (70LL * 365 * 86400);
+      Check_Sync_At( Utc_s );
+      localtime_r( &Utc_s, &Tm );
+      Local_Clock_Get( &Time );
+
+      if ( (Time.year != Tm.tm_year + 1900) || (Time.month != Tm.tm_mon + 1) || (Time.day != Tm.tm_mday) ||
+           (Time.weekday != Tm.tm_wday) || (Time.hour != Tm.tm_hour) || (Time.minute != Tm.tm_min) ||
+           (Time.second != Tm.tm_sec) )
+      {
+        if ( Wrong++ < 5 )
+        {
+          printf( "       %s at %ld: %04u-%02u-%02u %02u:%02u:%02u, the C library %04d-%02d-%02d %02d:%02d:%02d\n",
+                  Check_Zones[Zone][0], (long)Utc_s,
+                  Time.year, Time.month, Time.day, Time.hour, Time.minute, Time.second,
+                  Tm.tm_year + 1900, Tm.tm_mon + 1, Tm.tm_mday, Tm.tm_hour, Tm.tm_min, Tm.tm_sec );
+        }
+      }
+    }
+  }
+
+  snprintf( Line, sizeof(Line), "%u zones, %u times each, %u not as the C library",
+            (unsigned)(sizeof(Check_Zones) / sizeof(Check_Zones[0])), Times, Wrong );
+  Check( Wrong == 0, Line );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  uint32_t  Times = 2000;
+  FILE      *pConsole;
+  int       Opt;
+  bool      Verbose = false;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-d" ) == 0) && (Opt + 1 < argc) )
+    {
+      Ref_Drift = atof( argv[++Opt] ) * 1e-6;
+    }
+    else if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Times = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( strcmp( argv[Opt], "-v" ) == 0 )
+    {
+      Verbose = true;
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-d drift ppm] [-n times] [-v]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  pConsole = Verbose ? stdout : fopen( "/dev/null", "w" );
+  Sim_Serial_Set_Output( pConsole );
+  srand( 1 );
+
+  Check_Drift();
+  Check_Wrap();
+  Check_Zones_Run( Times );
+
+  printf( "%s\n", Check_Ok ? "PASS" : "FAIL" );
+  return Check_Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,297 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   log_rate_check.cpp
+@brief  Check the per call site log rate limiting under churn
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/logging.cpp on the host shims of tools/host_sim, the console
+going to a file. -n call sites, more than the LOG_RATE_TABLE_SIZE slots of
+the rate table, take turns logging a message each every -i ms for -t
+seconds, so their slots are recycled all the time.
+
+Then the console is read back. The messages printed are counted, and the
+counts of the "messages suppressed" lines are summed. It fails if
+
+  - more messages got through than the slots allow, a full burst for each
+    slot and a token per LOG_RATE_REFILL_MS after
+  - LOG_Get_Suppressed_Count() doesn't match the logs not printed
+  - more was reported suppressed than was, or nothing was
+
+What is dropped at call sites still in the table is reported once those
+log again, so the reported count may be short of the dropped count.
+
+A first phase has a single site log once per LOG_RATE_REFILL_MS, the rate
+it is allowed, none of it may be dropped.
+
+A last phase checks the collapsing of identical messages, at a level the
+rate limit leaves alone. A message logged 10 times prints once and holds
+9 repeats, a different message prints "repeated 9 times" before itself.
+That one logged 3 more times, then nothing, must get its "repeated 3
+times" from LOG_Handle() once LOG_REPEAT_FLUSH_MS went by, not later.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target log_rate_check
+
+Usage:
+  log_rate_check [-n call sites] [-i interval ms] [-t seconds]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "logging.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The file all the call sites are in, a line number each */
+static const char   Check_File[] PROGMEM = "churn.cpp";
+
+typedef struct
+{
+  unsigned long   printed;      /* Messages of the call sites */
+  unsigned long   reported;     /* Sum of the "messages suppressed" lines */
+  unsigned long   report_lines;
+  unsigned long   repeats;      /* Lines of the repeated messages */
+  unsigned long   repeated;     /* Sum of the "last message repeated" lines */
+  unsigned long   repeat_lines;
+
+} CHECK_CONSOLE_RECORD;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check_Read_Console( FILE *pFile, long From, CHECK_CONSOLE_RECORD *pConsole );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Check_Read_Console( FILE *pFile, long From, CHECK_CONSOLE_RECORD *pConsole )
+{
+  char            Line[256];
+  const char      *pText;
+  unsigned long   Count;
+
+  memset( pConsole, 0, sizeof(CHECK_CONSOLE_RECORD) );
+  fflush( pFile );
+  fseek( pFile, From, SEEK_SET );
+
+  while ( fgets( Line, sizeof(Line), pFile ) != NULL )
+  {
+    pText = strstr( Line, "]: " );
+    if ( pText == NULL )
+    {
+      continue;
+    }
+    pText += 3;
+
+    if ( strncmp( pText, "site ", 5 ) == 0 )
+    {
+      pConsole->printed++;
+    }
+    else if ( strncmp( pText, "repeat ", 7 ) == 0 )
+    {
+      pConsole->repeats++;
+    }
+    else if ( sscanf( pText, "Log: last message repeated %lu times", &Count ) == 1 )
+    {
+      pConsole->repeated += Count;
+      pConsole->repeat_lines++;
+    }
+    else if ( sscanf( pText, "Log: %lu messages suppressed", &Count ) == 1 )
+    {
+      pConsole->reported += Count;
+      pConsole->report_lines++;
+    }
+  }
+
+  fseek( pFile, 0, SEEK_END );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  CHECK_CONSOLE_RECORD  Console;
+  uint32_t        Sites       = 110;
+  uint32_t        Interval_ms = 1;
+  uint32_t        Seconds     = 60;
+  unsigned long   Calls       = 0;
+  unsigned long   Limit;
+  unsigned long   Pending;
+  unsigned long   Dropped;
+  uint32_t        Index;
+  uint64_t        End_us;
+  long            From;
+  FILE            *pConsole;
+  int             Opt;
+  bool            Ok = true;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Sites = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-i" ) == 0) && (Opt + 1 < argc) )
+    {
+      Interval_ms = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-t" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seconds = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-n call sites] [-i interval ms] [-t seconds]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( (Sites <= LOG_RATE_TABLE_SIZE) || (Interval_ms == 0) || (Seconds == 0) )
+  {
+    fprintf( stderr, "More call sites than the %u slots, an interval and a time above 0\n", LOG_RATE_TABLE_SIZE );
+    return 1;
+  }
+
+  pConsole = tmpfile();
+  if ( pConsole == NULL )
+  {
+    fprintf( stderr, "No temporary file for the console\n" );
+    return 1;
+  }
+  Sim_Serial_Set_Output( pConsole );
+
+  /*---------------------------------------------------------------------------*/
+
+  /* At the refill rate, nothing is dropped */
+  for ( Index = 0; Index < 60; Index++ )
+  {
+    LOG_ID_Handle( LOG_ID_DEFAULT, DBG_W, Check_File, NULL, 1, PSTR("site quiet %u\n"), Index );
+    Sim_Clock_Advance( (uint64_t)LOG_RATE_REFILL_MS * 1000 );
+  }
+  Check_Read_Console( pConsole, 0, &Console );
+  printf( "Quiet:  60 logs, one per %u ms, %lu printed, %lu dropped\n",
+          LOG_RATE_REFILL_MS, Console.printed, LOG_Get_Suppressed_Count() );
+  if ( (Console.printed != 60) || (LOG_Get_Suppressed_Count() != 0) )
+  {
+    printf( "FAIL: a site under the limit lost logs\n" );
+    Ok = false;
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* The call sites take turns, they are more than the slots */
+  From   = ftell( pConsole );
+  End_us = Sim_Clock_Us() + (uint64_t)Seconds * 1000000;
+  while ( Sim_Clock_Us() < End_us )
+  {
+    LOG_ID_Handle( LOG_ID_DEFAULT, DBG_W, Check_File, NULL, 100 + (Calls % Sites),
+                   PSTR("site %lu call %lu\n"), Calls % Sites, Calls );
+    Calls++;
+    Sim_Clock_Advance( (uint64_t)Interval_ms * 1000 );
+  }
+
+  Check_Read_Console( pConsole, From, &Console );
+  Dropped = LOG_Get_Suppressed_Count();
+  Limit   = (unsigned long)LOG_RATE_TABLE_SIZE * (LOG_RATE_BURST + (Seconds * 1000UL) / LOG_RATE_REFILL_MS + 1);
+  Pending = ( Console.reported <= Dropped ) ? (Dropped - Console.reported) : 0;
+
+  printf( "Churn:  %u sites, %lu logs in %u s, %lu printed, limit %lu\n", Sites, Calls, Seconds, Console.printed, Limit );
+  printf( "        %lu dropped, %lu reported in %lu lines, %lu not reported yet\n",
+          Dropped, Console.reported, Console.report_lines, Pending );
+
+  if ( Console.printed > Limit )
+  {
+    printf( "FAIL: %lu printed, the slots allow %lu\n", Console.printed, Limit );
+    Ok = false;
+  }
+  if ( Dropped != Calls - Console.printed )
+  {
+    printf( "FAIL: %lu dropped counted, %lu logs not printed\n", Dropped, Calls - Console.printed );
+    Ok = false;
+  }
+  if ( (Console.reported > Dropped) || (Console.reported == 0) )
+  {
+    printf( "FAIL: %lu reported suppressed, %lu dropped\n", Console.reported, Dropped );
+    Ok = false;
+  }
+
+  /*---------------------------------------------------------------------------*/
+
+  /* Repeats collapse, at a level the rate limit doesn't drop */
+  From = ftell( pConsole );
+  for ( Index = 0; Index < 10; Index++ )
+  {
+    LOG_ID_Handle( LOG_ID_DEFAULT, DBG_C, Check_File, NULL, 2, PSTR("repeat same\n") );
+    Sim_Clock_Advance( 1000000 );
+  }
+  Check_Read_Console( pConsole, From, &Console );
+  printf( "Repeat: 10 the same, %lu printed, %lu summaries\n", Console.repeats, Console.repeat_lines );
+  if ( (Console.repeats != 1) || (Console.repeat_lines != 0) )
+  {
+    printf( "FAIL: the same message wasn't collapsed\n" );
+    Ok = false;
+  }
+
+  /* A different message flushes them first */
+  LOG_ID_Handle( LOG_ID_DEFAULT, DBG_C, Check_File, NULL, 3, PSTR("repeat other\n") );
+  Check_Read_Console( pConsole, From, &Console );
+  printf( "        then another, %lu printed, %lu repeats summarised\n", Console.repeats, Console.repeated );
+  if ( (Console.repeats != 2) || (Console.repeated != 9) || (Console.repeat_lines != 1) )
+  {
+    printf( "FAIL: another message didn't print the 9 repeats before itself\n" );
+    Ok = false;
+  }
+
+  /* Repeats then quiet, loop() goes on calling LOG_Handle() */
+  for ( Index = 0; Index < 3; Index++ )
+  {
+    Sim_Clock_Advance( 1000000 );
+    LOG_ID_Handle( LOG_ID_DEFAULT, DBG_C, Check_File, NULL, 3, PSTR("repeat other\n") );
+  }
+  End_us = Sim_Clock_Us() + ((uint64_t)LOG_REPEAT_FLUSH_MS + 1000) * 1000;
+  while ( Sim_Clock_Us() < End_us )
+  {
+    LOG_Handle();
+    Sim_Clock_Advance( 100000 );
+  }
+  Check_Read_Console( pConsole, From, &Console );
+  printf( "        3 more then quiet for %u ms, %lu repeats summarised\n",
+          LOG_REPEAT_FLUSH_MS + 1000, Console.repeated );
+  if ( (Console.repeated != 12) || (Console.repeat_lines != 2) || (LOG_Get_Repeated_Count() != 12) )
+  {
+    printf( "FAIL: the repeats of a quiet message weren't printed after %u ms\n", LOG_REPEAT_FLUSH_MS );
+    Ok = false;
+  }
+
+  fclose( pConsole );
+
+  printf( "%s\n", Ok ? "PASS" : "FAIL" );
+  return Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,177 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_skip_check.cpp
+@brief  Check the MQTT client acknowledges the QoS 1 packets too long to take
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/mqtt_client.cpp with the Wi-Fi manager on the host shims of
+tools/host_sim, against its broker stand-in. Once subscribed, the broker
+sends it QoS 1 commands longer than its receive buffer, which it skips,
+then a short one it takes:
+
+  long payload    600 bytes of payload
+  long topic      a 300 byte topic, the packet ID past the buffer
+  short           the 'test' command, read after the skipped ones
+
+Each must get its PUBACK, else the broker keeps it in flight for good,
+the two long ones must be counted in mqtt_rx_skipped_total and the
+connection must still be up.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target mqtt_skip_check
+
+Usage:
+  mqtt_skip_check [-v]      -v for the console of the firmware
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "broker.h"
+#include "esp8266_global.h"
+#include "metrics.h"
+#include "mqtt_client.h"
+#include "wifi_manager.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define CHECK_CHIP_ID         0x00c0ffee
+
+/* Each loop() pass */
+#define CHECK_LOOP_US         100
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static bool   Check_Ok = true;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check( bool Condition, const char *pWhat );
+static void   Check_Run( uint32_t Ms );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Check( bool Condition, const char *pWhat )
+{
+  printf( "  %-4s %s\n", Condition ? "ok" : "FAIL", pWhat );
+  if ( !Condition )
+  {
+    Check_Ok = false;
+  }
+}
+
+/*===========================================================================*/
+
+/* The loop() of the firmware, for the parts the client needs */
+static void
+Check_Run( uint32_t Ms )
+{
+  uint64_t  End_us = Sim_Clock_Us() + (uint64_t)Ms * 1000;
+
+  while ( Sim_Clock_Us() < End_us )
+  {
+    Wifi_Handle();
+    mqtt_handle_client();
+    Sim_Clock_Advance( CHECK_LOOP_US );
+  }
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  FILE        *pConsole;
+  uint32_t    Waited_ms;
+  uint32_t    Connects;
+  char        Prefix[64];
+  std::string Long_Payload( 600, 'x' );
+  std::string Long_Topic;
+
+  if ( (argc > 1) && (strcmp( argv[1], "-v" ) == 0) )
+  {
+    pConsole = stdout;
+  }
+  else if ( argc > 1 )
+  {
+    fprintf( stderr, "Usage: %s [-v]\n", argv[0] );
+    return 1;
+  }
+  else
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+  Sim_Set_Chip_Id( CHECK_CHIP_ID );
+
+  if ( !Sim_Broker_Start() )
+  {
+    fprintf( stderr, "No socket for the broker\n" );
+    return 1;
+  }
+
+  My_Config_Set_Defaults( &My_Config );
+  Sim_Wifi_Add_Ap( My_Config.sta_list[0].ssid, -50, 1 );
+  Wifi_Initialise();
+  mqtt_client_init();
+
+  /* Until the broker has the subscription */
+  for ( Waited_ms = 0; (Sim_Broker_Subscriptions() == 0) && (Waited_ms < 30000); Waited_ms++ )
+  {
+    Check_Run( 1 );
+  }
+  if ( Sim_Broker_Subscriptions() == 0 )
+  {
+    fprintf( stderr, "Not subscribed at the broker\n" );
+    return 1;
+  }
+  Connects = Sim_Broker_Connects();
+
+  snprintf( Prefix, sizeof(Prefix), MQTT_TOPIC_ROOT "/%06x/cmd/", CHECK_CHIP_ID );
+  Long_Topic = std::string( Prefix ) + std::string( 300, 'a' );
+
+  Sim_Broker_Publish_Qos1( (std::string( Prefix ) + "test").c_str(), Long_Payload.c_str(), 101 );
+  Sim_Broker_Publish_Qos1( Long_Topic.c_str(), "1", 102 );
+  Sim_Broker_Publish_Qos1( (std::string( Prefix ) + "test").c_str(), "1", 103 );
+  Check_Run( 1000 );
+
+  printf( "QoS 1 over the receive buffer\n" );
+  Check( Sim_Broker_Acked( 101 ), "long payload acknowledged" );
+  Check( Sim_Broker_Acked( 102 ), "long topic acknowledged" );
+  Check( Sim_Broker_Acked( 103 ), "short command after them acknowledged" );
+  Check( Metric_Get( METRIC_MQTT_RX_SKIPPED ) == 2, "two counted as skipped" );
+  Check( mqtt_is_connected() && (Sim_Broker_Connects() == Connects), "still connected" );
+
+  printf( "%s\n", Check_Ok ? "PASS" : "FAIL" );
+  return Check_Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,171 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_subscribe_check.cpp
+@brief  Check the MQTT client subscribes again when the SUBSCRIBE isn't sent
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/mqtt_client.cpp with the Wi-Fi manager on the host shims of
+tools/host_sim, against its broker stand-in. Once the broker took CONNECT,
+the next -f writes of the connection send nothing, the SUBSCRIBE among
+them. The client must send it again on a later pass, so it fails if after
+-t seconds the broker has no subscription from it, the writes weren't all
+tried, or the state that follows the subscribe wasn't published.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target mqtt_subscribe_check
+
+Usage:
+  mqtt_subscribe_check [-f failed writes] [-t seconds] [-v]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "broker.h"
+#include "esp8266_global.h"
+#include "mqtt_client.h"
+#include "wifi_manager.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define CHECK_CHIP_ID         0x00c0ffee
+
+/* Each loop() pass */
+#define CHECK_LOOP_US         100
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check_Run( uint32_t Ms );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* The loop() of the firmware, for the parts the client needs */
+static void
+Check_Run( uint32_t Ms )
+{
+  uint64_t  End_us = Sim_Clock_Us() + (uint64_t)Ms * 1000;
+
+  while ( Sim_Clock_Us() < End_us )
+  {
+    Wifi_Handle();
+    mqtt_handle_client();
+    Sim_Clock_Advance( CHECK_LOOP_US );
+  }
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  uint32_t  Fail_Writes = 3;
+  uint32_t  Seconds     = 5;
+  uint32_t  Waited_ms;
+  FILE      *pConsole   = NULL;
+  char      Topic[64];
+  int       Opt;
+  bool      Ok = true;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-f" ) == 0) && (Opt + 1 < argc) )
+    {
+      Fail_Writes = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-t" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seconds = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( strcmp( argv[Opt], "-v" ) == 0 )
+    {
+      pConsole = stdout;
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-f failed writes] [-t seconds] [-v]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( pConsole == NULL )
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+  Sim_Set_Chip_Id( CHECK_CHIP_ID );
+
+  if ( !Sim_Broker_Start() )
+  {
+    fprintf( stderr, "No socket for the broker\n" );
+    return 1;
+  }
+
+  My_Config_Set_Defaults( &My_Config );
+  Sim_Wifi_Add_Ap( My_Config.sta_list[0].ssid, -50, 1 );
+  Wifi_Initialise();
+  mqtt_client_init();
+
+  /* Until the broker took CONNECT */
+  for ( Waited_ms = 0; !mqtt_is_connected() && (Waited_ms < 30000); Waited_ms++ )
+  {
+    Check_Run( 1 );
+  }
+  if ( !mqtt_is_connected() )
+  {
+    fprintf( stderr, "Not connected to the broker\n" );
+    return 1;
+  }
+
+  Sim_Net_Fail_Writes( Fail_Writes );
+  Check_Run( Seconds * 1000 );
+
+  snprintf( Topic, sizeof(Topic), MQTT_TOPIC_ROOT "/%06x/state/relay_status", CHECK_CHIP_ID );
+  printf( "%u writes failed after CONNACK, %u not tried, %u subscriptions, %u relay_status, %u connects\n",
+          Fail_Writes, Sim_Net_Failing_Writes(), Sim_Broker_Subscriptions(),
+          Sim_Broker_Count( Topic ), Sim_Broker_Connects() );
+
+  if ( Sim_Net_Failing_Writes() != 0 )
+  {
+    printf( "FAIL: the client stopped writing\n" );
+    Ok = false;
+  }
+  if ( Sim_Broker_Subscriptions() == 0 )
+  {
+    printf( "FAIL: the subscribe wasn't sent again\n" );
+    Ok = false;
+  }
+  if ( Sim_Broker_Count( Topic ) == 0 )
+  {
+    printf( "FAIL: no state after the subscribe\n" );
+    Ok = false;
+  }
+
+  printf( "%s\n", Ok ? "PASS" : "FAIL" );
+  return Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,230 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   mqtt_tls_check.cpp
+@brief  Check mqtt_transport.cpp counts a connect as resumed only if it was
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Builds main/mqtt_transport.cpp with MQTT_TLS_ENABLE on the host shims of
+tools/host_sim, its BearSSL client over OpenSSL, against the TLS broker
+stand-in. Each connect sets one of the two handshake metrics, by whether
+the session was resumed, the stand-in tells whether it resumed it:
+
+  first           nothing to offer, a full handshake
+  again           the session offered and resumed
+  forgotten       the broker forgot its sessions, offered but not resumed
+  after that      the session of the full handshake resumed
+
+A connect must also carry data both ways.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target mqtt_tls_check
+
+Needs OpenSSL, not built without it.
+
+Usage:
+  mqtt_tls_check [-v]      -v for the console of the firmware
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "tls_server.h"
+#include "esp8266_global.h"
+#include "metrics.h"
+#include "mqtt_transport.h"
+#include "wifi_manager.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define CHECK_PORT            8883
+
+/* Each loop() pass */
+#define CHECK_LOOP_US         100
+
+/* Left in both handshake metrics, the one set by a connect changes */
+#define CHECK_UNSET           0xffffffffUL
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static bool   Check_Ok = true;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check( bool Condition, const char *pWhat );
+static void   Check_Run( uint32_t Ms );
+static bool   Check_Echo( Client *pNet );
+static void   Check_Connect( const char *pWhat, bool Resumed );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Check( bool Condition, const char *pWhat )
+{
+  printf( "  %-4s %s\n", Condition ? "ok" : "FAIL", pWhat );
+  if ( !Condition )
+  {
+    Check_Ok = false;
+  }
+}
+
+/*===========================================================================*/
+
+/* The loop() of the firmware, for the Wi-Fi */
+static void
+Check_Run( uint32_t Ms )
+{
+  uint64_t  End_us = Sim_Clock_Us() + (uint64_t)Ms * 1000;
+
+  while ( Sim_Clock_Us() < End_us )
+  {
+    Wifi_Handle();
+    Sim_Clock_Advance( CHECK_LOOP_US );
+  }
+}
+
+/*===========================================================================*/
+
+/* A few bytes out and the same back, in real time */
+static bool
+Check_Echo( Client *pNet )
+{
+  static const uint8_t  Ping[] = { 0xc0, 0x00 };
+  uint8_t               Back[sizeof(Ping)];
+  size_t                Got = 0;
+  int                   Tries;
+  int                   Len;
+
+  if ( pNet->write( Ping, sizeof(Ping) ) != sizeof(Ping) )
+  {
+    return false;
+  }
+  for ( Tries = 0; (Got < sizeof(Back)) && (Tries < 1000); Tries++ )
+  {
+    Len = pNet->available() ? pNet->read( &Back[Got], sizeof(Back) - Got ) : 0;
+    Got += ( Len > 0 ) ? Len : 0;
+    usleep( 1000 );
+  }
+
+  return ( Got == sizeof(Back) ) && ( memcmp( Back, Ping, sizeof(Ping) ) == 0 );
+}
+
+/*===========================================================================*/
+
+/* A connect, which metric it set and what the broker did */
+static void
+Check_Connect( const char *pWhat, bool Resumed )
+{
+  uint32_t  Handshakes = Sim_Tls_Handshakes();
+  uint32_t  Resumes    = Sim_Tls_Resumed();
+  Client    *pNet;
+  bool      Set_Cached;
+  bool      Set_New;
+  int       Tries;
+  char      Line[160];
+
+  Metric_Set( METRIC_MQTT_HANDSHAKE_NEW_MS, CHECK_UNSET );
+  Metric_Set( METRIC_MQTT_HANDSHAKE_CACHED_MS, CHECK_UNSET );
+
+  pNet = Mqtt_Transport_Connect( "broker.local", CHECK_PORT );
+
+  /* The broker may finish its side after the device */
+  for ( Tries = 0; (Sim_Tls_Handshakes() == Handshakes) && (Tries < 1000); Tries++ )
+  {
+    usleep( 1000 );
+  }
+
+  Set_New    = ( Metric_Get( METRIC_MQTT_HANDSHAKE_NEW_MS ) != CHECK_UNSET );
+  Set_Cached = ( Metric_Get( METRIC_MQTT_HANDSHAKE_CACHED_MS ) != CHECK_UNSET );
+  snprintf( Line, sizeof(Line), "%s, counted %s, the broker %s, %s expected",
+            pWhat, Set_Cached ? "resumed" : ( Set_New ? "new" : "nothing" ),
+            (Sim_Tls_Resumed() > Resumes) ? "resumed" : "did a full handshake",
+            Resumed ? "resumed" : "new" );
+  Check( (pNet != NULL) && (Set_Cached == Resumed) && (Set_New == !Resumed) &&
+         ((Sim_Tls_Resumed() > Resumes) == Resumed), Line );
+
+  if ( pNet != NULL )
+  {
+    snprintf( Line, sizeof(Line), "%s, data both ways", pWhat );
+    Check( Check_Echo( pNet ), Line );
+  }
+  Mqtt_Transport_Stop();
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  FILE    *pConsole;
+
+  if ( (argc > 1) && (strcmp( argv[1], "-v" ) == 0) )
+  {
+    pConsole = stdout;
+  }
+  else if ( argc > 1 )
+  {
+    fprintf( stderr, "Usage: %s [-v]\n", argv[0] );
+    return 1;
+  }
+  else
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+
+  if ( !Sim_Tls_Start() )
+  {
+    fprintf( stderr, "No TLS broker\n" );
+    return 1;
+  }
+
+  My_Config_Set_Defaults( &My_Config );
+  Sim_Wifi_Add_Ap( My_Config.sta_list[0].ssid, -50, 1 );
+  Wifi_Initialise();
+  Check_Run( 10000 );
+  if ( !Wifi_Is_Connected() )
+  {
+    fprintf( stderr, "Not connected to the access point\n" );
+    return 1;
+  }
+
+  printf( "TLS sessions\n" );
+  Check_Connect( "first", false );
+  Check_Connect( "again", true );
+  Sim_Tls_Forget_Sessions();
+  Check_Connect( "forgotten by the broker", false );
+  Check_Connect( "after that", true );
+  Check( Metric_Get( METRIC_MQTT_CONNECT_FAILED ) == 0, "no connect failed" );
+
+  printf( "%s\n", Check_Ok ? "PASS" : "FAIL" );
+  return Check_Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+#==============================================================================
+# Copyright Mickey
+#==============================================================================
+"""
+@file   make_delta.py
+@brief  Make a firmware delta for /update, from the running image to a new one
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Writes the delta main/ota_delta.cpp applies, see the format there. The old
+image must be the .bin the device runs, byte for byte, the device refuses
+a delta whose old MD5 isn't that of its own flash.
+
+The new image is taken in pieces, each one copied from the old image where
+it is there, else carried as it is. A copy is looked for first where the
+last one left off, then anywhere through an index of MATCH_MIN byte
+blocks. After a change early in the image the code behind it moved, and
+its absolute addresses changed with it, so a long copy is broken every few
+words by a literal; the offset of the next copy is relative to the end of
+the last one, so picking up again costs two bytes.
+
+Prints the sizes of the new image, of it gzipped, which /update takes as
+well, and of the delta. Between builds of different compilers or a large
+rework little is left to copy, and the gzipped image is the smaller one.
+
+Usage:
+  make_delta.py old.bin new.bin out.delta
+
+Then:
+  curl -u user:password -F image=@out.delta http://<device>/update
+"""
+
+import argparse
+import gzip
+import hashlib
+import struct
+import sys
+
+MAGIC   = b"ESPD"
+VERSION = 1
+
+# Shortest copy looked for through the index, and at the expected place
+MATCH_MIN       = 8
+MATCH_MIN_NEXT  = 4
+
+# Most places of a block tried, the last ones indexed
+CANDIDATES_MAX  = 16
+
+
+def varint(value):
+    """Unsigned LEB128"""
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def match_length(old, old_pos, new, new_pos):
+    """Bytes equal from old_pos and new_pos on"""
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    length = 0
+    step = 64
+    while length < limit:
+        step = min(step, limit - length)
+        if old[old_pos + length:old_pos + length + step] == new[new_pos + length:new_pos + length + step]:
+            length += step
+        elif step > 1:
+            step //= 2
+        else:
+            break
+    return length
+
+
+def make_delta(old, new):
+    index = {}
+    for pos in range(len(old) - MATCH_MIN + 1):
+        places = index.setdefault(old[pos:pos + MATCH_MIN], [])
+        if len(places) == CANDIDATES_MAX:
+            places.pop(0)
+        places.append(pos)
+
+    out = bytearray()
+    literal = bytearray()
+    source = 0          # Where the last copy ended, as the device has it
+    pos = 0
+
+    def flush_literal():
+        if literal:
+            out.extend(varint((len(literal) << 1) | 1))
+            out.extend(literal)
+            literal.clear()
+
+    while pos < len(new):
+        # Where the last copy left off, past the literal since
+        best_from = source + len(literal)
+        best_len = 0
+        if best_from < len(old):
+            best_len = match_length(old, best_from, new, pos)
+        if best_len < MATCH_MIN_NEXT:
+            best_len = 0
+
+        for place in index.get(new[pos:pos + MATCH_MIN], ()):
+            length = match_length(old, place, new, pos)
+            if length > best_len + 2:
+                best_from, best_len = place, length
+
+        if best_len == 0:
+            literal.append(new[pos])
+            pos += 1
+            continue
+
+        flush_literal()
+        out.extend(varint(best_len << 1))
+        out.extend(varint(zigzag(best_from - source)))
+        source = best_from + best_len
+        pos += best_len
+
+    flush_literal()
+
+    header = MAGIC + struct.pack("<B3xII", VERSION, len(old), len(new)) + \
+             hashlib.md5(old).digest() + hashlib.md5(new).digest()
+    return header + bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Make a firmware delta for /update")
+    parser.add_argument("old", help="the .bin the device runs")
+    parser.add_argument("new", help="the .bin to update to")
+    parser.add_argument("out", help="the delta")
+    args = parser.parse_args()
+
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+
+    delta = make_delta(old, new)
+    with open(args.out, "wb") as f:
+        f.write(delta)
+
+    gzipped = len(gzip.compress(new, 9))
+    print("new   %8u bytes" % len(new))
+    print("gzip  %8u bytes, %5.1f %%" % (gzipped, 100.0 * gzipped / len(new)))
+    print("delta %8u bytes, %5.1f %%" % (len(delta), 100.0 * len(delta) / len(new)))
+    print("new MD5 %s" % hashlib.md5(new).hexdigest())
+    if len(delta) >= gzipped:
+        print("The gzipped image is smaller, send that instead")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
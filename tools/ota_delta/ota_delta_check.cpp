@@ -0,0 +1,651 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   ota_delta_check.cpp
+@brief  Apply a firmware delta with main/ota_delta.cpp, as the device does
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Feeds a delta made by make_delta.py to main/ota_delta.cpp in pieces of
+random length, up to the 2048 bytes a piece of an HTTP upload has, reads
+the old image from memory and collects the new one. It must come out
+byte for byte the new image, and no copy may read outside the old image.
+The header is checked as the device does, the old size and MD5 must be
+those of the old image.
+
+Without files the images are made up here from the seed, a new one with
+code inserted, removed and moved about in the old one, and the delta is
+made the way make_delta.py makes it. That is what ctest runs.
+
+Then the delta is cut short at the points of the header, after it and at
+each sixteenth, as a dropped upload gives, none may complete. It is also
+applied to a wrong base, the old image with a byte changed and one of
+another size, the header must be refused.
+
+Last it feeds -n broken deltas, each with a byte changed or cut short
+somewhere, as a bad link or a wrong file would give. Each one must fail,
+or come out not the new image so the MD5 check on the device refuses it,
+and none may read outside the old image or write past the new size.
+
+Prints the time the delta took to apply, on the host.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target ota_delta_check
+
+Usage:
+  ota_delta_check [old.bin new.bin delta] [-n broken deltas] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <map>
+#include <vector>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "ota_delta.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* HTTP_UPLOAD_BUFLEN of the web server */
+#define CHECK_PIECE_MAX_SIZE      2048
+
+/* The made up old image, about the sketch part of a small firmware */
+#define CHECK_IMAGE_SIZE          (96 * 1024)
+
+/* As make_delta.py, shortest copy through the index and where expected,
+   and most places of a block tried */
+#define CHECK_MATCH_MIN           8
+#define CHECK_MATCH_MIN_NEXT      4
+#define CHECK_CANDIDATES_MAX      16
+
+typedef struct
+{
+  const std::vector<UINT8>  *pOld;
+  std::vector<UINT8>        out;
+  UINT32    new_size;
+  UINT32    bad_reads;
+  UINT32    bad_writes;
+  BOOL      refused;          /* By the header callback */
+
+} CHECK_CONTEXT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void Check_Md5( const std::vector<UINT8> &Data, UINT8 *pDigest );
+static void Check_Make_Images( std::vector<UINT8> *pOld, std::vector<UINT8> *pNew );
+static void Check_Varint( std::vector<UINT8> *pOut, UINT32 Value );
+static UINT32 Check_Match( const std::vector<UINT8> &Old, UINT32 Old_Pos, const std::vector<UINT8> &New, UINT32 New_Pos );
+static void Check_Make_Delta( const std::vector<UINT8> &Old, const std::vector<UINT8> &New, std::vector<UINT8> *pDelta );
+static BOOL Check_Load( const char *pPath, std::vector<UINT8> *pData );
+static BOOL Check_Header( void *pContext, const OTA_DELTA_HEADER_RECORD *pHeader );
+static BOOL Check_Read( void *pContext, UINT32 Offset, UINT8 *pBuff, UINT16 Len );
+static BOOL Check_Write( void *pContext, const UINT8 *pBuff, UINT16 Len );
+static BOOL Check_Apply( const std::vector<UINT8> &Old, const std::vector<UINT8> &Delta,
+                         CHECK_CONTEXT_RECORD *pContext );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* RFC 1321, for the header as the device checks it, in uint32_t as UINT32
+   is 64 bits on the host */
+static void
+Check_Md5( const std::vector<UINT8> &Data, UINT8 *pDigest )
+{
+  static const UINT8  Shift[64] =
+  {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+  };
+  uint32_t            Sine[64];
+  uint32_t            State[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+  uint32_t            Word[16];
+  uint32_t            A, B, C, D, F, Temp;
+  UINT64              Bits = (UINT64)Data.size() * 8;
+  std::vector<UINT8>  Msg( Data );
+  size_t              Block;
+  UINT32              Index;
+
+  for ( Index = 0; Index < 64; Index++ )
+  {
+    Sine[Index] = (uint32_t)(UINT64)( fabs( sin( Index + 1.0 ) ) * 4294967296.0 );
+  }
+
+  Msg.push_back( 0x80 );
+  while ( (Msg.size() % 64) != 56 )
+  {
+    Msg.push_back( 0 );
+  }
+  for ( Index = 0; Index < 8; Index++ )
+  {
+    Msg.push_back( (UINT8)(Bits >> (8 * Index)) );
+  }
+
+  for ( Block = 0; Block < Msg.size(); Block += 64 )
+  {
+    for ( Index = 0; Index < 16; Index++ )
+    {
+      Word[Index] = (uint32_t)Msg[Block + 4 * Index] | ((uint32_t)Msg[Block + 4 * Index + 1] << 8) |
+                    ((uint32_t)Msg[Block + 4 * Index + 2] << 16) | ((uint32_t)Msg[Block + 4 * Index + 3] << 24);
+    }
+
+    A = State[0];
+    B = State[1];
+    C = State[2];
+    D = State[3];
+    for ( Index = 0; Index < 64; Index++ )
+    {
+      switch ( Index / 16 )
+      {
+        case 0:   F = (B & C) | (~B & D);   Temp = Index;                 break;
+        case 1:   F = (D & B) | (~D & C);   Temp = (5 * Index + 1) % 16;  break;
+        case 2:   F = B ^ C ^ D;            Temp = (3 * Index + 5) % 16;  break;
+        default:  F = C ^ (B | ~D);         Temp = (7 * Index) % 16;      break;
+      }
+      F = F + A + Sine[Index] + Word[Temp];
+      A = D;
+      D = C;
+      C = B;
+      B = B + ((F << Shift[Index]) | (F >> (32 - Shift[Index])));
+    }
+    State[0] += A;
+    State[1] += B;
+    State[2] += C;
+    State[3] += D;
+  }
+
+  for ( Index = 0; Index < 16; Index++ )
+  {
+    pDigest[Index] = (UINT8)(State[Index / 4] >> (8 * (Index % 4)));
+  }
+}
+
+/*===========================================================================*/
+
+/* Code like words and a table repeated, then the new one from it: a
+   function inserted early so what follows moves, its calls to fixed
+   addresses changed every few words, a part removed, a part moved and
+   more added at the end */
+static void
+Check_Make_Images( std::vector<UINT8> *pOld, std::vector<UINT8> *pNew )
+{
+  std::vector<UINT8>  Insert;
+  UINT32  Index;
+  UINT32  At;
+
+  pOld->clear();
+  pNew->clear();
+
+  while ( pOld->size() < CHECK_IMAGE_SIZE )
+  {
+    if ( (rand() % 8) == 0 )
+    {
+      /* A table or string the compiler put again */
+      At = rand() % (pOld->size() + 1);
+      pOld->insert( pOld->end(), pOld->begin() + At, pOld->begin() + At + ((pOld->size() - At) % 64) );
+    }
+    else
+    {
+      pOld->push_back( (UINT8)(rand() & 0x3f) );
+      pOld->push_back( (UINT8)(rand()) );
+      pOld->push_back( (UINT8)(0x40 | (rand() & 0x0f)) );
+    }
+  }
+  pOld->resize( CHECK_IMAGE_SIZE );
+
+  for ( Index = 0; Index < 700; Index++ )
+  {
+    Insert.push_back( (UINT8)rand() );
+  }
+
+  pNew->insert( pNew->end(), pOld->begin(), pOld->begin() + 4096 );
+  pNew->insert( pNew->end(), Insert.begin(), Insert.end() );
+  for ( Index = 4096; Index < 40000; Index++ )
+  {
+    pNew->push_back( ((Index % 24) == 0) ? (UINT8)((*pOld)[Index] + 3) : (*pOld)[Index] );
+  }
+  pNew->insert( pNew->end(), pOld->begin() + 60000, pOld->begin() + 80000 );
+  pNew->insert( pNew->end(), pOld->begin() + 42000, pOld->begin() + 60000 );
+  pNew->insert( pNew->end(), pOld->begin() + 80000, pOld->end() );
+  pNew->insert( pNew->end(), Insert.begin(), Insert.begin() + 300 );
+}
+
+/*===========================================================================*/
+
+/* Unsigned LEB128 */
+static void
+Check_Varint( std::vector<UINT8> *pOut, UINT32 Value )
+{
+  while ( Value >= 0x80 )
+  {
+    pOut->push_back( (UINT8)(Value | 0x80) );
+    Value >>= 7;
+  }
+  pOut->push_back( (UINT8)Value );
+}
+
+/*===========================================================================*/
+
+/* Bytes equal from Old_Pos and New_Pos on */
+static UINT32
+Check_Match( const std::vector<UINT8> &Old, UINT32 Old_Pos, const std::vector<UINT8> &New, UINT32 New_Pos )
+{
+  UINT32  Len = 0;
+
+  while ( ((Old_Pos + Len) < Old.size()) && ((New_Pos + Len) < New.size()) && (Old[Old_Pos + Len] == New[New_Pos + Len]) )
+  {
+    Len++;
+  }
+
+  return Len;
+}
+
+/*===========================================================================*/
+
+/* As make_delta.py makes it */
+static void
+Check_Make_Delta( const std::vector<UINT8> &Old, const std::vector<UINT8> &New, std::vector<UINT8> *pDelta )
+{
+  std::map<std::vector<UINT8>, std::vector<UINT32> >  Index;
+  std::vector<UINT8>  Literal;
+  std::vector<UINT8>  Block;
+  std::vector<UINT32> *pPlaces;
+  UINT8       Header[OTA_DELTA_HEADER_SIZE];
+  UINT32      Source = 0;
+  UINT32      Pos    = 0;
+  UINT32      Best_From;
+  UINT32      Best_Len;
+  UINT32      Len;
+  UINT32      Place;
+  INT32       Offset;
+
+  for ( Place = 0; (Place + CHECK_MATCH_MIN) <= Old.size(); Place++ )
+  {
+    pPlaces = &Index[std::vector<UINT8>( Old.begin() + Place, Old.begin() + Place + CHECK_MATCH_MIN )];
+    if ( pPlaces->size() == CHECK_CANDIDATES_MAX )
+    {
+      pPlaces->erase( pPlaces->begin() );
+    }
+    pPlaces->push_back( Place );
+  }
+
+  memset( Header, 0, sizeof(Header) );
+  memcpy( Header, OTA_DELTA_MAGIC, 4 );
+  Header[4] = OTA_DELTA_VERSION;
+  for ( Place = 0; Place < 4; Place++ )
+  {
+    Header[8 + Place]  = (UINT8)(Old.size() >> (8 * Place));
+    Header[12 + Place] = (UINT8)(New.size() >> (8 * Place));
+  }
+  Check_Md5( Old, &Header[16] );
+  Check_Md5( New, &Header[32] );
+  pDelta->assign( Header, Header + sizeof(Header) );
+
+  while ( Pos < New.size() )
+  {
+    /* Where the last copy left off, past the literal since */
+    Best_From = Source + Literal.size();
+    Best_Len  = ( Best_From < Old.size() ) ? Check_Match( Old, Best_From, New, Pos ) : 0;
+    if ( Best_Len < CHECK_MATCH_MIN_NEXT )
+    {
+      Best_Len = 0;
+    }
+
+    if ( (Pos + CHECK_MATCH_MIN) <= New.size() )
+    {
+      Block.assign( New.begin() + Pos, New.begin() + Pos + CHECK_MATCH_MIN );
+      if ( Index.count( Block ) > 0 )
+      {
+        for ( UINT32 From : Index[Block] )
+        {
+          Len = Check_Match( Old, From, New, Pos );
+          if ( Len > (Best_Len + 2) )
+          {
+            Best_From = From;
+            Best_Len  = Len;
+          }
+        }
+      }
+    }
+
+    if ( Best_Len == 0 )
+    {
+      Literal.push_back( New[Pos++] );
+      continue;
+    }
+
+    if ( !Literal.empty() )
+    {
+      Check_Varint( pDelta, (Literal.size() << 1) | 1 );
+      pDelta->insert( pDelta->end(), Literal.begin(), Literal.end() );
+      Literal.clear();
+    }
+
+    Offset = (INT32)Best_From - (INT32)Source;
+    Check_Varint( pDelta, Best_Len << 1 );
+    Check_Varint( pDelta, ( Offset >= 0 ) ? ((UINT32)Offset << 1) : (((UINT32)-Offset << 1) - 1) );
+    Source = Best_From + Best_Len;
+    Pos   += Best_Len;
+  }
+
+  if ( !Literal.empty() )
+  {
+    Check_Varint( pDelta, (Literal.size() << 1) | 1 );
+    pDelta->insert( pDelta->end(), Literal.begin(), Literal.end() );
+  }
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Load( const char *pPath, std::vector<UINT8> *pData )
+{
+  FILE    *pFile = fopen( pPath, "rb" );
+  UINT8   Buff[4096];
+  size_t  Len;
+
+  if ( pFile == NULL )
+  {
+    fprintf( stderr, "Can't open %s\n", pPath );
+    return FALSE;
+  }
+
+  while ( (Len = fread( Buff, 1, sizeof(Buff), pFile )) > 0 )
+  {
+    pData->insert( pData->end(), Buff, Buff + Len );
+  }
+  fclose( pFile );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* As the device, the delta must be for this old image */
+static BOOL
+Check_Header( void *pContext, const OTA_DELTA_HEADER_RECORD *pHeader )
+{
+  CHECK_CONTEXT_RECORD  *pCheck = (CHECK_CONTEXT_RECORD *)pContext;
+  UINT8                 Md5[16];
+
+  pCheck->new_size = pHeader->new_size;
+
+  Check_Md5( *pCheck->pOld, Md5 );
+  pCheck->refused = ( pHeader->old_size != pCheck->pOld->size() ) ||
+                    ( memcmp( Md5, pHeader->old_md5, sizeof(Md5) ) != 0 );
+
+  return !pCheck->refused;
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Read( void *pContext, UINT32 Offset, UINT8 *pBuff, UINT16 Len )
+{
+  CHECK_CONTEXT_RECORD  *pCheck = (CHECK_CONTEXT_RECORD *)pContext;
+
+  if ( ((UINT64)Offset + Len) > pCheck->pOld->size() )
+  {
+    pCheck->bad_reads++;
+    return FALSE;
+  }
+
+  memcpy( pBuff, &(*pCheck->pOld)[Offset], Len );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Write( void *pContext, const UINT8 *pBuff, UINT16 Len )
+{
+  CHECK_CONTEXT_RECORD  *pCheck = (CHECK_CONTEXT_RECORD *)pContext;
+
+  if ( (pCheck->out.size() + Len) > pCheck->new_size )
+  {
+    pCheck->bad_writes++;
+    return FALSE;
+  }
+
+  pCheck->out.insert( pCheck->out.end(), pBuff, pBuff + Len );
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* The delta in random pieces, TRUE if it applied to the end */
+static BOOL
+Check_Apply( const std::vector<UINT8> &Old, const std::vector<UINT8> &Delta, CHECK_CONTEXT_RECORD *pContext )
+{
+  static OTA_DELTA_RECORD Delta_State;
+  OTA_DELTA_IO_RECORD Io = { Check_Header, Check_Read, Check_Write, pContext };
+  size_t  Index = 0;
+  size_t  Len;
+
+  pContext->pOld      = &Old;
+  pContext->new_size  = 0;
+  pContext->refused   = FALSE;
+  pContext->bad_reads  = 0;
+  pContext->bad_writes = 0;
+  pContext->out.clear();
+
+  Ota_Delta_Init( &Delta_State, &Io );
+
+  while ( Index < Delta.size() )
+  {
+    Len = 1 + (rand() % CHECK_PIECE_MAX_SIZE);
+    Len = ( Len < (Delta.size() - Index) ) ? Len : (Delta.size() - Index);
+
+    if ( !Ota_Delta_Feed( &Delta_State, &Delta[Index], Len ) )
+    {
+      return FALSE;
+    }
+    Index += Len;
+  }
+
+  return Ota_Delta_Is_Done( &Delta_State );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  std::vector<UINT8>    Old;
+  std::vector<UINT8>    New;
+  std::vector<UINT8>    Delta;
+  std::vector<UINT8>    Broken;
+  std::vector<UINT8>    Wrong_Base;
+  CHECK_CONTEXT_RECORD  Context;
+  const char  *pPaths[3];
+  UINT32      Paths       = 0;
+  UINT32      Broken_Count = 200;
+  UINT32      Seed        = 1;
+  UINT32      Index;
+  UINT32      Failed      = 0;
+  UINT32      Wrong       = 0;
+  UINT32      Bad_Access  = 0;
+  UINT32      Harmless    = 0;
+  UINT32      At;
+  UINT32      Cuts        = 0;
+  UINT32      Completed   = 0;
+  UINT32      Cut_Access  = 0;
+  clock_t     Start;
+  double      Apply_ms;
+  INT32       Opt;
+  BOOL        Ok          = TRUE;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Broken_Count = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (argv[Opt][0] != '-') && (Paths < 3) )
+    {
+      pPaths[Paths++] = argv[Opt];
+    }
+    else
+    {
+      /* Not a usage */
+      Paths = 4;
+      break;
+    }
+  }
+
+  if ( (Paths != 0) && (Paths != 3) )
+  {
+    fprintf( stderr, "Usage: %s [old.bin new.bin delta] [-n broken deltas] [-s seed]\n", argv[0] );
+    return 1;
+  }
+
+  srand( Seed );
+
+  if ( Paths == 0 )
+  {
+    Check_Make_Images( &Old, &New );
+    Check_Make_Delta( Old, New, &Delta );
+    printf( "Made up images, seed %lu\n", Seed );
+  }
+  else if ( !Check_Load( pPaths[0], &Old ) || !Check_Load( pPaths[1], &New ) || !Check_Load( pPaths[2], &Delta ) )
+  {
+    return 1;
+  }
+
+  Context.new_size   = 0;
+  Context.bad_reads  = 0;
+  Context.bad_writes = 0;
+
+  /* As it is */
+  Start = clock();
+  if ( !Check_Apply( Old, Delta, &Context ) || (Context.out != New) )
+  {
+    printf( "FAILED, the delta doesn't give the new image\n" );
+    return 2;
+  }
+  Apply_ms = (clock() - Start) * 1000.0 / CLOCKS_PER_SEC;
+
+  printf( "old %zu, new %zu, delta %zu bytes, %.1f %% of the new image, applied in %.2f ms\n",
+          Old.size(), New.size(), Delta.size(), 100.0 * Delta.size() / New.size(), Apply_ms );
+
+  /* Cut short, in the header, right after it and all through the commands */
+  for ( At = 0; At < Delta.size(); At += ( At < OTA_DELTA_HEADER_SIZE ) ? 7 : (Delta.size() / 16) )
+  {
+    Broken.assign( Delta.begin(), Delta.begin() + At );
+    Cuts++;
+    Completed  += Check_Apply( Old, Broken, &Context ) ? 1 : 0;
+    Cut_Access += Context.bad_reads + Context.bad_writes;
+  }
+  Broken.assign( Delta.begin(), Delta.end() - 1 );
+  Cuts++;
+  Completed  += Check_Apply( Old, Broken, &Context ) ? 1 : 0;
+  Cut_Access += Context.bad_reads + Context.bad_writes;
+
+  printf( "%lu deltas cut short, %lu completed, %lu reads or writes out of bounds\n", Cuts, Completed, Cut_Access );
+  if ( (Completed > 0) || (Cut_Access > 0) )
+  {
+    printf( "FAILED, a delta cut short completed or went outside the images\n" );
+    Ok = FALSE;
+  }
+
+  /* For another base, a byte changed, then of another size */
+  Wrong_Base = Old;
+  Wrong_Base[Wrong_Base.size() / 2] ^= 0x01;
+  Completed = Check_Apply( Wrong_Base, Delta, &Context ) ? 1 : 0;
+  printf( "Old image with a byte changed: %s\n", Context.refused ? "refused" : "taken" );
+  if ( !Context.refused || Completed )
+  {
+    printf( "FAILED, a delta was taken for another base\n" );
+    Ok = FALSE;
+  }
+
+  Wrong_Base.assign( Old.begin(), Old.end() - 4096 );
+  Completed = Check_Apply( Wrong_Base, Delta, &Context ) ? 1 : 0;
+  printf( "Old image 4096 bytes shorter: %s\n", Context.refused ? "refused" : "taken" );
+  if ( !Context.refused || Completed )
+  {
+    printf( "FAILED, a delta was taken for a base of another size\n" );
+    Ok = FALSE;
+  }
+
+  /* Broken */
+  for ( Index = 0; Index < Broken_Count; Index++ )
+  {
+    Broken = Delta;
+    At     = rand() % Delta.size();
+    if ( Index % 2 )
+    {
+      Broken.resize( At );
+    }
+    else
+    {
+      Broken[At] ^= (UINT8)(1 + (rand() % 255));
+    }
+
+    if ( !Check_Apply( Old, Broken, &Context ) )
+    {
+      Failed++;
+    }
+    else if ( Context.out != New )
+    {
+      Wrong++;
+    }
+    else if ( ((At >= 5) && (At < 8)) || ((At >= 16) && (At < OTA_DELTA_HEADER_SIZE)) )
+    {
+      /* The reserved bytes, or an MD5 the device checks itself */
+      Harmless++;
+    }
+
+    Bad_Access += Context.bad_reads + Context.bad_writes;
+  }
+
+  printf( "%lu broken deltas: %lu refused, %lu gave a wrong image for the MD5 to refuse, %lu changed the header "
+          "MD5s or reserved bytes, %lu reads or writes out of bounds\n",
+          Broken_Count, Failed, Wrong, Harmless, Bad_Access );
+
+  if ( Bad_Access > 0 )
+  {
+    printf( "FAILED, a broken delta went outside the images\n" );
+    Ok = FALSE;
+  }
+  if ( (Failed + Wrong + Harmless) != Broken_Count )
+  {
+    printf( "FAILED, a broken delta gave the new image\n" );
+    Ok = FALSE;
+  }
+
+  return Ok ? 0 : 2;
+}
+
+/*===========================================================================*/
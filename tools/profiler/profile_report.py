@@ -0,0 +1,223 @@
+#!/usr/bin/env python3
+#==============================================================================
+# Copyright Mickey
+#==============================================================================
+"""
+@file   profile_report.py
+@brief  Symbolize a profile of main/profiler.cpp against the ELF of the build
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+The profile is a count per program counter. Each address is looked up in
+the symbols of the ELF, the ROM functions included, and the counts are
+added up per function. It prints where the time went by part of the
+firmware, then a flat profile of the functions, or with -f the folded
+stacks flamegraph.pl and speedscope read.
+
+There are no call stacks in the samples, a folded stack is the memory the
+function runs from, the part of the firmware and the function. The part
+comes from the source file of the address with -l: the Arduino library
+it is in, the core, the sketch, or "sdk" for the Wi-Fi and network blobs,
+which have no line info.
+
+The ELF must be of the firmware that was profiled, the header of the
+profile has its SW_REVISION. Get it from the Arduino build, e.g.
+  arduino-cli compile -b esp8266:esp8266:nodemcuv2 --export-binaries main
+  -> main/build/esp8266.esp8266.nodemcuv2/main.ino.elf
+
+Get the profile from /profile, or all pieces published on the state topic:
+  curl -u user:password "http://<device>/profile?start=200&s=120"
+  curl -u user:password "http://<device>/profile?stop" > profile.txt
+  mosquitto_sub -t 'site/<id>/state/profile' -C 8 > profile.txt
+
+Usage:
+  profile_report.py [-n top] [-l] [-f] [-p tool-prefix] firmware.elf profile.txt
+
+The toolchain comes with the ESP8266 core, add its bin directory to PATH
+or give the prefix with -p, as for tools/dram_report.
+"""
+
+import argparse
+import bisect
+import subprocess
+import sys
+
+# Where code runs from on the ESP8266
+REGIONS = [
+    (0x40000000, 0x40010000, "rom"),
+    (0x40100000, 0x4010C000, "iram"),
+    (0x40200000, 0x40300000, "flash"),
+]
+
+# Source paths to the part of the firmware, first match wins
+PARTS = [
+    ("/libraries/",     None),          # The library name follows
+    ("/cores/esp8266/", "core"),
+    ("/tools/sdk/",     "sdk"),
+    ("/main/",          "sketch"),
+]
+
+# Symbol types of code, and absolute ones for the ROM functions
+CODE_TYPES = "TtWwAa"
+
+
+def run(tool, args, stdin=None):
+    """Run a toolchain program and return its output lines"""
+    try:
+        out = subprocess.run([tool] + args, check=True, capture_output=True, text=True, input=stdin).stdout
+    except FileNotFoundError:
+        sys.exit("%s not found, see -p" % tool)
+    except subprocess.CalledProcessError as err:
+        sys.exit(err.stderr.strip())
+    return out.splitlines()
+
+
+def region_of(addr):
+    for start, end, name in REGIONS:
+        if start <= addr < end:
+            return name
+    return "other"
+
+
+def load_profile(paths):
+    """{pc: count} and the header fields, the pieces may come in any order"""
+    counts = {}
+    header = {}
+    for path in paths:
+        with open(path) as f:
+            for line in f:
+                line = line.strip()
+                if line.startswith("# profile"):
+                    for field in line.split()[2:]:
+                        key, _, value = field.partition("=")
+                        header[key] = value
+                    continue
+                if not line or line.startswith("#"):
+                    continue
+                fields = line.split()
+                if len(fields) != 2:
+                    continue
+                pc = int(fields[0], 16)
+                counts[pc] = counts.get(pc, 0) + int(fields[1])
+    return counts, header
+
+
+class Symbols:
+    """Code symbols by address, a symbol without a size runs up to the next one"""
+
+    def __init__(self, prefix, elf):
+        by_addr = {}
+        for line in run(prefix + "nm", ["-n", "-S", "-C", "--defined-only", elf]):
+            fields = line.split(None, 3)
+            if len(fields) == 4 and len(fields[2]) == 1:
+                addr, size, kind, name = int(fields[0], 16), int(fields[1], 16), fields[2], fields[3]
+            elif len(fields) >= 3 and len(fields[1]) == 1:
+                addr, size, kind, name = int(fields[0], 16), 0, fields[1], line.split(None, 2)[2]
+            else:
+                continue
+            if kind not in CODE_TYPES or (kind in "Aa" and region_of(addr) != "rom"):
+                continue
+            # Of aliases at one address, keep the one that has a size, then the global one
+            old = by_addr.get(addr)
+            if old is None or (size, kind.isupper()) > (old[0], old[1].isupper()):
+                by_addr[addr] = (size, kind, name)
+
+        self.starts = sorted(by_addr)
+        self.entries = [by_addr[addr] for addr in self.starts]
+
+    def lookup(self, pc):
+        index = bisect.bisect_right(self.starts, pc) - 1
+        if index < 0:
+            return None
+        size, _, name = self.entries[index]
+        start = self.starts[index]
+        if size > 0 and pc >= start + size:
+            return None
+        if size == 0 and region_of(start) != region_of(pc):
+            return None
+        return name
+
+
+def part_of(path):
+    """The part of the firmware a source file is in"""
+    if path.startswith("??"):
+        return "sdk"
+    path = path.replace("\\", "/")
+    for marker, part in PARTS:
+        at = path.find(marker)
+        if at < 0:
+            continue
+        if part is None:
+            return path[at + len(marker):].split("/")[0]
+        return part
+    return "other"
+
+
+def load_parts(prefix, elf, pcs):
+    """{pc: part}, from the line info through addr2line"""
+    pcs = sorted(pcs)
+    lines = run(prefix + "addr2line", ["-e", elf], "\n".join("0x%x" % pc for pc in pcs) + "\n")
+    return {pc: "rom" if region_of(pc) == "rom" else part_of(line) for pc, line in zip(pcs, lines)}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Symbolize a profile of the ESP8266 profiler")
+    parser.add_argument("elf")
+    parser.add_argument("profile", nargs="+", help="/profile output or the published pieces")
+    parser.add_argument("-n", "--top", type=int, default=30, help="functions to list")
+    parser.add_argument("-l", "--lines", action="store_true", help="the parts of the firmware from the line info")
+    parser.add_argument("-f", "--folded", action="store_true", help="folded stacks for a flame graph")
+    parser.add_argument("-p", "--prefix", default="xtensa-lx106-elf-", help="toolchain prefix")
+    args = parser.parse_args()
+
+    counts, header = load_profile(args.profile)
+    if not counts:
+        sys.exit("No samples in %s" % ", ".join(args.profile))
+
+    symbols = Symbols(args.prefix, args.elf)
+    parts = load_parts(args.prefix, args.elf, counts) if args.lines else {}
+
+    functions = {}
+    by_part = {}
+    for pc, count in counts.items():
+        name = symbols.lookup(pc) or "0x%08x" % pc
+        part = parts.get(pc, region_of(pc))
+        key = (region_of(pc), part, name)
+        functions[key] = functions.get(key, 0) + count
+        by_part[part] = by_part.get(part, 0) + count
+
+    total = sum(counts.values())
+
+    if args.folded:
+        for (region, part, name), count in sorted(functions.items(), key=lambda item: -item[1]):
+            stack = [region, part, name] if args.lines else [region, name]
+            print("%s %d" % (";".join(stack), count))
+        return 0
+
+    rate = int(header.get("rate_hz", "0"))
+    cycles = int(header.get("isr_cycles", "0"))
+    mhz = int(header.get("cpu_mhz", "80"))
+    print("Profile of %s, %d samples at %d Hz over %s ms, %s dropped" %
+          (header.get("sw", "?"), total, rate, header.get("ms", "?"), header.get("dropped", "?")))
+    if rate and cycles:
+        print("Sampling took %d cycles a sample, %.3f %% of the CPU" % (cycles, 100.0 * rate * cycles / (mhz * 1e6)))
+    if header.get("samples") and int(header["samples"]) != total + int(header.get("dropped", "0")):
+        print("Only %d of %s samples are here, some pieces are missing" % (total, header["samples"]))
+
+    print("\nBy %s:" % ("part" if args.lines else "memory"))
+    for part, count in sorted(by_part.items(), key=lambda item: -item[1]):
+        print("  %7d %6.2f %%  %s" % (count, 100.0 * count / total, part))
+
+    print("\n  samples      %   cum %  function")
+    cumulative = 0
+    for (region, part, name), count in sorted(functions.items(), key=lambda item: -item[1])[:args.top]:
+        cumulative += count
+        print("  %7d %6.2f %6.2f   %s  [%s]" % (count, 100.0 * count / total, 100.0 * cumulative / total, name, part))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,469 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   qos_window_check.cpp
+@brief  QoS 1 through a lossy broker stand-in, throughput and latency by window
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/mqtt_qos.cpp and main/mqtt_packet.cpp on the host, the packets
+go over a simulated link to a broker stand-in and back. Time is simulated
+in milliseconds, the client does what mqtt_client.cpp does once per loop():
+take the PUBACKs that came, hand in publishes while the window has room,
+send what Mqtt_Qos_Due() gives out.
+
+The link delays each packet -l ms each way and loses -p percent of them,
+PUBLISH and PUBACK alike, as a broker under load or a flaky Wifi would.
+The broker takes CHECK_BROKER_MS for each packet, one after the other.
+
+For each window size the client publishes as fast as the window lets it
+for -t seconds, then the rest drain. Printed are the publishes the broker
+got per second, once each, the time from handed in to PUBACK, the
+retransmissions and the copies the broker got.
+
+The broker stand-in sends a command every CHECK_COMMAND_MS at QoS 1 as
+well, and sends it again with DUP when our PUBACK is late, so the
+incoming side is checked too: each command must be applied exactly once.
+
+It fails if a publish is not acknowledged in the end, one was
+acknowledged that the broker never got, a command was not applied or was
+applied twice, or the window of 4 doesn't give twice the throughput of 1.
+
+Build, from this directory:
+  g++ -O2 -DMQTT_QOS_WINDOW=16 -I../../main -o qos_window_check qos_window_check.cpp
+      ../../main/mqtt_qos.cpp ../../main/mqtt_packet.cpp
+
+Usage:
+  qos_window_check [-p loss %] [-l latency ms] [-t seconds] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "mqtt_qos.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The broker, per packet */
+#define CHECK_BROKER_MS           1
+
+/* The broker's commands, and its wait for our PUBACK */
+#define CHECK_COMMAND_MS          1000
+#define CHECK_COMMAND_RETRY_MS    2000
+
+/* After -t, for the window to drain */
+#define CHECK_DRAIN_MS            120000
+
+#define CHECK_PACKET_MAX_SIZE     MQTT_QOS_PACKET_MAX_SIZE
+
+/* A packet on the link */
+typedef struct
+{
+  uint32_t  arrive_ms;
+  uint16_t  len;
+  UINT8     bytes[CHECK_PACKET_MAX_SIZE];
+
+} CHECK_PACKET_RECORD;
+
+/* One way of the link */
+typedef struct
+{
+  std::vector<CHECK_PACKET_RECORD>  packets;
+  uint32_t  latency_ms;
+  uint32_t  loss_percent;
+
+} CHECK_LINK_RECORD;
+
+/* A command the broker waits to have acknowledged */
+typedef struct
+{
+  uint16_t  packet_id;
+  uint32_t  sequence;
+  uint32_t  sent_ms;
+
+} CHECK_COMMAND_RECORD;
+
+typedef struct
+{
+  uint32_t  window;
+  uint32_t  handed_in;
+  uint32_t  acked;
+  uint32_t  received;           /* By the broker, once each */
+  uint32_t  copies;             /* By the broker, again */
+  uint32_t  retransmits;
+  uint32_t  acked_not_received;
+  uint32_t  commands;
+  uint32_t  commands_missed;
+  uint32_t  commands_twice;
+  uint32_t  command_copies;     /* Told by Mqtt_Qos_Is_New() */
+  double    rate;               /* Received per second in the -t seconds */
+  uint32_t  p50_ms;
+  uint32_t  p99_ms;
+  uint32_t  max_ms;
+
+} CHECK_RESULT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static uint32_t Check_Sequence( const MQTT_PACKET_RECORD *pDecoded );
+static void   Check_Send( CHECK_LINK_RECORD *pLink, const UINT8 *pPacket, uint16_t Len, uint32_t Now_ms );
+static BOOL   Check_Receive( CHECK_LINK_RECORD *pLink, uint32_t Now_ms, CHECK_PACKET_RECORD *pPacket,
+                             MQTT_PACKET_RECORD *pDecoded );
+static void   Check_Run( uint32_t Window, uint32_t Seconds, CHECK_RESULT_RECORD *pResult,
+                         uint32_t Latency_ms, uint32_t Loss_Percent );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* The sequence number in a payload, it is not NUL terminated */
+static uint32_t
+Check_Sequence( const MQTT_PACKET_RECORD *pDecoded )
+{
+  uint32_t  Sequence = 0;
+  uint16_t  Index;
+
+  for ( Index = 0; Index < pDecoded->payload_len; Index++ )
+  {
+    Sequence = (Sequence * 10) + (pDecoded->pPayload[Index] - '0');
+  }
+
+  return Sequence;
+}
+
+/*===========================================================================*/
+
+/* Onto the link, unless it is lost */
+static void
+Check_Send( CHECK_LINK_RECORD *pLink, const UINT8 *pPacket, uint16_t Len, uint32_t Now_ms )
+{
+  CHECK_PACKET_RECORD Packet;
+
+  if ( (uint32_t)(rand() % 100) < pLink->loss_percent )
+  {
+    return;
+  }
+
+  Packet.arrive_ms = Now_ms + pLink->latency_ms;
+  Packet.len       = Len;
+  memcpy( Packet.bytes, pPacket, Len );
+  pLink->packets.push_back( Packet );
+}
+
+/*===========================================================================*/
+
+/* The first packet arrived by now, decoded as mqtt_client.cpp does */
+static BOOL
+Check_Receive( CHECK_LINK_RECORD *pLink, uint32_t Now_ms, CHECK_PACKET_RECORD *pPacket,
+               MQTT_PACKET_RECORD *pDecoded )
+{
+  UINT32  Packet_Len;
+
+  if ( pLink->packets.empty() || (pLink->packets.front().arrive_ms > Now_ms) )
+  {
+    return FALSE;
+  }
+
+  *pPacket = pLink->packets.front();
+  pLink->packets.erase( pLink->packets.begin() );
+
+  if ( (Mqtt_Decode_Length( pPacket->bytes, pPacket->len, &Packet_Len ) != 1) || (Packet_Len != pPacket->len) ||
+       !Mqtt_Decode( pPacket->bytes, Packet_Len, pDecoded ) )
+  {
+    fprintf( stderr, "Malformed packet on the link\n" );
+    exit( 3 );
+  }
+
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Run( uint32_t Window, uint32_t Seconds, CHECK_RESULT_RECORD *pResult,
+           uint32_t Latency_ms, uint32_t Loss_Percent )
+{
+  MQTT_QOS_RECORD                   Qos;
+  CHECK_LINK_RECORD                 Up;
+  CHECK_LINK_RECORD                 Down;
+  CHECK_PACKET_RECORD               Packet;
+  MQTT_PACKET_RECORD                Decoded;
+  std::vector<uint8_t>              Received;         /* By sequence */
+  std::vector<uint8_t>              Applied;
+  std::vector<uint32_t>             Latencies;
+  std::vector<CHECK_COMMAND_RECORD> Commands;         /* Waiting for PUBACK */
+  CHECK_COMMAND_RECORD              Command;
+  const UINT8   *pOut;
+  UINT8         Buff[CHECK_PACKET_MAX_SIZE];
+  CHAR          Payload[12];
+  uint32_t      Now_ms;
+  uint32_t      End_ms        = Seconds * 1000;
+  uint32_t      Broker_Free_ms = 0;
+  uint32_t      Received_In_Time = 0;
+  uint32_t      Sequence;
+  UINT32        Latency;
+  uint16_t      Broker_Id     = 0;
+  uint16_t      Len;
+  size_t        Index;
+
+  memset( pResult, 0, sizeof(CHECK_RESULT_RECORD) );
+  pResult->window = Window;
+
+  Mqtt_Qos_Init( &Qos, Window );
+  Up.latency_ms   = Down.latency_ms   = Latency_ms;
+  Up.loss_percent = Down.loss_percent = Loss_Percent;
+
+  for ( Now_ms = 0; Now_ms < End_ms + CHECK_DRAIN_MS; Now_ms++ )
+  {
+    /* The broker, a packet at a time */
+    while ( (Broker_Free_ms <= Now_ms) && Check_Receive( &Up, Now_ms, &Packet, &Decoded ) )
+    {
+      Broker_Free_ms = Now_ms + CHECK_BROKER_MS;
+
+      if ( Decoded.type == MQTT_PUBLISH )
+      {
+        Sequence = Check_Sequence( &Decoded );
+        if ( Received[Sequence] )
+        {
+          pResult->copies++;
+        }
+        else
+        {
+          Received[Sequence] = 1;
+          pResult->received++;
+          Received_In_Time += (Now_ms < End_ms) ? 1 : 0;
+        }
+        Check_Send( &Down, Buff, Mqtt_Encode_Ack( Buff, sizeof(Buff), MQTT_PUBACK, Decoded.packet_id ), Now_ms );
+      }
+      else if ( Decoded.type == MQTT_PUBACK )
+      {
+        for ( Index = 0; Index < Commands.size(); Index++ )
+        {
+          if ( Commands[Index].packet_id == Decoded.packet_id )
+          {
+            Commands.erase( Commands.begin() + Index );
+            break;
+          }
+        }
+      }
+    }
+
+    /* The broker's commands, new and late */
+    if ( (Now_ms < End_ms) && ((Now_ms % CHECK_COMMAND_MS) == 0) )
+    {
+      if ( ++Broker_Id == 0 )
+      {
+        Broker_Id = 1;
+      }
+      Command.packet_id = Broker_Id;
+      Command.sequence  = pResult->commands++;
+      Command.sent_ms   = Now_ms;
+      Commands.push_back( Command );
+      Applied.push_back( 0 );
+      snprintf( Payload, sizeof(Payload), "%u", Command.sequence );
+      Check_Send( &Down, Buff, Mqtt_Encode_Publish( Buff, sizeof(Buff), "site/0/cmd/relay_status",
+                                                    (const UINT8 *)Payload, strlen( Payload ), 1, FALSE, FALSE,
+                                                    Command.packet_id ), Now_ms );
+    }
+    for ( Index = 0; Index < Commands.size(); Index++ )
+    {
+      if ( (Now_ms - Commands[Index].sent_ms) >= CHECK_COMMAND_RETRY_MS )
+      {
+        Commands[Index].sent_ms = Now_ms;
+        snprintf( Payload, sizeof(Payload), "%u", Commands[Index].sequence );
+        Check_Send( &Down, Buff, Mqtt_Encode_Publish( Buff, sizeof(Buff), "site/0/cmd/relay_status",
+                                                      (const UINT8 *)Payload, strlen( Payload ), 1, FALSE, TRUE,
+                                                      Commands[Index].packet_id ), Now_ms );
+      }
+    }
+
+    /* The client, one loop() */
+    while ( Check_Receive( &Down, Now_ms, &Packet, &Decoded ) )
+    {
+      if ( Decoded.type == MQTT_PUBACK )
+      {
+        if ( Mqtt_Qos_Acked( &Qos, Decoded.packet_id, Now_ms, &Latency ) )
+        {
+          pResult->acked++;
+          Latencies.push_back( Latency );
+        }
+      }
+      else if ( Decoded.type == MQTT_PUBLISH )
+      {
+        Check_Send( &Up, Buff, Mqtt_Encode_Ack( Buff, sizeof(Buff), MQTT_PUBACK, Decoded.packet_id ), Now_ms );
+        if ( Mqtt_Qos_Is_New( &Qos, &Decoded ) )
+        {
+          Sequence = Check_Sequence( &Decoded );
+          Applied[Sequence]++;
+        }
+        else
+        {
+          pResult->command_copies++;
+        }
+      }
+    }
+
+    while ( Now_ms < End_ms )
+    {
+      snprintf( Payload, sizeof(Payload), "%u", pResult->handed_in );
+      if ( Mqtt_Qos_Publish( &Qos, "site/0/state/relay_ack", (const UINT8 *)Payload, strlen( Payload ),
+                             FALSE, Now_ms ) == 0 )
+      {
+        break;
+      }
+      pResult->handed_in++;
+      Received.push_back( 0 );
+    }
+
+    while ( (pOut = Mqtt_Qos_Due( &Qos, Now_ms, &Len )) != NULL )
+    {
+      pResult->retransmits += (pOut[0] & MQTT_PUBLISH_DUP) ? 1 : 0;
+      Check_Send( &Up, pOut, Len, Now_ms );
+    }
+
+    if ( (Now_ms >= End_ms) && (Mqtt_Qos_In_Flight( &Qos ) == 0) && Commands.empty() )
+    {
+      break;
+    }
+  }
+
+  /* Acknowledged is received, as the broker only acknowledges what it got */
+  pResult->acked_not_received = pResult->acked - std::min( pResult->acked, pResult->received );
+
+  for ( Index = 0; Index < Applied.size(); Index++ )
+  {
+    pResult->commands_missed += (Applied[Index] == 0) ? 1 : 0;
+    pResult->commands_twice  += (Applied[Index] > 1) ? 1 : 0;
+  }
+
+  std::sort( Latencies.begin(), Latencies.end() );
+  if ( !Latencies.empty() )
+  {
+    pResult->p50_ms = Latencies[Latencies.size() / 2];
+    pResult->p99_ms = Latencies[Latencies.size() * 99 / 100];
+    pResult->max_ms = Latencies.back();
+  }
+  pResult->rate = Received_In_Time / (double)Seconds;
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  static const uint32_t Windows[] = { 1, 2, 4, 8, 16 };
+  CHECK_RESULT_RECORD Results[sizeof(Windows) / sizeof(Windows[0])];
+  uint32_t  Loss_Percent  = 5;
+  uint32_t  Latency_ms    = 40;
+  uint32_t  Seconds       = 60;
+  uint32_t  Seed          = 1;
+  uint32_t  Index;
+  INT32     Opt;
+  BOOL      Ok            = TRUE;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-p" ) == 0) && (Opt + 1 < argc) )
+    {
+      Loss_Percent = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-l" ) == 0) && (Opt + 1 < argc) )
+    {
+      Latency_ms = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-t" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seconds = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-p loss %%] [-l latency ms] [-t seconds] [-s seed]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  if ( (Loss_Percent >= 100) || (Seconds == 0) )
+  {
+    fprintf( stderr, "Loss must be below 100 %%, time above 0\n" );
+    return 1;
+  }
+
+  printf( "%u%% lost each way, %u ms each way, %u s, retry after %u ms doubling to %u ms\n\n",
+          Loss_Percent, Latency_ms, Seconds, MQTT_QOS_RETRY_MS, MQTT_QOS_RETRY_MAX_MS );
+  printf( "%6s %10s %8s %8s %8s %8s %8s %10s\n",
+          "window", "publish/s", "p50 ms", "p99 ms", "max ms", "retx", "copies", "cmd copies" );
+
+  for ( Index = 0; Index < sizeof(Windows) / sizeof(Windows[0]); Index++ )
+  {
+    CHECK_RESULT_RECORD *pResult = &Results[Index];
+
+    if ( Windows[Index] > MQTT_QOS_WINDOW )
+    {
+      break;
+    }
+
+    srand( Seed );
+    Check_Run( Windows[Index], Seconds, pResult, Latency_ms, Loss_Percent );
+
+    printf( "%6u %10.1f %8u %8u %8u %8u %8u %10u\n", pResult->window, pResult->rate,
+            pResult->p50_ms, pResult->p99_ms, pResult->max_ms, pResult->retransmits, pResult->copies,
+            pResult->command_copies );
+
+    if ( pResult->acked != pResult->handed_in )
+    {
+      printf( "  FAILED, %u of %u publishes not acknowledged\n", pResult->handed_in - pResult->acked,
+              pResult->handed_in );
+      Ok = FALSE;
+    }
+    if ( pResult->acked_not_received > 0 )
+    {
+      printf( "  FAILED, %u publishes acknowledged but not received\n", pResult->acked_not_received );
+      Ok = FALSE;
+    }
+    if ( (pResult->commands_missed > 0) || (pResult->commands_twice > 0) )
+    {
+      printf( "  FAILED, of %u commands %u not applied, %u applied twice\n",
+              pResult->commands, pResult->commands_missed, pResult->commands_twice );
+      Ok = FALSE;
+    }
+  }
+
+  if ( (MQTT_QOS_WINDOW >= 4) && (Results[2].rate < (Results[0].rate * 2)) )
+  {
+    printf( "FAILED, a window of 4 gives %.1f publish/s, not twice the %.1f of 1\n",
+            Results[2].rate, Results[0].rate );
+    Ok = FALSE;
+  }
+
+  return Ok ? 0 : 2;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,454 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   reconnect_storm.cpp
+@brief  A fleet of MQTT clients reconnecting to a restarted broker
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/mqtt_backoff.h on the host against a model of the broker. Time is
+simulated in milliseconds. All -n clients are connected when the broker
+restarts at 0, they all see the connection drop at once and it is back
+after -d seconds.
+
+The broker stand-in does one thing at a time: a TLS handshake and CONNACK
+takes STORM_HANDSHAKE_US, any other packet STORM_PACKET_US. It holds
+STORM_BACKLOG connects waiting, more are refused, and a connect still
+waiting after MQTT_CONNECT_TIMEOUT_MS is given up by the client. The
+broker does the handshake of a given up connect all the same, for nothing.
+
+Both ways are run, with the same seed:
+
+  fixed     Reconnect every 15 s, then subscribe all topics and publish
+            the state at once, as EspMQTTClient did
+  jitter    Reconnect after the mqtt_backoff.h delays, subscribe from a
+            random point in the first 2 s, one topic per 100 ms, then
+            publish the state, as mqtt_client.cpp does
+
+For each way the connect attempts and the connected clients are printed
+per -w seconds. Then the busiest second, by the attempts that reached the
+broker, how far behind the broker got, that is the delay every client's
+packets saw, and when the last client got through. The attempts while the
+broker is down are refused by its host and cost it nothing.
+
+The jitter takes longer until the last client is through, the fixed 15 s
+happen to give the broker time to catch up between waves. It fails if
+with jitter not all clients get through, the busiest second has more than
+a quarter of the fleet trying, or the broker got as far behind as with the
+fixed interval.
+
+Build, from this directory:
+  g++ -O2 -I../../main -o reconnect_storm reconnect_storm.cpp
+
+Usage:
+  reconnect_storm [-n clients] [-d broker down s] [-t seconds] [-w window s] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "mqtt_backoff.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* The broker, a TLS handshake with the server side of ECDHE and the
+   certificate signature, and any other packet */
+#define STORM_HANDSHAKE_US        2000
+#define STORM_PACKET_US           200
+#define STORM_BACKLOG             1024
+
+/* The client, as in mqtt_transport.h and mqtt_client.cpp */
+#define MQTT_CONNECT_TIMEOUT_MS   5000
+#define MQTT_BACKOFF_BASE_MS      2000
+#define MQTT_BACKOFF_CAP_MS       120000
+#define MQTT_BACKOFF_STABLE_MS    60000
+#define MQTT_SUBSCRIBE_SPREAD_MS  2000
+#define MQTT_SUBSCRIBE_GAP_MS     100
+
+/* EspMQTTClient */
+#define FIXED_INTERVAL_MS         15000
+
+/* Topics, and the state published after them */
+#define STORM_TOPICS              9
+#define STORM_ANNOUNCE            3
+
+/* A client acts once per loop(), so within this of when it is due */
+#define STORM_LOOP_MS             20
+
+typedef enum
+{
+  STORM_WAIT = 0,                 /* Until next_ms */
+  STORM_QUEUED,                   /* With the broker, until next_ms */
+  STORM_CONNECTED,
+
+} STORM_STATE;
+
+typedef struct
+{
+  STORM_STATE         state;
+  uint32_t            next_ms;
+  uint32_t            connected_ms;
+  uint32_t            attempt;    /* Tells a given up connect in the queue */
+  uint8_t             packets;    /* Still to send after CONNACK */
+  uint32_t            packet_ms;  /* When the next of them is due */
+  MQTT_BACKOFF_RECORD backoff;
+
+} STORM_CLIENT_RECORD;
+
+typedef struct
+{
+  uint32_t  client;
+  uint32_t  attempt;              /* 0 for a packet after CONNACK */
+
+} STORM_JOB_RECORD;
+
+typedef struct
+{
+  uint32_t  attempts;
+  uint32_t  refused;              /* Broker down or backlog full */
+  uint32_t  timed_out;
+  uint32_t  wasted;               /* Handshakes for a client that gave up */
+  uint32_t  all_ms;               /* When the last client got through, 0 if not */
+  uint32_t  peak_attempts;        /* In one second, at the broker up */
+  uint32_t  peak_busy_us;         /* Broker busy in one second */
+  uint32_t  peak_behind_ms;       /* Work queued at the broker */
+  std::vector<uint32_t> window_attempts;
+  std::vector<uint32_t> window_connected;
+
+} STORM_RESULT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static uint32_t Storm_Random( uint32_t Range );
+static uint32_t Storm_Delay( BOOL Jitter, STORM_CLIENT_RECORD *pClient );
+static void     Storm_Run( BOOL Jitter, uint32_t Clients, uint32_t Down_ms, uint32_t Seconds,
+                           uint32_t Window_s, STORM_RESULT_RECORD *pResult );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* 0 to Range - 1, rand() alone is only 15 bits on some hosts */
+static uint32_t
+Storm_Random( uint32_t Range )
+{
+  uint32_t  Random = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+
+  return (Range > 0) ? (Random % Range) : Random;
+}
+
+/*===========================================================================*/
+
+/* From a failure to the next attempt */
+static uint32_t
+Storm_Delay( BOOL Jitter, STORM_CLIENT_RECORD *pClient )
+{
+  uint32_t  Delay_ms = Jitter ? Mqtt_Backoff_Next( &pClient->backoff, Storm_Random( 0 ) ) : FIXED_INTERVAL_MS;
+
+  return Delay_ms + Storm_Random( STORM_LOOP_MS );
+}
+
+/*===========================================================================*/
+
+static void
+Storm_Run( BOOL Jitter, uint32_t Clients, uint32_t Down_ms, uint32_t Seconds, uint32_t Window_s,
+           STORM_RESULT_RECORD *pResult )
+{
+  std::vector<STORM_CLIENT_RECORD>  Fleet( Clients );
+  std::deque<STORM_JOB_RECORD>      Queue;
+  std::vector<uint32_t>             Second_Attempts( Seconds, 0 );
+  std::vector<uint32_t>             Second_Busy( Seconds, 0 );
+  STORM_JOB_RECORD  Job;
+  uint32_t  Now_ms;
+  uint64_t  Busy_Until_us = (uint64_t)Down_ms * 1000;
+  uint64_t  Queued_us     = 0;        /* Work in Queue */
+  uint32_t  Queued        = 0;        /* Connects in Queue */
+  uint32_t  Connected     = 0;
+  uint32_t  Index;
+  BOOL      Up;
+
+  pResult->window_attempts.assign( (Seconds + Window_s - 1) / Window_s, 0 );
+  pResult->window_connected.assign( pResult->window_attempts.size(), 0 );
+
+  /* The broker just went, everyone was connected and stable */
+  for ( Index = 0; Index < Clients; Index++ )
+  {
+    STORM_CLIENT_RECORD *pClient = &Fleet[Index];
+
+    memset( pClient, 0, sizeof(STORM_CLIENT_RECORD) );
+    Mqtt_Backoff_Init( &pClient->backoff, MQTT_BACKOFF_BASE_MS, MQTT_BACKOFF_CAP_MS );
+    pClient->state   = STORM_WAIT;
+    pClient->next_ms = Storm_Delay( Jitter, pClient );
+  }
+
+  for ( Now_ms = 0; Now_ms < Seconds * 1000; Now_ms++ )
+  {
+    Up = (Now_ms >= Down_ms);
+
+    /* The broker, one job after the other */
+    while ( Up && (Busy_Until_us <= (uint64_t)Now_ms * 1000) && !Queue.empty() )
+    {
+      Job = Queue.front();
+      Queue.pop_front();
+
+      if ( Job.attempt == 0 )
+      {
+        Queued_us    -= STORM_PACKET_US;
+        Busy_Until_us = std::max( Busy_Until_us, (uint64_t)Now_ms * 1000 ) + STORM_PACKET_US;
+        Second_Busy[Now_ms / 1000] += STORM_PACKET_US;
+        continue;
+      }
+
+      Queued--;
+      Queued_us    -= STORM_HANDSHAKE_US;
+      Busy_Until_us = std::max( Busy_Until_us, (uint64_t)Now_ms * 1000 ) + STORM_HANDSHAKE_US;
+      Second_Busy[Now_ms / 1000] += STORM_HANDSHAKE_US;
+
+      STORM_CLIENT_RECORD *pClient = &Fleet[Job.client];
+      if ( (pClient->state != STORM_QUEUED) || (pClient->attempt != Job.attempt) )
+      {
+        pResult->wasted++;
+        continue;
+      }
+
+      pClient->state        = STORM_CONNECTED;
+      pClient->connected_ms = (uint32_t)(Busy_Until_us / 1000);
+      pClient->packets      = STORM_TOPICS + STORM_ANNOUNCE;
+      pClient->packet_ms    = pClient->connected_ms + (Jitter ? Storm_Random( MQTT_SUBSCRIBE_SPREAD_MS ) : 0);
+      Connected++;
+      pResult->window_connected[std::min( (size_t)(pClient->connected_ms / 1000 / Window_s),
+                                          pResult->window_connected.size() - 1 )]++;
+      if ( Connected == Clients )
+      {
+        pResult->all_ms = pClient->connected_ms;
+      }
+    }
+
+    if ( Up )
+    {
+      pResult->peak_behind_ms = std::max( pResult->peak_behind_ms,
+                                          (uint32_t)((std::max( Busy_Until_us, (uint64_t)Now_ms * 1000 ) -
+                                                      (uint64_t)Now_ms * 1000 + Queued_us) / 1000) );
+    }
+
+    /* The clients */
+    for ( Index = 0; Index < Clients; Index++ )
+    {
+      STORM_CLIENT_RECORD *pClient = &Fleet[Index];
+
+      switch ( pClient->state )
+      {
+        case STORM_WAIT:
+
+          if ( Now_ms < pClient->next_ms )
+          {
+            break;
+          }
+
+          pResult->attempts++;
+          pResult->window_attempts[Now_ms / 1000 / Window_s]++;
+          if ( Up )
+          {
+            Second_Attempts[Now_ms / 1000]++;
+          }
+
+          if ( !Up || (Queued >= STORM_BACKLOG) )
+          {
+            pResult->refused++;
+            pClient->next_ms = Now_ms + Storm_Delay( Jitter, pClient );
+            break;
+          }
+
+          Job.client  = Index;
+          Job.attempt = ++pClient->attempt;
+          Queue.push_back( Job );
+          Queued++;
+          Queued_us += STORM_HANDSHAKE_US;
+          pClient->state   = STORM_QUEUED;
+          pClient->next_ms = Now_ms + MQTT_CONNECT_TIMEOUT_MS;
+          break;
+
+        case STORM_QUEUED:
+
+          if ( Now_ms >= pClient->next_ms )
+          {
+            pResult->timed_out++;
+            pClient->state   = STORM_WAIT;
+            pClient->next_ms = Now_ms + Storm_Delay( Jitter, pClient );
+          }
+          break;
+
+        case STORM_CONNECTED:
+
+          /* Without jitter all of them at once */
+          while ( (pClient->packets > 0) && (Now_ms >= pClient->packet_ms) )
+          {
+            Job.client  = Index;
+            Job.attempt = 0;
+            Queue.push_back( Job );
+            Queued_us += STORM_PACKET_US;
+            pClient->packets--;
+            if ( Jitter && (pClient->packets > 0) )
+            {
+              pClient->packet_ms = Now_ms + ((pClient->packets > STORM_ANNOUNCE) ? MQTT_SUBSCRIBE_GAP_MS : 0);
+            }
+          }
+
+          if ( (Now_ms - pClient->connected_ms) >= MQTT_BACKOFF_STABLE_MS )
+          {
+            Mqtt_Backoff_Reset( &pClient->backoff );
+          }
+          break;
+      }
+    }
+  }
+
+  pResult->peak_attempts = *std::max_element( Second_Attempts.begin(), Second_Attempts.end() );
+  pResult->peak_busy_us  = *std::max_element( Second_Busy.begin(), Second_Busy.end() );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  STORM_RESULT_RECORD Results[2];
+  uint32_t  Clients   = 1000;
+  uint32_t  Down_s    = 10;
+  uint32_t  Seconds   = 300;
+  uint32_t  Window_s  = 5;
+  uint32_t  Seed      = 1;
+  uint32_t  Index;
+  uint32_t  Rows;
+  INT32     Opt;
+  BOOL      Ok        = TRUE;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Clients = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-d" ) == 0) && (Opt + 1 < argc) )
+    {
+      Down_s = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-t" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seconds = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-w" ) == 0) && (Opt + 1 < argc) )
+    {
+      Window_s = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-n clients] [-d broker down s] [-t seconds] [-w window s] [-s seed]\n",
+               argv[0] );
+      return 1;
+    }
+  }
+
+  if ( (Clients == 0) || (Seconds == 0) || (Window_s == 0) || (Down_s >= Seconds) )
+  {
+    fprintf( stderr, "Clients, time and window must be above 0, the broker down for less than the time\n" );
+    return 1;
+  }
+
+  printf( "%u clients, broker down for %u s, %.1f ms a handshake, backlog %u\n\n",
+          Clients, Down_s, STORM_HANDSHAKE_US / 1000.0, STORM_BACKLOG );
+
+  for ( Index = 0; Index < 2; Index++ )
+  {
+    srand( Seed );
+    Storm_Run( Index == 1, Clients, Down_s * 1000, Seconds, Window_s, &Results[Index] );
+  }
+
+  /* Only as far as something happens */
+  for ( Rows = Results[0].window_attempts.size(); Rows > 1; Rows-- )
+  {
+    if ( (Results[0].window_attempts[Rows - 1] + Results[1].window_attempts[Rows - 1] +
+          Results[0].window_connected[Rows - 1] + Results[1].window_connected[Rows - 1]) > 0 )
+    {
+      break;
+    }
+  }
+
+  printf( "%8s  %18s  %18s\n", "", "fixed", "jitter" );
+  printf( "%8s  %8s %9s  %8s %9s\n", "from s", "attempts", "connected", "attempts", "connected" );
+  for ( Index = 0; Index < Rows; Index++ )
+  {
+    printf( "%8u  %8u %9u  %8u %9u\n", Index * Window_s,
+            Results[0].window_attempts[Index], Results[0].window_connected[Index],
+            Results[1].window_attempts[Index], Results[1].window_connected[Index] );
+  }
+  printf( "\n" );
+
+  for ( Index = 0; Index < 2; Index++ )
+  {
+    STORM_RESULT_RECORD *pResult = &Results[Index];
+
+    printf( "%-7s %u attempts, %u refused, %u timed out, %u handshakes wasted\n"
+            "        busiest second %u attempts, broker busy %u ms, behind by up to %u ms, ",
+            (Index == 0) ? "fixed" : "jitter",
+            pResult->attempts, pResult->refused, pResult->timed_out, pResult->wasted,
+            pResult->peak_attempts, pResult->peak_busy_us / 1000, pResult->peak_behind_ms );
+    if ( pResult->all_ms > 0 )
+    {
+      printf( "all through at %.1f s\n", pResult->all_ms / 1000.0 );
+    }
+    else
+    {
+      printf( "not all through\n" );
+    }
+  }
+
+  if ( Results[1].all_ms == 0 )
+  {
+    printf( "FAILED, with jitter not all clients got through in %u s\n", Seconds );
+    Ok = FALSE;
+  }
+  if ( (Results[1].peak_attempts * 4) > Clients )
+  {
+    printf( "FAILED, with jitter %u clients tried in one second\n", Results[1].peak_attempts );
+    Ok = FALSE;
+  }
+  if ( Results[1].peak_behind_ms >= Results[0].peak_behind_ms )
+  {
+    printf( "FAILED, with jitter the broker got as far behind\n" );
+    Ok = FALSE;
+  }
+
+  return Ok ? 0 : 2;
+}
+
+/*===========================================================================*/
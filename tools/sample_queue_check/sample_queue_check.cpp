@@ -0,0 +1,323 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sample_queue_check.cpp
+@brief  Check the sonar sample queue under simulated and real preemption
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/sample_queue.h on the host the way the firmware does, an
+interrupt pushing and loop() popping, in two ways:
+
+  Simulated   One thread. The timer interrupt fires on a fixed schedule
+              and also at random inside Sample_Queue_Pop(), at the points
+              between the slot access and the index update. loop() stalls
+              at random for up to 3 ring sizes, as a blocking HTTP handler
+              or Wi-Fi scan would. Repeatable with -s.
+
+  Threaded    The producer is a real second thread, so the memory ordering
+              of the queue is tested as well.
+
+Either way, every sample the producer got in must come out once, in order
+and intact, and every one it didn't must be counted as a drop.
+
+Build, from this directory:
+  g++ -O2 -pthread -I../../main -o sample_queue_check sample_queue_check.cpp
+
+Usage:
+  sample_queue_check [-n samples] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+/* The simulated interrupts preempt loop() inside the queue calls */
+static void Check_Preempt( void );
+#define SAMPLE_QUEUE_RELEASE()  Check_Preempt()
+#define SAMPLE_QUEUE_ACQUIRE()  Check_Preempt()
+
+#include "sample_queue.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Percent chance the interrupt fires at a preemption point in loop() */
+#define CHECK_PREEMPT_PERCENT   30
+
+/* Longest loop() stall, in timer ticks */
+#define CHECK_STALL_MAX         (3 * SAMPLE_QUEUE_SIZE)
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static SAMPLE_QUEUE_RECORD    Check_Queue;
+
+/* Producer side, what got in */
+static std::vector<uint32_t>  Check_Accepted;
+static uint32_t               Check_Seq        = 0;
+static uint32_t               Check_Rejected   = 0;
+
+/* Consumer side, what came out */
+static std::vector<uint32_t>  Check_Popped;
+static uint32_t               Check_Corrupt    = 0;
+
+static BOOL                   Check_Simulated  = FALSE;
+static BOOL                   Check_In_Interrupt = FALSE;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check_Interrupt( void );
+static void   Check_Pop_All( void );
+static BOOL   Check_Verify( const CHAR *pName );
+static void   Check_Reset( void );
+static BOOL   Check_Run_Simulated( UINT32 Samples );
+static BOOL   Check_Run_Threaded( UINT32 Samples );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* The timer interrupt, a sample whose fields all follow from its seq */
+static void
+Check_Interrupt( void )
+{
+  SAMPLE_RECORD Sample;
+
+  Check_In_Interrupt = TRUE;
+
+  Check_Seq++;
+  Sample.seq        = Check_Seq;
+  Sample.trigger_us = Check_Seq * 100000;
+  Sample.echo_us    = Check_Seq * 7 + 1;
+
+  if ( Sample_Queue_Push( &Check_Queue, &Sample ) )
+  {
+    Check_Accepted.push_back( Check_Seq );
+  }
+  else
+  {
+    Check_Rejected++;
+  }
+
+  Check_In_Interrupt = FALSE;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Preempt( void )
+{
+  __atomic_thread_fence( __ATOMIC_SEQ_CST );
+
+  /* An interrupt doesn't preempt itself */
+  if ( Check_Simulated && !Check_In_Interrupt && ((rand() % 100) < CHECK_PREEMPT_PERCENT) )
+  {
+    Check_Interrupt();
+  }
+}
+
+/*===========================================================================*/
+
+/* What loop() does, take everything there is */
+static void
+Check_Pop_All( void )
+{
+  SAMPLE_RECORD Sample;
+
+  while ( Sample_Queue_Pop( &Check_Queue, &Sample ) )
+  {
+    if ( (Sample.trigger_us != Sample.seq * 100000) || (Sample.echo_us != Sample.seq * 7 + 1) )
+    {
+      Check_Corrupt++;
+    }
+    Check_Popped.push_back( Sample.seq );
+  }
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Verify( const CHAR *pName )
+{
+  BOOL    Ok = TRUE;
+  size_t  Index;
+
+  if ( Check_Popped != Check_Accepted )
+  {
+    for ( Index = 0; (Index < Check_Popped.size()) && (Index < Check_Accepted.size()); Index++ )
+    {
+      if ( Check_Popped[Index] != Check_Accepted[Index] )
+      {
+        break;
+      }
+    }
+    printf( "  %s: out of order or lost at sample %zu, %zu in, %zu out\n",
+            pName, Index, Check_Accepted.size(), Check_Popped.size() );
+    Ok = FALSE;
+  }
+
+  if ( Check_Queue.drops != Check_Rejected )
+  {
+    printf( "  %s: %lu drops counted, %lu rejected\n", pName, (UINT32)Check_Queue.drops, (UINT32)Check_Rejected );
+    Ok = FALSE;
+  }
+
+  if ( Check_Corrupt != 0 )
+  {
+    printf( "  %s: %lu samples corrupt\n", pName, (UINT32)Check_Corrupt );
+    Ok = FALSE;
+  }
+
+  printf( "%-10s %lu samples, %zu through, %lu dropped, %s\n", pName, (UINT32)Check_Seq,
+          Check_Popped.size(), (UINT32)Check_Queue.drops, Ok ? "ok" : "FAILED" );
+
+  return Ok;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Reset( void )
+{
+  Sample_Queue_Init( &Check_Queue );
+  Check_Accepted.clear();
+  Check_Popped.clear();
+  Check_Seq      = 0;
+  Check_Rejected = 0;
+  Check_Corrupt  = 0;
+}
+
+/*===========================================================================*/
+
+/* The interrupt fires every tick, and inside the queue calls of loop() */
+static BOOL
+Check_Run_Simulated( UINT32 Samples )
+{
+  UINT32  Stall = 0;
+
+  Check_Reset();
+  Check_Simulated = TRUE;
+
+  while ( Check_Seq < Samples )
+  {
+    Check_Interrupt();
+
+    if ( Stall > 0 )
+    {
+      Stall--;
+      continue;
+    }
+
+    Check_Pop_All();
+
+    /* Now and then a long handler */
+    if ( (rand() % 8) == 0 )
+    {
+      Stall = rand() % (CHECK_STALL_MAX + 1);
+    }
+  }
+
+  Check_Simulated = FALSE;
+  Check_Pop_All();
+
+  return Check_Verify( "simulated" );
+}
+
+/*===========================================================================*/
+
+/* A real thread as the interrupt */
+static BOOL
+Check_Run_Threaded( UINT32 Samples )
+{
+  volatile BOOL Done = FALSE;
+  UINT32        Spin;
+
+  Check_Reset();
+
+  std::thread Producer( [&]()
+  {
+    while ( Check_Seq < Samples )
+    {
+      Check_Interrupt();
+
+      /* Bursts, so the ring fills as well */
+      for ( Spin = rand() % 2000; Spin > 0; Spin-- )
+      {
+        __atomic_signal_fence( __ATOMIC_SEQ_CST );
+      }
+
+      /* Let loop() run on a single core host */
+      if ( (rand() % 8) == 0 )
+      {
+        std::this_thread::yield();
+      }
+    }
+    Done = TRUE;
+  } );
+
+  while ( !Done )
+  {
+    Check_Pop_All();
+  }
+  Producer.join();
+  Check_Pop_All();
+
+  return Check_Verify( "threaded" );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  UINT32  Samples = 1000000;
+  UINT32  Seed    = 1;
+  INT32   Opt;
+  BOOL    Ok;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Samples = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-n samples] [-s seed]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  srand( Seed );
+
+  Ok  = Check_Run_Simulated( Samples );
+  Ok &= Check_Run_Threaded( Samples );
+
+  return Ok ? 0 : 2;
+}
+
+/*===========================================================================*/
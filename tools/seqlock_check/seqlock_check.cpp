@@ -0,0 +1,281 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   seqlock_check.cpp
+@brief  Stress the My_Status sequence lock with a concurrent writer
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/seqlock.h over a MY_STATUS_RECORD on the host. Each write
+section fills every field from one number, the count of write sections,
+so a copy with fields from two writes, or with a number other than the
+version it was returned with, is caught. In two ways:
+
+  Simulated   One thread. The writer fires at random inside the copy of
+              the reader, byte by byte, as an interrupt or another task
+              would. Repeatable with -s.
+
+  Threaded    The writer is a real second thread, so the memory ordering
+              is tested as well.
+
+Build, from this directory:
+  g++ -O2 -pthread -I../../main -o seqlock_check seqlock_check.cpp
+
+Usage:
+  seqlock_check [-n reads] [-s seed]
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+/* The simulated writer preempts the reader inside the copy */
+static void Check_Copy( void *pDst, const volatile void *pSrc, size_t Size );
+#define SEQLOCK_COPY( pDst, pSrc, Size )  Check_Copy( (pDst), (pSrc), (Size) )
+
+#include "seqlock.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Percent chance the writer fires before a byte of the copy */
+#define CHECK_PREEMPT_PERCENT   2
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static SEQLOCK_RECORD     Check_Lock;
+static MY_STATUS_RECORD   Check_Status;
+
+static BOOL               Check_Simulated = FALSE;
+static BOOL               Check_In_Write  = FALSE;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check_Write( void );
+static BOOL   Check_Consistent( const MY_STATUS_RECORD *pStatus, uint32_t Version );
+static void   Check_Reset( void );
+static BOOL   Check_Run_Simulated( UINT32 Reads );
+static BOOL   Check_Run_Threaded( UINT32 Reads );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* One write section, every field from the count of sections */
+static void
+Check_Write( void )
+{
+  uint32_t  N = Seqlock_Version( &Check_Lock ) + 1;
+
+  Check_In_Write = TRUE;
+  Seqlock_Write_Begin( &Check_Lock );
+
+  Check_Status.local_timestamp_s    = N;
+  snprintf( Check_Status.local_time_str, sizeof(Check_Status.local_time_str), "%lu", (UINT32)N );
+  Check_Status.relay_status         = N & 1;
+  Check_Status.current_wifi_status  = N & 0xFF;
+  snprintf( Check_Status.current_sta_ssid, sizeof(Check_Status.current_sta_ssid), "ssid-%lu", (UINT32)N );
+  Check_Status.wifi_connect_time_ms = N;
+  Check_Status.distance_valid       = (N & 2) != 0;
+  Check_Status.raw_distance_cm      = (FLOAT)(N & 0xFFFF);
+  Check_Status.avg_distance_cm      = (FLOAT)(N & 0xFFFF) + 0.5f;
+
+  Seqlock_Write_End( &Check_Lock );
+  Check_In_Write = FALSE;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Copy( void *pDst, const volatile void *pSrc, size_t Size )
+{
+  size_t  Index;
+
+  for ( Index = 0; Index < Size; Index++ )
+  {
+    /* The writer doesn't preempt itself */
+    if ( Check_Simulated && !Check_In_Write && ((rand() % 100) < CHECK_PREEMPT_PERCENT) )
+    {
+      Check_Write();
+    }
+    ((UINT8 *)pDst)[Index] = ((const volatile UINT8 *)pSrc)[Index];
+  }
+}
+
+/*===========================================================================*/
+
+/* All fields from the same write, and that write is the version */
+static BOOL
+Check_Consistent( const MY_STATUS_RECORD *pStatus, uint32_t Version )
+{
+  CHAR      Expect[WIFI_SSID_STR_MAX_SIZE];
+  uint32_t  N = pStatus->local_timestamp_s;
+
+  if ( N != Version )
+  {
+    return FALSE;
+  }
+
+  snprintf( Expect, sizeof(Expect), "%lu", (UINT32)N );
+  if ( strcmp( Expect, pStatus->local_time_str ) != 0 )
+  {
+    return FALSE;
+  }
+  snprintf( Expect, sizeof(Expect), "ssid-%lu", (UINT32)N );
+  if ( (N != 0) && (strcmp( Expect, pStatus->current_sta_ssid ) != 0) )
+  {
+    return FALSE;
+  }
+
+  return ( pStatus->relay_status         == (BOOL)(N & 1) ) &&
+         ( pStatus->current_wifi_status  == (N & 0xFF) ) &&
+         ( pStatus->wifi_connect_time_ms == N ) &&
+         ( pStatus->distance_valid       == ((N & 2) != 0) ) &&
+         ( pStatus->raw_distance_cm      == (FLOAT)(N & 0xFFFF) ) &&
+         ( pStatus->avg_distance_cm      == ((N == 0) ? 0 : (FLOAT)(N & 0xFFFF) + 0.5f) );
+}
+
+/*===========================================================================*/
+
+static void
+Check_Reset( void )
+{
+  Seqlock_Init( &Check_Lock );
+  memset( &Check_Status, 0, sizeof(Check_Status) );
+  snprintf( Check_Status.local_time_str, sizeof(Check_Status.local_time_str), "0" );
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Run_Simulated( UINT32 Reads )
+{
+  MY_STATUS_RECORD  Copy;
+  uint32_t          Version;
+  uint32_t          Last = 0;
+  UINT32            Bad  = 0;
+  UINT32            Count;
+
+  Check_Reset();
+  Check_Simulated = TRUE;
+
+  for ( Count = 0; Count < Reads; Count++ )
+  {
+    Version = Seqlock_Read( &Check_Lock, &Copy, &Check_Status, sizeof(Copy) );
+    if ( !Check_Consistent( &Copy, Version ) || (Version < Last) )
+    {
+      Bad++;
+    }
+    Last = Version;
+  }
+
+  Check_Simulated = FALSE;
+
+  printf( "simulated  %lu reads, %lu writes, %lu torn or out of order, %s\n",
+          Reads, (UINT32)Seqlock_Version( &Check_Lock ), Bad, (Bad == 0) ? "ok" : "FAILED" );
+
+  return ( Bad == 0 );
+}
+
+/*===========================================================================*/
+
+static BOOL
+Check_Run_Threaded( UINT32 Reads )
+{
+  MY_STATUS_RECORD  Copy;
+  uint32_t          Version;
+  uint32_t          Last = 0;
+  UINT32            Bad  = 0;
+  UINT32            Count;
+  volatile BOOL     Done = FALSE;
+
+  Check_Reset();
+
+  std::thread Writer( [&]()
+  {
+    while ( !Done )
+    {
+      Check_Write();
+
+      /* Let the reader run on a single core host */
+      if ( (rand() % 64) == 0 )
+      {
+        std::this_thread::yield();
+      }
+    }
+  } );
+
+  for ( Count = 0; Count < Reads; Count++ )
+  {
+    Version = Seqlock_Read( &Check_Lock, &Copy, &Check_Status, sizeof(Copy) );
+    if ( !Check_Consistent( &Copy, Version ) || (Version < Last) )
+    {
+      Bad++;
+    }
+    Last = Version;
+  }
+
+  Done = TRUE;
+  Writer.join();
+
+  printf( "threaded   %lu reads, %lu writes, %lu torn or out of order, %s\n",
+          Reads, (UINT32)Seqlock_Version( &Check_Lock ), Bad, (Bad == 0) ? "ok" : "FAILED" );
+
+  return ( Bad == 0 );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  UINT32  Reads = 1000000;
+  UINT32  Seed  = 1;
+  INT32   Opt;
+  BOOL    Ok;
+
+  for ( Opt = 1; Opt < argc; Opt++ )
+  {
+    if ( (strcmp( argv[Opt], "-n" ) == 0) && (Opt + 1 < argc) )
+    {
+      Reads = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else if ( (strcmp( argv[Opt], "-s" ) == 0) && (Opt + 1 < argc) )
+    {
+      Seed = strtoul( argv[++Opt], NULL, 0 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [-n reads] [-s seed]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  srand( Seed );
+
+  Ok  = Check_Run_Simulated( Reads );
+  Ok &= Check_Run_Threaded( Reads );
+
+  return Ok ? 0 : 2;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,343 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   sntp_check.cpp
+@brief  Check the SNTP client on canned replies, offset, delay and bad times
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/sntp_client.cpp with the local clock and the Wi-Fi manager on the
+host shims of tools/host_sim, against its NTP server stand-in. Each poll
+is asked for with Sntp_Request_Sync(), its replies are changed on the way
+out as the case needs, and the offset and round trip the client took are
+compared with what the replies make them:
+
+  first sync      the clock is stepped to the true time
+  server ahead    the server is 5 s ahead, offset +5 s, then -5 s back
+  hold time       the server holds the request 30 ms, its receive and
+                  transmit times say so, no delay and no offset
+  return delay    the reply takes 40 ms back, RTT 40 ms, offset -20 ms,
+                  the half of it the asymmetry puts on the clock
+  loss            30 % of the replies lost, still the shortest RTT
+
+Then replies the client must not take, each from a server 3 s ahead, so
+the clock moves if one is taken:
+
+  zero transmit or receive time, transmit before receive, stratum 0 (a
+  Kiss-o'-Death), leap indicator 3 (unsynchronised), an originate time
+  that isn't the request's, and no reply at all
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target sntp_check
+
+Usage:
+  sntp_check [-v]      -v for the console of the firmware
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "ntp_server.h"
+#include "esp8266_global.h"
+#include "local_clock.h"
+#include "sntp_client.h"
+#include "wifi_manager.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* 2026-10-19 00:00:00 UTC */
+#define CHECK_START_UNIX_US   1792368000000000LL
+
+/* Each loop() pass */
+#define CHECK_LOOP_US         100
+
+/* A poll takes at most a burst of timeouts, the spacing between */
+#define CHECK_POLL_MS         ( SNTP_BURST_SIZE * (SNTP_REPLY_TIMEOUT_MS + SNTP_BURST_SPACING_MS) + 500 )
+
+/* Error allowed for the loop() granularity */
+#define CHECK_MARGIN_US       300
+
+#define NTP_OFS_FLAGS         0
+#define NTP_OFS_STRATUM       1
+#define NTP_OFS_ORIGINATE     24
+#define NTP_OFS_RECEIVE       32
+#define NTP_OFS_TRANSMIT      40
+
+/* What is done to the replies */
+typedef enum
+{
+  CHECK_BAD_NONE = 0,
+  CHECK_BAD_ZERO_TRANSMIT,
+  CHECK_BAD_ZERO_RECEIVE,
+  CHECK_BAD_SENT_BEFORE,
+  CHECK_BAD_KISS,
+  CHECK_BAD_UNSYNCED,
+  CHECK_BAD_ORIGINATE,
+
+} CHECK_BAD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static bool       Check_Ok = true;
+
+/* How the stand-in's replies are changed */
+static int64_t    Tamper_Shift_us = 0;
+static int64_t    Tamper_Hold_us  = 0;
+static CHECK_BAD  Tamper_Bad      = CHECK_BAD_NONE;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void     Check( bool Condition, const char *pWhat );
+static void     Check_Tamper( uint8_t *pPacket );
+static void     Check_Run( uint32_t Ms );
+static void     Check_Poll( void );
+static int64_t  Check_Error_us( void );
+static void     Check_Good( const char *pWhat, int64_t Offset_us, int64_t Rtt_us );
+static void     Check_Bad( const char *pWhat, CHECK_BAD Bad, uint32_t Loss );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Check( bool Condition, const char *pWhat )
+{
+  printf( "  %-4s %s\n", Condition ? "ok" : "FAIL", pWhat );
+  if ( !Condition )
+  {
+    Check_Ok = false;
+  }
+}
+
+/*===========================================================================*/
+
+/* On every reply of the stand-in, as it is queued */
+static void
+Check_Tamper( uint8_t *pPacket )
+{
+  int64_t   Receive_us  = Sim_Ntp_Now_us() + Tamper_Shift_us;
+
+  Sim_Ntp_Write_Time( &pPacket[NTP_OFS_RECEIVE],  Receive_us );
+  Sim_Ntp_Write_Time( &pPacket[NTP_OFS_TRANSMIT], Receive_us + Tamper_Hold_us );
+
+  switch ( Tamper_Bad )
+  {
+    case CHECK_BAD_ZERO_TRANSMIT:
+      memset( &pPacket[NTP_OFS_TRANSMIT], 0, 8 );
+      break;
+
+    case CHECK_BAD_ZERO_RECEIVE:
+      memset( &pPacket[NTP_OFS_RECEIVE], 0, 8 );
+      break;
+
+    case CHECK_BAD_SENT_BEFORE:
+      Sim_Ntp_Write_Time( &pPacket[NTP_OFS_TRANSMIT], Receive_us - 1000 );
+      break;
+
+    case CHECK_BAD_KISS:
+      pPacket[NTP_OFS_STRATUM] = 0;
+      memcpy( &pPacket[12], "RATE", 4 );
+      break;
+
+    case CHECK_BAD_UNSYNCED:
+      pPacket[NTP_OFS_FLAGS] |= 0xc0;
+      break;
+
+    case CHECK_BAD_ORIGINATE:
+      pPacket[NTP_OFS_ORIGINATE + 7] ^= 0x01;
+      break;
+
+    default:
+      break;
+  }
+}
+
+/*===========================================================================*/
+
+/* The loop() of the firmware, for the parts the client needs */
+static void
+Check_Run( uint32_t Ms )
+{
+  uint64_t  End_us = Sim_Clock_Us() + (uint64_t)Ms * 1000;
+
+  while ( Sim_Clock_Us() < End_us )
+  {
+    Wifi_Handle();
+    Sntp_Handle();
+    Local_Clock_Handle();
+    Sim_Clock_Advance( CHECK_LOOP_US );
+  }
+}
+
+/*===========================================================================*/
+
+/* A poll now, and the time it takes */
+static void
+Check_Poll( void )
+{
+  Sntp_Request_Sync();
+  Check_Run( CHECK_POLL_MS );
+}
+
+/*===========================================================================*/
+
+static int64_t
+Check_Error_us( void )
+{
+  return Local_Clock_Now_us() - Sim_Ntp_Now_us();
+}
+
+/*===========================================================================*/
+
+/* A poll that syncs, to an offset and RTT within CHECK_MARGIN_US */
+static void
+Check_Good( const char *pWhat, int64_t Offset_us, int64_t Rtt_us )
+{
+  char  Line[160];
+
+  Check_Poll();
+
+  snprintf( Line, sizeof(Line), "%s, offset %lld us, RTT %lu us, %lld and %lld expected",
+            pWhat, (long long)Sntp_Get_Last_Offset_us(), Sntp_Get_Last_Rtt_us(),
+            (long long)Offset_us, (long long)Rtt_us );
+  Check( (llabs( Sntp_Get_Last_Offset_us() - Offset_us ) <= CHECK_MARGIN_US) &&
+         (llabs( (int64_t)Sntp_Get_Last_Rtt_us() - Rtt_us ) <= CHECK_MARGIN_US),
+         Line );
+}
+
+/*===========================================================================*/
+
+/* A poll from a server 3 s ahead whose replies must all be dropped */
+static void
+Check_Bad( const char *pWhat, CHECK_BAD Bad, uint32_t Loss )
+{
+  int64_t   Before_us = Check_Error_us();
+  int64_t   After_us;
+  uint32_t  Requests  = Sim_Ntp_Requests();
+  char      Line[160];
+
+  Tamper_Shift_us = 3000000;
+  Tamper_Bad      = Bad;
+  Sim_Ntp_Set_Loss( Loss );
+
+  Check_Poll();
+
+  Tamper_Shift_us = 0;
+  Tamper_Bad      = CHECK_BAD_NONE;
+  Sim_Ntp_Set_Loss( 0 );
+
+  After_us = Check_Error_us();
+  snprintf( Line, sizeof(Line), "%s, %u requests, the clock %lld us off after, %lld before",
+            pWhat, Sim_Ntp_Requests() - Requests, (long long)After_us, (long long)Before_us );
+  Check( (Sim_Ntp_Requests() > Requests) && (llabs( After_us - Before_us ) <= CHECK_MARGIN_US), Line );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  FILE    *pConsole;
+  char    Line[160];
+
+  if ( (argc > 1) && (strcmp( argv[1], "-v" ) == 0) )
+  {
+    pConsole = stdout;
+  }
+  else if ( argc > 1 )
+  {
+    fprintf( stderr, "Usage: %s [-v]\n", argv[0] );
+    return 1;
+  }
+  else
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+
+  if ( !Sim_Ntp_Start( CHECK_START_UNIX_US ) )
+  {
+    fprintf( stderr, "No socket for the NTP server\n" );
+    return 1;
+  }
+  Sim_Ntp_Set_Tamper( Check_Tamper );
+
+  /* Connected before the client starts */
+  My_Config_Set_Defaults( &My_Config );
+  Sim_Wifi_Add_Ap( My_Config.sta_list[0].ssid, -50, 1 );
+  Wifi_Initialise();
+  Check_Run( 10000 );
+  if ( !Wifi_Is_Connected() )
+  {
+    fprintf( stderr, "Not connected to the access point\n" );
+    return 1;
+  }
+
+  Sntp_Add_Server( "pool.ntp.org" );
+  Sntp_Start();
+  Check_Run( CHECK_POLL_MS );
+
+  printf( "Syncing\n" );
+  snprintf( Line, sizeof(Line), "first sync, the clock %lld us off, RTT %lu us",
+            (long long)Check_Error_us(), Sntp_Get_Last_Rtt_us() );
+  Check( Local_Clock_Is_Valid() && (llabs( Check_Error_us() ) <= CHECK_MARGIN_US) &&
+         (Sntp_Get_Last_Rtt_us() <= CHECK_MARGIN_US), Line );
+
+  Tamper_Shift_us = 5000000;
+  Check_Good( "server 5 s ahead", 5000000, 0 );
+  Tamper_Shift_us = 0;
+  Check_Good( "server back", -5000000, 0 );
+
+  Tamper_Hold_us = 30000;
+  Sim_Ntp_Set_Delay( 30000 );
+  Check_Good( "held 30 ms by the server", 0, 0 );
+  Tamper_Hold_us = 0;
+
+  Sim_Ntp_Set_Delay( 40000 );
+  Check_Good( "40 ms on the way back", -20000, 40000 );
+  Sim_Ntp_Set_Delay( 0 );
+
+  /* The -20 ms slewed in, the clock 20 ms behind */
+  Check_Run( 60000 );
+  Sim_Ntp_Set_Loss( 30 );
+  Check_Good( "30 % lost", 20000, 0 );
+  Sim_Ntp_Set_Loss( 0 );
+
+  printf( "Dropped\n" );
+  Check_Run( 60000 );
+  Check_Good( "in sync first", 0, 0 );
+  Check_Bad( "zero transmit time",          CHECK_BAD_ZERO_TRANSMIT, 0 );
+  Check_Bad( "zero receive time",           CHECK_BAD_ZERO_RECEIVE,  0 );
+  Check_Bad( "transmit before receive",     CHECK_BAD_SENT_BEFORE,   0 );
+  Check_Bad( "Kiss-o'-Death",               CHECK_BAD_KISS,          0 );
+  Check_Bad( "unsynchronised server",       CHECK_BAD_UNSYNCED,      0 );
+  Check_Bad( "not the request's originate", CHECK_BAD_ORIGINATE,     0 );
+  Check_Bad( "all replies lost",            CHECK_BAD_NONE,          100 );
+
+  printf( "%s\n", Check_Ok ? "PASS" : "FAIL" );
+  return Check_Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+#==============================================================================
+# Copyright Mickey
+#==============================================================================
+"""
+@file   tls_broker_check.py
+@brief  Measure full and resumed TLS handshakes against a local broker stand-in
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Does what mqtt_transport.cpp does with MQTT_TLS_ENABLE, on the host: TLS
+1.2, the same suites in the same order, session ID resumption without
+tickets as BearSSL has it, then CONNECT and wait for CONNACK. The broker
+stand-in runs in a thread, once with an ECDSA P-256 certificate and once
+with an RSA 2048 one, made with openssl for the run.
+
+For each certificate it connects -n times with a new session, and -n times
+offering the session of the first connect, and prints the medians of the
+client CPU time spent in the handshake, the bytes on the wire up to CONNACK
+and the round trips the handshake waited for. The client runs TLS on memory
+buffers so only the handshake itself is timed, not Python or the socket.
+The CPU time is what counts for the ESP8266, where the handshake is bound
+by the public key operations, and the round trips are what counts on a slow
+link. It fails if the broker didn't resume an offered session.
+
+The times are for the host, the ESP8266 is about two orders of magnitude
+slower. The ratio of full to resumed carries over, and the bytes and round
+trips are the same.
+
+This measures the protocol with Python's ssl, not the firmware, and is not
+a ctest. What mqtt_transport.cpp itself does with a session, and which
+metric a connect counts in, is checked by tools/mqtt_tls_check.
+
+Usage:
+  tls_broker_check.py [-n handshakes]
+
+Needs openssl in PATH.
+"""
+
+import argparse
+import os
+import socket
+import ssl
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+# mqtt_transport.cpp, Mqtt_Tls_Ciphers, in OpenSSL names
+CLIENT_CIPHERS = ":".join([
+    "ECDHE-ECDSA-AES128-GCM-SHA256",
+    "ECDHE-ECDSA-CHACHA20-POLY1305",
+    "ECDHE-ECDSA-AES128-SHA256",
+    "ECDHE-RSA-AES128-GCM-SHA256",
+    "ECDHE-RSA-CHACHA20-POLY1305",
+    "ECDHE-RSA-AES128-SHA256",
+])
+
+# The certificates of the broker stand-in
+CERTS = [
+    ("ecdsa-p256", ["-newkey", "ec", "-pkeyopt", "ec_paramgen_curve:prime256v1"]),
+    ("rsa-2048",   ["-newkey", "rsa:2048"]),
+]
+
+# CONNECT of client "esp8266", keep alive 15 s, clean session
+MQTT_CONNECT = bytes([0x10, 0x13, 0x00, 0x04]) + b"MQTT" + bytes([0x04, 0x02, 0x00, 0x0F, 0x00, 0x07]) + b"esp8266"
+MQTT_CONNACK = bytes([0x20, 0x02, 0x00, 0x00])
+
+
+def make_cert(directory, name, key_args):
+    """Self-signed certificate and key, returns their paths"""
+    cert = os.path.join(directory, name + ".pem")
+    key  = os.path.join(directory, name + ".key")
+    try:
+        subprocess.run(["openssl", "req", "-x509", "-nodes", "-days", "1", "-subj", "/CN=broker.local",
+                        "-keyout", key, "-out", cert] + key_args,
+                       check=True, capture_output=True)
+    except FileNotFoundError:
+        sys.exit("openssl not found")
+    except subprocess.CalledProcessError as err:
+        sys.exit(err.stderr.decode().strip())
+    return cert, key
+
+
+def read_packet(conn):
+    """One MQTT packet, None if the connection closed"""
+    header = conn.recv(1)
+    if not header:
+        return None
+    length, shift = 0, 0
+    while True:
+        byte = conn.recv(1)
+        if not byte:
+            return None
+        header += byte
+        length |= (byte[0] & 0x7F) << shift
+        shift += 7
+        if not byte[0] & 0x80:
+            break
+    body = b""
+    while len(body) < length:
+        chunk = conn.recv(length - len(body))
+        if not chunk:
+            return None
+        body += chunk
+    return header + body
+
+
+class Broker:
+    """Accepts TLS, answers CONNECT with CONNACK, until the client goes"""
+
+    def __init__(self, cert, key):
+        self.context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        self.context.maximum_version = ssl.TLSVersion.TLSv1_2
+        self.context.load_cert_chain(cert, key)
+        # Session IDs in the server cache, BearSSL has no tickets
+        self.context.options |= ssl.OP_NO_TICKET
+        self.listener = socket.create_server(("127.0.0.1", 0))
+        self.port = self.listener.getsockname()[1]
+        self.thread = threading.Thread(target=self.serve, daemon=True)
+        self.thread.start()
+
+    def serve(self):
+        while True:
+            try:
+                raw, _ = self.listener.accept()
+            except OSError:
+                return
+            raw.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            try:
+                with self.context.wrap_socket(raw, server_side=True) as conn:
+                    while True:
+                        packet = read_packet(conn)
+                        if packet is None or packet[0] >> 4 == 14:
+                            break
+                        if packet[0] >> 4 == 1:
+                            conn.sendall(MQTT_CONNACK)
+                    # Without close_notify OpenSSL drops the session
+                    conn.unwrap()
+            except (ssl.SSLError, OSError):
+                raw.close()
+
+    def close(self):
+        self.listener.close()
+
+
+def connect(context, port, session):
+    """One connect up to CONNACK, the client side of TLS on memory buffers so
+    its CPU time, bytes and round trips can be counted.
+    Returns (client cpu s, bytes, round trips, session, reused)"""
+    raw = socket.create_connection(("127.0.0.1", port))
+    raw.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    incoming, outgoing = ssl.MemoryBIO(), ssl.MemoryBIO()
+    tls = context.wrap_bio(incoming, outgoing, server_hostname="broker.local", session=session)
+    cpu, wire, trips = 0.0, 0, 0
+
+    def flush():
+        nonlocal wire
+        data = outgoing.read()
+        wire += len(data)
+        raw.sendall(data)
+
+    def receive():
+        nonlocal wire
+        data = raw.recv(4096)
+        if not data:
+            sys.exit("broker closed the connection")
+        wire += len(data)
+        incoming.write(data)
+
+    while True:
+        start = time.thread_time()
+        try:
+            tls.do_handshake()
+            cpu += time.thread_time() - start
+            break
+        except ssl.SSLWantReadError:
+            cpu += time.thread_time() - start
+        flush()
+        receive()
+        trips += 1
+    flush()
+
+    tls.write(MQTT_CONNECT)
+    flush()
+    reply = b""
+    while len(reply) < len(MQTT_CONNACK):
+        try:
+            reply += tls.read(len(MQTT_CONNACK) - len(reply))
+        except ssl.SSLWantReadError:
+            receive()
+    if reply != MQTT_CONNACK:
+        sys.exit("no CONNACK")
+
+    result = (cpu, wire, trips, tls.session, tls.session_reused)
+
+    tls.write(bytes([0xE0, 0x00]))
+    try:
+        tls.unwrap()
+    except ssl.SSLWantReadError:
+        pass
+    flush()
+    raw.close()
+    return result
+
+
+def measure(cert, key, count):
+    """Medians of full and resumed connects, and the share resumed"""
+    broker = Broker(cert, key)
+
+    context = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    context.maximum_version = ssl.TLSVersion.TLSv1_2
+    context.set_ciphers(CLIENT_CIPHERS)
+    context.check_hostname = False
+    context.load_verify_locations(cert)
+
+    full = [connect(context, broker.port, None) for _ in range(count)]
+    session = full[0][3]
+    resumed = [connect(context, broker.port, session) for _ in range(count)]
+
+    broker.close()
+
+    def medians(runs):
+        return (statistics.median(run[0] for run in runs) * 1000,
+                statistics.median(run[1] for run in runs),
+                statistics.median(run[2] for run in runs))
+
+    return medians(full), medians(resumed), sum(1 for run in resumed if run[4]) / count
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[2].split("@brief")[-1].strip())
+    parser.add_argument("-n", type=int, default=20, help="handshakes of each kind")
+    args = parser.parse_args()
+    if args.n < 1:
+        sys.exit("-n must be 1 or more")
+
+    ok = True
+    print("%-12s %-8s %8s %7s %6s %8s" % ("certificate", "session", "cpu ms", "bytes", "trips", "resumed"))
+    with tempfile.TemporaryDirectory() as directory:
+        for name, key_args in CERTS:
+            cert, key = make_cert(directory, name, key_args)
+            full, resumed, share = measure(cert, key, args.n)
+            print("%-12s %-8s %8.3f %7d %6d" % ((name, "new") + full))
+            print("%-12s %-8s %8.3f %7d %6d %7.0f%%" % (("", "cached") + resumed + (share * 100,)))
+            ok &= (share == 1.0)
+
+    if not ok:
+        print("FAILED, an offered session was not resumed")
+    return 0 if ok else 2
+
+
+if __name__ == "__main__":
+    sys.exit(main())
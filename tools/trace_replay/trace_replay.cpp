@@ -0,0 +1,386 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   trace_replay.cpp
+@brief  Replay a recorded sensor trace through the relay control on the host
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Feeds a trace recorded by main/trace.cpp through the same sonar filter and
+relay decision code as the firmware (main/relay_control.cpp), as fast as
+the host runs, and reports relay transitions, on-time and how far the
+replay diverges from the relay changes recorded on the device.
+
+It fails if the replay diverges from the recorded changes, or with -t if
+it made another count of transitions. ctest runs it on fixture_trace.txt,
+a made up trace whose R lines are the changes expected, see its header.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target trace_replay
+
+Usage:
+  trace_replay [-n repeat] [-t transitions] [-c topic=message]... trace.txt
+
+  -n  Replay the trace this many times, to measure the replay speed
+  -t  The relay transitions the replay must make
+  -c  Override a command, e.g. -c high_distance=80. It's applied after
+      every command of the trace, so the config under test always wins
+
+Collect a trace by publishing "on" to the "trace" topic and saving the
+lines of "trace_data", e.g.
+  mosquitto_sub -h <broker> -t trace_data > trace.txt
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "relay_control.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+#define TRACE_TOPIC_MAX_SIZE    48
+#define TRACE_MESSAGE_MAX_SIZE  32
+#define TRACE_OVERRIDE_MAX      8
+
+/* One line of the trace */
+typedef struct
+{
+  CHAR    type;                 /* 'S', 'C' or 'R' */
+  UINT32  ms;
+
+  /* 'S' */
+  FLOAT   raw_distance_cm;
+  INT16   minute_of_day;
+
+  /* 'C' */
+  CHAR    topic[TRACE_TOPIC_MAX_SIZE];
+  CHAR    message[TRACE_MESSAGE_MAX_SIZE];
+
+  /* 'R' */
+  BOOL    relay_status;
+
+} TRACE_EVENT_RECORD;
+
+/* Counters of one run */
+typedef struct
+{
+  UINT32  samples;
+  UINT32  commands;
+  UINT32  transitions;
+  UINT64  on_ms;
+
+  UINT32  ref_transitions;
+  UINT64  ref_on_ms;
+
+  UINT32  divergent_samples;
+  UINT64  divergent_ms;
+
+} REPLAY_RESULT_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static std::vector<TRACE_EVENT_RECORD> Trace_Events;
+
+static const CHAR *Override_Topics[TRACE_OVERRIDE_MAX];
+static const CHAR *Override_Messages[TRACE_OVERRIDE_MAX];
+static UINT8       Override_Count = 0;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static BOOL   Trace_Load( const CHAR *pFile_Name );
+static void   Replay_Apply_Command( MY_CONFIG_RECORD *pConfig, BOOL *pRelay_Status, const CHAR *pTopic, const CHAR *pMessage );
+static void   Replay_Run( REPLAY_RESULT_RECORD *pResult );
+static DOUBLE Replay_Now_s( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* Parse the whole trace, lines that are not trace lines are skipped */
+static BOOL
+Trace_Load( const CHAR *pFile_Name )
+{
+  FILE               *pFile;
+  CHAR                Line[160];
+  TRACE_EVENT_RECORD  Event;
+  CHAR               *pField;
+  INT32               Minute;
+  INT32               Relay;
+
+  pFile = fopen( pFile_Name, "r" );
+  if ( pFile == NULL )
+  {
+    fprintf( stderr, "Can't open %s\n", pFile_Name );
+    return FALSE;
+  }
+
+  while ( fgets( Line, sizeof(Line), pFile ) != NULL )
+  {
+    Line[strcspn( Line, "\r\n" )] = 0;
+    memset( &Event, 0, sizeof(Event) );
+    Event.type = Line[0];
+
+    if ( (Event.type == 'S') &&
+         (sscanf( Line, "S,%lu,%f,%ld", &Event.ms, &Event.raw_distance_cm, &Minute ) == 3) )
+    {
+      Event.minute_of_day = (INT16)Minute;
+    }
+    else if ( (Event.type == 'R') && (sscanf( Line, "R,%lu,%ld", &Event.ms, &Relay ) == 2) )
+    {
+      Event.relay_status = ( Relay != 0 );
+    }
+    else if ( (Event.type == 'C') && (sscanf( Line, "C,%lu,", &Event.ms ) == 1) )
+    {
+      /* C,<ms>,<topic>,<message>, the message may hold anything */
+      pField = strchr( &Line[2], ',' );
+      if ( (pField == NULL) || (strchr( pField + 1, ',' ) == NULL) )
+      {
+        continue;
+      }
+      pField++;
+      snprintf( Event.topic, sizeof(Event.topic), "%.*s", (int)(strchr( pField, ',' ) - pField), pField );
+      snprintf( Event.message, sizeof(Event.message), "%s", strchr( pField, ',' ) + 1 );
+    }
+    else
+    {
+      continue;
+    }
+
+    Trace_Events.push_back( Event );
+  }
+
+  fclose( pFile );
+  return TRUE;
+}
+
+/*===========================================================================*/
+
+/* Apply a command, then the overrides on top */
+static void
+Replay_Apply_Command( MY_CONFIG_RECORD *pConfig, BOOL *pRelay_Status, const CHAR *pTopic, const CHAR *pMessage )
+{
+  UINT8   Index;
+
+  Relay_Apply_Command( pConfig, pRelay_Status, pTopic, pMessage );
+
+  for ( Index = 0; Index < Override_Count; Index++ )
+  {
+    Relay_Apply_Command( pConfig, pRelay_Status, Override_Topics[Index], Override_Messages[Index] );
+  }
+}
+
+/*===========================================================================*/
+
+/* One pass over the trace, decide after each sample and command as loop() does */
+static void
+Replay_Run( REPLAY_RESULT_RECORD *pResult )
+{
+  MY_CONFIG_RECORD    Config;
+  SONAR_FILTER_RECORD Filter;
+  RELAY_INPUT_RECORD  Input;
+  BOOL                Relay_Status      = FALSE;
+  BOOL                Ref_Relay_Status  = FALSE;
+  BOOL                Ref_Seen          = FALSE;
+  BOOL                Filter_Ready      = FALSE;
+  BOOL                Last_Sample_Valid = FALSE;
+  UINT32              Last_ms           = 0;
+  UINT32              Last_Sample_ms    = 0;
+  BOOL                New_Status;
+  size_t              Index;
+
+  memset( pResult, 0, sizeof(REPLAY_RESULT_RECORD) );
+  memset( &Config, 0, sizeof(Config) );
+  memset( &Input, 0, sizeof(Input) );
+
+  for ( Index = 0; Index < Trace_Events.size(); Index++ )
+  {
+    const TRACE_EVENT_RECORD *pEvent = &Trace_Events[Index];
+
+    /* On-time since the last event */
+    if ( Index > 0 )
+    {
+      pResult->on_ms     += Relay_Status     ? (pEvent->ms - Last_ms) : 0;
+      pResult->ref_on_ms += Ref_Relay_Status ? (pEvent->ms - Last_ms) : 0;
+    }
+    Last_ms = pEvent->ms;
+
+    switch ( pEvent->type )
+    {
+      case 'S':
+        /* The relay change of the last sample is recorded after it, compare now */
+        if ( Last_Sample_Valid && Ref_Seen && (Relay_Status != Ref_Relay_Status) )
+        {
+          pResult->divergent_samples++;
+          pResult->divergent_ms += pEvent->ms - Last_Sample_ms;
+        }
+        Last_Sample_Valid = TRUE;
+        Last_Sample_ms    = pEvent->ms;
+        pResult->samples++;
+
+        /* The firmware fills the window with the first sample at boot */
+        if ( !Filter_Ready && (pEvent->raw_distance_cm != 0) )
+        {
+          Sonar_Filter_Reset( &Filter, pEvent->raw_distance_cm );
+          Filter_Ready = TRUE;
+        }
+
+        Input.distance_valid  = Filter_Ready && Sonar_Filter_Add( &Filter, pEvent->raw_distance_cm );
+        Input.avg_distance_cm = Filter_Ready ? Filter.avg_distance_cm : 0;
+        Input.time_valid      = ( pEvent->minute_of_day >= 0 );
+        Input.hour            = Input.time_valid ? (pEvent->minute_of_day / 60) : 0;
+        Input.minute          = Input.time_valid ? (pEvent->minute_of_day % 60) : 0;
+        break;
+
+      case 'C':
+        pResult->commands++;
+        Replay_Apply_Command( &Config, &Relay_Status, pEvent->topic, pEvent->message );
+        break;
+
+      case 'R':
+        /* The first one is the relay when recording started */
+        if ( !Ref_Seen )
+        {
+          Relay_Status = pEvent->relay_status;
+        }
+        else if ( pEvent->relay_status != Ref_Relay_Status )
+        {
+          pResult->ref_transitions++;
+        }
+        Ref_Relay_Status = pEvent->relay_status;
+        Ref_Seen         = TRUE;
+        continue;
+
+      default:
+        continue;
+    }
+
+    New_Status = Relay_Decide( &Config, &Input, Relay_Status );
+    if ( New_Status != Relay_Status )
+    {
+      pResult->transitions++;
+      Relay_Status = New_Status;
+    }
+  }
+}
+
+/*===========================================================================*/
+
+static DOUBLE
+Replay_Now_s( void )
+{
+  struct timespec Now;
+
+  clock_gettime( CLOCK_MONOTONIC, &Now );
+  return Now.tv_sec + Now.tv_nsec / 1e9;
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  REPLAY_RESULT_RECORD  Result;
+  UINT32                Repeat = 1;
+  INT32                 Expected = -1;
+  UINT32                Count;
+  DOUBLE                Start_s;
+  DOUBLE                Cost_s;
+  DOUBLE                Trace_s;
+  CHAR                 *pEqual;
+  INT32                 Opt;
+
+  for ( Opt = 1; Opt < argc - 1; Opt++ )
+  {
+    if ( strcmp( argv[Opt], "-n" ) == 0 )
+    {
+      Repeat = strtoul( argv[++Opt], NULL, 10 );
+      Repeat = ( Repeat == 0 ) ? 1 : Repeat;
+    }
+    else if ( strcmp( argv[Opt], "-t" ) == 0 )
+    {
+      Expected = strtol( argv[++Opt], NULL, 10 );
+    }
+    else if ( (strcmp( argv[Opt], "-c" ) == 0) && (Override_Count < TRACE_OVERRIDE_MAX) )
+    {
+      pEqual = strchr( argv[++Opt], '=' );
+      if ( pEqual == NULL )
+      {
+        fprintf( stderr, "Bad override %s, topic=message expected\n", argv[Opt] );
+        return 1;
+      }
+      *pEqual = 0;
+      Override_Topics[Override_Count]   = argv[Opt];
+      Override_Messages[Override_Count] = pEqual + 1;
+      Override_Count++;
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  if ( (Opt != argc - 1) || !Trace_Load( argv[argc - 1] ) )
+  {
+    fprintf( stderr, "Usage: %s [-n repeat] [-t transitions] [-c topic=message]... trace.txt\n", argv[0] );
+    return 1;
+  }
+
+  if ( Trace_Events.empty() )
+  {
+    fprintf( stderr, "No trace lines found\n" );
+    return 1;
+  }
+
+  Start_s = Replay_Now_s();
+  for ( Count = 0; Count < Repeat; Count++ )
+  {
+    Replay_Run( &Result );
+  }
+  Cost_s  = Replay_Now_s() - Start_s;
+  Trace_s = (Trace_Events.back().ms - Trace_Events.front().ms) / 1000.0;
+
+  printf( "samples:            %lu\n", Result.samples );
+  printf( "commands:           %lu\n", Result.commands );
+  printf( "trace_duration_s:   %.1f\n", Trace_s );
+  printf( "transitions:        %lu\n", Result.transitions );
+  printf( "on_time_s:          %.1f\n", Result.on_ms / 1000.0 );
+  printf( "ref_transitions:    %lu\n", Result.ref_transitions );
+  printf( "ref_on_time_s:      %.1f\n", Result.ref_on_ms / 1000.0 );
+  printf( "divergent_samples:  %lu\n", Result.divergent_samples );
+  printf( "divergent_time_s:   %.1f\n", Result.divergent_ms / 1000.0 );
+  printf( "replay_runs:        %lu\n", Repeat );
+  printf( "replay_cost_s:      %.3f\n", Cost_s );
+  printf( "speedup:            %.0fx\n", (Cost_s > 0) ? (Trace_s * Repeat / Cost_s) : 0 );
+
+  if ( (Expected >= 0) && (Result.transitions != (UINT32)Expected) )
+  {
+    printf( "FAIL: %lu transitions, %ld expected\n", Result.transitions, Expected );
+    return 2;
+  }
+
+  return ( Result.divergent_samples == 0 ) ? 0 : 2;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,183 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   watchdog_rtc_check.cpp
+@brief  Check the watchdog reads back after a reset what its interrupt wrote
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Runs main/watchdog.cpp on the host shims of tools/host_sim, their RTC
+memory mapped at its addresses as on the chip. The timer interrupt writes
+the stall record by address, Watchdog_Initialise() reads it back with
+ESP.rtcUserMemoryRead(), so the two only meet if the address is that of
+the user block.
+
+A first boot, in a child process, stalls the NTP task past its deadline
+with the reset off, then the SDK watchdog resets it, only the interrupt
+wrote the record. The boot after it, in this process, must take the
+stall from the RTC memory, and its log line must name the task, the
+names are in flash and printed with %S, a wchar_t string to glibc.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target watchdog_rtc_check
+
+Usage:
+  watchdog_rtc_check [-v]      -v for the console of the firmware
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "esp8266_global.h"
+#include "metrics.h"
+#include "watchdog.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Past the 2 s deadline of the NTP task */
+#define CHECK_STALL_MS        3000
+
+/* Watchdog_Initialise() logs it after the reset */
+#define CHECK_STALL_LINE      "Task ntp ran "
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check_Boot_Stall( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+/* The first boot, stalls and is reset by the SDK watchdog, exits 0 if the
+   stall was counted */
+static void
+Check_Boot_Stall( void )
+{
+  My_Config_Set_Defaults( &My_Config );
+  My_Config.wdt_enable = FALSE;
+
+  Watchdog_Initialise();
+  Watchdog_Begin( WATCHDOG_TASK_NTP );
+  Sim_Clock_Advance( CHECK_STALL_MS * 1000 );
+
+  Sim_Storage_Restart();
+  _exit( (Metric_Get( METRIC_WATCHDOG_STALLS_NTP ) == 1) ? 0 : 1 );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  char    Dir[] = "/tmp/watchdog_rtc_check.XXXXXX";
+  FILE    *pConsole;
+  char    Line[160];
+  bool    Named = false;
+  FILE    *pLog;
+  pid_t   Child;
+  int     Status;
+  bool    Ok = true;
+
+  if ( (argc > 1) && (strcmp( argv[1], "-v" ) == 0) )
+  {
+    pConsole = stdout;
+  }
+  else if ( argc > 1 )
+  {
+    fprintf( stderr, "Usage: %s [-v]\n", argv[0] );
+    return 1;
+  }
+  else
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+
+  if ( mkdtemp( Dir ) == NULL )
+  {
+    fprintf( stderr, "No storage directory\n" );
+    return 1;
+  }
+  Sim_Storage_Set_Dir( Dir );
+
+  fflush( NULL );
+  Child = fork();
+  if ( Child == 0 )
+  {
+    Check_Boot_Stall();
+  }
+  if ( (Child < 0) || (waitpid( Child, &Status, 0 ) != Child) )
+  {
+    fprintf( stderr, "No first boot\n" );
+    return 1;
+  }
+
+  printf( "Before the reset, %s\n",
+          (WIFEXITED( Status ) && (WEXITSTATUS( Status ) == 0)) ? "the stall counted" : "no stall" );
+  if ( !WIFEXITED( Status ) || (WEXITSTATUS( Status ) != 0) )
+  {
+    printf( "FAIL: the NTP task wasn't caught over its deadline\n" );
+    Ok = false;
+  }
+
+  pLog = tmpfile();
+  Sim_Serial_Set_Output( pLog );
+  My_Config_Set_Defaults( &My_Config );
+  My_Config.wdt_enable = FALSE;
+  Watchdog_Initialise();
+  Sim_Serial_Set_Output( pConsole );
+
+  rewind( pLog );
+  while ( fgets( Line, sizeof(Line), pLog ) != NULL )
+  {
+    Named = Named || ( strstr( Line, CHECK_STALL_LINE ) != NULL );
+    fputs( Line, pConsole );
+  }
+  fclose( pLog );
+
+  printf( "After the reset, %s, %lu NTP stalls\n",
+          Sim_Storage_Restarted() ? "restarted" : "power on",
+          Metric_Get( METRIC_WATCHDOG_STALLS_NTP ) );
+  if ( !Sim_Storage_Restarted() )
+  {
+    printf( "FAIL: the storage wasn't kept over the reset\n" );
+    Ok = false;
+  }
+  if ( Metric_Get( METRIC_WATCHDOG_STALLS_NTP ) != 1 )
+  {
+    printf( "FAIL: the record the interrupt wrote isn't where Watchdog_Initialise() reads\n" );
+    Ok = false;
+  }
+  if ( !Named )
+  {
+    printf( "FAIL: no \"" CHECK_STALL_LINE "\" in the log, %%S not taken as a string\n" );
+    Ok = false;
+  }
+
+  printf( "%s\n", Ok ? "PASS" : "FAIL" );
+  return Ok ? 0 : 1;
+}
+
+/*===========================================================================*/
@@ -0,0 +1,370 @@
+/*=============================================================================
+Copyright Mickey
+=============================================================================*/
+/*!
+@file   wifi_select_check.cpp
+@brief  Check the network selection, the roaming order and the config migration
+@author Mickey
+@date   2026.10.19
+@note
+
+Description:
+Three parts, each printing what it found and FAIL where it is not what
+is expected:
+
+Selection, Wifi_Sort_Scan() and Wifi_Select_Network() of
+main/wifi_select.cpp on canned scan results. The strongest repeater of a
+network wins, a priority level is worth WIFI_PRIORITY_WEIGHT_DB, an AP
+under WIFI_MIN_RSSI_DBM and a record not valid are never taken.
+
+Roaming, main/wifi_manager.cpp on the host shims of tools/host_sim with
+two repeaters of "home", an "office" of higher priority and a "cafe" not
+stored. The signals change as the device would move and the access points
+it connects to are recorded, in order:
+
+  home 0        the strongest stored AP at boot
+  home 1        home 0 gets weak, home 1 is WIFI_ROAM_HYSTERESIS_DB stronger
+  (stays)       home 0 comes back, but less than the hysteresis stronger
+  office 2      office comes in range, its priority makes it the choice
+  home 0        office is gone, the rescan after the loss takes home
+
+Migration, My_Config_Validate() of main/esp8266_global.cpp on a config of
+format 2. The network becomes the first of the list, the AP and relay
+settings are kept.
+
+Build, from tools/:
+  cmake -S . -B build && cmake --build build --target wifi_select_check
+
+Usage:
+  wifi_select_check [-v]      -v for the console of the firmware
+*/
+
+/*=============================================================================
+System Includes
+=============================================================================*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+/*=============================================================================
+Local Includes
+=============================================================================*/
+
+#include "sim.h"
+#include "esp8266_global.h"
+#include "wifi_select.h"
+#include "wifi_manager.h"
+
+/*=============================================================================
+Definitions
+=============================================================================*/
+
+/* Wifi_Handle() as loop() calls it */
+#define CHECK_LOOP_MS       10
+
+/* A config of format 2, as main/esp8266_global.h had it */
+typedef struct
+{
+  UINT16  format_version;
+
+  CHAR    sta_ssid[WIFI_SSID_STR_MAX_SIZE];
+  CHAR    sta_pwd[WIFI_PWD_STR_MAX_SIZE];
+  CHAR    ap_ssid[WIFI_SSID_STR_MAX_SIZE];
+  CHAR    ap_pwd[WIFI_PWD_STR_MAX_SIZE];
+
+  BOOL    relay_auto;
+  RELAY_TIMING_RECORD relay_on_timing;
+  RELAY_TIMING_RECORD relay_off_timing;
+  FLOAT   high_distance_cm;
+  FLOAT   low_distance_cm;
+
+} CHECK_CONFIG_V2_RECORD;
+
+/*=============================================================================
+Static Variables
+=============================================================================*/
+
+static bool               Check_Ok = true;
+
+/* The access points connected to, in order */
+static std::vector<int>   Check_Order;
+
+/*=============================================================================
+Static Prototypes
+=============================================================================*/
+
+static void   Check( bool Condition, const char *pWhat );
+static void   Check_Add_Scan( WIFI_SCAN_RECORD *pScan, UINT8 *pSize, const char *pSsid, UINT8 Id, INT8 Rssi );
+static void   Check_Selection( void );
+static void   Check_Run( uint32_t Ms );
+static void   Check_Roaming( void );
+static void   Check_Migration( void );
+
+/*=============================================================================
+Function Definitions
+=============================================================================*/
+
+/*===========================================================================*/
+
+static void
+Check( bool Condition, const char *pWhat )
+{
+  printf( "  %-4s %s\n", Condition ? "ok" : "FAIL", pWhat );
+  if ( !Condition )
+  {
+    Check_Ok = false;
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Check_Add_Scan( WIFI_SCAN_RECORD *pScan, UINT8 *pSize, const char *pSsid, UINT8 Id, INT8 Rssi )
+{
+  WIFI_SCAN_RECORD  *pRecord = &pScan[(*pSize)++];
+
+  memset( pRecord, 0, sizeof(WIFI_SCAN_RECORD) );
+  strncpy( pRecord->ssid, pSsid, WIFI_SSID_STR_MAX_SIZE - 1 );
+  pRecord->bssid[5] = Id;
+  pRecord->channel  = 1;
+  pRecord->rssi     = Rssi;
+}
+
+/*===========================================================================*/
+
+static void
+Check_Selection( void )
+{
+  WIFI_STA_RECORD   List[WIFI_STA_LIST_MAX_SIZE];
+  WIFI_SCAN_RECORD  Scan[WIFI_SCAN_MAX_RESULTS];
+  UINT8             Size = 0;
+  INT8              Scan_Index;
+  INT8              List_Index;
+
+  printf( "Selection\n" );
+
+  memset( List, 0, sizeof(List) );
+  List[0].valid = TRUE;
+  strcpy( List[0].ssid, "home" );
+  List[1].valid = TRUE;
+  strcpy( List[1].ssid, "office" );
+  List[2].valid = FALSE;
+  strcpy( List[2].ssid, "cafe" );
+
+  /* Sorted strongest first, equal ones in the order found */
+  Check_Add_Scan( Scan, &Size, "home",   1, -70 );
+  Check_Add_Scan( Scan, &Size, "cafe",   2, -40 );
+  Check_Add_Scan( Scan, &Size, "home",   3, -55 );
+  Check_Add_Scan( Scan, &Size, "office", 4, -70 );
+  Check_Add_Scan( Scan, &Size, "office", 5, -60 );
+  Wifi_Sort_Scan( Scan, Size );
+  Check( (Scan[0].bssid[5] == 2) && (Scan[1].bssid[5] == 3) && (Scan[2].bssid[5] == 5) &&
+         (Scan[3].bssid[5] == 1) && (Scan[4].bssid[5] == 4),
+         "sorted by RSSI, stable" );
+
+  /* Same priority, the strongest repeater of a stored network */
+  List_Index = Wifi_Select_Network( List, WIFI_STA_LIST_MAX_SIZE, Scan, Size, &Scan_Index );
+  Check( (List_Index == 0) && (Scan[Scan_Index].bssid[5] == 3), "strongest stored AP, not the cafe" );
+
+  /* 5 dB weaker but a level higher, office */
+  List[1].priority = 1;
+  List_Index = Wifi_Select_Network( List, WIFI_STA_LIST_MAX_SIZE, Scan, Size, &Scan_Index );
+  Check( (List_Index == 1) && (Scan[Scan_Index].bssid[5] == 5), "a priority level is worth the signal" );
+
+  /* A level lower, home even when office is as strong */
+  List[1].priority = 0;
+  List[0].priority = 1;
+  Scan[1].rssi     = -60;
+  Wifi_Sort_Scan( Scan, Size );
+  List_Index = Wifi_Select_Network( List, WIFI_STA_LIST_MAX_SIZE, Scan, Size, &Scan_Index );
+  Check( List_Index == 0, "the higher priority at equal signal" );
+
+  /* Nothing stored is on the air, the cafe record is not valid */
+  strcpy( List[0].ssid, "nowhere" );
+  strcpy( List[1].ssid, "nowhere" );
+  List_Index = Wifi_Select_Network( List, WIFI_STA_LIST_MAX_SIZE, Scan, Size, &Scan_Index );
+  Check( (List_Index < 0) && (Scan_Index < 0), "nothing stored found, -1" );
+
+  /* Too weak whatever the priority */
+  Size = 0;
+  Check_Add_Scan( Scan, &Size, "office", 6, WIFI_MIN_RSSI_DBM - 1 );
+  Check_Add_Scan( Scan, &Size, "home",   7, -80 );
+  strcpy( List[0].ssid, "home" );
+  strcpy( List[1].ssid, "office" );
+  List[0].priority = 0;
+  List[1].priority = WIFI_PRIORITY_MAX;
+  List_Index = Wifi_Select_Network( List, WIFI_STA_LIST_MAX_SIZE, Scan, Size, &Scan_Index );
+  Check( (List_Index == 0) && (Scan[Scan_Index].bssid[5] == 7), "an AP under the minimum RSSI is ignored" );
+}
+
+/*===========================================================================*/
+
+/* Wifi_Handle() for a while, recording the access points connected to */
+static void
+Check_Run( uint32_t Ms )
+{
+  uint32_t  Index;
+  int       Ap;
+
+  for ( Index = 0; Index < Ms / CHECK_LOOP_MS; Index++ )
+  {
+    Wifi_Handle();
+    Sim_Clock_Advance( CHECK_LOOP_MS * 1000 );
+
+    Ap = Sim_Wifi_Ap();
+    if ( (Ap >= 0) && (Check_Order.empty() || (Check_Order.back() != Ap)) )
+    {
+      Check_Order.push_back( Ap );
+    }
+  }
+}
+
+/*===========================================================================*/
+
+static void
+Check_Roaming( void )
+{
+  static const int  Expected[] = { 0, 1, 2, 0 };
+  int               Home_0;
+  int               Home_1;
+  int               Office;
+  size_t            Index;
+  bool              Same;
+
+  printf( "Roaming\n" );
+
+  My_Config_Set_Defaults( &My_Config );
+  memset( My_Config.sta_list, 0, sizeof(My_Config.sta_list) );
+  My_Config.sta_list[0].valid     = TRUE;
+  My_Config.sta_list[0].priority  = 0;
+  strcpy( My_Config.sta_list[0].ssid, "home" );
+  My_Config.sta_list[1].valid     = TRUE;
+  My_Config.sta_list[1].priority  = 2;
+  strcpy( My_Config.sta_list[1].ssid, "office" );
+
+  Home_0 = Sim_Wifi_Add_Ap( "home",   -62, 1 );
+  Home_1 = Sim_Wifi_Add_Ap( "home",   -70, 6 );
+  Office = Sim_Wifi_Add_Ap( "office", -95, 11 );
+  Sim_Wifi_Add_Ap( "cafe", -40, 3 );
+
+  /* Past the first WIFI_ROAM_SCAN_INTERVAL_MS, it may roam from the start */
+  Sim_Clock_Advance( (uint64_t)WIFI_ROAM_SCAN_INTERVAL_MS * 1000 );
+
+  Wifi_Initialise();
+  Check_Run( 20000 );
+  Check( Sim_Wifi_Ap() == Home_0, "connects to the strongest stored AP" );
+
+  Sim_Wifi_Set_Ap_Rssi( Home_0, -80 );
+  Sim_Wifi_Set_Ap_Rssi( Home_1, -60 );
+  Check_Run( WIFI_ROAM_SCAN_INTERVAL_MS + 2 * WIFI_ROAM_CHECK_MS );
+  Check( Sim_Wifi_Ap() == Home_1, "roams to the stronger repeater" );
+
+  Sim_Wifi_Set_Ap_Rssi( Home_1, -78 );
+  Sim_Wifi_Set_Ap_Rssi( Home_0, -78 + WIFI_ROAM_HYSTERESIS_DB - 1 );
+  Check_Run( 2 * WIFI_ROAM_SCAN_INTERVAL_MS + 2 * WIFI_ROAM_CHECK_MS );
+  Check( Sim_Wifi_Ap() == Home_1, "stays within the hysteresis" );
+
+  Sim_Wifi_Set_Ap_Rssi( Office, -78 + WIFI_ROAM_HYSTERESIS_DB );
+  Check_Run( WIFI_ROAM_SCAN_INTERVAL_MS + 2 * WIFI_ROAM_CHECK_MS );
+  Check( Sim_Wifi_Ap() == Office, "roams to the preferred network" );
+
+  Sim_Wifi_Set_Ap_Rssi( Office, -95 );
+  Sim_Wifi_Drop();
+  Check_Run( WIFI_RETRY_INTERVAL_MS + 20000 );
+  Check( Sim_Wifi_Ap() == Home_0, "after the loss, the best AP left" );
+
+  Same = ( Check_Order.size() == sizeof(Expected) / sizeof(Expected[0]) );
+  printf( "  order" );
+  for ( Index = 0; Index < Check_Order.size(); Index++ )
+  {
+    printf( " %d", Check_Order[Index] );
+    Same = Same && ( Check_Order[Index] == Expected[Index] );
+  }
+  printf( "\n" );
+  Check( Same, "the order is home 0, home 1, office, home 0" );
+}
+
+/*===========================================================================*/
+
+static void
+Check_Migration( void )
+{
+  MY_CONFIG_RECORD        Config;
+  CHECK_CONFIG_V2_RECORD  Old_Config;
+
+  printf( "Migration\n" );
+
+  /* As EEPROM holds it, the rest of the bytes after the old record */
+  memset( &Config, 0xff, sizeof(Config) );
+  memset( &Old_Config, 0, sizeof(Old_Config) );
+  Old_Config.format_version = 2;
+  strcpy( Old_Config.sta_ssid, "home" );
+  strcpy( Old_Config.sta_pwd,  "secret" );
+  strcpy( Old_Config.ap_ssid,  "pump" );
+  strcpy( Old_Config.ap_pwd,   "12345678" );
+  Old_Config.relay_auto             = TRUE;
+  Old_Config.relay_on_timing.valid  = TRUE;
+  Old_Config.relay_on_timing.hh     = 6;
+  Old_Config.relay_on_timing.mm     = 30;
+  Old_Config.relay_off_timing.valid = TRUE;
+  Old_Config.relay_off_timing.hh    = 7;
+  Old_Config.relay_off_timing.mm    = 15;
+  Old_Config.high_distance_cm       = 80.5f;
+  Old_Config.low_distance_cm        = 20.25f;
+  memcpy( &Config, &Old_Config, sizeof(Old_Config) );
+
+  Check( My_Config_Validate( &Config ) == FN_RETURN_OK, "format 2 is valid" );
+  Check( Config.format_version == MY_CONFIG_FORMAT_VERSION, "moved to the current format" );
+  Check( Config.sta_list[0].valid && (Config.sta_list[0].priority == 0) &&
+         (strcmp( Config.sta_list[0].ssid, "home" ) == 0) &&
+         (strcmp( Config.sta_list[0].pwd, "secret" ) == 0),
+         "the network is the first of the list" );
+  Check( !Config.sta_list[1].valid && !Config.sta_list[2].valid && !Config.sta_list[3].valid,
+         "the rest of the list is free" );
+  Check( (strcmp( Config.ap_ssid, "pump" ) == 0) && (strcmp( Config.ap_pwd, "12345678" ) == 0),
+         "the AP is kept" );
+  Check( Config.relay_auto &&
+         Config.relay_on_timing.valid && (Config.relay_on_timing.hh == 6) && (Config.relay_on_timing.mm == 30) &&
+         Config.relay_off_timing.valid && (Config.relay_off_timing.hh == 7) && (Config.relay_off_timing.mm == 15) &&
+         (Config.high_distance_cm == 80.5f) && (Config.low_distance_cm == 20.25f),
+         "the relay settings are kept" );
+  Check( Config.wdt_enable, "the watchdog is on, as format 3 gets it" );
+
+  Config.format_version = 1;
+  Check( My_Config_Validate( &Config ) != FN_RETURN_OK, "format 1 is not" );
+}
+
+/*===========================================================================*/
+
+int
+main( int argc, char *argv[] )
+{
+  FILE  *pConsole = NULL;
+
+  if ( (argc > 1) && (strcmp( argv[1], "-v" ) == 0) )
+  {
+    pConsole = stdout;
+  }
+  else if ( argc > 1 )
+  {
+    fprintf( stderr, "Usage: %s [-v]\n", argv[0] );
+    return 1;
+  }
+  else
+  {
+    pConsole = fopen( "/dev/null", "w" );
+  }
+  Sim_Serial_Set_Output( pConsole );
+
+  Check_Selection();
+  Check_Roaming();
+  Check_Migration();
+
+  printf( "%s\n", Check_Ok ? "PASS" : "FAIL" );
+  return Check_Ok ? 0 : 1;
+}
+
+/*===========================================================================*/